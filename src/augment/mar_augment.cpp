@@ -2,1056 +2,5162 @@
  * @file mar_augment.c
  * 
  * Contains code which is used for augmentation.
+ * Each augmentation context is an independent pipeline with its own cameras, detectors, threads and
+ * augmentations, so several contexts may be updated on their own threads at the same time.  A context must only
+ * be used by one thread at a time, except for its snapshots, which may be acquired and released from any thread
+ * while it is being updated, and its configuration, which may be reloaded from any thread and is applied before
+ * the next update.  The functions without a context use the context created by mar_augment_init.
  *
  * @author Greg Eddington
- * @todo Change to C by finding a C matrix library
+ * @todo Change to C
  */
 
 extern "C"
 {
   #include "mar_augment.h"
+  #include "mar_model_cache.h"
+  #include "../camera/mar_capture_log.h"
   #include "../common/mar_common.h"
+  #include "../common/mar_image_pyramid.h"
+  #include "../common/mar_stats.h"
+  #include "../common/mar_thread_pool.h"
+  #include "../vision/mar_affine.h"
+  #include "../vision/mar_features.h"
+  #include "../vision/mar_keypoint_grid.h"
+  #include "../vision/mar_keypoint_index.h"
+  #include "../vision/mar_motion.h"
+  #include "../vision/mar_optical_flow.h"
   #include <libconfig.h> 
   #include <float.h>
+  #include <math.h>
+  #include <stdio.h>
+  #include <stdlib.h>
+  #include <string.h>
+  #include <pthread.h>
 }
 
-#include <armadillo>
+/** \defgroup augment_frame_states Augmentation Frame States
+ *  @{
+ */
+/** The frame is waiting to be captured */
+#define MAR_AUGMENT_FRAME_FREE      0
+/** The frame is being captured and its keypoints detected */
+#define MAR_AUGMENT_FRAME_DETECTING 1
+/** The frame is ready to be tracked */
+#define MAR_AUGMENT_FRAME_DETECTED  2
+/** The frame is the current frame being tracked and displayed */
+#define MAR_AUGMENT_FRAME_TRACKING  3
+/** @} */
+
+/** A camera frame moving through the augmentation pipeline */
+typedef struct
+{
+  /** The state of the frame in the pipeline */
+  int state;
+  /** The error from capturing or detecting the frame */
+  mar_error_code error;
+  /** The camera frame lease */
+  mar_camera_frame frame;
+  /** Whether or not frame is currently leased from the camera */
+  char frame_acquired;
+  /** The grayscale images of the frame shared by SIFT, MSER and the visualizer */
+  mar_image_pyramid pyramid;
+  /** Whether or not the SIFT keypoints have been calculated */
+  char sift_calculated;
+  /** The scratch memory of the frame, reset whenever the frame is captured */
+  mar_arena arena;
+  /** The SIFT keypoints, allocated from the frame's arena */
+  mar_sift_keypoint *keypoints;
+  /** The number of SIFT keypoints */
+  int num_keypoints;
+  /** The SIFT keypoints bucketed by position */
+  mar_keypoint_grid grid;
+  /** The regions to detect keypoints in, planned before the frame is detected */
+  mar_sift_region regions[MAR_SIFT_MAX_REGIONS];
+  /** The number of regions to detect keypoints in, 0 to detect over the whole frame */
+  int num_regions;
+  /** Whether or not the keypoints were detected over the whole frame */
+  char full_frame;
+  /** Whether or not no keypoints are detected as every augmentation is followed by optical flow, planned before the frame is detected */
+  char skip_detection;
+}
+mar_augment_frame;
+
+/** The detector settings which may be reloaded while the pipeline runs, applied by the thread using each detector */
+typedef struct
+{
+  /** The MSER delta */
+  float mser_delta;
+  /** The minimum area of an MSER relative to the frame */
+  float mser_min_area;
+  /** The maximum area of an MSER relative to the frame */
+  float mser_max_area;
+  /** The minimum diversity of an MSER */
+  float mser_min_diversity;
+  /** The maximum variation of an MSER */
+  float mser_max_variation;
+  /** The number of SIFT octaves */
+  int sift_number_of_octaves;
+  /** The first SIFT octave */
+  int sift_first_octave;
+  /** The SIFT peak threshold */
+  float sift_peak_threshold;
+  /** The SIFT edge threshold */
+  float sift_edge_threshold;
+  /** The FAST corner threshold */
+  int orb_fast_threshold;
+}
+mar_augment_detector_settings;
+
+/** A camera of the augmentation, with its own detectors, pipeline frames and detection thread */
+typedef struct
+{
+  /** The pipeline the view belongs to */
+  mar_augment_ctx *ctx;
+  /** The index of the view */
+  int index;
+  /** The ID of the camera */
+  mar_camera_id camera_id;
+  /** The keypoint detector of the camera's frames, used by one thread at a time */
+  mar_features_ctx features;
+  /** The MSER detector of the camera's frames */
+  mar_mser_ctx mser;
+  /** The version of the detector settings the keypoint detector was last configured with */
+  unsigned int features_settings_version;
+  /** The version of the detector settings the MSER detector was last configured with */
+  unsigned int mser_settings_version;
+  /** The frames of the pipeline, only the first is used when not pipelined */
+  mar_augment_frame frames[MAR_AUGMENT_PIPELINE_DEPTH];
+  /** The number of frames in use */
+  int num_frames;
+  /** The frame being tracked and displayed, or NULL before the first update */
+  mar_augment_frame *current_frame;
+  /** Whether or not the detection thread is running */
+  char pipeline_running;
+  /** The detection thread */
+  pthread_t pipeline_thread;
+  /** Guards the frame states and pipeline_running */
+  pthread_mutex_t pipeline_mutex;
+  /** Signaled whenever a frame changes state */
+  pthread_cond_t pipeline_cond;
+  /** The number of frames handed to the detection thread since capture started */
+  unsigned int pipeline_detect_count;
+  /** The number of frames taken for tracking since capture started */
+  unsigned int pipeline_track_count;
+  /** The current camera frame in an RGB24 format, converted only when requested */
+  unsigned char *frame_rgb;
+  /** Whether or not frame_rgb holds the current camera frame */
+  char frame_rgb_converted;
+  /** Whether or not the MSER have been calculated for the current frame */
+  char mser_calculated_this_frame;
+  /** The MSER of the current frame */
+  mar_mser *mser_regions;
+  /** The number of MSER of the current frame */
+  int mser_num_regions;
+  /** Whether or not the MSER thread is running */
+  char mser_running;
+  /** The MSER thread, which detects MSER in the background while they are being asked for */
+  pthread_t mser_thread;
+  /** Guards the MSER job and result flags and mser_running */
+  pthread_mutex_t mser_mutex;
+  /** Signaled whenever an MSER job is handed out, finished or cancelled */
+  pthread_cond_t mser_cond;
+  /** The copy of the frame level the MSER thread detects in, owned by the thread while a job is pending */
+  unsigned char *mser_image;
+  /** The width of the level the pending MSER job detects in */
+  int mser_image_width;
+  /** The height of the level the pending MSER job detects in */
+  int mser_image_height;
+  /** The pyramid level the pending MSER job detects in */
+  int mser_image_level;
+  /** Whether or not an MSER job has been handed to the MSER thread and not finished */
+  char mser_job_pending;
+  /** Whether or not the results of the pending MSER job are to be thrown away */
+  char mser_job_cancelled;
+  /** The double buffered results of the MSER thread, the front one is published and the back one is written */
+  mar_mser *mser_buffers[2];
+  /** The size of each result buffer */
+  int mser_buffer_sizes[2];
+  /** The number of MSER in each result buffer */
+  int mser_buffer_counts[2];
+  /** The index of the published result buffer */
+  int mser_front;
+  /** Whether or not the back result buffer holds results waiting to be published */
+  char mser_back_ready;
+  /** The error of the last MSER job */
+  mar_error_code mser_error;
+  /** The update during which MSER were last asked for */
+  unsigned int mser_requested_update;
+  /** The update during which the last MSER job was handed out */
+  unsigned int mser_submitted_update;
+  /** The number of frames planned since keypoints were last planned for the whole frame */
+  int roi_frames_since_full_frame;
+  /** Whether or not the next planned frame must be detected over the whole frame */
+  char roi_force_full_frame;
+  /** The number of frames planned since keypoints were last planned to be detected */
+  int flow_frames_since_detection;
+  /** The image pyramid of the last tracked frame, which points are followed from */
+  mar_image_pyramid flow_previous;
+  /** Whether or not flow_previous holds the last tracked frame */
+  char flow_previous_valid;
+  /** The number of augmentations tracked in the view */
+  int number_of_augmentations;
+  /** The error of the last update of the view */
+  mar_error_code error;
+}
+mar_augment_view;
 
-using namespace arma;
+/** The keypoints of an augmentation's surface, which are only touched while the augmentation is tracked or created */
+typedef struct
+{
+  /** The X coordinates of the SIFT keypoints on the surface in the initial frame */
+  float initial_x[MAR_MAX_NUMBER_OF_AUGMENTATION_KEYPOINTS];
+  /** The Y coordinates of the SIFT keypoints on the surface in the initial frame */
+  float initial_y[MAR_MAX_NUMBER_OF_AUGMENTATION_KEYPOINTS];
+  /** Number of initial SIFT keypoints */
+  int num_initial_keypoints;
+  /** The descriptors of the initial SIFT keypoints, in the same order as their coordinates */
+  mar_keypoint_index index;
+  /** The number of tracked frames each keypoint was matched in, halved every MAR_AUGMENT_KEYPOINT_HISTORY frames */
+  unsigned short keypoint_hits[MAR_MAX_NUMBER_OF_AUGMENTATION_KEYPOINTS];
+  /** The number of tracked frames each keypoint was not matched in, halved every MAR_AUGMENT_KEYPOINT_HISTORY frames */
+  unsigned short keypoint_misses[MAR_MAX_NUMBER_OF_AUGMENTATION_KEYPOINTS];
+  /** The descriptors of SIFT keypoints seen on the surface in the last frame which may become initial keypoints */
+  mar_keypoint_index potential_index;
+  /** The X coordinates on the initial surface of the points followed by optical flow */
+  float flow_x[MAR_MAX_NUM_OF_MATCHED_KEYPOINTS];
+  /** The Y coordinates on the initial surface of the points followed by optical flow */
+  float flow_y[MAR_MAX_NUM_OF_MATCHED_KEYPOINTS];
+  /** The X coordinates in the last frame of the points followed by optical flow */
+  float flow_u[MAR_MAX_NUM_OF_MATCHED_KEYPOINTS];
+  /** The Y coordinates in the last frame of the points followed by optical flow */
+  float flow_v[MAR_MAX_NUM_OF_MATCHED_KEYPOINTS];
+  /** The number of points followed by optical flow */
+  int num_flow_points;
+}
+mar_augmentation_surface;
 
-/** Whether or not the augmentation module has been initialized @return */
-MAR_PRIVATE char mar_augment_initialized = 0;
-/** The configuration context used to load and store configuration values @return */
-MAR_PRIVATE config_t mar_cfg;
-/** The ID of the camera used for augmentation @return */
-MAR_PRIVATE mar_camera_id camera_id = MAR_CAM_NO_CAMERA;
-/** Whether or not to run the augmentation @return */
-MAR_PRIVATE char mar_run_augmentation = 0;
+/** Marks a keypoint of a frame which has not been matched against an augmentation's keypoints yet */
+#define MAR_AUGMENT_MATCH_UNKNOWN -2
 
-/** Whether or not the MSER have been calculated @return */
-MAR_PRIVATE char mar_mser_calculated_this_frame = 0;
-/** The MSER @return */
-MAR_PRIVATE mar_mser *mar_mser_regions;
-/** The number of MSER @return */
-MAR_PRIVATE int mar_mser_num_regions;
+/** A match between a keypoint of a frame and a keypoint of an augmentation, kept while the best matches are selected */
+typedef struct
+{
+  /** The descriptor difference of the match */
+  float difference;
+  /** The number of matches kept before this one, which orders matches of the same difference */
+  int order;
+  /** The index of the augmentation's keypoint */
+  int model;
+  /** The index of the frame's keypoint */
+  int frame;
+}
+mar_augment_match;
 
-/** Whether or not the SIFT keypoints have been calculated @return */
-MAR_PRIVATE char mar_sift_calculated_this_frame = 0;
-/** The SIFT keypoints @return */
-MAR_PRIVATE mar_sift_keypoint *mar_sift_keypoints;
-/** The number of SIFT keypoints @return */
-MAR_PRIVATE int mar_sift_num_keypoints;
+/** The best matches between the keypoints of a frame and the keypoints of an augmentation */
+typedef struct
+{
+  /** The best matches so far in a max-heap, the worst kept match on top */
+  mar_augment_match heap[MAR_MAX_NUM_OF_MATCHED_KEYPOINTS];
+  /** The number of matches in the heap */
+  int heap_size;
+  /** The X coordinates of the matched points on the initial surface, sorted from the best to the worst match */
+  float x[MAR_MAX_NUM_OF_MATCHED_KEYPOINTS];
+  /** The Y coordinates of the matched points on the initial surface, sorted from the best to the worst match */
+  float y[MAR_MAX_NUM_OF_MATCHED_KEYPOINTS];
+  /** The X coordinates of the matches in the frame, sorted from the best to the worst match */
+  float u[MAR_MAX_NUM_OF_MATCHED_KEYPOINTS];
+  /** The Y coordinates of the matches in the frame, sorted from the best to the worst match */
+  float v[MAR_MAX_NUM_OF_MATCHED_KEYPOINTS];
+  /** The number of matches found, which may be more than are kept */
+  int num_matches;
+}
+mar_augment_matches;
 
-/** A MAR library augmentation */
+/** A MAR library augmentation, holding the pose and status which are read every frame */
 typedef struct
 {
+  /** Whether the augmentation exists */
+  char initialized;
+  /** The error of the last tracking, MAR_ERROR_NONE if the augmentation was found */
+  mar_error_code error;
+  /** The number of matches which agree with the augmentation's last transformation */
+  int num_inliers;
+  /** The number of matches the augmentation's last transformation was solved from */
+  int num_matches;
+  /** The affine transformation which transforms points on the initial surface to points on the latest frame's surface */
+  mar_affine transform;
+  /** The affine transformation which transforms points on the latest frame's surface to points on the initial surface */
+  mar_affine transform_inverse;
+  /** The index of the view the augmentation is tracked in */
+  int view;
   /** The MSER being tracked */
   mar_mser mser;
-  /** The affine transformation matrix which transforms points on the initial surface to points on the latest frame's surface */
-  fmat::fixed<3, 3> transform;
-  /** The affine transformation matrix which transforms points on the latest frame's surface to points on the initial surface */
-  fmat::fixed<3, 3> transform_inverse;
-  /** A list of SIFT keypoints on the surface in the initial frame */
-  mar_sift_keypoint initial_keypoints[MAR_MAX_NUMBER_OF_AUGMENTATION_KEYPOINTS];
-  /** Number of initial SIFT keypoints */
-  int num_initial_keypoints;
-  /** The index into the keypoint buffer for new keypoints */
-  size_t new_keypoint_cursor;
-  /** A list of SIFT keypoints on the surface in the initial frame */
-  mar_sift_keypoint potential_keypoints[MAR_MAX_NUMBER_OF_AUGMENTATION_KEYPOINTS];
-  /** Number of initial SIFT keypoints */
-  int num_potential_keypoints;
+  /** The motion model of the transformation */
+  mar_motion motion;
+  /** The keypoints of the surface, allocated the first time the ID is used and kept when it is freed */
+  mar_augmentation_surface *surface;
+  /** The next free ID after this one while the augmentation does not exist, -1 for none */
+  int next_free;
 }
 mar_augmentation;
 
-/** The number of augmentations */
-MAR_PRIVATE int mar_number_of_augmentations = 0;
-/** Whether the augmentation is initialized */
-MAR_PRIVATE char mar_augmentation_initialized[MAR_MAX_NUMBER_OF_AUGMENTATIONS] = { 0 };
-/** Whether the augmentation exists */
-MAR_PRIVATE mar_augmentation mar_augmentations[MAR_MAX_NUMBER_OF_AUGMENTATIONS];
-/** Whether the last augmentation was successful or not */
-MAR_PRIVATE mar_error_code mar_augmentation_successful[MAR_MAX_NUMBER_OF_AUGMENTATIONS] = { 0 };
+/** The augmentations to track in a frame, shared by the tracking tasks */
+typedef struct
+{
+  /** The pipeline the augmentations belong to */
+  mar_augment_ctx *ctx;
+  /** The IDs of the augmentations to track, allocated from the frame's arena */
+  int *ids;
+  /** The number of augmentations to track */
+  int num_ids;
+  /** The keypoints of the frame */
+  mar_sift_keypoint *keypoints;
+  /** The number of keypoints of the frame */
+  int num_keypoints;
+  /** The keypoints of the frame bucketed by position */
+  const mar_keypoint_grid *grid;
+  /** The scratch memory of the frame */
+  mar_arena *arena;
+  /** Whether or not augmentations are followed by optical flow from the previous frame instead of matched */
+  char flow;
+  /** The image pyramid of the previous frame */
+  mar_image_pyramid *previous;
+  /** The image pyramid of the frame */
+  mar_image_pyramid *current;
+}
+mar_augment_track_job;
+
+/** The state of an augmentation pipeline, independent of every other pipeline */
+struct mar_augment_ctx
+{
+  /** The configuration context used to load and store configuration values */
+  config_t cfg;
+  /** Whether or not to run the augmentation */
+  char run_augmentation;
+  /** Whether or not frames are captured and detected on a separate thread for each view */
+  char pipelined;
+  /** The cameras of the augmentation */
+  mar_augment_view views[MAR_AUGMENT_MAX_NUM_VIEWS];
+  /** The number of cameras of the augmentation */
+  int num_views;
+  /** The number of image pyramid levels built for every view's frames, which small frames may have fewer of than configured */
+  int pyramid_levels;
+  /** The number of randomized trees in each augmentation's keypoint index */
+  int index_trees;
+  /** The maximum number of descriptors compared when matching a keypoint against an augmentation's keypoint index */
+  int index_max_comparisons;
+  /** The maximum number of samples tried when estimating an augmentation's transformation */
+  int ransac_iterations;
+  /** The distance in pixels within which a transformed keypoint agrees with its match */
+  float ransac_threshold;
+  /** The confidence after which no more samples are tried when estimating a transformation */
+  float ransac_confidence;
+  /** The format of the keypoint descriptors augmentations store, one of the keypoint index formats */
+  char index_format;
+  /** The feature backend keypoints are detected with */
+  int feature_backend;
+  /** Whether or not MSER are detected on a thread of each view instead of during the call asking for them */
+  char mser_background;
+  /** The number of updates between detections of MSER on the MSER threads */
+  int mser_interval;
+  /** The image pyramid level MSER are detected in */
+  int mser_level;
+  /** The maximum difference between two keypoints' descriptors to be considered matching, which depends on the feature backend */
+  float max_keypoint_difference;
+  /** How much closer a keypoint's best match must be than its second best match to be unique, which depends on the feature backend */
+  float unique_keypoint_threshold;
+  /** Whether or not keypoints are only detected around tracked augmentations */
+  char roi_detection;
+  /** The number of pixels added to each side of an augmentation's predicted bounding box */
+  int roi_padding;
+  /** The number of frames between keypoint detections over the whole frame */
+  int roi_full_frame_interval;
+  /** Whether or not augmentations are followed by optical flow between keypoint detections */
+  char flow_tracking;
+  /** The maximum number of frames between keypoint detections while following augmentations by optical flow */
+  int flow_detection_interval;
+  /** The number of inliers every augmentation needs for the next frame to be followed by optical flow */
+  int flow_min_inliers;
+  /** The radius of the window tracked around each point followed by optical flow */
+  int flow_window_radius;
+  /** The maximum number of optical flow iterations on each pyramid level */
+  int flow_iterations;
+  /** Whether or not augmentations are predicted by a motion model */
+  char motion_model;
+  /** The gain applied to the difference between a measured and a predicted transformation */
+  float motion_alpha;
+  /** The gain applied to the difference between a measured and a predicted transformation to correct its velocity */
+  float motion_beta;
+  /** The maximum number of frames in a row a lost augmentation's transformation is predicted for */
+  int motion_max_coast_frames;
+  /** The number of heap allocations made during the last update */
+  unsigned long frame_allocations;
+  /** The number of updates since an augmentation was created or freed, up to MAR_AUGMENT_STEADY_STATE_FRAMES */
+  int steady_frames;
+  /** The threads used to track augmentations concurrently, or NULL to track them on the updating thread */
+  mar_thread_pool *tracking_pool;
+  /** The number of augmentations */
+  int number_of_augmentations;
+  /** The augmentations indexed by ID, grown as more IDs are needed */
+  mar_augmentation *augmentations;
+  /** The number of IDs in augmentations */
+  int augmentations_capacity;
+  /** The first free ID, -1 when every ID is in use */
+  int augmentations_free;
+  /** The log the session is recorded into, or NULL when not recording */
+  mar_capture_log_writer *recorder;
+  /** The log the session is replayed from, or NULL when not replaying */
+  mar_capture_log *replay;
+  /** The model cache the augmentations are saved to when the context is freed, or NULL for none */
+  const char *model_cache;
+  /** Whether or not the model cache was loaded or did not exist yet, so saving over it loses no models */
+  char model_cache_loaded;
+  /** The number of updates made */
+  unsigned int num_updates;
+  /** The index of the next event of the replayed log to apply */
+  uint32_t replay_next_event;
+  /** The latencies of each \ref augment_stages "stage", recorded from every thread of the pipeline */
+  mar_stats_histogram stage_latencies[MAR_AUGMENT_NUM_STAGES];
+  /** Whether or not the detectors are scaled down whenever updates take longer than the frame budget */
+  char governor;
+  /** The time in microseconds an update should take */
+  float governor_frame_budget;
+  /** The maximum number of first SIFT octaves skipped to meet the frame budget */
+  int governor_max_octave_skip;
+  /** The maximum image pyramid level MSER are detected in to meet the frame budget */
+  int governor_max_mser_level;
+  /** The smoothed time in microseconds of the updates */
+  float governor_update_time;
+  /** The number of updates before the detectors may be changed again */
+  int governor_settle_updates;
+  /** The number of first SIFT octaves the detectors of every view skip, read atomically by the detection threads */
+  int governor_octave_skip;
+  /** The image pyramid level MSER are detected in */
+  int governor_mser_level;
+  /** The snapshots published after each update */
+  mar_augment_snapshot snapshots[MAR_AUGMENT_NUM_SNAPSHOTS];
+  /** The latest published snapshot, or NULL before the first */
+  mar_augment_snapshot *snapshot_published;
+  /** Guards snapshot_published, snapshot_contents and the reference counts of the snapshots */
+  pthread_mutex_t snapshot_mutex;
+  /** Whether or not snapshots are published, set atomically once one has been asked for */
+  char snapshots_enabled;
+  /** The \ref augment_snapshot_contents "contents" asked for by the last acquire */
+  int snapshot_contents;
+  /** The detector settings every view's detectors are configured with */
+  mar_augment_detector_settings detector_settings;
+  /** Increased whenever detector_settings changes, read atomically by the threads using the detectors */
+  unsigned int detector_settings_version;
+  /** A configuration reloaded to be applied before the next update, or NULL, set atomically */
+  config_t *reload_cfg;
+  /** Guards detector_settings, detector_settings_version and reload_cfg */
+  pthread_mutex_t reload_mutex;
+};
+
+/** The pipeline used by the functions without a context, created by mar_augment_init @return */
+MAR_PRIVATE mar_augment_ctx *mar_augment_default_ctx = NULL;
 
 /**
- * Initializes augmentation using a configuration file
- *
- * @param filename The filename of the configuration file, NULL for default settings
+ * Returns the camera leases held by the pipeline frames of a view.  The view's detection thread must not be running.
  *
- * @return MAR_ERROR_NONE on success, an error code on failure.
+ * @param v The view
+ */
+MAR_PRIVATE
+void mar_augment_release_frames(mar_augment_view *v)
+{
+  int i;
+
+  for (i = 0; i < v->num_frames; i++)
+  {
+    if (v->frames[i].frame_acquired)
+    {
+      mar_camera_release_frame(&v->frames[i].frame);
+      v->frames[i].frame_acquired = 0;
+    }
+    v->frames[i].state = MAR_AUGMENT_FRAME_FREE;
+  }
+  v->current_frame = NULL;
+  v->flow_previous_valid = 0;
+}
+
+/**
+ * Frees the resources of the pipeline frames of a view.  The view's detection thread must not be running.
  *
- * @todo initialize state variables
+ * @param v The view
  */
-MAR_PUBLIC
-mar_error_code mar_augment_init(char *filename)
+MAR_PRIVATE
+void mar_augment_free_frames(mar_augment_view *v)
 {
-  mar_error_code mrv;
-  int camera_type = MAR_CAM_DEFAULT_TYPE, 
-    camera_format = MAR_CAM_DEFAULT_FORMAT, 
-    camera_width = MAR_CAM_DEFAULT_WIDTH, 
-    camera_height = MAR_CAM_DEFAULT_HEIGHT, 
-    sift_number_of_octaves = MAR_SIFT_DEFAULT_NUMBER_OF_OCTAVES, 
-    sift_number_of_levels = MAR_SIFT_DEFAULT_NUMBER_OF_LEVELS, 
-    sift_first_octave = MAR_SIFT_DEFAULT_FIRST_OCTAVE;
-  const char *camera_dev_name = MAR_CAM_DEFAULT_DEV_NAME;
-  double mser_delta = MAR_MSER_DEFAULT_DELTA, 
-    mser_min_area = MAR_MSER_DEFAULT_MIN_AREA, 
-    mser_max_area = MAR_MSER_DEFAULT_MAX_AREA, 
-    mser_min_diversity = MAR_MSER_DEFAULT_MIN_DIVERSITY, 
-    mser_max_variation = MAR_MSER_DEFAULT_MAX_VARIATION, 
-    sift_peak_threshold = MAR_SIFT_DEFAULT_PEAK_THRESHOLD, 
-    sift_edge_threshold = MAR_SIFT_DEFAULT_EDGE_THRESHOLD;
+  int i;
 
-  // Check if augmentation has already been initialized
-  if (mar_augment_initialized)
+  mar_augment_release_frames(v);
+  for (i = 0; i < v->num_frames; i++)
   {
-    return MAR_ERROR_AUGMENTATION_ALREADY_INITIALIZED;
+    mar_image_pyramid_free(&v->frames[i].pyramid);
+    mar_keypoint_grid_free(&v->frames[i].grid);
+    mar_arena_free(&v->frames[i].arena);
+    MAR_CLEAR(v->frames[i]);
   }
+  v->num_frames = 0;
+}
+
+/**
+ * Leases the next camera frame into a pipeline frame and extracts its luma, returning the frame's previous lease first.
+ *
+ * @param v The view
+ * @param f The pipeline frame
+ *
+ * @return MAR_ERROR_NONE on success, an error code on failure.
+ */
+MAR_PRIVATE
+mar_error_code mar_augment_capture_frame(mar_augment_view *v, mar_augment_frame *f)
+{
+  mar_error_code mrv;
+  uint64_t start;
 
-  config_init(&mar_cfg);
+  // Nothing allocated for the previous frame is in use anymore.  A failure to grow the arena only means
+  // this frame's scratch memory comes from the heap again, so it is not an error.
+  mar_arena_reset(&f->arena);
+  f->keypoints = NULL;
+  f->num_keypoints = 0;
+  f->sift_calculated = 0;
 
-  // Load the config file
-  if (filename != NULL)
+  // Return the previous frame to the camera and lease the next one
+  if (f->frame_acquired)
   {
-    if (!config_read_file(&mar_cfg, filename)) 
+    f->frame_acquired = 0;
+    mrv = mar_camera_release_frame(&f->frame);
+    if (mrv != MAR_ERROR_NONE)
     {
-        fprintf(stderr, "%s:%d - %s\n", config_error_file(&mar_cfg), config_error_line(&mar_cfg), config_error_text(&mar_cfg));
-        config_destroy(&mar_cfg);
-        return MAR_ERROR_READING_CONFIG;
+      return mrv;
     }
   }
 
-  // Create camera
-  config_lookup_int(&mar_cfg, "camera.camera_type", &camera_type);
-  config_lookup_string(&mar_cfg, "camera.dev_name", &camera_dev_name);
-  config_lookup_int(&mar_cfg, "camera.camera_format", &camera_format);
-  config_lookup_int(&mar_cfg, "camera.camera_width", &camera_width);
-  config_lookup_int(&mar_cfg, "camera.camera_height", &camera_height);
-  mrv = mar_camera_new(&camera_id, (mar_camera_type)camera_type, (char *)camera_dev_name, (mar_camera_format)camera_format, camera_width, camera_height);
+  start = mar_stats_now();
+  mrv = mar_camera_acquire_frame(v->camera_id, &f->frame);
   if (mrv != MAR_ERROR_NONE)
   {
-    config_destroy(&mar_cfg);
     return mrv;
   }
+  f->frame_acquired = 1;
+  mar_stats_histogram_add(&v->ctx->stage_latencies[MAR_AUGMENT_STAGE_CAPTURE], mar_stats_now() - start);
 
-  // Create the MSER filter
-  mrv = mar_mser_new(camera_width, camera_height);
-  if (mrv != MAR_ERROR_NONE)
+  // Record the frame as it was captured, in the view's stream
+  if (v->ctx->recorder != NULL)
   {
-    mar_camera_free(camera_id);
-    config_destroy(&mar_cfg);
-    return mrv;
+    mrv = mar_capture_log_write_frame(v->ctx->recorder, v->index, &f->frame);
+    if (mrv != MAR_ERROR_NONE)
+    {
+      return mrv;
+    }
   }
 
-  // Configure the MSER filter
-  config_lookup_float(&mar_cfg, "mser.delta", &mser_delta);
-  mar_mser_set_delta(mser_delta);
-
-  config_lookup_float(&mar_cfg, "mser.min_area", &mser_min_area);
-  mar_mser_set_min_area(mser_min_area);
-
-  config_lookup_float(&mar_cfg, "mser.max_area", &mser_max_area);
-  mar_mser_set_max_area(mser_max_area);
-
-  config_lookup_float(&mar_cfg, "mser.min_diversity", &mser_min_diversity);
-  mar_mser_set_min_diversity(mser_min_diversity);
-
-  config_lookup_float(&mar_cfg, "mser.max_variation", &mser_max_variation);
-  mar_mser_set_max_variation(mser_max_variation);
-
-  // Create the SIFT filter
-  config_lookup_int(&mar_cfg, "sift.number_of_octaves", &sift_number_of_octaves);
-  config_lookup_int(&mar_cfg, "sift.number_of_levels", &sift_number_of_levels);
-  config_lookup_int(&mar_cfg, "sift.first_octave", &sift_first_octave);
-  mrv = mar_sift_new(camera_width, camera_height, sift_number_of_octaves, sift_number_of_levels, sift_first_octave);
+  // Start the frame's image pyramid from the luma of the leased buffer
+  start = mar_stats_now();
+  mrv = mar_camera_frame_to_grayscale(&f->frame, mar_image_pyramid_get_frame_storage(&f->pyramid));
   if (mrv != MAR_ERROR_NONE)
   {
-    mar_camera_free(camera_id);
-    mar_mser_free();
-    config_destroy(&mar_cfg);
     return mrv;
   }
-
-  // Configure the SIFT filter
-  config_lookup_float(&mar_cfg, "sift.peak_threshold", &sift_peak_threshold);
-  mar_sift_set_peak_threshold(sift_peak_threshold);
-  config_lookup_float(&mar_cfg, "sift.edge_threshold", &sift_edge_threshold);
-  mar_sift_set_edge_threshold(sift_edge_threshold);
-
-  // Mark as initialized
-  mar_augment_initialized = 1;
+  mar_image_pyramid_set_frame(&f->pyramid, mar_image_pyramid_get_frame_storage(&f->pyramid), NULL);
+  mar_stats_histogram_add(&v->ctx->stage_latencies[MAR_AUGMENT_STAGE_CONVERT], mar_stats_now() - start);
 
   return MAR_ERROR_NONE;
 }
 
 /**
- * Initializes augmentation using default settings
+ * Configures the tracking settings which are only read by the updating thread, so that they can be reloaded
+ * between updates.  Settings missing from the configuration take their default values.
  *
- * @return MAR_ERROR_NONE on success, an error code on failure.
+ * @param ctx The augmentation context, whose number of pyramid levels and feature backend are set
+ * @param cfg The configuration
  */
-MAR_PUBLIC
-mar_error_code mar_augment_init_from_defaults()
+MAR_PRIVATE
+void mar_augment_configure_tracking(mar_augment_ctx *ctx, const config_t *cfg)
 {
-  return mar_augment_init(NULL);
+  int roi_detection = MAR_AUGMENT_DEFAULT_ROI_DETECTION,
+    motion_model = MAR_AUGMENT_DEFAULT_MOTION_MODEL;
+  double ransac_threshold = MAR_AFFINE_DEFAULT_INLIER_THRESHOLD,
+    ransac_confidence = MAR_AFFINE_DEFAULT_CONFIDENCE,
+    motion_alpha = MAR_MOTION_DEFAULT_ALPHA,
+    motion_beta = MAR_MOTION_DEFAULT_BETA,
+    governor_frame_budget = MAR_AUGMENT_DEFAULT_GOVERNOR_FRAME_BUDGET;
+
+  // Configure the transformation estimator
+  ctx->ransac_iterations = MAR_AFFINE_DEFAULT_MAX_ITERATIONS;
+  config_lookup_int(cfg, "augment.ransac_iterations", &ctx->ransac_iterations);
+  config_lookup_float(cfg, "augment.ransac_threshold", &ransac_threshold);
+  ctx->ransac_threshold = ransac_threshold;
+  config_lookup_float(cfg, "augment.ransac_confidence", &ransac_confidence);
+  ctx->ransac_confidence = ransac_confidence;
+
+  // Configure detection around tracked augmentations
+  config_lookup_bool(cfg, "augment.roi_detection", &roi_detection);
+  ctx->roi_detection = roi_detection;
+  ctx->roi_padding = MAR_AUGMENT_DEFAULT_ROI_PADDING;
+  config_lookup_int(cfg, "augment.roi_padding", &ctx->roi_padding);
+  ctx->roi_full_frame_interval = MAR_AUGMENT_DEFAULT_ROI_FULL_FRAME_INTERVAL;
+  config_lookup_int(cfg, "augment.roi_full_frame_interval", &ctx->roi_full_frame_interval);
+
+  // Configure the motion model of augmentations
+  config_lookup_bool(cfg, "augment.motion_model", &motion_model);
+  ctx->motion_model = motion_model;
+  config_lookup_float(cfg, "augment.motion_alpha", &motion_alpha);
+  ctx->motion_alpha = motion_alpha;
+  config_lookup_float(cfg, "augment.motion_beta", &motion_beta);
+  ctx->motion_beta = motion_beta;
+  ctx->motion_max_coast_frames = MAR_MOTION_DEFAULT_MAX_COAST_FRAMES;
+  config_lookup_int(cfg, "augment.motion_max_coast_frames", &ctx->motion_max_coast_frames);
+
+  // Configure following augmentations by optical flow between detections
+  ctx->flow_detection_interval = MAR_AUGMENT_DEFAULT_FLOW_DETECTION_INTERVAL;
+  config_lookup_int(cfg, "augment.flow_detection_interval", &ctx->flow_detection_interval);
+  ctx->flow_min_inliers = MAR_AUGMENT_DEFAULT_FLOW_MIN_INLIERS;
+  config_lookup_int(cfg, "augment.flow_min_inliers", &ctx->flow_min_inliers);
+  ctx->flow_window_radius = MAR_OPTICAL_FLOW_DEFAULT_WINDOW_RADIUS;
+  config_lookup_int(cfg, "augment.flow_window_radius", &ctx->flow_window_radius);
+  ctx->flow_iterations = MAR_OPTICAL_FLOW_DEFAULT_MAX_ITERATIONS;
+  config_lookup_int(cfg, "augment.flow_iterations", &ctx->flow_iterations);
+
+  // Configure scaling the detectors to the frame budget
+  config_lookup_float(cfg, "augment.governor_frame_budget", &governor_frame_budget);
+  ctx->governor_frame_budget = governor_frame_budget * 1000;
+  ctx->governor_max_octave_skip = MAR_AUGMENT_DEFAULT_GOVERNOR_MAX_OCTAVE_SKIP;
+  config_lookup_int(cfg, "augment.governor_max_octave_skip", &ctx->governor_max_octave_skip);
+  ctx->governor_max_mser_level = MAR_AUGMENT_DEFAULT_GOVERNOR_MAX_MSER_LEVEL;
+  config_lookup_int(cfg, "augment.governor_max_mser_level", &ctx->governor_max_mser_level);
+  if (ctx->governor_max_mser_level > ctx->pyramid_levels - 1)
+  {
+    ctx->governor_max_mser_level = ctx->pyramid_levels - 1;
+  }
+  if (ctx->feature_backend == MAR_FEATURES_ORB && ctx->governor_max_octave_skip > ctx->pyramid_levels - 1)
+  {
+    ctx->governor_max_octave_skip = ctx->pyramid_levels - 1;
+  }
+
+  // Configure detecting MSER
+  ctx->mser_interval = MAR_AUGMENT_DEFAULT_MSER_INTERVAL;
+  config_lookup_int(cfg, "augment.mser_interval", &ctx->mser_interval);
+  if (ctx->mser_interval < 1)
+  {
+    ctx->mser_interval = 1;
+  }
+  ctx->mser_level = MAR_AUGMENT_DEFAULT_MSER_LEVEL;
+  config_lookup_int(cfg, "augment.mser_level", &ctx->mser_level);
+  if (ctx->mser_level < 0 || ctx->mser_level > ctx->pyramid_levels - 1)
+  {
+    ctx->mser_level = ctx->mser_level < 0 ? 0 : ctx->pyramid_levels - 1;
+  }
 }
 
 /**
- * Starts the augmentation camera
+ * Reads the detector settings which can be changed without recreating a view.  Settings missing from the
+ * configuration take their default values.
  *
- * @return MAR_ERROR_NONE on success, an error code on failure.
+ * @param cfg The configuration
+ * @param settings Will be filled with the settings
  */
-MAR_PUBLIC
-mar_error_code mar_start_capture()
+MAR_PRIVATE
+void mar_augment_read_detector_settings(const config_t *cfg, mar_augment_detector_settings *settings)
 {
-  // Check if augmentation has not been initialized
-  if (!mar_augment_initialized)
-  {
-    return MAR_ERROR_AUGMENTATION_NOT_INITIALIZED;
-  }
+  int sift_number_of_octaves = MAR_SIFT_DEFAULT_NUMBER_OF_OCTAVES, 
+    sift_first_octave = MAR_SIFT_DEFAULT_FIRST_OCTAVE,
+    orb_fast_threshold = MAR_ORB_DEFAULT_FAST_THRESHOLD;
+  double mser_delta = MAR_MSER_DEFAULT_DELTA, 
+    mser_min_area = MAR_MSER_DEFAULT_MIN_AREA, 
+    mser_max_area = MAR_MSER_DEFAULT_MAX_AREA, 
+    mser_min_diversity = MAR_MSER_DEFAULT_MIN_DIVERSITY, 
+    mser_max_variation = MAR_MSER_DEFAULT_MAX_VARIATION, 
+    sift_peak_threshold = MAR_SIFT_DEFAULT_PEAK_THRESHOLD, 
+    sift_edge_threshold = MAR_SIFT_DEFAULT_EDGE_THRESHOLD;
+
+  config_lookup_float(cfg, "mser.delta", &mser_delta);
+  config_lookup_float(cfg, "mser.min_area", &mser_min_area);
+  config_lookup_float(cfg, "mser.max_area", &mser_max_area);
+  config_lookup_float(cfg, "mser.min_diversity", &mser_min_diversity);
+  config_lookup_float(cfg, "mser.max_variation", &mser_max_variation);
+  config_lookup_int(cfg, "sift.number_of_octaves", &sift_number_of_octaves);
+  config_lookup_int(cfg, "sift.first_octave", &sift_first_octave);
+  config_lookup_float(cfg, "sift.peak_threshold", &sift_peak_threshold);
+  config_lookup_float(cfg, "sift.edge_threshold", &sift_edge_threshold);
+  config_lookup_int(cfg, "orb.fast_threshold", &orb_fast_threshold);
 
-  return mar_camera_start(camera_id);
+  settings->mser_delta = mser_delta;
+  settings->mser_min_area = mser_min_area;
+  settings->mser_max_area = mser_max_area;
+  settings->mser_min_diversity = mser_min_diversity;
+  settings->mser_max_variation = mser_max_variation;
+  settings->sift_number_of_octaves = sift_number_of_octaves;
+  settings->sift_first_octave = sift_first_octave;
+  settings->sift_peak_threshold = sift_peak_threshold;
+  settings->sift_edge_threshold = sift_edge_threshold;
+  settings->orb_fast_threshold = orb_fast_threshold;
 }
 
 /**
- * Stops the augmentation camera
+ * Takes a copy of the detector settings if they changed since a detector was last configured.
  *
- * @return MAR_ERROR_NONE on success, an error code on failure.
+ * @param ctx The augmentation context
+ * @param version The version of the settings the detector was last configured with, updated to the copied version
+ * @param settings Will be filled with the settings if they changed
+ *
+ * @return Whether or not the settings changed
  */
-MAR_PUBLIC
-mar_error_code mar_stop_capture()
+MAR_PRIVATE
+char mar_augment_get_detector_settings(mar_augment_ctx *ctx, unsigned int *version, mar_augment_detector_settings *settings)
 {
-  // Check if augmentation has not been initialized
-  if (!mar_augment_initialized)
+  if (__atomic_load_n(&ctx->detector_settings_version, __ATOMIC_ACQUIRE) == *version)
   {
-    return MAR_ERROR_AUGMENTATION_NOT_INITIALIZED;
+    return 0;
   }
 
-  return mar_camera_stop(camera_id);
+  pthread_mutex_lock(&ctx->reload_mutex);
+  *settings = ctx->detector_settings;
+  *version = ctx->detector_settings_version;
+  pthread_mutex_unlock(&ctx->reload_mutex);
+
+  return 1;
 }
 
 /**
- * Get's the Euclidian distance between two SIFT keypoints
+ * Configures the keypoint detector of a view with the latest detector settings, recreating its filters if its
+ * octaves changed.  Must only be called by the thread using the detector.  Settings which cannot be applied are
+ * not retried until the settings change again.
  *
- * @param k1 The first SIFT keypoint
- * @param k2 The second SIFT keypoint
- * 
- * @return The Euclidian distance between the two, equal to the sum of the difference between all descriptors
+ * @param v The view
+ *
+ * @return MAR_ERROR_NONE on success, an error code on failure.
  */
 MAR_PRIVATE
-float get_keypoint_difference(mar_sift_keypoint *k1, mar_sift_keypoint *k2)
+mar_error_code mar_augment_refresh_features(mar_augment_view *v)
 {
-  float diff = 0;
-  int i;
+  mar_augment_detector_settings settings;
+  mar_sift_ctx *sift;
+  mar_error_code mrv;
+
+  if (!mar_augment_get_detector_settings(v->ctx, &v->features_settings_version, &settings))
+  {
+    return MAR_ERROR_NONE;
+  }
+
+  if (v->ctx->feature_backend == MAR_FEATURES_ORB)
+  {
+    return mar_orb_ctx_set_fast_threshold(mar_features_ctx_get_orb(&v->features), settings.orb_fast_threshold);
+  }
 
-  // Calculate difference
-  for (i = 0; i < MAR_SIFT_NBO * MAR_SIFT_NBP * MAR_SIFT_NBP; i++)
+  sift = mar_features_ctx_get_sift(&v->features);
+  mrv = mar_sift_ctx_set_peak_threshold(sift, settings.sift_peak_threshold);
+  if (mrv == MAR_ERROR_NONE)
+  {
+    mrv = mar_sift_ctx_set_edge_threshold(sift, settings.sift_edge_threshold);
+  }
+  if (mrv == MAR_ERROR_NONE)
   {
-    diff += fabs(k1->descriptor[i] - k2->descriptor[i]);
+    mrv = mar_features_ctx_set_sift_octaves(&v->features, settings.sift_number_of_octaves, settings.sift_first_octave);
   }
 
-  return diff;
+  return mrv;
 }
 
 /**
- * Checks if a point is within an ellipse
+ * Configures the MSER detector of a view with the latest detector settings.  Must only be called by the thread
+ * using the detector.  Settings which cannot be applied are not retried until the settings change again.
  *
- * @param px The X coordinate of the point
- * @param py The Y coordinate of the point
- * @param ellipse_x The X coordinate of the ellipse
- * @param ellipse_y The Y coordinate of the ellipse
- * @param ellipse_a The semimajor axis of the ellipse
- * @param ellipse_b The semiminor axis of the ellipse
- * @param ellipse_angle The angle of the ellipse
+ * @param v The view
  *
- * @return 1 if the point is within the ellipse, otherwise 0
+ * @return MAR_ERROR_NONE on success, an error code on failure.
  */
 MAR_PRIVATE
-char is_point_in_ellipse(float px, float py, float ellipse_x, float ellipse_y, float ellipse_a, float ellipse_b, float ellipse_angle)
+mar_error_code mar_augment_refresh_mser(mar_augment_view *v)
 {
-  float x = (px-ellipse_x);
-  float y = (py-ellipse_y);
-  float beta = ellipse_angle * (ellipse_a > ellipse_b ? 1 : -1);
-  float sinbeta = sin(beta);
-  float cosbeta = cos(beta);
-  float rx = cosbeta * x - sinbeta * y;
-  float ry = sinbeta * x + cosbeta * y;
+  mar_augment_detector_settings settings;
+  mar_error_code mrv;
+
+  if (!mar_augment_get_detector_settings(v->ctx, &v->mser_settings_version, &settings))
+  {
+    return MAR_ERROR_NONE;
+  }
+
+  mrv = mar_mser_ctx_set_delta(&v->mser, settings.mser_delta);
+  if (mrv == MAR_ERROR_NONE)
+  {
+    mrv = mar_mser_ctx_set_min_area(&v->mser, settings.mser_min_area);
+  }
+  if (mrv == MAR_ERROR_NONE)
+  {
+    mrv = mar_mser_ctx_set_max_area(&v->mser, settings.mser_max_area);
+  }
+  if (mrv == MAR_ERROR_NONE)
+  {
+    mrv = mar_mser_ctx_set_min_diversity(&v->mser, settings.mser_min_diversity);
+  }
+  if (mrv == MAR_ERROR_NONE)
+  {
+    mrv = mar_mser_ctx_set_max_variation(&v->mser, settings.mser_max_variation);
+  }
 
-  return ((rx*rx)/(ellipse_a*ellipse_a*4))+((ry*ry)/(ellipse_b*ellipse_b*4)) < 1;
+  return mrv;
 }
 
 /**
- * Finds the best match between a given SIFT keypoints and a set of SIFT keypoints.
- * Also checks if the keypoint is distinguishable and unique by checking that it only strongly matches one
- * other keypoint and not multiple keypoints.
+ * Detects the SIFT keypoints of a pipeline frame and copies them into the frame.  No keypoints are detected
+ * when the frame was planned to be followed by optical flow.
  *
- * @param k The SIFT keypoint to match
- * @param keypoints An array of potentially matching keypoints
- * @param num_keypoints The number of keypoints and size of the array keypoints
- * @param best_difference Will be filled with the Euclidian distance of the keypoint k's descriptor and the best keypoint's descriptor
+ * @param v The view
+ * @param f The pipeline frame
  *
- * @return The index of the best match if the keypoint is distinguishable and unique, meaning that the keypoint matches only one keypoint strongly
+ * @return MAR_ERROR_NONE on success, an error code on failure.
  */
 MAR_PRIVATE
-int get_best_keypoint_match(mar_sift_keypoint *k, mar_sift_keypoint *keypoints, int num_keypoints, float *best_difference)
+mar_error_code mar_augment_detect_keypoints(mar_augment_view *v, mar_augment_frame *f)
 {
-  int i, best_i = -1;
-  float difference, best_diff = FLT_MAX, second_best_diff = 0;
-  
-  // Check the distance between all keypoints and find the best and second best
-  for (i = 0; i < num_keypoints; i++)
-  {
-    difference = get_keypoint_difference(k, &keypoints[i]);
+  mar_error_code mrv;
+  mar_sift_keypoint *keypoints, *new_keypoints;
+  int num_keypoints, skip;
+  uint64_t start;
 
-    if (difference < best_diff)
-    {
-      best_i = i;
-      second_best_diff = best_diff;
-      best_diff = difference;
-    }
-    else if (difference < second_best_diff)
-    {
-      second_best_diff = difference;
-    }
+  // The augmentations are followed by optical flow instead
+  if (f->skip_detection)
+  {
+    f->keypoints = NULL;
+    f->num_keypoints = 0;
+    f->full_frame = 0;
+    f->sift_calculated = 1;
+    return mar_keypoint_grid_build(&f->grid, NULL, 0);
   }
 
-  *best_difference = best_diff;
+  // Follow reloaded settings and the scales chosen by the governor, which are only changed by the thread using the detector
+  mrv = mar_augment_refresh_features(v);
+  if (mrv != MAR_ERROR_NONE)
+  {
+    return mrv;
+  }
+  skip = __atomic_load_n(&v->ctx->governor_octave_skip, __ATOMIC_RELAXED);
+  mrv = mar_features_ctx_set_scale_skip(&v->features, skip);
+  if (mrv != MAR_ERROR_NONE)
+  {
+    return mrv;
+  }
 
-  // Check that the match is unique
-  if (best_diff * MAR_UNIQUE_KEYPOINT_THRESHOLD <= second_best_diff)
+  start = mar_stats_now();
+  if (f->num_regions > 0)
   {
-    return best_i;
+    mrv = mar_features_ctx_get_keypoints_from_regions(&v->features, &keypoints, &num_keypoints, &f->pyramid, f->regions, f->num_regions);
   }
- 
-  return -1;
-}
+  else
+  {
+    mrv = mar_features_ctx_get_keypoints(&v->features, &keypoints, &num_keypoints, &f->pyramid);
+  }
+  if (mrv != MAR_ERROR_NONE)
+  {
+    return mrv;
+  }
+  mar_stats_histogram_add(&v->ctx->stage_latencies[MAR_AUGMENT_STAGE_SIFT], mar_stats_now() - start);
 
-/**
- * Starts the augmentation algorithm.
- *
- * @return MAR_ERROR_NONE on success, an error code on failure.
- */
-MAR_PUBLIC
-mar_error_code mar_start_augmentation()
-{
-  // Check if augmentation has not been initialized
-  if (!mar_augment_initialized)
+  // The detector's buffer is reused on the next detection, so keep a copy with the frame
+  new_keypoints = (mar_sift_keypoint *)mar_arena_alloc(&f->arena, num_keypoints * sizeof(mar_sift_keypoint));
+  if (new_keypoints == NULL)
   {
-    return MAR_ERROR_AUGMENTATION_NOT_INITIALIZED;
+    return MAR_ERROR_MALLOC;
   }
+  memcpy(new_keypoints, keypoints, num_keypoints * sizeof(mar_sift_keypoint));
+  f->keypoints = new_keypoints;
+  f->num_keypoints = num_keypoints;
 
-  mar_run_augmentation = 1;
+  // Bucket the keypoints once for every augmentation's containment queries
+  mrv = mar_keypoint_grid_build(&f->grid, f->keypoints, f->num_keypoints);
+  if (mrv != MAR_ERROR_NONE)
+  {
+    return mrv;
+  }
+  f->full_frame = f->num_regions == 0;
+  f->sift_calculated = 1;
 
   return MAR_ERROR_NONE;
 }
 
 /**
- * Stops the augmentation algorithm.
+ * Returns the transformation of an augmentation expected a number of frames after the last tracked frame.
+ * Without a motion model the last transformation is expected.
  *
- * @return MAR_ERROR_NONE on success, an error code on failure.
+ * @param ctx The augmentation context
+ * @param i The augmentation's ID
+ * @param frames The number of frames ahead
+ * @param predicted Will be filled with the expected transformation
  */
-MAR_PUBLIC
-mar_error_code mar_stop_augmentation()
+MAR_PRIVATE
+void mar_augment_predict_transform(mar_augment_ctx *ctx, int i, int frames, mar_affine *predicted)
 {
-  // Check if augmentation has not been initialized
-  if (!mar_augment_initialized)
+  if (ctx->motion_model)
   {
-    return MAR_ERROR_AUGMENTATION_NOT_INITIALIZED;
+    mar_motion_predict(&ctx->augmentations[i].motion, frames, ctx->motion_max_coast_frames, predicted);
+    return;
   }
 
-  mar_run_augmentation = 0;
-
-  return MAR_ERROR_NONE;
+  *predicted = ctx->augmentations[i].transform;
 }
 
 /**
- * Updates an augmentation frame
+ * Plans where the keypoints of a pipeline frame will be detected.  When following augmentations by optical flow,
+ * no keypoints are detected while every augmentation keeps enough inliers, up to a number of frames in a row.
+ * Keypoints are detected over the whole frame periodically, whenever an augmentation was lost in the last frame,
+ * whenever a new augmentation needs them and when there are more augmentations than MAR_SIFT_MAX_REGIONS.  Otherwise they are only detected within the bounding box of each
+ * augmentation's keypoints under its transformation predicted for the frame, padded to allow for motion which
+ * was not predicted.
+ * Must not be called while augmentations are being tracked.
  *
- * @return MAR_ERROR_NONE on success, an error code on failure.
- *
- * @todo Add unmatched SIFT keypoints after they appear consecutively so many times
- * @todo Try using all matched keypoints when calculating the transformation matrix
+ * @param v The view
+ * @param f The pipeline frame, which must not be being detected
  */
-MAR_PUBLIC
-mar_error_code mar_augment_update()
+MAR_PRIVATE
+void mar_augment_plan_detection(mar_augment_view *v, mar_augment_frame *f)
 {
-  mar_error_code mrv;
-  int i, j, k, l, m, num_keypoints, matched_keypoints;
-  float ox, oy, best_difference = 0, differences[MAR_MAX_NUM_OF_MATCHED_KEYPOINTS];
-  float x[MAR_MAX_NUM_OF_MATCHED_KEYPOINTS], y[MAR_MAX_NUM_OF_MATCHED_KEYPOINTS], u[MAR_MAX_NUM_OF_MATCHED_KEYPOINTS], v[MAR_MAX_NUM_OF_MATCHED_KEYPOINTS];
-  mar_sift_keypoint *contained_keypoints;
+  mar_augment_ctx *ctx = v->ctx;
+  int i, j, k, num_regions = 0;
+  float px, py, min_x, min_y, max_x, max_y, corner_x[4], corner_y[4];
+  mar_affine t;
 
-  // Check if augmentation has not been initialized
-  if (!mar_augment_initialized)
+  f->num_regions = 0;
+  f->skip_detection = 0;
+
+  // Check if every augmentation can be followed by optical flow
+  v->flow_frames_since_detection++;
+  if (ctx->flow_tracking && v->flow_previous_valid && ctx->run_augmentation && v->number_of_augmentations > 0 && 
+      !v->roi_force_full_frame && v->flow_frames_since_detection < ctx->flow_detection_interval)
   {
-    return MAR_ERROR_AUGMENTATION_NOT_INITIALIZED;
+    for (i = 0; i < ctx->augmentations_capacity; i++)
+    {
+      if (ctx->augmentations[i].initialized && ctx->augmentations[i].view == v->index &&
+          (ctx->augmentations[i].num_inliers < ctx->flow_min_inliers || ctx->augmentations[i].surface->num_flow_points == 0))
+      {
+        break;
+      }
+    }
+    if (i == ctx->augmentations_capacity)
+    {
+      f->skip_detection = 1;
+      return;
+    }
   }
+  v->flow_frames_since_detection = 0;
 
-  // Reset state variables
-  mar_mser_calculated_this_frame = 0;
-  mar_sift_calculated_this_frame = 0;
-
-  // Update the camera
-  mrv = mar_camera_update(camera_id);
-  if (mrv != MAR_ERROR_NONE)
+  // Check if the whole frame is due
+  v->roi_frames_since_full_frame++;
+  if (!ctx->roi_detection || !ctx->run_augmentation || v->number_of_augmentations == 0 || 
+      v->number_of_augmentations > MAR_SIFT_MAX_REGIONS || v->roi_force_full_frame || 
+      v->roi_frames_since_full_frame >= ctx->roi_full_frame_interval)
   {
-    return mrv;
+    v->roi_frames_since_full_frame = 0;
+    v->roi_force_full_frame = 0;
+    return;
   }
 
-  // Check if any augmentations exists
-  if (mar_run_augmentation)
+  for (i = 0; i < ctx->augmentations_capacity; i++)
   {
-    // Update the SIFT filter
-    mrv = mar_sift_get_keypoints(&mar_sift_keypoints, &mar_sift_num_keypoints, mar_camera_get_frame_buffer(camera_id));
-    if (mrv != MAR_ERROR_NONE)
+    if (!ctx->augmentations[i].initialized || ctx->augmentations[i].view != v->index)
     {
-      return mrv;
+      continue;
     }
-    mar_sift_calculated_this_frame = 1;
 
-    // Iterate through all possible augmentations
-    for (i = 0; i < MAR_MAX_NUMBER_OF_AUGMENTATIONS; i++)
+    // A lost augmentation could be anywhere in the frame
+    if (ctx->augmentations[i].num_inliers == 0)
     {
-      // Check if the augmentation exists
-      if (mar_augmentation_initialized[i])
-      {
-        // Find keypoints within the given ellipse
-        num_keypoints = 0;
-        for (j = 0; j < mar_sift_num_keypoints; j++)
-        {
-          mar_augment_untransform_point(i, mar_sift_keypoints[j].x, mar_sift_keypoints[j].y, &ox, &oy);
-          if (is_point_in_ellipse(ox, oy, mar_augmentations[i].mser.ellipse_x, mar_augmentations[i].mser.ellipse_y, 
-                mar_augmentations[i].mser.ellipse_a, mar_augmentations[i].mser.ellipse_b, mar_augmentations[i].mser.ellipse_angle))
-          {
-            ++num_keypoints;
-          }
-        }
-        
-        // Copy the keypoints within the ellipse to a buffer
-        contained_keypoints = (mar_sift_keypoint*)malloc(sizeof(mar_sift_keypoint) * num_keypoints);
-        num_keypoints = 0;
-        for (j = 0; j < mar_sift_num_keypoints; j++)
-        {
-          mar_augment_untransform_point(i, mar_sift_keypoints[j].x, mar_sift_keypoints[j].y, &ox, &oy);
-          if (is_point_in_ellipse(ox, oy, mar_augmentations[i].mser.ellipse_x, mar_augmentations[i].mser.ellipse_y, 
-                mar_augmentations[i].mser.ellipse_a, mar_augmentations[i].mser.ellipse_b, mar_augmentations[i].mser.ellipse_angle))
-          {
-            memcpy(&contained_keypoints[num_keypoints++], &mar_sift_keypoints[j], sizeof(mar_sift_keypoint));
-          }
-        }
+      v->roi_frames_since_full_frame = 0;
+      return;
+    }
 
-        // Initialize matching variables
-        matched_keypoints = 0;
-        for (j = 0; j < MAR_MAX_NUM_OF_MATCHED_KEYPOINTS; j++)
-        {
-          differences[j] = MAR_MAX_KEYPOINT_DIFFERENCE;
-        }
+    // Bound the augmentation's keypoints on its initial surface
+    min_x = max_x = ctx->augmentations[i].surface->initial_x[0];
+    min_y = max_y = ctx->augmentations[i].surface->initial_y[0];
+    for (j = 1; j < ctx->augmentations[i].surface->num_initial_keypoints; j++)
+    {
+      min_x = ctx->augmentations[i].surface->initial_x[j] < min_x ? ctx->augmentations[i].surface->initial_x[j] : min_x;
+      max_x = ctx->augmentations[i].surface->initial_x[j] > max_x ? ctx->augmentations[i].surface->initial_x[j] : max_x;
+      min_y = ctx->augmentations[i].surface->initial_y[j] < min_y ? ctx->augmentations[i].surface->initial_y[j] : min_y;
+      max_y = ctx->augmentations[i].surface->initial_y[j] > max_y ? ctx->augmentations[i].surface->initial_y[j] : max_y;
+    }
+    corner_x[0] = corner_x[2] = min_x;
+    corner_x[1] = corner_x[3] = max_x;
+    corner_y[0] = corner_y[1] = min_y;
+    corner_y[2] = corner_y[3] = max_y;
 
-        // Iterate through every keypoint within the ellipse
-        for (j = 0; j < num_keypoints; j++)
-        {
-          k = get_best_keypoint_match(&contained_keypoints[j], mar_augmentations[i].initial_keypoints, mar_augmentations[i].num_initial_keypoints, &best_difference);
-
-          // Check if the keypoint uniquely matched an initial keypoint
-          if (k != -1)
-          {
-            // Check if the match is one of the best matches so far
-            if (best_difference < differences[MAR_MAX_NUM_OF_MATCHED_KEYPOINTS-1])
-            {
-              ++matched_keypoints;
-
-              // Find which slot it should be placed in and place it there
-              for (l = 0; l < MAR_MAX_NUM_OF_MATCHED_KEYPOINTS; l++)
-              {
-                if (best_difference < differences[l])
-                {
-                  for (m = MAR_MAX_NUM_OF_MATCHED_KEYPOINTS-1; m > l; m--)
-                  {
-                    x[m] = x[m-1];
-                    y[m] = y[m-1];
-                    u[m] = u[m-1];
-                    v[m] = v[m-1];
-                    differences[m] = differences[m-1];
-                  }
-
-                  x[l] = mar_augmentations[i].initial_keypoints[k].x;
-                  y[l] = mar_augmentations[i].initial_keypoints[k].y;
-                  u[l] = contained_keypoints[j].x;
-                  v[l] = contained_keypoints[j].y;
-                  differences[l] = best_difference;
-                  
-                  break;
-                }
-              }
-            }
-          
-            // Update the initial keypoints descriptor to the most recent match of it
-            memcpy(mar_augmentations[i].initial_keypoints[k].descriptor, contained_keypoints[j].descriptor, 128);
-          }
-        }
+    // Bound the corners of the box under the transformation predicted for the frame, which is tracked after
+    // the frame being tracked now when pipelined
+    mar_augment_predict_transform(ctx, i, v->pipeline_running ? 2 : 1, &t);
+    for (k = 0; k < 4; k++)
+    {
+      px = t.a * corner_x[k] + t.b * corner_y[k] + t.tx;
+      py = t.c * corner_x[k] + t.d * corner_y[k] + t.ty;
+      if (k == 0)
+      {
+        min_x = max_x = px;
+        min_y = max_y = py;
+      }
+      min_x = px < min_x ? px : min_x;
+      max_x = px > max_x ? px : max_x;
+      min_y = py < min_y ? py : min_y;
+      max_y = py > max_y ? py : max_y;
+    }
 
-        // If we can't find them in the augmented MSER region, then look in the whole frame to refocus
-        if (matched_keypoints < MAR_MIN_NUM_OF_MATCHED_KEYPOINTS)
-        {
-          // Initialize matching variables
-          matched_keypoints = 0;
-          for (j = 0; j < MAR_MAX_NUM_OF_MATCHED_KEYPOINTS; j++)
-          {
-            differences[j] = MAR_MAX_KEYPOINT_DIFFERENCE;
-          }
-
-          // Iterate in all the keypoints within the frame
-          for (j = 0; j < mar_sift_num_keypoints; j++)
-          {
-            k = get_best_keypoint_match(&mar_sift_keypoints[j], mar_augmentations[i].initial_keypoints, mar_augmentations[i].num_initial_keypoints, &best_difference);
-
-            // Check if the keypoint uniquely matched an initial keypoint
-            if (k != -1)
-            {
-              // Check if the match is one of the best matches so far
-              if (best_difference < differences[MAR_MAX_NUM_OF_MATCHED_KEYPOINTS-1])
-              {
-                ++matched_keypoints;
-
-                // Find which slot it should be placed in and place it there
-                for (l = 0; l < MAR_MAX_NUM_OF_MATCHED_KEYPOINTS; l++)
-                {
-                  if (best_difference < differences[l])
-                  {
-                    for (m = MAR_MAX_NUM_OF_MATCHED_KEYPOINTS-1; m > l; m--)
-                    {
-                      x[m] = x[m-1];
-                      y[m] = y[m-1];
-                      u[m] = u[m-1];
-                      v[m] = v[m-1];
-                      differences[m] = differences[m-1];
-                    }
-
-                    x[l] = mar_augmentations[i].initial_keypoints[k].x;
-                    y[l] = mar_augmentations[i].initial_keypoints[k].y;
-                    u[l] = mar_sift_keypoints[j].x;
-                    v[l] = mar_sift_keypoints[j].y;
-                    differences[l] = best_difference;
-                    
-                    break;
-                  }
-                }
-              }
-            }
-          }
-        }
+    f->regions[num_regions].x = (int)floorf(min_x) - ctx->roi_padding;
+    f->regions[num_regions].y = (int)floorf(min_y) - ctx->roi_padding;
+    f->regions[num_regions].width = (int)ceilf(max_x - min_x) + 2*ctx->roi_padding;
+    f->regions[num_regions].height = (int)ceilf(max_y - min_y) + 2*ctx->roi_padding;
+    num_regions++;
+  }
 
-        // Free the buffer allocated for contained keypoints
-        free(contained_keypoints);
+  f->num_regions = num_regions;
+}
 
-        // Check if a sufficient number of keypoints has been matched
-        if (matched_keypoints >= MAR_MIN_NUM_OF_MATCHED_KEYPOINTS)
-        {
-          fmat A(matched_keypoints*2, 6);
-          fmat::fixed<6, 1> T;
-          fmat b(matched_keypoints*2, 1);
-          
-          // Try all possible matrices to find one with acceptable skew and scaling ratio
-          for (j = 0; j < matched_keypoints; j++)
-          {
-            // Fill in the initial matrix
-            A(j*2, 0) =     x[j];
-            A(j*2, 1) =     y[j];  
-            A(j*2, 2) =        0;
-            A(j*2, 3) =        0;  
-            A(j*2, 4) =        1;
-            A(j*2, 5) =        0;  
-            A(j*2+1, 0) =      0;
-            A(j*2+1, 1) =      0;  
-            A(j*2+1, 2) =   x[j];
-            A(j*2+1, 3) =   y[j];  
-            A(j*2+1, 4) =      0;
-            A(j*2+1, 5) =      1;
-    
-            // Fill in the transformed point matrix
-            b(j*2, 0) =   u[0+j];
-            b(j*2+1, 0) = v[0+j];
-          }
-
-          // Calculate and save transform
-          T = pinv(A)*b;
-
-          // Check that the skew is less than the maximum skew 
-          // Note that this doesn't account for a large positive skew on one axis and a large negative skew on the other
-          if (fabs(T(1, 0)+T(2, 0)) > MAR_AUGMENT_MAX_SKEW)
-          {
-            /// @todo set to a skew error code
-            mar_augmentation_successful[i] = MAR_ERROR_TOO_FEW_MATCHING_KEYPOINTS;
-            continue;
-          }
-
-          // Check that the scale difference is less than the maximum scale difference (scale ratio = fabs(scale_x - scale_y))
-          if (fabs(T(0, 0)-T(3, 0)) > MAR_AUGMENT_MAX_SCALE_RATIO)
-          {
-            /// @todo set to a scale error code
-            mar_augmentation_successful[i] = MAR_ERROR_TOO_FEW_MATCHING_KEYPOINTS;
-            continue;
-          }
-
-          // Set the transformation matrix
-          mar_augmentations[i].transform(0, 0) = T(0, 0);
-          mar_augmentations[i].transform(0, 1) = T(1, 0); 
-          mar_augmentations[i].transform(0, 2) = T(4, 0); 
-          mar_augmentations[i].transform(1, 0) = T(2, 0); 
-          mar_augmentations[i].transform(1, 1) = T(3, 0); 
-          mar_augmentations[i].transform(1, 2) = T(5, 0); 
-          mar_augmentations[i].transform(2, 0) = 0; 
-          mar_augmentations[i].transform(2, 1) = 0; 
-          mar_augmentations[i].transform(2, 2) = 1; 
-
-          // Mark augmentation as successful
-          mar_augmentation_successful[i] = MAR_ERROR_NONE;          
-          /// @todo: allow the ability to config whether or not to add points continue;
-
-          // Add new points
-          num_keypoints = 0;
-          for (j = 0; j < mar_sift_num_keypoints; j++)
-          {
-            mar_augment_untransform_point(i, mar_sift_keypoints[j].x, mar_sift_keypoints[j].y, &ox, &oy);
-            if (is_point_in_ellipse(ox, oy, mar_augmentations[i].mser.ellipse_x, mar_augmentations[i].mser.ellipse_y, 
-                  mar_augmentations[i].mser.ellipse_a, mar_augmentations[i].mser.ellipse_b, mar_augmentations[i].mser.ellipse_angle))
-            {
-              ++num_keypoints;
-            }
-          }
-
-          // Copy the keypoints within the ellipse to a buffer
-          contained_keypoints = (mar_sift_keypoint*)malloc(sizeof(mar_sift_keypoint) * num_keypoints);
-          num_keypoints = 0;
-          for (j = 0; j < mar_sift_num_keypoints; j++)
-          {
-            mar_augment_untransform_point(i, mar_sift_keypoints[j].x, mar_sift_keypoints[j].y, &ox, &oy);
-            if (is_point_in_ellipse(ox, oy, mar_augmentations[i].mser.ellipse_x, mar_augmentations[i].mser.ellipse_y, 
-                  mar_augmentations[i].mser.ellipse_a, mar_augmentations[i].mser.ellipse_b, mar_augmentations[i].mser.ellipse_angle))
-            {
-              memcpy(&contained_keypoints[num_keypoints++], &mar_sift_keypoints[j], sizeof(mar_sift_keypoint));
-            }
-          }
-
-          // Iterate through every keypoint within the ellipse
-          int new_potential_keypoints = 0;
-          for (j = 0; j < num_keypoints && new_potential_keypoints < MAR_MAX_NUMBER_OF_AUGMENTATION_KEYPOINTS; j++)
-          {
-            k = get_best_keypoint_match(&contained_keypoints[j], mar_augmentations[i].initial_keypoints, mar_augmentations[i].num_initial_keypoints, &best_difference);
-
-            // Check if the keypoint uniquely matched an initial keypoint
-            if (best_difference > MAR_MAX_KEYPOINT_DIFFERENCE)
-            {
-              k = get_best_keypoint_match(&contained_keypoints[j], mar_augmentations[i].potential_keypoints, mar_augmentations[i].num_potential_keypoints, &best_difference);
-
-              if (k != -1 && best_difference < MAR_MAX_KEYPOINT_DIFFERENCE)
-              {
-                memcpy(&mar_augmentations[i].initial_keypoints[mar_augmentations[i].new_keypoint_cursor], &contained_keypoints[j], sizeof(mar_sift_keypoint));
-                mar_augment_untransform_point(i, mar_augmentations[i].initial_keypoints[mar_augmentations[i].new_keypoint_cursor].x, 
-                  mar_augmentations[i].initial_keypoints[mar_augmentations[i].new_keypoint_cursor].y, &ox, &oy);
-                mar_augmentations[i].initial_keypoints[mar_augmentations[i].new_keypoint_cursor].x = ox;
-                mar_augmentations[i].initial_keypoints[mar_augmentations[i].new_keypoint_cursor].y = oy;
-                num_keypoints = num_keypoints >= MAR_MAX_NUMBER_OF_AUGMENTATION_KEYPOINTS ? MAR_MAX_NUMBER_OF_AUGMENTATION_KEYPOINTS : num_keypoints + 1;
-                mar_augmentations[i].new_keypoint_cursor = (mar_augmentations[i].new_keypoint_cursor + 1) % MAR_MAX_NUMBER_OF_AUGMENTATION_KEYPOINTS;
-              }
-            }
-            else
-            {
-              memcpy(&mar_augmentations[i].potential_keypoints[new_potential_keypoints++], &contained_keypoints[j], sizeof(mar_sift_keypoint));
-            }
-          }
-          mar_augmentations[i].num_potential_keypoints = new_potential_keypoints;
-
-          // Free the buffer allocated for contained keypoints
-          free(contained_keypoints);
-        }
-        else 
-        {
-          mar_augmentation_successful[i] = MAR_ERROR_TOO_FEW_MATCHING_KEYPOINTS;
-          continue;
-        }
+/**
+ * Returns the SIFT keypoints of the current frame detected over the whole frame.  When only regions of the frame
+ * or no keypoints were detected, they are detected again over the whole frame, or when pipelined the next frame planned is detected
+ * over the whole frame and the keypoints of the regions are returned.
+ *
+ * @param v The view
+ * @param keypoints A pointer to a pointer which will be modified to point to the array of keypoints.
+ * @param num_keypoints The number of SIFT keypoints
+ *
+ * @return MAR_ERROR_NONE on success, an error code on failure.
+ */
+MAR_PRIVATE
+mar_error_code mar_augment_get_full_frame_keypoints(mar_augment_view *v, mar_sift_keypoint **keypoints, int *num_keypoints)
+{
+  mar_error_code mrv;
+
+  if (v->current_frame != NULL && v->current_frame->sift_calculated && !v->current_frame->full_frame)
+  {
+    if (v->pipeline_running)
+    {
+      v->roi_force_full_frame = 1;
+    }
+    else
+    {
+      v->current_frame->num_regions = 0;
+      v->current_frame->skip_detection = 0;
+      mrv = mar_augment_detect_keypoints(v, v->current_frame);
+      if (mrv != MAR_ERROR_NONE)
+      {
+        return mrv;
+      }
+    }
+  }
+
+  return mar_augment_ctx_view_get_keypoints(v->ctx, v->index, keypoints, num_keypoints);
+}
+
+/**
+ * The detection thread of a view.  Captures frames and detects their SIFT keypoints ahead of the tracking done in
+ * mar_augment_update, filling the view's pipeline frames in order.  Each view has its own thread and detectors,
+ * so the cameras are detected concurrently.
+ *
+ * @param arg The mar_augment_view
+ *
+ * @return NULL
+ */
+MAR_PRIVATE
+void *mar_augment_pipeline_thread_main(void *arg)
+{
+  mar_augment_view *v = (mar_augment_view *)arg;
+  mar_augment_frame *f;
+
+  pthread_mutex_lock(&v->pipeline_mutex);
+  while (v->pipeline_running)
+  {
+    // Wait for the tracker to finish with the next frame in order
+    f = &v->frames[v->pipeline_detect_count % v->num_frames];
+    if (f->state != MAR_AUGMENT_FRAME_FREE)
+    {
+      pthread_cond_wait(&v->pipeline_cond, &v->pipeline_mutex);
+      continue;
+    }
+    f->state = MAR_AUGMENT_FRAME_DETECTING;
+    v->pipeline_detect_count++;
+    pthread_mutex_unlock(&v->pipeline_mutex);
+
+    // Keypoints are always detected since the tracker cannot run SIFT itself while this thread owns the filter
+    f->error = mar_augment_capture_frame(v, f);
+    if (f->error == MAR_ERROR_NONE)
+    {
+      f->error = mar_augment_detect_keypoints(v, f);
+    }
+
+    pthread_mutex_lock(&v->pipeline_mutex);
+    f->state = MAR_AUGMENT_FRAME_DETECTED;
+    pthread_cond_broadcast(&v->pipeline_cond);
+  }
+  pthread_mutex_unlock(&v->pipeline_mutex);
+
+  return NULL;
+}
+
+/**
+ * Stops the detection thread of a view if it is running and returns every camera lease held by the view's pipeline.
+ *
+ * @param v The view
+ */
+MAR_PRIVATE
+void mar_augment_stop_pipeline(mar_augment_view *v)
+{
+  if (v->pipeline_running)
+  {
+    pthread_mutex_lock(&v->pipeline_mutex);
+    v->pipeline_running = 0;
+    pthread_cond_broadcast(&v->pipeline_cond);
+    pthread_mutex_unlock(&v->pipeline_mutex);
+    pthread_join(v->pipeline_thread, NULL);
+  }
+
+  mar_augment_release_frames(v);
+}
+
+/**
+ * Scales MSER detected in a level of the image pyramid back to the full resolution frame.
+ *
+ * @param regions The regions
+ * @param num_regions The number of regions
+ * @param level The level the regions were detected in
+ */
+MAR_PRIVATE
+void mar_augment_scale_regions(mar_mser *regions, int num_regions, int level)
+{
+  int j;
+
+  for (j = 0; level > 0 && j < num_regions; j++)
+  {
+    regions[j].ellipse_x = (regions[j].ellipse_x + 0.5f) * (1 << level) - 0.5f;
+    regions[j].ellipse_y = (regions[j].ellipse_y + 0.5f) * (1 << level) - 0.5f;
+    regions[j].ellipse_a *= 1 << level;
+    regions[j].ellipse_b *= 1 << level;
+  }
+}
+
+/**
+ * The MSER thread of a view.  Detects MSER in the copy of a frame level handed to it by mar_augment_schedule_regions
+ * and writes them to the back result buffer, which is published at the start of a later update.  The tracking
+ * frames never wait for it, so asking for regions adds no time to them.
+ *
+ * @param arg The mar_augment_view
+ *
+ * @return NULL
+ */
+MAR_PRIVATE
+void *mar_augment_mser_thread_main(void *arg)
+{
+  mar_augment_view *v = (mar_augment_view *)arg;
+  mar_mser *regions, *grown;
+  mar_error_code mrv;
+  int num_regions, back;
+  uint64_t start;
+
+  pthread_mutex_lock(&v->mser_mutex);
+  while (v->mser_running)
+  {
+    if (!v->mser_job_pending)
+    {
+      pthread_cond_wait(&v->mser_cond, &v->mser_mutex);
+      continue;
+    }
+    back = !v->mser_front;
+    pthread_mutex_unlock(&v->mser_mutex);
+
+    // The job's image, the back buffer and the MSER filter belong to this thread until the job is finished
+    start = mar_stats_now();
+    num_regions = 0;
+    mrv = mar_augment_refresh_mser(v);
+    if (mrv == MAR_ERROR_NONE)
+    {
+      mrv = mar_mser_ctx_set_size(&v->mser, v->mser_image_width, v->mser_image_height);
+    }
+    if (mrv == MAR_ERROR_NONE)
+    {
+      mrv = mar_mser_ctx_get_regions_from_grayscale(&v->mser, &regions, &num_regions, v->mser_image, NULL);
+    }
+    if (mrv == MAR_ERROR_NONE && num_regions > v->mser_buffer_sizes[back])
+    {
+      grown = (mar_mser *)mar_realloc(v->mser_buffers[back], sizeof(mar_mser) * num_regions);
+      if (grown == NULL)
+      {
+        mrv = MAR_ERROR_MALLOC;
       }
+      else
+      {
+        v->mser_buffers[back] = grown;
+        v->mser_buffer_sizes[back] = num_regions;
+      }
+    }
+    if (mrv == MAR_ERROR_NONE)
+    {
+      memcpy(v->mser_buffers[back], regions, sizeof(mar_mser) * num_regions);
+      mar_augment_scale_regions(v->mser_buffers[back], num_regions, v->mser_image_level);
+      mar_stats_histogram_add(&v->ctx->stage_latencies[MAR_AUGMENT_STAGE_MSER], mar_stats_now() - start);
+    }
+
+    pthread_mutex_lock(&v->mser_mutex);
+    if (mrv == MAR_ERROR_NONE && !v->mser_job_cancelled)
+    {
+      v->mser_buffer_counts[back] = num_regions;
+      v->mser_back_ready = 1;
+    }
+    v->mser_error = mrv;
+    v->mser_job_pending = 0;
+    v->mser_job_cancelled = 0;
+    pthread_cond_broadcast(&v->mser_cond);
+  }
+  pthread_mutex_unlock(&v->mser_mutex);
+
+  return NULL;
+}
+
+/**
+ * Publishes the MSER the MSER thread of a view finished, and hands it the current frame when regions are still
+ * being asked for and enough updates have passed since the last job.  Once regions stop being asked for, the
+ * pending job is cancelled and no more are handed out.
+ *
+ * @param v The view
+ */
+MAR_PRIVATE
+void mar_augment_schedule_regions(mar_augment_view *v)
+{
+  mar_augment_ctx *ctx = v->ctx;
+  const unsigned char *gray;
+  int width, height;
+  char wanted;
+
+  if (!v->mser_running)
+  {
+    return;
+  }
+
+  pthread_mutex_lock(&v->mser_mutex);
+
+  // The regions returned before this update stay valid until now, since the thread only writes the back buffer
+  if (v->mser_back_ready)
+  {
+    v->mser_front = !v->mser_front;
+    v->mser_back_ready = 0;
+  }
+  v->mser_regions = v->mser_buffers[v->mser_front];
+  v->mser_num_regions = v->mser_buffer_counts[v->mser_front];
+
+  wanted = ctx->num_updates - v->mser_requested_update <= MAR_AUGMENT_MSER_IDLE_UPDATES;
+  if (!wanted && v->mser_job_pending)
+  {
+    v->mser_job_cancelled = 1;
+  }
+  else if (wanted && !v->mser_job_pending && v->current_frame != NULL && 
+      ctx->num_updates - v->mser_submitted_update >= (unsigned int)ctx->mser_interval)
+  {
+    // A level the frame has no image for is reported as the thread's error instead of handing out a job
+    gray = mar_image_pyramid_get_gray(&v->current_frame->pyramid, ctx->mser_level, &width, &height);
+    if (gray == NULL)
+    {
+      v->mser_error = MAR_ERROR_INVALID_ARGUMENT;
+    }
+    else
+    {
+      memcpy(v->mser_image, gray, width * height);
+      v->mser_image_width = width;
+      v->mser_image_height = height;
+      v->mser_image_level = ctx->mser_level;
+      v->mser_job_pending = 1;
+      v->mser_submitted_update = ctx->num_updates;
+      pthread_cond_broadcast(&v->mser_cond);
+    }
+  }
+
+  pthread_mutex_unlock(&v->mser_mutex);
+}
+
+/**
+ * Starts the MSER thread of a view if it is not running.
+ *
+ * @param v The view
+ *
+ * @return MAR_ERROR_NONE on success, an error code on failure.
+ */
+MAR_PRIVATE
+mar_error_code mar_augment_start_mser(mar_augment_view *v)
+{
+  if (v->mser_running)
+  {
+    return MAR_ERROR_NONE;
+  }
+
+  // Room for the full resolution level, so any level can be handed to the thread
+  if (v->mser_image == NULL)
+  {
+    v->mser_image = (unsigned char *)mar_malloc(v->frames[0].pyramid.width[0] * v->frames[0].pyramid.height[0]);
+    if (v->mser_image == NULL)
+    {
+      return MAR_ERROR_MALLOC;
+    }
+  }
+
+  v->mser_job_pending = 0;
+  v->mser_job_cancelled = 0;
+  v->mser_back_ready = 0;
+  v->mser_buffer_counts[0] = 0;
+  v->mser_buffer_counts[1] = 0;
+  v->mser_front = 0;
+  v->mser_error = MAR_ERROR_NONE;
+  v->mser_submitted_update = v->ctx->num_updates - v->ctx->mser_interval;
+  v->mser_running = 1;
+  if (pthread_create(&v->mser_thread, NULL, mar_augment_mser_thread_main, v) != 0)
+  {
+    v->mser_running = 0;
+    return MAR_ERROR_THREAD;
+  }
+
+  return MAR_ERROR_NONE;
+}
+
+/**
+ * Stops the MSER thread of a view if it is running, after it finishes its pending job.
+ *
+ * @param v The view
+ */
+MAR_PRIVATE
+void mar_augment_stop_mser(mar_augment_view *v)
+{
+  if (v->mser_running)
+  {
+    pthread_mutex_lock(&v->mser_mutex);
+    v->mser_running = 0;
+    v->mser_job_cancelled = 1;
+    pthread_cond_broadcast(&v->mser_cond);
+    pthread_mutex_unlock(&v->mser_mutex);
+    pthread_join(v->mser_thread, NULL);
+  }
+}
+
+/**
+ * Frees the camera, detectors and pipeline frames of a view, which may have only been partly created.  The view's
+ * detection and MSER threads must not be running.
+ *
+ * @param v The view
+ */
+MAR_PRIVATE
+void mar_augment_free_view(mar_augment_view *v)
+{
+  mar_augment_free_frames(v);
+  mar_image_pyramid_free(&v->flow_previous);
+  mar_mser_ctx_free(&v->mser);
+  mar_features_ctx_free(&v->features);
+  free(v->frame_rgb);
+  v->frame_rgb = NULL;
+  mar_free(v->mser_image);
+  mar_free(v->mser_buffers[0]);
+  mar_free(v->mser_buffers[1]);
+  v->mser_image = NULL;
+  v->mser_buffers[0] = NULL;
+  v->mser_buffers[1] = NULL;
+  if (v->camera_id != MAR_CAM_NO_CAMERA)
+  {
+    mar_camera_stop(v->camera_id);
+    mar_camera_free(v->camera_id);
+    v->camera_id = MAR_CAM_NO_CAMERA;
+  }
+  pthread_cond_destroy(&v->pipeline_cond);
+  pthread_mutex_destroy(&v->pipeline_mutex);
+  pthread_cond_destroy(&v->mser_cond);
+  pthread_mutex_destroy(&v->mser_mutex);
+}
+
+/**
+ * Creates a view, opening its camera and creating its own detectors and pipeline frames.  Each camera starts
+ * from the settings of the camera group, overridden by the settings of its entry in the cameras list.  The
+ * detectors of every view share the settings of the sift and mser groups.
+ *
+ * @param ctx The augmentation context
+ * @param v The view to create, freed with mar_augment_free_view even on failure
+ * @param index The index of the view
+ * @param camera The view's entry in the cameras list, or NULL to only use the camera group
+ * @param pyramid_levels The number of levels in the grayscale image pyramid of each frame
+ *
+ * @return MAR_ERROR_NONE on success, an error code on failure.
+ */
+MAR_PRIVATE
+mar_error_code mar_augment_new_view(mar_augment_ctx *ctx, mar_augment_view *v, int index, const config_setting_t *camera, int pyramid_levels)
+{
+  mar_error_code mrv;
+  int i;
+  int camera_type = MAR_CAM_DEFAULT_TYPE, 
+    camera_format = MAR_CAM_DEFAULT_FORMAT, 
+    camera_width = MAR_CAM_DEFAULT_WIDTH, 
+    camera_height = MAR_CAM_DEFAULT_HEIGHT, 
+    camera_capture_policy = MAR_CAM_DEFAULT_CAPTURE_POLICY,
+    sift_number_of_levels = MAR_SIFT_DEFAULT_NUMBER_OF_LEVELS, 
+    orb_number_of_levels = MAR_ORB_DEFAULT_NUMBER_OF_LEVELS,
+    orb_max_keypoints = MAR_ORB_DEFAULT_MAX_KEYPOINTS;
+  const char *camera_dev_name = MAR_CAM_DEFAULT_DEV_NAME;
+
+  MAR_CLEAR(*v);
+  v->ctx = ctx;
+  v->index = index;
+  v->camera_id = MAR_CAM_NO_CAMERA;
+  v->error = MAR_ERROR_NONE;
+  pthread_mutex_init(&v->pipeline_mutex, NULL);
+  pthread_cond_init(&v->pipeline_cond, NULL);
+  pthread_mutex_init(&v->mser_mutex, NULL);
+  pthread_cond_init(&v->mser_cond, NULL);
+
+  // Create camera
+  config_lookup_int(&ctx->cfg, "camera.camera_type", &camera_type);
+  config_lookup_string(&ctx->cfg, "camera.dev_name", &camera_dev_name);
+  config_lookup_int(&ctx->cfg, "camera.camera_format", &camera_format);
+  config_lookup_int(&ctx->cfg, "camera.camera_width", &camera_width);
+  config_lookup_int(&ctx->cfg, "camera.camera_height", &camera_height);
+  config_lookup_int(&ctx->cfg, "camera.capture_policy", &camera_capture_policy);
+  if (camera != NULL)
+  {
+    config_setting_lookup_int(camera, "camera_type", &camera_type);
+    config_setting_lookup_string(camera, "dev_name", &camera_dev_name);
+    config_setting_lookup_int(camera, "camera_format", &camera_format);
+    config_setting_lookup_int(camera, "camera_width", &camera_width);
+    config_setting_lookup_int(camera, "camera_height", &camera_height);
+    config_setting_lookup_int(camera, "capture_policy", &camera_capture_policy);
+  }
+  if (ctx->replay != NULL)
+  {
+    // Replay the frames the view captured, every one in order
+    mrv = mar_camera_new_replay(&v->camera_id, ctx->replay, index);
+    if (mrv == MAR_ERROR_NONE)
+    {
+      mar_camera_get_resolution(v->camera_id, &camera_width, &camera_height);
+    }
+    camera_capture_policy = MAR_CAM_CAPTURE_SYNCHRONOUS;
+  }
+  else
+  {
+    mrv = mar_camera_new(&v->camera_id, (mar_camera_type)camera_type, (char *)camera_dev_name, (mar_camera_format)camera_format, camera_width, camera_height);
+  }
+  if (mrv != MAR_ERROR_NONE)
+  {
+    v->camera_id = MAR_CAM_NO_CAMERA;
+    return mrv;
+  }
+
+  // Capture on a dedicated thread if requested
+  mrv = mar_camera_set_capture_policy(v->camera_id, (mar_camera_capture_policy)camera_capture_policy);
+  if (mrv != MAR_ERROR_NONE)
+  {
+    return mrv;
+  }
+
+  // Create the pipeline frames and color frame
+  v->num_frames = ctx->pipelined ? MAR_AUGMENT_PIPELINE_DEPTH : 1;
+  for (i = 0; i < v->num_frames; i++)
+  {
+    mrv = mar_image_pyramid_new(&v->frames[i].pyramid, camera_width, camera_height, pyramid_levels);
+    if (mrv == MAR_ERROR_NONE)
+    {
+      mrv = mar_keypoint_grid_new(&v->frames[i].grid, camera_width, camera_height, MAR_KEYPOINT_GRID_DEFAULT_CELL_SIZE);
+    }
+    if (mrv == MAR_ERROR_NONE)
+    {
+      mrv = mar_arena_new(&v->frames[i].arena, MAR_AUGMENT_FRAME_ARENA_SIZE);
+    }
+    if (mrv != MAR_ERROR_NONE)
+    {
+      return mrv;
+    }
+  }
+
+  v->frame_rgb = (unsigned char *)calloc(camera_width * camera_height, 3);
+  if (v->frame_rgb == NULL)
+  {
+    return MAR_ERROR_MALLOC;
+  }
+
+  // Create the MSER filter
+  mrv = mar_mser_ctx_new(&v->mser, camera_width, camera_height);
+  if (mrv != MAR_ERROR_NONE)
+  {
+    return mrv;
+  }
+
+  // Configure the MSER filter
+  mrv = mar_augment_refresh_mser(v);
+  if (mrv != MAR_ERROR_NONE)
+  {
+    return mrv;
+  }
+
+  if (ctx->feature_backend == MAR_FEATURES_ORB)
+  {
+    // Create the FAST and rotated BRIEF detector, which can only use the levels of the frame's image pyramid
+    config_lookup_int(&ctx->cfg, "orb.number_of_levels", &orb_number_of_levels);
+    config_lookup_int(&ctx->cfg, "orb.max_keypoints", &orb_max_keypoints);
+    mrv = mar_features_ctx_new_orb(&v->features, camera_width, camera_height, 
+        orb_number_of_levels < v->frames[0].pyramid.num_levels ? orb_number_of_levels : v->frames[0].pyramid.num_levels,
+        ctx->detector_settings.orb_fast_threshold, orb_max_keypoints);
+    if (mrv != MAR_ERROR_NONE)
+    {
+      return mrv;
+    }
+  }
+  else
+  {
+    // Create the SIFT filter
+    config_lookup_int(&ctx->cfg, "sift.number_of_levels", &sift_number_of_levels);
+    mrv = mar_features_ctx_new_sift(&v->features, camera_width, camera_height, ctx->detector_settings.sift_number_of_octaves, 
+        sift_number_of_levels, ctx->detector_settings.sift_first_octave);
+    if (mrv != MAR_ERROR_NONE)
+    {
+      return mrv;
+    }
+  }
+
+  // Configure the keypoint detector's thresholds
+  mrv = mar_augment_refresh_features(v);
+  if (mrv != MAR_ERROR_NONE)
+  {
+    return mrv;
+  }
+
+  // Keep the last tracked frame for following augmentations by optical flow
+  if (ctx->flow_tracking)
+  {
+    mrv = mar_image_pyramid_new(&v->flow_previous, camera_width, camera_height, pyramid_levels);
+    if (mrv != MAR_ERROR_NONE)
+    {
+      return mrv;
+    }
+  }
+
+  return MAR_ERROR_NONE;
+}
+
+/**
+ * Starts recording a session into the capture log named by augment.record, beginning with the configuration.
+ *
+ * @param ctx The augmentation context, whose recorder is left NULL when the session is not recorded
+ * @param filename The filename of the configuration file, NULL for default settings
+ *
+ * @return MAR_ERROR_NONE on success, an error code on failure.
+ */
+MAR_PRIVATE
+mar_error_code mar_augment_start_recording(mar_augment_ctx *ctx, const char *filename)
+{
+  const char *record = NULL;
+  mar_error_code mrv;
+  char *config = NULL;
+  long length = 0;
+  FILE *file;
+
+  config_lookup_string(&ctx->cfg, "augment.record", &record);
+  if (record == NULL || record[0] == '\0')
+  {
+    return MAR_ERROR_NONE;
+  }
+
+  // Keep the configuration exactly as it was read
+  if (filename != NULL)
+  {
+    file = fopen(filename, "rb");
+    if (file == NULL)
+    {
+      return MAR_ERROR_READING_CONFIG;
+    }
+    if (fseek(file, 0, SEEK_END) == 0 && (length = ftell(file)) >= 0 && fseek(file, 0, SEEK_SET) == 0)
+    {
+      config = (char *)mar_malloc(length > 0 ? length : 1);
+    }
+    if (config == NULL || fread(config, 1, length, file) != (size_t)length)
+    {
+      mar_free(config);
+      fclose(file);
+      return config == NULL ? MAR_ERROR_MALLOC : MAR_ERROR_READING_CONFIG;
+    }
+    fclose(file);
+  }
+
+  mrv = mar_capture_log_writer_new(&ctx->recorder, record);
+  if (mrv == MAR_ERROR_NONE)
+  {
+    mrv = mar_capture_log_write_config(ctx->recorder, config != NULL ? config : "", length);
+    if (mrv != MAR_ERROR_NONE)
+    {
+      mar_capture_log_writer_free(ctx->recorder);
+    }
+  }
+  if (mrv != MAR_ERROR_NONE)
+  {
+    ctx->recorder = NULL;
+  }
+  mar_free(config);
+
+  return mrv;
+}
+
+/**
+ * Records a call made to the augmentation, to be made again before the same update when the session is replayed.
+ * A call which cannot be recorded only leaves the log incomplete, which is reported when the log is finished.
+ *
+ * @param ctx The augmentation context
+ * @param type The \ref capture_log_events "event type"
+ * @param view The view of a new augmentation
+ * @param id The ID of a new or freed augmentation
+ * @param error The error returned by the call
+ * @param region The MSER of a new augmentation, or NULL
+ */
+MAR_PRIVATE
+void mar_augment_record_event(mar_augment_ctx *ctx, uint32_t type, int view, int id, mar_error_code error, const mar_mser *region)
+{
+  mar_capture_log_event event;
+
+  if (ctx->recorder == NULL)
+  {
+    return;
+  }
+
+  MAR_CLEAR(event);
+  event.type = type;
+  event.update = ctx->num_updates;
+  event.view = view;
+  event.id = id;
+  event.error = error;
+  if (region != NULL)
+  {
+    event.ellipse_x = region->ellipse_x;
+    event.ellipse_y = region->ellipse_y;
+    event.ellipse_a = region->ellipse_a;
+    event.ellipse_b = region->ellipse_b;
+    event.ellipse_angle = region->ellipse_angle;
+  }
+  mar_capture_log_write_event(ctx->recorder, &event);
+}
+
+/**
+ * Creates an augmentation context from a loaded configuration, or the configuration of a replayed log.
+ *
+ * @param ctx Will be filled with the context, freed with mar_augment_ctx_free
+ * @param filename The filename of the configuration file, NULL for default settings, ignored when replaying
+ * @param replay The log to replay, owned by the context once it is created, or NULL to open the configured cameras
+ *
+ * @return MAR_ERROR_NONE on success, an error code on failure.
+ */
+MAR_PRIVATE
+mar_error_code mar_augment_ctx_create(mar_augment_ctx **ctx_out, char *filename, mar_capture_log *replay)
+{
+  mar_augment_ctx *ctx;
+  mar_error_code mrv;
+  int i, num_views, num_models;
+  int pyramid_levels = MAR_AUGMENT_DEFAULT_PYRAMID_LEVELS,
+    pipelined = MAR_AUGMENT_DEFAULT_PIPELINED,
+    tracking_threads = MAR_AUGMENT_DEFAULT_TRACKING_THREADS,
+    quantized_descriptors = MAR_KEYPOINT_INDEX_DEFAULT_QUANTIZED,
+    flow_tracking = MAR_AUGMENT_DEFAULT_FLOW_TRACKING,
+    governor = MAR_AUGMENT_DEFAULT_GOVERNOR,
+    feature_backend = MAR_FEATURES_DEFAULT_BACKEND,
+    mser_background = MAR_AUGMENT_DEFAULT_MSER_BACKGROUND;
+  config_setting_t *cameras;
+
+  *ctx_out = NULL;
+  ctx = (mar_augment_ctx *)mar_calloc(1, sizeof(mar_augment_ctx));
+  if (ctx == NULL)
+  {
+    return MAR_ERROR_MALLOC;
+  }
+  ctx->augmentations_free = -1;
+  ctx->replay = replay;
+  pthread_mutex_init(&ctx->snapshot_mutex, NULL);
+  pthread_mutex_init(&ctx->reload_mutex, NULL);
+
+  config_init(&ctx->cfg);
+
+  // Load the config file, or the config the replayed session was recorded with
+  if (replay != NULL)
+  {
+    if (!config_read_string(&ctx->cfg, replay->config != NULL ? replay->config : ""))
+    {
+        fprintf(stderr, "%d - %s\n", config_error_line(&ctx->cfg), config_error_text(&ctx->cfg));
+        config_destroy(&ctx->cfg);
+        mar_free(ctx);
+        return MAR_ERROR_READING_CONFIG;
+    }
+  }
+  else if (filename != NULL)
+  {
+    if (!config_read_file(&ctx->cfg, filename)) 
+    {
+        fprintf(stderr, "%s:%d - %s\n", config_error_file(&ctx->cfg), config_error_line(&ctx->cfg), config_error_text(&ctx->cfg));
+        config_destroy(&ctx->cfg);
+        mar_free(ctx);
+        return MAR_ERROR_READING_CONFIG;
+    }
+  }
+
+  // Configure the pipeline of every view
+  config_lookup_int(&ctx->cfg, "augment.pyramid_levels", &pyramid_levels);
+  config_lookup_bool(&ctx->cfg, "augment.pipelined", &pipelined);
+  ctx->pipelined = pipelined;
+
+  // Configure the keypoint indices of new augmentations
+  ctx->index_trees = MAR_KEYPOINT_INDEX_DEFAULT_NUMBER_OF_TREES;
+  ctx->index_max_comparisons = MAR_KEYPOINT_INDEX_DEFAULT_MAX_COMPARISONS;
+  config_lookup_int(&ctx->cfg, "augment.index_trees", &ctx->index_trees);
+  config_lookup_int(&ctx->cfg, "augment.index_max_comparisons", &ctx->index_max_comparisons);
+  config_lookup_bool(&ctx->cfg, "augment.quantized_descriptors", &quantized_descriptors);
+
+  // Binary descriptors are matched by Hamming distance, so they need their own index and thresholds
+  config_lookup_int(&ctx->cfg, "augment.feature_backend", &feature_backend);
+  if (feature_backend == MAR_FEATURES_ORB)
+  {
+    ctx->feature_backend = MAR_FEATURES_ORB;
+    ctx->index_format = MAR_KEYPOINT_INDEX_BINARY;
+    ctx->max_keypoint_difference = MAR_ORB_MAX_DIFFERENCE;
+    ctx->unique_keypoint_threshold = MAR_ORB_UNIQUE_KEYPOINT_THRESHOLD;
+  }
+  else
+  {
+    ctx->feature_backend = MAR_FEATURES_SIFT;
+    ctx->index_format = quantized_descriptors ? MAR_KEYPOINT_INDEX_QUANTIZED : MAR_KEYPOINT_INDEX_FLOAT;
+    ctx->max_keypoint_difference = MAR_MAX_KEYPOINT_DIFFERENCE;
+    ctx->unique_keypoint_threshold = MAR_UNIQUE_KEYPOINT_THRESHOLD;
+  }
+
+  // Configure the detector settings which may also be reloaded while the pipeline runs
+  mar_augment_read_detector_settings(&ctx->cfg, &ctx->detector_settings);
+  ctx->detector_settings_version = 1;
+
+  // Configure following augmentations by optical flow, which needs the previous frame kept by every view
+  config_lookup_bool(&ctx->cfg, "augment.flow_tracking", &flow_tracking);
+  ctx->flow_tracking = flow_tracking;
+
+  // Configure scaling the detectors to the frame budget, which a replay must not do to reproduce its recording
+  config_lookup_bool(&ctx->cfg, "augment.governor", &governor);
+  ctx->governor = governor && replay == NULL;
+
+  // Configure detecting MSER, which are only needed while a surface is being chosen
+  config_lookup_bool(&ctx->cfg, "augment.mser_background", &mser_background);
+  ctx->mser_background = mser_background;
+
+  // Create a view for each camera
+  cameras = config_lookup(&ctx->cfg, "cameras");
+  num_views = cameras != NULL ? config_setting_length(cameras) : 1;
+  if (num_views < 1 || num_views > MAR_AUGMENT_MAX_NUM_VIEWS)
+  {
+    config_destroy(&ctx->cfg);
+    mar_free(ctx);
+    return MAR_ERROR_NO_CAMERAS_AVAILABLE;
+  }
+  for (ctx->num_views = 0; ctx->num_views < num_views; ctx->num_views++)
+  {
+    mrv = mar_augment_new_view(ctx, &ctx->views[ctx->num_views], ctx->num_views, 
+        cameras != NULL ? config_setting_get_elem(cameras, ctx->num_views) : NULL, pyramid_levels);
+    if (mrv != MAR_ERROR_NONE)
+    {
+      for (i = 0; i <= ctx->num_views; i++)
+      {
+        mar_augment_free_view(&ctx->views[i]);
+      }
+      config_destroy(&ctx->cfg);
+      mar_free(ctx);
+      return mrv;
+    }
+  }
+
+  // Configure the tracking settings which may also be reloaded while the pipeline runs, whose pyramid levels must
+  // exist in every view since an image pyramid stops early for small frames
+  ctx->pyramid_levels = MAR_IMAGE_PYRAMID_MAX_LEVELS;
+  for (i = 0; i < ctx->num_views; i++)
+  {
+    if (ctx->views[i].frames[0].pyramid.num_levels < ctx->pyramid_levels)
+    {
+      ctx->pyramid_levels = ctx->views[i].frames[0].pyramid.num_levels;
+    }
+  }
+  mar_augment_configure_tracking(ctx, &ctx->cfg);
+
+  // Create the tracking threads
+  config_lookup_int(&ctx->cfg, "augment.tracking_threads", &tracking_threads);
+  ctx->tracking_pool = NULL;
+  if (tracking_threads != 1)
+  {
+    mrv = mar_thread_pool_new(&ctx->tracking_pool, tracking_threads);
+    if (mrv != MAR_ERROR_NONE)
+    {
+      for (i = 0; i < ctx->num_views; i++)
+      {
+        mar_augment_free_view(&ctx->views[i]);
+      }
+      config_destroy(&ctx->cfg);
+      mar_free(ctx);
+      return mrv;
+    }
+  }
+
+  // Record the session if requested, which a replayed session never is
+  if (replay == NULL)
+  {
+    mrv = mar_augment_start_recording(ctx, filename);
+    if (mrv != MAR_ERROR_NONE)
+    {
+      mar_augment_ctx_free(ctx);
+      return mrv;
+    }
+  }
+
+  // Load the models saved by the last session, which a replayed or recorded session neither loads nor saves since loading is not a recorded call
+  if (replay == NULL && ctx->recorder == NULL)
+  {
+    config_lookup_string(&ctx->cfg, "augment.model_cache", &ctx->model_cache);
+    if (ctx->model_cache != NULL && ctx->model_cache[0] == '\0')
+    {
+      ctx->model_cache = NULL;
+    }
+  }
+  if (ctx->model_cache != NULL)
+  {
+    // A missing cache is expected before the first session saves one, any other failure keeps the cache from being overwritten
+    mrv = mar_augment_ctx_load_models(ctx, ctx->model_cache, NULL, 0, &num_models);
+    if (mrv == MAR_ERROR_NONE || mrv == MAR_ERROR_MODEL_CACHE_NOT_FOUND)
+    {
+      ctx->model_cache_loaded = 1;
+    }
+    else
+    {
+      mar_print_error(mrv);
+    }
+  }
+
+  *ctx_out = ctx;
+
+  return MAR_ERROR_NONE;
+}
+
+/**
+ * Creates an augmentation context using a configuration file.  Every entry of the cameras list is opened as a view
+ * with its own detectors, or only the camera group when there is no cameras list.  Contexts share no state, so
+ * each may be updated on its own thread, but the cameras of every context come from the same MAR_CAM_MAX_NUM_CAMERAS.
+ * When augment.record names a file, the configuration, every captured frame and every call made to the context
+ * are recorded into it as a capture log.  When augment.model_cache names a file and the session is not recorded,
+ * the augmentations saved to it by the last session are loaded, and once the cache has been loaded or found not
+ * to exist yet the augmentations are saved to it when the context is freed.
+ *
+ * @param ctx Will be filled with the context, freed with mar_augment_ctx_free
+ * @param filename The filename of the configuration file, NULL for default settings
+ *
+ * @return MAR_ERROR_NONE on success, an error code on failure.
+ */
+MAR_PUBLIC
+mar_error_code mar_augment_ctx_new(mar_augment_ctx **ctx_out, char *filename)
+{
+  return mar_augment_ctx_create(ctx_out, filename, NULL);
+}
+
+/**
+ * Creates an augmentation context replaying a recorded capture log.  The context is configured as the recorded one
+ * was, each view replays the frames its camera captured, and the recorded calls which created and freed augmentations
+ * or started and stopped augmentation are made again before the same updates, so the same results are computed
+ * bit-exactly by the same build.  Those calls must not be made by the caller.
+ *
+ * @param ctx Will be filled with the context, freed with mar_augment_ctx_free
+ * @param log_file The filename of the capture log
+ *
+ * @return MAR_ERROR_NONE on success, an error code on failure.
+ */
+MAR_PUBLIC
+mar_error_code mar_augment_ctx_new_replay(mar_augment_ctx **ctx_out, const char *log_file)
+{
+  mar_capture_log *log;
+  mar_error_code mrv;
+
+  *ctx_out = NULL;
+  mrv = mar_capture_log_open(&log, log_file);
+  if (mrv != MAR_ERROR_NONE)
+  {
+    return mrv;
+  }
+
+  mrv = mar_augment_ctx_create(ctx_out, NULL, log);
+  if (mrv != MAR_ERROR_NONE)
+  {
+    mar_capture_log_free(log);
+  }
+
+  return mrv;
+}
+
+/**
+ * Initializes augmentation using a configuration file.  Every entry of the cameras list is opened as a view with
+ * its own detectors, or only the camera group when there is no cameras list.
+ *
+ * @param filename The filename of the configuration file, NULL for default settings
+ *
+ * @return MAR_ERROR_NONE on success, an error code on failure.
+ */
+MAR_PUBLIC
+mar_error_code mar_augment_init(char *filename)
+{
+  // Check if augmentation has already been initialized
+  if (mar_augment_default_ctx != NULL)
+  {
+    return MAR_ERROR_AUGMENTATION_ALREADY_INITIALIZED;
+  }
+
+  return mar_augment_ctx_new(&mar_augment_default_ctx, filename);
+}
+
+/**
+ * Initializes augmentation using default settings
+ *
+ * @return MAR_ERROR_NONE on success, an error code on failure.
+ */
+MAR_PUBLIC
+mar_error_code mar_augment_init_from_defaults()
+{
+  return mar_augment_init(NULL);
+}
+
+/**
+ * Initializes augmentation replaying a recorded capture log, as mar_augment_ctx_new_replay.
+ *
+ * @param log_file The filename of the capture log
+ *
+ * @return MAR_ERROR_NONE on success, an error code on failure.
+ */
+MAR_PUBLIC
+mar_error_code mar_augment_init_replay(const char *log_file)
+{
+  // Check if augmentation has already been initialized
+  if (mar_augment_default_ctx != NULL)
+  {
+    return MAR_ERROR_AUGMENTATION_ALREADY_INITIALIZED;
+  }
+
+  return mar_augment_ctx_new_replay(&mar_augment_default_ctx, log_file);
+}
+
+/**
+ * Reloads the configuration file of a context, to be applied before the next update without recreating the
+ * pipeline or losing any augmentation.  The MSER and SIFT thresholds, the SIFT octaves, the FAST threshold and
+ * every augment setting read each update, such as the RANSAC, ROI detection, motion model, optical flow,
+ * governor limits and MSER interval and level settings, are changed.  Each detector is changed by the thread
+ * using it before its next detection, and SIFT filters are recreated there when their octaves change.  Settings
+ * missing from the file return to their defaults.  The cameras, image pyramid, feature backend, descriptor
+ * format, keypoint indices, threads and the settings enabling optical flow, the governor, background MSER,
+ * recording and the model cache only change when a new context is created.  A capture log keeps the
+ * configuration the session started with.  May be called from any thread while the context is being updated.
+ *
+ * @param ctx The augmentation context
+ * @param filename The filename of the configuration file
+ *
+ * @return MAR_ERROR_NONE on success, MAR_ERROR_READING_CONFIG if the file could not be read, in which case the
+ *         configuration is unchanged, an error code on failure.  A setting which cannot be applied to a detector
+ *         is reported as the error of the next update of its view.
+ */
+MAR_PUBLIC
+mar_error_code mar_augment_ctx_reload_config(mar_augment_ctx *ctx, const char *filename)
+{
+  config_t *cfg, *previous;
+
+  // Check if augmentation has not been initialized
+  if (ctx == NULL)
+  {
+    return MAR_ERROR_AUGMENTATION_NOT_INITIALIZED;
+  }
+
+  // Parse on the calling thread so that the update only copies the settings
+  cfg = (config_t *)mar_malloc(sizeof(config_t));
+  if (cfg == NULL)
+  {
+    return MAR_ERROR_MALLOC;
+  }
+  config_init(cfg);
+  if (!config_read_file(cfg, filename))
+  {
+    fprintf(stderr, "%s:%d - %s\n", config_error_file(cfg), config_error_line(cfg), config_error_text(cfg));
+    config_destroy(cfg);
+    mar_free(cfg);
+    return MAR_ERROR_READING_CONFIG;
+  }
+
+  // Replace a configuration reloaded since the last update, only the latest one is applied
+  pthread_mutex_lock(&ctx->reload_mutex);
+  previous = ctx->reload_cfg;
+  __atomic_store_n(&ctx->reload_cfg, cfg, __ATOMIC_RELEASE);
+  pthread_mutex_unlock(&ctx->reload_mutex);
+  if (previous != NULL)
+  {
+    config_destroy(previous);
+    mar_free(previous);
+  }
+
+  return MAR_ERROR_NONE;
+}
+
+/**
+ * Reloads the configuration file of the augmentation, as mar_augment_ctx_reload_config.
+ *
+ * @param filename The filename of the configuration file
+ *
+ * @return MAR_ERROR_NONE on success, MAR_ERROR_READING_CONFIG if the file could not be read, in which case the
+ *         configuration is unchanged, an error code on failure.
+ */
+MAR_PUBLIC
+mar_error_code mar_augment_reload_config(const char *filename)
+{
+  return mar_augment_ctx_reload_config(mar_augment_default_ctx, filename);
+}
+
+/**
+ * Starts the augmentation cameras, and the detection thread of each view when pipelined
+ *
+ * @param ctx The augmentation context
+ *
+ * @return MAR_ERROR_NONE on success, an error code on failure.
+ */
+MAR_PUBLIC
+mar_error_code mar_augment_ctx_start_capture(mar_augment_ctx *ctx)
+{
+  mar_error_code mrv;
+  mar_augment_view *v;
+  int i;
+
+  // Check if augmentation has not been initialized
+  if (ctx == NULL)
+  {
+    return MAR_ERROR_AUGMENTATION_NOT_INITIALIZED;
+  }
+
+  for (i = 0; i < ctx->num_views; i++)
+  {
+    v = &ctx->views[i];
+    mrv = mar_camera_start(v->camera_id);
+    if (mrv == MAR_ERROR_NONE && ctx->pipelined && !v->pipeline_running)
+    {
+      // Start detecting frames ahead of the tracker
+      mar_augment_release_frames(v);
+      v->pipeline_detect_count = 0;
+      v->pipeline_track_count = 0;
+      v->pipeline_running = 1;
+      if (pthread_create(&v->pipeline_thread, NULL, mar_augment_pipeline_thread_main, v) != 0)
+      {
+        v->pipeline_running = 0;
+        mar_camera_stop(v->camera_id);
+        mrv = MAR_ERROR_THREAD;
+      }
+    }
+
+    // Leave no camera of the rig capturing when one fails
+    if (mrv != MAR_ERROR_NONE)
+    {
+      while (--i >= 0)
+      {
+        mar_augment_stop_pipeline(&ctx->views[i]);
+        mar_camera_stop(ctx->views[i].camera_id);
+      }
+      return mrv;
+    }
+  }
+
+  return MAR_ERROR_NONE;
+}
+
+/**
+ * Starts the augmentation cameras, and the detection thread of each view when pipelined
+ *
+ * @return MAR_ERROR_NONE on success, an error code on failure.
+ */
+MAR_PUBLIC
+mar_error_code mar_start_capture()
+{
+  return mar_augment_ctx_start_capture(mar_augment_default_ctx);
+}
+
+/**
+ * Stops the augmentation cameras
+ *
+ * @param ctx The augmentation context
+ *
+ * @return MAR_ERROR_NONE on success, an error code on failure.
+ */
+MAR_PUBLIC
+mar_error_code mar_augment_ctx_stop_capture(mar_augment_ctx *ctx)
+{
+  mar_error_code mrv, retval = MAR_ERROR_NONE;
+  int i;
+
+  // Check if augmentation has not been initialized
+  if (ctx == NULL)
+  {
+    return MAR_ERROR_AUGMENTATION_NOT_INITIALIZED;
+  }
+
+  for (i = 0; i < ctx->num_views; i++)
+  {
+    // Return the leased frames before the camera takes its buffers back
+    mar_augment_stop_pipeline(&ctx->views[i]);
+    mrv = mar_camera_stop(ctx->views[i].camera_id);
+    retval = retval == MAR_ERROR_NONE ? mrv : retval;
+  }
+
+  return retval;
+}
+
+/**
+ * Stops the augmentation cameras
+ *
+ * @return MAR_ERROR_NONE on success, an error code on failure.
+ */
+MAR_PUBLIC
+mar_error_code mar_stop_capture()
+{
+  return mar_augment_ctx_stop_capture(mar_augment_default_ctx);
+}
+
+/**
+ * Gets the transformation which maps an ellipse onto the unit circle, for finding the points within the ellipse.
+ *
+ * @param ellipse_x The X coordinate of the center of the ellipse
+ * @param ellipse_y The Y coordinate of the center of the ellipse
+ * @param ellipse_a The length of the ellipse's major axis
+ * @param ellipse_b The length of the ellipse's minor axis
+ * @param ellipse_angle The angle of the ellipse's major axis
+ * @param ellipse Will be filled with the transformation
+ */
+MAR_PRIVATE
+void mar_augment_get_ellipse(float ellipse_x, float ellipse_y, float ellipse_a, float ellipse_b, float ellipse_angle, mar_affine *ellipse)
+{
+  float beta = ellipse_angle * (ellipse_a > ellipse_b ? 1 : -1);
+  float sinbeta = sin(beta);
+  float cosbeta = cos(beta);
+
+  // Rotate onto the axes, then scale each axis by twice its length
+  ellipse->a = cosbeta / (2*ellipse_a);
+  ellipse->b = -sinbeta / (2*ellipse_a);
+  ellipse->c = sinbeta / (2*ellipse_b);
+  ellipse->d = cosbeta / (2*ellipse_b);
+  ellipse->tx = -(ellipse->a * ellipse_x + ellipse->b * ellipse_y);
+  ellipse->ty = -(ellipse->c * ellipse_x + ellipse->d * ellipse_y);
+}
+
+/**
+ * Gets the transformation which maps an augmentation's ellipse in the latest frame onto the unit circle.  The initial
+ * keypoints are normalized by the MSER's center and mean axis, so the ellipse is normalized the same way on the
+ * initial surface and then mapped to the frame through the augmentation's inverse transformation.
+ *
+ * @param ctx The augmentation context
+ * @param i The augmentation's ID
+ * @param ellipse Will be filled with the transformation
+ */
+MAR_PRIVATE
+void mar_augment_get_surface_ellipse(mar_augment_ctx *ctx, int i, mar_affine *ellipse)
+{
+  const mar_mser *mser = &ctx->augmentations[i].mser;
+  float scale = (mser->ellipse_a + mser->ellipse_b) / 2;
+  mar_affine surface_ellipse;
+
+  mar_augment_get_ellipse(0, 0, mser->ellipse_a / scale, mser->ellipse_b / scale, mser->ellipse_angle, &surface_ellipse);
+  mar_affine_compose(&ctx->augmentations[i].transform_inverse, &surface_ellipse, ellipse);
+}
+
+/**
+ * Finds the best match between a given SIFT keypoint and the keypoints of a keypoint index.
+ * Also checks if the keypoint is distinguishable and unique by checking that it only strongly matches one
+ * other keypoint and not multiple keypoints.
+ *
+ * @param ctx The augmentation context
+ * @param k The SIFT keypoint to match
+ * @param index The index of potentially matching keypoints
+ * @param best_difference Will be filled with the distance of the keypoint k's descriptor and the best keypoint's descriptor
+ *
+ * @return The index of the best match if the keypoint is distinguishable and unique, meaning that the keypoint matches only one keypoint strongly
+ */
+MAR_PRIVATE
+int get_best_keypoint_match(mar_augment_ctx *ctx, mar_sift_keypoint *k, mar_keypoint_index *index, float *best_difference)
+{
+  int best_i;
+  float second_best_diff;
+
+  if (mar_keypoint_index_query(index, k, &best_i, best_difference, &second_best_diff) != MAR_ERROR_NONE)
+  {
+    return -1;
+  }
+
+  // Check that the match is unique
+  if (best_i != -1 && *best_difference * ctx->unique_keypoint_threshold <= second_best_diff)
+  {
+    return best_i;
+  }
+
+  return -1;
+}
+
+/**
+ * Starts the augmentation algorithm.
+ *
+ * @param ctx The augmentation context
+ *
+ * @return MAR_ERROR_NONE on success, an error code on failure.
+ */
+MAR_PUBLIC
+mar_error_code mar_augment_ctx_start_augmentation(mar_augment_ctx *ctx)
+{
+  // Check if augmentation has not been initialized
+  if (ctx == NULL)
+  {
+    return MAR_ERROR_AUGMENTATION_NOT_INITIALIZED;
+  }
+
+  ctx->run_augmentation = 1;
+  mar_augment_record_event(ctx, MAR_CAPTURE_LOG_EVENT_START_AUGMENTATION, 0, 0, MAR_ERROR_NONE, NULL);
+
+  return MAR_ERROR_NONE;
+}
+
+/**
+ * Starts the augmentation algorithm.
+ *
+ * @return MAR_ERROR_NONE on success, an error code on failure.
+ */
+MAR_PUBLIC
+mar_error_code mar_start_augmentation()
+{
+  return mar_augment_ctx_start_augmentation(mar_augment_default_ctx);
+}
+
+/**
+ * Stops the augmentation algorithm.
+ *
+ * @param ctx The augmentation context
+ *
+ * @return MAR_ERROR_NONE on success, an error code on failure.
+ */
+MAR_PUBLIC
+mar_error_code mar_augment_ctx_stop_augmentation(mar_augment_ctx *ctx)
+{
+  // Check if augmentation has not been initialized
+  if (ctx == NULL)
+  {
+    return MAR_ERROR_AUGMENTATION_NOT_INITIALIZED;
+  }
+
+  ctx->run_augmentation = 0;
+  mar_augment_record_event(ctx, MAR_CAPTURE_LOG_EVENT_STOP_AUGMENTATION, 0, 0, MAR_ERROR_NONE, NULL);
+
+  return MAR_ERROR_NONE;
+}
+
+/**
+ * Stops the augmentation algorithm.
+ *
+ * @return MAR_ERROR_NONE on success, an error code on failure.
+ */
+MAR_PUBLIC
+mar_error_code mar_stop_augmentation()
+{
+  return mar_augment_ctx_stop_augmentation(mar_augment_default_ctx);
+}
+
+/**
+ * Estimates the transformation of an augmentation from matches between its initial surface and the current frame,
+ * setting the augmentation's transformation and error.  The inliers are kept to be followed by optical flow.
+ *
+ * @param ctx The augmentation context
+ * @param i The augmentation's ID
+ * @param x The X coordinates of the matched points on the initial surface
+ * @param y The Y coordinates of the matched points on the initial surface
+ * @param u The X coordinates of the matches in the current frame
+ * @param v The Y coordinates of the matches in the current frame
+ * @param num_matches The number of matches, at most MAR_MAX_NUM_OF_MATCHED_KEYPOINTS, sorted from the most to the least reliable
+ *
+ * @return 1 if the transformation was found, otherwise 0
+ */
+MAR_PRIVATE
+char mar_augment_solve(mar_augment_ctx *ctx, int i, const float *x, const float *y, const float *u, const float *v, int num_matches)
+{
+  mar_affine T, T_inverse, predicted;
+  unsigned char inliers[MAR_MAX_NUM_OF_MATCHED_KEYPOINTS];
+  int j, num_inliers;
+
+  // Estimate the transform from the matches, ignoring matches which disagree with most others, starting from
+  // the motion model's prediction once it has been measured
+  ctx->augmentations[i].num_inliers = 0;
+  mar_augment_predict_transform(ctx, i, 1, &predicted);
+  if (mar_affine_estimate(x, y, u, v, num_matches, ctx->ransac_iterations, ctx->ransac_threshold, ctx->ransac_confidence,
+        ctx->motion_model && ctx->augmentations[i].motion.num_measurements > 0 ? &predicted : NULL, 
+        &T, inliers, &num_inliers) != MAR_ERROR_NONE || num_inliers < MAR_MIN_NUM_OF_MATCHED_KEYPOINTS)
+  {
+    ctx->augmentations[i].error = MAR_ERROR_TOO_FEW_MATCHING_KEYPOINTS;
+    return 0;
+  }
+
+  // Check that the skew is less than the maximum skew 
+  // Note that this doesn't account for a large positive skew on one axis and a large negative skew on the other
+  if (fabs(T.b+T.c) > MAR_AUGMENT_MAX_SKEW)
+  {
+    /// @todo set to a skew error code
+    ctx->augmentations[i].error = MAR_ERROR_TOO_FEW_MATCHING_KEYPOINTS;
+    return 0;
+  }
+
+  // Check that the scale difference is less than the maximum scale difference (scale ratio = fabs(scale_x - scale_y))
+  if (fabs(T.a-T.d) > MAR_AUGMENT_MAX_SCALE_RATIO)
+  {
+    /// @todo set to a scale error code
+    ctx->augmentations[i].error = MAR_ERROR_TOO_FEW_MATCHING_KEYPOINTS;
+    return 0;
+  }
+
+  // The inverse maps frame points back onto the initial surface
+  if (mar_affine_invert(&T, &T_inverse) != MAR_ERROR_NONE)
+  {
+    ctx->augmentations[i].error = MAR_ERROR_DEGENERATE_TRANSFORM;
+    return 0;
+  }
+
+  // Smooth the measured transformation with the motion model
+  if (ctx->motion_model)
+  {
+    mar_motion_update(&ctx->augmentations[i].motion, &T, ctx->motion_alpha, ctx->motion_beta, ctx->motion_max_coast_frames);
+    if (mar_affine_invert(&ctx->augmentations[i].motion.transform, &T_inverse) == MAR_ERROR_NONE)
+    {
+      T = ctx->augmentations[i].motion.transform;
+    }
+    else
+    {
+      mar_affine_invert(&T, &T_inverse);
+    }
+  }
+
+  // Set the transformation matrices
+  ctx->augmentations[i].transform = T;
+  ctx->augmentations[i].transform_inverse = T_inverse;
+  ctx->augmentations[i].num_inliers = num_inliers;
+
+  // Follow the inliers by optical flow until the next detection
+  ctx->augmentations[i].surface->num_flow_points = 0;
+  for (j = 0; j < num_matches; j++)
+  {
+    if (inliers[j])
+    {
+      ctx->augmentations[i].surface->flow_x[ctx->augmentations[i].surface->num_flow_points] = x[j];
+      ctx->augmentations[i].surface->flow_y[ctx->augmentations[i].surface->num_flow_points] = y[j];
+      ctx->augmentations[i].surface->flow_u[ctx->augmentations[i].surface->num_flow_points] = u[j];
+      ctx->augmentations[i].surface->flow_v[ctx->augmentations[i].surface->num_flow_points] = v[j];
+      ctx->augmentations[i].surface->num_flow_points++;
+    }
+  }
+
+  // Mark augmentation as successful
+  ctx->augmentations[i].error = MAR_ERROR_NONE;
+
+  return 1;
+}
+
+/**
+ * Checks if a match is worse than another, having a greater difference or the same difference and being kept later.
+ *
+ * @param a The first match
+ * @param b The second match
+ *
+ * @return 1 if the first match is worse, 0 otherwise
+ */
+MAR_PRIVATE
+int mar_augment_match_is_worse(const mar_augment_match *a, const mar_augment_match *b)
+{
+  return a->difference > b->difference || (a->difference == b->difference && a->order > b->order);
+}
+
+/**
+ * Places a match at a slot of a max-heap of matches, moving it down past every better match below it.
+ *
+ * @param heap The heap
+ * @param heap_size The number of matches in the heap
+ * @param slot The slot to place the match at, whose match is overwritten
+ * @param match The match
+ */
+MAR_PRIVATE
+void mar_augment_sift_match_down(mar_augment_match *heap, int heap_size, int slot, const mar_augment_match *match)
+{
+  int child;
+
+  for (child = slot * 2 + 1; child < heap_size; child = slot * 2 + 1)
+  {
+    if (child + 1 < heap_size && mar_augment_match_is_worse(&heap[child + 1], &heap[child]))
+    {
+      child++;
+    }
+    if (!mar_augment_match_is_worse(&heap[child], match))
+    {
+      break;
+    }
+    heap[slot] = heap[child];
+    slot = child;
+  }
+  heap[slot] = *match;
+}
+
+/**
+ * Matches a keypoint of the current frame against an augmentation's keypoints, keeping the match if it is one of
+ * the best so far.  The result is remembered so each keypoint of the frame is only matched once per frame, and
+ * each of the augmentation's keypoints remembers the frame keypoint which matched it best.
+ *
+ * @param ctx The augmentation context
+ * @param i The augmentation's ID
+ * @param frame_keypoints The keypoints of the current frame
+ * @param j The index of the keypoint of the current frame
+ * @param model_matches The augmentation's keypoint which each frame keypoint uniquely matched, -1 for none or MAR_AUGMENT_MATCH_UNKNOWN
+ * @param model_differences The difference of each frame keypoint to its closest keypoint of the augmentation
+ * @param hit_keypoints The frame keypoint which best matched each of the augmentation's keypoints, or -1
+ * @param matches The best matches so far
+ */
+MAR_PRIVATE
+void mar_augment_match_keypoint(mar_augment_ctx *ctx, int i, mar_sift_keypoint *frame_keypoints, int j, int *model_matches,
+    float *model_differences, int *hit_keypoints, mar_augment_matches *matches)
+{
+  mar_augment_match match;
+  int k, l;
+
+  if (model_matches[j] == MAR_AUGMENT_MATCH_UNKNOWN)
+  {
+    model_differences[j] = FLT_MAX;
+    model_matches[j] = get_best_keypoint_match(ctx, &frame_keypoints[j], &ctx->augmentations[i].surface->index, &model_differences[j]);
+  }
+  k = model_matches[j];
+
+  // Check if the keypoint uniquely matched an initial keypoint
+  if (k == -1 || model_differences[j] >= ctx->max_keypoint_difference)
+  {
+    return;
+  }
+  if (hit_keypoints[k] == -1 || model_differences[j] < model_differences[hit_keypoints[k]])
+  {
+    hit_keypoints[k] = j;
+  }
+
+  // Check if the match is one of the best matches so far, a later match of the same difference as the worst is not
+  if (matches->heap_size < MAR_MAX_NUM_OF_MATCHED_KEYPOINTS || model_differences[j] < matches->heap[0].difference)
+  {
+    match.difference = model_differences[j];
+    match.order = matches->num_matches++;
+    match.model = k;
+    match.frame = j;
+    if (matches->heap_size < MAR_MAX_NUM_OF_MATCHED_KEYPOINTS)
+    {
+      // Sift the match up from the bottom of the heap
+      for (l = matches->heap_size++; l > 0 && mar_augment_match_is_worse(&match, &matches->heap[(l - 1) / 2]); l = (l - 1) / 2)
+      {
+        matches->heap[l] = matches->heap[(l - 1) / 2];
+      }
+      matches->heap[l] = match;
+    }
+    else
+    {
+      // Replace the worst match, which is on top
+      mar_augment_sift_match_down(matches->heap, matches->heap_size, 0, &match);
+    }
+  }
+}
+
+/**
+ * Clears the best matches between the keypoints of a frame and the keypoints of an augmentation.
+ *
+ * @param matches The matches
+ * @param hit_keypoints The frame keypoint which best matched each of the augmentation's keypoints, all reset to -1
+ */
+MAR_PRIVATE
+void mar_augment_clear_matches(mar_augment_matches *matches, int *hit_keypoints)
+{
+  int j;
+
+  matches->num_matches = 0;
+  matches->heap_size = 0;
+  for (j = 0; j < MAR_MAX_NUMBER_OF_AUGMENTATION_KEYPOINTS; j++)
+  {
+    hit_keypoints[j] = -1;
+  }
+}
+
+/**
+ * Sorts the best matches from the best to the worst by heapsort, then fills their coordinates.  Matches of the
+ * same difference stay in the order they were found.
+ *
+ * @param surface The augmentation's keypoints
+ * @param frame_keypoints The keypoints of the current frame
+ * @param matches The matches
+ */
+MAR_PRIVATE
+void mar_augment_sort_matches(const mar_augmentation_surface *surface, const mar_sift_keypoint *frame_keypoints, mar_augment_matches *matches)
+{
+  mar_augment_match worst;
+  int j;
+
+  // Move the worst match to the end of the heap until every match is in place
+  for (j = matches->heap_size - 1; j > 0; j--)
+  {
+    worst = matches->heap[0];
+    mar_augment_sift_match_down(matches->heap, j, 0, &matches->heap[j]);
+    matches->heap[j] = worst;
+  }
+
+  for (j = 0; j < matches->heap_size; j++)
+  {
+    matches->x[j] = surface->initial_x[matches->heap[j].model];
+    matches->y[j] = surface->initial_y[matches->heap[j].model];
+    matches->u[j] = frame_keypoints[matches->heap[j].frame].x;
+    matches->v[j] = frame_keypoints[matches->heap[j].frame].y;
+  }
+}
+
+/**
+ * Returns how useful a keypoint of an augmentation has been, the fraction of the recent tracked frames it was
+ * matched in, starting at one half.
+ *
+ * @param surface The augmentation's keypoints
+ * @param j The index of the keypoint
+ *
+ * @return The usefulness of the keypoint, between 0 and 1
+ */
+MAR_PRIVATE
+float mar_augment_get_keypoint_usefulness(const mar_augmentation_surface *surface, int j)
+{
+  return (surface->keypoint_hits[j] + 1.0f) / (surface->keypoint_hits[j] + surface->keypoint_misses[j] + 2.0f);
+}
+
+/**
+ * Finds where to place a new keypoint of an augmentation, after its last keypoint while there is room, otherwise
+ * in place of its least useful keypoint which was neither matched nor placed this frame.
+ *
+ * @param surface The augmentation's keypoints
+ * @param hit_keypoints The frame keypoint which matched each of the augmentation's keypoints this frame, or -1
+ * @param new_keypoints The frame keypoint placed in each of the augmentation's keypoints this frame, or -1
+ *
+ * @return The index to place the keypoint at, or -1 if every keypoint was matched or placed this frame
+ */
+MAR_PRIVATE
+int mar_augment_find_keypoint_slot(const mar_augmentation_surface *surface, const int *hit_keypoints, const int *new_keypoints)
+{
+  int j, slot = -1;
+  float usefulness, least_usefulness = 2;
+
+  // New keypoints are placed in order after the last, so the index grows one keypoint at a time
+  for (j = surface->index.num_keypoints; j < MAR_MAX_NUMBER_OF_AUGMENTATION_KEYPOINTS; j++)
+  {
+    if (new_keypoints[j] == -1)
+    {
+      return j;
+    }
+  }
+
+  for (j = 0; j < surface->index.num_keypoints; j++)
+  {
+    if (hit_keypoints[j] == -1 && new_keypoints[j] == -1)
+    {
+      usefulness = mar_augment_get_keypoint_usefulness(surface, j);
+      if (usefulness < least_usefulness)
+      {
+        least_usefulness = usefulness;
+        slot = j;
+      }
+    }
+  }
+
+  return slot;
+}
+
+/**
+ * Tracks a single augmentation in the current frame by matching its keypoints and solving for its transformation.
+ * Once solved, the augmentation's keypoints are updated from the same matches: matched keypoints have their
+ * descriptors refreshed and are scored as hits, the others as misses, and keypoints of the frame which were also
+ * seen in the last frame replace the least useful keypoints.  Augmentations are independent of each other, so
+ * different augmentations may be tracked concurrently.
+ *
+ * @param ctx The augmentation context
+ * @param i The augmentation's ID
+ * @param frame_keypoints The keypoints of the current frame
+ * @param frame_num_keypoints The number of keypoints of the current frame
+ * @param grid The keypoints of the current frame bucketed by position
+ * @param arena The scratch memory of the current frame
+ */
+MAR_PRIVATE
+void mar_augment_track(mar_augment_ctx *ctx, int i, mar_sift_keypoint *frame_keypoints, int frame_num_keypoints, const mar_keypoint_grid *grid, mar_arena *arena)
+{
+  mar_augmentation_surface *surface = ctx->augmentations[i].surface;
+  int j, k, l, num_keypoints, num_new_potentials;
+  int *contained, *model_matches;
+  float ox, oy, best_difference, *model_differences;
+  int hit_keypoints[MAR_MAX_NUMBER_OF_AUGMENTATION_KEYPOINTS], new_keypoints[MAR_MAX_NUMBER_OF_AUGMENTATION_KEYPOINTS];
+  int new_potentials[MAR_MAX_NUMBER_OF_AUGMENTATION_KEYPOINTS];
+  mar_augment_matches matches;
+  mar_affine ellipse;
+  uint64_t start;
+  char solved;
+
+  // The matches of the frame keypoints are kept for the whole frame, so the solve and the model update share them
+  contained = (int *)mar_arena_alloc(arena, frame_num_keypoints * sizeof(int));
+  model_matches = (int *)mar_arena_alloc(arena, frame_num_keypoints * sizeof(int));
+  model_differences = (float *)mar_arena_alloc(arena, frame_num_keypoints * sizeof(float));
+  if (contained == NULL || model_matches == NULL || model_differences == NULL)
+  {
+    ctx->augmentations[i].error = MAR_ERROR_MALLOC;
+    return;
+  }
+  for (j = 0; j < frame_num_keypoints; j++)
+  {
+    model_matches[j] = MAR_AUGMENT_MATCH_UNKNOWN;
+  }
+
+  // Find keypoints within the ellipse in the last frame
+  start = mar_stats_now();
+  mar_augment_get_surface_ellipse(ctx, i, &ellipse);
+  mar_keypoint_grid_query_ellipse(grid, &ellipse, contained, &num_keypoints);
+  mar_stats_histogram_add(&ctx->stage_latencies[MAR_AUGMENT_STAGE_CONTAINMENT], mar_stats_now() - start);
+  start = mar_stats_now();
+
+  // Iterate through every keypoint within the ellipse
+  mar_augment_clear_matches(&matches, hit_keypoints);
+  for (j = 0; j < num_keypoints; j++)
+  {
+    mar_augment_match_keypoint(ctx, i, frame_keypoints, contained[j], model_matches, model_differences, hit_keypoints, &matches);
+  }
+
+  // If we can't find them in the augmented MSER region, then look in the whole frame to refocus
+  if (matches.num_matches < MAR_MIN_NUM_OF_MATCHED_KEYPOINTS)
+  {
+    mar_augment_clear_matches(&matches, hit_keypoints);
+    for (j = 0; j < frame_num_keypoints; j++)
+    {
+      mar_augment_match_keypoint(ctx, i, frame_keypoints, j, model_matches, model_differences, hit_keypoints, &matches);
+    }
+  }
+
+  mar_augment_sort_matches(surface, frame_keypoints, &matches);
+  mar_stats_histogram_add(&ctx->stage_latencies[MAR_AUGMENT_STAGE_MATCH], mar_stats_now() - start);
+
+  // Only the best matches are kept, sorted from the best to the worst
+  if (matches.num_matches > MAR_MAX_NUM_OF_MATCHED_KEYPOINTS)
+  {
+    matches.num_matches = MAR_MAX_NUM_OF_MATCHED_KEYPOINTS;
+  }
+  ctx->augmentations[i].num_matches = matches.num_matches;
+
+  // Check if a sufficient number of keypoints has been matched
+  if (matches.num_matches < MAR_MIN_NUM_OF_MATCHED_KEYPOINTS)
+  {
+    ctx->augmentations[i].error = MAR_ERROR_TOO_FEW_MATCHING_KEYPOINTS;
+    return;
+  }
+
+  start = mar_stats_now();
+  solved = mar_augment_solve(ctx, i, matches.x, matches.y, matches.u, matches.v, matches.num_matches);
+  mar_stats_histogram_add(&ctx->stage_latencies[MAR_AUGMENT_STAGE_SOLVE], mar_stats_now() - start);
+  if (!solved)
+  {
+    return;
+  }
+
+  /// @todo: allow the ability to config whether or not to add points continue;
+
+  // Add new points from the keypoints within the ellipse under the new transformation
+  start = mar_stats_now();
+  mar_augment_get_surface_ellipse(ctx, i, &ellipse);
+  mar_keypoint_grid_query_ellipse(grid, &ellipse, contained, &num_keypoints);
+  mar_stats_histogram_add(&ctx->stage_latencies[MAR_AUGMENT_STAGE_CONTAINMENT], mar_stats_now() - start);
+
+  // Find the keypoints within the ellipse which are not yet keypoints of the augmentation, only matching the
+  // keypoints which entered the ellipse under the new transformation against the augmentation's keypoints
+  num_new_potentials = 0;
+  for (j = 0; j < MAR_MAX_NUMBER_OF_AUGMENTATION_KEYPOINTS; j++)
+  {
+    new_keypoints[j] = -1;
+  }
+  for (j = 0; j < num_keypoints && num_new_potentials < MAR_MAX_NUMBER_OF_AUGMENTATION_KEYPOINTS; j++)
+  {
+    l = contained[j];
+    if (model_matches[l] == MAR_AUGMENT_MATCH_UNKNOWN)
+    {
+      model_differences[l] = FLT_MAX;
+      model_matches[l] = get_best_keypoint_match(ctx, &frame_keypoints[l], &surface->index, &model_differences[l]);
+    }
+
+    // Keypoints close to one of the augmentation's keypoints are already part of it
+    if (model_differences[l] <= ctx->max_keypoint_difference)
+    {
+      continue;
+    }
+
+    // Keypoints which were also seen in the last frame become keypoints of the augmentation, the others may next frame
+    k = get_best_keypoint_match(ctx, &frame_keypoints[l], &surface->potential_index, &best_difference);
+    if (k != -1 && best_difference < ctx->max_keypoint_difference)
+    {
+      k = mar_augment_find_keypoint_slot(surface, hit_keypoints, new_keypoints);
+      if (k != -1)
+      {
+        mar_augment_ctx_untransform_point(ctx, i, frame_keypoints[l].x, frame_keypoints[l].y, &ox, &oy);
+        surface->initial_x[k] = ox;
+        surface->initial_y[k] = oy;
+        new_keypoints[k] = l;
+      }
+    }
+    else
+    {
+      new_potentials[num_new_potentials++] = l;
+    }
+  }
+
+  // Refresh the descriptors of the matched keypoints to their most recent match and score every keypoint
+  for (j = 0; j < surface->index.num_keypoints; j++)
+  {
+    if (hit_keypoints[j] != -1)
+    {
+      mar_keypoint_index_update_keypoint(&surface->index, j, &frame_keypoints[hit_keypoints[j]]);
+      surface->keypoint_hits[j]++;
+    }
+    else
+    {
+      surface->keypoint_misses[j]++;
+    }
+    if (surface->keypoint_hits[j] + surface->keypoint_misses[j] >= MAR_AUGMENT_KEYPOINT_HISTORY)
+    {
+      surface->keypoint_hits[j] /= 2;
+      surface->keypoint_misses[j] /= 2;
+    }
+  }
+
+  // Update the indices once, so each is rebuilt at most once per frame
+  for (j = 0; j < MAR_MAX_NUMBER_OF_AUGMENTATION_KEYPOINTS; j++)
+  {
+    if (new_keypoints[j] != -1)
+    {
+      mar_keypoint_index_set_keypoint(&surface->index, j, &frame_keypoints[new_keypoints[j]]);
+      surface->keypoint_hits[j] = 1;
+      surface->keypoint_misses[j] = 0;
+    }
+  }
+  surface->num_initial_keypoints = surface->index.num_keypoints;
+
+  mar_keypoint_index_clear(&surface->potential_index);
+  for (j = 0; j < num_new_potentials; j++)
+  {
+    mar_keypoint_index_set_keypoint(&surface->potential_index, j, &frame_keypoints[new_potentials[j]]);
+  }
+}
+
+/**
+ * Tracks a single augmentation in the current frame by following the inliers of its last transformation from
+ * the previous frame with optical flow and solving for its transformation.  Augmentations are independent of
+ * each other, so different augmentations may be tracked concurrently.
+ *
+ * @param ctx The augmentation context
+ * @param i The augmentation's ID
+ * @param previous The image pyramid of the previous frame, prepared with mar_optical_flow_prepare
+ * @param current The image pyramid of the current frame, prepared with mar_optical_flow_prepare
+ */
+MAR_PRIVATE
+void mar_augment_track_flow(mar_augment_ctx *ctx, int i, mar_image_pyramid *previous, mar_image_pyramid *current)
+{
+  int j, num_points;
+  float x[MAR_MAX_NUM_OF_MATCHED_KEYPOINTS], y[MAR_MAX_NUM_OF_MATCHED_KEYPOINTS], u[MAR_MAX_NUM_OF_MATCHED_KEYPOINTS], v[MAR_MAX_NUM_OF_MATCHED_KEYPOINTS];
+  unsigned char tracked[MAR_MAX_NUM_OF_MATCHED_KEYPOINTS];
+  uint64_t start;
+
+  // Follow the points into the current frame
+  num_points = 0;
+  if (mar_optical_flow_track(previous, current, ctx->augmentations[i].surface->flow_u, ctx->augmentations[i].surface->flow_v, 
+        ctx->augmentations[i].surface->num_flow_points, ctx->flow_window_radius, ctx->flow_iterations, u, v, tracked) == MAR_ERROR_NONE)
+  {
+    // Pair the points which were not lost with where they started on the initial surface
+    for (j = 0; j < ctx->augmentations[i].surface->num_flow_points; j++)
+    {
+      if (tracked[j])
+      {
+        x[num_points] = ctx->augmentations[i].surface->flow_x[j];
+        y[num_points] = ctx->augmentations[i].surface->flow_y[j];
+        u[num_points] = u[j];
+        v[num_points] = v[j];
+        num_points++;
+      }
+    }
+  }
+
+  ctx->augmentations[i].num_matches = num_points;
+  if (num_points < MAR_MIN_NUM_OF_MATCHED_KEYPOINTS)
+  {
+    ctx->augmentations[i].num_inliers = 0;
+    ctx->augmentations[i].error = MAR_ERROR_TOO_FEW_MATCHING_KEYPOINTS;
+    ctx->augmentations[i].surface->num_flow_points = 0;
+    return;
+  }
+
+  start = mar_stats_now();
+  if (!mar_augment_solve(ctx, i, x, y, u, v, num_points))
+  {
+    ctx->augmentations[i].surface->num_flow_points = 0;
+  }
+  mar_stats_histogram_add(&ctx->stage_latencies[MAR_AUGMENT_STAGE_SOLVE], mar_stats_now() - start);
+}
+
+/**
+ * A thread pool task which tracks one of the augmentations listed in a mar_augment_track_job.  With a motion
+ * model the augmentation is searched for where it is predicted to be, and is predicted while it is lost.
+ *
+ * @param arg The mar_augment_track_job
+ * @param index The index into the job's augmentation IDs
+ */
+MAR_PRIVATE
+void mar_augment_track_task(void *arg, int index)
+{
+  mar_augment_track_job *job = (mar_augment_track_job *)arg;
+  mar_augment_ctx *ctx = job->ctx;
+  int i = job->ids[index];
+  mar_affine T, T_inverse;
+
+  // Search for the augmentation where the motion model expects it
+  if (ctx->motion_model)
+  {
+    mar_augment_predict_transform(ctx, i, 1, &T);
+    if (mar_affine_invert(&T, &T_inverse) == MAR_ERROR_NONE)
+    {
+      ctx->augmentations[i].transform = T;
+      ctx->augmentations[i].transform_inverse = T_inverse;
+    }
+  }
+
+  if (job->flow)
+  {
+    mar_augment_track_flow(ctx, i, job->previous, job->current);
+  }
+  else
+  {
+    mar_augment_track(ctx, i, job->keypoints, job->num_keypoints, job->grid, job->arena);
+  }
+
+  // A lost augmentation keeps moving as it was for a few frames instead of freezing in place
+  if (ctx->motion_model && ctx->augmentations[i].error != MAR_ERROR_NONE)
+  {
+    mar_motion_coast(&ctx->augmentations[i].motion, ctx->motion_max_coast_frames);
+    if (mar_affine_invert(&ctx->augmentations[i].motion.transform, &T_inverse) == MAR_ERROR_NONE)
+    {
+      ctx->augmentations[i].transform = ctx->augmentations[i].motion.transform;
+      ctx->augmentations[i].transform_inverse = T_inverse;
+    }
+  }
+}
+
+/**
+ * Captures or takes the next frame of a view, detects its keypoints and tracks every augmentation of the view in it.
+ *
+ * @param v The view
+ *
+ * @return MAR_ERROR_NONE on success, an error code on failure.
+ */
+MAR_PRIVATE
+mar_error_code mar_augment_update_view(mar_augment_view *v)
+{
+  mar_augment_ctx *ctx = v->ctx;
+  mar_error_code mrv;
+  mar_augment_frame *f;
+  mar_augment_track_job job;
+  int i;
+
+  // Reset state variables
+  v->mser_calculated_this_frame = 0;
+  v->frame_rgb_converted = 0;
+
+  if (v->pipeline_running)
+  {
+    // Hand the previous frame back to the detection thread and take the next frame in capture order
+    pthread_mutex_lock(&v->pipeline_mutex);
+    if (v->current_frame != NULL)
+    {
+      mar_augment_plan_detection(v, v->current_frame);
+      v->current_frame->state = MAR_AUGMENT_FRAME_FREE;
+      pthread_cond_broadcast(&v->pipeline_cond);
+    }
+    f = &v->frames[v->pipeline_track_count % v->num_frames];
+    while (f->state != MAR_AUGMENT_FRAME_DETECTED)
+    {
+      pthread_cond_wait(&v->pipeline_cond, &v->pipeline_mutex);
+    }
+    f->state = MAR_AUGMENT_FRAME_TRACKING;
+    v->pipeline_track_count++;
+    pthread_mutex_unlock(&v->pipeline_mutex);
+
+    v->current_frame = f;
+    if (f->error != MAR_ERROR_NONE)
+    {
+      return f->error;
+    }
+  }
+  else
+  {
+    // Capture the frame on this thread
+    f = v->current_frame = &v->frames[0];
+    mrv = mar_augment_capture_frame(v, f);
+    if (mrv != MAR_ERROR_NONE)
+    {
+      return mrv;
+    }
+    mar_augment_plan_detection(v, f);
+  }
+
+  // Check if any augmentations exists
+  if (ctx->run_augmentation)
+  {
+    // Update the SIFT filter, unless the detection thread already has
+    if (!f->sift_calculated)
+    {
+      mrv = mar_augment_detect_keypoints(v, f);
+      if (mrv != MAR_ERROR_NONE)
+      {
+        return mrv;
+      }
+    }
+
+    // Track every augmentation of the view, concurrently when a tracking pool exists
+    job.ctx = ctx;
+    job.num_ids = 0;
+    job.ids = (int *)mar_arena_alloc(&f->arena, (v->number_of_augmentations > 0 ? v->number_of_augmentations : 1) * sizeof(int));
+    if (job.ids == NULL)
+    {
+      return MAR_ERROR_MALLOC;
+    }
+    for (i = 0; i < ctx->augmentations_capacity; i++)
+    {
+      if (ctx->augmentations[i].initialized && ctx->augmentations[i].view == v->index)
+      {
+        job.ids[job.num_ids++] = i;
+      }
+    }
+    job.keypoints = f->keypoints;
+    job.num_keypoints = f->num_keypoints;
+    job.grid = &f->grid;
+    job.arena = &f->arena;
+    job.flow = f->skip_detection && v->flow_previous_valid;
+    job.previous = &v->flow_previous;
+    job.current = &f->pyramid;
+    if (job.flow)
+    {
+      // The pyramid levels are built lazily, so build them before the tasks share them
+      mar_optical_flow_prepare(job.previous);
+      mar_optical_flow_prepare(job.current);
+    }
+    mar_thread_pool_run(ctx->tracking_pool, mar_augment_track_task, &job, job.num_ids);
+
+    // Keep this frame for following the augmentations into the next one
+    if (ctx->flow_tracking)
+    {
+      memcpy(mar_image_pyramid_get_frame_storage(&v->flow_previous), mar_image_pyramid_get_gray(&f->pyramid, 0, NULL, NULL), 
+          v->flow_previous.width[0] * v->flow_previous.height[0]);
+      mar_image_pyramid_set_frame(&v->flow_previous, mar_image_pyramid_get_frame_storage(&v->flow_previous), NULL);
+      v->flow_previous_valid = 1;
+    }
+  }
+  else
+  {
+    v->flow_previous_valid = 0;
+  }
+
+  return MAR_ERROR_NONE;
+}
+
+/**
+ * Makes the calls of the replayed log which were recorded before the current update.  The augmentations are
+ * created from the same current frames as when they were recorded, so they are given the same IDs.
+ *
+ * @param ctx The augmentation context
+ */
+MAR_PRIVATE
+void mar_augment_replay_events(mar_augment_ctx *ctx)
+{
+  const mar_capture_log_event *event;
+  mar_augmentation_id id;
+  mar_mser region;
+
+  while (ctx->replay_next_event < ctx->replay->num_events && 
+      ctx->replay->events[ctx->replay_next_event]->update <= ctx->num_updates)
+  {
+    event = ctx->replay->events[ctx->replay_next_event++];
+    switch (event->type)
+    {
+      case MAR_CAPTURE_LOG_EVENT_NEW_AUGMENTATION:
+        MAR_CLEAR(region);
+        region.ellipse_x = event->ellipse_x;
+        region.ellipse_y = event->ellipse_y;
+        region.ellipse_a = event->ellipse_a;
+        region.ellipse_b = event->ellipse_b;
+        region.ellipse_angle = event->ellipse_angle;
+        mar_augment_ctx_view_new_augmentation(ctx, event->view, &id, &region);
+        break;
+      case MAR_CAPTURE_LOG_EVENT_FREE_AUGMENTATION:
+        mar_augment_ctx_free_augmentation(ctx, (mar_augmentation_id)event->id);
+        break;
+      case MAR_CAPTURE_LOG_EVENT_START_AUGMENTATION:
+        mar_augment_ctx_start_augmentation(ctx);
+        break;
+      case MAR_CAPTURE_LOG_EVENT_STOP_AUGMENTATION:
+        mar_augment_ctx_stop_augmentation(ctx);
+        break;
+    }
+  }
+}
+
+/**
+ * Scales the detectors of every view to the frame budget from the time of the latest update.  While the smoothed
+ * update time is over the budget, the detector whose latest run took longer is scaled down a step, MSER by
+ * detecting in the next image pyramid level and SIFT by skipping its next first octave.  Once the update time is
+ * back under MAR_AUGMENT_GOVERNOR_HEADROOM of the budget, SIFT is restored first since tracking depends on it.
+ * The SIFT detectors follow the change on the thread detecting their next frame, so the pipeline keeps running.
+ *
+ * @param ctx The augmentation context
+ * @param latency The time of the latest update in microseconds
+ */
+MAR_PRIVATE
+void mar_augment_govern(mar_augment_ctx *ctx, uint64_t latency)
+{
+  uint64_t sift_time, mser_time;
+  int octave_skip = ctx->governor_octave_skip, mser_level = ctx->governor_mser_level;
+
+  if (ctx->governor_update_time == 0)
+  {
+    ctx->governor_update_time = latency;
+  }
+  ctx->governor_update_time += MAR_AUGMENT_GOVERNOR_SMOOTHING * (latency - ctx->governor_update_time);
+  if (ctx->governor_settle_updates > 0)
+  {
+    ctx->governor_settle_updates--;
+    return;
+  }
+
+  if (ctx->governor_update_time > ctx->governor_frame_budget)
+  {
+    // Scale down the detector which costs the most, MSER detected on their own thread cost the update nothing
+    sift_time = mar_stats_histogram_get_last(&ctx->stage_latencies[MAR_AUGMENT_STAGE_SIFT]);
+    mser_time = mar_stats_histogram_get_last(&ctx->stage_latencies[MAR_AUGMENT_STAGE_MSER]);
+    if (!ctx->mser_background && mser_level < ctx->governor_max_mser_level && 
+        (mser_time > sift_time || octave_skip >= ctx->governor_max_octave_skip))
+    {
+      mser_level++;
+    }
+    else if (octave_skip < ctx->governor_max_octave_skip)
+    {
+      octave_skip++;
+    }
+  }
+  else if (ctx->governor_update_time < ctx->governor_frame_budget * MAR_AUGMENT_GOVERNOR_HEADROOM)
+  {
+    if (octave_skip > 0)
+    {
+      octave_skip--;
+    }
+    else if (mser_level > 0)
+    {
+      mser_level--;
+    }
+  }
+
+  if (octave_skip != ctx->governor_octave_skip || mser_level != ctx->governor_mser_level)
+  {
+    __atomic_store_n(&ctx->governor_octave_skip, octave_skip, __ATOMIC_RELAXED);
+    ctx->governor_mser_level = mser_level;
+    ctx->governor_settle_updates = MAR_AUGMENT_GOVERNOR_SETTLE_UPDATES;
+
+    // Recreating the detectors allocates, which is not a steady state update
+    ctx->steady_frames = 0;
+  }
+}
+
+/**
+ * Grows a snapshot buffer to hold at least a number of bytes, keeping its size for the following snapshots.
+ *
+ * @param buffer The buffer, which is moved when it grows
+ * @param size The size of the buffer in bytes
+ * @param needed The number of bytes needed
+ *
+ * @return MAR_ERROR_NONE on success, MAR_ERROR_MALLOC if the buffer could not grow.
+ */
+MAR_PRIVATE
+mar_error_code mar_augment_reserve_snapshot_buffer(void **buffer, size_t *size, size_t needed)
+{
+  void *grown;
+
+  if (needed > *size)
+  {
+    grown = mar_realloc(*buffer, needed);
+    if (grown == NULL)
+    {
+      return MAR_ERROR_MALLOC;
+    }
+    *buffer = grown;
+    *size = needed;
+  }
+
+  return MAR_ERROR_NONE;
+}
+
+/**
+ * Copies the state of a context after an update into a snapshot no reader holds, then publishes it in place of the
+ * previous one.  Keypoints and MSER asked for are detected now if the update did not detect them.  Nothing is
+ * published when every other snapshot is held.
+ *
+ * @param ctx The augmentation context
+ * @param error The error returned by the update
+ *
+ * @return MAR_ERROR_NONE on success, MAR_ERROR_MALLOC if the snapshot could not be copied.
+ */
+MAR_PRIVATE
+mar_error_code mar_augment_publish_snapshot(mar_augment_ctx *ctx, mar_error_code error)
+{
+  mar_augment_snapshot *snapshot = NULL;
+  mar_augment_snapshot_view *sv;
+  const mar_camera_frame *frame;
+  mar_sift_keypoint *keypoints;
+  mar_mser *regions;
+  const unsigned char *gray;
+  mar_error_code mrv = MAR_ERROR_NONE;
+  int i, j, contents, num, width, height;
+
+  // Take a snapshot which is neither held nor published, so no reader can acquire it while it is written
+  pthread_mutex_lock(&ctx->snapshot_mutex);
+  contents = ctx->snapshot_contents;
+  for (i = 0; i < MAR_AUGMENT_NUM_SNAPSHOTS && snapshot == NULL; i++)
+  {
+    if (ctx->snapshots[i].refs == 0 && &ctx->snapshots[i] != ctx->snapshot_published)
+    {
+      snapshot = &ctx->snapshots[i];
+    }
+  }
+  pthread_mutex_unlock(&ctx->snapshot_mutex);
+  if (snapshot == NULL)
+  {
+    return MAR_ERROR_NONE;
+  }
+
+  snapshot->version = ctx->num_updates;
+  snapshot->error = error;
+  snapshot->contents = contents;
+  snapshot->num_views = ctx->num_views;
+
+  // Copy the results of every augmentation
+  snapshot->num_results = 0;
+  mrv = mar_augment_reserve_snapshot_buffer((void **)&snapshot->results, &snapshot->results_size,
+      ctx->augmentations_capacity * sizeof(mar_augmentation_result));
+  if (mrv != MAR_ERROR_NONE)
+  {
+    return mrv;
+  }
+  mar_augment_ctx_get_results(ctx, MAR_AUGMENT_ALL_VIEWS, snapshot->results, ctx->augmentations_capacity, &snapshot->num_results);
+
+  for (i = 0; i < ctx->num_views && mrv == MAR_ERROR_NONE; i++)
+  {
+    sv = &snapshot->views[i];
+    sv->error = ctx->views[i].error;
+    sv->num_keypoints = 0;
+    sv->num_regions = 0;
+    MAR_CLEAR(sv->frame);
+    MAR_CLEAR(sv->gray);
+
+    // Detection errors leave the snapshot without keypoints or MSER, the errors were kept by the update
+    if ((contents & MAR_AUGMENT_SNAPSHOT_KEYPOINTS) && mar_augment_ctx_view_get_keypoints(ctx, i, &keypoints, &num) == MAR_ERROR_NONE)
+    {
+      mrv = mar_augment_reserve_snapshot_buffer((void **)&sv->keypoints, &sv->keypoints_size, num * sizeof(mar_sift_keypoint));
+      if (mrv == MAR_ERROR_NONE)
+      {
+        memcpy(sv->keypoints, keypoints, num * sizeof(mar_sift_keypoint));
+        sv->num_keypoints = num;
+      }
+    }
+    if (mrv == MAR_ERROR_NONE && (contents & MAR_AUGMENT_SNAPSHOT_REGIONS) &&
+        mar_augment_ctx_view_get_regions(ctx, i, &regions, &num) == MAR_ERROR_NONE)
+    {
+      mrv = mar_augment_reserve_snapshot_buffer((void **)&sv->regions, &sv->regions_size, num * sizeof(mar_mser));
+      if (mrv == MAR_ERROR_NONE)
+      {
+        memcpy(sv->regions, regions, num * sizeof(mar_mser));
+        sv->num_regions = num;
+      }
+    }
+
+    // Copy the raw frame, pointing the copy's lease at the snapshot's own buffer
+    frame = mar_augment_ctx_view_get_camera_frame(ctx, i);
+    if (mrv == MAR_ERROR_NONE && (contents & MAR_AUGMENT_SNAPSHOT_FRAME) && frame != NULL)
+    {
+      mrv = mar_augment_reserve_snapshot_buffer((void **)&sv->frame_buffer, &sv->frame_buffer_size, frame->length);
+      if (mrv == MAR_ERROR_NONE)
+      {
+        memcpy(sv->frame_buffer, frame->data, frame->length);
+        sv->frame = *frame;
+        sv->frame.data = sv->frame_buffer;
+      }
+    }
+
+    // Copy every grayscale pyramid level
+    for (j = 0; j < MAR_IMAGE_PYRAMID_MAX_LEVELS && mrv == MAR_ERROR_NONE && (contents & MAR_AUGMENT_SNAPSHOT_GRAYSCALE); j++)
+    {
+      gray = mar_augment_ctx_view_get_grayscale_frame_buffer(ctx, i, j, &width, &height);
+      if (gray == NULL)
+      {
+        break;
+      }
+      mrv = mar_augment_reserve_snapshot_buffer((void **)&sv->gray_buffers[j], &sv->gray_buffer_sizes[j], width * height);
+      if (mrv == MAR_ERROR_NONE)
+      {
+        memcpy(sv->gray_buffers[j], gray, width * height);
+        sv->gray[j] = sv->gray_buffers[j];
+        sv->gray_width[j] = width;
+        sv->gray_height[j] = height;
+      }
+    }
+  }
+  if (mrv != MAR_ERROR_NONE)
+  {
+    return mrv;
+  }
+
+  // Replace the published snapshot, readers still holding the previous one keep it until they release it
+  pthread_mutex_lock(&ctx->snapshot_mutex);
+  ctx->snapshot_published = snapshot;
+  pthread_mutex_unlock(&ctx->snapshot_mutex);
+
+  return MAR_ERROR_NONE;
+}
+
+/**
+ * Applies a configuration reloaded by mar_augment_ctx_reload_config between two updates.  The tracking settings
+ * are changed at once, and the detector settings are published for the threads using the detectors.
+ *
+ * @param ctx The augmentation context
+ */
+MAR_PRIVATE
+void mar_augment_apply_reload(mar_augment_ctx *ctx)
+{
+  config_t *cfg;
+
+  pthread_mutex_lock(&ctx->reload_mutex);
+  cfg = ctx->reload_cfg;
+  __atomic_store_n(&ctx->reload_cfg, NULL, __ATOMIC_RELAXED);
+  mar_augment_configure_tracking(ctx, cfg);
+  mar_augment_read_detector_settings(cfg, &ctx->detector_settings);
+  __atomic_store_n(&ctx->detector_settings_version, ctx->detector_settings_version + 1, __ATOMIC_RELEASE);
+  pthread_mutex_unlock(&ctx->reload_mutex);
+  config_destroy(cfg);
+  mar_free(cfg);
+
+  // Keep the governor within its reloaded limits
+  if (ctx->governor_octave_skip > ctx->governor_max_octave_skip)
+  {
+    __atomic_store_n(&ctx->governor_octave_skip, ctx->governor_max_octave_skip > 0 ? ctx->governor_max_octave_skip : 0, __ATOMIC_RELAXED);
+  }
+  if (ctx->governor_mser_level > ctx->governor_max_mser_level)
+  {
+    ctx->governor_mser_level = ctx->governor_max_mser_level > 0 ? ctx->governor_max_mser_level : 0;
+  }
+
+  // Recreating the detectors allocates, which is not a steady state update
+  ctx->steady_frames = 0;
+}
+
+/**
+ * Updates an augmentation frame of every view.  When pipelined, the frame of each view was captured and its keypoints
+ * detected on the view's detection thread while the previous frame was being tracked, and frames are always tracked
+ * in capture order.  The error of each view is kept for mar_augment_ctx_view_get_error, and the first is returned.
+ * Once a snapshot has been asked for, each update publishes a new one for the threads reading it.
+ * When built with MAR_DEBUG_ALLOCATIONS, heap allocations made by an update once augmentations have not been
+ * created or freed for MAR_AUGMENT_STEADY_STATE_FRAMES updates are reported on stderr.
+ *
+ * @param ctx The augmentation context
+ *
+ * @return MAR_ERROR_NONE on success, an error code on failure.
+ *
+ * @todo Add unmatched SIFT keypoints after they appear consecutively so many times
+ * @todo Try using all matched keypoints when calculating the transformation matrix
+ */
+MAR_PUBLIC
+mar_error_code mar_augment_ctx_update(mar_augment_ctx *ctx)
+{
+  mar_error_code mrv = MAR_ERROR_NONE, error;
+  unsigned long allocations = mar_get_heap_allocations();
+  uint64_t start = mar_stats_now(), latency;
+  int i;
+
+  // Check if augmentation has not been initialized
+  if (ctx == NULL)
+  {
+    return MAR_ERROR_AUGMENTATION_NOT_INITIALIZED;
+  }
+
+  // Make the recorded calls which were made before this update
+  if (ctx->replay != NULL)
+  {
+    mar_augment_replay_events(ctx);
+  }
+
+  // Apply a reloaded configuration between frames, so that every view is updated with the same settings
+  if (__atomic_load_n(&ctx->reload_cfg, __ATOMIC_ACQUIRE) != NULL)
+  {
+    mar_augment_apply_reload(ctx);
+  }
+
+  for (i = 0; i < ctx->num_views; i++)
+  {
+    ctx->views[i].error = mar_augment_update_view(&ctx->views[i]);
+    mrv = mrv == MAR_ERROR_NONE ? ctx->views[i].error : mrv;
+    if (ctx->mser_background)
+    {
+      mar_augment_schedule_regions(&ctx->views[i]);
+    }
+  }
+  ctx->num_updates++;
+
+  // Publish the state of the update for the threads reading it, once they have asked for it
+  if (__atomic_load_n(&ctx->snapshots_enabled, __ATOMIC_ACQUIRE))
+  {
+    error = mar_augment_publish_snapshot(ctx, mrv);
+    mrv = mrv == MAR_ERROR_NONE ? error : mrv;
+  }
+  latency = mar_stats_now() - start;
+  mar_stats_histogram_add(&ctx->stage_latencies[MAR_AUGMENT_STAGE_UPDATE], latency);
+  if (ctx->governor)
+  {
+    mar_augment_govern(ctx, latency);
+  }
+
+  // Frame scratch memory comes from the frame arenas, so a steady state update should never touch the heap
+  ctx->frame_allocations = mar_get_heap_allocations() - allocations;
+  if (ctx->steady_frames < MAR_AUGMENT_STEADY_STATE_FRAMES)
+  {
+    ctx->steady_frames++;
+  }
+#ifdef MAR_DEBUG_ALLOCATIONS
+  else if (ctx->frame_allocations > 0)
+  {
+    fprintf(stderr, "mar_augment_update: %lu heap allocations in the steady state\n", ctx->frame_allocations);
+  }
+#endif
+
+  return mrv;
+}
+
+/**
+ * Updates an augmentation frame of every view.  When pipelined, the frame of each view was captured and its keypoints
+ * detected on the view's detection thread while the previous frame was being tracked, and frames are always tracked
+ * in capture order.  The error of each view is kept for mar_augment_view_get_error, and the first is returned.
+ * Once a snapshot has been asked for, each update publishes a new one for the threads reading it.
+ * When built with MAR_DEBUG_ALLOCATIONS, heap allocations made by an update once augmentations have not been
+ * created or freed for MAR_AUGMENT_STEADY_STATE_FRAMES updates are reported on stderr.
+ *
+ * @return MAR_ERROR_NONE on success, an error code on failure.
+ *
+ * @todo Add unmatched SIFT keypoints after they appear consecutively so many times
+ * @todo Try using all matched keypoints when calculating the transformation matrix
+ */
+MAR_PUBLIC
+mar_error_code mar_augment_update()
+{
+  return mar_augment_ctx_update(mar_augment_default_ctx);
+}
+
+/**
+ * Returns the number of heap allocations made during the last update, counting those of the detection thread
+ * when pipelined.  The allocations are counted for the whole process, so they include those of any other context
+ * updated at the same time.
+ *
+ * @param ctx The augmentation context
+ *
+ * @return The number of allocations, always 0 unless built with MAR_DEBUG_ALLOCATIONS
+ */
+MAR_PUBLIC
+unsigned long mar_augment_ctx_get_frame_allocations(mar_augment_ctx *ctx)
+{
+  return ctx != NULL ? ctx->frame_allocations : 0;
+}
+
+/**
+ * Returns the number of heap allocations made during the last update, counting those of the detection thread
+ * when pipelined.
+ *
+ * @return The number of allocations, always 0 unless built with MAR_DEBUG_ALLOCATIONS
+ */
+MAR_PUBLIC
+unsigned long mar_augment_get_frame_allocations()
+{
+  return mar_augment_ctx_get_frame_allocations(mar_augment_default_ctx);
+}
+
+/**
+ * Loads the transformation matrix for a given augmentation in a 4x4 column major matrix.  With a motion model,
+ * the transformation of an augmentation lost for a few frames is predicted from how it was moving.
+ *
+ * @param ctx The augmentation context
+ * @param id The augmentation's ID
+ * @param id Will be filled with the matrices values in a column major ordering.  
+ *
+ * @return MAR_ERROR_NONE on success, an error code on failure.
+ */
+MAR_PUBLIC
+mar_error_code mar_augment_ctx_get_transformation(mar_augment_ctx *ctx, mar_augmentation_id id, float mat[])
+{
+  // Check if augmentation has not been initialized
+  if (ctx == NULL)
+  {
+    return MAR_ERROR_AUGMENTATION_NOT_INITIALIZED;
+  }
+  if (id >= ctx->augmentations_capacity || !ctx->augmentations[id].initialized)
+  {
+    return MAR_ERROR_AUGMENTATION_ID_DOES_NOT_EXIST;
+  }
+
+  // Fill the matrix
+  mat[0]  = ctx->augmentations[id].transform.a;
+  mat[1]  = ctx->augmentations[id].transform.c;
+  mat[2]  = 0;
+  mat[3]  = 0;
+  mat[4]  = ctx->augmentations[id].transform.b;
+  mat[5]  = ctx->augmentations[id].transform.d;
+  mat[6]  = 0;
+  mat[7]  = 0;
+  mat[8]  = 0;
+  mat[9]  = 0;
+  mat[10] = 1;
+  mat[11] = 0;
+  mat[12] = ctx->augmentations[id].transform.tx;
+  mat[13] = ctx->augmentations[id].transform.ty;
+  mat[14] = 0;
+  mat[15] = 1;
+
+  return MAR_ERROR_NONE;
+}
+
+/**
+ * Loads the transformation matrix for a given augmentation in a 4x4 column major matrix.  With a motion model,
+ * the transformation of an augmentation lost for a few frames is predicted from how it was moving.
+ *
+ * @param id The augmentation's ID
+ * @param id Will be filled with the matrices values in a column major ordering.  
+ *
+ * @return MAR_ERROR_NONE on success, an error code on failure.
+ */
+MAR_PUBLIC
+mar_error_code mar_augment_get_transformation(mar_augmentation_id id, float mat[])
+{
+  return mar_augment_ctx_get_transformation(mar_augment_default_ctx, id, mat);
+}
+
+/**
+ * Returns the last error code for a specific augmentation
+ *
+ * @param ctx The augmentation context
+ * @param id The augmentation's ID
+ *
+ * @return MAR_ERROR_NONE on success, an error code on failure.
+ */
+MAR_PUBLIC
+mar_error_code mar_augment_ctx_get_augmentation_error(mar_augment_ctx *ctx, mar_augmentation_id id)
+{
+  if (ctx == NULL || id >= ctx->augmentations_capacity || !ctx->augmentations[id].initialized)
+  {
+    return MAR_ERROR_AUGMENTATION_ID_DOES_NOT_EXIST;
+  }
+
+  return ctx->augmentations[id].error;
+}
+
+/**
+ * Returns the last error code for a specific augmentation
+ *
+ * @param id The augmentation's ID
+ *
+ * @return MAR_ERROR_NONE on success, an error code on failure.
+ */
+MAR_PUBLIC
+mar_error_code mar_augmentation_get_error(mar_augmentation_id id)
+{
+  return mar_augment_ctx_get_augmentation_error(mar_augment_default_ctx, id);
+}
+
+/**
+ * Returns the number of matched keypoints which agree with the last transformation of a specific augmentation.
+ * The more keypoints agree, the more confident the transformation is.
+ *
+ * @param ctx The augmentation context
+ * @param id The augmentation's ID
+ *
+ * @return The number of agreeing keypoints, 0 if the last transformation could not be found
+ */
+MAR_PUBLIC
+int mar_augment_ctx_get_augmentation_num_inliers(mar_augment_ctx *ctx, mar_augmentation_id id)
+{
+  if (ctx == NULL || id >= ctx->augmentations_capacity || !ctx->augmentations[id].initialized)
+  {
+    return 0;
+  }
+
+  return ctx->augmentations[id].num_inliers;
+}
+
+/**
+ * Returns the number of matched keypoints which agree with the last transformation of a specific augmentation.
+ * The more keypoints agree, the more confident the transformation is.
+ *
+ * @param id The augmentation's ID
+ *
+ * @return The number of agreeing keypoints, 0 if the last transformation could not be found
+ */
+MAR_PUBLIC
+int mar_augmentation_get_num_inliers(mar_augmentation_id id)
+{
+  return mar_augment_ctx_get_augmentation_num_inliers(mar_augment_default_ctx, id);
+}
+
+/**
+ * Finds a free augmentation ID, growing the augmentations when every ID is in use.  The ID stays on the free
+ * list until the augmentation using it has been created.
+ *
+ * @param ctx The augmentation context
+ * @param i Will be filled with the free ID
+ *
+ * @return MAR_ERROR_NONE on success, MAR_ERROR_NO_AUGMENTATION_RESOURCES_AVAILABLE if MAR_MAX_NUMBER_OF_AUGMENTATIONS
+ *         IDs are in use, MAR_ERROR_MALLOC if the augmentations could not grow
+ */
+MAR_PRIVATE
+mar_error_code mar_augment_find_free_id(mar_augment_ctx *ctx, int *i)
+{
+  int j, capacity;
+  mar_augmentation *augmentations;
+
+  if (ctx->augmentations_free == -1)
+  {
+    if (ctx->augmentations_capacity >= MAR_MAX_NUMBER_OF_AUGMENTATIONS)
+    {
+      return MAR_ERROR_NO_AUGMENTATION_RESOURCES_AVAILABLE;
+    }
+
+    // Only the poses are grown, the keypoints of each augmentation live in their own allocation
+    capacity = ctx->augmentations_capacity > 0 ? ctx->augmentations_capacity * 2 : MAR_AUGMENT_INITIAL_CAPACITY;
+    capacity = capacity < MAR_MAX_NUMBER_OF_AUGMENTATIONS ? capacity : MAR_MAX_NUMBER_OF_AUGMENTATIONS;
+    augmentations = (mar_augmentation *)mar_realloc(ctx->augmentations, capacity * sizeof(mar_augmentation));
+    if (augmentations == NULL)
+    {
+      return MAR_ERROR_MALLOC;
+    }
+
+    // The new IDs are pushed from the highest so that the lowest is used first
+    for (j = capacity - 1; j >= ctx->augmentations_capacity; j--)
+    {
+      MAR_CLEAR(augmentations[j]);
+      augmentations[j].next_free = ctx->augmentations_free;
+      ctx->augmentations_free = j;
+    }
+    ctx->augmentations = augmentations;
+    ctx->augmentations_capacity = capacity;
+  }
+
+  *i = ctx->augmentations_free;
+
+  return MAR_ERROR_NONE;
+}
+
+/**
+ * Finds a free augmentation ID and prepares its keypoint storage, keeping that of a previous augmentation using
+ * the ID.  The keypoint indices are left empty.  The ID stays on the free list until mar_augment_take_id.
+ *
+ * @param ctx The augmentation context
+ * @param i Will be filled with the free ID
+ *
+ * @return MAR_ERROR_NONE on success, an error code on failure.
+ */
+MAR_PRIVATE
+mar_error_code mar_augment_prepare_surface(mar_augment_ctx *ctx, int *i)
+{
+  mar_augmentation_surface *surface;
+  mar_error_code mrv;
+
+  mrv = mar_augment_find_free_id(ctx, i);
+  if (mrv != MAR_ERROR_NONE)
+  {
+    return mrv;
+  }
+
+  // Create the keypoint storage, keeping that of a previous augmentation in this spot
+  if (ctx->augmentations[*i].surface == NULL)
+  {
+    surface = (mar_augmentation_surface *)mar_calloc(1, sizeof(mar_augmentation_surface));
+    if (surface == NULL)
+    {
+      return MAR_ERROR_MALLOC;
+    }
+    ctx->augmentations[*i].surface = surface;
+  }
+  surface = ctx->augmentations[*i].surface;
+  surface->num_flow_points = 0;
+  memset(surface->keypoint_hits, 0, sizeof(surface->keypoint_hits));
+  memset(surface->keypoint_misses, 0, sizeof(surface->keypoint_misses));
+
+  // Create the keypoint indices, whose descriptor storage grows as keypoints are added
+  if (surface->index.capacity == 0)
+  {
+    mrv = mar_keypoint_index_new(&surface->index, MAR_MAX_NUMBER_OF_AUGMENTATION_KEYPOINTS, 
+        ctx->index_format, ctx->index_trees, ctx->index_max_comparisons);
+    if (mrv != MAR_ERROR_NONE)
+    {
+      return mrv;
+    }
+  }
+  if (surface->potential_index.capacity == 0)
+  {
+    // The potential keypoints change every frame, so they are never worth building a forest for
+    mrv = mar_keypoint_index_new(&surface->potential_index, MAR_MAX_NUMBER_OF_AUGMENTATION_KEYPOINTS, 
+        ctx->index_format, 0, 0);
+    if (mrv != MAR_ERROR_NONE)
+    {
+      return mrv;
+    }
+  }
+  mar_keypoint_index_clear(&surface->index);
+  mar_keypoint_index_clear(&surface->potential_index);
+
+  return MAR_ERROR_NONE;
+}
+
+/**
+ * Initializes an augmentation whose keypoint storage has been filled, taking its ID off the free list.
+ *
+ * @param ctx The augmentation context
+ * @param i The ID prepared by mar_augment_prepare_surface
+ * @param view The index of the view the augmentation is tracked in
+ * @param transform The transformation the augmentation starts from
+ * @param transform_inverse The inverse of the transformation
+ */
+MAR_PRIVATE
+void mar_augment_take_id(mar_augment_ctx *ctx, int i, int view, const mar_affine *transform, const mar_affine *transform_inverse)
+{
+  ctx->augmentations_free = ctx->augmentations[i].next_free;
+  ctx->augmentations[i].next_free = -1;
+  ctx->augmentations[i].view = view;
+  ctx->augmentations[i].error = MAR_ERROR_NONE;
+  ctx->augmentations[i].num_inliers = 0;
+  ctx->augmentations[i].num_matches = 0;
+  mar_motion_reset(&ctx->augmentations[i].motion, transform);
+  ctx->steady_frames = 0;
+  ctx->number_of_augmentations++;
+  ctx->views[view].number_of_augmentations++;
+  ctx->augmentations[i].initialized = 1;
+
+  // Set the transformation matrices
+  ctx->augmentations[i].transform = *transform;
+  ctx->augmentations[i].transform_inverse = *transform_inverse;
+}
+
+/**
+ * Creates a new augmentation tracked in a view from the view's current frame.
+ *
+ * @param ctx The augmentation context
+ * @param view The index of the view whose current frame the MSER was found in
+ * @param id Will be willed in with the augmentation's ID
+ * @param region The MSER to track for augmentation
+ * 
+ * @return MAR_ERROR_NONE on success, an error code on failure.
+ */
+MAR_PRIVATE
+mar_error_code mar_augment_create_augmentation(mar_augment_ctx *ctx, int view, mar_augmentation_id *id, mar_mser *region)
+{
+  int i, j, k, l, num_keypoints, num_contained, frame_num_keypoints, *contained;
+  float scale;
+  mar_sift_keypoint *frame_keypoints;
+  mar_augmentation_surface *surface;
+  mar_affine ellipse, normalization, normalization_inverse;
+  mar_augment_view *v;
+  mar_error_code mrv;
+  uint64_t start;
+
+  // Check if augmentation has not been initialized
+  if (ctx == NULL)
+  {
+    return MAR_ERROR_AUGMENTATION_NOT_INITIALIZED;
+  }
+
+  if (view < 0 || view >= ctx->num_views)
+  {
+    return MAR_ERROR_INVALID_ARGUMENT;
+  }
+  v = &ctx->views[view];
+
+  // Find a new spot for the augmentation, which is only taken once the augmentation is created
+  mrv = mar_augment_prepare_surface(ctx, &i);
+  if (mrv != MAR_ERROR_NONE)
+  {
+    return mrv;
+  }
+  ctx->augmentations[i].mser = *region;
+  surface = ctx->augmentations[i].surface;
+
+  // Copy the keypoints within the ellipse to a buffer
+  num_keypoints = 0;
+  mrv = mar_augment_get_full_frame_keypoints(v, &frame_keypoints, &frame_num_keypoints);
+  if (mrv != MAR_ERROR_NONE)
+  {
+    return mrv;
+  }
+
+  // Find the keypoints within the MSER's ellipse
+  num_contained = 0;
+  contained = NULL;
+  if (v->current_frame != NULL && frame_num_keypoints > 0)
+  {
+    contained = (int *)mar_arena_alloc(&v->current_frame->arena, frame_num_keypoints * sizeof(int));
+    if (contained == NULL)
+    {
+      return MAR_ERROR_MALLOC;
+    }
+    start = mar_stats_now();
+    mar_augment_get_ellipse(region->ellipse_x, region->ellipse_y, region->ellipse_a, region->ellipse_b, region->ellipse_angle, &ellipse);
+    mar_keypoint_grid_query_ellipse(&v->current_frame->grid, &ellipse, contained, &num_contained);
+    mar_stats_histogram_add(&ctx->stage_latencies[MAR_AUGMENT_STAGE_CONTAINMENT], mar_stats_now() - start);
+  }
+
+  // Normalize the keypoints by the MSER's center and mean axis
+  scale = (region->ellipse_a + region->ellipse_b) / 2;
+  for (j = 0; j < num_contained; j++)
+  {
+    k = contained[j];
+    l = j % MAR_MAX_NUMBER_OF_AUGMENTATION_KEYPOINTS;
+    mrv = mar_keypoint_index_set_keypoint(&surface->index, l, &frame_keypoints[k]);
+    if (mrv != MAR_ERROR_NONE)
+    {
+      return mrv;
+    }
+    surface->initial_x[l] = (frame_keypoints[k].x - region->ellipse_x) / scale;
+    surface->initial_y[l] = (frame_keypoints[k].y - region->ellipse_y) / scale;
+    num_keypoints = num_keypoints >= MAR_MAX_NUMBER_OF_AUGMENTATION_KEYPOINTS ? MAR_MAX_NUMBER_OF_AUGMENTATION_KEYPOINTS : num_keypoints + 1;
+  }
+  surface->num_initial_keypoints = num_keypoints;
+
+  // Check if enough keypoints exist to create an augmentation
+  if (num_keypoints < MAR_MINIMUM_AUGMENTATION_KEYPOINTS)
+  {
+    return MAR_ERROR_TOO_FEW_KEYPOINTS;
+  }
+
+  // The surface starts where the keypoints were normalized from, so the first frame searches the MSER's ellipse
+  normalization.a = normalization.d = scale;
+  normalization.b = normalization.c = 0;
+  normalization.tx = region->ellipse_x;
+  normalization.ty = region->ellipse_y;
+  if (mar_affine_invert(&normalization, &normalization_inverse) != MAR_ERROR_NONE)
+  {
+    return MAR_ERROR_DEGENERATE_TRANSFORM;
+  }
+
+  // Initialize augmentation at the normalization, taking its ID off the free list
+  *id = i;
+  mar_augment_take_id(ctx, i, view, &normalization, &normalization_inverse);
+
+  return MAR_ERROR_NONE;
+}
+
+/**
+ * Creates a new augmentation tracked in a view, reusing freed IDs before new ones.  IDs are shared by every view.
+ *
+ * @param ctx The augmentation context
+ * @param view The index of the view whose current frame the MSER was found in
+ * @param id Will be willed in with the augmentation's ID
+ * @param region The MSER to track for augmentation
+ * 
+ * @return MAR_ERROR_NONE on success, an error code on failure.
+ */
+MAR_PUBLIC
+mar_error_code mar_augment_ctx_view_new_augmentation(mar_augment_ctx *ctx, int view, mar_augmentation_id *id, mar_mser *region)
+{
+  mar_error_code mrv;
+
+  mrv = mar_augment_create_augmentation(ctx, view, id, region);
+
+  // Failed calls are recorded too, since they may still have grown the augmentations
+  if (ctx != NULL)
+  {
+    mar_augment_record_event(ctx, MAR_CAPTURE_LOG_EVENT_NEW_AUGMENTATION, view, mrv == MAR_ERROR_NONE ? (int)*id : -1, mrv, region);
+  }
+
+  return mrv;
+}
+
+/**
+ * Creates a new augmentation tracked in a view, reusing freed IDs before new ones.  IDs are shared by every view.
+ *
+ * @param view The index of the view whose current frame the MSER was found in
+ * @param id Will be willed in with the augmentation's ID
+ * @param region The MSER to track for augmentation
+ * 
+ * @return MAR_ERROR_NONE on success, an error code on failure.
+ */
+MAR_PUBLIC
+mar_error_code mar_augment_view_new_augmentation(int view, mar_augmentation_id *id, mar_mser *region)
+{
+  return mar_augment_ctx_view_new_augmentation(mar_augment_default_ctx, view, id, region);
+}
+
+/**
+ * Creates a new augmentation tracked in the first view, reusing freed IDs before new ones
+ *
+ * @param id Will be willed in with the augmentation's ID
+ * @param region The MSER to track for augmentation
+ * 
+ * @return MAR_ERROR_NONE on success, an error code on failure.
+ */
+MAR_PUBLIC
+mar_error_code mar_augment_new_augmentation(mar_augmentation_id *id, mar_mser *region)
+{
+  return mar_augment_view_new_augmentation(0, id, region);
+}
+
+/**
+ * Augments a point using the affine transformation matrix of a MAR augmentation.
+ *
+ * @param ctx The augmentation context
+ * @param id The ID of the augmentation to use
+ * @param x The X coordinate of the point
+ * @param y The Y coordinate of the point
+ * @param tx Will be set to the transformed X coordinate of the point
+ * @param ty Will be set to the transformed Y coordinate of the point
+ * 
+ * @return MAR_ERROR_NONE on success, an error code on failure.
+ */
+MAR_PUBLIC
+mar_error_code mar_augment_ctx_transform_point(mar_augment_ctx *ctx, mar_augmentation_id id, float x, float y, float *tx, float *ty)
+{
+  const mar_affine *t;
+
+  // Check if augmentation has not been initialized
+  if (ctx == NULL)
+  {
+    return MAR_ERROR_AUGMENTATION_NOT_INITIALIZED;
+  }
+  if (id >= ctx->augmentations_capacity || !ctx->augmentations[id].initialized)
+  {
+    return MAR_ERROR_AUGMENTATION_ID_DOES_NOT_EXIST;
+  }
+
+  t = &ctx->augmentations[id].transform;
+  *tx = t->a * x + t->b * y + t->tx;
+  *ty = t->c * x + t->d * y + t->ty;
+
+  return MAR_ERROR_NONE;
+}
+
+/**
+ * Augments a point using the affine transformation matrix of a MAR augmentation.
+ *
+ * @param id The ID of the augmentation to use
+ * @param x The X coordinate of the point
+ * @param y The Y coordinate of the point
+ * @param tx Will be set to the transformed X coordinate of the point
+ * @param ty Will be set to the transformed Y coordinate of the point
+ * 
+ * @return MAR_ERROR_NONE on success, an error code on failure.
+ */
+MAR_PUBLIC
+mar_error_code mar_augment_transform_point(mar_augmentation_id id, float x, float y, float *tx, float *ty)
+{
+  return mar_augment_ctx_transform_point(mar_augment_default_ctx, id, x, y, tx, ty);
+}
+
+/**
+ * Deaugments a point using the affine transformation matrix of a MAR augmentation.  Changes the transform from the
+ * current frame's transform to the initial frame's transform.
+ *
+ * @param ctx The augmentation context
+ * @param id The ID of the augmentation to use
+ * @param x The X coordinate of the point
+ * @param y The Y coordinate of the point
+ * @param tx Will be set to the untransformed X coordinate of the point
+ * @param ty Will be set to the untransformed Y coordinate of the point
+ * 
+ * @return MAR_ERROR_NONE on success, an error code on failure.
+ */
+MAR_PUBLIC
+mar_error_code mar_augment_ctx_untransform_point(mar_augment_ctx *ctx, mar_augmentation_id id, float x, float y, float *tx, float *ty)
+{
+  const mar_affine *t;
+
+  // Check if augmentation has not been initialized
+  if (ctx == NULL)
+  {
+    return MAR_ERROR_AUGMENTATION_NOT_INITIALIZED;
+  }
+  if (id >= ctx->augmentations_capacity || !ctx->augmentations[id].initialized)
+  {
+    return MAR_ERROR_AUGMENTATION_ID_DOES_NOT_EXIST;
+  }
+
+  t = &ctx->augmentations[id].transform_inverse;
+  *tx = t->a * x + t->b * y + t->tx;
+  *ty = t->c * x + t->d * y + t->ty;
+
+  return MAR_ERROR_NONE;
+}
+
+/**
+ * Deaugments a point using the affine transformation matrix of a MAR augmentation.  Changes the transform from the
+ * current frame's transform to the initial frame's transform.
+ *
+ * @param id The ID of the augmentation to use
+ * @param x The X coordinate of the point
+ * @param y The Y coordinate of the point
+ * @param tx Will be set to the untransformed X coordinate of the point
+ * @param ty Will be set to the untransformed Y coordinate of the point
+ * 
+ * @return MAR_ERROR_NONE on success, an error code on failure.
+ */
+MAR_PUBLIC
+mar_error_code mar_augment_untransform_point(mar_augmentation_id id, float x, float y, float *tx, float *ty)
+{
+  return mar_augment_ctx_untransform_point(mar_augment_default_ctx, id, x, y, tx, ty);
+}
+
+/**
+ * Frees an augmentation.  Its ID is reused by a later augmentation, which also reuses its keypoint storage.
+ *
+ * @param ctx The augmentation context
+ * @param id The augmentation ID
+ */
+MAR_PUBLIC
+void mar_augment_ctx_free_augmentation(mar_augment_ctx *ctx, mar_augmentation_id id)
+{
+  if (ctx != NULL && id < ctx->augmentations_capacity && ctx->augmentations[id].initialized)
+  {
+    ctx->augmentations[id].initialized = 0;
+    ctx->augmentations[id].next_free = ctx->augmentations_free;
+    ctx->augmentations_free = id;
+    ctx->number_of_augmentations--;
+    ctx->views[ctx->augmentations[id].view].number_of_augmentations--;
+    ctx->steady_frames = 0;
+    mar_augment_record_event(ctx, MAR_CAPTURE_LOG_EVENT_FREE_AUGMENTATION, 0, id, MAR_ERROR_NONE, NULL);
+  }
+}
+
+/**
+ * Frees an augmentation.  Its ID is reused by a later augmentation, which also reuses its keypoint storage.
+ *
+ * @param id The augmentation ID
+ */
+MAR_PUBLIC
+void mar_augment_free_augmentation(mar_augmentation_id id)
+{
+  mar_augment_ctx_free_augmentation(mar_augment_default_ctx, id);
+}
+
+/**
+ * Saves the models of every augmentation to a model cache, replacing any file of the same name once every model
+ * is written, so that they can be loaded by mar_augment_ctx_load_models in a later session.  Each model keeps its
+ * MSER, its keypoints and the transformation it was last tracked at.
+ *
+ * @param ctx The augmentation context
+ * @param file_name The file to write
+ *
+ * @return MAR_ERROR_NONE on success, an error code on failure.
+ */
+MAR_PUBLIC
+mar_error_code mar_augment_ctx_save_models(mar_augment_ctx *ctx, const char *file_name)
+{
+  mar_model_cache_writer *writer;
+  mar_model_cache_model model;
+  mar_augmentation *a;
+  mar_error_code mrv;
+  uint32_t descriptor_size = 0;
+  int i;
+
+  if (ctx == NULL)
+  {
+    return MAR_ERROR_AUGMENTATION_NOT_INITIALIZED;
+  }
+
+  // Every augmentation's index has the format of the context, so any of them gives the descriptor size
+  for (i = 0; i < ctx->augmentations_capacity && descriptor_size == 0; i++)
+  {
+    if (ctx->augmentations[i].surface != NULL && ctx->augmentations[i].surface->index.capacity != 0)
+    {
+      descriptor_size = mar_keypoint_index_get_descriptor_size(&ctx->augmentations[i].surface->index);
+    }
+  }
+
+  mrv = mar_model_cache_writer_new(&writer, file_name, (uint32_t)ctx->index_format, descriptor_size);
+  if (mrv != MAR_ERROR_NONE)
+  {
+    return mrv;
+  }
+
+  for (i = 0; i < ctx->augmentations_capacity; i++)
+  {
+    a = &ctx->augmentations[i];
+    if (!a->initialized || a->surface->num_initial_keypoints <= 0)
+    {
+      continue;
+    }
+
+    MAR_CLEAR(model);
+    model.view = a->view;
+    model.num_keypoints = a->surface->num_initial_keypoints;
+    model.ellipse_x = a->mser.ellipse_x;
+    model.ellipse_y = a->mser.ellipse_y;
+    model.ellipse_a = a->mser.ellipse_a;
+    model.ellipse_b = a->mser.ellipse_b;
+    model.ellipse_angle = a->mser.ellipse_angle;
+    model.pose[0] = a->transform.a;
+    model.pose[1] = a->transform.b;
+    model.pose[2] = a->transform.c;
+    model.pose[3] = a->transform.d;
+    model.pose[4] = a->transform.tx;
+    model.pose[5] = a->transform.ty;
+    mrv = mar_model_cache_write_model(writer, &model, a->surface->initial_x, a->surface->initial_y, a->surface->keypoint_hits,
+        a->surface->keypoint_misses, mar_keypoint_index_get_descriptor(&a->surface->index, 0));
+    if (mrv != MAR_ERROR_NONE)
+    {
+      break;
+    }
+  }
+
+  // A cache which failed to write does not replace the last one
+  return mar_model_cache_writer_free(writer);
+}
+
+/**
+ * Saves the models of every augmentation to a model cache, as mar_augment_ctx_save_models.
+ *
+ * @param file_name The file to write
+ *
+ * @return MAR_ERROR_NONE on success, an error code on failure.
+ */
+MAR_PUBLIC
+mar_error_code mar_augment_save_models(const char *file_name)
+{
+  return mar_augment_ctx_save_models(mar_augment_default_ctx, file_name);
+}
+
+/**
+ * Creates an augmentation for each model of a model cache saved by mar_augment_ctx_save_models, without selecting
+ * its region again.  Each augmentation starts at the transformation its model was last tracked at and is found
+ * again by the usual search of the view's frames.  Models of views the context does not have are skipped.  Loaded
+ * augmentations are not recorded into capture logs.
+ *
+ * @param ctx The augmentation context
+ * @param file_name The file to read
+ * @param ids Will be filled with the IDs of the first max_ids augmentations created, may be NULL if max_ids is 0
+ * @param max_ids The size of the ids array
+ * @param num_ids Will be filled with the number of augmentations created
+ *
+ * @return MAR_ERROR_NONE on success, MAR_ERROR_MODEL_CACHE_NOT_FOUND if the cache does not exist,
+ *         MAR_ERROR_READING_MODEL_CACHE if the cache is not valid or its descriptors are not in the format of the
+ *         context, an error code on failure, in which case the augmentations created before the failure are kept.
+ */
+MAR_PUBLIC
+mar_error_code mar_augment_ctx_load_models(mar_augment_ctx *ctx, const char *file_name, mar_augmentation_id *ids, int max_ids, int *num_ids)
+{
+  mar_model_cache *cache;
+  mar_model_cache_entry entry;
+  mar_augmentation_surface *surface;
+  mar_affine pose, pose_inverse;
+  mar_error_code mrv;
+  uint32_t m, j, num_keypoints;
+  int i;
+
+  *num_ids = 0;
+  if (ctx == NULL)
+  {
+    return MAR_ERROR_AUGMENTATION_NOT_INITIALIZED;
+  }
+
+  mrv = mar_model_cache_open(&cache, file_name);
+  if (mrv != MAR_ERROR_NONE)
+  {
+    return mrv;
+  }
+  if (cache->descriptor_format != (uint32_t)ctx->index_format)
+  {
+    mar_model_cache_free(cache);
+    return MAR_ERROR_READING_MODEL_CACHE;
+  }
+
+  for (m = 0; m < cache->num_models; m++)
+  {
+    mar_model_cache_get_model(cache, m, &entry);
+    if (entry.model->view < 0 || entry.model->view >= ctx->num_views)
+    {
+      continue;
+    }
+    num_keypoints = entry.model->num_keypoints;
+    if (num_keypoints < MAR_MINIMUM_AUGMENTATION_KEYPOINTS || num_keypoints > MAR_MAX_NUMBER_OF_AUGMENTATION_KEYPOINTS)
+    {
+      mrv = MAR_ERROR_READING_MODEL_CACHE;
+      break;
+    }
+
+    mrv = mar_augment_prepare_surface(ctx, &i);
+    if (mrv != MAR_ERROR_NONE)
+    {
+      break;
+    }
+    surface = ctx->augmentations[i].surface;
+    if (cache->descriptor_size != (uint32_t)mar_keypoint_index_get_descriptor_size(&surface->index))
+    {
+      mrv = MAR_ERROR_READING_MODEL_CACHE;
+      break;
+    }
+
+    // Copy the keypoints out of the mapping, which is unmapped once every model is loaded
+    for (j = 0; j < num_keypoints && mrv == MAR_ERROR_NONE; j++)
+    {
+      mrv = mar_keypoint_index_set_descriptor(&surface->index, j, (const unsigned char *)entry.descriptors + j * cache->descriptor_size);
+    }
+    if (mrv != MAR_ERROR_NONE)
+    {
+      break;
+    }
+    memcpy(surface->initial_x, entry.initial_x, num_keypoints * sizeof(float));
+    memcpy(surface->initial_y, entry.initial_y, num_keypoints * sizeof(float));
+    memcpy(surface->keypoint_hits, entry.hits, num_keypoints * sizeof(unsigned short));
+    memcpy(surface->keypoint_misses, entry.misses, num_keypoints * sizeof(unsigned short));
+    surface->num_initial_keypoints = num_keypoints;
+
+    MAR_CLEAR(ctx->augmentations[i].mser);
+    ctx->augmentations[i].mser.ellipse_x = entry.model->ellipse_x;
+    ctx->augmentations[i].mser.ellipse_y = entry.model->ellipse_y;
+    ctx->augmentations[i].mser.ellipse_a = entry.model->ellipse_a;
+    ctx->augmentations[i].mser.ellipse_b = entry.model->ellipse_b;
+    ctx->augmentations[i].mser.ellipse_angle = entry.model->ellipse_angle;
+
+    // A degenerate last pose starts from the normalization instead, as a new augmentation would
+    pose.a = entry.model->pose[0];
+    pose.b = entry.model->pose[1];
+    pose.c = entry.model->pose[2];
+    pose.d = entry.model->pose[3];
+    pose.tx = entry.model->pose[4];
+    pose.ty = entry.model->pose[5];
+    if (mar_affine_invert(&pose, &pose_inverse) != MAR_ERROR_NONE)
+    {
+      pose.a = pose.d = (entry.model->ellipse_a + entry.model->ellipse_b) / 2;
+      pose.b = pose.c = 0;
+      pose.tx = entry.model->ellipse_x;
+      pose.ty = entry.model->ellipse_y;
+      if (mar_affine_invert(&pose, &pose_inverse) != MAR_ERROR_NONE)
+      {
+        mrv = MAR_ERROR_READING_MODEL_CACHE;
+        break;
+      }
+    }
+
+    mar_augment_take_id(ctx, i, entry.model->view, &pose, &pose_inverse);
+    if (*num_ids < max_ids)
+    {
+      ids[*num_ids] = i;
+    }
+    (*num_ids)++;
+  }
+  mar_model_cache_free(cache);
+
+  return mrv;
+}
+
+/**
+ * Creates an augmentation for each model of a model cache, as mar_augment_ctx_load_models.
+ *
+ * @param file_name The file to read
+ * @param ids Will be filled with the IDs of the first max_ids augmentations created, may be NULL if max_ids is 0
+ * @param max_ids The size of the ids array
+ * @param num_ids Will be filled with the number of augmentations created
+ *
+ * @return MAR_ERROR_NONE on success, MAR_ERROR_MODEL_CACHE_NOT_FOUND if the cache does not exist,
+ *         MAR_ERROR_READING_MODEL_CACHE if the cache is not valid or its descriptors are not in the format of the
+ *         context, an error code on failure, in which case the augmentations created before the failure are kept.
+ */
+MAR_PUBLIC
+mar_error_code mar_augment_load_models(const char *file_name, mar_augmentation_id *ids, int max_ids, int *num_ids)
+{
+  return mar_augment_ctx_load_models(mar_augment_default_ctx, file_name, ids, max_ids, num_ids);
+}
+
+/**
+ * Returns the maximally stable extremal regions for the current frame of a view.
+ * When MSER are detected in the background, they are the latest regions detected on the view's MSER thread,
+ * from a recent frame, and none are returned until the first detection finishes.
+ *
+ * @param ctx The augmentation context
+ * @param view The index of the view
+ * @param regions A pointer to a pointer which will be modified to point to the array of regions.
+ * @param num_regions The number of MSER, and the size of the regions array
+ *
+ * @return MAR_ERROR_NONE on success, an error code on failure.
+ */
+MAR_PUBLIC
+mar_error_code mar_augment_ctx_view_get_regions(mar_augment_ctx *ctx, int view, mar_mser **regions, int *num_regions)
+{
+  mar_augment_view *v;
+  mar_error_code mrv;
+  const unsigned char *gray;
+  int level, width, height;
+  uint64_t start;
+
+  // Check if augmentation has not been initialized
+  if (ctx == NULL)
+  {
+    return MAR_ERROR_AUGMENTATION_NOT_INITIALIZED;
+  }
+
+  if (view < 0 || view >= ctx->num_views)
+  {
+    return MAR_ERROR_INVALID_ARGUMENT;
+  }
+  v = &ctx->views[view];
+
+  // Return the latest regions of the MSER thread, which keeps detecting them while they are asked for
+  if (ctx->mser_background)
+  {
+    v->mser_requested_update = ctx->num_updates;
+    if (!v->mser_running)
+    {
+      mrv = mar_augment_start_mser(v);
+      if (mrv != MAR_ERROR_NONE)
+      {
+        return mrv;
+      }
+      mar_augment_schedule_regions(v);
+    }
+    pthread_mutex_lock(&v->mser_mutex);
+    mrv = v->mser_error;
+    pthread_mutex_unlock(&v->mser_mutex);
+    *regions = v->mser_regions;
+    *num_regions = v->mser_num_regions;
+    return mrv;
+  }
+
+  // Check if we have already calculated MSER this frame - if so then use the cached results
+  if (v->mser_calculated_this_frame)
+  {
+    *regions = v->mser_regions;  
+    *num_regions = v->mser_num_regions;
+    return MAR_ERROR_NONE;
+  }
+  else
+  {
+    // Calculate and return MSER
+    if (v->current_frame == NULL)
+    {
+      *regions = NULL;
+      *num_regions = 0;
+      return MAR_ERROR_NONE;
+    }
+
+    // Detect in the coarser of the configured level and the level chosen by the governor and scale the regions back to the frame
+    start = mar_stats_now();
+    level = ctx->governor_mser_level > ctx->mser_level ? ctx->governor_mser_level : ctx->mser_level;
+    gray = mar_image_pyramid_get_gray(&v->current_frame->pyramid, level, &width, &height);
+    if (gray == NULL)
+    {
+      return MAR_ERROR_INVALID_ARGUMENT;
+    }
+    mrv = mar_augment_refresh_mser(v);
+    if (mrv == MAR_ERROR_NONE)
+    {
+      mrv = mar_mser_ctx_set_size(&v->mser, width, height);
+    }
+    if (mrv != MAR_ERROR_NONE)
+    {
+      return mrv;
+    }
+    mrv = mar_mser_ctx_get_regions_from_grayscale(&v->mser, &v->mser_regions, &v->mser_num_regions, 
+        gray, mar_image_pyramid_get_inverse(&v->current_frame->pyramid, level));
+    if (mrv == MAR_ERROR_NONE)
+    {
+      mar_augment_scale_regions(v->mser_regions, v->mser_num_regions, level);
+      mar_stats_histogram_add(&ctx->stage_latencies[MAR_AUGMENT_STAGE_MSER], mar_stats_now() - start);
+      *regions = v->mser_regions;  
+      *num_regions = v->mser_num_regions; 
+      v->mser_calculated_this_frame = 1;
+    }
+    return mrv;
+  }
+}
+
+/**
+ * Returns the maximally stable extremal regions for the current frame of a view.
+ * When MSER are detected in the background, they are the latest regions detected on the view's MSER thread,
+ * from a recent frame, and none are returned until the first detection finishes.
+ *
+ * @param view The index of the view
+ * @param regions A pointer to a pointer which will be modified to point to the array of regions.
+ * @param num_regions The number of MSER, and the size of the regions array
+ *
+ * @return MAR_ERROR_NONE on success, an error code on failure.
+ */
+MAR_PUBLIC
+mar_error_code mar_augment_view_get_regions(int view, mar_mser **regions, int *num_regions)
+{
+  return mar_augment_ctx_view_get_regions(mar_augment_default_ctx, view, regions, num_regions);
+}
+
+/**
+ * Returns the maximally stable extremal regions for the current frame of the first view.
+ * When MSER are detected in the background, they are the latest regions detected on the view's MSER thread,
+ * from a recent frame, and none are returned until the first detection finishes.
+ *
+ * @param regions A pointer to a pointer which will be modified to point to the array of regions.
+ * @param num_regions The number of MSER, and the size of the regions array
+ *
+ * @return MAR_ERROR_NONE on success, an error code on failure.
+ */
+MAR_PUBLIC
+mar_error_code mar_augment_get_regions(mar_mser **regions, int *num_regions)
+{
+  return mar_augment_view_get_regions(0, regions, num_regions);
+}
+
+/**
+ * Returns the SIFT keypoints for the current frame of a view.
+ *
+ * @param ctx The augmentation context
+ * @param view The index of the view
+ * @param keypoints A pointer to a pointer which will be modified to point to the array of keypoints.
+ * @param num_keypoints The number of SIFT keypoints, and the size of the regions array
+ *
+ * @return MAR_ERROR_NONE on success, an error code on failure.
+ */
+MAR_PUBLIC
+mar_error_code mar_augment_ctx_view_get_keypoints(mar_augment_ctx *ctx, int view, mar_sift_keypoint **keypoints, int *num_keypoints)
+{
+  mar_augment_view *v;
+  mar_error_code mrv;
+
+  // Check if augmentation has not been initialized
+  if (ctx == NULL)
+  {
+    return MAR_ERROR_AUGMENTATION_NOT_INITIALIZED;
+  }
+
+  if (view < 0 || view >= ctx->num_views)
+  {
+    return MAR_ERROR_INVALID_ARGUMENT;
+  }
+  v = &ctx->views[view];
+
+  // Check if there is a frame yet
+  if (v->current_frame == NULL)
+  {
+    *keypoints = NULL;
+    *num_keypoints = 0;
+    return MAR_ERROR_NONE;
+  }
+
+  // Check if we have already updated the SIFT filter this frame - if not then calculate the keypoints,
+  // which the detection thread always does when pipelined
+  if (!v->current_frame->sift_calculated)
+  {
+    if (v->pipeline_running)
+    {
+      *keypoints = NULL;
+      *num_keypoints = 0;
+      return v->current_frame->error;
+    }
+
+    mrv = mar_augment_detect_keypoints(v, v->current_frame);
+    if (mrv != MAR_ERROR_NONE)
+    {
+      return mrv;
+    }
+  }
+
+  *keypoints = v->current_frame->keypoints;
+  *num_keypoints = v->current_frame->num_keypoints;
+
+  return MAR_ERROR_NONE;
+}
+
+/**
+ * Returns the SIFT keypoints for the current frame of a view.
+ *
+ * @param view The index of the view
+ * @param keypoints A pointer to a pointer which will be modified to point to the array of keypoints.
+ * @param num_keypoints The number of SIFT keypoints, and the size of the regions array
+ *
+ * @return MAR_ERROR_NONE on success, an error code on failure.
+ */
+MAR_PUBLIC
+mar_error_code mar_augment_view_get_keypoints(int view, mar_sift_keypoint **keypoints, int *num_keypoints)
+{
+  return mar_augment_ctx_view_get_keypoints(mar_augment_default_ctx, view, keypoints, num_keypoints);
+}
+
+/**
+ * Returns the SIFT keypoints for the current frame of the first view.
+ *
+ * @param keypoints A pointer to a pointer which will be modified to point to the array of keypoints.
+ * @param num_keypoints The number of SIFT keypoints, and the size of the regions array
+ *
+ * @return MAR_ERROR_NONE on success, an error code on failure.
+ */
+MAR_PUBLIC
+mar_error_code mar_augment_get_keypoints(mar_sift_keypoint **keypoints, int *num_keypoints)
+{
+  return mar_augment_view_get_keypoints(0, keypoints, num_keypoints);
+}
+
+/**
+ * Returns the number of views, one for each camera used for augmentation.
+ *
+ * @param ctx The augmentation context
+ *
+ * @return The number of views, 0 if augmentation has not been initialized
+ */
+MAR_PUBLIC
+int mar_augment_ctx_get_num_views(mar_augment_ctx *ctx)
+{
+  return ctx != NULL ? ctx->num_views : 0;
+}
+
+/**
+ * Returns the number of views, one for each camera used for augmentation.
+ *
+ * @return The number of views, 0 if augmentation has not been initialized
+ */
+MAR_PUBLIC
+int mar_augment_get_num_views()
+{
+  return mar_augment_ctx_get_num_views(mar_augment_default_ctx);
+}
+
+/**
+ * Returns the error of the last update of a view.
+ *
+ * @param ctx The augmentation context
+ * @param view The index of the view
+ *
+ * @return MAR_ERROR_NONE if the view's last update succeeded, an error code on failure.
+ */
+MAR_PUBLIC
+mar_error_code mar_augment_ctx_view_get_error(mar_augment_ctx *ctx, int view)
+{
+  if (ctx == NULL)
+  {
+    return MAR_ERROR_AUGMENTATION_NOT_INITIALIZED;
+  }
+
+  if (view < 0 || view >= ctx->num_views)
+  {
+    return MAR_ERROR_INVALID_ARGUMENT;
+  }
+
+  return ctx->views[view].error;
+}
+
+/**
+ * Returns the error of the last update of a view.
+ *
+ * @param view The index of the view
+ *
+ * @return MAR_ERROR_NONE if the view's last update succeeded, an error code on failure.
+ */
+MAR_PUBLIC
+mar_error_code mar_augment_view_get_error(int view)
+{
+  return mar_augment_ctx_view_get_error(mar_augment_default_ctx, view);
+}
+
+/**
+ * Returns the view an augmentation is tracked in.
+ *
+ * @param ctx The augmentation context
+ * @param id The augmentation's ID
+ *
+ * @return The index of the view, -1 if the augmentation does not exist
+ */
+MAR_PUBLIC
+int mar_augment_ctx_get_augmentation_view(mar_augment_ctx *ctx, mar_augmentation_id id)
+{
+  if (ctx == NULL || id >= ctx->augmentations_capacity || !ctx->augmentations[id].initialized)
+  {
+    return -1;
+  }
+
+  return ctx->augmentations[id].view;
+}
+
+/**
+ * Returns the view an augmentation is tracked in.
+ *
+ * @param id The augmentation's ID
+ *
+ * @return The index of the view, -1 if the augmentation does not exist
+ */
+MAR_PUBLIC
+int mar_augmentation_get_view(mar_augmentation_id id)
+{
+  return mar_augment_ctx_get_augmentation_view(mar_augment_default_ctx, id);
+}
+
+/**
+ * Fills the results of the last update for the augmentations of a view or of every view, in order of their IDs.
+ *
+ * @param ctx The augmentation context
+ * @param view The index of the view, or MAR_AUGMENT_ALL_VIEWS for the augmentations of every view
+ * @param results Will be filled with the results, max_results in size
+ * @param max_results The maximum number of results to fill
+ * @param num_results Will be filled with the number of results filled
+ *
+ * @return MAR_ERROR_NONE on success, an error code on failure.
+ */
+MAR_PUBLIC
+mar_error_code mar_augment_ctx_get_results(mar_augment_ctx *ctx, int view, mar_augmentation_result *results, int max_results, int *num_results)
+{
+  int i;
+
+  *num_results = 0;
+
+  // Check if augmentation has not been initialized
+  if (ctx == NULL)
+  {
+    return MAR_ERROR_AUGMENTATION_NOT_INITIALIZED;
+  }
+
+  if (view != MAR_AUGMENT_ALL_VIEWS && (view < 0 || view >= ctx->num_views))
+  {
+    return MAR_ERROR_INVALID_ARGUMENT;
+  }
+
+  for (i = 0; i < ctx->augmentations_capacity && *num_results < max_results; i++)
+  {
+    if (ctx->augmentations[i].initialized && (view == MAR_AUGMENT_ALL_VIEWS || ctx->augmentations[i].view == view))
+    {
+      results[*num_results].id = i;
+      results[*num_results].view = ctx->augmentations[i].view;
+      results[*num_results].error = ctx->augmentations[i].error;
+      results[*num_results].num_inliers = ctx->augmentations[i].num_inliers;
+      mar_augment_ctx_get_transformation(ctx, i, results[*num_results].transform);
+      (*num_results)++;
+    }
+  }
+
+  return MAR_ERROR_NONE;
+}
+
+/**
+ * Fills the results of the last update for the augmentations of a view or of every view, in order of their IDs.
+ *
+ * @param view The index of the view, or MAR_AUGMENT_ALL_VIEWS for the augmentations of every view
+ * @param results Will be filled with the results, max_results in size
+ * @param max_results The maximum number of results to fill
+ * @param num_results Will be filled with the number of results filled
+ *
+ * @return MAR_ERROR_NONE on success, an error code on failure.
+ */
+MAR_PUBLIC
+mar_error_code mar_augment_get_results(int view, mar_augmentation_result *results, int max_results, int *num_results)
+{
+  return mar_augment_ctx_get_results(mar_augment_default_ctx, view, results, max_results, num_results);
+}
+
+/**
+ * Acquires the latest snapshot of an augmentation context, holding the errors and results of its last update and
+ * the other contents asked for.  Contexts only publish snapshots once one has been asked for, so the first call
+ * returns MAR_ERROR_AGAIN until the next update.  Each update copies the contents asked for by the last call.  A
+ * snapshot never changes while it is held, so a reader should hold at most one at a time and release it quickly,
+ * and an update skips publishing when every other snapshot is held.  May be called from any thread while another
+ * thread updates the context.
+ *
+ * @param ctx The augmentation context
+ * @param contents The \ref augment_snapshot_contents "contents" the following snapshots should copy
+ * @param snapshot Will be filled with the snapshot, which must be released with mar_augment_ctx_release_snapshot
+ *
+ * @return MAR_ERROR_NONE on success, MAR_ERROR_AGAIN if no snapshot has been published yet.
+ */
+MAR_PUBLIC
+mar_error_code mar_augment_ctx_acquire_snapshot(mar_augment_ctx *ctx, int contents, const mar_augment_snapshot **snapshot)
+{
+  *snapshot = NULL;
+
+  // Check if augmentation has not been initialized
+  if (ctx == NULL)
+  {
+    return MAR_ERROR_AUGMENTATION_NOT_INITIALIZED;
+  }
+
+  pthread_mutex_lock(&ctx->snapshot_mutex);
+  ctx->snapshot_contents = contents;
+  if (ctx->snapshot_published != NULL)
+  {
+    ctx->snapshot_published->refs++;
+    *snapshot = ctx->snapshot_published;
+  }
+  pthread_mutex_unlock(&ctx->snapshot_mutex);
+  __atomic_store_n(&ctx->snapshots_enabled, 1, __ATOMIC_RELEASE);
+
+  return *snapshot != NULL ? MAR_ERROR_NONE : MAR_ERROR_AGAIN;
+}
+
+/**
+ * Acquires the latest snapshot of the augmentation, as mar_augment_ctx_acquire_snapshot.  May be called from any
+ * thread while another thread updates the augmentation.
+ *
+ * @param contents The \ref augment_snapshot_contents "contents" the following snapshots should copy
+ * @param snapshot Will be filled with the snapshot, which must be released with mar_augment_release_snapshot
+ *
+ * @return MAR_ERROR_NONE on success, MAR_ERROR_AGAIN if no snapshot has been published yet.
+ */
+MAR_PUBLIC
+mar_error_code mar_augment_acquire_snapshot(int contents, const mar_augment_snapshot **snapshot)
+{
+  return mar_augment_ctx_acquire_snapshot(mar_augment_default_ctx, contents, snapshot);
+}
+
+/**
+ * Releases a snapshot acquired by mar_augment_ctx_acquire_snapshot.  May be called from any thread.
+ *
+ * @param ctx The augmentation context
+ * @param snapshot The snapshot, may be NULL
+ */
+MAR_PUBLIC
+void mar_augment_ctx_release_snapshot(mar_augment_ctx *ctx, const mar_augment_snapshot *snapshot)
+{
+  if (ctx != NULL && snapshot != NULL)
+  {
+    pthread_mutex_lock(&ctx->snapshot_mutex);
+    ((mar_augment_snapshot *)snapshot)->refs--;
+    pthread_mutex_unlock(&ctx->snapshot_mutex);
+  }
+}
+
+/**
+ * Releases a snapshot acquired by mar_augment_acquire_snapshot.  May be called from any thread.
+ *
+ * @param snapshot The snapshot, may be NULL
+ */
+MAR_PUBLIC
+void mar_augment_release_snapshot(const mar_augment_snapshot *snapshot)
+{
+  mar_augment_ctx_release_snapshot(mar_augment_default_ctx, snapshot);
+}
+
+/**
+ * Fills the latency percentiles of each stage since the context was created or its statistics were reset, the
+ * number of frames the cameras dropped, and the keypoint, match and inlier counts of the augmentations, in order
+ * of their IDs.  Stages are timed as they run on every thread of the pipeline, so the statistics may be read while
+ * the pipeline runs, but only between updates on the thread using the context.
+ *
+ * @param ctx The augmentation context
+ * @param stats Will be filled with the statistics of the pipeline
+ * @param augmentations Will be filled with the statistics of each augmentation, max_augmentations in size, or NULL
+ * @param max_augmentations The maximum number of augmentation statistics to fill
+ * @param num_augmentations Will be filled with the number of augmentation statistics filled, or NULL
+ *
+ * @return MAR_ERROR_NONE on success, an error code on failure.
+ */
+MAR_PUBLIC
+mar_error_code mar_augment_ctx_get_stats(mar_augment_ctx *ctx, mar_augment_stats *stats, mar_augmentation_stats *augmentations,
+    int max_augmentations, int *num_augmentations)
+{
+  int i, n = 0;
+
+  if (num_augmentations != NULL)
+  {
+    *num_augmentations = 0;
+  }
+
+  // Check if augmentation has not been initialized
+  if (ctx == NULL)
+  {
+    return MAR_ERROR_AUGMENTATION_NOT_INITIALIZED;
+  }
+
+  for (i = 0; i < MAR_AUGMENT_NUM_STAGES; i++)
+  {
+    stats->stages[i].count = mar_stats_histogram_get_count(&ctx->stage_latencies[i]);
+    stats->stages[i].p50 = mar_stats_histogram_get_percentile(&ctx->stage_latencies[i], 50);
+    stats->stages[i].p95 = mar_stats_histogram_get_percentile(&ctx->stage_latencies[i], 95);
+    stats->stages[i].p99 = mar_stats_histogram_get_percentile(&ctx->stage_latencies[i], 99);
+  }
+  stats->num_updates = ctx->num_updates;
+  stats->dropped_frames = 0;
+  for (i = 0; i < ctx->num_views; i++)
+  {
+    stats->dropped_frames += mar_camera_get_num_dropped_frames(ctx->views[i].camera_id);
+  }
+  stats->num_augmentations = ctx->number_of_augmentations;
+  stats->sift_octave_skip = __atomic_load_n(&ctx->governor_octave_skip, __ATOMIC_RELAXED);
+  stats->mser_level = ctx->governor_mser_level;
+
+  for (i = 0; augmentations != NULL && i < ctx->augmentations_capacity && n < max_augmentations; i++)
+  {
+    if (ctx->augmentations[i].initialized)
+    {
+      augmentations[n].id = i;
+      augmentations[n].view = ctx->augmentations[i].view;
+      augmentations[n].num_keypoints = ctx->augmentations[i].surface->num_initial_keypoints;
+      augmentations[n].num_matches = ctx->augmentations[i].num_matches;
+      augmentations[n].num_inliers = ctx->augmentations[i].num_inliers;
+      n++;
     }
   }
+  if (num_augmentations != NULL)
+  {
+    *num_augmentations = n;
+  }
 
   return MAR_ERROR_NONE;
 }
 
 /**
- * Loads the transformation matrix for a given augmentation in a 4x4 column major matrix
+ * Fills the latency percentiles of each stage, the number of dropped frames, and the keypoint, match and inlier
+ * counts of the augmentations, as mar_augment_ctx_get_stats.
  *
- * @param id The augmentation's ID
- * @param id Will be filled with the matrices values in a column major ordering.  
+ * @param stats Will be filled with the statistics of the pipeline
+ * @param augmentations Will be filled with the statistics of each augmentation, max_augmentations in size, or NULL
+ * @param max_augmentations The maximum number of augmentation statistics to fill
+ * @param num_augmentations Will be filled with the number of augmentation statistics filled, or NULL
  *
  * @return MAR_ERROR_NONE on success, an error code on failure.
  */
 MAR_PUBLIC
-mar_error_code mar_augment_get_transformation(mar_augmentation_id id, float mat[])
+mar_error_code mar_augment_get_stats(mar_augment_stats *stats, mar_augmentation_stats *augmentations, int max_augmentations, int *num_augmentations)
+{
+  return mar_augment_ctx_get_stats(mar_augment_default_ctx, stats, augmentations, max_augmentations, num_augmentations);
+}
+
+/**
+ * Forgets the latencies recorded so far, so the next statistics only cover what follows.
+ *
+ * @param ctx The augmentation context
+ *
+ * @return MAR_ERROR_NONE on success, an error code on failure.
+ */
+MAR_PUBLIC
+mar_error_code mar_augment_ctx_reset_stats(mar_augment_ctx *ctx)
 {
+  int i;
+
   // Check if augmentation has not been initialized
-  if (!mar_augment_initialized)
+  if (ctx == NULL)
   {
     return MAR_ERROR_AUGMENTATION_NOT_INITIALIZED;
   }
 
-  // Check if augmentation has not been initialized
-  if (!mar_augmentation_initialized[id])
+  for (i = 0; i < MAR_AUGMENT_NUM_STAGES; i++)
   {
-    return MAR_ERROR_AUGMENTATION_ID_DOES_NOT_EXIST;
+    mar_stats_histogram_clear(&ctx->stage_latencies[i]);
   }
 
-  // Fill the matrix
-  mat[0]  = mar_augmentations[id].transform(0, 0);
-  mat[1]  = mar_augmentations[id].transform(1, 0);
-  mat[2]  = 0;
-  mat[3]  = mar_augmentations[id].transform(2, 0);
-  mat[4]  = mar_augmentations[id].transform(0, 1);
-  mat[5]  = mar_augmentations[id].transform(1, 1);
-  mat[6]  = 0;
-  mat[7]  = mar_augmentations[id].transform(2, 1);
-  mat[8]  = 0;
-  mat[9]  = 0;
-  mat[10] = 1;
-  mat[11] = 0;
-  mat[12] = mar_augmentations[id].transform(0, 2);
-  mat[13] = mar_augmentations[id].transform(1, 2);
-  mat[14] = 0;
-  mat[15] = mar_augmentations[id].transform(2, 2);
-
   return MAR_ERROR_NONE;
 }
 
 /**
- * Returns the last error code for a specific augmentation
- *
- * @param id The augmentation's ID
+ * Forgets the latencies recorded so far, so the next statistics only cover what follows.
  *
  * @return MAR_ERROR_NONE on success, an error code on failure.
  */
 MAR_PUBLIC
-mar_error_code mar_augmentation_get_error(mar_augmentation_id id)
+mar_error_code mar_augment_reset_stats()
 {
-  return mar_augmentation_successful[id];
+  return mar_augment_ctx_reset_stats(mar_augment_default_ctx);
 }
 
 /**
- * Creates a new augmentation
+ * Pushes frames through the augmentation as fast as the cameras deliver them, passing the results of every
+ * augmentation of every view to a callback after each update.  Capture is started before the first frame and
+ * stopped after the last, so cameras which are not paced, such as MAR_CAM_TYPE_FILE, are processed faster than
+ * real-time.  The callback may create and free augmentations, and augmentation must be started for any to be tracked.
  *
- * @param id Will be willed in with the augmentation's ID
- * @param region The MSER to track for augmentation
- * 
- * @return MAR_ERROR_NONE on success, an error code on failure.
+ * @param ctx The augmentation context
+ * @param max_frames The maximum number of frames to process, 0 to process every frame until a camera's stream ends
+ * @param callback Called with the results of each frame, may be NULL
+ * @param arg The argument passed to the callback
+ * @param num_frames Will be filled with the number of frames processed
+ *
+ * @return MAR_ERROR_NONE once max_frames or every frame of a stream has been processed, an error code on failure.
  */
 MAR_PUBLIC
-mar_error_code mar_augment_new_augmentation(mar_augmentation_id *id, mar_mser *region)
+mar_error_code mar_augment_ctx_run_batch(mar_augment_ctx *ctx, unsigned int max_frames, mar_augment_batch_callback callback, void *arg,
+    unsigned int *num_frames)
 {
-  int i, j, num_keypoints;
+  mar_error_code mrv, stop_mrv;
+  mar_augmentation_result *results = NULL, *grown;
+  int results_capacity = 0, num_results;
 
-  // Check if augmentation has not been initialized
-  if (!mar_augment_initialized)
+  *num_frames = 0;
+
+  mrv = mar_augment_ctx_start_capture(ctx);
+  if (mrv != MAR_ERROR_NONE)
   {
-    return MAR_ERROR_AUGMENTATION_NOT_INITIALIZED;
+    return mrv;
   }
 
-  // Find a new spot for the augmentation
-  for (i = 0; i < MAR_MAX_NUMBER_OF_AUGMENTATIONS; i++)
+  while (max_frames == 0 || *num_frames < max_frames)
   {
-    if (!mar_augmentation_initialized[i])
+    mrv = mar_augment_ctx_update(ctx);
+    if (mrv == MAR_ERROR_END_OF_STREAM)
     {
-      mar_augmentations[i].mser = *region;
-
-      // Copy the keypoints within the ellipse to a buffer
-      mar_augmentations[i].new_keypoint_cursor = 0;
-      num_keypoints = 0;
-      mar_augment_get_keypoints(&mar_sift_keypoints, &mar_sift_num_keypoints);
-      for (j = 0; j < mar_sift_num_keypoints; j++)
-      {
-        if (is_point_in_ellipse(mar_sift_keypoints[j].x, mar_sift_keypoints[j].y, 
-              region->ellipse_x, region->ellipse_y, region->ellipse_a, region->ellipse_b, region->ellipse_angle))
-        {
-          memcpy(&mar_augmentations[i].initial_keypoints[mar_augmentations[i].new_keypoint_cursor], &mar_sift_keypoints[j], sizeof(mar_sift_keypoint));
-          mar_augmentations[i].initial_keypoints[mar_augmentations[i].new_keypoint_cursor].x -= mar_augmentations[i].mser.ellipse_x;
-          mar_augmentations[i].initial_keypoints[mar_augmentations[i].new_keypoint_cursor].y -= mar_augmentations[i].mser.ellipse_y;
-          mar_augmentations[i].initial_keypoints[mar_augmentations[i].new_keypoint_cursor].x /= 
-            (mar_augmentations[i].mser.ellipse_a + mar_augmentations[i].mser.ellipse_b) / 2;
-          mar_augmentations[i].initial_keypoints[mar_augmentations[i].new_keypoint_cursor].y /= 
-            (mar_augmentations[i].mser.ellipse_a + mar_augmentations[i].mser.ellipse_b) / 2;
-          num_keypoints = num_keypoints >= MAR_MAX_NUMBER_OF_AUGMENTATION_KEYPOINTS ? MAR_MAX_NUMBER_OF_AUGMENTATION_KEYPOINTS : num_keypoints + 1;
-          mar_augmentations[i].new_keypoint_cursor = (mar_augmentations[i].new_keypoint_cursor + 1) % MAR_MAX_NUMBER_OF_AUGMENTATION_KEYPOINTS;
-        }
-      }
-      mar_augmentations[i].num_initial_keypoints = num_keypoints;
+      mrv = MAR_ERROR_NONE;
+      break;
+    }
+    else if (mrv != MAR_ERROR_NONE)
+    {
+      break;
+    }
 
-      // Check if enough keypoints exist to create an augmentation
-      if (num_keypoints < MAR_MINIMUM_AUGMENTATION_KEYPOINTS)
+    // Make room for a result for every augmentation, which only allocates when more IDs came into use
+    if (results_capacity < ctx->augmentations_capacity)
+    {
+      grown = (mar_augmentation_result *)mar_realloc(results, ctx->augmentations_capacity * sizeof(mar_augmentation_result));
+      if (grown == NULL)
       {
-        return MAR_ERROR_TOO_FEW_KEYPOINTS;
+        mrv = MAR_ERROR_MALLOC;
+        break;
       }
+      results = grown;
+      results_capacity = ctx->augmentations_capacity;
+    }
 
-      // Initialize augmentation
-      *id = i;
-      mar_number_of_augmentations++;
-      mar_augmentation_initialized[i] = 1;
-
-      // Set transformation matrix to the zero matrix
-      mar_augmentations[i].transform(0, 0) = 0;
-      mar_augmentations[i].transform(0, 1) = 0;
-      mar_augmentations[i].transform(0, 2) = 0;
-      mar_augmentations[i].transform(1, 0) = 0;
-      mar_augmentations[i].transform(1, 1) = 0;
-      mar_augmentations[i].transform(1, 2) = 0;
-      mar_augmentations[i].transform(2, 0) = 0;
-      mar_augmentations[i].transform(2, 1) = 0;
-      mar_augmentations[i].transform(2, 2) = 0; 
-      mar_augmentations[i].transform_inverse = pinv(mar_augmentations[i].transform);
-
-      return MAR_ERROR_NONE;
+    mar_augment_ctx_get_results(ctx, MAR_AUGMENT_ALL_VIEWS, results, results_capacity, &num_results);
+    if (callback != NULL)
+    {
+      callback(arg, *num_frames, results, num_results);
     }
+    (*num_frames)++;
   }
 
-  return MAR_ERROR_NO_AUGMENTATION_RESOURCES_AVAILABLE; 
+  mar_free(results);
+  stop_mrv = mar_augment_ctx_stop_capture(ctx);
+
+  return mrv != MAR_ERROR_NONE ? mrv : stop_mrv;
 }
 
 /**
- * Augments a point using the affine transformation matrix of a MAR augmentation.
+ * Pushes frames through the augmentation as fast as the cameras deliver them, passing the results of every
+ * augmentation of every view to a callback after each update.  Capture is started before the first frame and
+ * stopped after the last, so cameras which are not paced, such as MAR_CAM_TYPE_FILE, are processed faster than
+ * real-time.  The callback may create and free augmentations, and augmentation must be started for any to be tracked.
  *
- * @param id The ID of the augmentation to use
- * @param x The X coordinate of the point
- * @param y The Y coordinate of the point
- * @param tx Will be set to the transformed X coordinate of the point
- * @param ty Will be set to the transformed Y coordinate of the point
- * 
- * @return MAR_ERROR_NONE on success, an error code on failure.
+ * @param max_frames The maximum number of frames to process, 0 to process every frame until a camera's stream ends
+ * @param callback Called with the results of each frame, may be NULL
+ * @param arg The argument passed to the callback
+ * @param num_frames Will be filled with the number of frames processed
+ *
+ * @return MAR_ERROR_NONE once max_frames or every frame of a stream has been processed, an error code on failure.
  */
 MAR_PUBLIC
-mar_error_code mar_augment_transform_point(mar_augmentation_id id, float x, float y, float *tx, float *ty)
+mar_error_code mar_augment_run_batch(unsigned int max_frames, mar_augment_batch_callback callback, void *arg, unsigned int *num_frames)
 {
-  static fmat::fixed<3, 1> xy_mat, uv_mat;
-
-  // Check if augmentation has not been initialized
-  if (!mar_augment_initialized)
-  {
-    return MAR_ERROR_AUGMENTATION_NOT_INITIALIZED;
-  }
+  return mar_augment_ctx_run_batch(mar_augment_default_ctx, max_frames, callback, arg, num_frames);
+}
 
+/**
+ * Gets the camera ID of a view.
+ *
+ * @param ctx The augmentation context
+ * @param view The index of the view
+ * 
+ * @return The MAR library camera ID for the view's camera, MAR_CAM_NO_CAMERA if the view does not exist
+ */
+MAR_PUBLIC
+mar_camera_id mar_augment_ctx_view_get_camera(mar_augment_ctx *ctx, int view)
+{
   // Check if augmentation has not been initialized
-  if (!mar_augmentation_initialized[id])
+  if (ctx == NULL || view < 0 || view >= ctx->num_views)
   {
-    return MAR_ERROR_AUGMENTATION_ID_DOES_NOT_EXIST;
+    return MAR_CAM_NO_CAMERA;
   }
 
-  // Create the XY matrix  
-  xy_mat(0, 0) = x;
-  xy_mat(1, 0) = y;
-  xy_mat(2, 0) = 1;
-
-  uv_mat = mar_augmentations[id].transform * xy_mat;
+  return ctx->views[view].camera_id;
+}
 
-  *tx = uv_mat(0, 0);
-  *ty = uv_mat(1, 0);
+/**
+ * Gets the camera ID of a view.
+ *
+ * @param view The index of the view
+ * 
+ * @return The MAR library camera ID for the view's camera, MAR_CAM_NO_CAMERA if the view does not exist
+ */
+MAR_PUBLIC
+mar_camera_id mar_augment_view_get_camera(int view)
+{
+  return mar_augment_ctx_view_get_camera(mar_augment_default_ctx, view);
+}
 
-  return MAR_ERROR_NONE;
+/**
+ * Gets the camera ID of the first view.
+ * 
+ * @return The MAR library camera ID for the camera being used for augmentation
+ */
+MAR_PUBLIC
+mar_camera_id mar_augment_get_camera()
+{
+  return mar_augment_view_get_camera(0);
 }
 
 /**
- * Deaugments a point using the affine transformation matrix of a MAR augmentation.  Changes the transform from the
- * current frame's transform to the initial frame's transform.
+ * Returns the frame buffer of a view's camera in an RGB24 format.  The frame is only converted the first time it is
+ * requested after an update.  The frame buffer is 3 * width * height in size.
  *
- * @param id The ID of the augmentation to use
- * @param x The X coordinate of the point
- * @param y The Y coordinate of the point
- * @param tx Will be set to the untransformed X coordinate of the point
- * @param ty Will be set to the untransformed Y coordinate of the point
+ * @param ctx The augmentation context
+ * @param view The index of the view
  * 
- * @return MAR_ERROR_NONE on success, an error code on failure.
+ * @return The camera frame buffer, or NULL if the view does not exist
  */
 MAR_PUBLIC
-mar_error_code mar_augment_untransform_point(mar_augmentation_id id, float x, float y, float *tx, float *ty)
+unsigned char *mar_augment_ctx_view_get_camera_frame_buffer(mar_augment_ctx *ctx, int view)
 {
-  static fmat::fixed<3, 1> xy_mat, uv_mat;
+  mar_augment_view *v;
 
-  // Check if augmentation has not been initialized
-  if (!mar_augment_initialized)
+  if (ctx == NULL || view < 0 || view >= ctx->num_views)
   {
-    return MAR_ERROR_AUGMENTATION_NOT_INITIALIZED;
+    return NULL;
   }
+  v = &ctx->views[view];
 
-  // Check if augmentation has not been initialized
-  if (!mar_augmentation_initialized[id])
+  if (v->current_frame != NULL && v->current_frame->frame_acquired && !v->frame_rgb_converted)
   {
-    return MAR_ERROR_AUGMENTATION_ID_DOES_NOT_EXIST;
+    mar_camera_frame_to_rgb(&v->current_frame->frame, v->frame_rgb);
+    v->frame_rgb_converted = 1;
   }
 
-  // Create the XY matrix  
-  xy_mat(0, 0) = x;
-  xy_mat(1, 0) = y;
-  xy_mat(2, 0) = 1;
-
-  uv_mat = mar_augmentations[id].transform_inverse * xy_mat;
-
-  *tx = uv_mat(0, 0);
-  *ty = uv_mat(1, 0);
-
-  return MAR_ERROR_NONE;
+  return v->frame_rgb;
 }
 
 /**
- * Frees resources for an augmentation
+ * Returns the frame buffer of a view's camera in an RGB24 format.  The frame is only converted the first time it is
+ * requested after an update.  The frame buffer is 3 * width * height in size.
  *
- * @param id The augmentation ID
+ * @param view The index of the view
+ * 
+ * @return The camera frame buffer, or NULL if the view does not exist
  */
 MAR_PUBLIC
-void mar_augment_free_augmentation(mar_augmentation_id id)
+unsigned char *mar_augment_view_get_camera_frame_buffer(int view)
 {
-  if (mar_augmentation_initialized[id])
-  {
-    mar_augmentation_initialized[id] = 0;
-    mar_number_of_augmentations--;
-  }
+  return mar_augment_ctx_view_get_camera_frame_buffer(mar_augment_default_ctx, view);
 }
 
 /**
- * Returns the maximally stable extremal regions for a camera frame.
- *
- * @param regions A pointer to a pointer which will be modified to point to the array of regions.
- * @param num_regions The number of MSER, and the size of the regions array
- *
- * @return MAR_ERROR_NONE on success, an error code on failure.
+ * Returns the frame buffer of the first view's camera in an RGB24 format.  The frame is only converted the first
+ * time it is requested after an update.  The frame buffer is 3 * width * height in size.
+ * 
+ * @return The camera frame buffer.
  */
 MAR_PUBLIC
-mar_error_code mar_augment_get_regions(mar_mser **regions, int *num_regions)
+unsigned char *mar_augment_get_camera_frame_buffer()
 {
-  mar_error_code mrv;
+  return mar_augment_view_get_camera_frame_buffer(0);
+}
 
-  // Check if augmentation has not been initialized
-  if (!mar_augment_initialized)
+/**
+ * Returns the raw camera frame of a view in the camera's own pixel format, so that it can be converted elsewhere,
+ * such as on the GPU.  The frame stays valid until the next update.
+ *
+ * @param ctx The augmentation context
+ * @param view The index of the view
+ * 
+ * @return The camera frame, or NULL if the view does not exist or no frame has been captured
+ */
+MAR_PUBLIC
+const mar_camera_frame *mar_augment_ctx_view_get_camera_frame(mar_augment_ctx *ctx, int view)
+{
+  if (ctx == NULL || view < 0 || view >= ctx->num_views || ctx->views[view].current_frame == NULL ||
+      !ctx->views[view].current_frame->frame_acquired)
   {
-    return MAR_ERROR_AUGMENTATION_NOT_INITIALIZED;
+    return NULL;
   }
 
-  // Check if we have already calculated MSER this frame - if so then use the cached results
-  if (mar_mser_calculated_this_frame)
-  {
-    *regions = mar_mser_regions;  
-    *num_regions = mar_mser_num_regions;
-    return MAR_ERROR_NONE;
-  }
-  else
-  {
-    // Calculate and return MSER
-    mrv = mar_mser_get_regions(&mar_mser_regions, &mar_mser_num_regions, mar_camera_get_frame_buffer(camera_id));
-    if (mrv == MAR_ERROR_NONE)
-    {
-      *regions = mar_mser_regions;  
-      *num_regions = mar_mser_num_regions; 
-      mar_mser_calculated_this_frame = 1;
-    }
-    return mrv;
-  }
+  return &ctx->views[view].current_frame->frame;
 }
 
 /**
- * Returns the SIFT keypoints for a camera frame.
- *
- * @param keypoints A pointer to a pointer which will be modified to point to the array of keypoints.
- * @param num_keypoints The number of SIFT keypoints, and the size of the regions array
+ * Returns the raw camera frame of a view in the camera's own pixel format, so that it can be converted elsewhere,
+ * such as on the GPU.  The frame stays valid until the next update.
  *
- * @return MAR_ERROR_NONE on success, an error code on failure.
+ * @param view The index of the view
+ * 
+ * @return The camera frame, or NULL if the view does not exist or no frame has been captured
  */
 MAR_PUBLIC
-mar_error_code mar_augment_get_keypoints(mar_sift_keypoint **keypoints, int *num_keypoints)
+const mar_camera_frame *mar_augment_view_get_camera_frame(int view)
 {
-  mar_error_code mrv;
-
-  // Check if augmentation has not been initialized
-  if (!mar_augment_initialized)
-  {
-    return MAR_ERROR_AUGMENTATION_NOT_INITIALIZED;
-  }
+  return mar_augment_ctx_view_get_camera_frame(mar_augment_default_ctx, view);
+}
 
-  // Check if we have already updated the SIFT filter this frame - if so then use the cached results
-  if (mar_sift_calculated_this_frame)
-  {
-    *keypoints = mar_sift_keypoints;
-    *num_keypoints = mar_sift_num_keypoints;
-    return MAR_ERROR_NONE;
-  }
-  else
-  {
-    // Calculate and return the SIFT keypoints
-    mrv = mar_sift_get_keypoints(&mar_sift_keypoints, &mar_sift_num_keypoints, mar_camera_get_frame_buffer(camera_id));
-    if (mrv == MAR_ERROR_NONE)
-    {
-      *keypoints = mar_sift_keypoints;
-      *num_keypoints = mar_sift_num_keypoints;
-      mar_sift_calculated_this_frame = 1;
-    }
-    return mrv;
-  }
+/**
+ * Returns the raw camera frame of the first view in the camera's own pixel format, so that it can be converted
+ * elsewhere, such as on the GPU.  The frame stays valid until the next update.
+ * 
+ * @return The camera frame, or NULL if no frame has been captured
+ */
+MAR_PUBLIC
+const mar_camera_frame *mar_augment_get_camera_frame()
+{
+  return mar_augment_view_get_camera_frame(0);
 }
 
 /**
- * Gets the camera ID used for augmentation.
+ * Returns a level of the grayscale image pyramid of a view's current camera frame.  Level 0 is the full resolution
+ * luma, and each level after it is half the width and height of the one before it.
+ *
+ * @param ctx The augmentation context
+ * @param view The index of the view
+ * @param level The pyramid level
+ * @param width Will be filled with the width of the level, may be NULL
+ * @param height Will be filled with the height of the level, may be NULL
  * 
- * @return The MAR library camera ID for the camera being used for augmentation
+ * @return The 8-bit grayscale frame buffer, or NULL if the view or level does not exist
  */
 MAR_PUBLIC
-mar_camera_id mar_augment_get_camera()
+const unsigned char *mar_augment_ctx_view_get_grayscale_frame_buffer(mar_augment_ctx *ctx, int view, int level, int *width, int *height)
 {
-  // Check if augmentation has not been initialized
-  if (!mar_augment_initialized)
+  if (ctx == NULL || view < 0 || view >= ctx->num_views || ctx->views[view].current_frame == NULL)
   {
-    return MAR_CAM_NO_CAMERA;
+    return NULL;
   }
 
-  return camera_id;
+  return mar_image_pyramid_get_gray(&ctx->views[view].current_frame->pyramid, level, width, height);
 }
 
 /**
- * Returns the camera's frame buffer in an RGB24 format.  
- * The frame buffer is 3 * width * height in size.
+ * Returns a level of the grayscale image pyramid of a view's current camera frame.  Level 0 is the full resolution
+ * luma, and each level after it is half the width and height of the one before it.
+ *
+ * @param view The index of the view
+ * @param level The pyramid level
+ * @param width Will be filled with the width of the level, may be NULL
+ * @param height Will be filled with the height of the level, may be NULL
  * 
- * @return The camera frame buffer.
+ * @return The 8-bit grayscale frame buffer, or NULL if the view or level does not exist
  */
 MAR_PUBLIC
-unsigned char *mar_augment_get_camera_frame_buffer()
+const unsigned char *mar_augment_view_get_grayscale_frame_buffer(int view, int level, int *width, int *height)
 {
-  if (!mar_augment_initialized)
-  {
-    return NULL;
-  }
+  return mar_augment_ctx_view_get_grayscale_frame_buffer(mar_augment_default_ctx, view, level, width, height);
+}
 
-  return mar_camera_get_frame_buffer(camera_id);
+/**
+ * Returns a level of the current camera frame's grayscale image pyramid for the first view.  Level 0 is the full
+ * resolution luma, and each level after it is half the width and height of the one before it.
+ *
+ * @param level The pyramid level
+ * @param width Will be filled with the width of the level, may be NULL
+ * @param height Will be filled with the height of the level, may be NULL
+ * 
+ * @return The 8-bit grayscale frame buffer, or NULL if the level does not exist
+ */
+MAR_PUBLIC
+const unsigned char *mar_augment_get_grayscale_frame_buffer(int level, int *width, int *height)
+{
+  return mar_augment_view_get_grayscale_frame_buffer(0, level, width, height);
 }
 
 /**
- * Frees the augmentation resources
+ * Frees an augmentation context, stopping its cameras and detection threads.
  *
- * @return MAR_ERROR_NONE on success, an error code on failure.
+ * @param ctx The context, may be NULL
  */
 MAR_PUBLIC
-mar_error_code mar_augment_free()
+void mar_augment_ctx_free(mar_augment_ctx *ctx)
 {
-  int i;
+  mar_error_code mrv;
+  int i, j, k;
 
-  if (mar_augment_initialized)
+  if (ctx != NULL)
   {
-    mar_augment_initialized = 0;
-    mar_run_augmentation = 0;
+    ctx->run_augmentation = 0;
+
+    // Stop each detection and MSER thread, which may still be recording a captured frame
+    for (i = 0; i < ctx->num_views; i++)
+    {
+      mar_augment_stop_pipeline(&ctx->views[i]);
+      mar_augment_stop_mser(&ctx->views[i]);
+    }
+
+    // Finish the recording before the augmentations are freed, which are not calls made to the context
+    if (ctx->recorder != NULL)
+    {
+      mrv = mar_capture_log_writer_free(ctx->recorder);
+      ctx->recorder = NULL;
+      if (mrv != MAR_ERROR_NONE)
+      {
+        mar_print_error(mrv);
+      }
+    }
+
+    // Save the models for the next session while the configuration naming the cache still exists
+    if (ctx->model_cache != NULL && ctx->model_cache_loaded)
+    {
+      mrv = mar_augment_ctx_save_models(ctx, ctx->model_cache);
+      if (mrv != MAR_ERROR_NONE)
+      {
+        mar_print_error(mrv);
+      }
+    }
 
-    // Free all augmentations
-    for (i = 0; i < MAR_MAX_NUMBER_OF_AUGMENTATIONS; i++)
+    // Free all augmentations and their keypoints
+    for (i = 0; i < ctx->augmentations_capacity; i++)
     {
-      mar_augment_free_augmentation(i);
+      mar_augment_ctx_free_augmentation(ctx, i);
+      if (ctx->augmentations[i].surface != NULL)
+      {
+        if (ctx->augmentations[i].surface->index.capacity != 0)
+        {
+          mar_keypoint_index_free(&ctx->augmentations[i].surface->index);
+        }
+        if (ctx->augmentations[i].surface->potential_index.capacity != 0)
+        {
+          mar_keypoint_index_free(&ctx->augmentations[i].surface->potential_index);
+        }
+        mar_free(ctx->augmentations[i].surface);
+      }
     }
+    mar_free(ctx->augmentations);
 
     // Free all resources
-    config_destroy(&mar_cfg);
-    mar_mser_free();
-    mar_sift_free();
-    mar_camera_stop(camera_id);
-    return mar_camera_free(camera_id);
+    for (i = 0; i < ctx->num_views; i++)
+    {
+      mar_augment_free_view(&ctx->views[i]);
+    }
+    config_destroy(&ctx->cfg);
+    if (ctx->tracking_pool != NULL)
+    {
+      mar_thread_pool_free(ctx->tracking_pool);
+    }
+    if (ctx->replay != NULL)
+    {
+      mar_capture_log_free(ctx->replay);
+    }
+
+    // Free the snapshots, which must no longer be held
+    for (i = 0; i < MAR_AUGMENT_NUM_SNAPSHOTS; i++)
+    {
+      mar_free(ctx->snapshots[i].results);
+      for (j = 0; j < MAR_AUGMENT_MAX_NUM_VIEWS; j++)
+      {
+        mar_free(ctx->snapshots[i].views[j].keypoints);
+        mar_free(ctx->snapshots[i].views[j].regions);
+        mar_free(ctx->snapshots[i].views[j].frame_buffer);
+        for (k = 0; k < MAR_IMAGE_PYRAMID_MAX_LEVELS; k++)
+        {
+          mar_free(ctx->snapshots[i].views[j].gray_buffers[k]);
+        }
+      }
+    }
+    pthread_mutex_destroy(&ctx->snapshot_mutex);
+
+    // Drop a reloaded configuration which was never applied
+    if (ctx->reload_cfg != NULL)
+    {
+      config_destroy(ctx->reload_cfg);
+      mar_free(ctx->reload_cfg);
+    }
+    pthread_mutex_destroy(&ctx->reload_mutex);
+    mar_free(ctx);
   }
+}
+
+/**
+ * Frees the augmentation resources
+ *
+ * @return MAR_ERROR_NONE on success, an error code on failure.
+ */
+MAR_PUBLIC
+mar_error_code mar_augment_free()
+{
+  mar_augment_ctx_free(mar_augment_default_ctx);
+  mar_augment_default_ctx = NULL;
 
   return MAR_ERROR_NONE;
 }
-
@@ -2,6 +2,11 @@
  * @file mar_augment.h
  * 
  * Contains code which is used for augmentation.
+ * Each augmentation context is an independent pipeline with its own cameras, detectors, threads and
+ * augmentations, so several contexts may be updated on their own threads at the same time.  A context must only
+ * be used by one thread at a time, except for its snapshots, which may be acquired and released from any thread
+ * while it is being updated, and its configuration, which may be reloaded from any thread and is applied before
+ * the next update.  The functions without a context use the context created by mar_augment_init.
  *
  * @author Greg Eddington
  */
@@ -11,14 +16,18 @@
 
 #include "../common/mar_error.h"
 #include "../camera/mar_camera.h"
+#include "../common/mar_image_pyramid.h"
 #include "../vision/mar_mser.h"
 #include "../vision/mar_sift.h" 
 
 /** Can be used to assign to variable to denote that no augmentation has been assigned to an ID */
-#define MAR_NO_AUGMENTATION 255
+#define MAR_NO_AUGMENTATION 65535
 
-/** The maximum number of augmentations */
-#define MAR_MAX_NUMBER_OF_AUGMENTATIONS 32
+/** The maximum number of augmentations, IDs are always less than this */
+#define MAR_MAX_NUMBER_OF_AUGMENTATIONS 4096
+
+/** The number of augmentations room is made for when the first augmentation is created, doubling whenever more are needed */
+#define MAR_AUGMENT_INITIAL_CAPACITY 8
 
 /** The maximum difference between two keypoints to be considered matching */
 #define MAR_MAX_KEYPOINT_DIFFERENCE 2
@@ -46,11 +55,278 @@
 
 #define MAR_MAX_NUMBER_OF_AUGMENTATION_KEYPOINTS 512
 
+/** The number of tracked frames after which the hits and misses of an augmentation's keypoint are halved, so its usefulness follows recent frames */
+#define MAR_AUGMENT_KEYPOINT_HISTORY 64
+
+/** The default number of levels in the grayscale image pyramid of each camera frame */
+#define MAR_AUGMENT_DEFAULT_PYRAMID_LEVELS 3
+
+/** Whether or not frames are captured and detected on a separate thread by default */
+#define MAR_AUGMENT_DEFAULT_PIPELINED 0
+
+/** The default number of threads tracking augmentations, 0 for one per online processor */
+#define MAR_AUGMENT_DEFAULT_TRACKING_THREADS 1
+
+/** The number of frames in flight when pipelined, one being tracked and one being detected */
+#define MAR_AUGMENT_PIPELINE_DEPTH 2
+
+/** The initial size in bytes of the scratch memory of each frame, which grows to fit the frame loop */
+#define MAR_AUGMENT_FRAME_ARENA_SIZE (1 << 20)
+
+/** The number of updates without augmentations being created or freed after which the frame loop should not allocate */
+#define MAR_AUGMENT_STEADY_STATE_FRAMES 30
+
+/** Whether or not keypoints are only detected around tracked augmentations by default */
+#define MAR_AUGMENT_DEFAULT_ROI_DETECTION 0
+
+/** The default number of pixels added to each side of an augmentation's predicted bounding box when detecting around it */
+#define MAR_AUGMENT_DEFAULT_ROI_PADDING 32
+
+/** The default number of frames between keypoint detections over the whole frame when detecting around augmentations */
+#define MAR_AUGMENT_DEFAULT_ROI_FULL_FRAME_INTERVAL 15
+
+/** Whether or not augmentations are followed by optical flow between keypoint detections by default */
+#define MAR_AUGMENT_DEFAULT_FLOW_TRACKING 0
+
+/** The default maximum number of frames between keypoint detections while following augmentations by optical flow */
+#define MAR_AUGMENT_DEFAULT_FLOW_DETECTION_INTERVAL 5
+
+/** The default number of inliers every augmentation needs for the next frame to be followed by optical flow */
+#define MAR_AUGMENT_DEFAULT_FLOW_MIN_INLIERS 12
+
+/** Whether or not augmentations are predicted by a motion model by default */
+#define MAR_AUGMENT_DEFAULT_MOTION_MODEL 0
+
+/** Whether or not the detectors are scaled down by default whenever updates take longer than the frame budget */
+#define MAR_AUGMENT_DEFAULT_GOVERNOR 0
+
+/** The default time in milliseconds an update should take when the detectors are scaled to a frame budget */
+#define MAR_AUGMENT_DEFAULT_GOVERNOR_FRAME_BUDGET 33.3
+
+/** The default maximum number of first SIFT octaves, or first pyramid levels of FAST corners, skipped to meet the frame budget */
+#define MAR_AUGMENT_DEFAULT_GOVERNOR_MAX_OCTAVE_SKIP 2
+
+/** The default maximum image pyramid level MSER are detected in to meet the frame budget */
+#define MAR_AUGMENT_DEFAULT_GOVERNOR_MAX_MSER_LEVEL 2
+
+/** The weight of the latest update in the smoothed update time the frame budget is compared to */
+#define MAR_AUGMENT_GOVERNOR_SMOOTHING 0.1f
+
+/** The fraction of the frame budget the smoothed update time must fall under before detection quality is restored */
+#define MAR_AUGMENT_GOVERNOR_HEADROOM 0.7f
+
+/** The number of updates after changing the detectors before they are changed again, so the change shows in the update time */
+#define MAR_AUGMENT_GOVERNOR_SETTLE_UPDATES 15
+
+/** Whether or not MSER are detected on a thread of their own by default, instead of during the call asking for them */
+#define MAR_AUGMENT_DEFAULT_MSER_BACKGROUND 0
+
+/** The default number of updates between detections of MSER on their own thread */
+#define MAR_AUGMENT_DEFAULT_MSER_INTERVAL 5
+
+/** The default image pyramid level MSER are detected in, 0 for full resolution */
+#define MAR_AUGMENT_DEFAULT_MSER_LEVEL 0
+
+/** The number of updates MSER keep being detected on their own thread after they were last asked for */
+#define MAR_AUGMENT_MSER_IDLE_UPDATES 30
+
+/** The maximum number of views, one for each camera used for augmentation */
+#define MAR_AUGMENT_MAX_NUM_VIEWS MAR_CAM_MAX_NUM_CAMERAS
+
+/** Used in place of a view's index to denote every view */
+#define MAR_AUGMENT_ALL_VIEWS -1
+
 /** An augmentation identifier */
-typedef unsigned char mar_augmentation_id;
+typedef unsigned short mar_augmentation_id;
 
 /**
- * Initializes augmentation using a configuration file
+ * The result of the last update for an augmentation
+ */
+typedef struct
+{
+  /** The augmentation's ID @return */
+  mar_augmentation_id id;
+  /** The index of the view the augmentation is tracked in @return */
+  int view;
+  /** The error of the last tracking, MAR_ERROR_NONE if the augmentation was found @return */
+  mar_error_code error;
+  /** The number of matched keypoints which agree with the transformation @return */
+  int num_inliers;
+  /** The transformation in a 4x4 column major matrix, as filled by mar_augment_get_transformation @return */
+  float transform[16];
+}
+mar_augmentation_result;
+
+/** \defgroup augment_stages Augmentation Stages
+ *  @{
+ */
+/** Acquiring a frame from a view's camera **/
+#define MAR_AUGMENT_STAGE_CAPTURE     0
+/** Converting a frame to luma and building its image pyramid **/
+#define MAR_AUGMENT_STAGE_CONVERT     1
+/** Detecting the SIFT keypoints of a frame **/
+#define MAR_AUGMENT_STAGE_SIFT        2
+/** Detecting the MSERs of a frame **/
+#define MAR_AUGMENT_STAGE_MSER        3
+/** Finding the keypoints within the ellipse of an augmentation **/
+#define MAR_AUGMENT_STAGE_CONTAINMENT 4
+/** Matching the keypoints of an augmentation to the keypoints of a frame **/
+#define MAR_AUGMENT_STAGE_MATCH       5
+/** Solving the transformation of an augmentation from its matches **/
+#define MAR_AUGMENT_STAGE_SOLVE       6
+/** A whole update of every view **/
+#define MAR_AUGMENT_STAGE_UPDATE      7
+/** @} */
+
+/** The number of \ref augment_stages "stages" which are timed */
+#define MAR_AUGMENT_NUM_STAGES 8
+
+/**
+ * The latencies of a stage in microseconds, within 12%
+ */
+typedef struct
+{
+  /** The number of times the stage ran @return */
+  unsigned long count;
+  /** The median latency @return */
+  float p50;
+  /** The 95th percentile latency @return */
+  float p95;
+  /** The 99th percentile latency @return */
+  float p99;
+}
+mar_augment_stage_stats;
+
+/**
+ * The statistics of an augmentation pipeline
+ */
+typedef struct
+{
+  /** The latencies of each stage, indexed by \ref augment_stages "stage" @return */
+  mar_augment_stage_stats stages[MAR_AUGMENT_NUM_STAGES];
+  /** The number of updates made @return */
+  unsigned int num_updates;
+  /** The number of frames the cameras of every view dropped @return */
+  unsigned int dropped_frames;
+  /** The number of augmentations @return */
+  int num_augmentations;
+  /** The number of first SIFT octaves, or first pyramid levels of FAST corners, currently skipped to meet the frame budget @return */
+  int sift_octave_skip;
+  /** The image pyramid level MSER are currently detected in to meet the frame budget @return */
+  int mser_level;
+}
+mar_augment_stats;
+
+/**
+ * The statistics of the last update for an augmentation
+ */
+typedef struct
+{
+  /** The augmentation's ID @return */
+  mar_augmentation_id id;
+  /** The index of the view the augmentation is tracked in @return */
+  int view;
+  /** The number of keypoints of the augmentation's surface @return */
+  int num_keypoints;
+  /** The number of matches the last transformation was solved from @return */
+  int num_matches;
+  /** The number of matched keypoints which agree with the transformation @return */
+  int num_inliers;
+}
+mar_augmentation_stats;
+
+/** \defgroup augment_snapshot_contents Augmentation Snapshot Contents
+ *  @{
+ */
+/** The keypoints of each view's frame, detected by the update if nothing else asked for them **/
+#define MAR_AUGMENT_SNAPSHOT_KEYPOINTS 0x01
+/** The MSER of each view's frame, detected by the update if nothing else asked for them **/
+#define MAR_AUGMENT_SNAPSHOT_REGIONS   0x02
+/** A copy of each view's raw camera frame **/
+#define MAR_AUGMENT_SNAPSHOT_FRAME     0x04
+/** A copy of each view's grayscale image pyramid **/
+#define MAR_AUGMENT_SNAPSHOT_GRAYSCALE 0x08
+/** @} */
+
+/** The number of snapshots of a context, enough for one to be published while a reader holds another */
+#define MAR_AUGMENT_NUM_SNAPSHOTS 3
+
+/**
+ * The state of a view when a snapshot was published
+ */
+typedef struct
+{
+  /** The error of the view's update @return */
+  mar_error_code error;
+  /** The keypoints of the frame, when MAR_AUGMENT_SNAPSHOT_KEYPOINTS was asked for @return */
+  mar_sift_keypoint *keypoints;
+  /** The number of keypoints @return */
+  int num_keypoints;
+  /** The MSER of the frame, when MAR_AUGMENT_SNAPSHOT_REGIONS was asked for @return */
+  mar_mser *regions;
+  /** The number of MSER @return */
+  int num_regions;
+  /** The copy of the camera frame when MAR_AUGMENT_SNAPSHOT_FRAME was asked for, its data is NULL otherwise @return */
+  mar_camera_frame frame;
+  /** The copy of each grayscale pyramid level when MAR_AUGMENT_SNAPSHOT_GRAYSCALE was asked for, NULL past the last level @return */
+  const unsigned char *gray[MAR_IMAGE_PYRAMID_MAX_LEVELS];
+  /** The width of each grayscale pyramid level @return */
+  int gray_width[MAR_IMAGE_PYRAMID_MAX_LEVELS];
+  /** The height of each grayscale pyramid level @return */
+  int gray_height[MAR_IMAGE_PYRAMID_MAX_LEVELS];
+  /** The size of the keypoint buffer in bytes @return Do not access directly when using the library */
+  size_t keypoints_size;
+  /** The size of the MSER buffer in bytes @return Do not access directly when using the library */
+  size_t regions_size;
+  /** The buffer the frame is copied into @return Do not access directly when using the library */
+  unsigned char *frame_buffer;
+  /** The size of the frame buffer in bytes @return Do not access directly when using the library */
+  size_t frame_buffer_size;
+  /** The buffers the grayscale pyramid levels are copied into @return Do not access directly when using the library */
+  unsigned char *gray_buffers[MAR_IMAGE_PYRAMID_MAX_LEVELS];
+  /** The size of each grayscale buffer in bytes @return Do not access directly when using the library */
+  size_t gray_buffer_sizes[MAR_IMAGE_PYRAMID_MAX_LEVELS];
+}
+mar_augment_snapshot_view;
+
+/**
+ * An immutable copy of the state of an augmentation context after an update, which can be read on another thread
+ * while the context keeps being updated
+ */
+typedef struct
+{
+  /** The number of updates made when the snapshot was published, greater for each newer snapshot @return */
+  unsigned int version;
+  /** The error returned by the update @return */
+  mar_error_code error;
+  /** The \ref augment_snapshot_contents "contents" copied besides the errors and results @return */
+  int contents;
+  /** The number of views @return */
+  int num_views;
+  /** The state of each view @return */
+  mar_augment_snapshot_view views[MAR_AUGMENT_MAX_NUM_VIEWS];
+  /** The results of every augmentation of every view, in order of their IDs @return */
+  mar_augmentation_result *results;
+  /** The number of results @return */
+  int num_results;
+  /** The size of the results buffer in bytes @return Do not access directly when using the library */
+  size_t results_size;
+  /** The number of readers holding the snapshot @return Do not access directly when using the library */
+  int refs;
+}
+mar_augment_snapshot;
+
+/**
+ * Called by mar_augment_run_batch with the results of the augmentations after each frame @return
+ */
+typedef void (*mar_augment_batch_callback)(void *arg, unsigned int frame, const mar_augmentation_result *results, int num_results);
+
+/** An augmentation pipeline, created by mar_augment_ctx_new */
+typedef struct mar_augment_ctx mar_augment_ctx;
+
+/**
+ * Initializes augmentation using a configuration file.  Every entry of the cameras list is opened as a view with
+ * its own detectors, or only the camera group when there is no cameras list.
  *
  * @param filename The filename of the configuration file, NULL for default settings
  *
@@ -66,21 +342,45 @@ mar_error_code mar_augment_init(char *filename);
 mar_error_code mar_augment_init_from_defaults();
 
 /**
- * Starts the augmentation camera
+ * Initializes augmentation replaying a recorded capture log, as mar_augment_ctx_new_replay.
+ *
+ * @param log_file The filename of the capture log
+ *
+ * @return MAR_ERROR_NONE on success, an error code on failure.
+ */
+mar_error_code mar_augment_init_replay(const char *log_file);
+
+/**
+ * Reloads the configuration file of the augmentation, as mar_augment_ctx_reload_config.
+ *
+ * @param filename The filename of the configuration file
+ *
+ * @return MAR_ERROR_NONE on success, MAR_ERROR_READING_CONFIG if the file could not be read, in which case the
+ *         configuration is unchanged, an error code on failure.
+ */
+mar_error_code mar_augment_reload_config(const char *filename);
+
+/**
+ * Starts the augmentation cameras, and the detection thread of each view when pipelined
  *
  * @return MAR_ERROR_NONE on success, an error code on failure.
  */
 mar_error_code mar_start_capture();
 
 /**
- * Stops the augmentation camera
+ * Stops the augmentation cameras
  *
  * @return MAR_ERROR_NONE on success, an error code on failure.
  */
 mar_error_code mar_stop_capture();
 
 /**
- * Updates an augmentation frame
+ * Updates an augmentation frame of every view.  When pipelined, the frame of each view was captured and its keypoints
+ * detected on the view's detection thread while the previous frame was being tracked, and frames are always tracked
+ * in capture order.  The error of each view is kept for mar_augment_view_get_error, and the first is returned.
+ * Once a snapshot has been asked for, each update publishes a new one for the threads reading it.
+ * When built with MAR_DEBUG_ALLOCATIONS, heap allocations made by an update once augmentations have not been
+ * created or freed for MAR_AUGMENT_STEADY_STATE_FRAMES updates are reported on stderr.
  *
  * @return MAR_ERROR_NONE on success, an error code on failure.
  *
@@ -90,7 +390,31 @@ mar_error_code mar_stop_capture();
 mar_error_code mar_augment_update();
 
 /**
- * Creates a new augmentation
+ * Returns the number of views, one for each camera used for augmentation.
+ *
+ * @return The number of views, 0 if augmentation has not been initialized
+ */
+int mar_augment_get_num_views();
+
+/**
+ * Returns the error of the last update of a view.
+ *
+ * @param view The index of the view
+ *
+ * @return MAR_ERROR_NONE if the view's last update succeeded, an error code on failure.
+ */
+mar_error_code mar_augment_view_get_error(int view);
+
+/**
+ * Returns the number of heap allocations made during the last update, counting those of the detection thread
+ * when pipelined.
+ *
+ * @return The number of allocations, always 0 unless built with MAR_DEBUG_ALLOCATIONS
+ */
+unsigned long mar_augment_get_frame_allocations();
+
+/**
+ * Creates a new augmentation tracked in the first view, reusing freed IDs before new ones
  *
  * @param id Will be willed in with the augmentation's ID
  * @param region The MSER to track for augmentation
@@ -99,6 +423,17 @@ mar_error_code mar_augment_update();
  */
 mar_error_code mar_augment_new_augmentation(mar_augmentation_id *id, mar_mser *region);
 
+/**
+ * Creates a new augmentation tracked in a view, reusing freed IDs before new ones.  IDs are shared by every view.
+ *
+ * @param view The index of the view whose current frame the MSER was found in
+ * @param id Will be willed in with the augmentation's ID
+ * @param region The MSER to track for augmentation
+ * 
+ * @return MAR_ERROR_NONE on success, an error code on failure.
+ */
+mar_error_code mar_augment_view_new_augmentation(int view, mar_augmentation_id *id, mar_mser *region);
+
 /**
  * Augments a point using the affine transformation matrix of a MAR augmentation.
  *
@@ -127,14 +462,39 @@ mar_error_code mar_augment_transform_point(mar_augmentation_id id, float x, floa
 mar_error_code mar_augment_untransform_point(mar_augmentation_id id, float x, float y, float *tx, float *ty);
 
 /**
- * Frees resources for an augmentation
+ * Frees an augmentation.  Its ID is reused by a later augmentation, which also reuses its keypoint storage.
  *
  * @param id The augmentation ID
  */
 void mar_augment_free_augmentation(mar_augmentation_id id);
 
 /**
- * Returns the maximally stable extremal regions for a camera frame.
+ * Saves the models of every augmentation to a model cache, as mar_augment_ctx_save_models.
+ *
+ * @param file_name The file to write
+ *
+ * @return MAR_ERROR_NONE on success, an error code on failure.
+ */
+mar_error_code mar_augment_save_models(const char *file_name);
+
+/**
+ * Creates an augmentation for each model of a model cache, as mar_augment_ctx_load_models.
+ *
+ * @param file_name The file to read
+ * @param ids Will be filled with the IDs of the first max_ids augmentations created, may be NULL if max_ids is 0
+ * @param max_ids The size of the ids array
+ * @param num_ids Will be filled with the number of augmentations created
+ *
+ * @return MAR_ERROR_NONE on success, MAR_ERROR_MODEL_CACHE_NOT_FOUND if the cache does not exist,
+ *         MAR_ERROR_READING_MODEL_CACHE if the cache is not valid or its descriptors are not in the format of the
+ *         context, an error code on failure, in which case the augmentations created before the failure are kept.
+ */
+mar_error_code mar_augment_load_models(const char *file_name, mar_augmentation_id *ids, int max_ids, int *num_ids);
+
+/**
+ * Returns the maximally stable extremal regions for the current frame of the first view.
+ * When MSER are detected in the background, they are the latest regions detected on the view's MSER thread,
+ * from a recent frame, and none are returned until the first detection finishes.
  *
  * @param regions A pointer to a pointer which will be modified to point to the array of regions.
  * @param num_regions The number of MSER, and the size of the regions array
@@ -144,7 +504,20 @@ void mar_augment_free_augmentation(mar_augmentation_id id);
 mar_error_code mar_augment_get_regions(mar_mser **regions, int *num_regions);
 
 /**
- * Returns the SIFT keypoints for a camera frame.
+ * Returns the maximally stable extremal regions for the current frame of a view.
+ * When MSER are detected in the background, they are the latest regions detected on the view's MSER thread,
+ * from a recent frame, and none are returned until the first detection finishes.
+ *
+ * @param view The index of the view
+ * @param regions A pointer to a pointer which will be modified to point to the array of regions.
+ * @param num_regions The number of MSER, and the size of the regions array
+ *
+ * @return MAR_ERROR_NONE on success, an error code on failure.
+ */
+mar_error_code mar_augment_view_get_regions(int view, mar_mser **regions, int *num_regions);
+
+/**
+ * Returns the SIFT keypoints for the current frame of the first view.
  *
  * @param keypoints A pointer to a pointer which will be modified to point to the array of keypoints.
  * @param num_keypoints The number of SIFT keypoints, and the size of the regions array
@@ -154,20 +527,93 @@ mar_error_code mar_augment_get_regions(mar_mser **regions, int *num_regions);
 mar_error_code mar_augment_get_keypoints(mar_sift_keypoint **keypoints, int *num_keypoints);
 
 /**
- * Gets the camera ID used for augmentation.
+ * Returns the SIFT keypoints for the current frame of a view.
+ *
+ * @param view The index of the view
+ * @param keypoints A pointer to a pointer which will be modified to point to the array of keypoints.
+ * @param num_keypoints The number of SIFT keypoints, and the size of the regions array
+ *
+ * @return MAR_ERROR_NONE on success, an error code on failure.
+ */
+mar_error_code mar_augment_view_get_keypoints(int view, mar_sift_keypoint **keypoints, int *num_keypoints);
+
+/**
+ * Gets the camera ID of the first view.
  * 
  * @return The MAR library camera ID for the camera being used for augmentation
  */
 mar_camera_id mar_augment_get_camera();
 
 /**
- * Returns the camera's frame buffer in an RGB24 format.  
- * The frame buffer is 3 * width * height in size.
+ * Gets the camera ID of a view.
+ *
+ * @param view The index of the view
+ * 
+ * @return The MAR library camera ID for the view's camera, MAR_CAM_NO_CAMERA if the view does not exist
+ */
+mar_camera_id mar_augment_view_get_camera(int view);
+
+/**
+ * Returns the frame buffer of the first view's camera in an RGB24 format.  The frame is only converted the first
+ * time it is requested after an update.  The frame buffer is 3 * width * height in size.
  * 
  * @return The camera frame buffer.
  */
 unsigned char *mar_augment_get_camera_frame_buffer();
 
+/**
+ * Returns the frame buffer of a view's camera in an RGB24 format.  The frame is only converted the first time it is
+ * requested after an update.  The frame buffer is 3 * width * height in size.
+ *
+ * @param view The index of the view
+ * 
+ * @return The camera frame buffer, or NULL if the view does not exist
+ */
+unsigned char *mar_augment_view_get_camera_frame_buffer(int view);
+
+/**
+ * Returns the raw camera frame of the first view in the camera's own pixel format, so that it can be converted
+ * elsewhere, such as on the GPU.  The frame stays valid until the next update.
+ * 
+ * @return The camera frame, or NULL if no frame has been captured
+ */
+const mar_camera_frame *mar_augment_get_camera_frame();
+
+/**
+ * Returns the raw camera frame of a view in the camera's own pixel format, so that it can be converted elsewhere,
+ * such as on the GPU.  The frame stays valid until the next update.
+ *
+ * @param view The index of the view
+ * 
+ * @return The camera frame, or NULL if the view does not exist or no frame has been captured
+ */
+const mar_camera_frame *mar_augment_view_get_camera_frame(int view);
+
+/**
+ * Returns a level of the current camera frame's grayscale image pyramid for the first view.  Level 0 is the full
+ * resolution luma, and each level after it is half the width and height of the one before it.
+ *
+ * @param level The pyramid level
+ * @param width Will be filled with the width of the level, may be NULL
+ * @param height Will be filled with the height of the level, may be NULL
+ * 
+ * @return The 8-bit grayscale frame buffer, or NULL if the level does not exist
+ */
+const unsigned char *mar_augment_get_grayscale_frame_buffer(int level, int *width, int *height);
+
+/**
+ * Returns a level of the grayscale image pyramid of a view's current camera frame.  Level 0 is the full resolution
+ * luma, and each level after it is half the width and height of the one before it.
+ *
+ * @param view The index of the view
+ * @param level The pyramid level
+ * @param width Will be filled with the width of the level, may be NULL
+ * @param height Will be filled with the height of the level, may be NULL
+ * 
+ * @return The 8-bit grayscale frame buffer, or NULL if the view or level does not exist
+ */
+const unsigned char *mar_augment_view_get_grayscale_frame_buffer(int view, int level, int *width, int *height);
+
 /**
  * Frees the augmentation resources
  *
@@ -199,7 +645,18 @@ mar_error_code mar_stop_augmentation();
 mar_error_code mar_augmentation_get_error(mar_augmentation_id id);
 
 /**
- * Loads the transformation matrix for a given augmentation in a 4x4 column major matrix
+ * Returns the number of matched keypoints which agree with the last transformation of a specific augmentation.
+ * The more keypoints agree, the more confident the transformation is.
+ *
+ * @param id The augmentation's ID
+ *
+ * @return The number of agreeing keypoints, 0 if the last transformation could not be found
+ */
+int mar_augmentation_get_num_inliers(mar_augmentation_id id);
+
+/**
+ * Loads the transformation matrix for a given augmentation in a 4x4 column major matrix.  With a motion model,
+ * the transformation of an augmentation lost for a few frames is predicted from how it was moving.
  *
  * @param id The augmentation's ID
  * @param id Will be filled with the matrices values in a column major ordering.  
@@ -209,4 +666,491 @@ mar_error_code mar_augmentation_get_error(mar_augmentation_id id);
  */
 mar_error_code mar_augment_get_transformation(mar_augmentation_id id, float mat[]);
 
+/**
+ * Returns the view an augmentation is tracked in.
+ *
+ * @param id The augmentation's ID
+ *
+ * @return The index of the view, -1 if the augmentation does not exist
+ */
+int mar_augmentation_get_view(mar_augmentation_id id);
+
+/**
+ * Fills the results of the last update for the augmentations of a view or of every view, in order of their IDs.
+ *
+ * @param view The index of the view, or MAR_AUGMENT_ALL_VIEWS for the augmentations of every view
+ * @param results Will be filled with the results, max_results in size
+ * @param max_results The maximum number of results to fill
+ * @param num_results Will be filled with the number of results filled
+ *
+ * @return MAR_ERROR_NONE on success, an error code on failure.
+ */
+mar_error_code mar_augment_get_results(int view, mar_augmentation_result *results, int max_results, int *num_results);
+
+/**
+ * Acquires the latest snapshot of the augmentation, as mar_augment_ctx_acquire_snapshot.  May be called from any
+ * thread while another thread updates the augmentation.
+ *
+ * @param contents The \ref augment_snapshot_contents "contents" the following snapshots should copy
+ * @param snapshot Will be filled with the snapshot, which must be released with mar_augment_release_snapshot
+ *
+ * @return MAR_ERROR_NONE on success, MAR_ERROR_AGAIN if no snapshot has been published yet.
+ */
+mar_error_code mar_augment_acquire_snapshot(int contents, const mar_augment_snapshot **snapshot);
+
+/**
+ * Releases a snapshot acquired by mar_augment_acquire_snapshot.  May be called from any thread.
+ *
+ * @param snapshot The snapshot, may be NULL
+ */
+void mar_augment_release_snapshot(const mar_augment_snapshot *snapshot);
+
+/**
+ * Fills the latency percentiles of each stage, the number of dropped frames, and the keypoint, match and inlier
+ * counts of the augmentations, as mar_augment_ctx_get_stats.
+ *
+ * @param stats Will be filled with the statistics of the pipeline
+ * @param augmentations Will be filled with the statistics of each augmentation, max_augmentations in size, or NULL
+ * @param max_augmentations The maximum number of augmentation statistics to fill
+ * @param num_augmentations Will be filled with the number of augmentation statistics filled, or NULL
+ *
+ * @return MAR_ERROR_NONE on success, an error code on failure.
+ */
+mar_error_code mar_augment_get_stats(mar_augment_stats *stats, mar_augmentation_stats *augmentations, int max_augmentations, int *num_augmentations);
+
+/**
+ * Forgets the latencies recorded so far, so the next statistics only cover what follows.
+ *
+ * @return MAR_ERROR_NONE on success, an error code on failure.
+ */
+mar_error_code mar_augment_reset_stats();
+
+/**
+ * Pushes frames through the augmentation as fast as the cameras deliver them, passing the results of every
+ * augmentation of every view to a callback after each update.  Capture is started before the first frame and
+ * stopped after the last, so cameras which are not paced, such as MAR_CAM_TYPE_FILE, are processed faster than
+ * real-time.  The callback may create and free augmentations, and augmentation must be started for any to be tracked.
+ *
+ * @param max_frames The maximum number of frames to process, 0 to process every frame until a camera's stream ends
+ * @param callback Called with the results of each frame, may be NULL
+ * @param arg The argument passed to the callback
+ * @param num_frames Will be filled with the number of frames processed
+ *
+ * @return MAR_ERROR_NONE once max_frames or every frame of a stream has been processed, an error code on failure.
+ */
+mar_error_code mar_augment_run_batch(unsigned int max_frames, mar_augment_batch_callback callback, void *arg, unsigned int *num_frames);
+
+/**
+ * Creates an augmentation context using a configuration file.  Every entry of the cameras list is opened as a view
+ * with its own detectors, or only the camera group when there is no cameras list.  Contexts share no state, so
+ * each may be updated on its own thread, but the cameras of every context come from the same MAR_CAM_MAX_NUM_CAMERAS.
+ * When augment.record names a file, the configuration, every captured frame and every call made to the context
+ * are recorded into it as a capture log.  When augment.model_cache names a file and the session is not recorded,
+ * the augmentations saved to it by the last session are loaded, and once the cache has been loaded or found not
+ * to exist yet the augmentations are saved to it when the context is freed.
+ *
+ * @param ctx Will be filled with the context, freed with mar_augment_ctx_free
+ * @param filename The filename of the configuration file, NULL for default settings
+ *
+ * @return MAR_ERROR_NONE on success, an error code on failure.
+ */
+mar_error_code mar_augment_ctx_new(mar_augment_ctx **ctx_out, char *filename);
+
+/**
+ * Creates an augmentation context replaying a recorded capture log.  The context is configured as the recorded one
+ * was, each view replays the frames its camera captured, and the recorded calls which created and freed augmentations
+ * or started and stopped augmentation are made again before the same updates, so the same results are computed
+ * bit-exactly by the same build.  Those calls must not be made by the caller.
+ *
+ * @param ctx Will be filled with the context, freed with mar_augment_ctx_free
+ * @param log_file The filename of the capture log
+ *
+ * @return MAR_ERROR_NONE on success, an error code on failure.
+ */
+mar_error_code mar_augment_ctx_new_replay(mar_augment_ctx **ctx_out, const char *log_file);
+
+/**
+ * Reloads the configuration file of a context, to be applied before the next update without recreating the
+ * pipeline or losing any augmentation.  The MSER and SIFT thresholds, the SIFT octaves, the FAST threshold and
+ * every augment setting read each update, such as the RANSAC, ROI detection, motion model, optical flow,
+ * governor limits and MSER interval and level settings, are changed.  Each detector is changed by the thread
+ * using it before its next detection, and SIFT filters are recreated there when their octaves change.  Settings
+ * missing from the file return to their defaults.  The cameras, image pyramid, feature backend, descriptor
+ * format, keypoint indices, threads and the settings enabling optical flow, the governor, background MSER,
+ * recording and the model cache only change when a new context is created.  A capture log keeps the
+ * configuration the session started with.  May be called from any thread while the context is being updated.
+ *
+ * @param ctx The augmentation context
+ * @param filename The filename of the configuration file
+ *
+ * @return MAR_ERROR_NONE on success, MAR_ERROR_READING_CONFIG if the file could not be read, in which case the
+ *         configuration is unchanged, an error code on failure.  A setting which cannot be applied to a detector
+ *         is reported as the error of the next update of its view.
+ */
+mar_error_code mar_augment_ctx_reload_config(mar_augment_ctx *ctx, const char *filename);
+
+/**
+ * Starts the augmentation cameras, and the detection thread of each view when pipelined
+ *
+ * @param ctx The augmentation context
+ *
+ * @return MAR_ERROR_NONE on success, an error code on failure.
+ */
+mar_error_code mar_augment_ctx_start_capture(mar_augment_ctx *ctx);
+
+/**
+ * Stops the augmentation cameras
+ *
+ * @param ctx The augmentation context
+ *
+ * @return MAR_ERROR_NONE on success, an error code on failure.
+ */
+mar_error_code mar_augment_ctx_stop_capture(mar_augment_ctx *ctx);
+
+/**
+ * Starts the augmentation algorithm.
+ *
+ * @param ctx The augmentation context
+ *
+ * @return MAR_ERROR_NONE on success, an error code on failure.
+ */
+mar_error_code mar_augment_ctx_start_augmentation(mar_augment_ctx *ctx);
+
+/**
+ * Stops the augmentation algorithm.
+ *
+ * @param ctx The augmentation context
+ *
+ * @return MAR_ERROR_NONE on success, an error code on failure.
+ */
+mar_error_code mar_augment_ctx_stop_augmentation(mar_augment_ctx *ctx);
+
+/**
+ * Updates an augmentation frame of every view.  When pipelined, the frame of each view was captured and its keypoints
+ * detected on the view's detection thread while the previous frame was being tracked, and frames are always tracked
+ * in capture order.  The error of each view is kept for mar_augment_ctx_view_get_error, and the first is returned.
+ * Once a snapshot has been asked for, each update publishes a new one for the threads reading it.
+ * When built with MAR_DEBUG_ALLOCATIONS, heap allocations made by an update once augmentations have not been
+ * created or freed for MAR_AUGMENT_STEADY_STATE_FRAMES updates are reported on stderr.
+ *
+ * @param ctx The augmentation context
+ *
+ * @return MAR_ERROR_NONE on success, an error code on failure.
+ *
+ * @todo Add unmatched SIFT keypoints after they appear consecutively so many times
+ * @todo Try using all matched keypoints when calculating the transformation matrix
+ */
+mar_error_code mar_augment_ctx_update(mar_augment_ctx *ctx);
+
+/**
+ * Returns the number of heap allocations made during the last update, counting those of the detection thread
+ * when pipelined.  The allocations are counted for the whole process, so they include those of any other context
+ * updated at the same time.
+ *
+ * @param ctx The augmentation context
+ *
+ * @return The number of allocations, always 0 unless built with MAR_DEBUG_ALLOCATIONS
+ */
+unsigned long mar_augment_ctx_get_frame_allocations(mar_augment_ctx *ctx);
+
+/**
+ * Loads the transformation matrix for a given augmentation in a 4x4 column major matrix.  With a motion model,
+ * the transformation of an augmentation lost for a few frames is predicted from how it was moving.
+ *
+ * @param ctx The augmentation context
+ * @param id The augmentation's ID
+ * @param id Will be filled with the matrices values in a column major ordering.  
+ *
+ * @return MAR_ERROR_NONE on success, an error code on failure.
+ */
+mar_error_code mar_augment_ctx_get_transformation(mar_augment_ctx *ctx, mar_augmentation_id id, float mat[]);
+
+/**
+ * Returns the last error code for a specific augmentation
+ *
+ * @param ctx The augmentation context
+ * @param id The augmentation's ID
+ *
+ * @return MAR_ERROR_NONE on success, an error code on failure.
+ */
+mar_error_code mar_augment_ctx_get_augmentation_error(mar_augment_ctx *ctx, mar_augmentation_id id);
+
+/**
+ * Returns the number of matched keypoints which agree with the last transformation of a specific augmentation.
+ * The more keypoints agree, the more confident the transformation is.
+ *
+ * @param ctx The augmentation context
+ * @param id The augmentation's ID
+ *
+ * @return The number of agreeing keypoints, 0 if the last transformation could not be found
+ */
+int mar_augment_ctx_get_augmentation_num_inliers(mar_augment_ctx *ctx, mar_augmentation_id id);
+
+/**
+ * Creates a new augmentation tracked in a view, reusing freed IDs before new ones.  IDs are shared by every view.
+ *
+ * @param ctx The augmentation context
+ * @param view The index of the view whose current frame the MSER was found in
+ * @param id Will be willed in with the augmentation's ID
+ * @param region The MSER to track for augmentation
+ * 
+ * @return MAR_ERROR_NONE on success, an error code on failure.
+ */
+mar_error_code mar_augment_ctx_view_new_augmentation(mar_augment_ctx *ctx, int view, mar_augmentation_id *id, mar_mser *region);
+
+/**
+ * Augments a point using the affine transformation matrix of a MAR augmentation.
+ *
+ * @param ctx The augmentation context
+ * @param id The ID of the augmentation to use
+ * @param x The X coordinate of the point
+ * @param y The Y coordinate of the point
+ * @param tx Will be set to the transformed X coordinate of the point
+ * @param ty Will be set to the transformed Y coordinate of the point
+ * 
+ * @return MAR_ERROR_NONE on success, an error code on failure.
+ */
+mar_error_code mar_augment_ctx_transform_point(mar_augment_ctx *ctx, mar_augmentation_id id, float x, float y, float *tx, float *ty);
+
+/**
+ * Deaugments a point using the affine transformation matrix of a MAR augmentation.  Changes the transform from the
+ * current frame's transform to the initial frame's transform.
+ *
+ * @param ctx The augmentation context
+ * @param id The ID of the augmentation to use
+ * @param x The X coordinate of the point
+ * @param y The Y coordinate of the point
+ * @param tx Will be set to the untransformed X coordinate of the point
+ * @param ty Will be set to the untransformed Y coordinate of the point
+ * 
+ * @return MAR_ERROR_NONE on success, an error code on failure.
+ */
+mar_error_code mar_augment_ctx_untransform_point(mar_augment_ctx *ctx, mar_augmentation_id id, float x, float y, float *tx, float *ty);
+
+/**
+ * Frees an augmentation.  Its ID is reused by a later augmentation, which also reuses its keypoint storage.
+ *
+ * @param ctx The augmentation context
+ * @param id The augmentation ID
+ */
+void mar_augment_ctx_free_augmentation(mar_augment_ctx *ctx, mar_augmentation_id id);
+
+/**
+ * Saves the models of every augmentation to a model cache, replacing any file of the same name once every model
+ * is written, so that they can be loaded by mar_augment_ctx_load_models in a later session.  Each model keeps its
+ * MSER, its keypoints and the transformation it was last tracked at.
+ *
+ * @param ctx The augmentation context
+ * @param file_name The file to write
+ *
+ * @return MAR_ERROR_NONE on success, an error code on failure.
+ */
+mar_error_code mar_augment_ctx_save_models(mar_augment_ctx *ctx, const char *file_name);
+
+/**
+ * Creates an augmentation for each model of a model cache saved by mar_augment_ctx_save_models, without selecting
+ * its region again.  Each augmentation starts at the transformation its model was last tracked at and is found
+ * again by the usual search of the view's frames.  Models of views the context does not have are skipped.  Loaded
+ * augmentations are not recorded into capture logs.
+ *
+ * @param ctx The augmentation context
+ * @param file_name The file to read
+ * @param ids Will be filled with the IDs of the first max_ids augmentations created, may be NULL if max_ids is 0
+ * @param max_ids The size of the ids array
+ * @param num_ids Will be filled with the number of augmentations created
+ *
+ * @return MAR_ERROR_NONE on success, MAR_ERROR_MODEL_CACHE_NOT_FOUND if the cache does not exist,
+ *         MAR_ERROR_READING_MODEL_CACHE if the cache is not valid or its descriptors are not in the format of the
+ *         context, an error code on failure, in which case the augmentations created before the failure are kept.
+ */
+mar_error_code mar_augment_ctx_load_models(mar_augment_ctx *ctx, const char *file_name, mar_augmentation_id *ids, int max_ids, int *num_ids);
+
+/**
+ * Returns the maximally stable extremal regions for the current frame of a view.
+ * When MSER are detected in the background, they are the latest regions detected on the view's MSER thread,
+ * from a recent frame, and none are returned until the first detection finishes.
+ *
+ * @param ctx The augmentation context
+ * @param view The index of the view
+ * @param regions A pointer to a pointer which will be modified to point to the array of regions.
+ * @param num_regions The number of MSER, and the size of the regions array
+ *
+ * @return MAR_ERROR_NONE on success, an error code on failure.
+ */
+mar_error_code mar_augment_ctx_view_get_regions(mar_augment_ctx *ctx, int view, mar_mser **regions, int *num_regions);
+
+/**
+ * Returns the SIFT keypoints for the current frame of a view.
+ *
+ * @param ctx The augmentation context
+ * @param view The index of the view
+ * @param keypoints A pointer to a pointer which will be modified to point to the array of keypoints.
+ * @param num_keypoints The number of SIFT keypoints, and the size of the regions array
+ *
+ * @return MAR_ERROR_NONE on success, an error code on failure.
+ */
+mar_error_code mar_augment_ctx_view_get_keypoints(mar_augment_ctx *ctx, int view, mar_sift_keypoint **keypoints, int *num_keypoints);
+
+/**
+ * Returns the number of views, one for each camera used for augmentation.
+ *
+ * @param ctx The augmentation context
+ *
+ * @return The number of views, 0 if augmentation has not been initialized
+ */
+int mar_augment_ctx_get_num_views(mar_augment_ctx *ctx);
+
+/**
+ * Returns the error of the last update of a view.
+ *
+ * @param ctx The augmentation context
+ * @param view The index of the view
+ *
+ * @return MAR_ERROR_NONE if the view's last update succeeded, an error code on failure.
+ */
+mar_error_code mar_augment_ctx_view_get_error(mar_augment_ctx *ctx, int view);
+
+/**
+ * Returns the view an augmentation is tracked in.
+ *
+ * @param ctx The augmentation context
+ * @param id The augmentation's ID
+ *
+ * @return The index of the view, -1 if the augmentation does not exist
+ */
+int mar_augment_ctx_get_augmentation_view(mar_augment_ctx *ctx, mar_augmentation_id id);
+
+/**
+ * Fills the results of the last update for the augmentations of a view or of every view, in order of their IDs.
+ *
+ * @param ctx The augmentation context
+ * @param view The index of the view, or MAR_AUGMENT_ALL_VIEWS for the augmentations of every view
+ * @param results Will be filled with the results, max_results in size
+ * @param max_results The maximum number of results to fill
+ * @param num_results Will be filled with the number of results filled
+ *
+ * @return MAR_ERROR_NONE on success, an error code on failure.
+ */
+mar_error_code mar_augment_ctx_get_results(mar_augment_ctx *ctx, int view, mar_augmentation_result *results, int max_results, int *num_results);
+
+/**
+ * Acquires the latest snapshot of an augmentation context, holding the errors and results of its last update and
+ * the other contents asked for.  Contexts only publish snapshots once one has been asked for, so the first call
+ * returns MAR_ERROR_AGAIN until the next update.  Each update copies the contents asked for by the last call.  A
+ * snapshot never changes while it is held, so a reader should hold at most one at a time and release it quickly,
+ * and an update skips publishing when every other snapshot is held.  May be called from any thread while another
+ * thread updates the context.
+ *
+ * @param ctx The augmentation context
+ * @param contents The \ref augment_snapshot_contents "contents" the following snapshots should copy
+ * @param snapshot Will be filled with the snapshot, which must be released with mar_augment_ctx_release_snapshot
+ *
+ * @return MAR_ERROR_NONE on success, MAR_ERROR_AGAIN if no snapshot has been published yet.
+ */
+mar_error_code mar_augment_ctx_acquire_snapshot(mar_augment_ctx *ctx, int contents, const mar_augment_snapshot **snapshot);
+
+/**
+ * Releases a snapshot acquired by mar_augment_ctx_acquire_snapshot.  May be called from any thread.
+ *
+ * @param ctx The augmentation context
+ * @param snapshot The snapshot, may be NULL
+ */
+void mar_augment_ctx_release_snapshot(mar_augment_ctx *ctx, const mar_augment_snapshot *snapshot);
+
+/**
+ * Gets the camera ID of a view.
+ *
+ * @param ctx The augmentation context
+ * @param view The index of the view
+ * 
+ * @return The MAR library camera ID for the view's camera, MAR_CAM_NO_CAMERA if the view does not exist
+ */
+mar_camera_id mar_augment_ctx_view_get_camera(mar_augment_ctx *ctx, int view);
+
+/**
+ * Returns the frame buffer of a view's camera in an RGB24 format.  The frame is only converted the first time it is
+ * requested after an update.  The frame buffer is 3 * width * height in size.
+ *
+ * @param ctx The augmentation context
+ * @param view The index of the view
+ * 
+ * @return The camera frame buffer, or NULL if the view does not exist
+ */
+unsigned char *mar_augment_ctx_view_get_camera_frame_buffer(mar_augment_ctx *ctx, int view);
+
+/**
+ * Returns the raw camera frame of a view in the camera's own pixel format, so that it can be converted elsewhere,
+ * such as on the GPU.  The frame stays valid until the next update.
+ *
+ * @param ctx The augmentation context
+ * @param view The index of the view
+ * 
+ * @return The camera frame, or NULL if the view does not exist or no frame has been captured
+ */
+const mar_camera_frame *mar_augment_ctx_view_get_camera_frame(mar_augment_ctx *ctx, int view);
+
+/**
+ * Returns a level of the grayscale image pyramid of a view's current camera frame.  Level 0 is the full resolution
+ * luma, and each level after it is half the width and height of the one before it.
+ *
+ * @param ctx The augmentation context
+ * @param view The index of the view
+ * @param level The pyramid level
+ * @param width Will be filled with the width of the level, may be NULL
+ * @param height Will be filled with the height of the level, may be NULL
+ * 
+ * @return The 8-bit grayscale frame buffer, or NULL if the view or level does not exist
+ */
+const unsigned char *mar_augment_ctx_view_get_grayscale_frame_buffer(mar_augment_ctx *ctx, int view, int level, int *width, int *height);
+
+/**
+ * Frees an augmentation context, stopping its cameras and detection threads.
+ *
+ * @param ctx The context, may be NULL
+ */
+void mar_augment_ctx_free(mar_augment_ctx *ctx);
+
+/**
+ * Pushes frames through the augmentation as fast as the cameras deliver them, passing the results of every
+ * augmentation of every view to a callback after each update.  Capture is started before the first frame and
+ * stopped after the last, so cameras which are not paced, such as MAR_CAM_TYPE_FILE, are processed faster than
+ * real-time.  The callback may create and free augmentations, and augmentation must be started for any to be tracked.
+ *
+ * @param ctx The augmentation context
+ * @param max_frames The maximum number of frames to process, 0 to process every frame until a camera's stream ends
+ * @param callback Called with the results of each frame, may be NULL
+ * @param arg The argument passed to the callback
+ * @param num_frames Will be filled with the number of frames processed
+ *
+ * @return MAR_ERROR_NONE once max_frames or every frame of a stream has been processed, an error code on failure.
+ */
+mar_error_code mar_augment_ctx_run_batch(mar_augment_ctx *ctx, unsigned int max_frames, mar_augment_batch_callback callback, void *arg,
+    unsigned int *num_frames);
+
+/**
+ * Fills the latency percentiles of each stage since the context was created or its statistics were reset, the
+ * number of frames the cameras dropped, and the keypoint, match and inlier counts of the augmentations, in order
+ * of their IDs.  Stages are timed as they run on every thread of the pipeline, so the statistics may be read while
+ * the pipeline runs, but only between updates on the thread using the context.
+ *
+ * @param ctx The augmentation context
+ * @param stats Will be filled with the statistics of the pipeline
+ * @param augmentations Will be filled with the statistics of each augmentation, max_augmentations in size, or NULL
+ * @param max_augmentations The maximum number of augmentation statistics to fill
+ * @param num_augmentations Will be filled with the number of augmentation statistics filled, or NULL
+ *
+ * @return MAR_ERROR_NONE on success, an error code on failure.
+ */
+mar_error_code mar_augment_ctx_get_stats(mar_augment_ctx *ctx, mar_augment_stats *stats, mar_augmentation_stats *augmentations,
+    int max_augmentations, int *num_augmentations);
+
+/**
+ * Forgets the latencies recorded so far, so the next statistics only cover what follows.
+ *
+ * @param ctx The augmentation context
+ *
+ * @return MAR_ERROR_NONE on success, an error code on failure.
+ */
+mar_error_code mar_augment_ctx_reset_stats(mar_augment_ctx *ctx);
+
 #endif
@@ -0,0 +1,358 @@
+/**
+ * @file mar_model_cache.c
+ *
+ * Contains a cache of augmentation models, so that augmentations created in one session can be found again in
+ * the next without selecting their regions again.  The cache is a header followed by one record for each model,
+ * a fixed size description followed by the model's keypoint coordinates, keypoint statistics and descriptors,
+ * padded to 8 bytes, so a cache is read in place by memory mapping it.  Descriptors are stored in the format of
+ * the keypoint index they were taken from, and models may only be loaded into indices of the same format.
+ *
+ * @author Greg Eddington
+ */
+
+#include "mar_model_cache.h"
+#include "../common/mar_common.h"
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/** The alignment of every model record */
+#define MAR_MODEL_CACHE_ALIGNMENT 8
+/** The suffix of the file a cache is written to before it replaces the cache */
+#define MAR_MODEL_CACHE_TEMP_SUFFIX ".tmp"
+
+/**
+ * The header at the start of every model cache
+ */
+typedef struct
+{
+  /** MAR_MODEL_CACHE_MAGIC */
+  char magic[8];
+  /** MAR_MODEL_CACHE_VERSION */
+  uint32_t version;
+  /** The format of the descriptors, one of the keypoint index formats */
+  uint32_t descriptor_format;
+  /** The number of bytes of each keypoint's descriptor */
+  uint32_t descriptor_size;
+  /** Zero */
+  uint32_t reserved;
+}
+mar_model_cache_header;
+
+/**
+ * Returns the number of bytes of a model record without its padding.
+ *
+ * @param num_keypoints The number of keypoints of the model
+ * @param descriptor_size The number of bytes of each keypoint's descriptor
+ *
+ * @return The length of the record
+ */
+MAR_PRIVATE
+uint64_t mar_model_cache_record_length(uint64_t num_keypoints, uint64_t descriptor_size)
+{
+  return sizeof(mar_model_cache_model) + num_keypoints * (2 * sizeof(float) + 2 * sizeof(uint16_t) + descriptor_size);
+}
+
+/**
+ * Returns the number of bytes a record takes with its padding.
+ *
+ * @param length The number of bytes of the record
+ *
+ * @return The padded length
+ */
+MAR_PRIVATE
+uint64_t mar_model_cache_padded(uint64_t length)
+{
+  return (length + MAR_MODEL_CACHE_ALIGNMENT - 1) & ~(uint64_t)(MAR_MODEL_CACHE_ALIGNMENT - 1);
+}
+
+/**
+ * Creates a model cache.  The cache is written beside the file and replaces it only once it is written completely, so
+ * a failed write keeps the previous cache.
+ *
+ * @param writer A pointer to a pointer which will be modified to point at the new cache
+ * @param file_name The file to write
+ * @param descriptor_format The format of the descriptors, one of the keypoint index formats
+ * @param descriptor_size The number of bytes of each keypoint's descriptor
+ *
+ * @return MAR_ERROR_NONE on success, an error code on failure
+ */
+MAR_PUBLIC
+mar_error_code mar_model_cache_writer_new(mar_model_cache_writer **writer, const char *file_name, uint32_t descriptor_format,
+    uint32_t descriptor_size)
+{
+  mar_model_cache_header header;
+  mar_model_cache_writer *w;
+  size_t length;
+
+  *writer = w = mar_calloc(1, sizeof(mar_model_cache_writer));
+  if (w == NULL)
+  {
+    return MAR_ERROR_MALLOC;
+  }
+
+  length = strlen(file_name);
+  w->file_name = mar_malloc(length + 1);
+  w->temp_file_name = mar_malloc(length + sizeof(MAR_MODEL_CACHE_TEMP_SUFFIX));
+  if (w->file_name == NULL || w->temp_file_name == NULL)
+  {
+    mar_free(w->file_name);
+    mar_free(w->temp_file_name);
+    mar_free(w);
+    return MAR_ERROR_MALLOC;
+  }
+  memcpy(w->file_name, file_name, length + 1);
+  memcpy(w->temp_file_name, file_name, length);
+  memcpy(w->temp_file_name + length, MAR_MODEL_CACHE_TEMP_SUFFIX, sizeof(MAR_MODEL_CACHE_TEMP_SUFFIX));
+
+  w->file = fopen(w->temp_file_name, "wb");
+  if (w->file == NULL)
+  {
+    mar_free(w->file_name);
+    mar_free(w->temp_file_name);
+    mar_free(w);
+    return MAR_ERROR_DEVICE_OPEN;
+  }
+  w->descriptor_size = descriptor_size;
+  w->error = MAR_ERROR_NONE;
+
+  MAR_CLEAR(header);
+  memcpy(header.magic, MAR_MODEL_CACHE_MAGIC, sizeof(header.magic));
+  header.version = MAR_MODEL_CACHE_VERSION;
+  header.descriptor_format = descriptor_format;
+  header.descriptor_size = descriptor_size;
+  if (fwrite(&header, sizeof(header), 1, w->file) != 1)
+  {
+    w->error = MAR_ERROR_WRITING_MODEL_CACHE;
+    return mar_model_cache_writer_free(w);
+  }
+
+  return MAR_ERROR_NONE;
+}
+
+/**
+ * Finishes writing a model cache and frees it.
+ *
+ * @param writer The cache
+ *
+ * @return MAR_ERROR_NONE on success, MAR_ERROR_WRITING_MODEL_CACHE if any model could not be written, in which case
+ *         the file is left as it was
+ */
+MAR_PUBLIC
+mar_error_code mar_model_cache_writer_free(mar_model_cache_writer *writer)
+{
+  mar_error_code mrv = writer->error;
+
+  if (fclose(writer->file) != 0)
+  {
+    mrv = MAR_ERROR_WRITING_MODEL_CACHE;
+  }
+
+  // Only a complete cache replaces the last one
+  if (mrv == MAR_ERROR_NONE && rename(writer->temp_file_name, writer->file_name) != 0)
+  {
+    mrv = MAR_ERROR_WRITING_MODEL_CACHE;
+  }
+  if (mrv != MAR_ERROR_NONE)
+  {
+    remove(writer->temp_file_name);
+  }
+
+  mar_free(writer->file_name);
+  mar_free(writer->temp_file_name);
+  mar_free(writer);
+
+  return mrv;
+}
+
+/**
+ * Writes a model.  The first error is kept, and nothing more is written afterwards.
+ *
+ * @param writer The cache
+ * @param model The description of the model
+ * @param initial_x The X coordinates of the keypoints on the initial surface
+ * @param initial_y The Y coordinates of the keypoints on the initial surface
+ * @param hits The number of frames each keypoint was matched in
+ * @param misses The number of frames each keypoint was not matched in
+ * @param descriptors The descriptors of the keypoints, one after another
+ *
+ * @return MAR_ERROR_NONE on success, MAR_ERROR_WRITING_MODEL_CACHE on failure
+ */
+MAR_PUBLIC
+mar_error_code mar_model_cache_write_model(mar_model_cache_writer *writer, const mar_model_cache_model *model, const float *initial_x,
+    const float *initial_y, const uint16_t *hits, const uint16_t *misses, const void *descriptors)
+{
+  static const uint8_t padding[MAR_MODEL_CACHE_ALIGNMENT] = { 0 };
+  size_t n = model->num_keypoints;
+  uint64_t length;
+
+  length = mar_model_cache_record_length(n, writer->descriptor_size);
+  if (writer->error == MAR_ERROR_NONE &&
+      (fwrite(model, sizeof(*model), 1, writer->file) != 1 ||
+       fwrite(initial_x, sizeof(float), n, writer->file) != n ||
+       fwrite(initial_y, sizeof(float), n, writer->file) != n ||
+       fwrite(hits, sizeof(uint16_t), n, writer->file) != n ||
+       fwrite(misses, sizeof(uint16_t), n, writer->file) != n ||
+       fwrite(descriptors, writer->descriptor_size, n, writer->file) != n ||
+       fwrite(padding, 1, mar_model_cache_padded(length) - length, writer->file) != mar_model_cache_padded(length) - length))
+  {
+    writer->error = MAR_ERROR_WRITING_MODEL_CACHE;
+  }
+
+  return writer->error;
+}
+
+/**
+ * Walks the model records of a mapped cache, counting them or filling the cache's index.  A record cut short by the
+ * end of the file ends the cache.
+ *
+ * @param cache The cache, whose index is filled if fill is set
+ * @param fill Whether or not to fill the index, which must have room for every model counted before
+ */
+MAR_PRIVATE
+void mar_model_cache_index(mar_model_cache *cache, char fill)
+{
+  size_t offset = sizeof(mar_model_cache_header);
+  const mar_model_cache_model *model;
+  uint64_t length;
+
+  cache->num_models = 0;
+  while (offset + sizeof(mar_model_cache_model) <= cache->length)
+  {
+    model = (const mar_model_cache_model *)(cache->data + offset);
+    length = mar_model_cache_record_length(model->num_keypoints, cache->descriptor_size);
+    if (length > cache->length - offset)
+    {
+      break;
+    }
+
+    if (fill)
+    {
+      cache->models[cache->num_models] = offset;
+    }
+    cache->num_models++;
+
+    // The padding of the last record may be cut short too
+    offset += mar_model_cache_padded(length);
+  }
+}
+
+/**
+ * Maps a model cache and indexes its models.
+ *
+ * @param cache A pointer to a pointer which will be modified to point at the cache
+ * @param file_name The file to read
+ *
+ * @return MAR_ERROR_NONE on success, MAR_ERROR_MODEL_CACHE_NOT_FOUND if the file does not exist, MAR_ERROR_READING_MODEL_CACHE
+ *         if the file is not a model cache, an error code on failure
+ */
+MAR_PUBLIC
+mar_error_code mar_model_cache_open(mar_model_cache **cache, const char *file_name)
+{
+  const mar_model_cache_header *header;
+  struct stat st;
+  mar_model_cache *c;
+  void *data;
+  int fd;
+
+  *cache = c = mar_calloc(1, sizeof(mar_model_cache));
+  if (c == NULL)
+  {
+    return MAR_ERROR_MALLOC;
+  }
+
+  // Map the whole cache, the mapping outlives the file descriptor
+  fd = open(file_name, O_RDONLY);
+  if (fd == -1)
+  {
+    mar_free(c);
+    return errno == ENOENT ? MAR_ERROR_MODEL_CACHE_NOT_FOUND : MAR_ERROR_DEVICE_OPEN;
+  }
+  if (fstat(fd, &st) == -1 || !S_ISREG(st.st_mode) || (size_t)st.st_size < sizeof(mar_model_cache_header))
+  {
+    close(fd);
+    mar_free(c);
+    return MAR_ERROR_READING_MODEL_CACHE;
+  }
+  c->length = st.st_size;
+  data = mmap(NULL, c->length, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (data == MAP_FAILED)
+  {
+    mar_free(c);
+    return MAR_ERROR_MMAP;
+  }
+  c->data = data;
+
+  header = (const mar_model_cache_header *)c->data;
+  if (memcmp(header->magic, MAR_MODEL_CACHE_MAGIC, sizeof(header->magic)) != 0 || header->version != MAR_MODEL_CACHE_VERSION)
+  {
+    munmap(data, c->length);
+    mar_free(c);
+    return MAR_ERROR_READING_MODEL_CACHE;
+  }
+  c->descriptor_format = header->descriptor_format;
+  c->descriptor_size = header->descriptor_size;
+
+  // Count the models, then index them
+  mar_model_cache_index(c, 0);
+  c->models = mar_malloc((c->num_models > 0 ? c->num_models : 1) * sizeof(size_t));
+  if (c->models == NULL)
+  {
+    mar_model_cache_free(c);
+    return MAR_ERROR_MALLOC;
+  }
+  mar_model_cache_index(c, 1);
+
+  return MAR_ERROR_NONE;
+}
+
+/**
+ * Unmaps a model cache and frees it.  Models taken from the cache must not be accessed afterwards.
+ *
+ * @param cache The cache
+ */
+MAR_PUBLIC
+void mar_model_cache_free(mar_model_cache *cache)
+{
+  mar_free(cache->models);
+  munmap((void *)cache->data, cache->length);
+  mar_free(cache);
+}
+
+/**
+ * Fills an entry with a model of a cache.  The entry points into the mapped cache.
+ *
+ * @param cache The cache
+ * @param index The index of the model
+ * @param entry Will be filled with the model
+ *
+ * @return MAR_ERROR_NONE on success, MAR_ERROR_INVALID_ARGUMENT if the cache has no such model
+ */
+MAR_PUBLIC
+mar_error_code mar_model_cache_get_model(const mar_model_cache *cache, uint32_t index, mar_model_cache_entry *entry)
+{
+  const uint8_t *payload;
+  size_t n;
+
+  if (index >= cache->num_models)
+  {
+    return MAR_ERROR_INVALID_ARGUMENT;
+  }
+
+  entry->model = (const mar_model_cache_model *)(cache->data + cache->models[index]);
+  n = entry->model->num_keypoints;
+  payload = (const uint8_t *)(entry->model + 1);
+  entry->initial_x = (const float *)payload;
+  entry->initial_y = (const float *)(payload + n * sizeof(float));
+  entry->hits = (const uint16_t *)(payload + 2 * n * sizeof(float));
+  entry->misses = (const uint16_t *)(payload + 2 * n * sizeof(float) + n * sizeof(uint16_t));
+  entry->descriptors = payload + 2 * n * (sizeof(float) + sizeof(uint16_t));
+
+  return MAR_ERROR_NONE;
+}
@@ -0,0 +1,179 @@
+/**
+ * @file mar_model_cache.h
+ *
+ * Contains a cache of augmentation models, so that augmentations created in one session can be found again in
+ * the next without selecting their regions again.  The cache is a header followed by one record for each model,
+ * a fixed size description followed by the model's keypoint coordinates, keypoint statistics and descriptors,
+ * padded to 8 bytes, so a cache is read in place by memory mapping it.  Descriptors are stored in the format of
+ * the keypoint index they were taken from, and models may only be loaded into indices of the same format.
+ *
+ * @author Greg Eddington
+ */
+
+#ifndef MAR_MODEL_CACHE_H
+#define MAR_MODEL_CACHE_H
+
+#include "../common/mar_error.h"
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/** The bytes which start every model cache */
+#define MAR_MODEL_CACHE_MAGIC "MARMODL\n"
+/** The version of the model cache layout */
+#define MAR_MODEL_CACHE_VERSION 1
+
+/**
+ * The description of a model, followed in the cache by its keypoints @return
+ */
+typedef struct
+{
+  /** The view the model was tracked in @return */
+  int32_t view;
+  /** The number of keypoints of the model @return */
+  uint32_t num_keypoints;
+  /** The X coordinate of the center of the model's MSER @return */
+  float ellipse_x;
+  /** The Y coordinate of the center of the model's MSER @return */
+  float ellipse_y;
+  /** The semimajor axis of the model's MSER @return */
+  float ellipse_a;
+  /** The semiminor axis of the model's MSER @return */
+  float ellipse_b;
+  /** The angle of rotation of the model's MSER @return */
+  float ellipse_angle;
+  /** The affine transformation of the model's last pose, a, b, c, d, tx and ty @return */
+  float pose[6];
+  /** Zero @return */
+  uint32_t reserved;
+}
+mar_model_cache_model;
+
+/**
+ * A model of a mapped cache, pointing into the mapping @return
+ */
+typedef struct
+{
+  /** The description of the model @return */
+  const mar_model_cache_model *model;
+  /** The X coordinates of the keypoints on the initial surface @return */
+  const float *initial_x;
+  /** The Y coordinates of the keypoints on the initial surface @return */
+  const float *initial_y;
+  /** The number of frames each keypoint was matched in @return */
+  const uint16_t *hits;
+  /** The number of frames each keypoint was not matched in @return */
+  const uint16_t *misses;
+  /** The descriptors of the keypoints, one after another @return */
+  const void *descriptors;
+}
+mar_model_cache_entry;
+
+/**
+ * A model cache being written
+ */
+typedef struct
+{
+  /** The file being written @return Do not access directly when using the library */
+  FILE *file;
+  /** The name of the cache @return Do not access directly when using the library */
+  char *file_name;
+  /** The name of the file being written, replacing the cache once it is complete @return Do not access directly when using the library */
+  char *temp_file_name;
+  /** The number of bytes of each keypoint's descriptor @return Read-Only */
+  uint32_t descriptor_size;
+  /** The first error writing the cache @return Read-Only */
+  mar_error_code error;
+}
+mar_model_cache_writer;
+
+/**
+ * A memory mapped model cache being read
+ */
+typedef struct
+{
+  /** The mapped cache file @return Do not access directly when using the library */
+  const uint8_t *data;
+  /** The number of bytes mapped @return Do not access directly when using the library */
+  size_t length;
+  /** The format of the descriptors, one of the keypoint index formats @return Read-Only */
+  uint32_t descriptor_format;
+  /** The number of bytes of each keypoint's descriptor @return Read-Only */
+  uint32_t descriptor_size;
+  /** The offsets of the model records @return Do not access directly when using the library */
+  size_t *models;
+  /** The number of models @return Read-Only */
+  uint32_t num_models;
+}
+mar_model_cache;
+
+/**
+ * Creates a model cache.  The cache is written beside the file and replaces it only once it is written completely, so
+ * a failed write keeps the previous cache.
+ *
+ * @param writer A pointer to a pointer which will be modified to point at the new cache
+ * @param file_name The file to write
+ * @param descriptor_format The format of the descriptors, one of the keypoint index formats
+ * @param descriptor_size The number of bytes of each keypoint's descriptor
+ *
+ * @return MAR_ERROR_NONE on success, an error code on failure
+ */
+mar_error_code mar_model_cache_writer_new(mar_model_cache_writer **writer, const char *file_name, uint32_t descriptor_format,
+    uint32_t descriptor_size);
+
+/**
+ * Finishes writing a model cache and frees it.
+ *
+ * @param writer The cache
+ *
+ * @return MAR_ERROR_NONE on success, MAR_ERROR_WRITING_MODEL_CACHE if any model could not be written, in which case
+ *         the file is left as it was
+ */
+mar_error_code mar_model_cache_writer_free(mar_model_cache_writer *writer);
+
+/**
+ * Writes a model.  The first error is kept, and nothing more is written afterwards.
+ *
+ * @param writer The cache
+ * @param model The description of the model
+ * @param initial_x The X coordinates of the keypoints on the initial surface
+ * @param initial_y The Y coordinates of the keypoints on the initial surface
+ * @param hits The number of frames each keypoint was matched in
+ * @param misses The number of frames each keypoint was not matched in
+ * @param descriptors The descriptors of the keypoints, one after another
+ *
+ * @return MAR_ERROR_NONE on success, MAR_ERROR_WRITING_MODEL_CACHE on failure
+ */
+mar_error_code mar_model_cache_write_model(mar_model_cache_writer *writer, const mar_model_cache_model *model, const float *initial_x,
+    const float *initial_y, const uint16_t *hits, const uint16_t *misses, const void *descriptors);
+
+/**
+ * Maps a model cache and indexes its models.
+ *
+ * @param cache A pointer to a pointer which will be modified to point at the cache
+ * @param file_name The file to read
+ *
+ * @return MAR_ERROR_NONE on success, MAR_ERROR_MODEL_CACHE_NOT_FOUND if the file does not exist, MAR_ERROR_READING_MODEL_CACHE
+ *         if the file is not a model cache, an error code on failure
+ */
+mar_error_code mar_model_cache_open(mar_model_cache **cache, const char *file_name);
+
+/**
+ * Unmaps a model cache and frees it.  Models taken from the cache must not be accessed afterwards.
+ *
+ * @param cache The cache
+ */
+void mar_model_cache_free(mar_model_cache *cache);
+
+/**
+ * Fills an entry with a model of a cache.  The entry points into the mapped cache.
+ *
+ * @param cache The cache
+ * @param index The index of the model
+ * @param entry Will be filled with the model
+ *
+ * @return MAR_ERROR_NONE on success, MAR_ERROR_INVALID_ARGUMENT if the cache has no such model
+ */
+mar_error_code mar_model_cache_get_model(const mar_model_cache *cache, uint32_t index, mar_model_cache_entry *entry);
+
+#endif
@@ -0,0 +1,696 @@
+/**
+ * @file mar_bench.c
+ *
+ * Contains a headless benchmark of the MAR library.  Each stage of the augmentation is timed on its own over
+ * synthetic frames, and the whole augmentation is timed by updating it over a recording of the same frames, at
+ * 320x240, 640x480 and 1280x720.  The latency percentiles and frame rate of every benchmark are reported so
+ * regressions show up before they reach devices.
+ *
+ * Usage: mar_bench [micro|e2e|all] [number of frames]
+ *
+ * @author Greg Eddington
+ */
+
+#include <mar/augment/mar_augment.h>
+#include <mar/camera/mar_camera.h>
+#include <mar/common/mar_error.h>
+#include <mar/common/mar_image.h>
+#include <mar/common/mar_image_pyramid.h>
+#include <mar/vision/mar_affine.h>
+#include <mar/vision/mar_keypoint_index.h>
+#include <mar/vision/mar_mser.h>
+#include <mar/vision/mar_orb.h>
+#include <mar/vision/mar_sift.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+/** The default number of frames each benchmark runs for */
+#define MAR_BENCH_DEFAULT_NUM_FRAMES 120
+/** The number of frames run before timing starts, so caches and buffers are warm */
+#define MAR_BENCH_WARMUP_FRAMES 5
+/** The number of pixels the synthetic scene is larger than a frame on each side, the range of the camera motion */
+#define MAR_BENCH_SCENE_MARGIN 32
+/** The number of matched points of each affine estimation */
+#define MAR_BENCH_AFFINE_POINTS 200
+/** The fraction of matched points of each affine estimation which are outliers */
+#define MAR_BENCH_AFFINE_OUTLIERS 0.3f
+
+/** A frame resolution benchmarked */
+typedef struct
+{
+  /** The frame width */
+  int width;
+  /** The frame height */
+  int height;
+}
+mar_bench_resolution;
+
+/** The resolutions benchmarked */
+static const mar_bench_resolution resolutions[] = { { 320, 240 }, { 640, 480 }, { 1280, 720 } };
+
+/** The latencies of a benchmark */
+typedef struct
+{
+  /** The latency of each run in microseconds */
+  double *samples;
+  /** The number of runs */
+  int num_samples;
+  /** The wall time of every run together in microseconds */
+  double total;
+}
+mar_bench_stats;
+
+/** The number of frames each benchmark runs for */
+static int num_frames = MAR_BENCH_DEFAULT_NUM_FRAMES;
+
+/** The names of the stages timed by the augmentation, indexed by stage */
+static const char *stage_names[MAR_AUGMENT_NUM_STAGES] = { "capture", "convert", "sift", "mser", "containment", "match", "solve", "update" };
+
+/**
+ * Returns the time of a monotonic clock.
+ *
+ * @return The time in microseconds
+ */
+static double now()
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+
+  return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+/**
+ * Returns a pseudo-random number, the same sequence on every run so benchmarks are comparable.
+ *
+ * @param state The state of the generator
+ *
+ * @return A number in [0-1)
+ */
+static float next_random(unsigned int *state)
+{
+  *state = *state * 1103515245u + 12345u;
+
+  return (*state >> 8) / 16777216.0f;
+}
+
+/**
+ * Compares two latencies for sorting.
+ */
+static int compare_samples(const void *a, const void *b)
+{
+  double x = *(const double *)a, y = *(const double *)b;
+
+  return x < y ? -1 : x > y;
+}
+
+/**
+ * Starts collecting the latencies of a benchmark.
+ *
+ * @param stats The latencies
+ * @param capacity The maximum number of runs
+ */
+static void stats_init(mar_bench_stats *stats, int capacity)
+{
+  stats->samples = malloc(capacity * sizeof(double));
+  stats->num_samples = 0;
+  stats->total = 0;
+  if (stats->samples == NULL)
+  {
+    fprintf(stderr, "error: ");
+    mar_print_error(MAR_ERROR_MALLOC);
+    exit(EXIT_FAILURE);
+  }
+}
+
+/**
+ * Adds the latency of a run.
+ *
+ * @param stats The latencies
+ * @param start The time the run started, from now
+ */
+static void stats_add(mar_bench_stats *stats, double start)
+{
+  double latency = now() - start;
+
+  stats->samples[stats->num_samples++] = latency;
+  stats->total += latency;
+}
+
+/**
+ * Returns a percentile of sorted latencies, the nearest run's latency.
+ *
+ * @param stats The sorted latencies
+ * @param percentile The percentile in [0-100]
+ *
+ * @return The latency in microseconds
+ */
+static double stats_percentile(const mar_bench_stats *stats, double percentile)
+{
+  int i = (int)(percentile / 100.0 * (stats->num_samples - 1) + 0.5);
+
+  return stats->samples[i];
+}
+
+/**
+ * Prints the heading of the report.
+ */
+static void print_heading()
+{
+  printf("%-24s %10s %6s %10s %10s %10s %10s %10s %9s\n",
+      "benchmark", "resolution", "runs", "p50 us", "p90 us", "p99 us", "max us", "mean us", "fps");
+}
+
+/**
+ * Prints the latencies of a benchmark and frees them.
+ *
+ * @param name The name of the benchmark
+ * @param resolution The resolution benchmarked, or NULL if the benchmark does not depend on it
+ * @param stats The latencies
+ */
+static void stats_report(const char *name, const mar_bench_resolution *resolution, mar_bench_stats *stats)
+{
+  char size[32] = "-";
+  double mean;
+
+  if (resolution != NULL)
+  {
+    snprintf(size, sizeof(size), "%dx%d", resolution->width, resolution->height);
+  }
+
+  if (stats->num_samples == 0)
+  {
+    printf("%-24s %10s %6d\n", name, size, 0);
+  }
+  else
+  {
+    qsort(stats->samples, stats->num_samples, sizeof(double), compare_samples);
+    mean = stats->total / stats->num_samples;
+    printf("%-24s %10s %6d %10.1f %10.1f %10.1f %10.1f %10.1f %9.1f\n", name, size, stats->num_samples,
+        stats_percentile(stats, 50), stats_percentile(stats, 90), stats_percentile(stats, 99),
+        stats->samples[stats->num_samples - 1], mean, 1e6 / mean);
+  }
+  fflush(stdout);
+
+  free(stats->samples);
+  stats->samples = NULL;
+}
+
+/**
+ * Exits if a benchmarked call failed.
+ *
+ * @param mrv The error returned by the call
+ * @param what What was called
+ */
+static void check(mar_error_code mrv, const char *what)
+{
+  if (mrv != MAR_ERROR_NONE)
+  {
+    fprintf(stderr, "error: %s: ", what);
+    mar_print_error(mrv);
+    exit(EXIT_FAILURE);
+  }
+}
+
+/**
+ * Creates a synthetic grayscale scene of overlapping ellipses of varied intensity over fine noise, so every stage
+ * finds regions and keypoints to work on.  The scene is larger than a frame so frames can be cut from it as the
+ * camera moves.
+ *
+ * @param width The scene width
+ * @param height The scene height
+ *
+ * @return The scene, width * height in size
+ */
+static unsigned char *new_scene(int width, int height)
+{
+  unsigned int state = 1;
+  unsigned char *scene;
+  float cx, cy, rx, ry, dx, dy;
+  int i, x, y, value, num_ellipses = width * height / 4000;
+
+  scene = malloc(width * height);
+  if (scene == NULL)
+  {
+    check(MAR_ERROR_MALLOC, "scene");
+  }
+  for (i = 0; i < width * height; i++)
+  {
+    scene[i] = 96 + (int)(next_random(&state) * 32);
+  }
+
+  for (i = 0; i < num_ellipses; i++)
+  {
+    cx = next_random(&state) * width;
+    cy = next_random(&state) * height;
+    rx = 4 + next_random(&state) * 28;
+    ry = 4 + next_random(&state) * 28;
+    value = (int)(next_random(&state) * 255);
+    for (y = (int)(cy - ry); y <= (int)(cy + ry); y++)
+    {
+      for (x = (int)(cx - rx); x <= (int)(cx + rx); x++)
+      {
+        dx = (x - cx) / rx;
+        dy = (y - cy) / ry;
+        if (x >= 0 && y >= 0 && x < width && y < height && dx * dx + dy * dy <= 1)
+        {
+          scene[y * width + x] = value;
+        }
+      }
+    }
+  }
+
+  return scene;
+}
+
+/**
+ * Cuts a YUYV camera frame from a scene, with the camera moved slowly around the scene from frame to frame.
+ *
+ * @param scene The scene
+ * @param resolution The frame resolution, MAR_BENCH_SCENE_MARGIN smaller than the scene on each side
+ * @param frame The index of the frame
+ * @param yuyv Will be filled with the frame, 2 * width * height in size
+ */
+static void cut_frame(const unsigned char *scene, const mar_bench_resolution *resolution, int frame, unsigned char *yuyv)
+{
+  int x, y, scene_width = resolution->width + 2 * MAR_BENCH_SCENE_MARGIN;
+  int offset_x = MAR_BENCH_SCENE_MARGIN + (frame % 32 < 16 ? frame % 16 : 16 - frame % 16) - 8;
+  int offset_y = MAR_BENCH_SCENE_MARGIN + (frame % 48 < 24 ? frame % 24 : 24 - frame % 24) / 2 - 6;
+  const unsigned char *row;
+
+  for (y = 0; y < resolution->height; y++)
+  {
+    row = scene + (y + offset_y) * scene_width + offset_x;
+    for (x = 0; x < resolution->width; x += 2)
+    {
+      *yuyv++ = row[x];
+      *yuyv++ = 128;
+      *yuyv++ = row[x + 1];
+      *yuyv++ = 128;
+    }
+  }
+}
+
+/**
+ * Creates every frame benchmarked at a resolution.
+ *
+ * @param resolution The frame resolution
+ *
+ * @return The YUYV frames one after another, num_frames frames in size
+ */
+static unsigned char *new_frames(const mar_bench_resolution *resolution)
+{
+  size_t frame_length = (size_t)resolution->width * resolution->height * 2;
+  unsigned char *scene, *frames;
+  int i;
+
+  scene = new_scene(resolution->width + 2 * MAR_BENCH_SCENE_MARGIN, resolution->height + 2 * MAR_BENCH_SCENE_MARGIN);
+  frames = malloc(frame_length * num_frames);
+  if (frames == NULL)
+  {
+    check(MAR_ERROR_MALLOC, "frames");
+  }
+  for (i = 0; i < num_frames; i++)
+  {
+    cut_frame(scene, resolution, i, frames + frame_length * i);
+  }
+  free(scene);
+
+  return frames;
+}
+
+/**
+ * Times each stage of the augmentation on its own at a resolution: filling the camera frame buffers, converting
+ * frames to grayscale, detecting SIFT keypoints and MSER, matching keypoints against a keypoint index, and
+ * detecting and matching FAST and rotated BRIEF keypoints.
+ *
+ * @param resolution The frame resolution
+ */
+static void bench_stages(const mar_bench_resolution *resolution)
+{
+  int i, j, num_pixels = resolution->width * resolution->height, num_keypoints, num_regions, best;
+  size_t frame_length = (size_t)num_pixels * 2;
+  unsigned char *frames, *rgb, *gray;
+  float *grayf, best_difference, second_best_difference;
+  mar_sift_keypoint *keypoints;
+  mar_keypoint_index index;
+  mar_bench_stats stats;
+  mar_sift_ctx sift;
+  mar_orb_ctx orb;
+  mar_image_pyramid pyramid;
+  mar_mser_ctx mser;
+  mar_mser *regions;
+  double start;
+
+  frames = new_frames(resolution);
+  rgb = malloc(num_pixels * 3);
+  gray = malloc(num_pixels);
+  grayf = malloc(num_pixels * sizeof(float));
+  if (rgb == NULL || gray == NULL || grayf == NULL)
+  {
+    check(MAR_ERROR_MALLOC, "frame buffers");
+  }
+
+  // The conversions a camera makes from the frame of its last update when its RGB or float frame buffer is asked for
+  stats_init(&stats, num_frames);
+  for (i = 0; i < num_frames; i++)
+  {
+    start = now();
+    mar_image_yuyv_to_rgb(frames + frame_length * i, rgb, num_pixels);
+    stats_add(&stats, start);
+  }
+  stats_report("yuyv_to_rgb", resolution, &stats);
+
+  stats_init(&stats, num_frames);
+  for (i = 0; i < num_frames; i++)
+  {
+    start = now();
+    mar_image_yuyv_to_grayf(frames + frame_length * i, grayf, num_pixels);
+    stats_add(&stats, start);
+  }
+  stats_report("yuyv_to_grayf", resolution, &stats);
+
+  // The luma extraction of every augmentation frame
+  stats_init(&stats, num_frames);
+  for (i = 0; i < num_frames; i++)
+  {
+    start = now();
+    mar_image_yuyv_to_gray(frames + frame_length * i, gray, num_pixels);
+    stats_add(&stats, start);
+  }
+  stats_report("yuyv_to_gray", resolution, &stats);
+
+  // SIFT keypoints of the whole frame
+  check(mar_sift_ctx_new(&sift, resolution->width, resolution->height, MAR_SIFT_DEFAULT_NUMBER_OF_OCTAVES,
+      MAR_SIFT_DEFAULT_NUMBER_OF_LEVELS, MAR_SIFT_DEFAULT_FIRST_OCTAVE), "mar_sift_ctx_new");
+  stats_init(&stats, num_frames);
+  for (i = 0; i < num_frames; i++)
+  {
+    mar_image_yuyv_to_rgb(frames + frame_length * i, rgb, num_pixels);
+    start = now();
+    check(mar_sift_ctx_get_keypoints(&sift, &keypoints, &num_keypoints, rgb), "mar_sift_ctx_get_keypoints");
+    stats_add(&stats, start);
+  }
+  stats_report("sift_get_keypoints", resolution, &stats);
+
+  // MSER of the whole frame
+  check(mar_mser_ctx_new(&mser, resolution->width, resolution->height), "mar_mser_ctx_new");
+  stats_init(&stats, num_frames);
+  for (i = 0; i < num_frames; i++)
+  {
+    mar_image_yuyv_to_rgb(frames + frame_length * i, rgb, num_pixels);
+    start = now();
+    check(mar_mser_ctx_get_regions(&mser, &regions, &num_regions, rgb), "mar_mser_ctx_get_regions");
+    stats_add(&stats, start);
+  }
+  stats_report("mser_get_regions", resolution, &stats);
+  mar_mser_ctx_free(&mser);
+
+  // Matching every keypoint of a frame against the keypoints of the first frame, as each augmentation's
+  // keypoints are matched, timed for the whole frame
+  mar_image_yuyv_to_rgb(frames, rgb, num_pixels);
+  check(mar_sift_ctx_get_keypoints(&sift, &keypoints, &num_keypoints, rgb), "mar_sift_ctx_get_keypoints");
+  check(mar_keypoint_index_new(&index, num_keypoints > 0 ? num_keypoints : 1, MAR_KEYPOINT_INDEX_DEFAULT_QUANTIZED,
+      MAR_KEYPOINT_INDEX_DEFAULT_NUMBER_OF_TREES, MAR_KEYPOINT_INDEX_DEFAULT_MAX_COMPARISONS), "mar_keypoint_index_new");
+  for (j = 0; j < num_keypoints; j++)
+  {
+    check(mar_keypoint_index_set_keypoint(&index, j, &keypoints[j]), "mar_keypoint_index_set_keypoint");
+  }
+  stats_init(&stats, num_frames);
+  for (i = 1; i <= num_frames; i++)
+  {
+    mar_image_yuyv_to_rgb(frames + frame_length * (i % num_frames), rgb, num_pixels);
+    check(mar_sift_ctx_get_keypoints(&sift, &keypoints, &num_keypoints, rgb), "mar_sift_ctx_get_keypoints");
+    start = now();
+    for (j = 0; j < num_keypoints; j++)
+    {
+      check(mar_keypoint_index_query(&index, &keypoints[j], &best, &best_difference, &second_best_difference),
+          "mar_keypoint_index_query");
+    }
+    stats_add(&stats, start);
+  }
+  stats_report("keypoint_match", resolution, &stats);
+  mar_keypoint_index_free(&index);
+  mar_sift_ctx_free(&sift);
+
+  // FAST and rotated BRIEF keypoints of the whole frame, from the pyramid built for each frame
+  check(mar_image_pyramid_new(&pyramid, resolution->width, resolution->height, MAR_ORB_DEFAULT_NUMBER_OF_LEVELS), "mar_image_pyramid_new");
+  check(mar_orb_ctx_new(&orb, resolution->width, resolution->height, MAR_ORB_DEFAULT_NUMBER_OF_LEVELS, MAR_ORB_DEFAULT_FAST_THRESHOLD,
+      MAR_ORB_DEFAULT_MAX_KEYPOINTS), "mar_orb_ctx_new");
+  stats_init(&stats, num_frames);
+  for (i = 0; i < num_frames; i++)
+  {
+    mar_image_yuyv_to_gray(frames + frame_length * i, gray, num_pixels);
+    start = now();
+    mar_image_pyramid_set_frame(&pyramid, gray, NULL);
+    check(mar_orb_ctx_get_keypoints(&orb, &keypoints, &num_keypoints, &pyramid), "mar_orb_ctx_get_keypoints");
+    stats_add(&stats, start);
+  }
+  stats_report("orb_get_keypoints", resolution, &stats);
+
+  // Matching binary descriptors by Hamming distance the same way
+  mar_image_yuyv_to_gray(frames, gray, num_pixels);
+  mar_image_pyramid_set_frame(&pyramid, gray, NULL);
+  check(mar_orb_ctx_get_keypoints(&orb, &keypoints, &num_keypoints, &pyramid), "mar_orb_ctx_get_keypoints");
+  check(mar_keypoint_index_new(&index, num_keypoints > 0 ? num_keypoints : 1, MAR_KEYPOINT_INDEX_BINARY, 0, 0), "mar_keypoint_index_new");
+  for (j = 0; j < num_keypoints; j++)
+  {
+    check(mar_keypoint_index_set_keypoint(&index, j, &keypoints[j]), "mar_keypoint_index_set_keypoint");
+  }
+  stats_init(&stats, num_frames);
+  for (i = 1; i <= num_frames; i++)
+  {
+    mar_image_yuyv_to_gray(frames + frame_length * (i % num_frames), gray, num_pixels);
+    mar_image_pyramid_set_frame(&pyramid, gray, NULL);
+    check(mar_orb_ctx_get_keypoints(&orb, &keypoints, &num_keypoints, &pyramid), "mar_orb_ctx_get_keypoints");
+    start = now();
+    for (j = 0; j < num_keypoints; j++)
+    {
+      check(mar_keypoint_index_query(&index, &keypoints[j], &best, &best_difference, &second_best_difference),
+          "mar_keypoint_index_query");
+    }
+    stats_add(&stats, start);
+  }
+  stats_report("orb_keypoint_match", resolution, &stats);
+  mar_keypoint_index_free(&index);
+  mar_orb_ctx_free(&orb);
+  mar_image_pyramid_free(&pyramid);
+
+  free(grayf);
+  free(gray);
+  free(rgb);
+  free(frames);
+}
+
+/**
+ * Times the robust estimation of affine transformations from matches with outliers, which does not depend on
+ * the resolution.
+ */
+static void bench_affine()
+{
+  float x[MAR_BENCH_AFFINE_POINTS], y[MAR_BENCH_AFFINE_POINTS], u[MAR_BENCH_AFFINE_POINTS], v[MAR_BENCH_AFFINE_POINTS];
+  unsigned char inliers[MAR_BENCH_AFFINE_POINTS];
+  unsigned int state = 1;
+  mar_affine truth, transform;
+  mar_bench_stats stats;
+  int i, j, num_inliers;
+  double start;
+
+  stats_init(&stats, num_frames);
+  for (i = 0; i < num_frames; i++)
+  {
+    // A small rotation, scale and shift of a surface, as between consecutive frames
+    truth.a = 1 + (next_random(&state) - 0.5f) * 0.1f;
+    truth.b = (next_random(&state) - 0.5f) * 0.1f;
+    truth.c = (next_random(&state) - 0.5f) * 0.1f;
+    truth.d = 1 + (next_random(&state) - 0.5f) * 0.1f;
+    truth.tx = (next_random(&state) - 0.5f) * 20;
+    truth.ty = (next_random(&state) - 0.5f) * 20;
+    for (j = 0; j < MAR_BENCH_AFFINE_POINTS; j++)
+    {
+      x[j] = next_random(&state) * 320;
+      y[j] = next_random(&state) * 240;
+      if (next_random(&state) < MAR_BENCH_AFFINE_OUTLIERS)
+      {
+        u[j] = next_random(&state) * 320;
+        v[j] = next_random(&state) * 240;
+      }
+      else
+      {
+        u[j] = truth.a * x[j] + truth.b * y[j] + truth.tx + (next_random(&state) - 0.5f);
+        v[j] = truth.c * x[j] + truth.d * y[j] + truth.ty + (next_random(&state) - 0.5f);
+      }
+    }
+
+    start = now();
+    mar_affine_estimate(x, y, u, v, MAR_BENCH_AFFINE_POINTS, MAR_AFFINE_DEFAULT_MAX_ITERATIONS,
+        MAR_AFFINE_DEFAULT_INLIER_THRESHOLD, MAR_AFFINE_DEFAULT_CONFIDENCE, NULL, &transform, inliers, &num_inliers);
+    stats_add(&stats, start);
+  }
+  stats_report("affine_estimate", NULL, &stats);
+}
+
+/**
+ * Writes a recording of every frame benchmarked at a resolution, and a configuration replaying it through a
+ * recorded video file camera.
+ *
+ * @param resolution The frame resolution
+ * @param recording Will be filled with the filename of the recording
+ * @param config Will be filled with the filename of the configuration
+ */
+static void write_recording(const mar_bench_resolution *resolution, char *recording, char *config)
+{
+  size_t frame_length = (size_t)resolution->width * resolution->height * 2;
+  unsigned char *frames;
+  FILE *file;
+  int fd;
+
+  frames = new_frames(resolution);
+  strcpy(recording, "/tmp/mar_bench_XXXXXX");
+  fd = mkstemp(recording);
+  file = fd != -1 ? fdopen(fd, "wb") : NULL;
+  if (file == NULL || fwrite(frames, frame_length, num_frames, file) != (size_t)num_frames || fclose(file) != 0)
+  {
+    check(MAR_ERROR_DEVICE_OPEN, recording);
+  }
+  free(frames);
+
+  strcpy(config, "/tmp/mar_bench_XXXXXX");
+  fd = mkstemp(config);
+  file = fd != -1 ? fdopen(fd, "w") : NULL;
+  if (file == NULL)
+  {
+    check(MAR_ERROR_DEVICE_OPEN, config);
+  }
+  fprintf(file, "camera : { camera_type = %d; dev_name = \"%s\"; camera_format = %d; "
+      "camera_width = %d; camera_height = %d; capture_policy = %d; };\n", MAR_CAM_TYPE_FILE, recording,
+      MAR_CAM_FMT_YUYV, resolution->width, resolution->height, MAR_CAM_CAPTURE_SYNCHRONOUS);
+  if (fclose(file) != 0)
+  {
+    check(MAR_ERROR_DEVICE_OPEN, config);
+  }
+}
+
+/**
+ * Times whole augmentation updates over a recording at a resolution, tracking an augmentation created from the
+ * largest MSER of the first frame.
+ *
+ * @param resolution The frame resolution
+ */
+static void bench_updates(const mar_bench_resolution *resolution)
+{
+  char recording[32], config[32];
+  mar_augmentation_id id;
+  mar_augment_ctx *ctx;
+  mar_bench_stats stats;
+  mar_augment_stats stages;
+  mar_mser *regions;
+  mar_error_code mrv;
+  int i, largest, num_regions;
+  double start, wall;
+
+  write_recording(resolution, recording, config);
+  check(mar_augment_ctx_new(&ctx, config), "mar_augment_ctx_new");
+  check(mar_augment_ctx_start_capture(ctx), "mar_augment_ctx_start_capture");
+
+  // Track the largest region of the first frame
+  check(mar_augment_ctx_update(ctx), "mar_augment_ctx_update");
+  check(mar_augment_ctx_view_get_regions(ctx, 0, &regions, &num_regions), "mar_augment_ctx_view_get_regions");
+  for (i = 1, largest = 0; i < num_regions; i++)
+  {
+    if (regions[i].ellipse_a * regions[i].ellipse_b > regions[largest].ellipse_a * regions[largest].ellipse_b)
+    {
+      largest = i;
+    }
+  }
+  if (num_regions > 0 && mar_augment_ctx_view_new_augmentation(ctx, 0, &id, &regions[largest]) == MAR_ERROR_NONE)
+  {
+    mar_augment_ctx_start_augmentation(ctx);
+  }
+
+  // Warm up, then time every update until the recording ends
+  for (i = 1; i < MAR_BENCH_WARMUP_FRAMES && i < num_frames - 1; i++)
+  {
+    check(mar_augment_ctx_update(ctx), "mar_augment_ctx_update");
+  }
+  stats_init(&stats, num_frames);
+  mar_augment_ctx_reset_stats(ctx);
+  wall = now();
+  for (;;)
+  {
+    start = now();
+    mrv = mar_augment_ctx_update(ctx);
+    if (mrv == MAR_ERROR_END_OF_STREAM)
+    {
+      break;
+    }
+    check(mrv, "mar_augment_ctx_update");
+    stats_add(&stats, start);
+  }
+
+  // The frame rate is of the whole loop, counting the time between updates
+  stats.total = now() - wall;
+  stats_report("augment_update", resolution, &stats);
+
+  // Break the updates down by the stages the augmentation timed itself
+  check(mar_augment_ctx_get_stats(ctx, &stages, NULL, 0, NULL), "mar_augment_ctx_get_stats");
+  for (i = 0; i < MAR_AUGMENT_NUM_STAGES; i++)
+  {
+    printf("  %-22s %17lu  p50 %.1f  p95 %.1f  p99 %.1f\n", stage_names[i], stages.stages[i].count, stages.stages[i].p50,
+        stages.stages[i].p95, stages.stages[i].p99);
+  }
+  printf("  %-22s %17u\n", "dropped_frames", stages.dropped_frames);
+
+  mar_augment_ctx_stop_capture(ctx);
+  mar_augment_ctx_free(ctx);
+  unlink(config);
+  unlink(recording);
+}
+
+/**
+ * Runs the benchmarks.
+ *
+ * @param argc The number of arguments
+ * @param argv micro for the stage benchmarks, e2e for the augmentation benchmark or all for both, and the number of frames
+ */
+int main(int argc, char **argv)
+{
+  const char *which = argc > 1 ? argv[1] : "all";
+  char micro, e2e;
+  int i;
+
+  micro = strcmp(which, "micro") == 0 || strcmp(which, "all") == 0;
+  e2e = strcmp(which, "e2e") == 0 || strcmp(which, "all") == 0;
+  if (argc > 2)
+  {
+    num_frames = atoi(argv[2]);
+  }
+  if ((!micro && !e2e) || num_frames < MAR_BENCH_WARMUP_FRAMES + 1)
+  {
+    fprintf(stderr, "usage: %s [micro|e2e|all] [number of frames, at least %d]\n", argv[0], MAR_BENCH_WARMUP_FRAMES + 1);
+    return EXIT_FAILURE;
+  }
+
+  printf("image kernels: %s\n", mar_image_get_kernel_name());
+  print_heading();
+  if (micro)
+  {
+    for (i = 0; i < sizeof(resolutions) / sizeof(resolutions[0]); i++)
+    {
+      bench_stages(&resolutions[i]);
+    }
+    bench_affine();
+  }
+  if (e2e)
+  {
+    for (i = 0; i < sizeof(resolutions) / sizeof(resolutions[0]); i++)
+    {
+      bench_updates(&resolutions[i]);
+    }
+  }
+
+  return EXIT_SUCCESS;
+}
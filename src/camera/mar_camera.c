@@ -9,7 +9,11 @@
 #include "mar_camera.h"
 
 #include "../common/mar_common.h"
+#include "../common/mar_image.h"
 #include "mar_v4l2_mmap_camera.h"
+#include "mar_file_camera.h"
+#include "mar_replay_camera.h"
+#include "mar_capture_ring.h"
 
 /**
  * Contains information for MAR library camera instances.
@@ -20,6 +24,10 @@ typedef struct
   mar_camera_type type;
   /** A pointer to the camera data structure @return Do not access directly when using the library */
   void *camera;
+  /** How frames are captured @return Do not access directly when using the library */
+  mar_camera_capture_policy policy;
+  /** The capture ring while capturing asynchronously, otherwise NULL @return Do not access directly when using the library */
+  mar_capture_ring *ring;
 }
 mar_camera;
 
@@ -55,6 +63,8 @@ mar_error_code mar_camera_new(mar_camera_id *id, mar_camera_type type, char *dev
   }
   *id = i;
   mar_cameras[i].type = type;
+  mar_cameras[i].policy = MAR_CAM_CAPTURE_SYNCHRONOUS;
+  mar_cameras[i].ring = NULL;
 
   // Create the camera
   switch(type)
@@ -66,11 +76,60 @@ mar_error_code mar_camera_new(mar_camera_id *id, mar_camera_type type, char *dev
         mar_cameras[i].camera = 0;
       }
       return retval;
+    case MAR_CAM_TYPE_FILE:
+      retval = mar_file_camera_new((mar_file_camera **)&mar_cameras[i].camera, dev_name, format, width, height);
+      if (retval != MAR_ERROR_NONE)
+      {
+        mar_cameras[i].camera = 0;
+      }
+      return retval;
+    case MAR_CAM_TYPE_REPLAY:
+      retval = mar_replay_camera_new_from_file((mar_replay_camera **)&mar_cameras[i].camera, dev_name, format, width, height);
+      if (retval != MAR_ERROR_NONE)
+      {
+        mar_cameras[i].camera = 0;
+      }
+      return retval;
     default:
       return MAR_ERROR_CAM_TYPE_NOT_SUPPORTED;
   }
 }
 
+/**
+ * Initializes a MAR camera replaying one stream of an open capture log, so several cameras can share a log.
+ * The log must outlive the camera.
+ *
+ * @param id A pointer to an int which will be filled with the ID of the newly created camera
+ * @param log The capture log
+ * @param stream The stream of the log to replay
+ *
+ * @return MAR_ERROR_NONE on success, an error code on failure
+ */
+mar_error_code mar_camera_new_replay(mar_camera_id *id, struct mar_capture_log *log, int stream)
+{
+  int i;
+  mar_error_code retval;
+
+  // Check for an empty camera
+  for (i = 0 ; i < MAR_CAM_MAX_NUM_CAMERAS && mar_cameras[i].camera != 0; i++);
+  if (i == MAR_CAM_MAX_NUM_CAMERAS)
+  {
+    // No camera spots available
+    return MAR_ERROR_NO_CAMERAS_AVAILABLE;
+  }
+  *id = i;
+  mar_cameras[i].type = MAR_CAM_TYPE_REPLAY;
+  mar_cameras[i].policy = MAR_CAM_CAPTURE_SYNCHRONOUS;
+  mar_cameras[i].ring = NULL;
+
+  retval = mar_replay_camera_new((mar_replay_camera **)&mar_cameras[i].camera, log, stream);
+  if (retval != MAR_ERROR_NONE)
+  {
+    mar_cameras[i].camera = 0;
+  }
+  return retval;
+}
+
 /**
  * Frees a camera created by the MAR library.
  *
@@ -82,18 +141,107 @@ mar_error_code mar_camera_free(mar_camera_id id)
 {
   mar_error_code retval;
 
+  // Stop the capture thread before the camera goes away
+  if (mar_cameras[id].ring != NULL)
+  {
+    mar_capture_ring_free(mar_cameras[id].ring);
+    mar_cameras[id].ring = NULL;
+  }
+
   switch(mar_cameras[id].type)
   {
     case MAR_CAM_TYPE_V4L2_MMAP:
       retval = mar_v4l2_mmap_camera_free((mar_v4l2_mmap_camera *)mar_cameras[id].camera);
       mar_cameras[id].camera = 0;
       return retval;
+    case MAR_CAM_TYPE_FILE:
+      retval = mar_file_camera_free((mar_file_camera *)mar_cameras[id].camera);
+      mar_cameras[id].camera = 0;
+      return retval;
+    case MAR_CAM_TYPE_REPLAY:
+      retval = mar_replay_camera_free((mar_replay_camera *)mar_cameras[id].camera);
+      mar_cameras[id].camera = 0;
+      return retval;
     default:
       mar_cameras[id].camera = 0;
       return MAR_ERROR_CAM_TYPE_NOT_SUPPORTED;
   }
 }
 
+/**
+ * Captures a new frame from the camera's own buffers, bypassing any capture ring.
+ * 
+ * @param id The ID of the camera to capture from
+ * @param frame Will be filled with the leased frame
+ *
+ * @return MAR_ERROR_NONE on success, an error code on failure
+ */
+MAR_PRIVATE
+mar_error_code mar_camera_acquire_device_frame(mar_camera_id id, mar_camera_frame *frame)
+{
+  frame->camera_id = id;
+
+  switch(mar_cameras[id].type)
+  {
+    case MAR_CAM_TYPE_V4L2_MMAP:
+      return mar_v4l2_mmap_camera_acquire_frame((mar_v4l2_mmap_camera *)mar_cameras[id].camera, frame);
+    case MAR_CAM_TYPE_FILE:
+      return mar_file_camera_acquire_frame((mar_file_camera *)mar_cameras[id].camera, frame);
+    case MAR_CAM_TYPE_REPLAY:
+      return mar_replay_camera_acquire_frame((mar_replay_camera *)mar_cameras[id].camera, frame);
+    default:
+      return MAR_ERROR_CAM_TYPE_NOT_SUPPORTED;
+  }
+}
+
+/**
+ * Returns a frame captured with mar_camera_acquire_device_frame to the camera's own buffers.
+ * 
+ * @param id The ID of the camera the frame was captured from
+ * @param frame The frame to release
+ *
+ * @return MAR_ERROR_NONE on success, an error code on failure
+ */
+MAR_PRIVATE
+mar_error_code mar_camera_release_device_frame(mar_camera_id id, mar_camera_frame *frame)
+{
+  switch(mar_cameras[id].type)
+  {
+    case MAR_CAM_TYPE_V4L2_MMAP:
+      return mar_v4l2_mmap_camera_release_frame((mar_v4l2_mmap_camera *)mar_cameras[id].camera, frame);
+    case MAR_CAM_TYPE_FILE:
+      return mar_file_camera_release_frame((mar_file_camera *)mar_cameras[id].camera, frame);
+    case MAR_CAM_TYPE_REPLAY:
+      return mar_replay_camera_release_frame((mar_replay_camera *)mar_cameras[id].camera, frame);
+    default:
+      return MAR_ERROR_CAM_TYPE_NOT_SUPPORTED;
+  }
+}
+
+/**
+ * Sets how the camera captures frames, which takes effect the next time capturing is started.
+ * With an asynchronous policy a dedicated thread captures frames into a ring while the camera is started,
+ * and frames must be taken with mar_camera_acquire_frame instead of mar_camera_update.
+ *
+ * @param id The ID of the camera
+ * @param policy The \ref camera_capture_policies "capture policy"
+ *
+ * @return MAR_ERROR_NONE on success, an error code on failure
+ */
+mar_error_code mar_camera_set_capture_policy(mar_camera_id id, mar_camera_capture_policy policy)
+{
+  switch (policy)
+  {
+    case MAR_CAM_CAPTURE_SYNCHRONOUS:
+    case MAR_CAM_CAPTURE_DROP_OLDEST:
+    case MAR_CAM_CAPTURE_BLOCK:
+      mar_cameras[id].policy = policy;
+      return MAR_ERROR_NONE;
+    default:
+      return MAR_ERROR_INVALID_ARGUMENT;
+  }
+}
+
 /**
  * Starts camera capturing
  *
@@ -103,17 +251,40 @@ mar_error_code mar_camera_free(mar_camera_id id)
  */
 mar_error_code mar_camera_start(mar_camera_id id)
 {
+  mar_error_code retval;
+
   switch(mar_cameras[id].type)
   {
     case MAR_CAM_TYPE_V4L2_MMAP:
-      return mar_v4l2_mmap_camera_start((mar_v4l2_mmap_camera *)mar_cameras[id].camera);
+      retval = mar_v4l2_mmap_camera_start((mar_v4l2_mmap_camera *)mar_cameras[id].camera);
+      break;
+    case MAR_CAM_TYPE_FILE:
+      retval = mar_file_camera_start((mar_file_camera *)mar_cameras[id].camera);
+      break;
+    case MAR_CAM_TYPE_REPLAY:
+      retval = mar_replay_camera_start((mar_replay_camera *)mar_cameras[id].camera);
+      break;
     default:
       return MAR_ERROR_CAM_TYPE_NOT_SUPPORTED;
   }
+
+  // Start the capture thread
+  if (retval == MAR_ERROR_NONE && mar_cameras[id].policy != MAR_CAM_CAPTURE_SYNCHRONOUS && mar_cameras[id].ring == NULL)
+  {
+    retval = mar_capture_ring_new(&mar_cameras[id].ring, id, mar_cameras[id].policy, 
+        mar_camera_acquire_device_frame, mar_camera_release_device_frame);
+    if (retval != MAR_ERROR_NONE)
+    {
+      mar_cameras[id].ring = NULL;
+      mar_camera_stop(id);
+    }
+  }
+
+  return retval;
 }
 
 /**
- * Updates the camera and captuers a new frame.
+ * Updates the camera and captuers a new frame.  Not available while capturing asynchronously.
  * 
  * @param id The ID of the camera it update
  *
@@ -121,15 +292,145 @@ mar_error_code mar_camera_start(mar_camera_id id)
  */
 mar_error_code mar_camera_update(mar_camera_id id)
 {
+  if (mar_cameras[id].ring != NULL)
+  {
+    return MAR_ERROR_CAMERA_CAPTURING_ASYNCHRONOUSLY;
+  }
+
   switch(mar_cameras[id].type)
   {
     case MAR_CAM_TYPE_V4L2_MMAP:
       return mar_v4l2_mmap_camera_update((mar_v4l2_mmap_camera *)mar_cameras[id].camera);
+    case MAR_CAM_TYPE_FILE:
+      return mar_file_camera_update((mar_file_camera *)mar_cameras[id].camera);
+    case MAR_CAM_TYPE_REPLAY:
+      return mar_replay_camera_update((mar_replay_camera *)mar_cameras[id].camera);
     default:
       return MAR_ERROR_CAM_TYPE_NOT_SUPPORTED;
   }
 }
 
+/**
+ * Captures a new frame and leases the camera's capture buffer to the caller without copying or converting it.
+ * The buffer is not refilled by the camera until it is returned with mar_camera_release_frame, so every acquired
+ * frame must be released.  At least one buffer always stays with the camera, so acquiring fails with
+ * MAR_ERROR_CAMERA_FRAMES_EXHAUSTED if too many frames are held at once.  Stopping the camera ends every lease.
+ * 
+ * @param id The ID of the camera to capture from
+ * @param frame Will be filled with the leased frame
+ *
+ * @return MAR_ERROR_NONE on success, an error code on failure
+ */
+mar_error_code mar_camera_acquire_frame(mar_camera_id id, mar_camera_frame *frame)
+{
+  if (mar_cameras[id].ring != NULL)
+  {
+    frame->camera_id = id;
+    return mar_capture_ring_acquire_frame(mar_cameras[id].ring, frame);
+  }
+
+  return mar_camera_acquire_device_frame(id, frame);
+}
+
+/**
+ * Returns a frame leased with mar_camera_acquire_frame to its camera.  The frame's image data must not be
+ * accessed afterwards.
+ * 
+ * @param frame The frame to release
+ *
+ * @return MAR_ERROR_NONE on success, an error code on failure
+ */
+mar_error_code mar_camera_release_frame(mar_camera_frame *frame)
+{
+  if (mar_cameras[frame->camera_id].ring != NULL)
+  {
+    return mar_capture_ring_release_frame(mar_cameras[frame->camera_id].ring, frame);
+  }
+
+  return mar_camera_release_device_frame(frame->camera_id, frame);
+}
+
+/**
+ * Converts a leased frame to an RGB24 image.
+ * 
+ * @param frame The frame to convert
+ * @param rgb The destination image, 3 * width * height in size
+ *
+ * @return MAR_ERROR_NONE on success, an error code on failure
+ */
+mar_error_code mar_camera_frame_to_rgb(const mar_camera_frame *frame, unsigned char *rgb)
+{
+  int num_pixels = frame->width * frame->height;
+
+  switch(frame->format)
+  {
+    case MAR_CAM_FMT_YUYV:
+      // Never read past the end of the frame
+      if (num_pixels > frame->length / 2)
+      {
+        num_pixels = frame->length / 2;
+      }
+      mar_image_yuyv_to_rgb(frame->data, rgb, num_pixels);
+      return MAR_ERROR_NONE;
+    default:
+      return MAR_ERROR_PIXEL_FORMAT_NOT_SUPPORTED;
+  }
+}
+
+/**
+ * Extracts the luma of a leased frame as an 8-bit grayscale image.
+ * 
+ * @param frame The frame to convert
+ * @param gray The destination image, width * height in size
+ *
+ * @return MAR_ERROR_NONE on success, an error code on failure
+ */
+mar_error_code mar_camera_frame_to_grayscale(const mar_camera_frame *frame, unsigned char *gray)
+{
+  int num_pixels = frame->width * frame->height;
+
+  switch(frame->format)
+  {
+    case MAR_CAM_FMT_YUYV:
+      // Never read past the end of the frame
+      if (num_pixels > frame->length / 2)
+      {
+        num_pixels = frame->length / 2;
+      }
+      mar_image_yuyv_to_gray(frame->data, gray, num_pixels);
+      return MAR_ERROR_NONE;
+    default:
+      return MAR_ERROR_PIXEL_FORMAT_NOT_SUPPORTED;
+  }
+}
+
+/**
+ * Extracts the luma of a leased frame as a floating point grayscale image normalized to [0-1].
+ * 
+ * @param frame The frame to convert
+ * @param gray The destination image, width * height floats in size
+ *
+ * @return MAR_ERROR_NONE on success, an error code on failure
+ */
+mar_error_code mar_camera_frame_to_float_grayscale(const mar_camera_frame *frame, float *gray)
+{
+  int num_pixels = frame->width * frame->height;
+
+  switch(frame->format)
+  {
+    case MAR_CAM_FMT_YUYV:
+      // Never read past the end of the frame
+      if (num_pixels > frame->length / 2)
+      {
+        num_pixels = frame->length / 2;
+      }
+      mar_image_yuyv_to_grayf(frame->data, gray, num_pixels);
+      return MAR_ERROR_NONE;
+    default:
+      return MAR_ERROR_PIXEL_FORMAT_NOT_SUPPORTED;
+  }
+}
+
 /**
  * Stops camera capturing
  *
@@ -139,15 +440,44 @@ mar_error_code mar_camera_update(mar_camera_id id)
  */
 mar_error_code mar_camera_stop(mar_camera_id id)
 {
+  // Stop the capture thread before the camera stops streaming
+  if (mar_cameras[id].ring != NULL)
+  {
+    mar_capture_ring_free(mar_cameras[id].ring);
+    mar_cameras[id].ring = NULL;
+  }
+
   switch(mar_cameras[id].type)
   {
     case MAR_CAM_TYPE_V4L2_MMAP:
       return mar_v4l2_mmap_camera_stop((mar_v4l2_mmap_camera *)mar_cameras[id].camera);
+    case MAR_CAM_TYPE_FILE:
+      return mar_file_camera_stop((mar_file_camera *)mar_cameras[id].camera);
+    case MAR_CAM_TYPE_REPLAY:
+      return mar_replay_camera_stop((mar_replay_camera *)mar_cameras[id].camera);
     default:
       return MAR_ERROR_CAM_TYPE_NOT_SUPPORTED;
   }
 }
 
+/**
+ * Returns the number of frames the capture thread has overwritten before they were acquired since capturing
+ * was last started.
+ *
+ * @param id The ID of the camera
+ *
+ * @return The number of dropped frames, 0 when capturing synchronously
+ */
+unsigned int mar_camera_get_num_dropped_frames(mar_camera_id id)
+{
+  if (mar_cameras[id].ring == NULL)
+  {
+    return 0;
+  }
+
+  return mar_capture_ring_get_num_dropped(mar_cameras[id].ring);
+}
+
 /**
  * Returns the currently set camera pixel format.
  *
@@ -161,6 +491,10 @@ mar_camera_format mar_camera_get_pixel_format(mar_camera_id id)
   {
     case MAR_CAM_TYPE_V4L2_MMAP:
       return mar_v4l2_mmap_camera_get_pixel_format((mar_v4l2_mmap_camera *)mar_cameras[id].camera);
+    case MAR_CAM_TYPE_FILE:
+      return mar_file_camera_get_pixel_format((mar_file_camera *)mar_cameras[id].camera);
+    case MAR_CAM_TYPE_REPLAY:
+      return mar_replay_camera_get_pixel_format((mar_replay_camera *)mar_cameras[id].camera);
     default:
       return MAR_ERROR_CAM_TYPE_NOT_SUPPORTED;
   }
@@ -180,6 +514,12 @@ void mar_camera_get_resolution(mar_camera_id id, int *width, int *height)
     case MAR_CAM_TYPE_V4L2_MMAP:
       mar_v4l2_mmap_camera_get_resolution((mar_v4l2_mmap_camera *)mar_cameras[id].camera, width, height);
       break;
+    case MAR_CAM_TYPE_FILE:
+      mar_file_camera_get_resolution((mar_file_camera *)mar_cameras[id].camera, width, height);
+      break;
+    case MAR_CAM_TYPE_REPLAY:
+      mar_replay_camera_get_resolution((mar_replay_camera *)mar_cameras[id].camera, width, height);
+      break;
     default:
       *width = 0;
       *height = 0;
@@ -200,6 +540,56 @@ unsigned char *mar_camera_get_frame_buffer(mar_camera_id id)
   {
     case MAR_CAM_TYPE_V4L2_MMAP:
       return mar_v4l2_mmap_camera_get_frame_buffer((mar_v4l2_mmap_camera *)mar_cameras[id].camera);
+    case MAR_CAM_TYPE_FILE:
+      return mar_file_camera_get_frame_buffer((mar_file_camera *)mar_cameras[id].camera);
+    case MAR_CAM_TYPE_REPLAY:
+      return mar_replay_camera_get_frame_buffer((mar_replay_camera *)mar_cameras[id].camera);
+    default:
+      return NULL;
+  }
+}
+
+/**
+ * Returns the camera's frame buffer as an 8-bit grayscale image taken directly from the luma channel.
+ * The frame buffer is width * height in size.
+ *
+ * @param id The ID of the camera to get the frame buffer of.
+ * 
+ * @return The camera grayscale frame buffer.
+ */
+unsigned char *mar_camera_get_grayscale_frame_buffer(mar_camera_id id)
+{
+  switch(mar_cameras[id].type)
+  {
+    case MAR_CAM_TYPE_V4L2_MMAP:
+      return mar_v4l2_mmap_camera_get_grayscale_frame_buffer((mar_v4l2_mmap_camera *)mar_cameras[id].camera);
+    case MAR_CAM_TYPE_FILE:
+      return mar_file_camera_get_grayscale_frame_buffer((mar_file_camera *)mar_cameras[id].camera);
+    case MAR_CAM_TYPE_REPLAY:
+      return mar_replay_camera_get_grayscale_frame_buffer((mar_replay_camera *)mar_cameras[id].camera);
+    default:
+      return NULL;
+  }
+}
+
+/**
+ * Returns the camera's frame buffer as a floating point grayscale image normalized to [0-1] taken directly
+ * from the luma channel.  The frame buffer is width * height floats in size.
+ *
+ * @param id The ID of the camera to get the frame buffer of.
+ * 
+ * @return The camera floating point grayscale frame buffer.
+ */
+float *mar_camera_get_float_grayscale_frame_buffer(mar_camera_id id)
+{
+  switch(mar_cameras[id].type)
+  {
+    case MAR_CAM_TYPE_V4L2_MMAP:
+      return mar_v4l2_mmap_camera_get_float_grayscale_frame_buffer((mar_v4l2_mmap_camera *)mar_cameras[id].camera);
+    case MAR_CAM_TYPE_FILE:
+      return mar_file_camera_get_float_grayscale_frame_buffer((mar_file_camera *)mar_cameras[id].camera);
+    case MAR_CAM_TYPE_REPLAY:
+      return mar_replay_camera_get_float_grayscale_frame_buffer((mar_replay_camera *)mar_cameras[id].camera);
     default:
       return NULL;
   }
@@ -10,6 +10,8 @@
 #define MAR_CAMERA_H
 
 #include "../common/mar_error.h"
+#include <stddef.h>
+#include <stdint.h>
 
 /** The default camera type */
 #define MAR_CAM_DEFAULT_TYPE MAR_CAM_TYPE_V4L2_MMAP
@@ -21,6 +23,8 @@
 #define MAR_CAM_DEFAULT_HEIGHT 240
 /** The default camera device name */
 #define MAR_CAM_DEFAULT_DEV_NAME "/dev/video0"
+/** The default camera capture policy */
+#define MAR_CAM_DEFAULT_CAPTURE_POLICY MAR_CAM_CAPTURE_SYNCHRONOUS
 
 /** The maximum number of cameras */
 #define MAR_CAM_MAX_NUM_CAMERAS 2
@@ -33,9 +37,24 @@
  */
 /** V4L2 Memory Mapped Devices **/
 #define MAR_CAM_TYPE_V4L2_MMAP 1
+/** Recorded Video Files of Raw Frames, Delivered Without Pacing **/
+#define MAR_CAM_TYPE_FILE 2
+/** The First Stream of a Capture Log, Replayed Bit-Exactly Without Pacing **/
+#define MAR_CAM_TYPE_REPLAY 3
 /** @} */
 
 
+/** \defgroup camera_capture_policies Camera Capture Policies
+ *  @{
+ */
+/** Frames are captured by the thread which updates the camera or acquires a frame **/
+#define MAR_CAM_CAPTURE_SYNCHRONOUS 0
+/** Frames are captured by a dedicated thread, and acquiring takes the newest frame, dropping older ones **/
+#define MAR_CAM_CAPTURE_DROP_OLDEST 1
+/** Frames are captured by a dedicated thread, which waits when the consumer falls behind so every frame is acquired in order **/
+#define MAR_CAM_CAPTURE_BLOCK 2
+/** @} */
+
 /** \defgroup camera_pixel_formats Camera Pixel Formats
  *  @{
  */
@@ -43,6 +62,17 @@
 #define MAR_CAM_FMT_YUYV 0x01
 /** @} */
 
+/** \defgroup camera_converted_buffers Camera Frame Buffers Converted From The Last Update
+ *  @{
+ */
+/** The RGB24 frame buffer **/
+#define MAR_CAM_CONVERTED_RGB 0x01
+/** The 8-bit grayscale frame buffer **/
+#define MAR_CAM_CONVERTED_GRAYSCALE 0x02
+/** The floating point grayscale frame buffer **/
+#define MAR_CAM_CONVERTED_FLOAT_GRAYSCALE 0x04
+/** @} */
+
 /**
  * The camera pixel format @return
  */
@@ -53,11 +83,45 @@ typedef unsigned char mar_camera_format;
  */
 typedef unsigned char mar_camera_type;
 
+/**
+ * The camera capture policy @return
+ */
+typedef unsigned char mar_camera_capture_policy;
+
 /**
  * A camera identifier @return
  */
 typedef unsigned char mar_camera_id;
 
+/**
+ * A camera frame leased with mar_camera_acquire_frame.  The image data is the camera's own capture buffer,
+ * which is not reused by the camera until the frame is returned with mar_camera_release_frame.
+ */
+typedef struct
+{
+  /** The ID of the camera which captured the frame @return Read-Only */
+  mar_camera_id camera_id;
+  /** The raw image in the camera pixel format @return Read-Only */
+  const unsigned char *data;
+  /** The number of bytes of image data @return Read-Only */
+  size_t length;
+  /** The camera pixel format of the image data @return Read-Only */
+  mar_camera_format format;
+  /** The frame width @return Read-Only */
+  int width;
+  /** The frame height @return Read-Only */
+  int height;
+  /** The time the frame was captured in microseconds @return Read-Only */
+  uint64_t timestamp;
+  /** The frame sequence number assigned by the camera @return Read-Only */
+  uint32_t sequence;
+  /** The camera's index for the capture buffer @return Do not access directly when using the library */
+  int buffer_index;
+}
+mar_camera_frame;
+
+struct mar_capture_log;
+
 /**
  * Initializes a MAR camera.
  *
@@ -72,6 +136,18 @@ typedef unsigned char mar_camera_id;
  */
 mar_error_code mar_camera_new(mar_camera_id *id, mar_camera_type type, char *dev_name, mar_camera_format format, int width, int height);
 
+/**
+ * Initializes a MAR camera replaying one stream of an open capture log, so several cameras can share a log.
+ * The log must outlive the camera.
+ *
+ * @param id A pointer to an int which will be filled with the ID of the newly created camera
+ * @param log The capture log
+ * @param stream The stream of the log to replay
+ *
+ * @return MAR_ERROR_NONE on success, an error code on failure
+ */
+mar_error_code mar_camera_new_replay(mar_camera_id *id, struct mar_capture_log *log, int stream);
+
 /**
  * Frees a camera created by the MAR library.
  *
@@ -81,6 +157,18 @@ mar_error_code mar_camera_new(mar_camera_id *id, mar_camera_type type, char *dev
  */
 mar_error_code mar_camera_free(mar_camera_id id);
 
+/**
+ * Sets how the camera captures frames, which takes effect the next time capturing is started.
+ * With an asynchronous policy a dedicated thread captures frames into a ring while the camera is started,
+ * and frames must be taken with mar_camera_acquire_frame instead of mar_camera_update.
+ *
+ * @param id The ID of the camera
+ * @param policy The \ref camera_capture_policies "capture policy"
+ *
+ * @return MAR_ERROR_NONE on success, an error code on failure
+ */
+mar_error_code mar_camera_set_capture_policy(mar_camera_id id, mar_camera_capture_policy policy);
+
 /**
  * Starts camera capturing
  *
@@ -91,7 +179,8 @@ mar_error_code mar_camera_free(mar_camera_id id);
 mar_error_code mar_camera_start(mar_camera_id id);
 
 /**
- * Updates the camera and captuers a new frame.
+ * Updates the camera and captuers a new frame.  Not available while capturing asynchronously.  Each frame buffer
+ * is only converted from the new frame when it is first asked for.
  * 
  * @param id The ID of the camera it update
  *
@@ -99,6 +188,59 @@ mar_error_code mar_camera_start(mar_camera_id id);
  */
 mar_error_code mar_camera_update(mar_camera_id id);
 
+/**
+ * Captures a new frame and leases the camera's capture buffer to the caller without copying or converting it.
+ * The buffer is not refilled by the camera until it is returned with mar_camera_release_frame, so every acquired
+ * frame must be released.  At least one buffer always stays with the camera, so acquiring fails with
+ * MAR_ERROR_CAMERA_FRAMES_EXHAUSTED if too many frames are held at once.  Stopping the camera ends every lease.
+ * 
+ * @param id The ID of the camera to capture from
+ * @param frame Will be filled with the leased frame
+ *
+ * @return MAR_ERROR_NONE on success, an error code on failure
+ */
+mar_error_code mar_camera_acquire_frame(mar_camera_id id, mar_camera_frame *frame);
+
+/**
+ * Returns a frame leased with mar_camera_acquire_frame to its camera.  The frame's image data must not be
+ * accessed afterwards.
+ * 
+ * @param frame The frame to release
+ *
+ * @return MAR_ERROR_NONE on success, an error code on failure
+ */
+mar_error_code mar_camera_release_frame(mar_camera_frame *frame);
+
+/**
+ * Converts a leased frame to an RGB24 image.
+ * 
+ * @param frame The frame to convert
+ * @param rgb The destination image, 3 * width * height in size
+ *
+ * @return MAR_ERROR_NONE on success, an error code on failure
+ */
+mar_error_code mar_camera_frame_to_rgb(const mar_camera_frame *frame, unsigned char *rgb);
+
+/**
+ * Extracts the luma of a leased frame as an 8-bit grayscale image.
+ * 
+ * @param frame The frame to convert
+ * @param gray The destination image, width * height in size
+ *
+ * @return MAR_ERROR_NONE on success, an error code on failure
+ */
+mar_error_code mar_camera_frame_to_grayscale(const mar_camera_frame *frame, unsigned char *gray);
+
+/**
+ * Extracts the luma of a leased frame as a floating point grayscale image normalized to [0-1].
+ * 
+ * @param frame The frame to convert
+ * @param gray The destination image, width * height floats in size
+ *
+ * @return MAR_ERROR_NONE on success, an error code on failure
+ */
+mar_error_code mar_camera_frame_to_float_grayscale(const mar_camera_frame *frame, float *gray);
+
 /**
  * Stops camera capturing
  *
@@ -108,6 +250,16 @@ mar_error_code mar_camera_update(mar_camera_id id);
  */
 mar_error_code mar_camera_stop(mar_camera_id id);
 
+/**
+ * Returns the number of frames the capture thread has overwritten before they were acquired since capturing
+ * was last started.
+ *
+ * @param id The ID of the camera
+ *
+ * @return The number of dropped frames, 0 when capturing synchronously
+ */
+unsigned int mar_camera_get_num_dropped_frames(mar_camera_id id);
+
 /**
  * Returns the currently set camera pixel format.
  *
@@ -136,4 +288,24 @@ void mar_camera_get_resolution(mar_camera_id id, int *width, int *height);
  */
 unsigned char *mar_camera_get_frame_buffer(mar_camera_id id);
 
+/**
+ * Returns the camera's frame buffer as an 8-bit grayscale image taken directly from the luma channel.
+ * The frame buffer is width * height in size.
+ *
+ * @param id The ID of the camera to get the frame buffer of.
+ * 
+ * @return The camera grayscale frame buffer.
+ */
+unsigned char *mar_camera_get_grayscale_frame_buffer(mar_camera_id id);
+
+/**
+ * Returns the camera's frame buffer as a floating point grayscale image normalized to [0-1] taken directly
+ * from the luma channel.  The frame buffer is width * height floats in size.
+ *
+ * @param id The ID of the camera to get the frame buffer of.
+ * 
+ * @return The camera floating point grayscale frame buffer.
+ */
+float *mar_camera_get_float_grayscale_frame_buffer(mar_camera_id id);
+
 #endif
@@ -0,0 +1,403 @@
+/**
+ * @file mar_capture_log.c
+ *
+ * Contains a log of the camera frames, configuration and augmentation calls of an augmentation session, which
+ * can be replayed bit-exactly.  The log is a header followed by records, each a fixed size record header and a
+ * payload padded to 8 bytes, so a log is read in place by memory mapping it and indexing its records once.
+ * Frames are stored raw in the camera pixel format.  Logs are only meant to be replayed by the build which
+ * recorded them.
+ *
+ * @author Greg Eddington
+ */
+
+#include "mar_capture_log.h"
+#include "../common/mar_common.h"
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/** The alignment of every record */
+#define MAR_CAPTURE_LOG_ALIGNMENT 8
+
+/**
+ * The header at the start of every capture log
+ */
+typedef struct
+{
+  /** MAR_CAPTURE_LOG_MAGIC */
+  char magic[8];
+  /** MAR_CAPTURE_LOG_VERSION */
+  uint32_t version;
+  /** Zero */
+  uint32_t reserved;
+}
+mar_capture_log_header;
+
+/**
+ * Returns the number of bytes a payload takes with its padding.
+ *
+ * @param length The number of bytes of the payload
+ *
+ * @return The padded length
+ */
+MAR_PRIVATE
+uint64_t mar_capture_log_padded(uint64_t length)
+{
+  return (length + MAR_CAPTURE_LOG_ALIGNMENT - 1) & ~(uint64_t)(MAR_CAPTURE_LOG_ALIGNMENT - 1);
+}
+
+/**
+ * Writes a record whose payload is made of two parts.  The first error is kept, and nothing more is written afterwards.
+ *
+ * @param writer The log
+ * @param type The \ref capture_log_records "record type"
+ * @param stream The stream of a frame record, 0 otherwise
+ * @param first The first part of the payload
+ * @param first_length The number of bytes of the first part
+ * @param second The second part of the payload, may be NULL
+ * @param second_length The number of bytes of the second part
+ *
+ * @return MAR_ERROR_NONE on success, MAR_ERROR_WRITING_CAPTURE_LOG on failure
+ */
+MAR_PRIVATE
+mar_error_code mar_capture_log_write_record(mar_capture_log_writer *writer, uint32_t type, uint32_t stream,
+    const void *first, size_t first_length, const void *second, size_t second_length)
+{
+  static const uint8_t padding[MAR_CAPTURE_LOG_ALIGNMENT] = { 0 };
+  mar_capture_log_record record;
+  mar_error_code mrv;
+
+  MAR_CLEAR(record);
+  record.type = type;
+  record.stream = stream;
+  record.length = first_length + second_length;
+
+  pthread_mutex_lock(&writer->mutex);
+  if (writer->error == MAR_ERROR_NONE &&
+      (fwrite(&record, sizeof(record), 1, writer->file) != 1 ||
+       fwrite(first, 1, first_length, writer->file) != first_length ||
+       (second_length > 0 && fwrite(second, 1, second_length, writer->file) != second_length) ||
+       fwrite(padding, 1, mar_capture_log_padded(record.length) - record.length, writer->file) !=
+         mar_capture_log_padded(record.length) - record.length))
+  {
+    writer->error = MAR_ERROR_WRITING_CAPTURE_LOG;
+  }
+  mrv = writer->error;
+  pthread_mutex_unlock(&writer->mutex);
+
+  return mrv;
+}
+
+/**
+ * Creates a capture log, replacing any file of the same name.
+ *
+ * @param writer A pointer to a pointer which will be modified to point at the new log
+ * @param file_name The file to write
+ *
+ * @return MAR_ERROR_NONE on success, an error code on failure
+ */
+MAR_PUBLIC
+mar_error_code mar_capture_log_writer_new(mar_capture_log_writer **writer, const char *file_name)
+{
+  mar_capture_log_header header;
+  mar_capture_log_writer *w;
+
+  *writer = w = mar_malloc(sizeof(mar_capture_log_writer));
+  if (w == NULL)
+  {
+    return MAR_ERROR_MALLOC;
+  }
+
+  w->file = fopen(file_name, "wb");
+  if (w->file == NULL)
+  {
+    mar_free(w);
+    return MAR_ERROR_DEVICE_OPEN;
+  }
+  w->error = MAR_ERROR_NONE;
+  pthread_mutex_init(&w->mutex, NULL);
+
+  MAR_CLEAR(header);
+  memcpy(header.magic, MAR_CAPTURE_LOG_MAGIC, sizeof(header.magic));
+  header.version = MAR_CAPTURE_LOG_VERSION;
+  if (fwrite(&header, sizeof(header), 1, w->file) != 1)
+  {
+    fclose(w->file);
+    pthread_mutex_destroy(&w->mutex);
+    mar_free(w);
+    return MAR_ERROR_WRITING_CAPTURE_LOG;
+  }
+
+  return MAR_ERROR_NONE;
+}
+
+/**
+ * Finishes writing a capture log and frees it.
+ *
+ * @param writer The log
+ *
+ * @return MAR_ERROR_NONE on success, MAR_ERROR_WRITING_CAPTURE_LOG if any record could not be written
+ */
+MAR_PUBLIC
+mar_error_code mar_capture_log_writer_free(mar_capture_log_writer *writer)
+{
+  mar_error_code mrv = writer->error;
+
+  if (fclose(writer->file) != 0)
+  {
+    mrv = MAR_ERROR_WRITING_CAPTURE_LOG;
+  }
+  pthread_mutex_destroy(&writer->mutex);
+  mar_free(writer);
+
+  return mrv;
+}
+
+/**
+ * Writes the configuration text of the session.
+ *
+ * @param writer The log
+ * @param config The configuration text
+ * @param length The number of bytes of configuration text
+ *
+ * @return MAR_ERROR_NONE on success, an error code on failure
+ */
+MAR_PUBLIC
+mar_error_code mar_capture_log_write_config(mar_capture_log_writer *writer, const char *config, size_t length)
+{
+  // The terminator lets the text be parsed in place from the mapped log
+  return mar_capture_log_write_record(writer, MAR_CAPTURE_LOG_RECORD_CONFIG, 0, config, length, "", 1);
+}
+
+/**
+ * Writes a camera frame.  May be called from several threads at once.
+ *
+ * @param writer The log
+ * @param stream The stream of the frame, less than MAR_CAPTURE_LOG_MAX_STREAMS
+ * @param frame The frame
+ *
+ * @return MAR_ERROR_NONE on success, an error code on failure
+ */
+MAR_PUBLIC
+mar_error_code mar_capture_log_write_frame(mar_capture_log_writer *writer, int stream, const mar_camera_frame *frame)
+{
+  mar_capture_log_frame description;
+
+  if (stream < 0 || stream >= MAR_CAPTURE_LOG_MAX_STREAMS)
+  {
+    return MAR_ERROR_INVALID_ARGUMENT;
+  }
+
+  MAR_CLEAR(description);
+  description.timestamp = frame->timestamp;
+  description.sequence = frame->sequence;
+  description.format = frame->format;
+  description.width = frame->width;
+  description.height = frame->height;
+
+  return mar_capture_log_write_record(writer, MAR_CAPTURE_LOG_RECORD_FRAME, (uint32_t)stream,
+      &description, sizeof(description), frame->data, frame->length);
+}
+
+/**
+ * Writes a call made to the augmentation.
+ *
+ * @param writer The log
+ * @param event The call
+ *
+ * @return MAR_ERROR_NONE on success, an error code on failure
+ */
+MAR_PUBLIC
+mar_error_code mar_capture_log_write_event(mar_capture_log_writer *writer, const mar_capture_log_event *event)
+{
+  return mar_capture_log_write_record(writer, MAR_CAPTURE_LOG_RECORD_EVENT, 0, event, sizeof(*event), NULL, 0);
+}
+
+/**
+ * Walks the records of a mapped log, counting them or filling the log's indices.  A record cut short by the end
+ * of the file, as left by a session which did not finish, ends the log.
+ *
+ * @param log The log, whose indices are filled if fill is set
+ * @param fill Whether or not to fill the indices, which must have room for every record counted before
+ */
+MAR_PRIVATE
+void mar_capture_log_index(mar_capture_log *log, char fill)
+{
+  size_t offset = sizeof(mar_capture_log_header);
+  const mar_capture_log_record *record;
+  int i;
+
+  for (i = 0; i < MAR_CAPTURE_LOG_MAX_STREAMS; i++)
+  {
+    log->num_frames[i] = 0;
+  }
+  log->num_events = 0;
+
+  while (offset + sizeof(mar_capture_log_record) <= log->length)
+  {
+    record = (const mar_capture_log_record *)(log->data + offset);
+    if (record->length > log->length - offset - sizeof(mar_capture_log_record))
+    {
+      break;
+    }
+
+    switch (record->type)
+    {
+      case MAR_CAPTURE_LOG_RECORD_CONFIG:
+        log->config = (const char *)(record + 1);
+        break;
+      case MAR_CAPTURE_LOG_RECORD_FRAME:
+        if (record->stream < MAR_CAPTURE_LOG_MAX_STREAMS && record->length >= sizeof(mar_capture_log_frame))
+        {
+          if (fill)
+          {
+            log->frames[record->stream][log->num_frames[record->stream]] = offset;
+          }
+          log->num_frames[record->stream]++;
+        }
+        break;
+      case MAR_CAPTURE_LOG_RECORD_EVENT:
+        if (record->length >= sizeof(mar_capture_log_event))
+        {
+          if (fill)
+          {
+            log->events[log->num_events] = (const mar_capture_log_event *)(record + 1);
+          }
+          log->num_events++;
+        }
+        break;
+    }
+
+    // The padding of the last record may be cut short too
+    offset += sizeof(mar_capture_log_record) + mar_capture_log_padded(record->length);
+  }
+}
+
+/**
+ * Maps a capture log and indexes its records.
+ *
+ * @param log A pointer to a pointer which will be modified to point at the log
+ * @param file_name The file to read
+ *
+ * @return MAR_ERROR_NONE on success, MAR_ERROR_READING_CAPTURE_LOG if the file is not a capture log, an error code on failure
+ */
+MAR_PUBLIC
+mar_error_code mar_capture_log_open(mar_capture_log **log, const char *file_name)
+{
+  const mar_capture_log_header *header;
+  struct stat st;
+  mar_capture_log *l;
+  void *data;
+  int fd, i;
+
+  *log = l = mar_calloc(1, sizeof(mar_capture_log));
+  if (l == NULL)
+  {
+    return MAR_ERROR_MALLOC;
+  }
+
+  // Map the whole log, the mapping outlives the file descriptor
+  fd = open(file_name, O_RDONLY);
+  if (fd == -1)
+  {
+    mar_free(l);
+    return MAR_ERROR_DEVICE_OPEN;
+  }
+  if (fstat(fd, &st) == -1 || !S_ISREG(st.st_mode) || (size_t)st.st_size < sizeof(mar_capture_log_header))
+  {
+    close(fd);
+    mar_free(l);
+    return MAR_ERROR_READING_CAPTURE_LOG;
+  }
+  l->length = st.st_size;
+  data = mmap(NULL, l->length, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (data == MAP_FAILED)
+  {
+    mar_free(l);
+    return MAR_ERROR_MMAP;
+  }
+  l->data = data;
+
+  header = (const mar_capture_log_header *)l->data;
+  if (memcmp(header->magic, MAR_CAPTURE_LOG_MAGIC, sizeof(header->magic)) != 0 || header->version != MAR_CAPTURE_LOG_VERSION)
+  {
+    munmap(data, l->length);
+    mar_free(l);
+    return MAR_ERROR_READING_CAPTURE_LOG;
+  }
+
+  // Count the records, then index them
+  mar_capture_log_index(l, 0);
+  for (i = 0; i < MAR_CAPTURE_LOG_MAX_STREAMS; i++)
+  {
+    l->frames[i] = mar_malloc((l->num_frames[i] > 0 ? l->num_frames[i] : 1) * sizeof(size_t));
+  }
+  l->events = mar_malloc((l->num_events > 0 ? l->num_events : 1) * sizeof(const mar_capture_log_event *));
+  for (i = 0; i < MAR_CAPTURE_LOG_MAX_STREAMS && l->frames[i] != NULL; i++);
+  if (i < MAR_CAPTURE_LOG_MAX_STREAMS || l->events == NULL)
+  {
+    mar_capture_log_free(l);
+    return MAR_ERROR_MALLOC;
+  }
+  mar_capture_log_index(l, 1);
+
+  return MAR_ERROR_NONE;
+}
+
+/**
+ * Unmaps a capture log and frees it.  Frames taken from the log must not be accessed afterwards.
+ *
+ * @param log The log
+ */
+MAR_PUBLIC
+void mar_capture_log_free(mar_capture_log *log)
+{
+  int i;
+
+  for (i = 0; i < MAR_CAPTURE_LOG_MAX_STREAMS; i++)
+  {
+    mar_free(log->frames[i]);
+  }
+  mar_free(log->events);
+  munmap((void *)log->data, log->length);
+  mar_free(log);
+}
+
+/**
+ * Fills a camera frame with a frame of a log.  The image data points into the mapped log.
+ *
+ * @param log The log
+ * @param stream The stream of the frame
+ * @param index The index of the frame in its stream
+ * @param frame Will be filled with the frame, whose camera ID and buffer index are left unchanged
+ *
+ * @return MAR_ERROR_NONE on success, MAR_ERROR_END_OF_STREAM if the stream has no such frame
+ */
+MAR_PUBLIC
+mar_error_code mar_capture_log_get_frame(const mar_capture_log *log, int stream, uint32_t index, mar_camera_frame *frame)
+{
+  const mar_capture_log_record *record;
+  const mar_capture_log_frame *description;
+
+  if (stream < 0 || stream >= MAR_CAPTURE_LOG_MAX_STREAMS || index >= log->num_frames[stream])
+  {
+    return MAR_ERROR_END_OF_STREAM;
+  }
+
+  record = (const mar_capture_log_record *)(log->data + log->frames[stream][index]);
+  description = (const mar_capture_log_frame *)(record + 1);
+  frame->data = (const unsigned char *)(description + 1);
+  frame->length = record->length - sizeof(mar_capture_log_frame);
+  frame->format = (mar_camera_format)description->format;
+  frame->width = description->width;
+  frame->height = description->height;
+  frame->timestamp = description->timestamp;
+  frame->sequence = description->sequence;
+
+  return MAR_ERROR_NONE;
+}
@@ -0,0 +1,230 @@
+/**
+ * @file mar_capture_log.h
+ *
+ * Contains a log of the camera frames, configuration and augmentation calls of an augmentation session, which
+ * can be replayed bit-exactly.  The log is a header followed by records, each a fixed size record header and a
+ * payload padded to 8 bytes, so a log is read in place by memory mapping it and indexing its records once.
+ * Frames are stored raw in the camera pixel format.  Logs are only meant to be replayed by the build which
+ * recorded them.
+ *
+ * @author Greg Eddington
+ */
+
+#ifndef MAR_CAPTURE_LOG_H
+#define MAR_CAPTURE_LOG_H
+
+#include "../common/mar_error.h"
+#include "mar_camera.h"
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/** The bytes which start every capture log */
+#define MAR_CAPTURE_LOG_MAGIC "MARLOG\r\n"
+/** The version of the capture log layout */
+#define MAR_CAPTURE_LOG_VERSION 1
+/** The maximum number of frame streams in a log, one for each view */
+#define MAR_CAPTURE_LOG_MAX_STREAMS MAR_CAM_MAX_NUM_CAMERAS
+
+/** \defgroup capture_log_records Capture Log Records
+ *  @{
+ */
+/** The text of the configuration the session was initialized with, terminated by a NUL **/
+#define MAR_CAPTURE_LOG_RECORD_CONFIG 1
+/** A mar_capture_log_frame followed by the frame's image data **/
+#define MAR_CAPTURE_LOG_RECORD_FRAME  2
+/** A mar_capture_log_event **/
+#define MAR_CAPTURE_LOG_RECORD_EVENT  3
+/** @} */
+
+/** \defgroup capture_log_events Capture Log Events
+ *  @{
+ */
+/** An augmentation was created **/
+#define MAR_CAPTURE_LOG_EVENT_NEW_AUGMENTATION   1
+/** An augmentation was freed **/
+#define MAR_CAPTURE_LOG_EVENT_FREE_AUGMENTATION  2
+/** Augmentation was started **/
+#define MAR_CAPTURE_LOG_EVENT_START_AUGMENTATION 3
+/** Augmentation was stopped **/
+#define MAR_CAPTURE_LOG_EVENT_STOP_AUGMENTATION  4
+/** @} */
+
+/**
+ * The header of every record @return
+ */
+typedef struct
+{
+  /** The \ref capture_log_records "record type" @return */
+  uint32_t type;
+  /** The stream of a frame record, 0 otherwise @return */
+  uint32_t stream;
+  /** The number of bytes of the payload, not counting its padding @return */
+  uint64_t length;
+}
+mar_capture_log_record;
+
+/**
+ * The description of a frame record's image data @return
+ */
+typedef struct
+{
+  /** The time the frame was captured in microseconds @return */
+  uint64_t timestamp;
+  /** The frame sequence number assigned by the camera @return */
+  uint32_t sequence;
+  /** The camera pixel format of the image data @return */
+  uint32_t format;
+  /** The frame width @return */
+  int32_t width;
+  /** The frame height @return */
+  int32_t height;
+}
+mar_capture_log_frame;
+
+/**
+ * A call made to the augmentation between two updates @return
+ */
+typedef struct
+{
+  /** The \ref capture_log_events "event type" @return */
+  uint32_t type;
+  /** The number of updates made before the call @return */
+  uint32_t update;
+  /** The view of a new augmentation @return */
+  int32_t view;
+  /** The ID of a new or freed augmentation @return */
+  int32_t id;
+  /** The error returned by the call @return */
+  int32_t error;
+  /** The X coordinate of the center of a new augmentation's MSER @return */
+  float ellipse_x;
+  /** The Y coordinate of the center of a new augmentation's MSER @return */
+  float ellipse_y;
+  /** The semimajor axis of a new augmentation's MSER @return */
+  float ellipse_a;
+  /** The semiminor axis of a new augmentation's MSER @return */
+  float ellipse_b;
+  /** The angle of rotation of a new augmentation's MSER @return */
+  float ellipse_angle;
+}
+mar_capture_log_event;
+
+/**
+ * A capture log being written
+ */
+typedef struct
+{
+  /** The log file @return Do not access directly when using the library */
+  FILE *file;
+  /** Serializes records written from several threads @return Do not access directly when using the library */
+  pthread_mutex_t mutex;
+  /** The first error writing the log @return Read-Only */
+  mar_error_code error;
+}
+mar_capture_log_writer;
+
+/**
+ * A memory mapped capture log being read
+ */
+typedef struct mar_capture_log
+{
+  /** The mapped log file @return Do not access directly when using the library */
+  const uint8_t *data;
+  /** The number of bytes mapped @return Do not access directly when using the library */
+  size_t length;
+  /** The configuration text, or NULL if none was recorded @return Read-Only */
+  const char *config;
+  /** The offsets of the frame records of each stream @return Do not access directly when using the library */
+  size_t *frames[MAR_CAPTURE_LOG_MAX_STREAMS];
+  /** The number of frames of each stream @return Read-Only */
+  uint32_t num_frames[MAR_CAPTURE_LOG_MAX_STREAMS];
+  /** The events in the order they were written @return Do not access directly when using the library */
+  const mar_capture_log_event **events;
+  /** The number of events @return Read-Only */
+  uint32_t num_events;
+}
+mar_capture_log;
+
+/**
+ * Creates a capture log, replacing any file of the same name.
+ *
+ * @param writer A pointer to a pointer which will be modified to point at the new log
+ * @param file_name The file to write
+ *
+ * @return MAR_ERROR_NONE on success, an error code on failure
+ */
+mar_error_code mar_capture_log_writer_new(mar_capture_log_writer **writer, const char *file_name);
+
+/**
+ * Finishes writing a capture log and frees it.
+ *
+ * @param writer The log
+ *
+ * @return MAR_ERROR_NONE on success, MAR_ERROR_WRITING_CAPTURE_LOG if any record could not be written
+ */
+mar_error_code mar_capture_log_writer_free(mar_capture_log_writer *writer);
+
+/**
+ * Writes the configuration text of the session.
+ *
+ * @param writer The log
+ * @param config The configuration text
+ * @param length The number of bytes of configuration text
+ *
+ * @return MAR_ERROR_NONE on success, an error code on failure
+ */
+mar_error_code mar_capture_log_write_config(mar_capture_log_writer *writer, const char *config, size_t length);
+
+/**
+ * Writes a camera frame.  May be called from several threads at once.
+ *
+ * @param writer The log
+ * @param stream The stream of the frame, less than MAR_CAPTURE_LOG_MAX_STREAMS
+ * @param frame The frame
+ *
+ * @return MAR_ERROR_NONE on success, an error code on failure
+ */
+mar_error_code mar_capture_log_write_frame(mar_capture_log_writer *writer, int stream, const mar_camera_frame *frame);
+
+/**
+ * Writes a call made to the augmentation.
+ *
+ * @param writer The log
+ * @param event The call
+ *
+ * @return MAR_ERROR_NONE on success, an error code on failure
+ */
+mar_error_code mar_capture_log_write_event(mar_capture_log_writer *writer, const mar_capture_log_event *event);
+
+/**
+ * Maps a capture log and indexes its records.
+ *
+ * @param log A pointer to a pointer which will be modified to point at the log
+ * @param file_name The file to read
+ *
+ * @return MAR_ERROR_NONE on success, MAR_ERROR_READING_CAPTURE_LOG if the file is not a capture log, an error code on failure
+ */
+mar_error_code mar_capture_log_open(mar_capture_log **log, const char *file_name);
+
+/**
+ * Unmaps a capture log and frees it.  Frames taken from the log must not be accessed afterwards.
+ *
+ * @param log The log
+ */
+void mar_capture_log_free(mar_capture_log *log);
+
+/**
+ * Fills a camera frame with a frame of a log.  The image data points into the mapped log.
+ *
+ * @param log The log
+ * @param stream The stream of the frame
+ * @param index The index of the frame in its stream
+ * @param frame Will be filled with the frame, whose camera ID and buffer index are left unchanged
+ *
+ * @return MAR_ERROR_NONE on success, MAR_ERROR_END_OF_STREAM if the stream has no such frame
+ */
+mar_error_code mar_capture_log_get_frame(const mar_capture_log *log, int stream, uint32_t index, mar_camera_frame *frame);
+
+#endif
@@ -0,0 +1,441 @@
+/**
+ * @file mar_capture_ring.c
+ *
+ * Contains the asynchronous capture thread of the MAR library.  A dedicated thread captures frames
+ * from a camera and copies them into a small single-producer/single-consumer ring, so that the
+ * consumer never waits on the camera while a frame is ready.
+ *
+ * Each slot of the ring moves through FREE -> WRITING -> READY -> READING -> FREE.  The capture thread
+ * only claims FREE slots, or with the drop-oldest policy the oldest READY slot, and the consumer only
+ * claims READY slots, with every claim made by a compare-and-swap on the slot state.  A thread about to wait
+ * sets its waiting flag and looks at the slots once more, and the other thread only posts when it clears a set
+ * flag, so neither semaphore counts more than the one wakeup its waiter asked for.
+ *
+ * @author Greg Eddington
+ */
+
+#include "mar_capture_ring.h"
+#include "../common/mar_common.h"
+
+#include <stdlib.h>
+#include <errno.h>
+#include <time.h>
+
+/** \defgroup capture_ring_slot_states Capture Ring Slot States
+ *  @{
+ */
+/** The slot is empty */
+#define MAR_CAPTURE_RING_SLOT_FREE    0
+/** The capture thread is copying a frame into the slot */
+#define MAR_CAPTURE_RING_SLOT_WRITING 1
+/** The slot holds a frame which has not been taken */
+#define MAR_CAPTURE_RING_SLOT_READY   2
+/** The slot's frame is held by the consumer */
+#define MAR_CAPTURE_RING_SLOT_READING 3
+/** @} */
+
+/** How long the capture thread waits for a free slot before checking if it should stop, in milliseconds */
+#define MAR_CAPTURE_RING_POLL_MS 100
+
+/** How long the consumer waits for a frame before timing out, in milliseconds */
+#define MAR_CAPTURE_RING_TIMEOUT_MS 1000
+
+/**
+ * Atomically changes a slot's state.
+ *
+ * @param slot The slot
+ * @param from The expected current state
+ * @param to The new state
+ *
+ * @return 1 if the state was changed, 0 if the slot was not in the expected state
+ */
+MAR_PRIVATE
+int mar_capture_ring_claim(mar_capture_ring_slot *slot, int from, int to)
+{
+  return __atomic_compare_exchange_n(&slot->state, &from, to, 0, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+}
+
+/**
+ * Wakes the other thread if it is waiting on a semaphore.  The slot change it waits for must be made first.
+ *
+ * @param waiting The waiting flag of the other thread
+ * @param sem The semaphore it waits on
+ */
+MAR_PRIVATE
+void mar_capture_ring_wake(int *waiting, sem_t *sem)
+{
+  if (__atomic_exchange_n(waiting, 0, __ATOMIC_SEQ_CST))
+  {
+    sem_post(sem);
+  }
+}
+
+/**
+ * Waits on a semaphore for at most a number of milliseconds.
+ *
+ * @param sem The semaphore
+ * @param ms The number of milliseconds to wait
+ *
+ * @return 0 if the semaphore was decremented, -1 with errno set otherwise
+ */
+MAR_PRIVATE
+int mar_capture_ring_wait(sem_t *sem, long ms)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_REALTIME, &ts);
+  ts.tv_sec += ms / 1000;
+  ts.tv_nsec += (ms % 1000) * 1000000;
+  if (ts.tv_nsec >= 1000000000)
+  {
+    ts.tv_sec++;
+    ts.tv_nsec -= 1000000000;
+  }
+
+  return sem_timedwait(sem, &ts);
+}
+
+/**
+ * Claims a slot for the capture thread to write the next frame into, waiting if the policy requires it.
+ *
+ * @param ring The ring
+ *
+ * @return The claimed slot, or NULL if the ring is stopping
+ */
+MAR_PRIVATE
+mar_capture_ring_slot *mar_capture_ring_claim_write_slot(mar_capture_ring *ring)
+{
+  int i, oldest;
+  unsigned int order, oldest_order = 0;
+
+  while (__atomic_load_n(&ring->running, __ATOMIC_ACQUIRE))
+  {
+    // Prefer an empty slot
+    for (i = 0; i < MAR_CAPTURE_RING_NUM_SLOTS; i++)
+    {
+      if (mar_capture_ring_claim(&ring->slots[i], MAR_CAPTURE_RING_SLOT_FREE, MAR_CAPTURE_RING_SLOT_WRITING))
+      {
+        return &ring->slots[i];
+      }
+    }
+
+    // Overwrite the oldest frame the consumer has not taken
+    if (ring->policy == MAR_CAM_CAPTURE_DROP_OLDEST)
+    {
+      oldest = -1;
+      for (i = 0; i < MAR_CAPTURE_RING_NUM_SLOTS; i++)
+      {
+        order = __atomic_load_n(&ring->slots[i].order, __ATOMIC_RELAXED);
+        if (__atomic_load_n(&ring->slots[i].state, __ATOMIC_ACQUIRE) == MAR_CAPTURE_RING_SLOT_READY &&
+            (oldest == -1 || (int)(order - oldest_order) < 0))
+        {
+          oldest = i;
+          oldest_order = order;
+        }
+      }
+
+      if (oldest != -1 && mar_capture_ring_claim(&ring->slots[oldest], MAR_CAPTURE_RING_SLOT_READY, MAR_CAPTURE_RING_SLOT_WRITING))
+      {
+        __atomic_add_fetch(&ring->num_dropped, 1, __ATOMIC_RELAXED);
+        return &ring->slots[oldest];
+      }
+      else if (oldest != -1)
+      {
+        // The consumer took the frame first, try again
+        continue;
+      }
+    }
+
+    // Every frame is held by the consumer, or the policy is to block, so ask to be woken and look once more
+    if (!__atomic_load_n(&ring->capture_waiting, __ATOMIC_RELAXED))
+    {
+      __atomic_store_n(&ring->capture_waiting, 1, __ATOMIC_SEQ_CST);
+      continue;
+    }
+    mar_capture_ring_wait(&ring->slot_freed, MAR_CAPTURE_RING_POLL_MS);
+  }
+
+  return NULL;
+}
+
+/**
+ * The capture thread.  Captures frames from the camera and copies them into the ring until the ring is stopped
+ * or the camera fails.
+ *
+ * @param arg The ring
+ *
+ * @return NULL
+ */
+MAR_PRIVATE
+void *mar_capture_ring_thread(void *arg)
+{
+  mar_capture_ring *ring = (mar_capture_ring *)arg;
+  mar_capture_ring_slot *slot;
+  mar_camera_frame frame;
+  mar_error_code mrv = MAR_ERROR_NONE;
+  unsigned char *data;
+
+  while (__atomic_load_n(&ring->running, __ATOMIC_ACQUIRE))
+  {
+    mrv = ring->acquire(ring->camera_id, &frame);
+    if (mrv == MAR_ERROR_AGAIN || mrv == MAR_ERROR_INTERRUPTED || mrv == MAR_ERROR_CAMERA_TIMEOUT)
+    {
+      continue;
+    }
+    else if (mrv != MAR_ERROR_NONE)
+    {
+      break;
+    }
+
+    slot = mar_capture_ring_claim_write_slot(ring);
+    if (slot == NULL)
+    {
+      ring->release(ring->camera_id, &frame);
+      break;
+    }
+
+    // Copy the frame so the camera buffer can be returned right away
+    if (slot->capacity < frame.length)
+    {
+      data = mar_realloc(slot->data, frame.length);
+      if (data == NULL)
+      {
+        __atomic_store_n(&slot->state, MAR_CAPTURE_RING_SLOT_FREE, __ATOMIC_RELEASE);
+        ring->release(ring->camera_id, &frame);
+        mrv = MAR_ERROR_MALLOC;
+        break;
+      }
+      slot->data = data;
+      slot->capacity = frame.length;
+    }
+    memcpy(slot->data, frame.data, frame.length);
+    slot->frame = frame;
+    slot->frame.data = slot->data;
+    slot->frame.buffer_index = slot - ring->slots;
+
+    mrv = ring->release(ring->camera_id, &frame);
+    if (mrv != MAR_ERROR_NONE)
+    {
+      __atomic_store_n(&slot->state, MAR_CAPTURE_RING_SLOT_FREE, __ATOMIC_RELEASE);
+      break;
+    }
+
+    // Publish the frame
+    __atomic_store_n(&slot->order, ring->next_order++, __ATOMIC_RELAXED);
+    __atomic_store_n(&slot->state, MAR_CAPTURE_RING_SLOT_READY, __ATOMIC_SEQ_CST);
+    mar_capture_ring_wake(&ring->consumer_waiting, &ring->frame_ready);
+  }
+
+  // Report why capturing stopped and wake the consumer
+  if (__atomic_load_n(&ring->running, __ATOMIC_ACQUIRE) && mrv != MAR_ERROR_NONE)
+  {
+    __atomic_store_n(&ring->error, mrv, __ATOMIC_RELEASE);
+    sem_post(&ring->frame_ready);
+  }
+
+  return NULL;
+}
+
+/**
+ * Creates a capture ring and starts its capture thread.  The camera must already be capturing.
+ *
+ * @param ring A pointer to a pointer which will be modified to point at the new ring
+ * @param id The ID of the camera to capture from
+ * @param policy MAR_CAM_CAPTURE_DROP_OLDEST or MAR_CAM_CAPTURE_BLOCK
+ * @param acquire Captures a frame from the camera
+ * @param release Returns a frame captured with acquire to the camera
+ *
+ * @return MAR_ERROR_NONE on success, an error code on failure
+ */
+MAR_PUBLIC
+mar_error_code mar_capture_ring_new(mar_capture_ring **ring, mar_camera_id id, mar_camera_capture_policy policy,
+    mar_capture_ring_source acquire, mar_capture_ring_source release)
+{
+  mar_capture_ring *r;
+
+  *ring = r = calloc(1, sizeof(mar_capture_ring));
+  if (r == NULL)
+  {
+    return MAR_ERROR_MALLOC;
+  }
+
+  r->camera_id = id;
+  r->policy = policy;
+  r->acquire = acquire;
+  r->release = release;
+  r->running = 1;
+  r->error = MAR_ERROR_NONE;
+
+  if (sem_init(&r->frame_ready, 0, 0) == -1)
+  {
+    free(r);
+    return MAR_ERROR_THREAD;
+  }
+
+  if (sem_init(&r->slot_freed, 0, 0) == -1)
+  {
+    sem_destroy(&r->frame_ready);
+    free(r);
+    return MAR_ERROR_THREAD;
+  }
+
+  if (pthread_create(&r->thread, NULL, mar_capture_ring_thread, r) != 0)
+  {
+    sem_destroy(&r->slot_freed);
+    sem_destroy(&r->frame_ready);
+    free(r);
+    return MAR_ERROR_THREAD;
+  }
+
+  return MAR_ERROR_NONE;
+}
+
+/**
+ * Stops a capture ring's thread and frees the ring.  Frames acquired from the ring must not be accessed afterwards.
+ *
+ * @param ring The ring to free
+ */
+MAR_PUBLIC
+void mar_capture_ring_free(mar_capture_ring *ring)
+{
+  int i;
+
+  // Stop the capture thread, waking it if it is waiting on the consumer
+  __atomic_store_n(&ring->running, 0, __ATOMIC_RELEASE);
+  sem_post(&ring->slot_freed);
+  pthread_join(ring->thread, NULL);
+
+  sem_destroy(&ring->slot_freed);
+  sem_destroy(&ring->frame_ready);
+  for (i = 0; i < MAR_CAPTURE_RING_NUM_SLOTS; i++)
+  {
+    mar_free(ring->slots[i].data);
+  }
+  free(ring);
+}
+
+/**
+ * Takes a ready frame from the ring, waiting for one if none are ready.  With the drop-oldest policy
+ * the newest frame is taken and older ready frames are left to be overwritten, with the block policy
+ * frames are taken in the order they were captured.
+ *
+ * @param ring The ring
+ * @param frame Will be filled with the frame
+ *
+ * @return MAR_ERROR_NONE on success, an error code on failure
+ */
+MAR_PUBLIC
+mar_error_code mar_capture_ring_acquire_frame(mar_capture_ring *ring, mar_camera_frame *frame)
+{
+  int i, best;
+  unsigned int order, best_order = 0;
+  mar_error_code mrv;
+
+  for (;;)
+  {
+    // Find the newest or oldest ready frame depending on the policy
+    best = -1;
+    for (i = 0; i < MAR_CAPTURE_RING_NUM_SLOTS; i++)
+    {
+      if (__atomic_load_n(&ring->slots[i].state, __ATOMIC_SEQ_CST) == MAR_CAPTURE_RING_SLOT_READY)
+      {
+        order = __atomic_load_n(&ring->slots[i].order, __ATOMIC_RELAXED);
+        if (best == -1 ||
+            (ring->policy == MAR_CAM_CAPTURE_DROP_OLDEST ? (int)(order - best_order) > 0 : (int)(order - best_order) < 0))
+        {
+          best = i;
+          best_order = order;
+        }
+      }
+    }
+
+    if (best != -1)
+    {
+      if (mar_capture_ring_claim(&ring->slots[best], MAR_CAPTURE_RING_SLOT_READY, MAR_CAPTURE_RING_SLOT_READING))
+      {
+        // Drop every frame older than the one taken so it is never returned later
+        if (ring->policy == MAR_CAM_CAPTURE_DROP_OLDEST)
+        {
+          best_order = __atomic_load_n(&ring->slots[best].order, __ATOMIC_RELAXED);
+          for (i = 0; i < MAR_CAPTURE_RING_NUM_SLOTS; i++)
+          {
+            order = __atomic_load_n(&ring->slots[i].order, __ATOMIC_RELAXED);
+            if ((int)(order - best_order) < 0 &&
+                mar_capture_ring_claim(&ring->slots[i], MAR_CAPTURE_RING_SLOT_READY, MAR_CAPTURE_RING_SLOT_FREE))
+            {
+              __atomic_add_fetch(&ring->num_dropped, 1, __ATOMIC_RELAXED);
+              mar_capture_ring_wake(&ring->capture_waiting, &ring->slot_freed);
+            }
+          }
+        }
+
+        *frame = ring->slots[best].frame;
+        return MAR_ERROR_NONE;
+      }
+
+      // The capture thread overwrote the frame first, try again
+      continue;
+    }
+
+    // Report if the capture thread has stopped
+    mrv = __atomic_load_n(&ring->error, __ATOMIC_ACQUIRE);
+    if (mrv != MAR_ERROR_NONE)
+    {
+      return mrv;
+    }
+
+    // Ask to be woken and look once more, then wait for the capture thread to publish a frame
+    if (!__atomic_load_n(&ring->consumer_waiting, __ATOMIC_RELAXED))
+    {
+      __atomic_store_n(&ring->consumer_waiting, 1, __ATOMIC_SEQ_CST);
+      continue;
+    }
+    if (mar_capture_ring_wait(&ring->frame_ready, MAR_CAPTURE_RING_TIMEOUT_MS) == -1)
+    {
+      if (errno == ETIMEDOUT)
+      {
+        return MAR_ERROR_CAMERA_TIMEOUT;
+      }
+      else if (errno == EINTR)
+      {
+        return MAR_ERROR_INTERRUPTED;
+      }
+    }
+  }
+}
+
+/**
+ * Returns a frame taken with mar_capture_ring_acquire_frame to the ring.
+ *
+ * @param ring The ring
+ * @param frame The frame to release
+ *
+ * @return MAR_ERROR_NONE on success, an error code on failure
+ */
+MAR_PUBLIC
+mar_error_code mar_capture_ring_release_frame(mar_capture_ring *ring, mar_camera_frame *frame)
+{
+  if (frame->buffer_index < 0 || frame->buffer_index >= MAR_CAPTURE_RING_NUM_SLOTS ||
+      !mar_capture_ring_claim(&ring->slots[frame->buffer_index], MAR_CAPTURE_RING_SLOT_READING, MAR_CAPTURE_RING_SLOT_FREE))
+  {
+    return MAR_ERROR_CAMERA_FRAME_NOT_ACQUIRED;
+  }
+
+  frame->data = NULL;
+  mar_capture_ring_wake(&ring->capture_waiting, &ring->slot_freed);
+
+  return MAR_ERROR_NONE;
+}
+
+/**
+ * Returns the number of frames overwritten before they were taken by the consumer.
+ *
+ * @param ring The ring
+ *
+ * @return The number of dropped frames
+ */
+MAR_PUBLIC
+unsigned int mar_capture_ring_get_num_dropped(mar_capture_ring *ring)
+{
+  return __atomic_load_n(&ring->num_dropped, __ATOMIC_RELAXED);
+}
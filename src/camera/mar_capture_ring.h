@@ -0,0 +1,133 @@
+/**
+ * @file mar_capture_ring.h
+ *
+ * Contains the asynchronous capture thread of the MAR library.  A dedicated thread captures frames
+ * from a camera and copies them into a small single-producer/single-consumer ring, so that the
+ * consumer never waits on the camera while a frame is ready.
+ *
+ * @author Greg Eddington
+ */
+
+#ifndef MAR_CAPTURE_RING_H
+#define MAR_CAPTURE_RING_H
+
+#include "../common/mar_error.h"
+#include "mar_camera.h"
+#include <pthread.h>
+#include <semaphore.h>
+
+/** The number of frames in a capture ring */
+#define MAR_CAPTURE_RING_NUM_SLOTS 4
+
+/**
+ * A function which captures or releases a frame for a capture ring @return
+ */
+typedef mar_error_code (*mar_capture_ring_source)(mar_camera_id id, mar_camera_frame *frame);
+
+/**
+ * A frame in a capture ring
+ */
+typedef struct
+{
+  /** The state of the slot, accessed atomically @return Do not access directly when using the library */
+  int state;
+  /** The capture order of the frame, accessed atomically @return Do not access directly when using the library */
+  unsigned int order;
+  /** The frame, whose data points to the slot's storage @return Do not access directly when using the library */
+  mar_camera_frame frame;
+  /** The slot's frame storage @return Do not access directly when using the library */
+  unsigned char *data;
+  /** The size of the slot's frame storage @return Do not access directly when using the library */
+  size_t capacity;
+}
+mar_capture_ring_slot;
+
+/**
+ * An asynchronous capture thread and the ring of frames it fills
+ */
+typedef struct
+{
+  /** The camera being captured from @return Do not access directly when using the library */
+  mar_camera_id camera_id;
+  /** The capture policy, MAR_CAM_CAPTURE_DROP_OLDEST or MAR_CAM_CAPTURE_BLOCK @return Do not access directly when using the library */
+  mar_camera_capture_policy policy;
+  /** Captures a frame from the camera @return Do not access directly when using the library */
+  mar_capture_ring_source acquire;
+  /** Returns a frame to the camera @return Do not access directly when using the library */
+  mar_capture_ring_source release;
+  /** The frames of the ring @return Do not access directly when using the library */
+  mar_capture_ring_slot slots[MAR_CAPTURE_RING_NUM_SLOTS];
+  /** The capture order of the next frame @return Do not access directly when using the library */
+  unsigned int next_order;
+  /** The number of frames dropped by the drop-oldest policy, accessed atomically @return Do not access directly when using the library */
+  unsigned int num_dropped;
+  /** Whether or not the capture thread should keep running, accessed atomically @return Do not access directly when using the library */
+  int running;
+  /** The error which stopped the capture thread, accessed atomically @return Do not access directly when using the library */
+  int error;
+  /** The capture thread @return Do not access directly when using the library */
+  pthread_t thread;
+  /** Posted when a frame becomes ready while the consumer waits for one @return Do not access directly when using the library */
+  sem_t frame_ready;
+  /** Posted when a slot is freed while the capture thread waits for one @return Do not access directly when using the library */
+  sem_t slot_freed;
+  /** Whether or not the consumer waits on frame_ready, accessed atomically @return Do not access directly when using the library */
+  int consumer_waiting;
+  /** Whether or not the capture thread waits on slot_freed, accessed atomically @return Do not access directly when using the library */
+  int capture_waiting;
+}
+mar_capture_ring;
+
+/**
+ * Creates a capture ring and starts its capture thread.  The camera must already be capturing.
+ *
+ * @param ring A pointer to a pointer which will be modified to point at the new ring
+ * @param id The ID of the camera to capture from
+ * @param policy MAR_CAM_CAPTURE_DROP_OLDEST or MAR_CAM_CAPTURE_BLOCK
+ * @param acquire Captures a frame from the camera
+ * @param release Returns a frame captured with acquire to the camera
+ *
+ * @return MAR_ERROR_NONE on success, an error code on failure
+ */
+mar_error_code mar_capture_ring_new(mar_capture_ring **ring, mar_camera_id id, mar_camera_capture_policy policy,
+    mar_capture_ring_source acquire, mar_capture_ring_source release);
+
+/**
+ * Stops a capture ring's thread and frees the ring.  Frames acquired from the ring must not be accessed afterwards.
+ *
+ * @param ring The ring to free
+ */
+void mar_capture_ring_free(mar_capture_ring *ring);
+
+/**
+ * Takes a ready frame from the ring, waiting for one if none are ready.  With the drop-oldest policy
+ * the newest frame is taken and older ready frames are left to be overwritten, with the block policy
+ * frames are taken in the order they were captured.
+ *
+ * @param ring The ring
+ * @param frame Will be filled with the frame
+ *
+ * @return MAR_ERROR_NONE on success, an error code on failure
+ */
+mar_error_code mar_capture_ring_acquire_frame(mar_capture_ring *ring, mar_camera_frame *frame);
+
+/**
+ * Returns a frame taken with mar_capture_ring_acquire_frame to the ring.
+ *
+ * @param ring The ring
+ * @param frame The frame to release
+ *
+ * @return MAR_ERROR_NONE on success, an error code on failure
+ */
+mar_error_code mar_capture_ring_release_frame(mar_capture_ring *ring, mar_camera_frame *frame);
+
+/**
+ * Returns the number of frames overwritten before they were taken by the consumer.
+ *
+ * @param ring The ring
+ *
+ * @return The number of dropped frames
+ */
+unsigned int mar_capture_ring_get_num_dropped(mar_capture_ring *ring);
+
+#endif
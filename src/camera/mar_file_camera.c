@@ -0,0 +1,343 @@
+/**
+ * @file mar_file_camera.c
+ *
+ * Contains camera interfacing code for the MAR library for recorded video files.  A file is a raw dump of
+ * frames in the camera pixel format, one after another with no header, which is memory mapped so frames are
+ * leased straight from the page cache.  Frames are delivered as fast as they are acquired, with no real-time
+ * pacing, so recorded sessions can be processed faster than they were captured.
+ *
+ * @author Greg Eddington
+ */
+
+#include "mar_file_camera.h"
+#include "../common/mar_common.h"
+#include "../common/mar_error.h"
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+/**
+ * Opens a recorded video file as a camera.
+ *
+ * @param cam A pointer to a pointer which will be modified to point at a new camera
+ * @param file_name The file of raw frames
+ * @param format The pixel format of the frames
+ * @param width The frame width
+ * @param height The frame height
+ *
+ * @return MAR_ERROR_NONE on success, MAR_ERROR_END_OF_STREAM if the file holds no whole frame, an error code on failure
+ */
+MAR_PUBLIC
+mar_error_code mar_file_camera_new(mar_file_camera **cam, char *file_name, mar_camera_format format, int width, int height)
+{
+  struct stat st;
+  mar_file_camera *camera;
+  void *data;
+
+  *cam = camera = malloc(sizeof(mar_file_camera));
+
+  if (camera == NULL)
+  {
+    return MAR_ERROR_MALLOC;
+  }
+  MAR_CLEAR(*camera);
+  camera->format = format;
+  camera->width = width;
+  camera->height = height;
+
+  switch (format)
+  {
+    case MAR_CAM_FMT_YUYV:
+      camera->frame_length = (size_t)width * height * 2;
+      break;
+    default:
+      free(camera);
+      return MAR_ERROR_PIXEL_FORMAT_NOT_SUPPORTED;
+  }
+
+  // Check if the file exists
+  if (stat(file_name, &st) == -1)
+  {
+    free(camera);
+    return MAR_ERROR_DEVICE_NOT_FOUND;
+  }
+
+  // Check if it is a file which can be mapped
+  if (!S_ISREG(st.st_mode) || camera->frame_length == 0)
+  {
+    free(camera);
+    return MAR_ERROR_INVALID_ARGUMENT;
+  }
+
+  // Only whole frames are read, a partly written last frame is ignored
+  if ((size_t)st.st_size < camera->frame_length)
+  {
+    free(camera);
+    return MAR_ERROR_END_OF_STREAM;
+  }
+  camera->num_frames = (uint32_t)(st.st_size / camera->frame_length);
+  camera->data_length = camera->num_frames * camera->frame_length;
+
+  // Open the file
+  camera->fd = open(file_name, O_RDONLY);
+  if (camera->fd == -1)
+  {
+    free(camera);
+    return MAR_ERROR_DEVICE_OPEN;
+  }
+
+  // Map the frames, which are read once from start to end
+  data = mmap(NULL, camera->data_length, PROT_READ, MAP_PRIVATE, camera->fd, 0);
+  if (data == MAP_FAILED)
+  {
+    close(camera->fd);
+    free(camera);
+    return MAR_ERROR_MMAP;
+  }
+  posix_madvise(data, camera->data_length, POSIX_MADV_SEQUENTIAL);
+  camera->data = data;
+
+  camera->frame_buffer = malloc(camera->width * camera->height * 3);
+  camera->gray_frame_buffer = malloc(camera->width * camera->height);
+  camera->grayf_frame_buffer = malloc(camera->width * camera->height * sizeof(float));
+  if (camera->frame_buffer == NULL || camera->gray_frame_buffer == NULL || camera->grayf_frame_buffer == NULL)
+  {
+    free(camera->frame_buffer);
+    free(camera->gray_frame_buffer);
+    free(camera->grayf_frame_buffer);
+    munmap((void *)camera->data, camera->data_length);
+    close(camera->fd);
+    free(camera);
+    return MAR_ERROR_MALLOC;
+  }
+
+  return MAR_ERROR_NONE;
+}
+
+/**
+ * Frees a camera created by the MAR library.
+ *
+ * @param camera The camera to free
+ *
+ * @return MAR_ERROR_NONE on success, an error code on failure
+ */
+MAR_PUBLIC
+mar_error_code mar_file_camera_free(mar_file_camera *camera)
+{
+  mar_error_code retval = MAR_ERROR_NONE;
+
+  if (munmap((void *)camera->data, camera->data_length) == -1)
+  {
+    retval = MAR_ERROR_MUNMAP;
+  }
+
+  if (close(camera->fd) == -1)
+  {
+    retval = MAR_ERROR_DEVICE_CLOSE;
+  }
+
+  free(camera->frame_buffer);
+  free(camera->gray_frame_buffer);
+  free(camera->grayf_frame_buffer);
+  free(camera);
+
+  return retval;
+}
+
+/**
+ * Starts camera capturing from the first frame of the file
+ *
+ * @param camera The camera
+ *
+ * @return MAR_ERROR_NONE on success, an error code on failure
+ */
+MAR_PUBLIC
+mar_error_code mar_file_camera_start(mar_file_camera *camera)
+{
+  camera->next_frame = 0;
+
+  return MAR_ERROR_NONE;
+}
+
+/**
+ * Leases the next frame of the file to the caller.  The frame points into the mapped file, so any number of
+ * frames may be held at once.
+ *
+ * @param camera The camera to capture from
+ * @param frame Will be filled with the leased frame
+ *
+ * @return MAR_ERROR_NONE on success, MAR_ERROR_END_OF_STREAM after the last frame, an error code on failure
+ */
+MAR_PUBLIC
+mar_error_code mar_file_camera_acquire_frame(mar_file_camera *camera, mar_camera_frame *frame)
+{
+  if (camera->next_frame >= camera->num_frames)
+  {
+    return MAR_ERROR_END_OF_STREAM;
+  }
+
+  frame->data = camera->data + (size_t)camera->next_frame * camera->frame_length;
+  frame->length = camera->frame_length;
+  frame->format = camera->format;
+  frame->width = camera->width;
+  frame->height = camera->height;
+  frame->timestamp = (uint64_t)camera->next_frame * MAR_FILE_CAMERA_FRAME_INTERVAL;
+  frame->sequence = camera->next_frame;
+  frame->buffer_index = (int)camera->next_frame;
+  camera->next_frame++;
+
+  return MAR_ERROR_NONE;
+}
+
+/**
+ * Returns a leased frame to the camera.
+ *
+ * @param camera The camera the frame was acquired from
+ * @param frame The frame to release
+ *
+ * @return MAR_ERROR_NONE on success, an error code on failure
+ */
+MAR_PUBLIC
+mar_error_code mar_file_camera_release_frame(mar_file_camera *camera, mar_camera_frame *frame)
+{
+  if (frame->data == NULL || frame->buffer_index < 0 || (uint32_t)frame->buffer_index >= camera->num_frames)
+  {
+    return MAR_ERROR_CAMERA_FRAME_NOT_ACQUIRED;
+  }
+
+  frame->data = NULL;
+
+  return MAR_ERROR_NONE;
+}
+
+/**
+ * Updates the camera with the next frame of the file.
+ *
+ * @param camera The camera to update
+ *
+ * @return MAR_ERROR_NONE on success, MAR_ERROR_END_OF_STREAM after the last frame, an error code on failure
+ */
+MAR_PUBLIC
+mar_error_code mar_file_camera_update(mar_file_camera *camera)
+{
+  mar_camera_frame frame;
+  mar_error_code retval;
+
+  retval = mar_file_camera_acquire_frame(camera, &frame);
+  if (retval != MAR_ERROR_NONE)
+  {
+    return retval;
+  }
+
+  // The frame stays mapped, so the frame buffers are converted from it when asked for
+  camera->update_frame = frame;
+  camera->update_converted = 0;
+
+  return mar_file_camera_release_frame(camera, &frame);
+}
+
+/**
+ * Stops camera capturing
+ *
+ * @param camera The camera
+ *
+ * @return MAR_ERROR_NONE on success, an error code on failure
+ */
+MAR_PUBLIC
+mar_error_code mar_file_camera_stop(mar_file_camera *camera)
+{
+  return MAR_ERROR_NONE;
+}
+
+/**
+ * Returns the camera pixel format.
+ *
+ * @param camera The camera to get the pixel format from
+ *
+ * @return The camera pixel format.
+ */
+MAR_PUBLIC
+mar_camera_format mar_file_camera_get_pixel_format(mar_file_camera *camera)
+{
+  return camera->format;
+}
+
+/**
+ * Returns the camera resolution.
+ *
+ * @param camera The camera to get the resolution from
+ * @param width Will be filled with the resolution width.
+ * @param height Will be filled with the resolution height.
+ */
+MAR_PUBLIC
+void mar_file_camera_get_resolution(mar_file_camera *camera, int *width, int *height)
+{
+  *width = camera->width;
+  *height = camera->height;
+}
+
+/**
+ * Returns the camera's frame buffer in an RGB24 format.
+ * The frame buffer is 3 * width * height in size.
+ *
+ * @param camera The camera to get the frame buffer of.
+ *
+ * @return The camera buffer.
+ */
+MAR_PUBLIC
+unsigned char *mar_file_camera_get_frame_buffer(mar_file_camera *camera)
+{
+  // Convert the frame of the last update the first time it is asked for
+  if (camera->update_frame.data != NULL && !(camera->update_converted & MAR_CAM_CONVERTED_RGB))
+  {
+    mar_camera_frame_to_rgb(&camera->update_frame, camera->frame_buffer);
+    camera->update_converted |= MAR_CAM_CONVERTED_RGB;
+  }
+
+  return (unsigned char *)camera->frame_buffer;
+}
+
+/**
+ * Returns the camera's frame buffer as an 8-bit grayscale image taken from the luma channel.
+ * The frame buffer is width * height in size.
+ *
+ * @param camera The camera to get the frame buffer of.
+ *
+ * @return The camera grayscale buffer.
+ */
+MAR_PUBLIC
+unsigned char *mar_file_camera_get_grayscale_frame_buffer(mar_file_camera *camera)
+{
+  // Convert the frame of the last update the first time it is asked for
+  if (camera->update_frame.data != NULL && !(camera->update_converted & MAR_CAM_CONVERTED_GRAYSCALE))
+  {
+    mar_camera_frame_to_grayscale(&camera->update_frame, camera->gray_frame_buffer);
+    camera->update_converted |= MAR_CAM_CONVERTED_GRAYSCALE;
+  }
+
+  return (unsigned char *)camera->gray_frame_buffer;
+}
+
+/**
+ * Returns the camera's frame buffer as a floating point grayscale image normalized to [0-1] taken from the luma channel.
+ * The frame buffer is width * height floats in size.
+ *
+ * @param camera The camera to get the frame buffer of.
+ *
+ * @return The camera floating point grayscale buffer.
+ */
+MAR_PUBLIC
+float *mar_file_camera_get_float_grayscale_frame_buffer(mar_file_camera *camera)
+{
+  // Convert the frame of the last update the first time it is asked for
+  if (camera->update_frame.data != NULL && !(camera->update_converted & MAR_CAM_CONVERTED_FLOAT_GRAYSCALE))
+  {
+    mar_camera_frame_to_float_grayscale(&camera->update_frame, camera->grayf_frame_buffer);
+    camera->update_converted |= MAR_CAM_CONVERTED_FLOAT_GRAYSCALE;
+  }
+
+  return camera->grayf_frame_buffer;
+}
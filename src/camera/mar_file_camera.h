@@ -0,0 +1,177 @@
+/**
+ * @file mar_file_camera.h
+ *
+ * Contains camera interfacing code for the MAR library for recorded video files.  A file is a raw dump of
+ * frames in the camera pixel format, one after another with no header, which is memory mapped so frames are
+ * leased straight from the page cache.  Frames are delivered as fast as they are acquired, with no real-time
+ * pacing, so recorded sessions can be processed faster than they were captured.
+ *
+ * @author Greg Eddington
+ */
+
+#ifndef MAR_FILE_CAMERA_H
+#define MAR_FILE_CAMERA_H
+
+#include "../common/mar_error.h"
+#include "mar_camera.h"
+#include <stddef.h>
+#include <stdint.h>
+
+/** The time in microseconds between the timestamps of consecutive frames of a file */
+#define MAR_FILE_CAMERA_FRAME_INTERVAL 33333
+
+/**
+ * A MAR camera instance for recorded video files
+ */
+typedef struct
+{
+  /** The file descriptor @return Do not access directly when using the library **/
+  int fd;
+  /** The camera pixel format @return Do not access directly when using the library **/
+  mar_camera_format format;
+  /** The frame width @return Do not access directly when using the library **/
+  int width;
+  /** The frame height @return Do not access directly when using the library **/
+  int height;
+  /** The memory mapped file @return Do not access directly when using the library **/
+  const uint8_t *data;
+  /** The number of bytes mapped @return Do not access directly when using the library **/
+  size_t data_length;
+  /** The number of bytes of each frame @return Do not access directly when using the library **/
+  size_t frame_length;
+  /** The number of whole frames in the file @return Do not access directly when using the library **/
+  uint32_t num_frames;
+  /** The index of the next frame to acquire @return Do not access directly when using the library **/
+  uint32_t next_frame;
+  /** The camera frame buffer @return Do not access directly when using the library **/
+  uint8_t *frame_buffer;
+  /** The camera grayscale frame buffer @return Do not access directly when using the library **/
+  uint8_t *gray_frame_buffer;
+  /** The camera floating point grayscale frame buffer @return Do not access directly when using the library **/
+  float *grayf_frame_buffer;
+  /** The frame of the last update, kept until the next so the frame buffers are converted when asked for @return Do not access directly when using the library **/
+  mar_camera_frame update_frame;
+  /** The \ref camera_converted_buffers "frame buffers" converted from the frame of the last update @return Do not access directly when using the library **/
+  unsigned char update_converted;
+}
+mar_file_camera;
+
+/**
+ * Opens a recorded video file as a camera.
+ *
+ * @param cam A pointer to a pointer which will be modified to point at a new camera
+ * @param file_name The file of raw frames
+ * @param format The pixel format of the frames
+ * @param width The frame width
+ * @param height The frame height
+ *
+ * @return MAR_ERROR_NONE on success, MAR_ERROR_END_OF_STREAM if the file holds no whole frame, an error code on failure
+ */
+mar_error_code mar_file_camera_new(mar_file_camera **cam, char *file_name, mar_camera_format format, int width, int height);
+
+/**
+ * Frees a camera created by the MAR library.
+ *
+ * @param camera The camera to free
+ *
+ * @return MAR_ERROR_NONE on success, an error code on failure
+ */
+mar_error_code mar_file_camera_free(mar_file_camera *camera);
+
+/**
+ * Starts camera capturing from the first frame of the file
+ *
+ * @param camera The camera
+ *
+ * @return MAR_ERROR_NONE on success, an error code on failure
+ */
+mar_error_code mar_file_camera_start(mar_file_camera *camera);
+
+/**
+ * Updates the camera with the next frame of the file.
+ *
+ * @param camera The camera to update
+ *
+ * @return MAR_ERROR_NONE on success, MAR_ERROR_END_OF_STREAM after the last frame, an error code on failure
+ */
+mar_error_code mar_file_camera_update(mar_file_camera *camera);
+
+/**
+ * Leases the next frame of the file to the caller.  The frame points into the mapped file, so any number of
+ * frames may be held at once.
+ *
+ * @param camera The camera to capture from
+ * @param frame Will be filled with the leased frame
+ *
+ * @return MAR_ERROR_NONE on success, MAR_ERROR_END_OF_STREAM after the last frame, an error code on failure
+ */
+mar_error_code mar_file_camera_acquire_frame(mar_file_camera *camera, mar_camera_frame *frame);
+
+/**
+ * Returns a leased frame to the camera.
+ *
+ * @param camera The camera the frame was acquired from
+ * @param frame The frame to release
+ *
+ * @return MAR_ERROR_NONE on success, an error code on failure
+ */
+mar_error_code mar_file_camera_release_frame(mar_file_camera *camera, mar_camera_frame *frame);
+
+/**
+ * Stops camera capturing
+ *
+ * @param camera The camera
+ *
+ * @return MAR_ERROR_NONE on success, an error code on failure
+ */
+mar_error_code mar_file_camera_stop(mar_file_camera *camera);
+
+/**
+ * Returns the camera pixel format.
+ *
+ * @param camera The camera to get the pixel format from
+ *
+ * @return The camera pixel format.
+ */
+mar_camera_format mar_file_camera_get_pixel_format(mar_file_camera *camera);
+
+/**
+ * Returns the camera resolution.
+ *
+ * @param camera The camera to get the resolution from
+ * @param width Will be filled with the resolution width.
+ * @param height Will be filled with the resolution height.
+ */
+void mar_file_camera_get_resolution(mar_file_camera *camera, int *width, int *height);
+
+/**
+ * Returns the camera's frame buffer in an RGB24 format.
+ * The frame buffer is 3 * width * height in size.
+ *
+ * @param camera The camera to get the frame buffer of.
+ *
+ * @return The camera buffer.
+ */
+unsigned char *mar_file_camera_get_frame_buffer(mar_file_camera *camera);
+
+/**
+ * Returns the camera's frame buffer as an 8-bit grayscale image taken from the luma channel.
+ * The frame buffer is width * height in size.
+ *
+ * @param camera The camera to get the frame buffer of.
+ *
+ * @return The camera grayscale buffer.
+ */
+unsigned char *mar_file_camera_get_grayscale_frame_buffer(mar_file_camera *camera);
+
+/**
+ * Returns the camera's frame buffer as a floating point grayscale image normalized to [0-1] taken from the luma channel.
+ * The frame buffer is width * height floats in size.
+ *
+ * @param camera The camera to get the frame buffer of.
+ *
+ * @return The camera floating point grayscale buffer.
+ */
+float *mar_file_camera_get_float_grayscale_frame_buffer(mar_file_camera *camera);
+
+#endif
@@ -0,0 +1,333 @@
+/**
+ * @file mar_replay_camera.c
+ *
+ * Contains camera interfacing code for the MAR library for replaying the frames of a capture log.  Each frame
+ * is served exactly as it was recorded, image data, timestamp and sequence number alike, so a replayed
+ * session computes the same results as the recorded one.  Frames are delivered as fast as they are acquired.
+ *
+ * @author Greg Eddington
+ */
+
+#include "mar_replay_camera.h"
+#include "../common/mar_common.h"
+#include "../common/mar_error.h"
+
+#include <stdlib.h>
+
+/**
+ * Creates a camera replaying one stream of an open capture log.  The log must outlive the camera.
+ *
+ * @param cam A pointer to a pointer which will be modified to point at a new camera
+ * @param log The log
+ * @param stream The stream to replay
+ *
+ * @return MAR_ERROR_NONE on success, MAR_ERROR_END_OF_STREAM if the stream holds no frame, an error code on failure
+ */
+MAR_PUBLIC
+mar_error_code mar_replay_camera_new(mar_replay_camera **cam, mar_capture_log *log, int stream)
+{
+  mar_replay_camera *camera;
+  mar_camera_frame frame;
+  mar_error_code retval;
+
+  *cam = camera = malloc(sizeof(mar_replay_camera));
+
+  if (camera == NULL)
+  {
+    return MAR_ERROR_MALLOC;
+  }
+  MAR_CLEAR(*camera);
+  camera->log = log;
+  camera->stream = stream;
+
+  // The first frame describes the stream
+  retval = mar_capture_log_get_frame(log, stream, 0, &frame);
+  if (retval != MAR_ERROR_NONE)
+  {
+    free(camera);
+    return retval;
+  }
+  if (frame.format != MAR_CAM_FMT_YUYV)
+  {
+    free(camera);
+    return MAR_ERROR_PIXEL_FORMAT_NOT_SUPPORTED;
+  }
+  camera->format = frame.format;
+  camera->width = frame.width;
+  camera->height = frame.height;
+
+  camera->frame_buffer = malloc(camera->width * camera->height * 3);
+  camera->gray_frame_buffer = malloc(camera->width * camera->height);
+  camera->grayf_frame_buffer = malloc(camera->width * camera->height * sizeof(float));
+  if (camera->frame_buffer == NULL || camera->gray_frame_buffer == NULL || camera->grayf_frame_buffer == NULL)
+  {
+    free(camera->frame_buffer);
+    free(camera->gray_frame_buffer);
+    free(camera->grayf_frame_buffer);
+    free(camera);
+    return MAR_ERROR_MALLOC;
+  }
+
+  return MAR_ERROR_NONE;
+}
+
+/**
+ * Opens a capture log as a camera replaying its first stream.
+ *
+ * @param cam A pointer to a pointer which will be modified to point at a new camera
+ * @param file_name The capture log
+ * @param format The pixel format the frames must have
+ * @param width The width the frames must have
+ * @param height The height the frames must have
+ *
+ * @return MAR_ERROR_NONE on success, MAR_ERROR_END_OF_STREAM if the stream holds no frame, an error code on failure
+ */
+MAR_PUBLIC
+mar_error_code mar_replay_camera_new_from_file(mar_replay_camera **cam, char *file_name, mar_camera_format format, int width, int height)
+{
+  mar_capture_log *log;
+  mar_error_code retval;
+
+  retval = mar_capture_log_open(&log, file_name);
+  if (retval != MAR_ERROR_NONE)
+  {
+    return retval;
+  }
+
+  retval = mar_replay_camera_new(cam, log, 0);
+  if (retval != MAR_ERROR_NONE)
+  {
+    mar_capture_log_free(log);
+    return retval;
+  }
+
+  // The frames were recorded with other settings
+  if ((*cam)->format != format)
+  {
+    mar_replay_camera_free(*cam);
+    mar_capture_log_free(log);
+    return MAR_ERROR_PIXEL_FORMAT_NOT_SUPPORTED;
+  }
+  if ((*cam)->width != width || (*cam)->height != height)
+  {
+    mar_replay_camera_free(*cam);
+    mar_capture_log_free(log);
+    return MAR_ERROR_INVALID_ARGUMENT;
+  }
+  (*cam)->owns_log = 1;
+
+  return MAR_ERROR_NONE;
+}
+
+/**
+ * Frees a camera created by the MAR library.
+ *
+ * @param camera The camera to free
+ *
+ * @return MAR_ERROR_NONE on success, an error code on failure
+ */
+MAR_PUBLIC
+mar_error_code mar_replay_camera_free(mar_replay_camera *camera)
+{
+  if (camera->owns_log)
+  {
+    mar_capture_log_free(camera->log);
+  }
+
+  free(camera->frame_buffer);
+  free(camera->gray_frame_buffer);
+  free(camera->grayf_frame_buffer);
+  free(camera);
+
+  return MAR_ERROR_NONE;
+}
+
+/**
+ * Starts camera capturing from the first frame of the stream
+ *
+ * @param camera The camera
+ *
+ * @return MAR_ERROR_NONE on success, an error code on failure
+ */
+MAR_PUBLIC
+mar_error_code mar_replay_camera_start(mar_replay_camera *camera)
+{
+  camera->next_frame = 0;
+
+  return MAR_ERROR_NONE;
+}
+
+/**
+ * Leases the next frame of the stream to the caller.  The frame points into the mapped log, so any number of
+ * frames may be held at once.
+ *
+ * @param camera The camera to capture from
+ * @param frame Will be filled with the leased frame
+ *
+ * @return MAR_ERROR_NONE on success, MAR_ERROR_END_OF_STREAM after the last frame, an error code on failure
+ */
+MAR_PUBLIC
+mar_error_code mar_replay_camera_acquire_frame(mar_replay_camera *camera, mar_camera_frame *frame)
+{
+  mar_error_code retval;
+
+  retval = mar_capture_log_get_frame(camera->log, camera->stream, camera->next_frame, frame);
+  if (retval != MAR_ERROR_NONE)
+  {
+    return retval;
+  }
+  frame->buffer_index = (int)camera->next_frame;
+  camera->next_frame++;
+
+  return MAR_ERROR_NONE;
+}
+
+/**
+ * Returns a leased frame to the camera.
+ *
+ * @param camera The camera the frame was acquired from
+ * @param frame The frame to release
+ *
+ * @return MAR_ERROR_NONE on success, an error code on failure
+ */
+MAR_PUBLIC
+mar_error_code mar_replay_camera_release_frame(mar_replay_camera *camera, mar_camera_frame *frame)
+{
+  if (frame->data == NULL || frame->buffer_index < 0 || (uint32_t)frame->buffer_index >= camera->log->num_frames[camera->stream])
+  {
+    return MAR_ERROR_CAMERA_FRAME_NOT_ACQUIRED;
+  }
+
+  frame->data = NULL;
+
+  return MAR_ERROR_NONE;
+}
+
+/**
+ * Updates the camera with the next frame of the stream.
+ *
+ * @param camera The camera to update
+ *
+ * @return MAR_ERROR_NONE on success, MAR_ERROR_END_OF_STREAM after the last frame, an error code on failure
+ */
+MAR_PUBLIC
+mar_error_code mar_replay_camera_update(mar_replay_camera *camera)
+{
+  mar_camera_frame frame;
+  mar_error_code retval;
+
+  retval = mar_replay_camera_acquire_frame(camera, &frame);
+  if (retval != MAR_ERROR_NONE)
+  {
+    return retval;
+  }
+
+  // The frame stays mapped with the log, so the frame buffers are converted from it when asked for
+  camera->update_frame = frame;
+  camera->update_converted = 0;
+
+  return mar_replay_camera_release_frame(camera, &frame);
+}
+
+/**
+ * Stops camera capturing
+ *
+ * @param camera The camera
+ *
+ * @return MAR_ERROR_NONE on success, an error code on failure
+ */
+MAR_PUBLIC
+mar_error_code mar_replay_camera_stop(mar_replay_camera *camera)
+{
+  return MAR_ERROR_NONE;
+}
+
+/**
+ * Returns the camera pixel format.
+ *
+ * @param camera The camera to get the pixel format from
+ *
+ * @return The camera pixel format.
+ */
+MAR_PUBLIC
+mar_camera_format mar_replay_camera_get_pixel_format(mar_replay_camera *camera)
+{
+  return camera->format;
+}
+
+/**
+ * Returns the camera resolution.
+ *
+ * @param camera The camera to get the resolution from
+ * @param width Will be filled with the resolution width.
+ * @param height Will be filled with the resolution height.
+ */
+MAR_PUBLIC
+void mar_replay_camera_get_resolution(mar_replay_camera *camera, int *width, int *height)
+{
+  *width = camera->width;
+  *height = camera->height;
+}
+
+/**
+ * Returns the camera's frame buffer in an RGB24 format.
+ * The frame buffer is 3 * width * height in size.
+ *
+ * @param camera The camera to get the frame buffer of.
+ *
+ * @return The camera buffer.
+ */
+MAR_PUBLIC
+unsigned char *mar_replay_camera_get_frame_buffer(mar_replay_camera *camera)
+{
+  // Convert the frame of the last update the first time it is asked for
+  if (camera->update_frame.data != NULL && !(camera->update_converted & MAR_CAM_CONVERTED_RGB))
+  {
+    mar_camera_frame_to_rgb(&camera->update_frame, camera->frame_buffer);
+    camera->update_converted |= MAR_CAM_CONVERTED_RGB;
+  }
+
+  return (unsigned char *)camera->frame_buffer;
+}
+
+/**
+ * Returns the camera's frame buffer as an 8-bit grayscale image taken from the luma channel.
+ * The frame buffer is width * height in size.
+ *
+ * @param camera The camera to get the frame buffer of.
+ *
+ * @return The camera grayscale buffer.
+ */
+MAR_PUBLIC
+unsigned char *mar_replay_camera_get_grayscale_frame_buffer(mar_replay_camera *camera)
+{
+  // Convert the frame of the last update the first time it is asked for
+  if (camera->update_frame.data != NULL && !(camera->update_converted & MAR_CAM_CONVERTED_GRAYSCALE))
+  {
+    mar_camera_frame_to_grayscale(&camera->update_frame, camera->gray_frame_buffer);
+    camera->update_converted |= MAR_CAM_CONVERTED_GRAYSCALE;
+  }
+
+  return (unsigned char *)camera->gray_frame_buffer;
+}
+
+/**
+ * Returns the camera's frame buffer as a floating point grayscale image normalized to [0-1] taken from the luma channel.
+ * The frame buffer is width * height floats in size.
+ *
+ * @param camera The camera to get the frame buffer of.
+ *
+ * @return The camera floating point grayscale buffer.
+ */
+MAR_PUBLIC
+float *mar_replay_camera_get_float_grayscale_frame_buffer(mar_replay_camera *camera)
+{
+  // Convert the frame of the last update the first time it is asked for
+  if (camera->update_frame.data != NULL && !(camera->update_converted & MAR_CAM_CONVERTED_FLOAT_GRAYSCALE))
+  {
+    mar_camera_frame_to_float_grayscale(&camera->update_frame, camera->grayf_frame_buffer);
+    camera->update_converted |= MAR_CAM_CONVERTED_FLOAT_GRAYSCALE;
+  }
+
+  return camera->grayf_frame_buffer;
+}
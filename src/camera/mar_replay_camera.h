@@ -0,0 +1,180 @@
+/**
+ * @file mar_replay_camera.h
+ *
+ * Contains camera interfacing code for the MAR library for replaying the frames of a capture log.  Each frame
+ * is served exactly as it was recorded, image data, timestamp and sequence number alike, so a replayed
+ * session computes the same results as the recorded one.  Frames are delivered as fast as they are acquired.
+ *
+ * @author Greg Eddington
+ */
+
+#ifndef MAR_REPLAY_CAMERA_H
+#define MAR_REPLAY_CAMERA_H
+
+#include "../common/mar_error.h"
+#include "mar_camera.h"
+#include "mar_capture_log.h"
+#include <stdint.h>
+
+/**
+ * A MAR camera instance replaying one stream of a capture log
+ */
+typedef struct
+{
+  /** The log being replayed @return Do not access directly when using the library **/
+  mar_capture_log *log;
+  /** Whether or not the camera opened the log and frees it @return Do not access directly when using the library **/
+  char owns_log;
+  /** The stream of the log being replayed @return Do not access directly when using the library **/
+  int stream;
+  /** The camera pixel format @return Do not access directly when using the library **/
+  mar_camera_format format;
+  /** The frame width @return Do not access directly when using the library **/
+  int width;
+  /** The frame height @return Do not access directly when using the library **/
+  int height;
+  /** The index of the next frame to acquire @return Do not access directly when using the library **/
+  uint32_t next_frame;
+  /** The camera frame buffer @return Do not access directly when using the library **/
+  uint8_t *frame_buffer;
+  /** The camera grayscale frame buffer @return Do not access directly when using the library **/
+  uint8_t *gray_frame_buffer;
+  /** The camera floating point grayscale frame buffer @return Do not access directly when using the library **/
+  float *grayf_frame_buffer;
+  /** The frame of the last update, kept until the next so the frame buffers are converted when asked for @return Do not access directly when using the library **/
+  mar_camera_frame update_frame;
+  /** The \ref camera_converted_buffers "frame buffers" converted from the frame of the last update @return Do not access directly when using the library **/
+  unsigned char update_converted;
+}
+mar_replay_camera;
+
+/**
+ * Creates a camera replaying one stream of an open capture log.  The log must outlive the camera.
+ *
+ * @param cam A pointer to a pointer which will be modified to point at a new camera
+ * @param log The log
+ * @param stream The stream to replay
+ *
+ * @return MAR_ERROR_NONE on success, MAR_ERROR_END_OF_STREAM if the stream holds no frame, an error code on failure
+ */
+mar_error_code mar_replay_camera_new(mar_replay_camera **cam, mar_capture_log *log, int stream);
+
+/**
+ * Opens a capture log as a camera replaying its first stream.
+ *
+ * @param cam A pointer to a pointer which will be modified to point at a new camera
+ * @param file_name The capture log
+ * @param format The pixel format the frames must have
+ * @param width The width the frames must have
+ * @param height The height the frames must have
+ *
+ * @return MAR_ERROR_NONE on success, MAR_ERROR_END_OF_STREAM if the stream holds no frame, an error code on failure
+ */
+mar_error_code mar_replay_camera_new_from_file(mar_replay_camera **cam, char *file_name, mar_camera_format format, int width, int height);
+
+/**
+ * Frees a camera created by the MAR library.
+ *
+ * @param camera The camera to free
+ *
+ * @return MAR_ERROR_NONE on success, an error code on failure
+ */
+mar_error_code mar_replay_camera_free(mar_replay_camera *camera);
+
+/**
+ * Starts camera capturing from the first frame of the stream
+ *
+ * @param camera The camera
+ *
+ * @return MAR_ERROR_NONE on success, an error code on failure
+ */
+mar_error_code mar_replay_camera_start(mar_replay_camera *camera);
+
+/**
+ * Updates the camera with the next frame of the stream.
+ *
+ * @param camera The camera to update
+ *
+ * @return MAR_ERROR_NONE on success, MAR_ERROR_END_OF_STREAM after the last frame, an error code on failure
+ */
+mar_error_code mar_replay_camera_update(mar_replay_camera *camera);
+
+/**
+ * Leases the next frame of the stream to the caller.  The frame points into the mapped log, so any number of
+ * frames may be held at once.
+ *
+ * @param camera The camera to capture from
+ * @param frame Will be filled with the leased frame
+ *
+ * @return MAR_ERROR_NONE on success, MAR_ERROR_END_OF_STREAM after the last frame, an error code on failure
+ */
+mar_error_code mar_replay_camera_acquire_frame(mar_replay_camera *camera, mar_camera_frame *frame);
+
+/**
+ * Returns a leased frame to the camera.
+ *
+ * @param camera The camera the frame was acquired from
+ * @param frame The frame to release
+ *
+ * @return MAR_ERROR_NONE on success, an error code on failure
+ */
+mar_error_code mar_replay_camera_release_frame(mar_replay_camera *camera, mar_camera_frame *frame);
+
+/**
+ * Stops camera capturing
+ *
+ * @param camera The camera
+ *
+ * @return MAR_ERROR_NONE on success, an error code on failure
+ */
+mar_error_code mar_replay_camera_stop(mar_replay_camera *camera);
+
+/**
+ * Returns the camera pixel format.
+ *
+ * @param camera The camera to get the pixel format from
+ *
+ * @return The camera pixel format.
+ */
+mar_camera_format mar_replay_camera_get_pixel_format(mar_replay_camera *camera);
+
+/**
+ * Returns the camera resolution.
+ *
+ * @param camera The camera to get the resolution from
+ * @param width Will be filled with the resolution width.
+ * @param height Will be filled with the resolution height.
+ */
+void mar_replay_camera_get_resolution(mar_replay_camera *camera, int *width, int *height);
+
+/**
+ * Returns the camera's frame buffer in an RGB24 format.
+ * The frame buffer is 3 * width * height in size.
+ *
+ * @param camera The camera to get the frame buffer of.
+ *
+ * @return The camera buffer.
+ */
+unsigned char *mar_replay_camera_get_frame_buffer(mar_replay_camera *camera);
+
+/**
+ * Returns the camera's frame buffer as an 8-bit grayscale image taken from the luma channel.
+ * The frame buffer is width * height in size.
+ *
+ * @param camera The camera to get the frame buffer of.
+ *
+ * @return The camera grayscale buffer.
+ */
+unsigned char *mar_replay_camera_get_grayscale_frame_buffer(mar_replay_camera *camera);
+
+/**
+ * Returns the camera's frame buffer as a floating point grayscale image normalized to [0-1] taken from the luma channel.
+ * The frame buffer is width * height floats in size.
+ *
+ * @param camera The camera to get the frame buffer of.
+ *
+ * @return The camera floating point grayscale buffer.
+ */
+float *mar_replay_camera_get_float_grayscale_frame_buffer(mar_replay_camera *camera);
+
+#endif
@@ -197,6 +197,10 @@ mar_error_code mar_v4l2_mmap_camera_new(mar_v4l2_mmap_camera **cam, char *dev_na
   camera->width           = width;
   camera->height          = height;
   camera->format = format;
+  MAR_CLEAR(camera->leased);
+  camera->num_leased = 0;
+  MAR_CLEAR(camera->update_frame);
+  camera->update_converted = 0;
 
   switch (format) 
   {    
@@ -234,8 +238,13 @@ mar_error_code mar_v4l2_mmap_camera_new(mar_v4l2_mmap_camera **cam, char *dev_na
 
   camera->frame_buffer_length = camera->width * camera->height * 3;
   camera->frame_buffer = malloc(camera->frame_buffer_length);
-  if (camera->frame_buffer == NULL)
+  camera->gray_frame_buffer = malloc(camera->width * camera->height);
+  camera->grayf_frame_buffer = malloc(camera->width * camera->height * sizeof(float));
+  if (camera->frame_buffer == NULL || camera->gray_frame_buffer == NULL || camera->grayf_frame_buffer == NULL)
   {
+    free(camera->frame_buffer);
+    free(camera->gray_frame_buffer);
+    free(camera->grayf_frame_buffer);
     close(camera->dev_fd);
     free(camera);
     return MAR_ERROR_MALLOC;
@@ -264,6 +273,8 @@ mar_error_code mar_v4l2_mmap_camera_free(mar_v4l2_mmap_camera *camera)
   }
 
   free(camera->frame_buffer);
+  free(camera->gray_frame_buffer);
+  free(camera->grayf_frame_buffer);
   free(camera);
 
   return retval;
@@ -306,90 +317,28 @@ mar_error_code mar_v4l2_mmap_camera_start(mar_v4l2_mmap_camera *camera)
 }
 
 /**
- * Converts a YUV color value to RGB.
- *
- * @param y The Y color component
- * @param u The U color component
- * @param v The V color component
- * @param r The red color component
- * @param g The green color component
- * @param b The blue color component
- */
-MAR_PRIVATE
-void mar_v4l2_mmap_camera_yuv_to_rgb(unsigned char y, unsigned char u, unsigned char v,
-      unsigned char* r, unsigned char* g, unsigned char* b)
-{
-  int amp = 255;
-  double R, G, B;
-  
-  // Convert YUV to RGB
-  R = amp * (0.004565 * y + 0.000001 * u + 0.006250 * v - 0.872);
-  G = amp * (0.004565 * y - 0.001542 * u - 0.003183 * v + 0.531);
-  B = amp * (0.004565 * y + 0.007935 * u - 1.088);
-
-  // Clamp RGB between 0 and 255  
-  if (R < 0) R = 0;
-  if (G < 0) G = 0;
-  if (B < 0) B = 0;
-  
-  if (R > 255) R = 255;
-  if (G > 255) G = 255;
-  if (B > 255) B = 255;
-
-  *r = (unsigned char)(R);
-  *g = (unsigned char)(G);
-  *b = (unsigned char)(B);
-}
-
-/** 
- * Updates the camera frame buffer from the camera's value buffer.
- *
- * @param camera The camera
- * @param mmap_buffer_index The index of the current mmap buffer
- */
-MAR_PRIVATE
-void mar_v4l2_mmap_camera_yuyv_fill_frame(mar_v4l2_mmap_camera *camera, int mmap_buffer_index)
-{
-  int i;
-  uint8_t y1, y2, u, v, r, g, b;
-  int frame_index = 0;
-
-  for (i = 0; i < camera->mmap_buffer_length; i += 4)
-  {
-    y1 = camera->mmap_buffers[mmap_buffer_index][i + 0];
-    u  = camera->mmap_buffers[mmap_buffer_index][i + 1];
-    y2 = camera->mmap_buffers[mmap_buffer_index][i + 2];
-    v  = camera->mmap_buffers[mmap_buffer_index][i + 3];
-
-    mar_v4l2_mmap_camera_yuv_to_rgb(y1, u, v, &r, &g, &b);
-    camera->frame_buffer[frame_index + 0] = r;
-    camera->frame_buffer[frame_index + 1] = g;
-    camera->frame_buffer[frame_index + 2] = b;
-
-    mar_v4l2_mmap_camera_yuv_to_rgb(y2, u, v, &r, &g, &b);
-    camera->frame_buffer[frame_index + 3] = r;
-    camera->frame_buffer[frame_index + 4] = g;
-    camera->frame_buffer[frame_index + 5] = b;
-
-    frame_index += 6;
-  }
-}
-
-/**
- * Updates the camera and captuers a new frame.
+ * Captures a new frame and leases the driver's mmap buffer to the caller.  The buffer is only
+ * queued back to the driver when the frame is released.
  * 
- * @param camera The camera to update
+ * @param camera The camera to capture from
+ * @param frame Will be filled with the leased frame
  *
  * @return MAR_ERROR_NONE on success, an error code on failure
  */
 MAR_PUBLIC
-mar_error_code mar_v4l2_mmap_camera_update(mar_v4l2_mmap_camera *camera)
+mar_error_code mar_v4l2_mmap_camera_acquire_frame(mar_v4l2_mmap_camera *camera, mar_camera_frame *frame)
 {
   fd_set fds;
   struct timeval tv;
   int r;
   struct v4l2_buffer buf;
 
+  /* Always leave the driver a buffer to fill */
+  if (camera->num_leased >= camera->num_mmap_buffers - 1)
+  {
+    return MAR_ERROR_CAMERA_FRAMES_EXHAUSTED;
+  }
+
   /* Select files */
   FD_ZERO (&fds);
   FD_SET (camera->dev_fd, &fds);
@@ -434,15 +383,50 @@ mar_error_code mar_v4l2_mmap_camera_update(mar_v4l2_mmap_camera *camera)
       
   assert (buf.index < camera->num_mmap_buffers);
 
-  /* Calculate bytes per frame */
-  switch (camera->format) 
-  {  
-    case MAR_CAM_FMT_YUYV:
-      mar_v4l2_mmap_camera_yuyv_fill_frame(camera, buf.index);
-      break;
+  /* Lease the buffer */
+  camera->leased[buf.index] = 1;
+  camera->num_leased++;
+
+  frame->data = camera->mmap_buffers[buf.index];
+  frame->length = buf.bytesused != 0 && buf.bytesused < camera->mmap_buffer_length ? buf.bytesused : camera->mmap_buffer_length;
+  frame->format = camera->format;
+  frame->width = camera->width;
+  frame->height = camera->height;
+  frame->timestamp = (uint64_t)buf.timestamp.tv_sec * 1000000 + buf.timestamp.tv_usec;
+  frame->sequence = buf.sequence;
+  frame->buffer_index = buf.index;
+
+  return MAR_ERROR_NONE;
+}
+
+/**
+ * Queues the mmap buffer of a leased frame back to the driver.
+ * 
+ * @param camera The camera the frame was acquired from
+ * @param frame The frame to release
+ *
+ * @return MAR_ERROR_NONE on success, an error code on failure
+ */
+MAR_PUBLIC
+mar_error_code mar_v4l2_mmap_camera_release_frame(mar_v4l2_mmap_camera *camera, mar_camera_frame *frame)
+{
+  struct v4l2_buffer buf;
+
+  if (frame->buffer_index < 0 || frame->buffer_index >= camera->num_mmap_buffers || !camera->leased[frame->buffer_index])
+  {
+    return MAR_ERROR_CAMERA_FRAME_NOT_ACQUIRED;
   }
 
+  camera->leased[frame->buffer_index] = 0;
+  camera->num_leased--;
+  frame->data = NULL;
+
   /* Get buffer ready */
+  MAR_CLEAR(buf);
+  buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+  buf.memory = V4L2_MEMORY_MMAP;
+  buf.index = frame->buffer_index;
+
   if (mar_block_ioctl(camera->dev_fd, (int)VIDIOC_QBUF, &buf) == -1)
   {
     return MAR_ERROR_NO_BUFFER_QUEUED;
@@ -451,6 +435,34 @@ mar_error_code mar_v4l2_mmap_camera_update(mar_v4l2_mmap_camera *camera)
   return MAR_ERROR_NONE;
 }
 
+/**
+ * Updates the camera and captuers a new frame.  The frame stays leased until the next update, and each frame
+ * buffer is only converted from it when it is first asked for.
+ * 
+ * @param camera The camera to update
+ *
+ * @return MAR_ERROR_NONE on success, an error code on failure
+ */
+MAR_PUBLIC
+mar_error_code mar_v4l2_mmap_camera_update(mar_v4l2_mmap_camera *camera)
+{
+  mar_error_code retval;
+
+  /* Return the frame of the last update to the driver */
+  if (camera->update_frame.data != NULL)
+  {
+    retval = mar_v4l2_mmap_camera_release_frame(camera, &camera->update_frame);
+    if (retval != MAR_ERROR_NONE)
+    {
+      return retval;
+    }
+  }
+
+  /* Keep the new frame leased until the next update, the frame buffers are converted from it when asked for */
+  camera->update_converted = 0;
+  return mar_v4l2_mmap_camera_acquire_frame(camera, &camera->update_frame);
+}
+
 /**
  * Stops camera capturing
  *
@@ -469,6 +481,11 @@ mar_error_code mar_v4l2_mmap_camera_stop(mar_v4l2_mmap_camera *camera)
     return MAR_ERROR_STREAM_NOT_OFF;
   }
 
+  /* Stopping the stream takes every buffer back from the driver, ending all leases */
+  MAR_CLEAR(camera->leased);
+  camera->num_leased = 0;
+  camera->update_frame.data = NULL;
+
   return MAR_ERROR_NONE;
 }
 
@@ -509,6 +526,52 @@ void mar_v4l2_mmap_camera_get_resolution(mar_v4l2_mmap_camera *camera, int *widt
  */
 unsigned char *mar_v4l2_mmap_camera_get_frame_buffer(mar_v4l2_mmap_camera *camera)
 {
+  // Convert the frame of the last update the first time it is asked for
+  if (camera->update_frame.data != NULL && !(camera->update_converted & MAR_CAM_CONVERTED_RGB))
+  {
+    mar_camera_frame_to_rgb(&camera->update_frame, camera->frame_buffer);
+    camera->update_converted |= MAR_CAM_CONVERTED_RGB;
+  }
+
   return (unsigned char *)camera->frame_buffer;
 }
 
+/**
+ * Returns the camera's frame buffer as an 8-bit grayscale image taken from the luma channel.
+ * The frame buffer is width * height in size.
+ *
+ * @param camera The camera to get the frame buffer of.
+ * 
+ * @return The camera grayscale buffer.
+ */
+unsigned char *mar_v4l2_mmap_camera_get_grayscale_frame_buffer(mar_v4l2_mmap_camera *camera)
+{
+  // Convert the frame of the last update the first time it is asked for
+  if (camera->update_frame.data != NULL && !(camera->update_converted & MAR_CAM_CONVERTED_GRAYSCALE))
+  {
+    mar_camera_frame_to_grayscale(&camera->update_frame, camera->gray_frame_buffer);
+    camera->update_converted |= MAR_CAM_CONVERTED_GRAYSCALE;
+  }
+
+  return (unsigned char *)camera->gray_frame_buffer;
+}
+
+/**
+ * Returns the camera's frame buffer as a floating point grayscale image normalized to [0-1] taken from the luma channel.
+ * The frame buffer is width * height floats in size.
+ *
+ * @param camera The camera to get the frame buffer of.
+ * 
+ * @return The camera floating point grayscale buffer.
+ */
+float *mar_v4l2_mmap_camera_get_float_grayscale_frame_buffer(mar_v4l2_mmap_camera *camera)
+{
+  // Convert the frame of the last update the first time it is asked for
+  if (camera->update_frame.data != NULL && !(camera->update_converted & MAR_CAM_CONVERTED_FLOAT_GRAYSCALE))
+  {
+    mar_camera_frame_to_float_grayscale(&camera->update_frame, camera->grayf_frame_buffer);
+    camera->update_converted |= MAR_CAM_CONVERTED_FLOAT_GRAYSCALE;
+  }
+
+  return camera->grayf_frame_buffer;
+}
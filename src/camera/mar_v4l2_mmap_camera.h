@@ -43,6 +43,18 @@ typedef struct
   uint8_t *frame_buffer;       
   /** The camera mmap buffer length @return Do not access directly when using the library **/ 
   size_t frame_buffer_length;
+  /** The camera grayscale frame buffer @return Do not access directly when using the library **/ 
+  uint8_t *gray_frame_buffer;
+  /** The camera floating point grayscale frame buffer @return Do not access directly when using the library **/ 
+  float *grayf_frame_buffer;
+  /** The frame of the last update, kept until the next so the frame buffers are converted when asked for @return Do not access directly when using the library **/ 
+  mar_camera_frame update_frame;
+  /** The \ref camera_converted_buffers "frame buffers" converted from the frame of the last update @return Do not access directly when using the library **/ 
+  unsigned char update_converted;
+  /** Whether or not each mmap buffer is leased from the driver @return Do not access directly when using the library **/ 
+  char leased[MAR_V4L2_MMAP_CAMERA_MAX_MMAP_BUFFER_NUMBER];
+  /** The number of leased mmap buffers @return Do not access directly when using the library **/ 
+  int num_leased;
 } 
 mar_v4l2_mmap_camera;
 
@@ -78,7 +90,8 @@ mar_error_code mar_v4l2_mmap_camera_free(mar_v4l2_mmap_camera *camera);
 mar_error_code mar_v4l2_mmap_camera_start(mar_v4l2_mmap_camera *camera);
 
 /**
- * Updates the camera and captuers a new frame.
+ * Updates the camera and captuers a new frame.  The frame stays leased until the next update, and each frame
+ * buffer is only converted from it when it is first asked for.
  * 
  * @param camera The camera to update
  *
@@ -86,6 +99,27 @@ mar_error_code mar_v4l2_mmap_camera_start(mar_v4l2_mmap_camera *camera);
  */
 mar_error_code mar_v4l2_mmap_camera_update(mar_v4l2_mmap_camera *camera);
 
+/**
+ * Captures a new frame and leases the driver's mmap buffer to the caller.  The buffer is only
+ * queued back to the driver when the frame is released.
+ * 
+ * @param camera The camera to capture from
+ * @param frame Will be filled with the leased frame
+ *
+ * @return MAR_ERROR_NONE on success, an error code on failure
+ */
+mar_error_code mar_v4l2_mmap_camera_acquire_frame(mar_v4l2_mmap_camera *camera, mar_camera_frame *frame);
+
+/**
+ * Queues the mmap buffer of a leased frame back to the driver.
+ * 
+ * @param camera The camera the frame was acquired from
+ * @param frame The frame to release
+ *
+ * @return MAR_ERROR_NONE on success, an error code on failure
+ */
+mar_error_code mar_v4l2_mmap_camera_release_frame(mar_v4l2_mmap_camera *camera, mar_camera_frame *frame);
+
 /**
  * Stops camera capturing
  *
@@ -123,4 +157,24 @@ void mar_v4l2_mmap_camera_get_resolution(mar_v4l2_mmap_camera *camera, int *widt
  */
 unsigned char *mar_v4l2_mmap_camera_get_frame_buffer(mar_v4l2_mmap_camera *camera);
 
+/**
+ * Returns the camera's frame buffer as an 8-bit grayscale image taken from the luma channel.
+ * The frame buffer is width * height in size.
+ *
+ * @param camera The camera to get the frame buffer of.
+ * 
+ * @return The camera grayscale buffer.
+ */
+unsigned char *mar_v4l2_mmap_camera_get_grayscale_frame_buffer(mar_v4l2_mmap_camera *camera);
+
+/**
+ * Returns the camera's frame buffer as a floating point grayscale image normalized to [0-1] taken from the luma channel.
+ * The frame buffer is width * height floats in size.
+ *
+ * @param camera The camera to get the frame buffer of.
+ * 
+ * @return The camera floating point grayscale buffer.
+ */
+float *mar_v4l2_mmap_camera_get_float_grayscale_frame_buffer(mar_v4l2_mmap_camera *camera);
+
 #endif
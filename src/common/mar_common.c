@@ -10,6 +10,22 @@
 
 #include <sys/ioctl.h>
 #include <errno.h>
+#include <stdlib.h>
+
+/** The header of a heap allocation made once an arena was full */
+typedef struct mar_arena_overflow
+{
+  /** The next heap allocation */
+  struct mar_arena_overflow *next;
+  /** Pads the allocated memory to MAR_ARENA_ALIGNMENT */
+  unsigned char padding[MAR_ARENA_ALIGNMENT - sizeof(void *)];
+}
+mar_arena_overflow;
+
+#ifdef MAR_DEBUG_ALLOCATIONS
+/** The number of heap allocations made through mar_malloc, mar_calloc and mar_realloc @return */
+MAR_PRIVATE unsigned long mar_heap_allocations = 0;
+#endif
 
 /** 
  * Blocks until the ioctl function finishes 
@@ -29,3 +45,206 @@ int mar_block_ioctl(int fd, int request, void *arg)
 
   return r;
 }
+
+/**
+ * Creates an arena.
+ *
+ * @param arena The arena to create
+ * @param size The initial size of the arena in bytes
+ *
+ * @return MAR_ERROR_NONE on success, an error code on failure
+ */
+MAR_PUBLIC
+mar_error_code mar_arena_new(mar_arena *arena, size_t size)
+{
+  MAR_CLEAR(*arena);
+
+  size = (size + MAR_ARENA_ALIGNMENT - 1) & ~(size_t)(MAR_ARENA_ALIGNMENT - 1);
+  if (size > 0)
+  {
+    arena->base = (unsigned char *)mar_malloc(size);
+    if (arena->base == NULL)
+    {
+      return MAR_ERROR_MALLOC;
+    }
+  }
+  arena->size = size;
+
+  return MAR_ERROR_NONE;
+}
+
+/**
+ * Frees the heap allocations made once an arena was full.
+ *
+ * @param arena The arena
+ */
+MAR_PRIVATE
+void mar_arena_free_overflow(mar_arena *arena)
+{
+  mar_arena_overflow *overflow, *next;
+
+  for (overflow = (mar_arena_overflow *)arena->overflow; overflow != NULL; overflow = next)
+  {
+    next = overflow->next;
+    mar_free(overflow);
+  }
+  arena->overflow = NULL;
+}
+
+/**
+ * Frees an arena and everything allocated from it.
+ *
+ * @param arena The arena to free
+ */
+MAR_PUBLIC
+void mar_arena_free(mar_arena *arena)
+{
+  mar_arena_free_overflow(arena);
+  mar_free(arena->base);
+  MAR_CLEAR(*arena);
+}
+
+/**
+ * Allocates memory from an arena, aligned to MAR_ARENA_ALIGNMENT.  May be called from several threads at once.
+ *
+ * @param arena The arena
+ * @param size The number of bytes to allocate
+ *
+ * @return The memory, which lives until the arena is reset, or NULL if the arena was full and the heap allocation failed
+ */
+MAR_PUBLIC
+void *mar_arena_alloc(mar_arena *arena, size_t size)
+{
+  size_t offset;
+  mar_arena_overflow *overflow;
+
+  size = (size + MAR_ARENA_ALIGNMENT - 1) & ~(size_t)(MAR_ARENA_ALIGNMENT - 1);
+  offset = __atomic_fetch_add(&arena->used, size, __ATOMIC_RELAXED);
+  if (offset + size <= arena->size)
+  {
+    return arena->base + offset;
+  }
+
+  // The arena is full, so allocate from the heap and remember the allocation until the next reset
+  overflow = (mar_arena_overflow *)mar_malloc(sizeof(mar_arena_overflow) + size);
+  if (overflow == NULL)
+  {
+    return NULL;
+  }
+  overflow->next = (mar_arena_overflow *)__atomic_load_n(&arena->overflow, __ATOMIC_RELAXED);
+  while (!__atomic_compare_exchange_n(&arena->overflow, (void **)&overflow->next, overflow, 1, __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+
+  return overflow + 1;
+}
+
+/**
+ * Frees everything allocated from an arena since the last reset.  If the arena overflowed it is grown to hold
+ * everything that was allocated.  Must not be called while memory is being allocated from the arena.
+ *
+ * @param arena The arena
+ *
+ * @return MAR_ERROR_NONE on success, MAR_ERROR_MALLOC if the arena could not be grown, in which case it keeps its size
+ */
+MAR_PUBLIC
+mar_error_code mar_arena_reset(mar_arena *arena)
+{
+  unsigned char *base;
+  mar_error_code mrv = MAR_ERROR_NONE;
+
+  if (arena->overflow != NULL)
+  {
+    mar_arena_free_overflow(arena);
+
+    // Nothing in the arena is live, so its memory is replaced instead of copied
+    base = (unsigned char *)mar_malloc(arena->used);
+    if (base != NULL)
+    {
+      mar_free(arena->base);
+      arena->base = base;
+      arena->size = arena->used;
+    }
+    else
+    {
+      mrv = MAR_ERROR_MALLOC;
+    }
+  }
+  arena->used = 0;
+
+  return mrv;
+}
+
+/**
+ * Allocates memory from the heap, counting the allocation when built with MAR_DEBUG_ALLOCATIONS.
+ *
+ * @param size The number of bytes to allocate
+ *
+ * @return The memory, or NULL on failure
+ */
+MAR_PUBLIC
+void *mar_malloc(size_t size)
+{
+#ifdef MAR_DEBUG_ALLOCATIONS
+  __atomic_add_fetch(&mar_heap_allocations, 1, __ATOMIC_RELAXED);
+#endif
+  return malloc(size);
+}
+
+/**
+ * Allocates zeroed memory from the heap, counting the allocation when built with MAR_DEBUG_ALLOCATIONS.
+ *
+ * @param count The number of elements
+ * @param size The size of each element
+ *
+ * @return The memory, or NULL on failure
+ */
+MAR_PUBLIC
+void *mar_calloc(size_t count, size_t size)
+{
+#ifdef MAR_DEBUG_ALLOCATIONS
+  __atomic_add_fetch(&mar_heap_allocations, 1, __ATOMIC_RELAXED);
+#endif
+  return calloc(count, size);
+}
+
+/**
+ * Resizes memory allocated from the heap, counting the allocation when built with MAR_DEBUG_ALLOCATIONS.
+ *
+ * @param memory The memory to resize, or NULL
+ * @param size The new number of bytes
+ *
+ * @return The memory, or NULL on failure in which case the original memory is unchanged
+ */
+MAR_PUBLIC
+void *mar_realloc(void *memory, size_t size)
+{
+#ifdef MAR_DEBUG_ALLOCATIONS
+  __atomic_add_fetch(&mar_heap_allocations, 1, __ATOMIC_RELAXED);
+#endif
+  return realloc(memory, size);
+}
+
+/**
+ * Frees memory allocated from the heap.
+ *
+ * @param memory The memory to free, or NULL
+ */
+MAR_PUBLIC
+void mar_free(void *memory)
+{
+  free(memory);
+}
+
+/**
+ * Gets the number of heap allocations made through mar_malloc, mar_calloc and mar_realloc.
+ *
+ * @return The number of allocations, always 0 unless built with MAR_DEBUG_ALLOCATIONS
+ */
+MAR_PUBLIC
+unsigned long mar_get_heap_allocations()
+{
+#ifdef MAR_DEBUG_ALLOCATIONS
+  return __atomic_load_n(&mar_heap_allocations, __ATOMIC_RELAXED);
+#else
+  return 0;
+#endif
+}
@@ -9,6 +9,9 @@
 #ifndef MAR_COMMON_H
 #define MAR_COMMON_H
 
+#include "mar_error.h"
+
+#include <stddef.h>
 #include <string.h>
 
 /** Sets a variable or all fields of a structure to zero */
@@ -35,4 +38,105 @@
  */
 int mar_block_ioctl(int fd, int request, void *arg);
 
+/** The alignment in bytes of every allocation from an arena */
+#define MAR_ARENA_ALIGNMENT 16
+
+/**
+ * A bump allocator for memory which lives until the arena is reset, such as the scratch memory of a frame.
+ * Allocations past the end of the arena fall back to the heap, and the next reset grows the arena to the
+ * total used so that once the loop reaches a steady state no allocation touches the heap.
+ */
+typedef struct
+{
+  /** The memory of the arena @return Do not access directly when using the library */
+  unsigned char *base;
+  /** The size of the memory of the arena @return Read-Only */
+  size_t size;
+  /** The number of bytes allocated since the last reset, including bytes allocated from the heap @return Read-Only */
+  size_t used;
+  /** The list of heap allocations made since the last reset once the arena was full @return Do not access directly when using the library */
+  void *overflow;
+}
+mar_arena;
+
+/**
+ * Creates an arena.
+ *
+ * @param arena The arena to create
+ * @param size The initial size of the arena in bytes
+ *
+ * @return MAR_ERROR_NONE on success, an error code on failure
+ */
+mar_error_code mar_arena_new(mar_arena *arena, size_t size);
+
+/**
+ * Frees an arena and everything allocated from it.
+ *
+ * @param arena The arena to free
+ */
+void mar_arena_free(mar_arena *arena);
+
+/**
+ * Allocates memory from an arena, aligned to MAR_ARENA_ALIGNMENT.  May be called from several threads at once.
+ *
+ * @param arena The arena
+ * @param size The number of bytes to allocate
+ *
+ * @return The memory, which lives until the arena is reset, or NULL if the arena was full and the heap allocation failed
+ */
+void *mar_arena_alloc(mar_arena *arena, size_t size);
+
+/**
+ * Frees everything allocated from an arena since the last reset.  If the arena overflowed it is grown to hold
+ * everything that was allocated.  Must not be called while memory is being allocated from the arena.
+ *
+ * @param arena The arena
+ *
+ * @return MAR_ERROR_NONE on success, MAR_ERROR_MALLOC if the arena could not be grown, in which case it keeps its size
+ */
+mar_error_code mar_arena_reset(mar_arena *arena);
+
+/**
+ * Allocates memory from the heap, counting the allocation when built with MAR_DEBUG_ALLOCATIONS.
+ *
+ * @param size The number of bytes to allocate
+ *
+ * @return The memory, or NULL on failure
+ */
+void *mar_malloc(size_t size);
+
+/**
+ * Allocates zeroed memory from the heap, counting the allocation when built with MAR_DEBUG_ALLOCATIONS.
+ *
+ * @param count The number of elements
+ * @param size The size of each element
+ *
+ * @return The memory, or NULL on failure
+ */
+void *mar_calloc(size_t count, size_t size);
+
+/**
+ * Resizes memory allocated from the heap, counting the allocation when built with MAR_DEBUG_ALLOCATIONS.
+ *
+ * @param memory The memory to resize, or NULL
+ * @param size The new number of bytes
+ *
+ * @return The memory, or NULL on failure in which case the original memory is unchanged
+ */
+void *mar_realloc(void *memory, size_t size);
+
+/**
+ * Frees memory allocated from the heap.
+ *
+ * @param memory The memory to free, or NULL
+ */
+void mar_free(void *memory);
+
+/**
+ * Gets the number of heap allocations made through mar_malloc, mar_calloc and mar_realloc.
+ *
+ * @return The number of allocations, always 0 unless built with MAR_DEBUG_ALLOCATIONS
+ */
+unsigned long mar_get_heap_allocations();
+
 #endif
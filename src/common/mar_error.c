@@ -88,6 +88,30 @@ char *error_to_string_map[MAR_NUMBER_OF_ERRORS] =
 // #define MAR_ERROR_NO_AUGMENTATION_RESOURCES_AVAILABLE   33
   "augmentation ID does not exist",
 // #define MAR_ERROR_AUGMENTATION_ID_DOES_NOT_EXIST        34
+  "every camera frame buffer is leased",
+// #define MAR_ERROR_CAMERA_FRAMES_EXHAUSTED               35
+  "camera frame was not acquired",
+// #define MAR_ERROR_CAMERA_FRAME_NOT_ACQUIRED             36
+  "could not create thread",
+// #define MAR_ERROR_THREAD                                37
+  "camera is capturing asynchronously",
+// #define MAR_ERROR_CAMERA_CAPTURING_ASYNCHRONOUSLY       38
+  "invalid argument",
+// #define MAR_ERROR_INVALID_ARGUMENT                      39
+  "transformation is degenerate",
+// #define MAR_ERROR_DEGENERATE_TRANSFORM                  40
+  "no more frames in the camera stream",
+// #define MAR_ERROR_END_OF_STREAM                         41
+  "error writing capture log",
+// #define MAR_ERROR_WRITING_CAPTURE_LOG                   42
+  "error reading capture log",
+// #define MAR_ERROR_READING_CAPTURE_LOG                   43
+  "error writing model cache",
+// #define MAR_ERROR_WRITING_MODEL_CACHE                   44
+  "error reading model cache",
+// #define MAR_ERROR_READING_MODEL_CACHE                   45
+  "model cache does not exist",
+// #define MAR_ERROR_MODEL_CACHE_NOT_FOUND                 46
 };
 
 /**
@@ -0,0 +1,743 @@
+/**
+ * @file mar_image.c
+ *
+ * Contains image conversion kernels used across various components of the MAR library.
+ * The YUYV kernels are vectorized with SSE2, AVX2 or NEON when available, and the fastest
+ * kernel supported by the CPU is selected at runtime.  The grayscale kernels are simple
+ * enough to be left to the compiler's vectorizer.
+ *
+ * @author Greg Eddington
+ */
+
+#include "mar_image.h"
+#include "mar_common.h"
+
+#include <stddef.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+  #define MAR_IMAGE_X86
+  #include <immintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+  #define MAR_IMAGE_NEON
+  #include <arm_neon.h>
+#endif
+
+/** \defgroup image_yuv_coefficients YUV to RGB Coefficients
+ *  The coefficients are the scaled form of the original conversion, R = 255 * (0.004565 * Y + 0.000001 * U + 0.006250 * V - 0.872).
+ *  @{
+ */
+/** The Y coefficient shared by all channels */
+#define MAR_IMAGE_Y_COEF   1.164075f
+/** The U coefficient of the red channel */
+#define MAR_IMAGE_R_U_COEF 0.000255f
+/** The V coefficient of the red channel */
+#define MAR_IMAGE_R_V_COEF 1.59375f
+/** The constant of the red channel */
+#define MAR_IMAGE_R_CONST  -222.36f
+/** The U coefficient of the green channel */
+#define MAR_IMAGE_G_U_COEF -0.39321f
+/** The V coefficient of the green channel */
+#define MAR_IMAGE_G_V_COEF -0.811665f
+/** The constant of the green channel */
+#define MAR_IMAGE_G_CONST  135.405f
+/** The U coefficient of the blue channel */
+#define MAR_IMAGE_B_U_COEF 2.023425f
+/** The constant of the blue channel */
+#define MAR_IMAGE_B_CONST  -277.44f
+/** @} */
+
+/** The black level of the studio swing Y channel */
+#define MAR_IMAGE_Y_BLACK 16
+/** The fractional part of the 255/219 luma expansion in 8.8 fixed point, gray = t + ((t * 42) >> 8) */
+#define MAR_IMAGE_Y_EXPAND_FRAC 42
+
+/**
+ * A set of image conversion kernels for one instruction set
+ */
+typedef struct
+{
+  /** The instruction set name */
+  const char *name;
+  /** Converts YUYV to RGB24 */
+  void (*yuyv_to_rgb)(const unsigned char *yuyv, unsigned char *rgb, int num_pixels);
+  /** Extracts 8-bit luma from YUYV */
+  void (*yuyv_to_gray)(const unsigned char *yuyv, unsigned char *gray, int num_pixels);
+  /** Extracts normalized floating point luma from YUYV */
+  void (*yuyv_to_grayf)(const unsigned char *yuyv, float *gray, int num_pixels);
+}
+mar_image_kernels;
+
+/** The image kernels selected for the running CPU @return */
+MAR_PRIVATE const mar_image_kernels *mar_image_selected_kernels = NULL;
+
+/**
+ * Clamps a converted color channel to [0-255], truncating the fractional part.
+ *
+ * @param c The color channel value
+ *
+ * @return The clamped color channel value
+ */
+MAR_PRIVATE
+unsigned char mar_image_clamp(float c)
+{
+  if (c < 0) return 0;
+  if (c > 255) return 255;
+  return (unsigned char)c;
+}
+
+/**
+ * Converts a range of YUYV macropixels to RGB24 without vectorization.
+ *
+ * @param yuyv The YUYV source image
+ * @param rgb The RGB24 destination image
+ * @param first The first pixel to convert, must be even
+ * @param num_pixels The number of pixels in the image
+ */
+MAR_PRIVATE
+void mar_image_yuyv_to_rgb_range(const unsigned char *yuyv, unsigned char *rgb, int first, int num_pixels)
+{
+  int i, j;
+  float y, u, v;
+
+  for (i = first; i + 1 < num_pixels; i += 2)
+  {
+    u = yuyv[i*2 + 1];
+    v = yuyv[i*2 + 3];
+
+    for (j = 0; j < 2; j++)
+    {
+      y = yuyv[i*2 + j*2];
+      rgb[(i+j)*3 + 0] = mar_image_clamp(y * MAR_IMAGE_Y_COEF + u * MAR_IMAGE_R_U_COEF + v * MAR_IMAGE_R_V_COEF + MAR_IMAGE_R_CONST);
+      rgb[(i+j)*3 + 1] = mar_image_clamp(y * MAR_IMAGE_Y_COEF + u * MAR_IMAGE_G_U_COEF + v * MAR_IMAGE_G_V_COEF + MAR_IMAGE_G_CONST);
+      rgb[(i+j)*3 + 2] = mar_image_clamp(y * MAR_IMAGE_Y_COEF + u * MAR_IMAGE_B_U_COEF + MAR_IMAGE_B_CONST);
+    }
+  }
+}
+
+/**
+ * Expands a studio swing Y value to an 8-bit full range luma value.
+ *
+ * @param y The Y value
+ *
+ * @return The luma value
+ */
+MAR_PRIVATE
+unsigned char mar_image_expand_luma(unsigned char y)
+{
+  int t = y > MAR_IMAGE_Y_BLACK ? y - MAR_IMAGE_Y_BLACK : 0;
+
+  t += (t * MAR_IMAGE_Y_EXPAND_FRAC) >> 8;
+
+  return t > 255 ? 255 : (unsigned char)t;
+}
+
+/**
+ * Extracts a range of 8-bit luma values from YUYV without vectorization.
+ *
+ * @param yuyv The YUYV source image
+ * @param gray The grayscale destination image
+ * @param first The first pixel to convert
+ * @param num_pixels The number of pixels in the image
+ */
+MAR_PRIVATE
+void mar_image_yuyv_to_gray_range(const unsigned char *yuyv, unsigned char *gray, int first, int num_pixels)
+{
+  int i;
+
+  for (i = first; i < num_pixels; i++)
+  {
+    gray[i] = mar_image_expand_luma(yuyv[i*2]);
+  }
+}
+
+/**
+ * Extracts a range of normalized floating point luma values from YUYV without vectorization.
+ *
+ * @param yuyv The YUYV source image
+ * @param gray The grayscale destination image
+ * @param first The first pixel to convert
+ * @param num_pixels The number of pixels in the image
+ */
+MAR_PRIVATE
+void mar_image_yuyv_to_grayf_range(const unsigned char *yuyv, float *gray, int first, int num_pixels)
+{
+  int i;
+
+  for (i = first; i < num_pixels; i++)
+  {
+    gray[i] = mar_image_expand_luma(yuyv[i*2]) * (1.0f / 255.0f);
+  }
+}
+
+/** Scalar YUYV to RGB24 kernel */
+MAR_PRIVATE
+void mar_image_yuyv_to_rgb_scalar(const unsigned char *yuyv, unsigned char *rgb, int num_pixels)
+{
+  mar_image_yuyv_to_rgb_range(yuyv, rgb, 0, num_pixels);
+}
+
+/** Scalar YUYV to 8-bit luma kernel */
+MAR_PRIVATE
+void mar_image_yuyv_to_gray_scalar(const unsigned char *yuyv, unsigned char *gray, int num_pixels)
+{
+  mar_image_yuyv_to_gray_range(yuyv, gray, 0, num_pixels);
+}
+
+/** Scalar YUYV to floating point luma kernel */
+MAR_PRIVATE
+void mar_image_yuyv_to_grayf_scalar(const unsigned char *yuyv, float *gray, int num_pixels)
+{
+  mar_image_yuyv_to_grayf_range(yuyv, gray, 0, num_pixels);
+}
+
+/** The scalar image kernels @return */
+MAR_PRIVATE const mar_image_kernels mar_image_scalar_kernels =
+{
+  "scalar",
+  mar_image_yuyv_to_rgb_scalar,
+  mar_image_yuyv_to_gray_scalar,
+  mar_image_yuyv_to_grayf_scalar
+};
+
+#ifdef MAR_IMAGE_X86
+
+/**
+ * Interleaves 8 pixels of planar channels into RGB24.
+ *
+ * @param rgb The RGB24 destination, 24 bytes in size
+ * @param r The red channels
+ * @param g The green channels
+ * @param b The blue channels
+ */
+MAR_PRIVATE
+void mar_image_interleave_8(unsigned char *rgb, const unsigned char *r, const unsigned char *g, const unsigned char *b)
+{
+  int i;
+
+  for (i = 0; i < 8; i++)
+  {
+    rgb[i*3 + 0] = r[i];
+    rgb[i*3 + 1] = g[i];
+    rgb[i*3 + 2] = b[i];
+  }
+}
+
+/**
+ * Splits 8 YUYV pixels into Y, U and V channels widened to 16 bits, with U and V repeated for each pixel.
+ *
+ * @param src The 16 bytes of YUYV source
+ * @param y Will be filled with the Y channels
+ * @param u Will be filled with the U channels
+ * @param v Will be filled with the V channels
+ */
+MAR_PRIVATE
+void mar_image_split_yuyv_sse2(__m128i src, __m128i *y, __m128i *u, __m128i *v)
+{
+  __m128i uv = _mm_srli_epi16(src, 8);
+
+  *y = _mm_and_si128(src, _mm_set1_epi16(0x00FF));
+  *u = _mm_shufflehi_epi16(_mm_shufflelo_epi16(uv, _MM_SHUFFLE(2, 2, 0, 0)), _MM_SHUFFLE(2, 2, 0, 0));
+  *v = _mm_shufflehi_epi16(_mm_shufflelo_epi16(uv, _MM_SHUFFLE(3, 3, 1, 1)), _MM_SHUFFLE(3, 3, 1, 1));
+}
+
+/**
+ * Expands 8 studio swing Y values widened to 16 bits into full range luma.
+ *
+ * @param y The Y channels
+ *
+ * @return The luma values, not yet saturated to 8 bits
+ */
+MAR_PRIVATE
+__m128i mar_image_expand_luma_sse2(__m128i y)
+{
+  __m128i t = _mm_subs_epu16(y, _mm_set1_epi16(MAR_IMAGE_Y_BLACK));
+
+  return _mm_add_epi16(t, _mm_srli_epi16(_mm_mullo_epi16(t, _mm_set1_epi16(MAR_IMAGE_Y_EXPAND_FRAC)), 8));
+}
+
+/** SSE2 YUYV to RGB24 kernel, 8 pixels per iteration */
+MAR_PRIVATE
+void mar_image_yuyv_to_rgb_sse2(const unsigned char *yuyv, unsigned char *rgb, int num_pixels)
+{
+  int i, h;
+  __m128i src, y16, u16, v16, zero = _mm_setzero_si128(), rc[2], gc[2], bc[2];
+  __m128 y, u, v;
+  unsigned char r8[16], g8[16], b8[16];
+
+  for (i = 0; i + 8 <= num_pixels; i += 8)
+  {
+    src = _mm_loadu_si128((const __m128i *)(yuyv + i*2));
+    mar_image_split_yuyv_sse2(src, &y16, &u16, &v16);
+
+    // Convert the low and high 4 pixels in floating point
+    for (h = 0; h < 2; h++)
+    {
+      y = _mm_cvtepi32_ps(h ? _mm_unpackhi_epi16(y16, zero) : _mm_unpacklo_epi16(y16, zero));
+      u = _mm_cvtepi32_ps(h ? _mm_unpackhi_epi16(u16, zero) : _mm_unpacklo_epi16(u16, zero));
+      v = _mm_cvtepi32_ps(h ? _mm_unpackhi_epi16(v16, zero) : _mm_unpacklo_epi16(v16, zero));
+      y = _mm_mul_ps(y, _mm_set1_ps(MAR_IMAGE_Y_COEF));
+
+      rc[h] = _mm_cvttps_epi32(_mm_add_ps(_mm_add_ps(_mm_add_ps(y, _mm_mul_ps(u, _mm_set1_ps(MAR_IMAGE_R_U_COEF))),
+              _mm_mul_ps(v, _mm_set1_ps(MAR_IMAGE_R_V_COEF))), _mm_set1_ps(MAR_IMAGE_R_CONST)));
+      gc[h] = _mm_cvttps_epi32(_mm_add_ps(_mm_add_ps(_mm_add_ps(y, _mm_mul_ps(u, _mm_set1_ps(MAR_IMAGE_G_U_COEF))),
+              _mm_mul_ps(v, _mm_set1_ps(MAR_IMAGE_G_V_COEF))), _mm_set1_ps(MAR_IMAGE_G_CONST)));
+      bc[h] = _mm_cvttps_epi32(_mm_add_ps(_mm_add_ps(y, _mm_mul_ps(u, _mm_set1_ps(MAR_IMAGE_B_U_COEF))),
+              _mm_set1_ps(MAR_IMAGE_B_CONST)));
+    }
+
+    // Saturate to [0-255] and interleave
+    _mm_storeu_si128((__m128i *)r8, _mm_packus_epi16(_mm_packs_epi32(rc[0], rc[1]), zero));
+    _mm_storeu_si128((__m128i *)g8, _mm_packus_epi16(_mm_packs_epi32(gc[0], gc[1]), zero));
+    _mm_storeu_si128((__m128i *)b8, _mm_packus_epi16(_mm_packs_epi32(bc[0], bc[1]), zero));
+    mar_image_interleave_8(rgb + i*3, r8, g8, b8);
+  }
+
+  mar_image_yuyv_to_rgb_range(yuyv, rgb, i, num_pixels);
+}
+
+/** SSE2 YUYV to 8-bit luma kernel, 16 pixels per iteration */
+MAR_PRIVATE
+void mar_image_yuyv_to_gray_sse2(const unsigned char *yuyv, unsigned char *gray, int num_pixels)
+{
+  int i;
+  __m128i lo, hi, mask = _mm_set1_epi16(0x00FF);
+
+  for (i = 0; i + 16 <= num_pixels; i += 16)
+  {
+    lo = _mm_and_si128(_mm_loadu_si128((const __m128i *)(yuyv + i*2)), mask);
+    hi = _mm_and_si128(_mm_loadu_si128((const __m128i *)(yuyv + i*2 + 16)), mask);
+    _mm_storeu_si128((__m128i *)(gray + i), _mm_packus_epi16(mar_image_expand_luma_sse2(lo), mar_image_expand_luma_sse2(hi)));
+  }
+
+  mar_image_yuyv_to_gray_range(yuyv, gray, i, num_pixels);
+}
+
+/** SSE2 YUYV to floating point luma kernel, 8 pixels per iteration */
+MAR_PRIVATE
+void mar_image_yuyv_to_grayf_sse2(const unsigned char *yuyv, float *gray, int num_pixels)
+{
+  int i;
+  __m128i g, zero = _mm_setzero_si128();
+  __m128 scale = _mm_set1_ps(1.0f / 255.0f);
+
+  for (i = 0; i + 8 <= num_pixels; i += 8)
+  {
+    g = _mm_and_si128(_mm_loadu_si128((const __m128i *)(yuyv + i*2)), _mm_set1_epi16(0x00FF));
+    g = _mm_min_epi16(mar_image_expand_luma_sse2(g), _mm_set1_epi16(255));
+    _mm_storeu_ps(gray + i, _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(g, zero)), scale));
+    _mm_storeu_ps(gray + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(g, zero)), scale));
+  }
+
+  mar_image_yuyv_to_grayf_range(yuyv, gray, i, num_pixels);
+}
+
+/** The SSE2 image kernels @return */
+MAR_PRIVATE const mar_image_kernels mar_image_sse2_kernels =
+{
+  "sse2",
+  mar_image_yuyv_to_rgb_sse2,
+  mar_image_yuyv_to_gray_sse2,
+  mar_image_yuyv_to_grayf_sse2
+};
+
+/** AVX2 YUYV to RGB24 kernel, 8 pixels per iteration computed in one 256-bit register */
+MAR_PRIVATE __attribute__((target("avx2")))
+void mar_image_yuyv_to_rgb_avx2(const unsigned char *yuyv, unsigned char *rgb, int num_pixels)
+{
+  int i;
+  __m128i src, y16, u16, v16, uv, zero = _mm_setzero_si128();
+  __m256i r, g, b;
+  __m256 y, u, v;
+  unsigned char r8[16], g8[16], b8[16];
+
+  for (i = 0; i + 8 <= num_pixels; i += 8)
+  {
+    src = _mm_loadu_si128((const __m128i *)(yuyv + i*2));
+    uv = _mm_srli_epi16(src, 8);
+    y16 = _mm_and_si128(src, _mm_set1_epi16(0x00FF));
+    u16 = _mm_shufflehi_epi16(_mm_shufflelo_epi16(uv, _MM_SHUFFLE(2, 2, 0, 0)), _MM_SHUFFLE(2, 2, 0, 0));
+    v16 = _mm_shufflehi_epi16(_mm_shufflelo_epi16(uv, _MM_SHUFFLE(3, 3, 1, 1)), _MM_SHUFFLE(3, 3, 1, 1));
+
+    y = _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_cvtepu16_epi32(y16)), _mm256_set1_ps(MAR_IMAGE_Y_COEF));
+    u = _mm256_cvtepi32_ps(_mm256_cvtepu16_epi32(u16));
+    v = _mm256_cvtepi32_ps(_mm256_cvtepu16_epi32(v16));
+
+    r = _mm256_cvttps_epi32(_mm256_add_ps(_mm256_add_ps(_mm256_add_ps(y, _mm256_mul_ps(u, _mm256_set1_ps(MAR_IMAGE_R_U_COEF))),
+          _mm256_mul_ps(v, _mm256_set1_ps(MAR_IMAGE_R_V_COEF))), _mm256_set1_ps(MAR_IMAGE_R_CONST)));
+    g = _mm256_cvttps_epi32(_mm256_add_ps(_mm256_add_ps(_mm256_add_ps(y, _mm256_mul_ps(u, _mm256_set1_ps(MAR_IMAGE_G_U_COEF))),
+          _mm256_mul_ps(v, _mm256_set1_ps(MAR_IMAGE_G_V_COEF))), _mm256_set1_ps(MAR_IMAGE_G_CONST)));
+    b = _mm256_cvttps_epi32(_mm256_add_ps(_mm256_add_ps(y, _mm256_mul_ps(u, _mm256_set1_ps(MAR_IMAGE_B_U_COEF))),
+          _mm256_set1_ps(MAR_IMAGE_B_CONST)));
+
+    // Saturate to [0-255] and interleave
+    _mm_storeu_si128((__m128i *)r8, _mm_packus_epi16(_mm_packs_epi32(_mm256_castsi256_si128(r), _mm256_extracti128_si256(r, 1)), zero));
+    _mm_storeu_si128((__m128i *)g8, _mm_packus_epi16(_mm_packs_epi32(_mm256_castsi256_si128(g), _mm256_extracti128_si256(g, 1)), zero));
+    _mm_storeu_si128((__m128i *)b8, _mm_packus_epi16(_mm_packs_epi32(_mm256_castsi256_si128(b), _mm256_extracti128_si256(b, 1)), zero));
+    mar_image_interleave_8(rgb + i*3, r8, g8, b8);
+  }
+
+  mar_image_yuyv_to_rgb_range(yuyv, rgb, i, num_pixels);
+}
+
+/**
+ * Expands 16 studio swing Y values widened to 16 bits into full range luma.
+ *
+ * @param y The Y channels
+ *
+ * @return The luma values, not yet saturated to 8 bits
+ */
+MAR_PRIVATE __attribute__((target("avx2")))
+__m256i mar_image_expand_luma_avx2(__m256i y)
+{
+  __m256i t = _mm256_subs_epu16(y, _mm256_set1_epi16(MAR_IMAGE_Y_BLACK));
+
+  return _mm256_add_epi16(t, _mm256_srli_epi16(_mm256_mullo_epi16(t, _mm256_set1_epi16(MAR_IMAGE_Y_EXPAND_FRAC)), 8));
+}
+
+/** AVX2 YUYV to 8-bit luma kernel, 32 pixels per iteration */
+MAR_PRIVATE __attribute__((target("avx2")))
+void mar_image_yuyv_to_gray_avx2(const unsigned char *yuyv, unsigned char *gray, int num_pixels)
+{
+  int i;
+  __m256i lo, hi, mask = _mm256_set1_epi16(0x00FF);
+
+  for (i = 0; i + 32 <= num_pixels; i += 32)
+  {
+    lo = _mm256_and_si256(_mm256_loadu_si256((const __m256i *)(yuyv + i*2)), mask);
+    hi = _mm256_and_si256(_mm256_loadu_si256((const __m256i *)(yuyv + i*2 + 32)), mask);
+
+    // Packing works within 128-bit lanes, so reorder the 64-bit quarters afterwards
+    _mm256_storeu_si256((__m256i *)(gray + i), _mm256_permute4x64_epi64(
+          _mm256_packus_epi16(mar_image_expand_luma_avx2(lo), mar_image_expand_luma_avx2(hi)), _MM_SHUFFLE(3, 1, 2, 0)));
+  }
+
+  mar_image_yuyv_to_gray_range(yuyv, gray, i, num_pixels);
+}
+
+/** AVX2 YUYV to floating point luma kernel, 16 pixels per iteration */
+MAR_PRIVATE __attribute__((target("avx2")))
+void mar_image_yuyv_to_grayf_avx2(const unsigned char *yuyv, float *gray, int num_pixels)
+{
+  int i;
+  __m256i g;
+  __m256 scale = _mm256_set1_ps(1.0f / 255.0f);
+
+  for (i = 0; i + 16 <= num_pixels; i += 16)
+  {
+    g = _mm256_and_si256(_mm256_loadu_si256((const __m256i *)(yuyv + i*2)), _mm256_set1_epi16(0x00FF));
+    g = _mm256_min_epi16(mar_image_expand_luma_avx2(g), _mm256_set1_epi16(255));
+    _mm256_storeu_ps(gray + i, _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_cvtepu16_epi32(_mm256_castsi256_si128(g))), scale));
+    _mm256_storeu_ps(gray + i + 8, _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_cvtepu16_epi32(_mm256_extracti128_si256(g, 1))), scale));
+  }
+
+  mar_image_yuyv_to_grayf_range(yuyv, gray, i, num_pixels);
+}
+
+/** The AVX2 image kernels @return */
+MAR_PRIVATE const mar_image_kernels mar_image_avx2_kernels =
+{
+  "avx2",
+  mar_image_yuyv_to_rgb_avx2,
+  mar_image_yuyv_to_gray_avx2,
+  mar_image_yuyv_to_grayf_avx2
+};
+
+#endif
+
+#ifdef MAR_IMAGE_NEON
+
+/**
+ * Converts 8 pixels of one YUYV channel set to one saturated color channel.
+ *
+ * @param y The Y channels scaled by MAR_IMAGE_Y_COEF, low 4 pixels
+ * @param y_hi The Y channels scaled by MAR_IMAGE_Y_COEF, high 4 pixels
+ * @param u The U channels, low and high 4 pixels
+ * @param v The V channels, low and high 4 pixels
+ * @param u_coef The U coefficient
+ * @param v_coef The V coefficient
+ * @param c The constant
+ *
+ * @return The color channel of the 8 pixels
+ */
+MAR_PRIVATE
+uint8x8_t mar_image_channel_neon(float32x4_t y, float32x4_t y_hi, const float32x4_t *u, const float32x4_t *v, float u_coef, float v_coef, float c)
+{
+  float32x4_t lo, hi;
+
+  lo = vaddq_f32(vaddq_f32(vaddq_f32(y, vmulq_n_f32(u[0], u_coef)), vmulq_n_f32(v[0], v_coef)), vdupq_n_f32(c));
+  hi = vaddq_f32(vaddq_f32(vaddq_f32(y_hi, vmulq_n_f32(u[1], u_coef)), vmulq_n_f32(v[1], v_coef)), vdupq_n_f32(c));
+
+  return vqmovn_u16(vcombine_u16(vqmovun_s32(vcvtq_s32_f32(lo)), vqmovun_s32(vcvtq_s32_f32(hi))));
+}
+
+/**
+ * Widens 8 8-bit values to two vectors of floats.
+ *
+ * @param x The 8-bit values
+ * @param f Will be filled with the low and high 4 values
+ */
+MAR_PRIVATE
+void mar_image_widen_neon(uint8x8_t x, float32x4_t *f)
+{
+  uint16x8_t w = vmovl_u8(x);
+
+  f[0] = vcvtq_f32_u32(vmovl_u16(vget_low_u16(w)));
+  f[1] = vcvtq_f32_u32(vmovl_u16(vget_high_u16(w)));
+}
+
+/** NEON YUYV to RGB24 kernel, 16 pixels per iteration */
+MAR_PRIVATE
+void mar_image_yuyv_to_rgb_neon(const unsigned char *yuyv, unsigned char *rgb, int num_pixels)
+{
+  int i, p;
+  uint8x8x4_t src;
+  uint8x8x2_t r, g, b;
+  uint8x16x3_t out;
+  float32x4_t y[2], u[2], v[2];
+
+  for (i = 0; i + 16 <= num_pixels; i += 16)
+  {
+    // Deinterleave into even Y, U, odd Y and V
+    src = vld4_u8(yuyv + i*2);
+    mar_image_widen_neon(src.val[1], u);
+    mar_image_widen_neon(src.val[3], v);
+
+    // Convert the even pixels and then the odd pixels
+    for (p = 0; p < 2; p++)
+    {
+      mar_image_widen_neon(src.val[p*2], y);
+      y[0] = vmulq_n_f32(y[0], MAR_IMAGE_Y_COEF);
+      y[1] = vmulq_n_f32(y[1], MAR_IMAGE_Y_COEF);
+      r.val[p] = mar_image_channel_neon(y[0], y[1], u, v, MAR_IMAGE_R_U_COEF, MAR_IMAGE_R_V_COEF, MAR_IMAGE_R_CONST);
+      g.val[p] = mar_image_channel_neon(y[0], y[1], u, v, MAR_IMAGE_G_U_COEF, MAR_IMAGE_G_V_COEF, MAR_IMAGE_G_CONST);
+      b.val[p] = mar_image_channel_neon(y[0], y[1], u, v, MAR_IMAGE_B_U_COEF, 0.0f, MAR_IMAGE_B_CONST);
+    }
+
+    // Zip the even and odd pixels back together and store interleaved
+    r = vzip_u8(r.val[0], r.val[1]);
+    g = vzip_u8(g.val[0], g.val[1]);
+    b = vzip_u8(b.val[0], b.val[1]);
+    out.val[0] = vcombine_u8(r.val[0], r.val[1]);
+    out.val[1] = vcombine_u8(g.val[0], g.val[1]);
+    out.val[2] = vcombine_u8(b.val[0], b.val[1]);
+    vst3q_u8(rgb + i*3, out);
+  }
+
+  mar_image_yuyv_to_rgb_range(yuyv, rgb, i, num_pixels);
+}
+
+/**
+ * Expands 16 studio swing Y values into saturated full range luma.
+ *
+ * @param y The Y channels
+ *
+ * @return The luma values
+ */
+MAR_PRIVATE
+uint8x16_t mar_image_expand_luma_neon(uint8x16_t y)
+{
+  uint8x16_t t = vqsubq_u8(y, vdupq_n_u8(MAR_IMAGE_Y_BLACK));
+  uint8x8_t frac_lo = vshrn_n_u16(vmull_u8(vget_low_u8(t), vdup_n_u8(MAR_IMAGE_Y_EXPAND_FRAC)), 8);
+  uint8x8_t frac_hi = vshrn_n_u16(vmull_u8(vget_high_u8(t), vdup_n_u8(MAR_IMAGE_Y_EXPAND_FRAC)), 8);
+
+  return vqaddq_u8(t, vcombine_u8(frac_lo, frac_hi));
+}
+
+/** NEON YUYV to 8-bit luma kernel, 16 pixels per iteration */
+MAR_PRIVATE
+void mar_image_yuyv_to_gray_neon(const unsigned char *yuyv, unsigned char *gray, int num_pixels)
+{
+  int i;
+
+  for (i = 0; i + 16 <= num_pixels; i += 16)
+  {
+    vst1q_u8(gray + i, mar_image_expand_luma_neon(vld2q_u8(yuyv + i*2).val[0]));
+  }
+
+  mar_image_yuyv_to_gray_range(yuyv, gray, i, num_pixels);
+}
+
+/** NEON YUYV to floating point luma kernel, 16 pixels per iteration */
+MAR_PRIVATE
+void mar_image_yuyv_to_grayf_neon(const unsigned char *yuyv, float *gray, int num_pixels)
+{
+  int i;
+  uint8x16_t g;
+  float32x4_t f[2];
+
+  for (i = 0; i + 16 <= num_pixels; i += 16)
+  {
+    g = mar_image_expand_luma_neon(vld2q_u8(yuyv + i*2).val[0]);
+    mar_image_widen_neon(vget_low_u8(g), f);
+    vst1q_f32(gray + i, vmulq_n_f32(f[0], 1.0f / 255.0f));
+    vst1q_f32(gray + i + 4, vmulq_n_f32(f[1], 1.0f / 255.0f));
+    mar_image_widen_neon(vget_high_u8(g), f);
+    vst1q_f32(gray + i + 8, vmulq_n_f32(f[0], 1.0f / 255.0f));
+    vst1q_f32(gray + i + 12, vmulq_n_f32(f[1], 1.0f / 255.0f));
+  }
+
+  mar_image_yuyv_to_grayf_range(yuyv, gray, i, num_pixels);
+}
+
+/** The NEON image kernels @return */
+MAR_PRIVATE const mar_image_kernels mar_image_neon_kernels =
+{
+  "neon",
+  mar_image_yuyv_to_rgb_neon,
+  mar_image_yuyv_to_gray_neon,
+  mar_image_yuyv_to_grayf_neon
+};
+
+#endif
+
+/**
+ * Returns the fastest image kernels supported by the CPU, selecting them on first use.  Threads which use the
+ * kernels for the first time at once each select the same kernels, so the selection is only published atomically.
+ *
+ * @return The image kernels
+ */
+MAR_PRIVATE
+const mar_image_kernels *mar_image_get_kernels()
+{
+  const mar_image_kernels *kernels = __atomic_load_n(&mar_image_selected_kernels, __ATOMIC_ACQUIRE);
+
+  if (kernels == NULL)
+  {
+#if defined(MAR_IMAGE_X86)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+    {
+      kernels = &mar_image_avx2_kernels;
+    }
+    else if (__builtin_cpu_supports("sse2"))
+    {
+      kernels = &mar_image_sse2_kernels;
+    }
+    else
+    {
+      kernels = &mar_image_scalar_kernels;
+    }
+#elif defined(MAR_IMAGE_NEON)
+    kernels = &mar_image_neon_kernels;
+#else
+    kernels = &mar_image_scalar_kernels;
+#endif
+    __atomic_store_n(&mar_image_selected_kernels, kernels, __ATOMIC_RELEASE);
+  }
+
+  return kernels;
+}
+
+/**
+ * Converts a YUYV/YUY2 image to an RGB24 image.
+ *
+ * @param yuyv The YUYV source image, 2 * num_pixels bytes in size
+ * @param rgb The RGB24 destination image, 3 * num_pixels bytes in size
+ * @param num_pixels The number of pixels in the image, must be even
+ */
+MAR_PUBLIC
+void mar_image_yuyv_to_rgb(const unsigned char *yuyv, unsigned char *rgb, int num_pixels)
+{
+  mar_image_get_kernels()->yuyv_to_rgb(yuyv, rgb, num_pixels);
+}
+
+/**
+ * Extracts the luma plane of a YUYV/YUY2 image as an 8-bit grayscale image.
+ * The studio swing Y channel is expanded to the full [0-255] range, which matches
+ * the luminance of the image produced by mar_image_yuyv_to_rgb.
+ *
+ * @param yuyv The YUYV source image, 2 * num_pixels bytes in size
+ * @param gray The grayscale destination image, num_pixels bytes in size
+ * @param num_pixels The number of pixels in the image
+ */
+MAR_PUBLIC
+void mar_image_yuyv_to_gray(const unsigned char *yuyv, unsigned char *gray, int num_pixels)
+{
+  mar_image_get_kernels()->yuyv_to_gray(yuyv, gray, num_pixels);
+}
+
+/**
+ * Extracts the luma plane of a YUYV/YUY2 image as a floating point grayscale image normalized to [0-1].
+ *
+ * @param yuyv The YUYV source image, 2 * num_pixels bytes in size
+ * @param gray The grayscale destination image, num_pixels floats in size
+ * @param num_pixels The number of pixels in the image
+ */
+MAR_PUBLIC
+void mar_image_yuyv_to_grayf(const unsigned char *yuyv, float *gray, int num_pixels)
+{
+  mar_image_get_kernels()->yuyv_to_grayf(yuyv, gray, num_pixels);
+}
+
+/**
+ * Converts an 8-bit grayscale image to a floating point grayscale image normalized to [0-1].
+ *
+ * @param gray The 8-bit grayscale source image
+ * @param grayf The floating point grayscale destination image
+ * @param num_pixels The number of pixels in the image
+ */
+MAR_PUBLIC
+void mar_image_gray_to_grayf(const unsigned char *gray, float *grayf, int num_pixels)
+{
+  int i;
+
+  for (i = 0; i < num_pixels; i++)
+  {
+    grayf[i] = gray[i] * (1.0f / 255.0f);
+  }
+}
+
+/**
+ * Inverts an 8-bit grayscale image.
+ *
+ * @param gray The 8-bit grayscale source image
+ * @param inverse The inverse grayscale destination image, may be the same as gray
+ * @param num_pixels The number of pixels in the image
+ */
+MAR_PUBLIC
+void mar_image_invert_gray(const unsigned char *gray, unsigned char *inverse, int num_pixels)
+{
+  int i;
+
+  for (i = 0; i < num_pixels; i++)
+  {
+    inverse[i] = ~gray[i];
+  }
+}
+
+/**
+ * Halves the resolution of an 8-bit grayscale image by averaging each 2x2 block of pixels.
+ * An odd last row or column is dropped.
+ *
+ * @param gray The 8-bit grayscale source image
+ * @param width The width of the source image
+ * @param height The height of the source image
+ * @param half The destination image, (width / 2) * (height / 2) in size
+ */
+MAR_PUBLIC
+void mar_image_downsample_gray(const unsigned char *gray, int width, int height, unsigned char *half)
+{
+  int x, y;
+  const unsigned char *row0, *row1;
+
+  for (y = 0; y < height / 2; y++)
+  {
+    row0 = gray + (y*2) * width;
+    row1 = row0 + width;
+    for (x = 0; x < width / 2; x++)
+    {
+      half[y * (width / 2) + x] = (row0[x*2] + row0[x*2 + 1] + row1[x*2] + row1[x*2 + 1] + 2) >> 2;
+    }
+  }
+}
+
+/**
+ * Returns the name of the instruction set used by the selected image kernels.
+ *
+ * @return "avx2", "sse2", "neon" or "scalar"
+ */
+MAR_PUBLIC
+const char *mar_image_get_kernel_name()
+{
+  return mar_image_get_kernels()->name;
+}
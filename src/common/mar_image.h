@@ -0,0 +1,80 @@
+/**
+ * @file mar_image.h
+ *
+ * Contains image conversion kernels used across various components of the MAR library.
+ * The YUYV kernels are vectorized with SSE2, AVX2 or NEON when available, and the fastest
+ * kernel supported by the CPU is selected at runtime.  The grayscale kernels are simple
+ * enough to be left to the compiler's vectorizer.
+ *
+ * @author Greg Eddington
+ */
+
+#ifndef MAR_IMAGE_H
+#define MAR_IMAGE_H
+
+/**
+ * Converts a YUYV/YUY2 image to an RGB24 image.
+ *
+ * @param yuyv The YUYV source image, 2 * num_pixels bytes in size
+ * @param rgb The RGB24 destination image, 3 * num_pixels bytes in size
+ * @param num_pixels The number of pixels in the image, must be even
+ */
+void mar_image_yuyv_to_rgb(const unsigned char *yuyv, unsigned char *rgb, int num_pixels);
+
+/**
+ * Extracts the luma plane of a YUYV/YUY2 image as an 8-bit grayscale image.
+ * The studio swing Y channel is expanded to the full [0-255] range, which matches
+ * the luminance of the image produced by mar_image_yuyv_to_rgb.
+ *
+ * @param yuyv The YUYV source image, 2 * num_pixels bytes in size
+ * @param gray The grayscale destination image, num_pixels bytes in size
+ * @param num_pixels The number of pixels in the image
+ */
+void mar_image_yuyv_to_gray(const unsigned char *yuyv, unsigned char *gray, int num_pixels);
+
+/**
+ * Extracts the luma plane of a YUYV/YUY2 image as a floating point grayscale image normalized to [0-1].
+ *
+ * @param yuyv The YUYV source image, 2 * num_pixels bytes in size
+ * @param gray The grayscale destination image, num_pixels floats in size
+ * @param num_pixels The number of pixels in the image
+ */
+void mar_image_yuyv_to_grayf(const unsigned char *yuyv, float *gray, int num_pixels);
+
+/**
+ * Converts an 8-bit grayscale image to a floating point grayscale image normalized to [0-1].
+ *
+ * @param gray The 8-bit grayscale source image
+ * @param grayf The floating point grayscale destination image
+ * @param num_pixels The number of pixels in the image
+ */
+void mar_image_gray_to_grayf(const unsigned char *gray, float *grayf, int num_pixels);
+
+/**
+ * Inverts an 8-bit grayscale image.
+ *
+ * @param gray The 8-bit grayscale source image
+ * @param inverse The inverse grayscale destination image, may be the same as gray
+ * @param num_pixels The number of pixels in the image
+ */
+void mar_image_invert_gray(const unsigned char *gray, unsigned char *inverse, int num_pixels);
+
+/**
+ * Halves the resolution of an 8-bit grayscale image by averaging each 2x2 block of pixels.
+ * An odd last row or column is dropped.
+ *
+ * @param gray The 8-bit grayscale source image
+ * @param width The width of the source image
+ * @param height The height of the source image
+ * @param half The destination image, (width / 2) * (height / 2) in size
+ */
+void mar_image_downsample_gray(const unsigned char *gray, int width, int height, unsigned char *half);
+
+/**
+ * Returns the name of the instruction set used by the selected image kernels.
+ *
+ * @return "avx2", "sse2", "neon" or "scalar"
+ */
+const char *mar_image_get_kernel_name();
+
+#endif
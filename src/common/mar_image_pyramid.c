@@ -0,0 +1,217 @@
+/**
+ * @file mar_image_pyramid.c
+ *
+ * Contains a per-frame cache of grayscale images shared by the components of the MAR library.
+ * The full resolution luma is produced once per frame, and the floating point, inverse and
+ * downsampled images are built from it the first time they are requested during that frame.
+ *
+ * @author Greg Eddington
+ */
+
+#include "mar_image_pyramid.h"
+#include "mar_image.h"
+#include "mar_common.h"
+
+#include <stdlib.h>
+
+/**
+ * Creates a new image pyramid.
+ *
+ * @param pyramid The pyramid to initialize
+ * @param width The full resolution width
+ * @param height The full resolution height
+ * @param num_levels The number of levels, between 1 and MAR_IMAGE_PYRAMID_MAX_LEVELS
+ *
+ * @return MAR_ERROR_NONE on success, an error code on failure.
+ */
+MAR_PUBLIC
+mar_error_code mar_image_pyramid_new(mar_image_pyramid *pyramid, int width, int height, int num_levels)
+{
+  int i;
+
+  MAR_CLEAR(*pyramid);
+
+  if (num_levels < 1)
+  {
+    num_levels = 1;
+  }
+  else if (num_levels > MAR_IMAGE_PYRAMID_MAX_LEVELS)
+  {
+    num_levels = MAR_IMAGE_PYRAMID_MAX_LEVELS;
+  }
+
+  // Size each level, stopping early if the image becomes too small to halve
+  pyramid->width[0] = width;
+  pyramid->height[0] = height;
+  for (pyramid->num_levels = 1; pyramid->num_levels < num_levels; pyramid->num_levels++)
+  {
+    i = pyramid->num_levels;
+    if (pyramid->width[i-1] < 2 || pyramid->height[i-1] < 2)
+    {
+      break;
+    }
+    pyramid->width[i] = pyramid->width[i-1] / 2;
+    pyramid->height[i] = pyramid->height[i-1] / 2;
+  }
+
+  // Allocate storage for every image up front so frames never allocate
+  pyramid->grayf_storage = malloc(width * height * sizeof(float));
+  if (pyramid->grayf_storage == NULL)
+  {
+    mar_image_pyramid_free(pyramid);
+    return MAR_ERROR_MALLOC;
+  }
+
+  for (i = 0; i < pyramid->num_levels; i++)
+  {
+    pyramid->gray_storage[i] = malloc(pyramid->width[i] * pyramid->height[i]);
+    pyramid->inverse[i] = malloc(pyramid->width[i] * pyramid->height[i]);
+    if (pyramid->gray_storage[i] == NULL || pyramid->inverse[i] == NULL)
+    {
+      mar_image_pyramid_free(pyramid);
+      return MAR_ERROR_MALLOC;
+    }
+  }
+
+  return MAR_ERROR_NONE;
+}
+
+/**
+ * Frees the resources of an image pyramid created with mar_image_pyramid_new.
+ *
+ * @param pyramid The pyramid to free
+ */
+MAR_PUBLIC
+void mar_image_pyramid_free(mar_image_pyramid *pyramid)
+{
+  int i;
+
+  for (i = 0; i < MAR_IMAGE_PYRAMID_MAX_LEVELS; i++)
+  {
+    free(pyramid->gray_storage[i]);
+    free(pyramid->inverse[i]);
+  }
+  free(pyramid->grayf_storage);
+
+  MAR_CLEAR(*pyramid);
+}
+
+/**
+ * Starts a new frame using full resolution grayscale images owned by the caller, such as a camera's frame buffers.
+ * The images are referenced, not copied, and must stay valid until the next frame is set.
+ *
+ * @param pyramid The pyramid
+ * @param gray The 8-bit grayscale frame
+ * @param grayf The floating point grayscale frame normalized to [0-1], or NULL to build it from gray when requested
+ */
+MAR_PUBLIC
+void mar_image_pyramid_set_frame(mar_image_pyramid *pyramid, const unsigned char *gray, const float *grayf)
+{
+  pyramid->gray[0] = gray;
+  pyramid->grayf = grayf;
+  pyramid->gray_built = 1;
+  pyramid->inverse_built = 0;
+}
+
+/**
+ * Returns the pyramid's own full resolution grayscale storage.  A frame can be written into it and then
+ * started with mar_image_pyramid_set_frame, for frames which are not already available as grayscale images.
+ *
+ * @param pyramid The pyramid
+ *
+ * @return The storage, width * height in size
+ */
+MAR_PUBLIC
+unsigned char *mar_image_pyramid_get_frame_storage(mar_image_pyramid *pyramid)
+{
+  return pyramid->gray_storage[0];
+}
+
+/**
+ * Returns a level of the pyramid as an 8-bit grayscale image, building it if needed.
+ *
+ * @param pyramid The pyramid
+ * @param level The level, where 0 is full resolution
+ * @param width Will be filled with the width of the level, may be NULL
+ * @param height Will be filled with the height of the level, may be NULL
+ *
+ * @return The grayscale image, or NULL if the level does not exist
+ */
+MAR_PUBLIC
+const unsigned char *mar_image_pyramid_get_gray(mar_image_pyramid *pyramid, int level, int *width, int *height)
+{
+  const unsigned char *parent;
+
+  if (level < 0 || level >= pyramid->num_levels || pyramid->gray[0] == NULL)
+  {
+    return NULL;
+  }
+
+  // Build the level from the one above it
+  if (!(pyramid->gray_built & (1 << level)))
+  {
+    parent = mar_image_pyramid_get_gray(pyramid, level - 1, NULL, NULL);
+    mar_image_downsample_gray(parent, pyramid->width[level-1], pyramid->height[level-1], pyramid->gray_storage[level]);
+    pyramid->gray[level] = pyramid->gray_storage[level];
+    pyramid->gray_built |= 1 << level;
+  }
+
+  if (width != NULL)
+  {
+    *width = pyramid->width[level];
+  }
+  if (height != NULL)
+  {
+    *height = pyramid->height[level];
+  }
+
+  return pyramid->gray[level];
+}
+
+/**
+ * Returns a level of the pyramid as an inverse 8-bit grayscale image, building it if needed.
+ *
+ * @param pyramid The pyramid
+ * @param level The level, where 0 is full resolution
+ *
+ * @return The inverse grayscale image, or NULL if the level does not exist
+ */
+MAR_PUBLIC
+const unsigned char *mar_image_pyramid_get_inverse(mar_image_pyramid *pyramid, int level)
+{
+  const unsigned char *gray;
+
+  gray = mar_image_pyramid_get_gray(pyramid, level, NULL, NULL);
+  if (gray == NULL)
+  {
+    return NULL;
+  }
+
+  if (!(pyramid->inverse_built & (1 << level)))
+  {
+    mar_image_invert_gray(gray, pyramid->inverse[level], pyramid->width[level] * pyramid->height[level]);
+    pyramid->inverse_built |= 1 << level;
+  }
+
+  return pyramid->inverse[level];
+}
+
+/**
+ * Returns the full resolution level of the pyramid as a floating point grayscale image normalized to [0-1],
+ * building it if needed.
+ *
+ * @param pyramid The pyramid
+ *
+ * @return The floating point grayscale image
+ */
+MAR_PUBLIC
+const float *mar_image_pyramid_get_grayf(mar_image_pyramid *pyramid)
+{
+  if (pyramid->grayf == NULL && pyramid->gray[0] != NULL)
+  {
+    mar_image_gray_to_grayf(pyramid->gray[0], pyramid->grayf_storage, pyramid->width[0] * pyramid->height[0]);
+    pyramid->grayf = pyramid->grayf_storage;
+  }
+
+  return pyramid->grayf;
+}
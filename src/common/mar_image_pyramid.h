@@ -0,0 +1,118 @@
+/**
+ * @file mar_image_pyramid.h
+ *
+ * Contains a per-frame cache of grayscale images shared by the components of the MAR library.
+ * The full resolution luma is produced once per frame, and the floating point, inverse and
+ * downsampled images are built from it the first time they are requested during that frame.
+ *
+ * @author Greg Eddington
+ */
+
+#ifndef MAR_IMAGE_PYRAMID_H
+#define MAR_IMAGE_PYRAMID_H
+
+#include "mar_error.h"
+
+/** The maximum number of levels of an image pyramid, including the full resolution level */
+#define MAR_IMAGE_PYRAMID_MAX_LEVELS 4
+
+/**
+ * A grayscale image pyramid for a single camera frame.  Each level is half the width and height of the previous level.
+ */
+typedef struct
+{
+  /** The number of levels @return Read-Only */
+  int num_levels;
+  /** The width of each level @return Read-Only */
+  int width[MAR_IMAGE_PYRAMID_MAX_LEVELS];
+  /** The height of each level @return Read-Only */
+  int height[MAR_IMAGE_PYRAMID_MAX_LEVELS];
+  /** The 8-bit grayscale image of each level @return Do not access directly when using the library */
+  const unsigned char *gray[MAR_IMAGE_PYRAMID_MAX_LEVELS];
+  /** The storage owned by the pyramid for each level's grayscale image @return Do not access directly when using the library */
+  unsigned char *gray_storage[MAR_IMAGE_PYRAMID_MAX_LEVELS];
+  /** The inverse 8-bit grayscale image of each level @return Do not access directly when using the library */
+  unsigned char *inverse[MAR_IMAGE_PYRAMID_MAX_LEVELS];
+  /** The full resolution floating point grayscale image @return Do not access directly when using the library */
+  const float *grayf;
+  /** The storage owned by the pyramid for the floating point grayscale image @return Do not access directly when using the library */
+  float *grayf_storage;
+  /** A bit mask of the grayscale levels built for the current frame @return Do not access directly when using the library */
+  int gray_built;
+  /** A bit mask of the inverse levels built for the current frame @return Do not access directly when using the library */
+  int inverse_built;
+}
+mar_image_pyramid;
+
+/**
+ * Creates a new image pyramid.
+ *
+ * @param pyramid The pyramid to initialize
+ * @param width The full resolution width
+ * @param height The full resolution height
+ * @param num_levels The number of levels, between 1 and MAR_IMAGE_PYRAMID_MAX_LEVELS
+ *
+ * @return MAR_ERROR_NONE on success, an error code on failure.
+ */
+mar_error_code mar_image_pyramid_new(mar_image_pyramid *pyramid, int width, int height, int num_levels);
+
+/**
+ * Frees the resources of an image pyramid created with mar_image_pyramid_new.
+ *
+ * @param pyramid The pyramid to free
+ */
+void mar_image_pyramid_free(mar_image_pyramid *pyramid);
+
+/**
+ * Starts a new frame using full resolution grayscale images owned by the caller, such as a camera's frame buffers.
+ * The images are referenced, not copied, and must stay valid until the next frame is set.
+ *
+ * @param pyramid The pyramid
+ * @param gray The 8-bit grayscale frame
+ * @param grayf The floating point grayscale frame normalized to [0-1], or NULL to build it from gray when requested
+ */
+void mar_image_pyramid_set_frame(mar_image_pyramid *pyramid, const unsigned char *gray, const float *grayf);
+
+/**
+ * Returns the pyramid's own full resolution grayscale storage.  A frame can be written into it and then
+ * started with mar_image_pyramid_set_frame, for frames which are not already available as grayscale images.
+ *
+ * @param pyramid The pyramid
+ *
+ * @return The storage, width * height in size
+ */
+unsigned char *mar_image_pyramid_get_frame_storage(mar_image_pyramid *pyramid);
+
+/**
+ * Returns a level of the pyramid as an 8-bit grayscale image, building it if needed.
+ *
+ * @param pyramid The pyramid
+ * @param level The level, where 0 is full resolution
+ * @param width Will be filled with the width of the level, may be NULL
+ * @param height Will be filled with the height of the level, may be NULL
+ *
+ * @return The grayscale image, or NULL if the level does not exist
+ */
+const unsigned char *mar_image_pyramid_get_gray(mar_image_pyramid *pyramid, int level, int *width, int *height);
+
+/**
+ * Returns a level of the pyramid as an inverse 8-bit grayscale image, building it if needed.
+ *
+ * @param pyramid The pyramid
+ * @param level The level, where 0 is full resolution
+ *
+ * @return The inverse grayscale image, or NULL if the level does not exist
+ */
+const unsigned char *mar_image_pyramid_get_inverse(mar_image_pyramid *pyramid, int level);
+
+/**
+ * Returns the full resolution level of the pyramid as a floating point grayscale image normalized to [0-1],
+ * building it if needed.
+ *
+ * @param pyramid The pyramid
+ *
+ * @return The floating point grayscale image
+ */
+const float *mar_image_pyramid_get_grayf(mar_image_pyramid *pyramid);
+
+#endif
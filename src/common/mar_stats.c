@@ -0,0 +1,177 @@
+/**
+ * @file mar_stats.c
+ *
+ * Contains latency histograms used across various components of the MAR library to time their stages.
+ * Latencies are counted into buckets a quarter of an octave wide, so percentiles are within 12% of the
+ * exact value, and buckets are incremented atomically so any number of threads may record into the same
+ * histogram without locking.
+ *
+ * @author Greg Eddington
+ */
+
+#include "mar_stats.h"
+#include "mar_common.h"
+
+#include <time.h>
+
+/**
+ * Returns the smallest latency of a bucket.  The first 8 buckets hold a single microsecond each, and each
+ * octave from 8 microseconds on is split in 4 buckets.
+ *
+ * @param bucket The bucket
+ *
+ * @return The latency in microseconds
+ */
+MAR_PRIVATE
+uint64_t mar_stats_bucket_start(int bucket)
+{
+  if (bucket < 8)
+  {
+    return bucket;
+  }
+
+  return (uint64_t)(4 + ((bucket - 8) & 3)) << ((bucket - 8) / 4 + 1);
+}
+
+/**
+ * Returns the bucket of a latency.
+ *
+ * @param latency The latency in microseconds
+ *
+ * @return The bucket
+ */
+MAR_PRIVATE
+int mar_stats_bucket(uint64_t latency)
+{
+  int msb, bucket;
+
+  if (latency < 8)
+  {
+    return (int)latency;
+  }
+
+  // The octave and the two bits below the highest set bit
+  msb = 63 - __builtin_clzll(latency);
+  bucket = 8 + (msb - 3) * 4 + (int)((latency >> (msb - 2)) & 3);
+
+  return bucket < MAR_STATS_NUM_BUCKETS ? bucket : MAR_STATS_NUM_BUCKETS - 1;
+}
+
+/**
+ * Returns the time of a monotonic clock, for measuring latencies.
+ *
+ * @return The time in microseconds
+ */
+MAR_PUBLIC
+uint64_t mar_stats_now()
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+
+  return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+/**
+ * Removes every latency from a histogram.  Latencies recorded at the same time may or may not be kept.
+ *
+ * @param histogram The histogram
+ */
+MAR_PUBLIC
+void mar_stats_histogram_clear(mar_stats_histogram *histogram)
+{
+  int i;
+
+  for (i = 0; i < MAR_STATS_NUM_BUCKETS; i++)
+  {
+    __atomic_store_n(&histogram->buckets[i], 0, __ATOMIC_RELAXED);
+  }
+  __atomic_store_n(&histogram->count, 0, __ATOMIC_RELAXED);
+  __atomic_store_n(&histogram->last, 0, __ATOMIC_RELAXED);
+}
+
+/**
+ * Adds a latency to a histogram.  May be called from several threads at once.
+ *
+ * @param histogram The histogram
+ * @param latency The latency in microseconds
+ */
+MAR_PUBLIC
+void mar_stats_histogram_add(mar_stats_histogram *histogram, uint64_t latency)
+{
+  __atomic_add_fetch(&histogram->buckets[mar_stats_bucket(latency)], 1, __ATOMIC_RELAXED);
+  __atomic_add_fetch(&histogram->count, 1, __ATOMIC_RELAXED);
+  __atomic_store_n(&histogram->last, latency, __ATOMIC_RELAXED);
+}
+
+/**
+ * Returns the number of latencies of a histogram.
+ *
+ * @param histogram The histogram
+ *
+ * @return The number of latencies
+ */
+MAR_PUBLIC
+unsigned long mar_stats_histogram_get_count(const mar_stats_histogram *histogram)
+{
+  return __atomic_load_n(&histogram->count, __ATOMIC_RELAXED);
+}
+
+/**
+ * Returns the latest latency added to a histogram.
+ *
+ * @param histogram The histogram
+ *
+ * @return The latency in microseconds, 0 if the histogram is empty
+ */
+MAR_PUBLIC
+uint64_t mar_stats_histogram_get_last(const mar_stats_histogram *histogram)
+{
+  return __atomic_load_n(&histogram->last, __ATOMIC_RELAXED);
+}
+
+/**
+ * Returns a percentile of the latencies of a histogram, the middle of the bucket it falls in.  Latencies recorded
+ * at the same time may or may not be counted.
+ *
+ * @param histogram The histogram
+ * @param percentile The percentile in [0-100]
+ *
+ * @return The latency in microseconds, 0 if the histogram is empty
+ */
+MAR_PUBLIC
+float mar_stats_histogram_get_percentile(const mar_stats_histogram *histogram, float percentile)
+{
+  unsigned long counts[MAR_STATS_NUM_BUCKETS], count = 0, rank, seen = 0;
+  int i;
+
+  // Take the buckets once, the count may be ahead of them while other threads record
+  for (i = 0; i < MAR_STATS_NUM_BUCKETS; i++)
+  {
+    counts[i] = __atomic_load_n(&histogram->buckets[i], __ATOMIC_RELAXED);
+    count += counts[i];
+  }
+  if (count == 0)
+  {
+    return 0;
+  }
+
+  // The rank of the latency, counted from 1
+  rank = (unsigned long)(percentile / 100 * count + 0.5f);
+  rank = rank < 1 ? 1 : rank > count ? count : rank;
+  for (i = 0; i < MAR_STATS_NUM_BUCKETS - 1; i++)
+  {
+    seen += counts[i];
+    if (seen >= rank)
+    {
+      break;
+    }
+  }
+
+  // A bucket of a single microsecond, or the last bucket which has no end
+  if (i < 8 || i == MAR_STATS_NUM_BUCKETS - 1)
+  {
+    return (float)mar_stats_bucket_start(i);
+  }
+  return (mar_stats_bucket_start(i) + mar_stats_bucket_start(i + 1)) / 2.0f;
+}
@@ -0,0 +1,85 @@
+/**
+ * @file mar_stats.h
+ *
+ * Contains latency histograms used across various components of the MAR library to time their stages.
+ * Latencies are counted into buckets a quarter of an octave wide, so percentiles are within 12% of the
+ * exact value, and buckets are incremented atomically so any number of threads may record into the same
+ * histogram without locking.
+ *
+ * @author Greg Eddington
+ */
+
+#ifndef MAR_STATS_H
+#define MAR_STATS_H
+
+#include <stdint.h>
+
+/** The number of buckets of a histogram, the last of which holds every latency of a second or more */
+#define MAR_STATS_NUM_BUCKETS 80
+
+/**
+ * A histogram of latencies in microseconds
+ */
+typedef struct
+{
+  /** The number of latencies in each bucket, accessed atomically @return Do not access directly when using the library */
+  unsigned long buckets[MAR_STATS_NUM_BUCKETS];
+  /** The number of latencies, accessed atomically @return Do not access directly when using the library */
+  unsigned long count;
+  /** The latest latency, accessed atomically @return Do not access directly when using the library */
+  uint64_t last;
+}
+mar_stats_histogram;
+
+/**
+ * Returns the time of a monotonic clock, for measuring latencies.
+ *
+ * @return The time in microseconds
+ */
+uint64_t mar_stats_now();
+
+/**
+ * Removes every latency from a histogram.  Latencies recorded at the same time may or may not be kept.
+ *
+ * @param histogram The histogram
+ */
+void mar_stats_histogram_clear(mar_stats_histogram *histogram);
+
+/**
+ * Adds a latency to a histogram.  May be called from several threads at once.
+ *
+ * @param histogram The histogram
+ * @param latency The latency in microseconds
+ */
+void mar_stats_histogram_add(mar_stats_histogram *histogram, uint64_t latency);
+
+/**
+ * Returns the number of latencies of a histogram.
+ *
+ * @param histogram The histogram
+ *
+ * @return The number of latencies
+ */
+unsigned long mar_stats_histogram_get_count(const mar_stats_histogram *histogram);
+
+/**
+ * Returns the latest latency added to a histogram.
+ *
+ * @param histogram The histogram
+ *
+ * @return The latency in microseconds, 0 if the histogram is empty
+ */
+uint64_t mar_stats_histogram_get_last(const mar_stats_histogram *histogram);
+
+/**
+ * Returns a percentile of the latencies of a histogram, the middle of the bucket it falls in.  Latencies recorded
+ * at the same time may or may not be counted.
+ *
+ * @param histogram The histogram
+ * @param percentile The percentile in [0-100]
+ *
+ * @return The latency in microseconds, 0 if the histogram is empty
+ */
+float mar_stats_histogram_get_percentile(const mar_stats_histogram *histogram, float percentile);
+
+#endif
@@ -0,0 +1,215 @@
+/**
+ * @file mar_thread_pool.c
+ *
+ * Contains a fixed size thread pool used across various components of the MAR library to run
+ * independent tasks concurrently.  Work is handed out one index at a time, so threads which finish
+ * early keep taking work from the same job instead of idling.
+ *
+ * @author Greg Eddington
+ */
+
+#include "mar_thread_pool.h"
+#include "mar_common.h"
+
+#include <stdlib.h>
+#include <unistd.h>
+
+/**
+ * Runs tasks of the current job until every index has been handed out.
+ *
+ * @param pool The pool
+ * @param task The task of the job
+ * @param arg The argument of the job
+ * @param count The number of indices in the job
+ */
+MAR_PRIVATE
+void mar_thread_pool_work(mar_thread_pool *pool, mar_thread_pool_task task, void *arg, int count)
+{
+  int index;
+
+  while ((index = __atomic_fetch_add(&pool->next_index, 1, __ATOMIC_RELAXED)) < count)
+  {
+    task(arg, index);
+
+    // The thread finishing the last index wakes the thread waiting on the job
+    if (__atomic_add_fetch(&pool->num_finished, 1, __ATOMIC_ACQ_REL) == count)
+    {
+      pthread_mutex_lock(&pool->mutex);
+      pthread_cond_signal(&pool->job_finished);
+      pthread_mutex_unlock(&pool->mutex);
+    }
+  }
+}
+
+/**
+ * A worker thread.  Waits for jobs and works on them until the pool stops.
+ *
+ * @param arg The pool
+ *
+ * @return NULL
+ */
+MAR_PRIVATE
+void *mar_thread_pool_thread(void *arg)
+{
+  mar_thread_pool *pool = (mar_thread_pool *)arg;
+  unsigned int generation = 0;
+  mar_thread_pool_task task;
+  void *task_arg;
+  int count;
+
+  pthread_mutex_lock(&pool->mutex);
+  for (;;)
+  {
+    while (pool->running && pool->generation == generation)
+    {
+      pthread_cond_wait(&pool->job_started, &pool->mutex);
+    }
+    if (!pool->running)
+    {
+      break;
+    }
+
+    generation = pool->generation;
+    task = pool->task;
+    task_arg = pool->arg;
+    count = pool->count;
+    pool->num_active++;
+    pthread_mutex_unlock(&pool->mutex);
+
+    mar_thread_pool_work(pool, task, task_arg, count);
+
+    pthread_mutex_lock(&pool->mutex);
+    pool->num_active--;
+    pthread_cond_signal(&pool->job_finished);
+  }
+  pthread_mutex_unlock(&pool->mutex);
+
+  return NULL;
+}
+
+/**
+ * Creates a thread pool.
+ *
+ * @param pool A pointer to a pointer which will be modified to point at the new pool
+ * @param num_threads The number of threads including the thread running jobs, or 0 for one per online processor
+ *
+ * @return MAR_ERROR_NONE on success, an error code on failure
+ */
+MAR_PUBLIC
+mar_error_code mar_thread_pool_new(mar_thread_pool **pool, int num_threads)
+{
+  mar_thread_pool *p;
+
+  if (num_threads <= 0)
+  {
+    num_threads = sysconf(_SC_NPROCESSORS_ONLN);
+  }
+  if (num_threads < 1)
+  {
+    num_threads = 1;
+  }
+  else if (num_threads > MAR_THREAD_POOL_MAX_THREADS)
+  {
+    num_threads = MAR_THREAD_POOL_MAX_THREADS;
+  }
+
+  *pool = p = calloc(1, sizeof(mar_thread_pool));
+  if (p == NULL)
+  {
+    return MAR_ERROR_MALLOC;
+  }
+
+  pthread_mutex_init(&p->mutex, NULL);
+  pthread_cond_init(&p->job_started, NULL);
+  pthread_cond_init(&p->job_finished, NULL);
+  p->running = 1;
+
+  // The thread running a job is the first thread of the pool
+  for (p->num_threads = 1; p->num_threads < num_threads; p->num_threads++)
+  {
+    if (pthread_create(&p->threads[p->num_threads], NULL, mar_thread_pool_thread, p) != 0)
+    {
+      mar_thread_pool_free(p);
+      *pool = NULL;
+      return MAR_ERROR_THREAD;
+    }
+  }
+
+  return MAR_ERROR_NONE;
+}
+
+/**
+ * Stops the threads of a pool and frees it.
+ *
+ * @param pool The pool to free
+ */
+MAR_PUBLIC
+void mar_thread_pool_free(mar_thread_pool *pool)
+{
+  int i;
+
+  pthread_mutex_lock(&pool->mutex);
+  pool->running = 0;
+  pthread_cond_broadcast(&pool->job_started);
+  pthread_mutex_unlock(&pool->mutex);
+
+  for (i = 1; i < pool->num_threads; i++)
+  {
+    pthread_join(pool->threads[i], NULL);
+  }
+
+  pthread_cond_destroy(&pool->job_finished);
+  pthread_cond_destroy(&pool->job_started);
+  pthread_mutex_destroy(&pool->mutex);
+  free(pool);
+}
+
+/**
+ * Runs a task once for every index in [0, count) and waits for all of them to finish.  The calling thread
+ * runs tasks too.  Jobs must not be run from inside a task.
+ *
+ * @param pool The pool, or NULL to run every task on the calling thread
+ * @param task The task
+ * @param arg The argument passed to every task
+ * @param count The number of indices
+ */
+MAR_PUBLIC
+void mar_thread_pool_run(mar_thread_pool *pool, mar_thread_pool_task task, void *arg, int count)
+{
+  int i;
+
+  // Small jobs are not worth waking the workers for
+  if (pool == NULL || pool->num_threads == 1 || count <= 1)
+  {
+    for (i = 0; i < count; i++)
+    {
+      task(arg, i);
+    }
+    return;
+  }
+
+  // Publish the job once no worker is still leaving the previous one
+  pthread_mutex_lock(&pool->mutex);
+  while (pool->num_active > 0)
+  {
+    pthread_cond_wait(&pool->job_finished, &pool->mutex);
+  }
+  pool->task = task;
+  pool->arg = arg;
+  pool->count = count;
+  __atomic_store_n(&pool->next_index, 0, __ATOMIC_RELAXED);
+  __atomic_store_n(&pool->num_finished, 0, __ATOMIC_RELAXED);
+  pool->generation++;
+  pthread_cond_broadcast(&pool->job_started);
+  pthread_mutex_unlock(&pool->mutex);
+
+  // Work on the job alongside the workers, then wait for the stragglers
+  mar_thread_pool_work(pool, task, arg, count);
+
+  pthread_mutex_lock(&pool->mutex);
+  while (__atomic_load_n(&pool->num_finished, __ATOMIC_ACQUIRE) < count)
+  {
+    pthread_cond_wait(&pool->job_finished, &pool->mutex);
+  }
+  pthread_mutex_unlock(&pool->mutex);
+}
@@ -0,0 +1,87 @@
+/**
+ * @file mar_thread_pool.h
+ *
+ * Contains a fixed size thread pool used across various components of the MAR library to run
+ * independent tasks concurrently.  Work is handed out one index at a time, so threads which finish
+ * early keep taking work from the same job instead of idling.
+ *
+ * @author Greg Eddington
+ */
+
+#ifndef MAR_THREAD_POOL_H
+#define MAR_THREAD_POOL_H
+
+#include "mar_error.h"
+#include <pthread.h>
+
+/** The maximum number of threads in a pool, including the thread running jobs */
+#define MAR_THREAD_POOL_MAX_THREADS 16
+
+/**
+ * A task run by a thread pool once for every index of a job @return
+ */
+typedef void (*mar_thread_pool_task)(void *arg, int index);
+
+/**
+ * A MAR library thread pool
+ */
+typedef struct
+{
+  /** The number of threads, including the thread running jobs @return Read-Only */
+  int num_threads;
+  /** The worker threads @return Do not access directly when using the library */
+  pthread_t threads[MAR_THREAD_POOL_MAX_THREADS];
+  /** Guards the job fields and running @return Do not access directly when using the library */
+  pthread_mutex_t mutex;
+  /** Signaled when a new job starts or the pool stops @return Do not access directly when using the library */
+  pthread_cond_t job_started;
+  /** Signaled when the last index of a job finishes @return Do not access directly when using the library */
+  pthread_cond_t job_finished;
+  /** Incremented for every job so workers can tell new jobs apart @return Do not access directly when using the library */
+  unsigned int generation;
+  /** The task of the current job @return Do not access directly when using the library */
+  mar_thread_pool_task task;
+  /** The argument of the current job @return Do not access directly when using the library */
+  void *arg;
+  /** The number of indices in the current job @return Do not access directly when using the library */
+  int count;
+  /** The next index to hand out, accessed atomically @return Do not access directly when using the library */
+  int next_index;
+  /** The number of indices finished, accessed atomically @return Do not access directly when using the library */
+  int num_finished;
+  /** The number of workers inside a job @return Do not access directly when using the library */
+  int num_active;
+  /** Whether or not the workers should keep running @return Do not access directly when using the library */
+  int running;
+}
+mar_thread_pool;
+
+/**
+ * Creates a thread pool.
+ *
+ * @param pool A pointer to a pointer which will be modified to point at the new pool
+ * @param num_threads The number of threads including the thread running jobs, or 0 for one per online processor
+ *
+ * @return MAR_ERROR_NONE on success, an error code on failure
+ */
+mar_error_code mar_thread_pool_new(mar_thread_pool **pool, int num_threads);
+
+/**
+ * Stops the threads of a pool and frees it.
+ *
+ * @param pool The pool to free
+ */
+void mar_thread_pool_free(mar_thread_pool *pool);
+
+/**
+ * Runs a task once for every index in [0, count) and waits for all of them to finish.  The calling thread
+ * runs tasks too.  Jobs must not be run from inside a task.
+ *
+ * @param pool The pool, or NULL to run every task on the calling thread
+ * @param task The task
+ * @param arg The argument passed to every task
+ * @param count The number of indices
+ */
+void mar_thread_pool_run(mar_thread_pool *pool, mar_thread_pool_task task, void *arg, int count);
+
+#endif
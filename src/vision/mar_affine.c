@@ -0,0 +1,407 @@
+/**
+ * @file mar_affine.c
+ *
+ * Contains a robust estimator for affine transformations between matched points.  Minimal three point
+ * samples are drawn progressively from the best matches first, the consensus set of the best sample is
+ * grown until enough samples have been tried to be confident, and the transformation is then refined in
+ * closed form by least squares over the inliers.
+ *
+ * @author Greg Eddington
+ */
+
+#include "../common/mar_common.h"
+#include "mar_affine.h"
+
+#include <math.h>
+
+/** Systems whose determinant is this small relative to the scale of the matrix are treated as singular */
+#define MAR_AFFINE_SINGULAR_EPSILON 1e-9
+
+/**
+ * Solves a 3x3 linear system with Cramer's rule.
+ *
+ * @param m The matrix of the system, in row major order
+ * @param r The right hand side
+ * @param s Will be filled with the solution
+ * @param scale The magnitude of the matrix's entries, used to decide whether the matrix is singular
+ *
+ * @return 1 on success, 0 if the matrix is singular
+ */
+MAR_PRIVATE
+char mar_affine_solve3(const double m[3][3], const double r[3], double s[3], double scale)
+{
+  double det, c0, c1, c2;
+
+  c0 = m[1][1]*m[2][2] - m[1][2]*m[2][1];
+  c1 = m[1][0]*m[2][2] - m[1][2]*m[2][0];
+  c2 = m[1][0]*m[2][1] - m[1][1]*m[2][0];
+  det = m[0][0]*c0 - m[0][1]*c1 + m[0][2]*c2;
+
+  if (fabs(det) <= MAR_AFFINE_SINGULAR_EPSILON * scale * scale * scale)
+  {
+    return 0;
+  }
+
+  s[0] = (r[0]*c0 - m[0][1]*(r[1]*m[2][2] - m[1][2]*r[2]) + m[0][2]*(r[1]*m[2][1] - m[1][1]*r[2])) / det;
+  s[1] = (m[0][0]*(r[1]*m[2][2] - m[1][2]*r[2]) - r[0]*c1 + m[0][2]*(m[1][0]*r[2] - r[1]*m[2][0])) / det;
+  s[2] = (m[0][0]*(m[1][1]*r[2] - r[1]*m[2][1]) - m[0][1]*(m[1][0]*r[2] - r[1]*m[2][0]) + r[0]*c2) / det;
+
+  return 1;
+}
+
+/**
+ * Computes the affine transformation mapping three points exactly onto their matches.
+ *
+ * @param x The X coordinates of the points
+ * @param y The Y coordinates of the points
+ * @param u The X coordinates of the matches
+ * @param v The Y coordinates of the matches
+ * @param sample The indices of the three points
+ * @param transform Will be filled with the transformation
+ *
+ * @return 1 on success, 0 if the points are collinear
+ */
+MAR_PRIVATE
+char mar_affine_from_sample(const float *x, const float *y, const float *u, const float *v, const int sample[3], mar_affine *transform)
+{
+  double m[3][3], r[3], s[3], scale = 1;
+  int i;
+
+  for (i = 0; i < 3; i++)
+  {
+    m[i][0] = x[sample[i]];
+    m[i][1] = y[sample[i]];
+    m[i][2] = 1;
+    scale = fmax(scale, fmax(fabs(m[i][0]), fabs(m[i][1])));
+  }
+
+  for (i = 0; i < 3; i++)
+  {
+    r[i] = u[sample[i]];
+  }
+  if (!mar_affine_solve3((const double (*)[3])m, r, s, scale))
+  {
+    return 0;
+  }
+  transform->a = s[0];
+  transform->b = s[1];
+  transform->tx = s[2];
+
+  for (i = 0; i < 3; i++)
+  {
+    r[i] = v[sample[i]];
+  }
+  mar_affine_solve3((const double (*)[3])m, r, s, scale);
+  transform->c = s[0];
+  transform->d = s[1];
+  transform->ty = s[2];
+
+  return 1;
+}
+
+/**
+ * Marks the matches which a transformation maps a point to within a threshold of.
+ *
+ * @param x The X coordinates of the points
+ * @param y The Y coordinates of the points
+ * @param u The X coordinates of the matches
+ * @param v The Y coordinates of the matches
+ * @param num_points The number of matched points
+ * @param transform The transformation
+ * @param threshold The squared distance threshold
+ * @param inliers Will be filled with 1 for each inlier and 0 for each outlier, or NULL to only count them
+ *
+ * @return The number of inliers
+ */
+MAR_PRIVATE
+int mar_affine_find_inliers(const float *x, const float *y, const float *u, const float *v, int num_points,
+    const mar_affine *transform, float threshold, unsigned char *inliers)
+{
+  int i, n = 0;
+  float du, dv;
+  char inlier;
+
+  for (i = 0; i < num_points; i++)
+  {
+    du = transform->a * x[i] + transform->b * y[i] + transform->tx - u[i];
+    dv = transform->c * x[i] + transform->d * y[i] + transform->ty - v[i];
+    inlier = du*du + dv*dv < threshold;
+    n += inlier;
+    if (inliers != NULL)
+    {
+      inliers[i] = inlier;
+    }
+  }
+
+  return n;
+}
+
+/**
+ * Advances a xorshift random number generator.
+ *
+ * @param state The generator's state, never 0
+ *
+ * @return The next random number
+ */
+MAR_PRIVATE
+unsigned int mar_affine_random(unsigned int *state)
+{
+  *state ^= *state << 13;
+  *state ^= *state >> 17;
+  *state ^= *state << 5;
+
+  return *state;
+}
+
+/**
+ * Returns the number of samples which have to be tried for at least one of them to contain only inliers with a
+ * confidence, given the number of inliers of the best transformation so far.
+ *
+ * @param num_inliers The number of inliers of the best transformation so far
+ * @param num_points The number of matched points
+ * @param confidence The probability that at least one sample tried contains only inliers
+ * @param max_iterations The maximum number of samples, returned when more would be needed
+ *
+ * @return The number of samples
+ */
+MAR_PRIVATE
+int mar_affine_required_iterations(int num_inliers, int num_points, float confidence, int max_iterations)
+{
+  float outlier_sample, samples_needed;
+
+  outlier_sample = 1 - powf((float)num_inliers / num_points, 3);
+  if (outlier_sample <= 0)
+  {
+    return 0;
+  }
+  samples_needed = ceilf(logf(1 - confidence) / logf(outlier_sample));
+
+  return samples_needed < max_iterations ? (int)samples_needed : max_iterations;
+}
+
+/**
+ * Robustly estimates the affine transformation mapping points (x, y) to their matches (u, v).  Matches should be
+ * ordered from the most to the least reliable, since samples are drawn from the first matches before the rest.
+ *
+ * @param x The X coordinates of the points
+ * @param y The Y coordinates of the points
+ * @param u The X coordinates of the matches
+ * @param v The Y coordinates of the matches
+ * @param num_points The number of matched points
+ * @param max_iterations The maximum number of samples to try
+ * @param inlier_threshold The distance from a transformed point to its match for the match to be an inlier
+ * @param confidence The probability that at least one sample tried contains only inliers, after which sampling stops
+ * @param initial A predicted transformation scored before any sample, which stops sampling early when it is good, or NULL
+ * @param transform Will be filled with the transformation
+ * @param inliers Will be filled with 1 for each inlier and 0 for each outlier, num_points values
+ * @param num_inliers Will be filled with the number of inliers
+ *
+ * @return MAR_ERROR_NONE on success, MAR_ERROR_TOO_FEW_MATCHING_KEYPOINTS if no non degenerate sample was found
+ */
+MAR_PUBLIC
+mar_error_code mar_affine_estimate(const float *x, const float *y, const float *u, const float *v, int num_points,
+    int max_iterations, float inlier_threshold, float confidence, const mar_affine *initial, mar_affine *transform, 
+    unsigned char *inliers, int *num_inliers)
+{
+  mar_affine candidate, refined;
+  int i, n, sample[3], iteration, required_iterations, growth, subset, best_inliers = 0;
+  unsigned int state = 0x9E3779B9u ^ (unsigned int)num_points;
+  float threshold = inlier_threshold * inlier_threshold;
+
+  *num_inliers = 0;
+  if (num_points < 3)
+  {
+    return MAR_ERROR_TOO_FEW_MATCHING_KEYPOINTS;
+  }
+
+  // A good prediction already has most of the inliers, so only a few samples are tried against it
+  required_iterations = max_iterations;
+  if (initial != NULL)
+  {
+    n = mar_affine_find_inliers(x, y, u, v, num_points, initial, threshold, NULL);
+    if (n >= 3)
+    {
+      best_inliers = n;
+      *transform = *initial;
+      required_iterations = mar_affine_required_iterations(n, num_points, confidence, max_iterations);
+    }
+  }
+
+  // The sampled subset grows from the three best matches to every match over the first half of the iterations
+  growth = max_iterations / 2 > 1 ? max_iterations / 2 : 1;
+  for (iteration = 0; iteration < required_iterations; iteration++)
+  {
+    subset = 3 + (int)((long)(num_points - 3) * iteration / growth);
+    if (subset > num_points)
+    {
+      subset = num_points;
+    }
+
+    // While the subset grows each sample includes its newest match, so every match is tried soon after joining
+    sample[0] = subset < num_points ? subset - 1 : (int)(mar_affine_random(&state) % subset);
+    do
+    {
+      sample[1] = mar_affine_random(&state) % subset;
+    }
+    while (sample[1] == sample[0]);
+    do
+    {
+      sample[2] = mar_affine_random(&state) % subset;
+    }
+    while (sample[2] == sample[0] || sample[2] == sample[1]);
+
+    if (!mar_affine_from_sample(x, y, u, v, sample, &candidate))
+    {
+      continue;
+    }
+
+    n = mar_affine_find_inliers(x, y, u, v, num_points, &candidate, threshold, NULL);
+    if (n > best_inliers)
+    {
+      best_inliers = n;
+      *transform = candidate;
+
+      // Stop once a sample of only inliers has been tried with the requested confidence
+      n = mar_affine_required_iterations(n, num_points, confidence, max_iterations);
+      required_iterations = n < required_iterations ? n : required_iterations;
+    }
+  }
+
+  if (best_inliers < 3)
+  {
+    return MAR_ERROR_TOO_FEW_MATCHING_KEYPOINTS;
+  }
+
+  // Refine the transformation over its inliers, keeping refinements which do not lose inliers
+  best_inliers = mar_affine_find_inliers(x, y, u, v, num_points, transform, threshold, inliers);
+  for (i = 0; i < MAR_AFFINE_REFINEMENTS; i++)
+  {
+    if (mar_affine_fit(x, y, u, v, num_points, inliers, &refined) != MAR_ERROR_NONE)
+    {
+      break;
+    }
+    n = mar_affine_find_inliers(x, y, u, v, num_points, &refined, threshold, NULL);
+    if (n < best_inliers)
+    {
+      break;
+    }
+    *transform = refined;
+    best_inliers = mar_affine_find_inliers(x, y, u, v, num_points, transform, threshold, inliers);
+  }
+
+  *num_inliers = best_inliers;
+
+  return MAR_ERROR_NONE;
+}
+
+/**
+ * Fits the affine transformation mapping points (x, y) to their matches (u, v) by least squares.
+ *
+ * @param x The X coordinates of the points
+ * @param y The Y coordinates of the points
+ * @param u The X coordinates of the matches
+ * @param v The Y coordinates of the matches
+ * @param num_points The number of matched points
+ * @param inliers 1 for each match to fit and 0 for each match to ignore, or NULL to fit every match
+ * @param transform Will be filled with the transformation
+ *
+ * @return MAR_ERROR_NONE on success, MAR_ERROR_DEGENERATE_TRANSFORM if the points are collinear
+ */
+MAR_PUBLIC
+mar_error_code mar_affine_fit(const float *x, const float *y, const float *u, const float *v, int num_points,
+    const unsigned char *inliers, mar_affine *transform)
+{
+  double m[3][3] = { { 0 } }, ru[3] = { 0 }, rv[3] = { 0 }, s[3], scale = 1;
+  int i;
+
+  // The normal equations of the two output coordinates share the same 3x3 matrix
+  for (i = 0; i < num_points; i++)
+  {
+    if (inliers != NULL && !inliers[i])
+    {
+      continue;
+    }
+
+    m[0][0] += x[i] * x[i];
+    m[0][1] += x[i] * y[i];
+    m[0][2] += x[i];
+    m[1][1] += y[i] * y[i];
+    m[1][2] += y[i];
+    m[2][2] += 1;
+    ru[0] += x[i] * u[i];
+    ru[1] += y[i] * u[i];
+    ru[2] += u[i];
+    rv[0] += x[i] * v[i];
+    rv[1] += y[i] * v[i];
+    rv[2] += v[i];
+  }
+  m[1][0] = m[0][1];
+  m[2][0] = m[0][2];
+  m[2][1] = m[1][2];
+  scale = fmax(scale, fmax(m[0][0], fmax(m[1][1], m[2][2])));
+
+  if (!mar_affine_solve3((const double (*)[3])m, ru, s, scale))
+  {
+    return MAR_ERROR_DEGENERATE_TRANSFORM;
+  }
+  transform->a = s[0];
+  transform->b = s[1];
+  transform->tx = s[2];
+
+  mar_affine_solve3((const double (*)[3])m, rv, s, scale);
+  transform->c = s[0];
+  transform->d = s[1];
+  transform->ty = s[2];
+
+  return MAR_ERROR_NONE;
+}
+
+/**
+ * Inverts an affine transformation.
+ *
+ * @param transform The transformation
+ * @param inverse Will be filled with the inverse transformation
+ *
+ * @return MAR_ERROR_NONE on success, MAR_ERROR_DEGENERATE_TRANSFORM if the transformation is not invertible
+ */
+MAR_PUBLIC
+mar_error_code mar_affine_invert(const mar_affine *transform, mar_affine *inverse)
+{
+  double det = (double)transform->a * transform->d - (double)transform->b * transform->c;
+  mar_affine t = *transform;
+
+  if (fabs(det) <= MAR_AFFINE_SINGULAR_EPSILON)
+  {
+    return MAR_ERROR_DEGENERATE_TRANSFORM;
+  }
+
+  inverse->a = t.d / det;
+  inverse->b = -t.b / det;
+  inverse->c = -t.c / det;
+  inverse->d = t.a / det;
+  inverse->tx = -(inverse->a * t.tx + inverse->b * t.ty);
+  inverse->ty = -(inverse->c * t.tx + inverse->d * t.ty);
+
+  return MAR_ERROR_NONE;
+}
+
+/**
+ * Composes two affine transformations into the transformation which applies the first and then the second.
+ *
+ * @param first The transformation applied first
+ * @param second The transformation applied second
+ * @param composed Will be filled with the composed transformation, which may be either of the others
+ */
+MAR_PUBLIC
+void mar_affine_compose(const mar_affine *first, const mar_affine *second, mar_affine *composed)
+{
+  mar_affine t;
+
+  t.a = second->a * first->a + second->b * first->c;
+  t.b = second->a * first->b + second->b * first->d;
+  t.c = second->c * first->a + second->d * first->c;
+  t.d = second->c * first->b + second->d * first->d;
+  t.tx = second->a * first->tx + second->b * first->ty + second->tx;
+  t.ty = second->c * first->tx + second->d * first->ty + second->ty;
+  *composed = t;
+}
@@ -0,0 +1,104 @@
+/**
+ * @file mar_affine.h
+ *
+ * Contains a robust estimator for affine transformations between matched points.  Minimal three point
+ * samples are drawn progressively from the best matches first, the consensus set of the best sample is
+ * grown until enough samples have been tried to be confident, and the transformation is then refined in
+ * closed form by least squares over the inliers.
+ *
+ * @author Greg Eddington
+ */
+
+#ifndef MAR_AFFINE_H
+#define MAR_AFFINE_H
+
+#include "../common/mar_error.h"
+
+/** The default maximum number of samples tried by the estimator */
+#define MAR_AFFINE_DEFAULT_MAX_ITERATIONS 200
+/** The default distance in pixels from a transformed point to its match for the match to be an inlier */
+#define MAR_AFFINE_DEFAULT_INLIER_THRESHOLD 4.0f
+/** The default probability that at least one sample tried contains only inliers */
+#define MAR_AFFINE_DEFAULT_CONFIDENCE 0.995f
+/** The number of least squares refinements of the best sample's transformation */
+#define MAR_AFFINE_REFINEMENTS 2
+
+/**
+ * An affine transformation mapping (x, y) to (u, v) = (a*x + b*y + tx, c*x + d*y + ty) @return
+ */
+typedef struct
+{
+  /** The X scale and rotation of the X coordinate @return */
+  float a;
+  /** The X shear and rotation of the Y coordinate @return */
+  float b;
+  /** The Y shear and rotation of the X coordinate @return */
+  float c;
+  /** The Y scale and rotation of the Y coordinate @return */
+  float d;
+  /** The X translation @return */
+  float tx;
+  /** The Y translation @return */
+  float ty;
+}
+mar_affine;
+
+/**
+ * Robustly estimates the affine transformation mapping points (x, y) to their matches (u, v).  Matches should be
+ * ordered from the most to the least reliable, since samples are drawn from the first matches before the rest.
+ *
+ * @param x The X coordinates of the points
+ * @param y The Y coordinates of the points
+ * @param u The X coordinates of the matches
+ * @param v The Y coordinates of the matches
+ * @param num_points The number of matched points
+ * @param max_iterations The maximum number of samples to try
+ * @param inlier_threshold The distance from a transformed point to its match for the match to be an inlier
+ * @param confidence The probability that at least one sample tried contains only inliers, after which sampling stops
+ * @param initial A predicted transformation scored before any sample, which stops sampling early when it is good, or NULL
+ * @param transform Will be filled with the transformation
+ * @param inliers Will be filled with 1 for each inlier and 0 for each outlier, num_points values
+ * @param num_inliers Will be filled with the number of inliers
+ *
+ * @return MAR_ERROR_NONE on success, MAR_ERROR_TOO_FEW_MATCHING_KEYPOINTS if no non degenerate sample was found
+ */
+mar_error_code mar_affine_estimate(const float *x, const float *y, const float *u, const float *v, int num_points,
+    int max_iterations, float inlier_threshold, float confidence, const mar_affine *initial, mar_affine *transform, 
+    unsigned char *inliers, int *num_inliers);
+
+/**
+ * Fits the affine transformation mapping points (x, y) to their matches (u, v) by least squares.
+ *
+ * @param x The X coordinates of the points
+ * @param y The Y coordinates of the points
+ * @param u The X coordinates of the matches
+ * @param v The Y coordinates of the matches
+ * @param num_points The number of matched points
+ * @param inliers 1 for each match to fit and 0 for each match to ignore, or NULL to fit every match
+ * @param transform Will be filled with the transformation
+ *
+ * @return MAR_ERROR_NONE on success, MAR_ERROR_DEGENERATE_TRANSFORM if the points are collinear
+ */
+mar_error_code mar_affine_fit(const float *x, const float *y, const float *u, const float *v, int num_points,
+    const unsigned char *inliers, mar_affine *transform);
+
+/**
+ * Inverts an affine transformation.
+ *
+ * @param transform The transformation
+ * @param inverse Will be filled with the inverse transformation
+ *
+ * @return MAR_ERROR_NONE on success, MAR_ERROR_DEGENERATE_TRANSFORM if the transformation is not invertible
+ */
+mar_error_code mar_affine_invert(const mar_affine *transform, mar_affine *inverse);
+
+/**
+ * Composes two affine transformations into the transformation which applies the first and then the second.
+ *
+ * @param first The transformation applied first
+ * @param second The transformation applied second
+ * @param composed Will be filled with the composed transformation, which may be either of the others
+ */
+void mar_affine_compose(const mar_affine *first, const mar_affine *second, mar_affine *composed);
+
+#endif
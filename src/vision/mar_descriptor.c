@@ -0,0 +1,331 @@
+/**
+ * @file mar_descriptor.c
+ *
+ * Contains kernels for compact quantized SIFT descriptors.  Descriptors are quantized to one byte per
+ * value and compared with a sum of absolute differences, which is vectorized with SSE2, AVX2 or NEON
+ * when available.  Binary descriptors are compared by their Hamming distance, using the population
+ * count instruction when available.  The fastest kernel supported by the CPU is selected at runtime.
+ *
+ * @author Greg Eddington
+ */
+
+#include "../common/mar_common.h"
+#include "mar_descriptor.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+  #define MAR_DESCRIPTOR_X86
+  #include <immintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+  #define MAR_DESCRIPTOR_NEON
+  #include <arm_neon.h>
+#endif
+
+/**
+ * A set of descriptor kernels for one instruction set
+ */
+typedef struct
+{
+  /** The instruction set name */
+  const char *name;
+  /** Computes the sums of absolute differences between a descriptor and a block of descriptors */
+  void (*sad)(const unsigned char *query, const unsigned char *rows, int num_rows, unsigned int *distances);
+  /** Computes the Hamming distances between a binary descriptor and a block of binary descriptors */
+  void (*hamming)(const unsigned char *query, const unsigned char *rows, int num_rows, unsigned int *distances);
+}
+mar_descriptor_kernels;
+
+/** The descriptor kernels selected for the running CPU @return */
+MAR_PRIVATE const mar_descriptor_kernels *mar_descriptor_selected_kernels = NULL;
+
+/** Scalar sum of absolute differences kernel */
+MAR_PRIVATE
+void mar_descriptor_sad_scalar(const unsigned char *query, const unsigned char *rows, int num_rows, unsigned int *distances)
+{
+  int i, j;
+  unsigned int sum;
+
+  for (i = 0; i < num_rows; i++, rows += MAR_DESCRIPTOR_LENGTH)
+  {
+    sum = 0;
+    for (j = 0; j < MAR_DESCRIPTOR_LENGTH; j++)
+    {
+      sum += query[j] > rows[j] ? query[j] - rows[j] : rows[j] - query[j];
+    }
+    distances[i] = sum;
+  }
+}
+
+/** Scalar Hamming distance kernel, 64 bits at a time */
+MAR_PRIVATE
+void mar_descriptor_hamming_scalar(const unsigned char *query, const unsigned char *rows, int num_rows, unsigned int *distances)
+{
+  int i, j;
+  uint64_t q[MAR_DESCRIPTOR_BINARY_BYTES / 8], r[MAR_DESCRIPTOR_BINARY_BYTES / 8];
+  unsigned int sum;
+
+  // Rows are only byte aligned, so they are copied into words
+  memcpy(q, query, sizeof(q));
+  for (i = 0; i < num_rows; i++, rows += MAR_DESCRIPTOR_BINARY_BYTES)
+  {
+    memcpy(r, rows, sizeof(r));
+    sum = 0;
+    for (j = 0; j < MAR_DESCRIPTOR_BINARY_BYTES / 8; j++)
+    {
+      sum += __builtin_popcountll(q[j] ^ r[j]);
+    }
+    distances[i] = sum;
+  }
+}
+
+/** The scalar descriptor kernels @return */
+MAR_PRIVATE const mar_descriptor_kernels mar_descriptor_scalar_kernels =
+{
+  "scalar",
+  mar_descriptor_sad_scalar,
+  mar_descriptor_hamming_scalar
+};
+
+#ifdef MAR_DESCRIPTOR_X86
+
+/** SSE2 sum of absolute differences kernel, the query is held in 8 registers */
+MAR_PRIVATE
+void mar_descriptor_sad_sse2(const unsigned char *query, const unsigned char *rows, int num_rows, unsigned int *distances)
+{
+  int i, j;
+  __m128i q[MAR_DESCRIPTOR_LENGTH / 16], sum;
+
+  for (j = 0; j < MAR_DESCRIPTOR_LENGTH / 16; j++)
+  {
+    q[j] = _mm_loadu_si128((const __m128i *)(query + j*16));
+  }
+
+  for (i = 0; i < num_rows; i++, rows += MAR_DESCRIPTOR_LENGTH)
+  {
+    sum = _mm_setzero_si128();
+    for (j = 0; j < MAR_DESCRIPTOR_LENGTH / 16; j++)
+    {
+      sum = _mm_add_epi64(sum, _mm_sad_epu8(q[j], _mm_loadu_si128((const __m128i *)(rows + j*16))));
+    }
+
+    // Each 64-bit half holds the sum of 8 of the 16 bytes
+    distances[i] = _mm_cvtsi128_si32(_mm_add_epi64(sum, _mm_unpackhi_epi64(sum, sum)));
+  }
+}
+
+/** The SSE2 descriptor kernels @return */
+MAR_PRIVATE const mar_descriptor_kernels mar_descriptor_sse2_kernels =
+{
+  "sse2",
+  mar_descriptor_sad_sse2,
+  mar_descriptor_hamming_scalar
+};
+
+/** AVX2 sum of absolute differences kernel, the query is held in 4 registers */
+MAR_PRIVATE __attribute__((target("avx2")))
+void mar_descriptor_sad_avx2(const unsigned char *query, const unsigned char *rows, int num_rows, unsigned int *distances)
+{
+  int i, j;
+  __m256i q[MAR_DESCRIPTOR_LENGTH / 32], sum;
+  __m128i half;
+
+  for (j = 0; j < MAR_DESCRIPTOR_LENGTH / 32; j++)
+  {
+    q[j] = _mm256_loadu_si256((const __m256i *)(query + j*32));
+  }
+
+  for (i = 0; i < num_rows; i++, rows += MAR_DESCRIPTOR_LENGTH)
+  {
+    sum = _mm256_setzero_si256();
+    for (j = 0; j < MAR_DESCRIPTOR_LENGTH / 32; j++)
+    {
+      sum = _mm256_add_epi64(sum, _mm256_sad_epu8(q[j], _mm256_loadu_si256((const __m256i *)(rows + j*32))));
+    }
+
+    // Fold the four 64-bit partial sums
+    half = _mm_add_epi64(_mm256_castsi256_si128(sum), _mm256_extracti128_si256(sum, 1));
+    distances[i] = _mm_cvtsi128_si32(_mm_add_epi64(half, _mm_unpackhi_epi64(half, half)));
+  }
+}
+
+/** Hamming distance kernel using the population count instruction, which every AVX2 CPU has */
+MAR_PRIVATE __attribute__((target("popcnt")))
+void mar_descriptor_hamming_popcnt(const unsigned char *query, const unsigned char *rows, int num_rows, unsigned int *distances)
+{
+  int i, j;
+  uint64_t q[MAR_DESCRIPTOR_BINARY_BYTES / 8], r[MAR_DESCRIPTOR_BINARY_BYTES / 8];
+  unsigned int sum;
+
+  memcpy(q, query, sizeof(q));
+  for (i = 0; i < num_rows; i++, rows += MAR_DESCRIPTOR_BINARY_BYTES)
+  {
+    memcpy(r, rows, sizeof(r));
+    sum = 0;
+    for (j = 0; j < MAR_DESCRIPTOR_BINARY_BYTES / 8; j++)
+    {
+      sum += __builtin_popcountll(q[j] ^ r[j]);
+    }
+    distances[i] = sum;
+  }
+}
+
+/** The AVX2 descriptor kernels @return */
+MAR_PRIVATE const mar_descriptor_kernels mar_descriptor_avx2_kernels =
+{
+  "avx2",
+  mar_descriptor_sad_avx2,
+  mar_descriptor_hamming_popcnt
+};
+
+#endif
+
+#ifdef MAR_DESCRIPTOR_NEON
+
+/** NEON sum of absolute differences kernel, 16 bytes per iteration */
+MAR_PRIVATE
+void mar_descriptor_sad_neon(const unsigned char *query, const unsigned char *rows, int num_rows, unsigned int *distances)
+{
+  int i, j;
+  uint16x8_t sum;
+  uint64x2_t total;
+
+  for (i = 0; i < num_rows; i++, rows += MAR_DESCRIPTOR_LENGTH)
+  {
+    // Each 16-bit lane gathers at most 16 differences, so it cannot overflow
+    sum = vdupq_n_u16(0);
+    for (j = 0; j < MAR_DESCRIPTOR_LENGTH; j += 16)
+    {
+      sum = vpadalq_u8(sum, vabdq_u8(vld1q_u8(query + j), vld1q_u8(rows + j)));
+    }
+
+    total = vpaddlq_u32(vpaddlq_u16(sum));
+    distances[i] = (unsigned int)(vgetq_lane_u64(total, 0) + vgetq_lane_u64(total, 1));
+  }
+}
+
+/** NEON Hamming distance kernel, counting the bits of each byte and then summing the counts */
+MAR_PRIVATE
+void mar_descriptor_hamming_neon(const unsigned char *query, const unsigned char *rows, int num_rows, unsigned int *distances)
+{
+  int i;
+  uint8x16_t q0, q1;
+  uint16x8_t sum;
+  uint64x2_t total;
+
+  q0 = vld1q_u8(query);
+  q1 = vld1q_u8(query + 16);
+  for (i = 0; i < num_rows; i++, rows += MAR_DESCRIPTOR_BINARY_BYTES)
+  {
+    sum = vpaddlq_u8(vcntq_u8(veorq_u8(q0, vld1q_u8(rows))));
+    sum = vpadalq_u8(sum, vcntq_u8(veorq_u8(q1, vld1q_u8(rows + 16))));
+
+    total = vpaddlq_u32(vpaddlq_u16(sum));
+    distances[i] = (unsigned int)(vgetq_lane_u64(total, 0) + vgetq_lane_u64(total, 1));
+  }
+}
+
+/** The NEON descriptor kernels @return */
+MAR_PRIVATE const mar_descriptor_kernels mar_descriptor_neon_kernels =
+{
+  "neon",
+  mar_descriptor_sad_neon,
+  mar_descriptor_hamming_neon
+};
+
+#endif
+
+/**
+ * Returns the fastest descriptor kernels supported by the CPU, selecting them on first use.
+ *
+ * @return The descriptor kernels
+ */
+MAR_PRIVATE
+const mar_descriptor_kernels *mar_descriptor_get_kernels()
+{
+  if (mar_descriptor_selected_kernels == NULL)
+  {
+#if defined(MAR_DESCRIPTOR_X86)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+    {
+      mar_descriptor_selected_kernels = &mar_descriptor_avx2_kernels;
+    }
+    else if (__builtin_cpu_supports("sse2"))
+    {
+      mar_descriptor_selected_kernels = &mar_descriptor_sse2_kernels;
+    }
+    else
+    {
+      mar_descriptor_selected_kernels = &mar_descriptor_scalar_kernels;
+    }
+#elif defined(MAR_DESCRIPTOR_NEON)
+    mar_descriptor_selected_kernels = &mar_descriptor_neon_kernels;
+#else
+    mar_descriptor_selected_kernels = &mar_descriptor_scalar_kernels;
+#endif
+  }
+
+  return mar_descriptor_selected_kernels;
+}
+
+/**
+ * Quantizes a SIFT descriptor to one byte per value, saturating values above 255 / MAR_DESCRIPTOR_QUANTIZATION_SCALE.
+ *
+ * @param descriptor The descriptor, MAR_DESCRIPTOR_LENGTH values
+ * @param quantized The quantized descriptor, MAR_DESCRIPTOR_LENGTH bytes
+ */
+MAR_PUBLIC
+void mar_descriptor_quantize(const float *descriptor, unsigned char *quantized)
+{
+  int i;
+  float v;
+
+  for (i = 0; i < MAR_DESCRIPTOR_LENGTH; i++)
+  {
+    v = descriptor[i] * MAR_DESCRIPTOR_QUANTIZATION_SCALE + 0.5f;
+    quantized[i] = v <= 0 ? 0 : (v >= 255 ? 255 : (unsigned char)v);
+  }
+}
+
+/**
+ * Computes the sum of absolute differences between a quantized descriptor and each of a block of quantized descriptors.
+ * Dividing a sum by MAR_DESCRIPTOR_QUANTIZATION_SCALE gives the L1 distance of the original descriptors.
+ *
+ * @param query The quantized descriptor, MAR_DESCRIPTOR_LENGTH bytes
+ * @param rows The block of quantized descriptors stored one after another, MAR_DESCRIPTOR_LENGTH * num_rows bytes
+ * @param num_rows The number of descriptors in the block
+ * @param distances Will be filled with the sum of absolute differences to each descriptor, num_rows values
+ */
+MAR_PUBLIC
+void mar_descriptor_sad(const unsigned char *query, const unsigned char *rows, int num_rows, unsigned int *distances)
+{
+  mar_descriptor_get_kernels()->sad(query, rows, num_rows, distances);
+}
+
+/**
+ * Computes the Hamming distance between a binary descriptor and each of a block of binary descriptors.
+ *
+ * @param query The binary descriptor, MAR_DESCRIPTOR_BINARY_BYTES bytes
+ * @param rows The block of binary descriptors stored one after another, MAR_DESCRIPTOR_BINARY_BYTES * num_rows bytes
+ * @param num_rows The number of descriptors in the block
+ * @param distances Will be filled with the number of bits which differ from each descriptor, num_rows values
+ */
+MAR_PUBLIC
+void mar_descriptor_hamming(const unsigned char *query, const unsigned char *rows, int num_rows, unsigned int *distances)
+{
+  mar_descriptor_get_kernels()->hamming(query, rows, num_rows, distances);
+}
+
+/**
+ * Returns the name of the instruction set used by the descriptor kernels.
+ *
+ * @return "avx2", "sse2", "neon" or "scalar"
+ */
+MAR_PUBLIC
+const char *mar_descriptor_get_kernel_name()
+{
+  return mar_descriptor_get_kernels()->name;
+}
@@ -0,0 +1,62 @@
+/**
+ * @file mar_descriptor.h
+ *
+ * Contains kernels for compact quantized SIFT descriptors.  Descriptors are quantized to one byte per
+ * value and compared with a sum of absolute differences, which is vectorized with SSE2, AVX2 or NEON
+ * when available.  Binary descriptors are compared by their Hamming distance, using the population
+ * count instruction when available.
+ *
+ * @author Greg Eddington
+ */
+
+#ifndef MAR_DESCRIPTOR_H
+#define MAR_DESCRIPTOR_H
+
+#include "mar_sift.h"
+
+/** The number of values in a SIFT descriptor */
+#define MAR_DESCRIPTOR_LENGTH (MAR_SIFT_NBO * MAR_SIFT_NBP * MAR_SIFT_NBP)
+
+/** The scale applied to SIFT descriptor values before rounding them to a byte, SIFT values rarely exceed 0.5 */
+#define MAR_DESCRIPTOR_QUANTIZATION_SCALE 512.0f
+
+/** The number of bytes of a binary descriptor, one bit per test */
+#define MAR_DESCRIPTOR_BINARY_BYTES 32
+
+/**
+ * Quantizes a SIFT descriptor to one byte per value, saturating values above 255 / MAR_DESCRIPTOR_QUANTIZATION_SCALE.
+ *
+ * @param descriptor The descriptor, MAR_DESCRIPTOR_LENGTH values
+ * @param quantized The quantized descriptor, MAR_DESCRIPTOR_LENGTH bytes
+ */
+void mar_descriptor_quantize(const float *descriptor, unsigned char *quantized);
+
+/**
+ * Computes the sum of absolute differences between a quantized descriptor and each of a block of quantized descriptors.
+ * Dividing a sum by MAR_DESCRIPTOR_QUANTIZATION_SCALE gives the L1 distance of the original descriptors.
+ *
+ * @param query The quantized descriptor, MAR_DESCRIPTOR_LENGTH bytes
+ * @param rows The block of quantized descriptors stored one after another, MAR_DESCRIPTOR_LENGTH * num_rows bytes
+ * @param num_rows The number of descriptors in the block
+ * @param distances Will be filled with the sum of absolute differences to each descriptor, num_rows values
+ */
+void mar_descriptor_sad(const unsigned char *query, const unsigned char *rows, int num_rows, unsigned int *distances);
+
+/**
+ * Computes the Hamming distance between a binary descriptor and each of a block of binary descriptors.
+ *
+ * @param query The binary descriptor, MAR_DESCRIPTOR_BINARY_BYTES bytes
+ * @param rows The block of binary descriptors stored one after another, MAR_DESCRIPTOR_BINARY_BYTES * num_rows bytes
+ * @param num_rows The number of descriptors in the block
+ * @param distances Will be filled with the number of bits which differ from each descriptor, num_rows values
+ */
+void mar_descriptor_hamming(const unsigned char *query, const unsigned char *rows, int num_rows, unsigned int *distances);
+
+/**
+ * Returns the name of the instruction set used by the descriptor kernels.
+ *
+ * @return "avx2", "sse2", "neon" or "scalar"
+ */
+const char *mar_descriptor_get_kernel_name();
+
+#endif
@@ -0,0 +1,248 @@
+/**
+ * @file mar_features.c
+ *
+ * Contains a keypoint detector which can be backed by SIFT or by FAST corners with rotated BRIEF descriptors.
+ * Both backends detect from a frame's image pyramid and return keypoints of the same type, so the rest of the
+ * library does not depend on which one is used.  SIFT descriptors are compared by L1 distance and binary
+ * descriptors by Hamming distance, so matching thresholds depend on the backend.
+ *
+ * @author Greg Eddington
+ */
+
+#include "../common/mar_common.h"
+#include "mar_features.h"
+
+#include <stddef.h>
+
+/**
+ * Creates a new keypoint detector backed by SIFT.  Must be called before calling other functions on the detector.
+ *
+ * @param ctx The detector
+ * @param width The width of the camera frame
+ * @param height The height of the camera frame
+ * @param number_of_octaves The number of octaves to use in SIFT, MAR_SIFT_MAX_OCTAVES for the maximum
+ * @param number_of_levels The number of levels of each octave
+ * @param first_octave The index of the first octave
+ *
+ * @return MAR_ERROR_NONE on success, an error code on failure.
+ */
+MAR_PUBLIC
+mar_error_code mar_features_ctx_new_sift(mar_features_ctx *ctx, int width, int height, int number_of_octaves, int number_of_levels, int first_octave)
+{
+  MAR_CLEAR(*ctx);
+  ctx->backend = MAR_FEATURES_SIFT;
+  ctx->sift_number_of_octaves = number_of_octaves;
+  ctx->sift_first_octave = first_octave;
+
+  return mar_sift_ctx_new(&ctx->sift, width, height, number_of_octaves, number_of_levels, first_octave);
+}
+
+/**
+ * Creates a new keypoint detector backed by FAST corners with rotated BRIEF descriptors.  Must be called before
+ * calling other functions on the detector.
+ *
+ * @param ctx The detector
+ * @param width The width of the camera frame
+ * @param height The height of the camera frame
+ * @param number_of_levels The number of image pyramid levels to detect corners in
+ * @param fast_threshold The difference a pixel of the circle around a corner must have to the corner to count toward it
+ * @param max_keypoints The maximum number of keypoints detected in a frame
+ *
+ * @return MAR_ERROR_NONE on success, an error code on failure.
+ */
+MAR_PUBLIC
+mar_error_code mar_features_ctx_new_orb(mar_features_ctx *ctx, int width, int height, int number_of_levels, int fast_threshold, int max_keypoints)
+{
+  MAR_CLEAR(*ctx);
+  ctx->backend = MAR_FEATURES_ORB;
+
+  return mar_orb_ctx_new(&ctx->orb, width, height, number_of_levels, fast_threshold, max_keypoints);
+}
+
+/**
+ * Frees a detector created by mar_features_ctx_new_sift or mar_features_ctx_new_orb.  A cleared detector may also be freed.
+ *
+ * @param ctx The detector
+ */
+MAR_PUBLIC
+void mar_features_ctx_free(mar_features_ctx *ctx)
+{
+  switch (ctx->backend)
+  {
+    case MAR_FEATURES_SIFT:
+      mar_sift_ctx_free(&ctx->sift);
+      break;
+    case MAR_FEATURES_ORB:
+      mar_orb_ctx_free(&ctx->orb);
+      break;
+  }
+  MAR_CLEAR(*ctx);
+}
+
+/**
+ * Returns the SIFT detector of a detector backed by SIFT, so that its thresholds can be configured.
+ *
+ * @param ctx The detector
+ *
+ * @return The SIFT detector, or NULL if the backend is not MAR_FEATURES_SIFT
+ */
+MAR_PUBLIC
+mar_sift_ctx *mar_features_ctx_get_sift(mar_features_ctx *ctx)
+{
+  return ctx->backend == MAR_FEATURES_SIFT ? &ctx->sift : NULL;
+}
+
+/**
+ * Returns the FAST and rotated BRIEF detector of a detector backed by it, so that its thresholds can be configured.
+ *
+ * @param ctx The detector
+ *
+ * @return The FAST and rotated BRIEF detector, or NULL if the backend is not MAR_FEATURES_ORB
+ */
+MAR_PUBLIC
+mar_orb_ctx *mar_features_ctx_get_orb(mar_features_ctx *ctx)
+{
+  return ctx->backend == MAR_FEATURES_ORB ? &ctx->orb : NULL;
+}
+
+/**
+ * Skips the finest scales of detection, the first SIFT octaves or the first pyramid levels of FAST corners,
+ * trading small keypoints for speed.  At least one scale is always kept.
+ *
+ * @param ctx The detector
+ * @param scale_skip The number of scales to skip
+ *
+ * @return MAR_ERROR_NONE on success, an error code on failure.
+ */
+MAR_PUBLIC
+mar_error_code mar_features_ctx_set_scale_skip(mar_features_ctx *ctx, int scale_skip)
+{
+  mar_error_code mrv = MAR_ERROR_NONE;
+  int number_of_octaves;
+
+  if (scale_skip < 0)
+  {
+    return MAR_ERROR_INVALID_ARGUMENT;
+  }
+  if (scale_skip == ctx->scale_skip)
+  {
+    return MAR_ERROR_NONE;
+  }
+
+  switch (ctx->backend)
+  {
+    case MAR_FEATURES_SIFT:
+      number_of_octaves = ctx->sift_number_of_octaves;
+      if (number_of_octaves != MAR_SIFT_MAX_OCTAVES)
+      {
+        number_of_octaves = number_of_octaves - scale_skip > 1 ? number_of_octaves - scale_skip : 1;
+      }
+      mrv = mar_sift_ctx_set_octaves(&ctx->sift, number_of_octaves, ctx->sift_first_octave + scale_skip);
+      break;
+    case MAR_FEATURES_ORB:
+      mrv = mar_orb_ctx_set_first_level(&ctx->orb, scale_skip < ctx->orb.number_of_levels ? scale_skip : ctx->orb.number_of_levels - 1);
+      break;
+    default:
+      return MAR_ERROR_INVALID_ARGUMENT;
+  }
+  if (mrv != MAR_ERROR_NONE)
+  {
+    return mrv;
+  }
+  ctx->scale_skip = scale_skip;
+
+  return MAR_ERROR_NONE;
+}
+
+/**
+ * Changes the octaves of a detector backed by SIFT, recreating its filters.  The finest scales skipped by
+ * mar_features_ctx_set_scale_skip stay skipped from the new octaves.
+ *
+ * @param ctx The detector
+ * @param number_of_octaves The number of octaves to use in SIFT, MAR_SIFT_MAX_OCTAVES for the maximum
+ * @param first_octave The index of the first octave
+ *
+ * @return MAR_ERROR_NONE on success, MAR_ERROR_INVALID_ARGUMENT if the backend is not MAR_FEATURES_SIFT, an error code on failure.
+ */
+MAR_PUBLIC
+mar_error_code mar_features_ctx_set_sift_octaves(mar_features_ctx *ctx, int number_of_octaves, int first_octave)
+{
+  mar_error_code mrv;
+  int scale_skip = ctx->scale_skip, previous_number_of_octaves = ctx->sift_number_of_octaves, previous_first_octave = ctx->sift_first_octave;
+
+  if (ctx->backend != MAR_FEATURES_SIFT)
+  {
+    return MAR_ERROR_INVALID_ARGUMENT;
+  }
+  if (number_of_octaves == ctx->sift_number_of_octaves && first_octave == ctx->sift_first_octave)
+  {
+    return MAR_ERROR_NONE;
+  }
+
+  // Recreate the filters at the new octaves less the skipped scales
+  ctx->sift_number_of_octaves = number_of_octaves;
+  ctx->sift_first_octave = first_octave;
+  ctx->scale_skip = -1;
+  mrv = mar_features_ctx_set_scale_skip(ctx, scale_skip);
+  if (mrv != MAR_ERROR_NONE)
+  {
+    // The filters are unchanged on failure
+    ctx->sift_number_of_octaves = previous_number_of_octaves;
+    ctx->sift_first_octave = previous_first_octave;
+    ctx->scale_skip = scale_skip;
+  }
+
+  return mrv;
+}
+
+/**
+ * Calculates and returns the keypoints of a camera frame from its image pyramid.
+ *
+ * @param ctx The detector
+ * @param keypoints A pointer to a pointer which will be modified to point to the array of keypoints.
+ * @param num_keypoints The number of keypoints
+ * @param pyramid The image pyramid of the frame
+ *
+ * @return MAR_ERROR_NONE on success, an error code on failure.
+ */
+MAR_PUBLIC
+mar_error_code mar_features_ctx_get_keypoints(mar_features_ctx *ctx, mar_sift_keypoint **keypoints, int *num_keypoints, mar_image_pyramid *pyramid)
+{
+  switch (ctx->backend)
+  {
+    case MAR_FEATURES_SIFT:
+      return mar_sift_ctx_get_keypoints_from_grayscale(&ctx->sift, keypoints, num_keypoints, mar_image_pyramid_get_grayf(pyramid));
+    case MAR_FEATURES_ORB:
+      return mar_orb_ctx_get_keypoints(&ctx->orb, keypoints, num_keypoints, pyramid);
+  }
+
+  return MAR_ERROR_INVALID_ARGUMENT;
+}
+
+/**
+ * Calculates and returns the keypoints within regions of a camera frame from its image pyramid.
+ *
+ * @param ctx The detector
+ * @param keypoints A pointer to a pointer which will be modified to point to the array of keypoints.
+ * @param num_keypoints The number of keypoints
+ * @param pyramid The image pyramid of the frame
+ * @param regions The regions of the frame to detect keypoints in, in frame coordinates
+ * @param num_regions The number of regions, at most MAR_SIFT_MAX_REGIONS
+ *
+ * @return MAR_ERROR_NONE on success, an error code on failure.
+ */
+MAR_PUBLIC
+mar_error_code mar_features_ctx_get_keypoints_from_regions(mar_features_ctx *ctx, mar_sift_keypoint **keypoints, int *num_keypoints,
+    mar_image_pyramid *pyramid, const mar_sift_region *regions, int num_regions)
+{
+  switch (ctx->backend)
+  {
+    case MAR_FEATURES_SIFT:
+      return mar_sift_ctx_get_keypoints_from_grayscale_regions(&ctx->sift, keypoints, num_keypoints, mar_image_pyramid_get_grayf(pyramid),
+          regions, num_regions);
+    case MAR_FEATURES_ORB:
+      return mar_orb_ctx_get_keypoints_from_regions(&ctx->orb, keypoints, num_keypoints, pyramid, regions, num_regions);
+  }
+
+  return MAR_ERROR_INVALID_ARGUMENT;
+}
@@ -0,0 +1,157 @@
+/**
+ * @file mar_features.h
+ *
+ * Contains a keypoint detector which can be backed by SIFT or by FAST corners with rotated BRIEF descriptors.
+ * Both backends detect from a frame's image pyramid and return keypoints of the same type, so the rest of the
+ * library does not depend on which one is used.  SIFT descriptors are compared by L1 distance and binary
+ * descriptors by Hamming distance, so matching thresholds depend on the backend.
+ *
+ * @author Greg Eddington
+ */
+
+#ifndef MAR_FEATURES_H
+#define MAR_FEATURES_H
+
+#include "../common/mar_error.h"
+#include "../common/mar_image_pyramid.h"
+#include "mar_orb.h"
+#include "mar_sift.h"
+
+/** \defgroup feature_backends Feature Backends
+ * @{
+ */
+/** SIFT keypoints with floating point descriptors */
+#define MAR_FEATURES_SIFT 0
+/** FAST corners with rotated BRIEF binary descriptors */
+#define MAR_FEATURES_ORB  1
+/** @} */
+
+/** The feature backend used by default */
+#define MAR_FEATURES_DEFAULT_BACKEND MAR_FEATURES_SIFT
+
+/**
+ * A keypoint detector of either backend.  A detector may only be used by one thread at a time, but separate
+ * detectors may be used from separate threads at once.
+ */
+typedef struct
+{
+  /** The feature backend @return Read-Only */
+  int backend;
+  /** The SIFT detector, when the backend is MAR_FEATURES_SIFT @return Do not access directly when using the library */
+  mar_sift_ctx sift;
+  /** The FAST and rotated BRIEF detector, when the backend is MAR_FEATURES_ORB @return Do not access directly when using the library */
+  mar_orb_ctx orb;
+  /** The number of octaves the SIFT detector was created with @return Do not access directly when using the library */
+  int sift_number_of_octaves;
+  /** The first octave the SIFT detector was created with @return Do not access directly when using the library */
+  int sift_first_octave;
+  /** The number of the finest scales currently skipped @return Read-Only */
+  int scale_skip;
+}
+mar_features_ctx;
+
+/**
+ * Creates a new keypoint detector backed by SIFT.  Must be called before calling other functions on the detector.
+ *
+ * @param ctx The detector
+ * @param width The width of the camera frame
+ * @param height The height of the camera frame
+ * @param number_of_octaves The number of octaves to use in SIFT, MAR_SIFT_MAX_OCTAVES for the maximum
+ * @param number_of_levels The number of levels of each octave
+ * @param first_octave The index of the first octave
+ *
+ * @return MAR_ERROR_NONE on success, an error code on failure.
+ */
+mar_error_code mar_features_ctx_new_sift(mar_features_ctx *ctx, int width, int height, int number_of_octaves, int number_of_levels, int first_octave);
+
+/**
+ * Creates a new keypoint detector backed by FAST corners with rotated BRIEF descriptors.  Must be called before
+ * calling other functions on the detector.
+ *
+ * @param ctx The detector
+ * @param width The width of the camera frame
+ * @param height The height of the camera frame
+ * @param number_of_levels The number of image pyramid levels to detect corners in
+ * @param fast_threshold The difference a pixel of the circle around a corner must have to the corner to count toward it
+ * @param max_keypoints The maximum number of keypoints detected in a frame
+ *
+ * @return MAR_ERROR_NONE on success, an error code on failure.
+ */
+mar_error_code mar_features_ctx_new_orb(mar_features_ctx *ctx, int width, int height, int number_of_levels, int fast_threshold, int max_keypoints);
+
+/**
+ * Frees a detector created by mar_features_ctx_new_sift or mar_features_ctx_new_orb.  A cleared detector may also be freed.
+ *
+ * @param ctx The detector
+ */
+void mar_features_ctx_free(mar_features_ctx *ctx);
+
+/**
+ * Returns the SIFT detector of a detector backed by SIFT, so that its thresholds can be configured.
+ *
+ * @param ctx The detector
+ *
+ * @return The SIFT detector, or NULL if the backend is not MAR_FEATURES_SIFT
+ */
+mar_sift_ctx *mar_features_ctx_get_sift(mar_features_ctx *ctx);
+
+/**
+ * Returns the FAST and rotated BRIEF detector of a detector backed by it, so that its thresholds can be configured.
+ *
+ * @param ctx The detector
+ *
+ * @return The FAST and rotated BRIEF detector, or NULL if the backend is not MAR_FEATURES_ORB
+ */
+mar_orb_ctx *mar_features_ctx_get_orb(mar_features_ctx *ctx);
+
+/**
+ * Skips the finest scales of detection, the first SIFT octaves or the first pyramid levels of FAST corners,
+ * trading small keypoints for speed.  At least one scale is always kept.
+ *
+ * @param ctx The detector
+ * @param scale_skip The number of scales to skip
+ *
+ * @return MAR_ERROR_NONE on success, an error code on failure.
+ */
+mar_error_code mar_features_ctx_set_scale_skip(mar_features_ctx *ctx, int scale_skip);
+
+/**
+ * Changes the octaves of a detector backed by SIFT, recreating its filters.  The finest scales skipped by
+ * mar_features_ctx_set_scale_skip stay skipped from the new octaves.
+ *
+ * @param ctx The detector
+ * @param number_of_octaves The number of octaves to use in SIFT, MAR_SIFT_MAX_OCTAVES for the maximum
+ * @param first_octave The index of the first octave
+ *
+ * @return MAR_ERROR_NONE on success, MAR_ERROR_INVALID_ARGUMENT if the backend is not MAR_FEATURES_SIFT, an error code on failure.
+ */
+mar_error_code mar_features_ctx_set_sift_octaves(mar_features_ctx *ctx, int number_of_octaves, int first_octave);
+
+/**
+ * Calculates and returns the keypoints of a camera frame from its image pyramid.
+ *
+ * @param ctx The detector
+ * @param keypoints A pointer to a pointer which will be modified to point to the array of keypoints.
+ * @param num_keypoints The number of keypoints
+ * @param pyramid The image pyramid of the frame
+ *
+ * @return MAR_ERROR_NONE on success, an error code on failure.
+ */
+mar_error_code mar_features_ctx_get_keypoints(mar_features_ctx *ctx, mar_sift_keypoint **keypoints, int *num_keypoints, mar_image_pyramid *pyramid);
+
+/**
+ * Calculates and returns the keypoints within regions of a camera frame from its image pyramid.
+ *
+ * @param ctx The detector
+ * @param keypoints A pointer to a pointer which will be modified to point to the array of keypoints.
+ * @param num_keypoints The number of keypoints
+ * @param pyramid The image pyramid of the frame
+ * @param regions The regions of the frame to detect keypoints in, in frame coordinates
+ * @param num_regions The number of regions, at most MAR_SIFT_MAX_REGIONS
+ *
+ * @return MAR_ERROR_NONE on success, an error code on failure.
+ */
+mar_error_code mar_features_ctx_get_keypoints_from_regions(mar_features_ctx *ctx, mar_sift_keypoint **keypoints, int *num_keypoints,
+    mar_image_pyramid *pyramid, const mar_sift_region *regions, int num_regions);
+
+#endif
@@ -0,0 +1,221 @@
+/**
+ * @file mar_keypoint_grid.c
+ *
+ * Contains a uniform grid spatial index over the SIFT keypoints of a frame.  The grid is built once per
+ * frame by bucketing keypoints into square cells, so finding the keypoints within an ellipse only tests
+ * the keypoints of the cells overlapping the ellipse's bounding box.
+ *
+ * @author Greg Eddington
+ */
+
+#include "../common/mar_common.h"
+#include "mar_keypoint_grid.h"
+
+#include <math.h>
+#include <string.h>
+
+/**
+ * Returns the column or row of the cell containing a coordinate, clamped to the grid.
+ *
+ * @param coordinate The coordinate
+ * @param cell_size The width and height of a cell
+ * @param num_cells The number of columns or rows
+ *
+ * @return The column or row
+ */
+MAR_PRIVATE
+int mar_keypoint_grid_cell(float coordinate, int cell_size, int num_cells)
+{
+  // Coordinates outside of the frame, including NaN, fall into the nearest edge cell
+  if (!(coordinate >= 0))
+  {
+    return 0;
+  }
+  if (coordinate >= (float)cell_size * num_cells)
+  {
+    return num_cells - 1;
+  }
+
+  return (int)(coordinate / cell_size);
+}
+
+/**
+ * Creates an empty keypoint grid covering a frame.
+ *
+ * @param grid The grid to create
+ * @param width The width of the frame
+ * @param height The height of the frame
+ * @param cell_size The width and height in pixels of a cell
+ *
+ * @return MAR_ERROR_NONE on success, an error code on failure
+ */
+MAR_PUBLIC
+mar_error_code mar_keypoint_grid_new(mar_keypoint_grid *grid, int width, int height, int cell_size)
+{
+  MAR_CLEAR(*grid);
+
+  if (width <= 0 || height <= 0 || cell_size <= 0)
+  {
+    return MAR_ERROR_INVALID_ARGUMENT;
+  }
+
+  grid->cell_size = cell_size;
+  grid->columns = (width + cell_size - 1) / cell_size;
+  grid->rows = (height + cell_size - 1) / cell_size;
+  grid->cell_start = (int *)mar_calloc(grid->columns * grid->rows + 1, sizeof(int));
+  if (grid->cell_start == NULL)
+  {
+    return MAR_ERROR_MALLOC;
+  }
+
+  return MAR_ERROR_NONE;
+}
+
+/**
+ * Frees a keypoint grid.
+ *
+ * @param grid The grid to free
+ */
+MAR_PUBLIC
+void mar_keypoint_grid_free(mar_keypoint_grid *grid)
+{
+  mar_free(grid->cell_start);
+  mar_free(grid->order);
+  mar_free(grid->x);
+  mar_free(grid->y);
+  MAR_CLEAR(*grid);
+}
+
+/**
+ * Buckets the keypoints of a frame into a grid, replacing the keypoints of the previous frame.
+ *
+ * @param grid The grid
+ * @param keypoints The keypoints of the frame
+ * @param num_keypoints The number of keypoints
+ *
+ * @return MAR_ERROR_NONE on success, an error code on failure
+ */
+MAR_PUBLIC
+mar_error_code mar_keypoint_grid_build(mar_keypoint_grid *grid, const mar_sift_keypoint *keypoints, int num_keypoints)
+{
+  int i, cell, num_cells = grid->columns * grid->rows;
+  int *order;
+  float *x, *y;
+
+  // Grow the buffers, which are kept between frames
+  if (num_keypoints > grid->capacity)
+  {
+    order = (int *)mar_realloc(grid->order, num_keypoints * sizeof(int));
+    if (order == NULL)
+    {
+      return MAR_ERROR_MALLOC;
+    }
+    grid->order = order;
+    x = (float *)mar_realloc(grid->x, num_keypoints * sizeof(float));
+    if (x == NULL)
+    {
+      return MAR_ERROR_MALLOC;
+    }
+    grid->x = x;
+    y = (float *)mar_realloc(grid->y, num_keypoints * sizeof(float));
+    if (y == NULL)
+    {
+      return MAR_ERROR_MALLOC;
+    }
+    grid->y = y;
+    grid->capacity = num_keypoints;
+  }
+
+  // Count the keypoints of each cell, shifted by one so the prefix sums give each cell's start
+  memset(grid->cell_start, 0, (num_cells + 1) * sizeof(int));
+  for (i = 0; i < num_keypoints; i++)
+  {
+    cell = mar_keypoint_grid_cell(keypoints[i].y, grid->cell_size, grid->rows) * grid->columns + 
+      mar_keypoint_grid_cell(keypoints[i].x, grid->cell_size, grid->columns);
+    grid->cell_start[cell + 1]++;
+  }
+  for (i = 0; i < num_cells; i++)
+  {
+    grid->cell_start[i + 1] += grid->cell_start[i];
+  }
+
+  // Place each keypoint, using the start of the next cell as the cursor of each cell
+  for (i = 0; i < num_keypoints; i++)
+  {
+    cell = mar_keypoint_grid_cell(keypoints[i].y, grid->cell_size, grid->rows) * grid->columns + 
+      mar_keypoint_grid_cell(keypoints[i].x, grid->cell_size, grid->columns);
+    grid->order[grid->cell_start[cell]] = i;
+    grid->x[grid->cell_start[cell]] = keypoints[i].x;
+    grid->y[grid->cell_start[cell]] = keypoints[i].y;
+    grid->cell_start[cell]++;
+  }
+
+  // Each cursor now holds the start of the following cell, so shift them back
+  for (i = num_cells; i > 0; i--)
+  {
+    grid->cell_start[i] = grid->cell_start[i - 1];
+  }
+  grid->cell_start[0] = 0;
+  grid->num_keypoints = num_keypoints;
+
+  return MAR_ERROR_NONE;
+}
+
+/**
+ * Finds the keypoints of a grid within an ellipse.  The ellipse is given as the transformation which maps it onto
+ * the unit circle, so a point is within the ellipse if it is transformed to within a distance of 1 of the origin.
+ * Every keypoint is tested if the transformation is degenerate.
+ *
+ * @param grid The grid
+ * @param ellipse The transformation mapping the ellipse onto the unit circle
+ * @param indices Will be filled with the indices of the keypoints within the ellipse, room for every keypoint of the grid
+ * @param num_indices Will be filled with the number of keypoints within the ellipse
+ */
+MAR_PUBLIC
+void mar_keypoint_grid_query_ellipse(const mar_keypoint_grid *grid, const mar_affine *ellipse, int *indices, int *num_indices)
+{
+  int row, min_column, max_column, min_row, max_row, j, end;
+  float u, v, half_width, half_height;
+  mar_affine inverse;
+
+  *num_indices = 0;
+
+  // The bounding box of the unit circle mapped back through the inverse transformation
+  if (mar_affine_invert(ellipse, &inverse) == MAR_ERROR_NONE)
+  {
+    half_width = sqrtf(inverse.a * inverse.a + inverse.b * inverse.b);
+    half_height = sqrtf(inverse.c * inverse.c + inverse.d * inverse.d);
+    if (inverse.tx + half_width < 0 || inverse.ty + half_height < 0 ||
+        inverse.tx - half_width >= (float)grid->columns * grid->cell_size || 
+        inverse.ty - half_height >= (float)grid->rows * grid->cell_size)
+    {
+      return;
+    }
+    min_column = mar_keypoint_grid_cell(inverse.tx - half_width, grid->cell_size, grid->columns);
+    max_column = mar_keypoint_grid_cell(inverse.tx + half_width, grid->cell_size, grid->columns);
+    min_row = mar_keypoint_grid_cell(inverse.ty - half_height, grid->cell_size, grid->rows);
+    max_row = mar_keypoint_grid_cell(inverse.ty + half_height, grid->cell_size, grid->rows);
+  }
+  else
+  {
+    min_column = min_row = 0;
+    max_column = grid->columns - 1;
+    max_row = grid->rows - 1;
+  }
+
+  // The cells of a row are consecutive in the keypoint order, so each row of the box is one run
+  for (row = min_row; row <= max_row; row++)
+  {
+    j = grid->cell_start[row * grid->columns + min_column];
+    end = grid->cell_start[row * grid->columns + max_column + 1];
+    for (; j < end; j++)
+    {
+      u = ellipse->a * grid->x[j] + ellipse->b * grid->y[j] + ellipse->tx;
+      v = ellipse->c * grid->x[j] + ellipse->d * grid->y[j] + ellipse->ty;
+      if (u*u + v*v < 1)
+      {
+        indices[(*num_indices)++] = grid->order[j];
+      }
+    }
+  }
+}
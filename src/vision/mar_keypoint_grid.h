@@ -0,0 +1,89 @@
+/**
+ * @file mar_keypoint_grid.h
+ *
+ * Contains a uniform grid spatial index over the SIFT keypoints of a frame.  The grid is built once per
+ * frame by bucketing keypoints into square cells, so finding the keypoints within an ellipse only tests
+ * the keypoints of the cells overlapping the ellipse's bounding box.
+ *
+ * @author Greg Eddington
+ */
+
+#ifndef MAR_KEYPOINT_GRID_H
+#define MAR_KEYPOINT_GRID_H
+
+#include "../common/mar_error.h"
+#include "mar_affine.h"
+#include "mar_sift.h"
+
+/** The default width and height in pixels of a grid cell */
+#define MAR_KEYPOINT_GRID_DEFAULT_CELL_SIZE 32
+
+/**
+ * A uniform grid over the keypoints of a frame
+ */
+typedef struct
+{
+  /** The width and height in pixels of a cell @return Read-Only */
+  int cell_size;
+  /** The number of cell columns @return Read-Only */
+  int columns;
+  /** The number of cell rows @return Read-Only */
+  int rows;
+  /** The position in the keypoint order of the first keypoint of each cell, with one extra entry for the end @return Do not access directly when using the library */
+  int *cell_start;
+  /** The keypoint indices ordered by cell @return Do not access directly when using the library */
+  int *order;
+  /** The X coordinates of the keypoints ordered by cell @return Do not access directly when using the library */
+  float *x;
+  /** The Y coordinates of the keypoints ordered by cell @return Do not access directly when using the library */
+  float *y;
+  /** The number of keypoints the buffers can hold @return Do not access directly when using the library */
+  int capacity;
+  /** The number of keypoints in the grid @return Read-Only */
+  int num_keypoints;
+}
+mar_keypoint_grid;
+
+/**
+ * Creates an empty keypoint grid covering a frame.
+ *
+ * @param grid The grid to create
+ * @param width The width of the frame
+ * @param height The height of the frame
+ * @param cell_size The width and height in pixels of a cell
+ *
+ * @return MAR_ERROR_NONE on success, an error code on failure
+ */
+mar_error_code mar_keypoint_grid_new(mar_keypoint_grid *grid, int width, int height, int cell_size);
+
+/**
+ * Frees a keypoint grid.
+ *
+ * @param grid The grid to free
+ */
+void mar_keypoint_grid_free(mar_keypoint_grid *grid);
+
+/**
+ * Buckets the keypoints of a frame into a grid, replacing the keypoints of the previous frame.
+ *
+ * @param grid The grid
+ * @param keypoints The keypoints of the frame
+ * @param num_keypoints The number of keypoints
+ *
+ * @return MAR_ERROR_NONE on success, an error code on failure
+ */
+mar_error_code mar_keypoint_grid_build(mar_keypoint_grid *grid, const mar_sift_keypoint *keypoints, int num_keypoints);
+
+/**
+ * Finds the keypoints of a grid within an ellipse.  The ellipse is given as the transformation which maps it onto
+ * the unit circle, so a point is within the ellipse if it is transformed to within a distance of 1 of the origin.
+ * Every keypoint is tested if the transformation is degenerate.
+ *
+ * @param grid The grid
+ * @param ellipse The transformation mapping the ellipse onto the unit circle
+ * @param indices Will be filled with the indices of the keypoints within the ellipse, room for every keypoint of the grid
+ * @param num_indices Will be filled with the number of keypoints within the ellipse
+ */
+void mar_keypoint_grid_query_ellipse(const mar_keypoint_grid *grid, const mar_affine *ellipse, int *indices, int *num_indices);
+
+#endif
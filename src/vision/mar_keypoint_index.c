@@ -0,0 +1,542 @@
+/**
+ * @file mar_keypoint_index.c
+ *
+ * Contains a nearest neighbour index over SIFT keypoint descriptors.  Floating point descriptors are
+ * kept in a randomized k-d forest which is only rebuilt when keypoints are added or replaced, so matching
+ * a keypoint against the index checks a bounded number of descriptors instead of every descriptor.
+ * Quantized descriptors take a quarter of the memory and are searched exhaustively with vectorized
+ * sums of absolute differences.  Binary descriptors are searched exhaustively by Hamming distance.
+ *
+ * @author Greg Eddington
+ */
+
+#include "../common/mar_common.h"
+#include "mar_keypoint_index.h"
+
+#include <float.h>
+#include <limits.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <kdtree.h>
+
+/** The number of quantized descriptors compared per call to the distance kernel */
+#define MAR_KEYPOINT_INDEX_BATCH_SIZE 64
+
+/**
+ * Rebuilds the forest of an index over its current descriptors.
+ *
+ * @param index The index
+ *
+ * @return MAR_ERROR_NONE on success, an error code on failure
+ */
+MAR_PRIVATE
+mar_error_code mar_keypoint_index_build(mar_keypoint_index *index)
+{
+  VlKDForest *forest;
+
+  // The forest keeps its trees between builds, so a new forest is built each time
+  if (index->forest != NULL)
+  {
+    vl_kdforest_delete((VlKDForest *)index->forest);
+    index->forest = NULL;
+  }
+
+  forest = vl_kdforest_new(VL_TYPE_FLOAT, MAR_KEYPOINT_INDEX_DIMENSION, index->num_trees, VlDistanceL1);
+  if (forest == NULL)
+  {
+    return MAR_ERROR_MALLOC;
+  }
+  vl_kdforest_set_max_num_comparisons(forest, index->max_comparisons);
+  vl_kdforest_build(forest, index->num_keypoints, index->descriptors);
+
+  index->forest = forest;
+  index->built = 1;
+
+  return MAR_ERROR_NONE;
+}
+
+/**
+ * Searches every floating point descriptor of an index for the two closest to a keypoint's descriptor.
+ *
+ * @param index The index
+ * @param keypoint The keypoint to match
+ * @param best Will be filled with the position of the closest keypoint
+ * @param best_difference Will be filled with the distance to the closest keypoint
+ * @param second_best_difference Will be filled with the distance to the second closest keypoint
+ */
+MAR_PRIVATE
+void mar_keypoint_index_search(mar_keypoint_index *index, const mar_sift_keypoint *keypoint,
+    int *best, float *best_difference, float *second_best_difference)
+{
+  const float *descriptor;
+  float difference;
+  int i, j;
+
+  for (i = 0; i < index->num_keypoints; i++)
+  {
+    descriptor = &index->descriptors[i * MAR_KEYPOINT_INDEX_DIMENSION];
+    difference = 0;
+    for (j = 0; j < MAR_KEYPOINT_INDEX_DIMENSION; j++)
+    {
+      difference += fabsf(keypoint->descriptor[j] - descriptor[j]);
+    }
+
+    if (difference < *best_difference)
+    {
+      *best = i;
+      *second_best_difference = *best_difference;
+      *best_difference = difference;
+    }
+    else if (difference < *second_best_difference)
+    {
+      *second_best_difference = difference;
+    }
+  }
+}
+
+/**
+ * Searches every quantized descriptor of an index for the two closest to a keypoint's descriptor.
+ *
+ * @param index The index
+ * @param keypoint The keypoint to match
+ * @param best Will be filled with the position of the closest keypoint
+ * @param best_difference Will be filled with the distance to the closest keypoint
+ * @param second_best_difference Will be filled with the distance to the second closest keypoint
+ */
+MAR_PRIVATE
+void mar_keypoint_index_search_quantized(mar_keypoint_index *index, const mar_sift_keypoint *keypoint,
+    int *best, float *best_difference, float *second_best_difference)
+{
+  unsigned char query[MAR_KEYPOINT_INDEX_DIMENSION];
+  unsigned int distances[MAR_KEYPOINT_INDEX_BATCH_SIZE];
+  unsigned int best_distance = UINT_MAX, second_best_distance = UINT_MAX;
+  int i, j, n;
+
+  mar_descriptor_quantize(keypoint->descriptor, query);
+
+  // Compute distances a batch at a time to keep them on the stack
+  for (i = 0; i < index->num_keypoints; i += n)
+  {
+    n = index->num_keypoints - i < MAR_KEYPOINT_INDEX_BATCH_SIZE ? index->num_keypoints - i : MAR_KEYPOINT_INDEX_BATCH_SIZE;
+    mar_descriptor_sad(query, &index->quantized_descriptors[i * MAR_KEYPOINT_INDEX_DIMENSION], n, distances);
+
+    for (j = 0; j < n; j++)
+    {
+      if (distances[j] < best_distance)
+      {
+        *best = i + j;
+        second_best_distance = best_distance;
+        best_distance = distances[j];
+      }
+      else if (distances[j] < second_best_distance)
+      {
+        second_best_distance = distances[j];
+      }
+    }
+  }
+
+  if (best_distance != UINT_MAX)
+  {
+    *best_difference = best_distance / MAR_DESCRIPTOR_QUANTIZATION_SCALE;
+  }
+  if (second_best_distance != UINT_MAX)
+  {
+    *second_best_difference = second_best_distance / MAR_DESCRIPTOR_QUANTIZATION_SCALE;
+  }
+}
+
+/**
+ * Searches every binary descriptor of an index for the two closest to a keypoint's descriptor.
+ *
+ * @param index The index
+ * @param keypoint The keypoint to match
+ * @param best Will be filled with the position of the closest keypoint
+ * @param best_difference Will be filled with the number of bits which differ from the closest keypoint
+ * @param second_best_difference Will be filled with the number of bits which differ from the second closest keypoint
+ */
+MAR_PRIVATE
+void mar_keypoint_index_search_binary(mar_keypoint_index *index, const mar_sift_keypoint *keypoint,
+    int *best, float *best_difference, float *second_best_difference)
+{
+  unsigned int distances[MAR_KEYPOINT_INDEX_BATCH_SIZE];
+  unsigned int best_distance = UINT_MAX, second_best_distance = UINT_MAX;
+  int i, j, n;
+
+  for (i = 0; i < index->num_keypoints; i += n)
+  {
+    n = index->num_keypoints - i < MAR_KEYPOINT_INDEX_BATCH_SIZE ? index->num_keypoints - i : MAR_KEYPOINT_INDEX_BATCH_SIZE;
+    mar_descriptor_hamming((const unsigned char *)keypoint->descriptor,
+        &index->quantized_descriptors[i * MAR_DESCRIPTOR_BINARY_BYTES], n, distances);
+
+    for (j = 0; j < n; j++)
+    {
+      if (distances[j] < best_distance)
+      {
+        *best = i + j;
+        second_best_distance = best_distance;
+        best_distance = distances[j];
+      }
+      else if (distances[j] < second_best_distance)
+      {
+        second_best_distance = distances[j];
+      }
+    }
+  }
+
+  if (best_distance != UINT_MAX)
+  {
+    *best_difference = (float)best_distance;
+  }
+  if (second_best_distance != UINT_MAX)
+  {
+    *second_best_difference = (float)second_best_distance;
+  }
+}
+
+/**
+ * Returns the number of bytes of one row of an index's quantized or binary descriptor storage.
+ *
+ * @param index The index
+ *
+ * @return The row size
+ */
+MAR_PRIVATE
+int mar_keypoint_index_get_row_size(const mar_keypoint_index *index)
+{
+  return index->format == MAR_KEYPOINT_INDEX_BINARY ? MAR_DESCRIPTOR_BINARY_BYTES : MAR_KEYPOINT_INDEX_DIMENSION;
+}
+
+/**
+ * Creates an empty keypoint index.
+ *
+ * @param index The index to create
+ * @param capacity The maximum number of keypoints, no descriptor storage is allocated until keypoints are added
+ * @param format The format of the descriptors, quantized and binary descriptors are always searched exhaustively
+ * @param num_trees The number of randomized trees, 0 to always search exhaustively
+ * @param max_comparisons The maximum number of descriptors compared per query, 0 for an exact search
+ *
+ * @return MAR_ERROR_NONE on success, an error code on failure
+ */
+MAR_PUBLIC
+mar_error_code mar_keypoint_index_new(mar_keypoint_index *index, int capacity, char format, int num_trees, int max_comparisons)
+{
+  MAR_CLEAR(*index);
+
+  // Descriptor storage is only allocated as keypoints are added
+  index->capacity = capacity;
+  index->format = format;
+  index->num_trees = format != MAR_KEYPOINT_INDEX_FLOAT || num_trees < 0 ? 0 : num_trees;
+  index->max_comparisons = max_comparisons < 0 ? 0 : max_comparisons;
+
+  return MAR_ERROR_NONE;
+}
+
+/**
+ * Frees a keypoint index.
+ *
+ * @param index The index to free
+ */
+MAR_PUBLIC
+void mar_keypoint_index_free(mar_keypoint_index *index)
+{
+  if (index->forest != NULL)
+  {
+    vl_kdforest_delete((VlKDForest *)index->forest);
+  }
+  mar_free(index->descriptors);
+  mar_free(index->quantized_descriptors);
+  MAR_CLEAR(*index);
+}
+
+/**
+ * Removes every keypoint from an index.
+ *
+ * @param index The index
+ */
+MAR_PUBLIC
+void mar_keypoint_index_clear(mar_keypoint_index *index)
+{
+  index->num_keypoints = 0;
+  index->built = 0;
+}
+
+/**
+ * Grows the descriptor storage of an index to hold at least a number of keypoints, up to its capacity.
+ *
+ * @param index The index
+ * @param num_keypoints The number of keypoints to hold
+ *
+ * @return MAR_ERROR_NONE on success, MAR_ERROR_MALLOC if the storage could not grow
+ */
+MAR_PRIVATE
+mar_error_code mar_keypoint_index_reserve(mar_keypoint_index *index, int num_keypoints)
+{
+  int allocated;
+  void *descriptors;
+
+  if (num_keypoints <= index->allocated)
+  {
+    return MAR_ERROR_NONE;
+  }
+
+  // Double the storage so that an index filled one keypoint at a time is only reallocated a few times
+  allocated = index->allocated * 2 > MAR_KEYPOINT_INDEX_MIN_ALLOCATION ? index->allocated * 2 : MAR_KEYPOINT_INDEX_MIN_ALLOCATION;
+  allocated = allocated > num_keypoints ? allocated : num_keypoints;
+  allocated = allocated < index->capacity ? allocated : index->capacity;
+
+  if (index->format != MAR_KEYPOINT_INDEX_FLOAT)
+  {
+    descriptors = mar_realloc(index->quantized_descriptors, mar_keypoint_index_get_row_size(index) * allocated);
+    if (descriptors == NULL)
+    {
+      return MAR_ERROR_MALLOC;
+    }
+    index->quantized_descriptors = (unsigned char *)descriptors;
+  }
+  else
+  {
+    descriptors = mar_realloc(index->descriptors, sizeof(float) * MAR_KEYPOINT_INDEX_DIMENSION * allocated);
+    if (descriptors == NULL)
+    {
+      return MAR_ERROR_MALLOC;
+    }
+    index->descriptors = (float *)descriptors;
+  }
+  index->allocated = allocated;
+
+  // The forest refers to the descriptors, which may have moved
+  index->built = 0;
+
+  return MAR_ERROR_NONE;
+}
+
+/**
+ * Stores the descriptor of a keypoint in a row of an index.
+ *
+ * @param index The index
+ * @param position The row
+ * @param keypoint The keypoint
+ */
+MAR_PRIVATE
+void mar_keypoint_index_store(mar_keypoint_index *index, int position, const mar_sift_keypoint *keypoint)
+{
+  if (index->format == MAR_KEYPOINT_INDEX_BINARY)
+  {
+    memcpy(&index->quantized_descriptors[position * MAR_DESCRIPTOR_BINARY_BYTES], keypoint->descriptor, MAR_DESCRIPTOR_BINARY_BYTES);
+  }
+  else if (index->format == MAR_KEYPOINT_INDEX_QUANTIZED)
+  {
+    mar_descriptor_quantize(keypoint->descriptor, &index->quantized_descriptors[position * MAR_KEYPOINT_INDEX_DIMENSION]);
+  }
+  else
+  {
+    memcpy(&index->descriptors[position * MAR_KEYPOINT_INDEX_DIMENSION], keypoint->descriptor, sizeof(keypoint->descriptor));
+  }
+}
+
+/**
+ * Adds or replaces the keypoint at a position of an index, growing the index if the position is past its end.
+ * Descriptor storage grows as keypoints are added.  The forest is rebuilt on the next query.
+ *
+ * @param index The index
+ * @param position The position of the keypoint, less than the capacity of the index
+ * @param keypoint The keypoint
+ *
+ * @return MAR_ERROR_NONE on success, MAR_ERROR_INVALID_ARGUMENT if the position is out of range, MAR_ERROR_MALLOC if the storage could not grow
+ */
+MAR_PUBLIC
+mar_error_code mar_keypoint_index_set_keypoint(mar_keypoint_index *index, int position, const mar_sift_keypoint *keypoint)
+{
+  mar_error_code mrv;
+
+  if (position < 0 || position >= index->capacity)
+  {
+    return MAR_ERROR_INVALID_ARGUMENT;
+  }
+
+  mrv = mar_keypoint_index_reserve(index, position + 1);
+  if (mrv != MAR_ERROR_NONE)
+  {
+    return mrv;
+  }
+
+  mar_keypoint_index_store(index, position, keypoint);
+  if (position >= index->num_keypoints)
+  {
+    index->num_keypoints = position + 1;
+  }
+  index->built = 0;
+
+  return MAR_ERROR_NONE;
+}
+
+/**
+ * Refreshes the descriptor of a keypoint with a descriptor of the same keypoint from a later frame.
+ * The forest is not rebuilt since the descriptor is expected to stay close to the one it replaces.
+ *
+ * @param index The index
+ * @param position The position of the keypoint
+ * @param keypoint The keypoint whose descriptor to use
+ */
+MAR_PUBLIC
+void mar_keypoint_index_update_keypoint(mar_keypoint_index *index, int position, const mar_sift_keypoint *keypoint)
+{
+  if (position < 0 || position >= index->num_keypoints)
+  {
+    return;
+  }
+
+  // The forest reads distances from these rows, so only the tree partitions go stale
+  mar_keypoint_index_store(index, position, keypoint);
+}
+
+/**
+ * Returns the number of bytes of the stored descriptor of one keypoint, which depends on the format of an index.
+ *
+ * @param index The index
+ *
+ * @return The descriptor size
+ */
+MAR_PUBLIC
+int mar_keypoint_index_get_descriptor_size(const mar_keypoint_index *index)
+{
+  return index->format == MAR_KEYPOINT_INDEX_FLOAT ? MAR_KEYPOINT_INDEX_DIMENSION * sizeof(float) : mar_keypoint_index_get_row_size(index);
+}
+
+/**
+ * Returns the stored descriptor of a keypoint, in the format of the index, so that it can be saved.  The
+ * descriptors of consecutive positions are stored one after another.
+ *
+ * @param index The index
+ * @param position The position of the keypoint
+ *
+ * @return The descriptor, mar_keypoint_index_get_descriptor_size bytes in size, or NULL if the position is out of range
+ */
+MAR_PUBLIC
+const void *mar_keypoint_index_get_descriptor(const mar_keypoint_index *index, int position)
+{
+  if (position < 0 || position >= index->num_keypoints)
+  {
+    return NULL;
+  }
+
+  if (index->format == MAR_KEYPOINT_INDEX_FLOAT)
+  {
+    return &index->descriptors[position * MAR_KEYPOINT_INDEX_DIMENSION];
+  }
+
+  return &index->quantized_descriptors[position * mar_keypoint_index_get_row_size(index)];
+}
+
+/**
+ * Adds or replaces the keypoint at a position of an index from a stored descriptor in the format of the index, as
+ * returned by mar_keypoint_index_get_descriptor.  The forest is rebuilt on the next query.
+ *
+ * @param index The index
+ * @param position The position of the keypoint, less than the capacity of the index
+ * @param descriptor The descriptor, mar_keypoint_index_get_descriptor_size bytes in size
+ *
+ * @return MAR_ERROR_NONE on success, MAR_ERROR_INVALID_ARGUMENT if the position is out of range, MAR_ERROR_MALLOC if the storage could not grow
+ */
+MAR_PUBLIC
+mar_error_code mar_keypoint_index_set_descriptor(mar_keypoint_index *index, int position, const void *descriptor)
+{
+  mar_error_code mrv;
+
+  if (position < 0 || position >= index->capacity)
+  {
+    return MAR_ERROR_INVALID_ARGUMENT;
+  }
+
+  mrv = mar_keypoint_index_reserve(index, position + 1);
+  if (mrv != MAR_ERROR_NONE)
+  {
+    return mrv;
+  }
+
+  if (index->format == MAR_KEYPOINT_INDEX_FLOAT)
+  {
+    memcpy(&index->descriptors[position * MAR_KEYPOINT_INDEX_DIMENSION], descriptor, mar_keypoint_index_get_descriptor_size(index));
+  }
+  else
+  {
+    memcpy(&index->quantized_descriptors[position * mar_keypoint_index_get_row_size(index)], descriptor, mar_keypoint_index_get_descriptor_size(index));
+  }
+  if (position >= index->num_keypoints)
+  {
+    index->num_keypoints = position + 1;
+  }
+  index->built = 0;
+
+  return MAR_ERROR_NONE;
+}
+
+/**
+ * Finds the two keypoints of an index whose descriptors are closest to a keypoint's descriptor by L1 distance,
+ * or by Hamming distance for binary descriptors.  Distances between quantized descriptors are scaled back to the
+ * range of floating point descriptors.
+ * The forest is rebuilt first if the keypoints have changed.  An index must not be queried from more than one
+ * thread at a time.
+ *
+ * @param index The index
+ * @param keypoint The keypoint to match
+ * @param best Will be filled with the position of the closest keypoint, or -1 if the index is empty
+ * @param best_difference Will be filled with the distance to the closest keypoint, or FLT_MAX
+ * @param second_best_difference Will be filled with the distance to the second closest keypoint, or FLT_MAX
+ *
+ * @return MAR_ERROR_NONE on success, an error code on failure
+ */
+MAR_PUBLIC
+mar_error_code mar_keypoint_index_query(mar_keypoint_index *index, const mar_sift_keypoint *keypoint,
+    int *best, float *best_difference, float *second_best_difference)
+{
+  VlKDForestNeighbor neighbors[2];
+  mar_error_code mrv;
+
+  *best = -1;
+  *best_difference = FLT_MAX;
+  *second_best_difference = FLT_MAX;
+
+  if (index->format == MAR_KEYPOINT_INDEX_BINARY)
+  {
+    mar_keypoint_index_search_binary(index, keypoint, best, best_difference, second_best_difference);
+    return MAR_ERROR_NONE;
+  }
+  else if (index->format == MAR_KEYPOINT_INDEX_QUANTIZED)
+  {
+    mar_keypoint_index_search_quantized(index, keypoint, best, best_difference, second_best_difference);
+    return MAR_ERROR_NONE;
+  }
+
+  // Small indices are cheaper to search exhaustively than through the forest
+  if (index->num_trees == 0 || index->num_keypoints < MAR_KEYPOINT_INDEX_MIN_FOREST_SIZE)
+  {
+    mar_keypoint_index_search(index, keypoint, best, best_difference, second_best_difference);
+    return MAR_ERROR_NONE;
+  }
+
+  // Rebuild the forest if keypoints were added or replaced since the last query
+  if (!index->built)
+  {
+    mrv = mar_keypoint_index_build(index);
+    if (mrv != MAR_ERROR_NONE)
+    {
+      return mrv;
+    }
+  }
+
+  // Neighbours the search ran out of comparisons for are left with an invalid index
+  vl_kdforest_query((VlKDForest *)index->forest, neighbors, 2, keypoint->descriptor);
+  if (neighbors[0].index < (vl_uindex)index->num_keypoints)
+  {
+    *best = neighbors[0].index;
+    *best_difference = neighbors[0].distance;
+    if (neighbors[1].index < (vl_uindex)index->num_keypoints)
+    {
+      *second_best_difference = neighbors[1].distance;
+    }
+  }
+
+  return MAR_ERROR_NONE;
+}
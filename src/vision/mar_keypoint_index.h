@@ -0,0 +1,166 @@
+/**
+ * @file mar_keypoint_index.h
+ *
+ * Contains a nearest neighbour index over SIFT keypoint descriptors.  Floating point descriptors are
+ * kept in a randomized k-d forest which is only rebuilt when keypoints are added or replaced, so matching
+ * a keypoint against the index checks a bounded number of descriptors instead of every descriptor.
+ * Quantized descriptors take a quarter of the memory and are searched exhaustively with vectorized
+ * sums of absolute differences.  Binary descriptors are searched exhaustively by Hamming distance.
+ *
+ * @author Greg Eddington
+ */
+
+#ifndef MAR_KEYPOINT_INDEX_H
+#define MAR_KEYPOINT_INDEX_H
+
+#include "../common/mar_error.h"
+#include "mar_descriptor.h"
+#include "mar_sift.h"
+
+/** The number of descriptor values of a SIFT keypoint */
+#define MAR_KEYPOINT_INDEX_DIMENSION MAR_DESCRIPTOR_LENGTH
+/** The default number of randomized trees in a keypoint index */
+#define MAR_KEYPOINT_INDEX_DEFAULT_NUMBER_OF_TREES 4
+/** The default maximum number of descriptors compared per query, 0 for an exact search */
+#define MAR_KEYPOINT_INDEX_DEFAULT_MAX_COMPARISONS 64
+/** An index of floating point SIFT descriptors */
+#define MAR_KEYPOINT_INDEX_FLOAT 0
+/** An index of SIFT descriptors quantized to one byte per value */
+#define MAR_KEYPOINT_INDEX_QUANTIZED 1
+/** An index of binary descriptors packed into the first MAR_DESCRIPTOR_BINARY_BYTES bytes of each keypoint's descriptor */
+#define MAR_KEYPOINT_INDEX_BINARY 2
+/** Whether or not indices store quantized descriptors by default */
+#define MAR_KEYPOINT_INDEX_DEFAULT_QUANTIZED 0
+/** The smallest number of keypoints the descriptor storage of an index grows to */
+#define MAR_KEYPOINT_INDEX_MIN_ALLOCATION 16
+/** Indices with fewer keypoints than this are searched exhaustively instead of through the forest */
+#define MAR_KEYPOINT_INDEX_MIN_FOREST_SIZE 32
+
+/**
+ * A nearest neighbour index over SIFT keypoint descriptors
+ */
+typedef struct
+{
+  /** The k-d forest over the descriptors, or NULL when not built @return Do not access directly when using the library */
+  void *forest;
+  /** The floating point descriptors, one row of MAR_KEYPOINT_INDEX_DIMENSION values per keypoint, or NULL when quantized @return Do not access directly when using the library */
+  float *descriptors;
+  /** The quantized or binary descriptors, one row of MAR_KEYPOINT_INDEX_DIMENSION or MAR_DESCRIPTOR_BINARY_BYTES bytes per keypoint, or NULL when floating point @return Do not access directly when using the library */
+  unsigned char *quantized_descriptors;
+  /** The maximum number of keypoints @return Read-Only */
+  int capacity;
+  /** The number of keypoints the descriptor storage holds @return Do not access directly when using the library */
+  int allocated;
+  /** The number of keypoints @return Read-Only */
+  int num_keypoints;
+  /** The format of the descriptors, MAR_KEYPOINT_INDEX_FLOAT, MAR_KEYPOINT_INDEX_QUANTIZED or MAR_KEYPOINT_INDEX_BINARY @return Read-Only */
+  char format;
+  /** The number of randomized trees, 0 to always search exhaustively @return Read-Only */
+  int num_trees;
+  /** The maximum number of descriptors compared per query @return Read-Only */
+  int max_comparisons;
+  /** Whether or not the forest matches the keypoints @return Do not access directly when using the library */
+  char built;
+}
+mar_keypoint_index;
+
+/**
+ * Creates an empty keypoint index.
+ *
+ * @param index The index to create
+ * @param capacity The maximum number of keypoints, no descriptor storage is allocated until keypoints are added
+ * @param format The format of the descriptors, quantized and binary descriptors are always searched exhaustively
+ * @param num_trees The number of randomized trees, 0 to always search exhaustively
+ * @param max_comparisons The maximum number of descriptors compared per query, 0 for an exact search
+ *
+ * @return MAR_ERROR_NONE on success, an error code on failure
+ */
+mar_error_code mar_keypoint_index_new(mar_keypoint_index *index, int capacity, char format, int num_trees, int max_comparisons);
+
+/**
+ * Frees a keypoint index.
+ *
+ * @param index The index to free
+ */
+void mar_keypoint_index_free(mar_keypoint_index *index);
+
+/**
+ * Removes every keypoint from an index.
+ *
+ * @param index The index
+ */
+void mar_keypoint_index_clear(mar_keypoint_index *index);
+
+/**
+ * Adds or replaces the keypoint at a position of an index, growing the index if the position is past its end.
+ * Descriptor storage grows as keypoints are added.  The forest is rebuilt on the next query.
+ *
+ * @param index The index
+ * @param position The position of the keypoint, less than the capacity of the index
+ * @param keypoint The keypoint
+ *
+ * @return MAR_ERROR_NONE on success, MAR_ERROR_INVALID_ARGUMENT if the position is out of range, MAR_ERROR_MALLOC if the storage could not grow
+ */
+mar_error_code mar_keypoint_index_set_keypoint(mar_keypoint_index *index, int position, const mar_sift_keypoint *keypoint);
+
+/**
+ * Refreshes the descriptor of a keypoint with a descriptor of the same keypoint from a later frame.
+ * The forest is not rebuilt since the descriptor is expected to stay close to the one it replaces.
+ *
+ * @param index The index
+ * @param position The position of the keypoint
+ * @param keypoint The keypoint whose descriptor to use
+ */
+void mar_keypoint_index_update_keypoint(mar_keypoint_index *index, int position, const mar_sift_keypoint *keypoint);
+
+/**
+ * Returns the number of bytes of the stored descriptor of one keypoint, which depends on the format of an index.
+ *
+ * @param index The index
+ *
+ * @return The descriptor size
+ */
+int mar_keypoint_index_get_descriptor_size(const mar_keypoint_index *index);
+
+/**
+ * Returns the stored descriptor of a keypoint, in the format of the index, so that it can be saved.  The
+ * descriptors of consecutive positions are stored one after another.
+ *
+ * @param index The index
+ * @param position The position of the keypoint
+ *
+ * @return The descriptor, mar_keypoint_index_get_descriptor_size bytes in size, or NULL if the position is out of range
+ */
+const void *mar_keypoint_index_get_descriptor(const mar_keypoint_index *index, int position);
+
+/**
+ * Adds or replaces the keypoint at a position of an index from a stored descriptor in the format of the index, as
+ * returned by mar_keypoint_index_get_descriptor.  The forest is rebuilt on the next query.
+ *
+ * @param index The index
+ * @param position The position of the keypoint, less than the capacity of the index
+ * @param descriptor The descriptor, mar_keypoint_index_get_descriptor_size bytes in size
+ *
+ * @return MAR_ERROR_NONE on success, MAR_ERROR_INVALID_ARGUMENT if the position is out of range, MAR_ERROR_MALLOC if the storage could not grow
+ */
+mar_error_code mar_keypoint_index_set_descriptor(mar_keypoint_index *index, int position, const void *descriptor);
+
+/**
+ * Finds the two keypoints of an index whose descriptors are closest to a keypoint's descriptor by L1 distance,
+ * or by Hamming distance for binary descriptors.  Distances between quantized descriptors are scaled back to the
+ * range of floating point descriptors.
+ * The forest is rebuilt first if the keypoints have changed.  An index must not be queried from more than one
+ * thread at a time.
+ *
+ * @param index The index
+ * @param keypoint The keypoint to match
+ * @param best Will be filled with the position of the closest keypoint, or -1 if the index is empty
+ * @param best_difference Will be filled with the distance to the closest keypoint, or FLT_MAX
+ * @param second_best_difference Will be filled with the distance to the second closest keypoint, or FLT_MAX
+ *
+ * @return MAR_ERROR_NONE on success, an error code on failure
+ */
+mar_error_code mar_keypoint_index_query(mar_keypoint_index *index, const mar_sift_keypoint *keypoint,
+    int *best, float *best_difference, float *second_best_difference);
+
+#endif
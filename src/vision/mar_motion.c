@@ -0,0 +1,117 @@
+/**
+ * @file mar_motion.c
+ *
+ * Contains a constant velocity motion model over the six parameters of an affine transformation.  The model is
+ * an alpha-beta filter, the steady state of a Kalman filter with a constant velocity process, so each measured
+ * transformation corrects the predicted transformation and its velocity by fixed gains.
+ *
+ * @author Greg Eddington
+ */
+
+#include "../common/mar_common.h"
+#include "mar_motion.h"
+
+/**
+ * Adds a scaled transformation to another parameter by parameter.
+ *
+ * @param t The transformation to add to
+ * @param scale The scale of the added transformation
+ * @param added The added transformation
+ * @param sum Will be filled with t + scale * added, which may be either of the others
+ */
+MAR_PRIVATE
+void mar_motion_add(const mar_affine *t, float scale, const mar_affine *added, mar_affine *sum)
+{
+  sum->a = t->a + scale * added->a;
+  sum->b = t->b + scale * added->b;
+  sum->c = t->c + scale * added->c;
+  sum->d = t->d + scale * added->d;
+  sum->tx = t->tx + scale * added->tx;
+  sum->ty = t->ty + scale * added->ty;
+}
+
+/**
+ * Resets a motion model to a stationary transformation which has not been measured.  The first measurement
+ * afterwards replaces the transformation instead of correcting it.
+ *
+ * @param motion The motion model
+ * @param transform The transformation
+ */
+MAR_PUBLIC
+void mar_motion_reset(mar_motion *motion, const mar_affine *transform)
+{
+  MAR_CLEAR(*motion);
+  motion->transform = *transform;
+}
+
+/**
+ * Predicts the transformation a number of frames after the last frame.  A model which has been lost for
+ * longer than it may coast is not moving.
+ *
+ * @param motion The motion model
+ * @param frames The number of frames ahead
+ * @param max_coast_frames The maximum number of frames in a row a lost transformation is predicted for
+ * @param predicted Will be filled with the predicted transformation
+ */
+MAR_PUBLIC
+void mar_motion_predict(const mar_motion *motion, int frames, int max_coast_frames, mar_affine *predicted)
+{
+  if (motion->frames_lost >= max_coast_frames)
+  {
+    *predicted = motion->transform;
+    return;
+  }
+
+  mar_motion_add(&motion->transform, (float)frames, &motion->velocity, predicted);
+}
+
+/**
+ * Advances a motion model to the next frame with a measured transformation.  The measurement replaces the
+ * transformation after a reset or once the model has been lost for longer than it may coast.
+ *
+ * @param motion The motion model
+ * @param measured The measured transformation of the frame
+ * @param alpha The gain applied to the difference between the measured and the predicted transformation
+ * @param beta The gain applied to the difference between the measured and the predicted transformation to correct the velocity
+ * @param max_coast_frames The maximum number of frames in a row a lost transformation is predicted for
+ */
+MAR_PUBLIC
+void mar_motion_update(mar_motion *motion, const mar_affine *measured, float alpha, float beta, int max_coast_frames)
+{
+  mar_affine predicted, residual;
+
+  if (motion->num_measurements == 0 || motion->frames_lost >= max_coast_frames)
+  {
+    // Nothing is known about how the transformation was moving
+    motion->transform = *measured;
+    MAR_CLEAR(motion->velocity);
+  }
+  else
+  {
+    mar_motion_predict(motion, 1, max_coast_frames, &predicted);
+    mar_motion_add(measured, -1, &predicted, &residual);
+    mar_motion_add(&predicted, alpha, &residual, &motion->transform);
+    mar_motion_add(&motion->velocity, beta, &residual, &motion->velocity);
+  }
+
+  motion->num_measurements++;
+  motion->frames_lost = 0;
+}
+
+/**
+ * Advances a motion model to the next frame without a measurement.  The transformation follows the damped velocity
+ * for up to a number of frames in a row and is then held.
+ *
+ * @param motion The motion model
+ * @param max_coast_frames The maximum number of frames in a row a lost transformation is predicted for
+ */
+MAR_PUBLIC
+void mar_motion_coast(mar_motion *motion, int max_coast_frames)
+{
+  if (motion->frames_lost < max_coast_frames)
+  {
+    mar_motion_add(&motion->velocity, MAR_MOTION_COAST_DAMPING - 1, &motion->velocity, &motion->velocity);
+    mar_motion_add(&motion->transform, 1, &motion->velocity, &motion->transform);
+  }
+  motion->frames_lost++;
+}
@@ -0,0 +1,83 @@
+/**
+ * @file mar_motion.h
+ *
+ * Contains a constant velocity motion model over the six parameters of an affine transformation.  The model is
+ * an alpha-beta filter, the steady state of a Kalman filter with a constant velocity process, so each measured
+ * transformation corrects the predicted transformation and its velocity by fixed gains.  Predictions narrow where
+ * a surface is searched for, seed the transformation estimator and stand in for frames where the surface was lost.
+ *
+ * @author Greg Eddington
+ */
+
+#ifndef MAR_MOTION_H
+#define MAR_MOTION_H
+
+#include "mar_affine.h"
+
+/** The default gain applied to the difference between a measured and a predicted transformation, 1 to follow measurements exactly */
+#define MAR_MOTION_DEFAULT_ALPHA 0.8f
+/** The default gain applied to the difference between a measured and a predicted transformation to correct the velocity */
+#define MAR_MOTION_DEFAULT_BETA 0.3f
+/** The default maximum number of frames in a row a lost transformation is predicted for before it is held */
+#define MAR_MOTION_DEFAULT_MAX_COAST_FRAMES 5
+/** The factor the velocity is multiplied by on each frame a lost transformation is predicted for */
+#define MAR_MOTION_COAST_DAMPING 0.7f
+
+/**
+ * A constant velocity motion model of an affine transformation
+ */
+typedef struct
+{
+  /** The filtered transformation as of the last frame @return Read-Only */
+  mar_affine transform;
+  /** The change of each parameter of the transformation per frame @return Read-Only */
+  mar_affine velocity;
+  /** The number of measurements since the model was reset @return Read-Only */
+  int num_measurements;
+  /** The number of frames in a row without a measurement @return Read-Only */
+  int frames_lost;
+}
+mar_motion;
+
+/**
+ * Resets a motion model to a stationary transformation which has not been measured.  The first measurement
+ * afterwards replaces the transformation instead of correcting it.
+ *
+ * @param motion The motion model
+ * @param transform The transformation
+ */
+void mar_motion_reset(mar_motion *motion, const mar_affine *transform);
+
+/**
+ * Predicts the transformation a number of frames after the last frame.  A model which has been lost for
+ * longer than it may coast is not moving.
+ *
+ * @param motion The motion model
+ * @param frames The number of frames ahead
+ * @param max_coast_frames The maximum number of frames in a row a lost transformation is predicted for
+ * @param predicted Will be filled with the predicted transformation
+ */
+void mar_motion_predict(const mar_motion *motion, int frames, int max_coast_frames, mar_affine *predicted);
+
+/**
+ * Advances a motion model to the next frame with a measured transformation.  The measurement replaces the
+ * transformation after a reset or once the model has been lost for longer than it may coast.
+ *
+ * @param motion The motion model
+ * @param measured The measured transformation of the frame
+ * @param alpha The gain applied to the difference between the measured and the predicted transformation
+ * @param beta The gain applied to the difference between the measured and the predicted transformation to correct the velocity
+ * @param max_coast_frames The maximum number of frames in a row a lost transformation is predicted for
+ */
+void mar_motion_update(mar_motion *motion, const mar_affine *measured, float alpha, float beta, int max_coast_frames);
+
+/**
+ * Advances a motion model to the next frame without a measurement.  The transformation follows the damped velocity
+ * for up to a number of frames in a row and is then held.
+ *
+ * @param motion The motion model
+ * @param max_coast_frames The maximum number of frames in a row a lost transformation is predicted for
+ */
+void mar_motion_coast(mar_motion *motion, int max_coast_frames);
+
+#endif
@@ -15,37 +15,30 @@
 #include <stdio.h>
 #include <math.h>
 
-/** The MSER filter @return */
-MAR_PRIVATE VlMserFilt *mser_filter = NULL;
-/** The image buffer to store a grayscale of the camera image for MSER filtering @return */
-MAR_PRIVATE unsigned char *mser_image_buffer;
-/** The image buffer width @return */
-MAR_PRIVATE int mser_image_width = 0;
-/** The image buffer height @return */
-MAR_PRIVATE int mser_image_height = 0;
-/** A buffer for holding MSER ellipses found from filtering @return */
-MAR_PRIVATE mar_mser *mser_regions = NULL;
-/** The size of the MSER region buffer @return */
-MAR_PRIVATE int mser_regions_size = MAR_MSER_DEFAULT_NUMBER_OF_REGIONS;
+/** The detector used by the functions without a context, created by mar_mser_new @return */
+MAR_PRIVATE mar_mser_ctx mar_mser_default_ctx;
 
 /**
- * Creates a new MSER filter.  Must be called before calling other MAR MSER functions.
+ * Creates a new MSER detector.  Must be called before calling other functions on the detector.
  *
+ * @param ctx The MSER detector
  * @param width The width of the camera frame
  * @param height The height of the camera frame
  * 
  * @return MAR_ERROR_NONE on success, an error code on failure.
  */
 MAR_PUBLIC
-mar_error_code mar_mser_new(int width, int height)
+mar_error_code mar_mser_ctx_new(mar_mser_ctx *ctx, int width, int height)
 {
   int mser_dimensions[2];
 
+  MAR_CLEAR(*ctx);
+
   // Create the image buffer
-  mser_image_width = width;
-  mser_image_height = height;
-  mser_image_buffer = malloc(width * height);
-  if (mser_image_buffer == NULL)
+  ctx->image_width = width;
+  ctx->image_height = height;
+  ctx->image_buffer = mar_malloc(width * height);
+  if (ctx->image_buffer == NULL)
   {
     return MAR_ERROR_MALLOC;
   }
@@ -53,11 +46,16 @@ mar_error_code mar_mser_new(int width, int height)
   // Create the filter
   mser_dimensions[0] = width;
   mser_dimensions[1] = height;
-  mser_filter = vl_mser_new(2, mser_dimensions);
+  ctx->filter = vl_mser_new(2, mser_dimensions);
+  if (ctx->filter == NULL)
+  {
+    return MAR_ERROR_MALLOC;
+  }
 
   // Create the MSER region buffer
-  mser_regions = malloc(sizeof(mar_mser) * MAR_MSER_DEFAULT_NUMBER_OF_REGIONS);
-  if (mser_regions == NULL)
+  ctx->regions_size = MAR_MSER_DEFAULT_NUMBER_OF_REGIONS;
+  ctx->regions = mar_malloc(sizeof(mar_mser) * MAR_MSER_DEFAULT_NUMBER_OF_REGIONS);
+  if (ctx->regions == NULL)
   {
     return MAR_ERROR_MALLOC;
   }
@@ -66,46 +64,107 @@ mar_error_code mar_mser_new(int width, int height)
 }
 
 /**
- * Frees the MSER filter created by mar_mser_new.
+ * Frees an MSER detector created by mar_mser_ctx_new.
+ *
+ * @param ctx The MSER detector
  */
 MAR_PUBLIC
-void mar_mser_free()
+void mar_mser_ctx_free(mar_mser_ctx *ctx)
 {
-  if (mser_image_buffer != NULL)
+  if (ctx->image_buffer != NULL)
   {
-    free(mser_image_buffer);
-    mser_image_buffer = NULL;
+    mar_free(ctx->image_buffer);
+    ctx->image_buffer = NULL;
   }
 
-  if (mser_filter != NULL)
+  if (ctx->filter != NULL)
   {
-    vl_mser_delete(mser_filter);
-    mser_filter = NULL;
+    vl_mser_delete(ctx->filter);
+    ctx->filter = NULL;
   }
 
-  if (mser_regions != NULL)
+  if (ctx->regions != NULL)
   {
-    free(mser_regions);
-    mser_regions = NULL;
+    mar_free(ctx->regions);
+    ctx->regions = NULL;
   }
 }
 
+/**
+ * Changes the size of the images an MSER detector filters, recreating its filter with the same parameters.
+ * Filtering a downscaled image finds the larger regions at a fraction of the cost, in the downscaled image's
+ * coordinates.  Nothing is recreated if the size is unchanged.
+ *
+ * @param ctx The MSER detector
+ * @param width The width of the images
+ * @param height The height of the images
+ *
+ * @return MAR_ERROR_NONE on success, an error code on failure, in which case the detector is unchanged.
+ */
+MAR_PUBLIC
+mar_error_code mar_mser_ctx_set_size(mar_mser_ctx *ctx, int width, int height)
+{
+  int mser_dimensions[2];
+  unsigned char *image_buffer;
+  VlMserFilt *filter;
+
+  if (ctx->filter == NULL)
+  {
+    return MAR_ERROR_MSER_FILTER_NOT_CREATED;
+  }
+  if (width == ctx->image_width && height == ctx->image_height)
+  {
+    return MAR_ERROR_NONE;
+  }
+
+  // Create the filter and buffer before releasing the old ones
+  mser_dimensions[0] = width;
+  mser_dimensions[1] = height;
+  filter = vl_mser_new(2, mser_dimensions);
+  if (filter == NULL)
+  {
+    return MAR_ERROR_MALLOC;
+  }
+  image_buffer = mar_malloc(width * height);
+  if (image_buffer == NULL)
+  {
+    vl_mser_delete(filter);
+    return MAR_ERROR_MALLOC;
+  }
+
+  // The areas are fractions of the image, so the same parameters find the same regions at any size
+  vl_mser_set_delta(filter, vl_mser_get_delta(ctx->filter));
+  vl_mser_set_min_area(filter, vl_mser_get_min_area(ctx->filter));
+  vl_mser_set_max_area(filter, vl_mser_get_max_area(ctx->filter));
+  vl_mser_set_max_variation(filter, vl_mser_get_max_variation(ctx->filter));
+  vl_mser_set_min_diversity(filter, vl_mser_get_min_diversity(ctx->filter));
+  vl_mser_delete(ctx->filter);
+  mar_free(ctx->image_buffer);
+  ctx->filter = filter;
+  ctx->image_buffer = image_buffer;
+  ctx->image_width = width;
+  ctx->image_height = height;
+
+  return MAR_ERROR_NONE;
+}
+
 /**
  * Sets the delta value for MSER filter.  May only be called if a MSER filter has been created.
  *
+ * @param ctx The MSER detector
  * @param delta The filter delta
  *
  * @return MAR_ERROR_NONE on success, an error code on failure.
  */
 MAR_PUBLIC
-mar_error_code mar_mser_set_delta(float delta)
+mar_error_code mar_mser_ctx_set_delta(mar_mser_ctx *ctx, float delta)
 {
-  if (mser_filter == NULL)
+  if (ctx->filter == NULL)
   {
     return MAR_ERROR_MSER_FILTER_NOT_CREATED;
   }
 
-  vl_mser_set_delta(mser_filter, delta);
+  vl_mser_set_delta(ctx->filter, delta);
 
   return MAR_ERROR_NONE;
 }
@@ -113,19 +172,20 @@ mar_error_code mar_mser_set_delta(float delta)
 /**
  * Sets the minimum area for MSER filter regions.  May only be called if a MSER filter has been created.
  *
+ * @param ctx The MSER detector
  * @param min_area The minimum region area, normalized to [0-1], where one is the total area of the image.
  *
  * @return MAR_ERROR_NONE on success, an error code on failure.
  */
 MAR_PUBLIC
-mar_error_code mar_mser_set_min_area(float min_area)
+mar_error_code mar_mser_ctx_set_min_area(mar_mser_ctx *ctx, float min_area)
 {
-  if (mser_filter == NULL)
+  if (ctx->filter == NULL)
   {
     return MAR_ERROR_MSER_FILTER_NOT_CREATED;
   }
 
-  vl_mser_set_min_area(mser_filter, min_area);
+  vl_mser_set_min_area(ctx->filter, min_area);
 
   return MAR_ERROR_NONE;
 }
@@ -133,19 +193,20 @@ mar_error_code mar_mser_set_min_area(float min_area)
 /**
  * Sets the maximum area for MSER filter regions.  May only be called if a MSER filter has been created.
  *
+ * @param ctx The MSER detector
  * @param max_area The maximum region area, normalized to [0-1], where one is the total area of the image.
  *
  * @return MAR_ERROR_NONE on success, an error code on failure.
  */
 MAR_PUBLIC
-mar_error_code mar_mser_set_max_area(float max_area)
+mar_error_code mar_mser_ctx_set_max_area(mar_mser_ctx *ctx, float max_area)
 {
-  if (mser_filter == NULL)
+  if (ctx->filter == NULL)
   {
     return MAR_ERROR_MSER_FILTER_NOT_CREATED;
   }
 
-  vl_mser_set_max_area(mser_filter, max_area);
+  vl_mser_set_max_area(ctx->filter, max_area);
 
   return MAR_ERROR_NONE;
 }
@@ -153,19 +214,20 @@ mar_error_code mar_mser_set_max_area(float max_area)
 /**
  * Sets the max variation value for MSER filter.  May only be called if a MSER filter has been created.
  *
+ * @param ctx The MSER detector
  * @param max_variation The filter max variation
  *
  * @return MAR_ERROR_NONE on success, an error code on failure.
  */
 MAR_PUBLIC
-mar_error_code mar_mser_set_max_variation(float max_variation)
+mar_error_code mar_mser_ctx_set_max_variation(mar_mser_ctx *ctx, float max_variation)
 {
-  if (mser_filter == NULL)
+  if (ctx->filter == NULL)
   {
     return MAR_ERROR_MSER_FILTER_NOT_CREATED;
   }
 
-  vl_mser_set_max_variation(mser_filter, max_variation);
+  vl_mser_set_max_variation(ctx->filter, max_variation);
 
   return MAR_ERROR_NONE;
 }
@@ -173,19 +235,20 @@ mar_error_code mar_mser_set_max_variation(float max_variation)
 /**
  * Sets the minimum diversity value for MSER filter.  May only be called if a MSER filter has been created.
  *
+ * @param ctx The MSER detector
  * @param min_diversity The filter minimum diversity
  *
  * @return MAR_ERROR_NONE on success, an error code on failure.
  */
 MAR_PUBLIC
-mar_error_code mar_mser_set_min_diversity(float min_diversity)
+mar_error_code mar_mser_ctx_set_min_diversity(mar_mser_ctx *ctx, float min_diversity)
 {
-  if (mser_filter == NULL)
+  if (ctx->filter == NULL)
   {
     return MAR_ERROR_MSER_FILTER_NOT_CREATED;
   }
 
-  vl_mser_set_min_diversity(mser_filter, min_diversity);
+  vl_mser_set_min_diversity(ctx->filter, min_diversity);
 
   return MAR_ERROR_NONE;
 }
@@ -193,19 +256,20 @@ mar_error_code mar_mser_set_min_diversity(float min_diversity)
 /**
  * Gets the delta value for MSER filter.  May only be called if a MSER filter has been created.
  *
+ * @param ctx The MSER detector
  * @param delta Will be filled with the filter delta
  *
  * @return MAR_ERROR_NONE on success, an error code on failure.
  */
 MAR_PUBLIC
-mar_error_code mar_mser_get_delta(float *delta)
+mar_error_code mar_mser_ctx_get_delta(mar_mser_ctx *ctx, float *delta)
 {
-  if (mser_filter == NULL)
+  if (ctx->filter == NULL)
   {
     return MAR_ERROR_MSER_FILTER_NOT_CREATED;
   }
 
-  *delta = vl_mser_get_delta(mser_filter);
+  *delta = vl_mser_get_delta(ctx->filter);
 
   return MAR_ERROR_NONE;
 }
@@ -213,19 +277,20 @@ mar_error_code mar_mser_get_delta(float *delta)
 /**
  * Gets the minimum area for MSER filter regions.  May only be called if a MSER filter has been created.
  *
+ * @param ctx The MSER detector
  * @param min_area Will be filled with the minimum region area, normalized to [0-1], where one is the total area of the image.
  *
  * @return MAR_ERROR_NONE on success, an error code on failure.
  */
 MAR_PUBLIC
-mar_error_code mar_mser_get_min_area(float *min_area)
+mar_error_code mar_mser_ctx_get_min_area(mar_mser_ctx *ctx, float *min_area)
 {
-  if (mser_filter == NULL)
+  if (ctx->filter == NULL)
   {
     return MAR_ERROR_MSER_FILTER_NOT_CREATED;
   }
 
-  *min_area = vl_mser_get_min_area(mser_filter);
+  *min_area = vl_mser_get_min_area(ctx->filter);
 
   return MAR_ERROR_NONE;
 }
@@ -233,19 +298,20 @@ mar_error_code mar_mser_get_min_area(float *min_area)
 /**
  * Gets the maximum area for MSER filter regions.  May only be called if a MSER filter has been created.
  *
+ * @param ctx The MSER detector
  * @param max_area Will be filled with the maximum region area, normalized to [0-1], where one is the total area of the image.
  *
  * @return MAR_ERROR_NONE on success, an error code on failure.
  */
 MAR_PUBLIC
-mar_error_code mar_mser_get_max_area(float *max_area)
+mar_error_code mar_mser_ctx_get_max_area(mar_mser_ctx *ctx, float *max_area)
 {
-  if (mser_filter == NULL)
+  if (ctx->filter == NULL)
   {
     return MAR_ERROR_MSER_FILTER_NOT_CREATED;
   }
 
-  *max_area = vl_mser_get_max_area(mser_filter);
+  *max_area = vl_mser_get_max_area(ctx->filter);
 
   return MAR_ERROR_NONE;
 }
@@ -253,19 +319,20 @@ mar_error_code mar_mser_get_max_area(float *max_area)
 /**
  * Gets the max variation value for MSER filter.  May only be called if a MSER filter has been created.
  *
+ * @param ctx The MSER detector
  * @param max_variation Will be filled with the filter's max variation
  *
  * @return MAR_ERROR_NONE on success, an error code on failure.
  */
 MAR_PUBLIC
-mar_error_code mar_mser_get_max_variation(float *max_variation)
+mar_error_code mar_mser_ctx_get_max_variation(mar_mser_ctx *ctx, float *max_variation)
 {
-  if (mser_filter == NULL)
+  if (ctx->filter == NULL)
   {
     return MAR_ERROR_MSER_FILTER_NOT_CREATED;
   }
 
-  *max_variation = vl_mser_get_max_variation(mser_filter);
+  *max_variation = vl_mser_get_max_variation(ctx->filter);
 
   return MAR_ERROR_NONE;
 }
@@ -273,19 +340,20 @@ mar_error_code mar_mser_get_max_variation(float *max_variation)
 /**
  * Gets the minimum diversity value for MSER filter.  May only be called if a MSER filter has been created.
  *
+ * @param ctx The MSER detector
  * @param min_diversity The filter minimum diversity
  *
  * @return MAR_ERROR_NONE on success, an error code on failure.
  */
 MAR_PUBLIC
-mar_error_code mar_mser_get_min_diversity(float *min_diversity)
+mar_error_code mar_mser_ctx_get_min_diversity(mar_mser_ctx *ctx, float *min_diversity)
 {
-  if (mser_filter == NULL)
+  if (ctx->filter == NULL)
   {
     return MAR_ERROR_MSER_FILTER_NOT_CREATED;
   }
 
-  *min_diversity = vl_mser_get_min_diversity(mser_filter);
+  *min_diversity = vl_mser_get_min_diversity(ctx->filter);
 
   return MAR_ERROR_NONE;
 }
@@ -294,6 +362,7 @@ mar_error_code mar_mser_get_min_diversity(float *min_diversity)
  * Calculates and returns the maximally stable extremal regions for a
  * camera frame.
  *
+ * @param ctx The MSER detector
  * @param regions A pointer to a pointer which will be modified to point to the array of regions.
  * @param num_regions The number of MSER, and the size of the regions array
  * @param frame_buffer The camera's frame buffer
@@ -301,91 +370,319 @@ mar_error_code mar_mser_get_min_diversity(float *min_diversity)
  * @return MAR_ERROR_NONE on success, an error code on failure.
  */
 MAR_PUBLIC
-mar_error_code mar_mser_get_regions(mar_mser **regions, int *num_regions, unsigned char *frame_buffer)
+mar_error_code mar_mser_ctx_get_regions(mar_mser_ctx *ctx, mar_mser **regions, int *num_regions, unsigned char *frame_buffer)
+{
+  int i;
+
+  // Build grayscale image
+  for (i = 0; i < ctx->image_width * ctx->image_height; i++)
+  {
+    ctx->image_buffer[i] = frame_buffer[i*3 + 0] * .3 + frame_buffer[i*3 + 1] * .59 + frame_buffer[i*3 + 2] * .11;
+  }
+
+  return mar_mser_ctx_get_regions_from_grayscale(ctx, regions, num_regions, ctx->image_buffer, NULL);
+}
+
+/**
+ * Calculates and returns the maximally stable extremal regions for a
+ * grayscale camera frame.  The images are not modified.
+ *
+ * @param ctx The MSER detector
+ * @param regions A pointer to a pointer which will be modified to point to the array of regions.
+ * @param num_regions The number of MSER, and the size of the regions array
+ * @param image The 8-bit grayscale camera frame, width * height in size
+ * @param inverse_image The inverse of image, or NULL to have the filter build it
+ *
+ * @return MAR_ERROR_NONE on success, an error code on failure.
+ */
+MAR_PUBLIC
+mar_error_code mar_mser_ctx_get_regions_from_grayscale(mar_mser_ctx *ctx, mar_mser **regions, int *num_regions, const unsigned char *image, const unsigned char *inverse_image)
 {
   int i, j;
   float xx, yy, xy;
-  vl_uint const *regs;
   float const *ellipsoids;
-  VlMserStats const *stats;
+  mar_mser *grown;
 
-  // Build grayscale image
-  for (i = 0; i < mser_image_width * mser_image_height; i++)
+  if (ctx->filter == NULL)
   {
-    mser_image_buffer[i] = frame_buffer[i*3 + 0] * .3 + frame_buffer[i*3 + 1] * .59 + frame_buffer[i*3 + 2] * .11;
+    return MAR_ERROR_MSER_FILTER_NOT_CREATED;
   }
 
   // Process the image
-  vl_mser_process(mser_filter, mser_image_buffer);	
-  vl_mser_ell_fit(mser_filter);
-  *num_regions = vl_mser_get_regions_num(mser_filter);
-  regs = vl_mser_get_regions(mser_filter);   
-  ellipsoids = vl_mser_get_ell(mser_filter);
-  stats = vl_mser_get_stats(mser_filter);
+  vl_mser_process(ctx->filter, image);	
+  vl_mser_ell_fit(ctx->filter);
+  *num_regions = vl_mser_get_regions_num(ctx->filter);
+  ellipsoids = vl_mser_get_ell(ctx->filter);
 
   // Check if the array needs to be expanded
-  if (*num_regions > mser_regions_size) 
+  if (*num_regions > ctx->regions_size) 
   {
-    mser_regions_size = *num_regions;
-    mser_regions = realloc(mser_regions, sizeof(mar_mser) * mser_regions_size);
-    if (mser_regions == NULL)
+    grown = mar_realloc(ctx->regions, sizeof(mar_mser) * *num_regions);
+    if (grown == NULL)
     {
       return MAR_ERROR_MALLOC;
     }
+    ctx->regions = grown;
+    ctx->regions_size = *num_regions;
   }
   
   // Create the ellipses
   for (i = 0; i < *num_regions; i++)
   {
-    mser_regions[i].ellipse_x = ellipsoids[i*5+MAR_ELLIPSE_MEAN_X];
-    mser_regions[i].ellipse_y = ellipsoids[i*5+MAR_ELLIPSE_MEAN_Y];
+    ctx->regions[i].ellipse_x = ellipsoids[i*5+MAR_ELLIPSE_MEAN_X];
+    ctx->regions[i].ellipse_y = ellipsoids[i*5+MAR_ELLIPSE_MEAN_Y];
     xx = ellipsoids[i*5+MAR_ELLIPSE_VARIANCE_X];
     yy = ellipsoids[i*5+MAR_ELLIPSE_VARIANCE_Y];
     xy = ellipsoids[i*5+MAR_ELLIPSE_COVARIANCE];
-    mser_regions[i].ellipse_angle = -1 * 0.5 * atan2f(2*xy, xx-yy);
-    mser_regions[i].ellipse_a = sqrt(0.5 * (xx + yy + sqrt((xx - yy) * (xx - yy) + 4 * xy * xy)));
-    mser_regions[i].ellipse_b = sqrt(0.5 * (xx + yy - sqrt((xx - yy) * (xx - yy) + 4 * xy * xy)));
+    ctx->regions[i].ellipse_angle = -1 * 0.5 * atan2f(2*xy, xx-yy);
+    ctx->regions[i].ellipse_a = sqrt(0.5 * (xx + yy + sqrt((xx - yy) * (xx - yy) + 4 * xy * xy)));
+    ctx->regions[i].ellipse_b = sqrt(0.5 * (xx + yy - sqrt((xx - yy) * (xx - yy) + 4 * xy * xy)));
   }
 
   // Build inverse grayscale image
-  for (j = 0; j < mser_image_width * mser_image_height; j++)
+  if (inverse_image == NULL)
   {
-    mser_image_buffer[j] = ~mser_image_buffer[j];
+    for (j = 0; j < ctx->image_width * ctx->image_height; j++)
+    {
+      ctx->image_buffer[j] = ~image[j];
+    }
+    inverse_image = ctx->image_buffer;
   }
 
   // Process the image
-  vl_mser_process(mser_filter, mser_image_buffer);	
-  vl_mser_ell_fit(mser_filter);
-  *num_regions += vl_mser_get_regions_num(mser_filter);
-  regs = vl_mser_get_regions(mser_filter);   
-  ellipsoids = vl_mser_get_ell(mser_filter);
-  stats = vl_mser_get_stats(mser_filter);
+  vl_mser_process(ctx->filter, inverse_image);	
+  vl_mser_ell_fit(ctx->filter);
+  *num_regions += vl_mser_get_regions_num(ctx->filter);
+  ellipsoids = vl_mser_get_ell(ctx->filter);
 
   // Check if the array needs to be expanded
-  if (*num_regions > mser_regions_size) 
+  if (*num_regions > ctx->regions_size) 
   {
-    mser_regions_size = *num_regions;
-    mser_regions = realloc(mser_regions, sizeof(mar_mser) * mser_regions_size);
-    if (mser_regions == NULL)
+    grown = mar_realloc(ctx->regions, sizeof(mar_mser) * *num_regions);
+    if (grown == NULL)
     {
       return MAR_ERROR_MALLOC;
     }
+    ctx->regions = grown;
+    ctx->regions_size = *num_regions;
   }
   
   // Create the ellipses
+  // The ellipses of the inverse image are numbered from 0 but stored after those of the image
   for (j = i; j < *num_regions; j++)
   {
-    mser_regions[j].ellipse_x = ellipsoids[j*5+MAR_ELLIPSE_MEAN_X];
-    mser_regions[j].ellipse_y = ellipsoids[j*5+MAR_ELLIPSE_MEAN_Y];
-    xx = ellipsoids[j*5+MAR_ELLIPSE_VARIANCE_X];
-    yy = ellipsoids[j*5+MAR_ELLIPSE_VARIANCE_Y];
-    xy = ellipsoids[j*5+MAR_ELLIPSE_COVARIANCE];
-    mser_regions[j].ellipse_angle = -1 * 0.5 * atan2f(2*xy, xx-yy);
-    mser_regions[j].ellipse_a = sqrt(0.5 * (xx + yy + sqrt((xx - yy) * (xx - yy) + 4 * xy * xy)));
-    mser_regions[j].ellipse_b = sqrt(0.5 * (xx + yy - sqrt((xx - yy) * (xx - yy) + 4 * xy * xy)));
+    ctx->regions[j].ellipse_x = ellipsoids[(j-i)*5+MAR_ELLIPSE_MEAN_X];
+    ctx->regions[j].ellipse_y = ellipsoids[(j-i)*5+MAR_ELLIPSE_MEAN_Y];
+    xx = ellipsoids[(j-i)*5+MAR_ELLIPSE_VARIANCE_X];
+    yy = ellipsoids[(j-i)*5+MAR_ELLIPSE_VARIANCE_Y];
+    xy = ellipsoids[(j-i)*5+MAR_ELLIPSE_COVARIANCE];
+    ctx->regions[j].ellipse_angle = -1 * 0.5 * atan2f(2*xy, xx-yy);
+    ctx->regions[j].ellipse_a = sqrt(0.5 * (xx + yy + sqrt((xx - yy) * (xx - yy) + 4 * xy * xy)));
+    ctx->regions[j].ellipse_b = sqrt(0.5 * (xx + yy - sqrt((xx - yy) * (xx - yy) + 4 * xy * xy)));
   }
 
-  *regions = mser_regions;
+  *regions = ctx->regions;
 
   return MAR_ERROR_NONE;
 }
+
+/**
+ * Creates a new MSER filter.  Must be called before calling other MAR MSER functions without a detector.
+ *
+ * @param width The width of the camera frame
+ * @param height The height of the camera frame
+ * 
+ * @return MAR_ERROR_NONE on success, an error code on failure.
+ */
+MAR_PUBLIC
+mar_error_code mar_mser_new(int width, int height)
+{
+  return mar_mser_ctx_new(&mar_mser_default_ctx, width, height);
+}
+
+/**
+ * Frees the MSER filter created by mar_mser_new.
+ */
+MAR_PUBLIC
+void mar_mser_free()
+{
+  mar_mser_ctx_free(&mar_mser_default_ctx);
+}
+
+/**
+ * Changes the size of the images the MSER filter filters, recreating it with the same parameters.
+ * May only be called if a MSER filter has been created.
+ *
+ * @param width The width of the images
+ * @param height The height of the images
+ *
+ * @return MAR_ERROR_NONE on success, an error code on failure, in which case the filter is unchanged.
+ */
+MAR_PUBLIC
+mar_error_code mar_mser_set_size(int width, int height)
+{
+  return mar_mser_ctx_set_size(&mar_mser_default_ctx, width, height);
+}
+
+/**
+ * Sets the delta value for MSER filter.  May only be called if a MSER filter has been created.
+ *
+ * @param delta The filter delta
+ *
+ * @return MAR_ERROR_NONE on success, an error code on failure.
+ */
+MAR_PUBLIC
+mar_error_code mar_mser_set_delta(float delta)
+{
+  return mar_mser_ctx_set_delta(&mar_mser_default_ctx, delta);
+}
+
+/**
+ * Sets the minimum area for MSER filter regions.  May only be called if a MSER filter has been created.
+ *
+ * @param min_area The minimum region area, normalized to [0-1], where one is the total area of the image.
+ *
+ * @return MAR_ERROR_NONE on success, an error code on failure.
+ */
+MAR_PUBLIC
+mar_error_code mar_mser_set_min_area(float min_area)
+{
+  return mar_mser_ctx_set_min_area(&mar_mser_default_ctx, min_area);
+}
+
+/**
+ * Sets the maximum area for MSER filter regions.  May only be called if a MSER filter has been created.
+ *
+ * @param max_area The maximum region area, normalized to [0-1], where one is the total area of the image.
+ *
+ * @return MAR_ERROR_NONE on success, an error code on failure.
+ */
+MAR_PUBLIC
+mar_error_code mar_mser_set_max_area(float max_area)
+{
+  return mar_mser_ctx_set_max_area(&mar_mser_default_ctx, max_area);
+}
+
+/**
+ * Sets the max variation value for MSER filter.  May only be called if a MSER filter has been created.
+ *
+ * @param max_variation The filter max variation
+ *
+ * @return MAR_ERROR_NONE on success, an error code on failure.
+ */
+MAR_PUBLIC
+mar_error_code mar_mser_set_max_variation(float max_variation)
+{
+  return mar_mser_ctx_set_max_variation(&mar_mser_default_ctx, max_variation);
+}
+
+/**
+ * Sets the minimum diversity value for MSER filter.  May only be called if a MSER filter has been created.
+ *
+ * @param min_diversity The filter minimum diversity
+ *
+ * @return MAR_ERROR_NONE on success, an error code on failure.
+ */
+MAR_PUBLIC
+mar_error_code mar_mser_set_min_diversity(float min_diversity)
+{
+  return mar_mser_ctx_set_min_diversity(&mar_mser_default_ctx, min_diversity);
+}
+
+/**
+ * Gets the delta value for MSER filter.  May only be called if a MSER filter has been created.
+ *
+ * @param delta Will be filled with the filter delta
+ *
+ * @return MAR_ERROR_NONE on success, an error code on failure.
+ */
+MAR_PUBLIC
+mar_error_code mar_mser_get_delta(float *delta)
+{
+  return mar_mser_ctx_get_delta(&mar_mser_default_ctx, delta);
+}
+
+/**
+ * Gets the minimum area for MSER filter regions.  May only be called if a MSER filter has been created.
+ *
+ * @param min_area Will be filled with the minimum region area, normalized to [0-1], where one is the total area of the image.
+ *
+ * @return MAR_ERROR_NONE on success, an error code on failure.
+ */
+MAR_PUBLIC
+mar_error_code mar_mser_get_min_area(float *min_area)
+{
+  return mar_mser_ctx_get_min_area(&mar_mser_default_ctx, min_area);
+}
+
+/**
+ * Gets the maximum area for MSER filter regions.  May only be called if a MSER filter has been created.
+ *
+ * @param max_area Will be filled with the maximum region area, normalized to [0-1], where one is the total area of the image.
+ *
+ * @return MAR_ERROR_NONE on success, an error code on failure.
+ */
+MAR_PUBLIC
+mar_error_code mar_mser_get_max_area(float *max_area)
+{
+  return mar_mser_ctx_get_max_area(&mar_mser_default_ctx, max_area);
+}
+
+/**
+ * Gets the max variation value for MSER filter.  May only be called if a MSER filter has been created.
+ *
+ * @param max_variation Will be filled with the filter's max variation
+ *
+ * @return MAR_ERROR_NONE on success, an error code on failure.
+ */
+MAR_PUBLIC
+mar_error_code mar_mser_get_max_variation(float *max_variation)
+{
+  return mar_mser_ctx_get_max_variation(&mar_mser_default_ctx, max_variation);
+}
+
+/**
+ * Gets the minimum diversity value for MSER filter.  May only be called if a MSER filter has been created.
+ *
+ * @param min_diversity The filter minimum diversity
+ *
+ * @return MAR_ERROR_NONE on success, an error code on failure.
+ */
+MAR_PUBLIC
+mar_error_code mar_mser_get_min_diversity(float *min_diversity)
+{
+  return mar_mser_ctx_get_min_diversity(&mar_mser_default_ctx, min_diversity);
+}
+
+/**
+ * Calculates and returns the maximally stable extremal regions for a
+ * camera frame.
+ *
+ * @param regions A pointer to a pointer which will be modified to point to the array of regions.
+ * @param num_regions The number of MSER, and the size of the regions array
+ * @param frame_buffer The camera's frame buffer
+ *
+ * @return MAR_ERROR_NONE on success, an error code on failure.
+ */
+MAR_PUBLIC
+mar_error_code mar_mser_get_regions(mar_mser **regions, int *num_regions, unsigned char *frame_buffer)
+{
+  return mar_mser_ctx_get_regions(&mar_mser_default_ctx, regions, num_regions, frame_buffer);
+}
+
+/**
+ * Calculates and returns the maximally stable extremal regions for a
+ * grayscale camera frame.  The images are not modified.
+ *
+ * @param regions A pointer to a pointer which will be modified to point to the array of regions.
+ * @param num_regions The number of MSER, and the size of the regions array
+ * @param image The 8-bit grayscale camera frame, width * height in size
+ * @param inverse_image The inverse of image, or NULL to have the filter build it
+ *
+ * @return MAR_ERROR_NONE on success, an error code on failure.
+ */
+MAR_PUBLIC
+mar_error_code mar_mser_get_regions_from_grayscale(mar_mser **regions, int *num_regions, const unsigned char *image, const unsigned char *inverse_image)
+{
+  return mar_mser_ctx_get_regions_from_grayscale(&mar_mser_default_ctx, regions, num_regions, image, inverse_image);
+}
@@ -56,7 +56,28 @@ typedef struct
 mar_mser;
 
 /**
- * Creates a new MSER filter.  Must be called before calling other MAR MSER functions.
+ * An MSER detector with its own filter and buffers.  A detector may only be used by one thread at a time,
+ * but separate detectors may be used from separate threads at once.
+ */
+typedef struct
+{
+  /** The MSER filter, or NULL when not created @return Do not access directly when using the library */
+  void *filter;
+  /** The image buffer to store a grayscale of the camera image for MSER filtering @return Do not access directly when using the library */
+  unsigned char *image_buffer;
+  /** The image buffer width @return Read-Only */
+  int image_width;
+  /** The image buffer height @return Read-Only */
+  int image_height;
+  /** A buffer for holding MSER ellipses found from filtering @return Do not access directly when using the library */
+  mar_mser *regions;
+  /** The size of the MSER region buffer @return Do not access directly when using the library */
+  int regions_size;
+}
+mar_mser_ctx;
+
+/**
+ * Creates a new MSER filter.  Must be called before calling other MAR MSER functions without a detector.
  *
  * @param width The width of the camera frame
  * @param height The height of the camera frame
@@ -70,6 +91,17 @@ mar_error_code mar_mser_new(int width, int height);
  */
 void mar_mser_free();
 
+/**
+ * Changes the size of the images the MSER filter filters, recreating it with the same parameters.
+ * May only be called if a MSER filter has been created.
+ *
+ * @param width The width of the images
+ * @param height The height of the images
+ *
+ * @return MAR_ERROR_NONE on success, an error code on failure, in which case the filter is unchanged.
+ */
+mar_error_code mar_mser_set_size(int width, int height);
+
 /**
  * Sets the delta value for MSER filter.  May only be called if a MSER filter has been created.
  *
@@ -127,6 +159,19 @@ mar_error_code mar_mser_set_min_diversity(float min_diversity);
  */
 mar_error_code mar_mser_get_regions(mar_mser **regions, int *num_regions, unsigned char *frame_buffer);
 
+/**
+ * Calculates and returns the maximally stable extremal regions for a
+ * grayscale camera frame.  The images are not modified.
+ *
+ * @param regions A pointer to a pointer which will be modified to point to the array of regions.
+ * @param num_regions The number of MSER, and the size of the regions array
+ * @param image The 8-bit grayscale camera frame, width * height in size
+ * @param inverse_image The inverse of image, or NULL to have the filter build it
+ *
+ * @return MAR_ERROR_NONE on success, an error code on failure.
+ */
+mar_error_code mar_mser_get_regions_from_grayscale(mar_mser **regions, int *num_regions, const unsigned char *image, const unsigned char *inverse_image);
+
 /**
  * Gets the delta value for MSER filter.  May only be called if a MSER filter has been created.
  *
@@ -172,4 +217,162 @@ mar_error_code mar_mser_get_max_variation(float *max_variation);
  */
 mar_error_code mar_mser_get_min_diversity(float *min_diversity);
 
+/**
+ * Creates a new MSER detector.  Must be called before calling other functions on the detector.
+ *
+ * @param ctx The MSER detector
+ * @param width The width of the camera frame
+ * @param height The height of the camera frame
+ * 
+ * @return MAR_ERROR_NONE on success, an error code on failure.
+ */
+mar_error_code mar_mser_ctx_new(mar_mser_ctx *ctx, int width, int height);
+
+/**
+ * Frees an MSER detector created by mar_mser_ctx_new.
+ *
+ * @param ctx The MSER detector
+ */
+void mar_mser_ctx_free(mar_mser_ctx *ctx);
+
+/**
+ * Changes the size of the images an MSER detector filters, recreating its filter with the same parameters.
+ * Filtering a downscaled image finds the larger regions at a fraction of the cost, in the downscaled image's
+ * coordinates.  Nothing is recreated if the size is unchanged.
+ *
+ * @param ctx The MSER detector
+ * @param width The width of the images
+ * @param height The height of the images
+ *
+ * @return MAR_ERROR_NONE on success, an error code on failure, in which case the detector is unchanged.
+ */
+mar_error_code mar_mser_ctx_set_size(mar_mser_ctx *ctx, int width, int height);
+
+/**
+ * Sets the delta value for MSER filter.  May only be called if a MSER filter has been created.
+ *
+ * @param ctx The MSER detector
+ * @param delta The filter delta
+ *
+ * @return MAR_ERROR_NONE on success, an error code on failure.
+ */
+mar_error_code mar_mser_ctx_set_delta(mar_mser_ctx *ctx, float delta);
+
+/**
+ * Sets the minimum area for MSER filter regions.  May only be called if a MSER filter has been created.
+ *
+ * @param ctx The MSER detector
+ * @param min_area The minimum region area, normalized to [0-1], where one is the total area of the image.
+ *
+ * @return MAR_ERROR_NONE on success, an error code on failure.
+ */
+mar_error_code mar_mser_ctx_set_min_area(mar_mser_ctx *ctx, float min_area);
+
+/**
+ * Sets the maximum area for MSER filter regions.  May only be called if a MSER filter has been created.
+ *
+ * @param ctx The MSER detector
+ * @param max_area The maximum region area, normalized to [0-1], where one is the total area of the image.
+ *
+ * @return MAR_ERROR_NONE on success, an error code on failure.
+ */
+mar_error_code mar_mser_ctx_set_max_area(mar_mser_ctx *ctx, float max_area);
+
+/**
+ * Sets the max variation value for MSER filter.  May only be called if a MSER filter has been created.
+ *
+ * @param ctx The MSER detector
+ * @param max_variation The filter max variation
+ *
+ * @return MAR_ERROR_NONE on success, an error code on failure.
+ */
+mar_error_code mar_mser_ctx_set_max_variation(mar_mser_ctx *ctx, float max_variation);
+
+/**
+ * Sets the minimum diversity value for MSER filter.  May only be called if a MSER filter has been created.
+ *
+ * @param ctx The MSER detector
+ * @param min_diversity The filter minimum diversity
+ *
+ * @return MAR_ERROR_NONE on success, an error code on failure.
+ */
+mar_error_code mar_mser_ctx_set_min_diversity(mar_mser_ctx *ctx, float min_diversity);
+
+/**
+ * Gets the delta value for MSER filter.  May only be called if a MSER filter has been created.
+ *
+ * @param ctx The MSER detector
+ * @param delta Will be filled with the filter delta
+ *
+ * @return MAR_ERROR_NONE on success, an error code on failure.
+ */
+mar_error_code mar_mser_ctx_get_delta(mar_mser_ctx *ctx, float *delta);
+
+/**
+ * Gets the minimum area for MSER filter regions.  May only be called if a MSER filter has been created.
+ *
+ * @param ctx The MSER detector
+ * @param min_area Will be filled with the minimum region area, normalized to [0-1], where one is the total area of the image.
+ *
+ * @return MAR_ERROR_NONE on success, an error code on failure.
+ */
+mar_error_code mar_mser_ctx_get_min_area(mar_mser_ctx *ctx, float *min_area);
+
+/**
+ * Gets the maximum area for MSER filter regions.  May only be called if a MSER filter has been created.
+ *
+ * @param ctx The MSER detector
+ * @param max_area Will be filled with the maximum region area, normalized to [0-1], where one is the total area of the image.
+ *
+ * @return MAR_ERROR_NONE on success, an error code on failure.
+ */
+mar_error_code mar_mser_ctx_get_max_area(mar_mser_ctx *ctx, float *max_area);
+
+/**
+ * Gets the max variation value for MSER filter.  May only be called if a MSER filter has been created.
+ *
+ * @param ctx The MSER detector
+ * @param max_variation Will be filled with the filter's max variation
+ *
+ * @return MAR_ERROR_NONE on success, an error code on failure.
+ */
+mar_error_code mar_mser_ctx_get_max_variation(mar_mser_ctx *ctx, float *max_variation);
+
+/**
+ * Gets the minimum diversity value for MSER filter.  May only be called if a MSER filter has been created.
+ *
+ * @param ctx The MSER detector
+ * @param min_diversity The filter minimum diversity
+ *
+ * @return MAR_ERROR_NONE on success, an error code on failure.
+ */
+mar_error_code mar_mser_ctx_get_min_diversity(mar_mser_ctx *ctx, float *min_diversity);
+
+/**
+ * Calculates and returns the maximally stable extremal regions for a
+ * camera frame.
+ *
+ * @param ctx The MSER detector
+ * @param regions A pointer to a pointer which will be modified to point to the array of regions.
+ * @param num_regions The number of MSER, and the size of the regions array
+ * @param frame_buffer The camera's frame buffer
+ *
+ * @return MAR_ERROR_NONE on success, an error code on failure.
+ */
+mar_error_code mar_mser_ctx_get_regions(mar_mser_ctx *ctx, mar_mser **regions, int *num_regions, unsigned char *frame_buffer);
+
+/**
+ * Calculates and returns the maximally stable extremal regions for a
+ * grayscale camera frame.  The images are not modified.
+ *
+ * @param ctx The MSER detector
+ * @param regions A pointer to a pointer which will be modified to point to the array of regions.
+ * @param num_regions The number of MSER, and the size of the regions array
+ * @param image The 8-bit grayscale camera frame, width * height in size
+ * @param inverse_image The inverse of image, or NULL to have the filter build it
+ *
+ * @return MAR_ERROR_NONE on success, an error code on failure.
+ */
+mar_error_code mar_mser_ctx_get_regions_from_grayscale(mar_mser_ctx *ctx, mar_mser **regions, int *num_regions, const unsigned char *image, const unsigned char *inverse_image);
+
 #endif
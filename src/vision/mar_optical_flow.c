@@ -0,0 +1,204 @@
+/**
+ * @file mar_optical_flow.c
+ *
+ * Contains a pyramidal Lucas-Kanade tracker which follows points from one frame to the next.  Each point's
+ * displacement is found on the coarsest level of the image pyramids first and refined down to full resolution,
+ * so points can move further than the tracking window between frames.
+ *
+ * @author Greg Eddington
+ */
+
+#include "../common/mar_common.h"
+#include "mar_optical_flow.h"
+
+#include <math.h>
+
+/** The number of pixels in the largest tracking window */
+#define MAR_OPTICAL_FLOW_MAX_WINDOW_SIZE ((2*MAR_OPTICAL_FLOW_MAX_WINDOW_RADIUS + 1) * (2*MAR_OPTICAL_FLOW_MAX_WINDOW_RADIUS + 1))
+
+/**
+ * Samples an image between pixels by bilinear interpolation.  The sample and its right and lower neighbours
+ * must be within the image.
+ *
+ * @param image The 8-bit grayscale image
+ * @param width The width of the image
+ * @param x The X coordinate
+ * @param y The Y coordinate
+ *
+ * @return The interpolated intensity
+ */
+MAR_PRIVATE
+float mar_optical_flow_sample(const unsigned char *image, int width, float x, float y)
+{
+  int ix = (int)x, iy = (int)y;
+  float fx = x - ix, fy = y - iy;
+  const unsigned char *p = image + iy * width + ix;
+
+  return (1 - fy) * ((1 - fx) * p[0] + fx * p[1]) + fy * ((1 - fx) * p[width] + fx * p[width + 1]);
+}
+
+/**
+ * Builds every level of a pyramid so that it may then be tracked from several threads at once.
+ *
+ * @param pyramid The pyramid
+ */
+MAR_PUBLIC
+void mar_optical_flow_prepare(mar_image_pyramid *pyramid)
+{
+  mar_image_pyramid_get_gray(pyramid, pyramid->num_levels - 1, NULL, NULL);
+}
+
+/**
+ * Finds the displacement of a window from one image to the next by Gauss-Newton iterations, starting from a guess.
+ *
+ * @param previous The image the window is in
+ * @param current The image to find the window in
+ * @param width The width of the images
+ * @param height The height of the images
+ * @param x The X coordinate of the window's center in the previous image
+ * @param y The Y coordinate of the window's center in the previous image
+ * @param window_radius The radius of the window
+ * @param max_iterations The maximum number of iterations
+ * @param dx The guessed X displacement, updated with the displacement found
+ * @param dy The guessed Y displacement, updated with the displacement found
+ *
+ * @return 1 if the window was found, 0 if it left the images or has too little texture
+ */
+MAR_PRIVATE
+char mar_optical_flow_track_level(const unsigned char *previous, const unsigned char *current, int width, int height,
+    float x, float y, int window_radius, int max_iterations, float *dx, float *dy)
+{
+  float template_window[MAR_OPTICAL_FLOW_MAX_WINDOW_SIZE], ix[MAR_OPTICAL_FLOW_MAX_WINDOW_SIZE], iy[MAR_OPTICAL_FLOW_MAX_WINDOW_SIZE];
+  float gxx = 0, gxy = 0, gyy = 0, bx, by, det, min_eigenvalue, diff, ux, uy, cx, cy;
+  int i, j, k, n, iteration;
+
+  // The window and its gradients must stay within the previous image
+  if (x - window_radius - 1 < 0 || y - window_radius - 1 < 0 || x + window_radius + 2 >= width || y + window_radius + 2 >= height)
+  {
+    return 0;
+  }
+
+  // Sample the window and its gradients once, they do not change between iterations
+  n = 0;
+  for (j = -window_radius; j <= window_radius; j++)
+  {
+    for (i = -window_radius; i <= window_radius; i++, n++)
+    {
+      template_window[n] = mar_optical_flow_sample(previous, width, x + i, y + j);
+      ix[n] = (mar_optical_flow_sample(previous, width, x + i + 1, y + j) - mar_optical_flow_sample(previous, width, x + i - 1, y + j)) / 2;
+      iy[n] = (mar_optical_flow_sample(previous, width, x + i, y + j + 1) - mar_optical_flow_sample(previous, width, x + i, y + j - 1)) / 2;
+      gxx += ix[n] * ix[n];
+      gxy += ix[n] * iy[n];
+      gyy += iy[n] * iy[n];
+    }
+  }
+
+  // Lose windows without texture in both directions, where the displacement is not determined
+  det = gxx * gyy - gxy * gxy;
+  min_eigenvalue = (gxx + gyy - sqrtf((gxx - gyy) * (gxx - gyy) + 4 * gxy * gxy)) / 2;
+  if (min_eigenvalue / n < MAR_OPTICAL_FLOW_MIN_EIGENVALUE || det == 0)
+  {
+    return 0;
+  }
+
+  for (iteration = 0; iteration < max_iterations; iteration++)
+  {
+    cx = x + *dx;
+    cy = y + *dy;
+    if (cx - window_radius < 0 || cy - window_radius < 0 || cx + window_radius + 1 >= width || cy + window_radius + 1 >= height)
+    {
+      return 0;
+    }
+
+    // Accumulate the mismatch between the window and the current image weighted by the gradients
+    bx = by = 0;
+    k = 0;
+    for (j = -window_radius; j <= window_radius; j++)
+    {
+      for (i = -window_radius; i <= window_radius; i++, k++)
+      {
+        diff = template_window[k] - mar_optical_flow_sample(current, width, cx + i, cy + j);
+        bx += diff * ix[k];
+        by += diff * iy[k];
+      }
+    }
+
+    ux = (gyy * bx - gxy * by) / det;
+    uy = (gxx * by - gxy * bx) / det;
+    *dx += ux;
+    *dy += uy;
+    if (ux * ux + uy * uy < MAR_OPTICAL_FLOW_EPSILON * MAR_OPTICAL_FLOW_EPSILON)
+    {
+      break;
+    }
+  }
+
+  return 1;
+}
+
+/**
+ * Tracks points from one frame to the next.  The pyramids must have the same sizes and numbers of levels, and
+ * must have been prepared with mar_optical_flow_prepare.
+ *
+ * @param previous The image pyramid of the frame the points are in
+ * @param current The image pyramid of the frame to track the points into
+ * @param x The X coordinates of the points in the previous frame
+ * @param y The Y coordinates of the points in the previous frame
+ * @param num_points The number of points
+ * @param window_radius The radius of the window tracked around each point, at most MAR_OPTICAL_FLOW_MAX_WINDOW_RADIUS
+ * @param max_iterations The maximum number of iterations on each pyramid level
+ * @param tracked_x Will be filled with the X coordinates of the points in the current frame
+ * @param tracked_y Will be filled with the Y coordinates of the points in the current frame
+ * @param tracked Will be filled with 1 for each point which was tracked and 0 for each point which was lost
+ *
+ * @return MAR_ERROR_NONE on success, MAR_ERROR_INVALID_ARGUMENT if the pyramids or window do not match
+ */
+MAR_PUBLIC
+mar_error_code mar_optical_flow_track(mar_image_pyramid *previous, mar_image_pyramid *current, 
+    const float *x, const float *y, int num_points, int window_radius, int max_iterations, 
+    float *tracked_x, float *tracked_y, unsigned char *tracked)
+{
+  int i, level, width, height;
+  float dx, dy, guess_x, guess_y, scale;
+  const unsigned char *previous_level, *current_level;
+
+  if (previous->num_levels != current->num_levels || previous->width[0] != current->width[0] || 
+      previous->height[0] != current->height[0] || window_radius < 1 || window_radius > MAR_OPTICAL_FLOW_MAX_WINDOW_RADIUS)
+  {
+    return MAR_ERROR_INVALID_ARGUMENT;
+  }
+
+  for (i = 0; i < num_points; i++)
+  {
+    // Start at the coarsest level with no displacement, doubling the displacement found at each finer level
+    dx = dy = 0;
+    tracked[i] = 0;
+    for (level = previous->num_levels - 1; level >= 0; level--)
+    {
+      previous_level = mar_image_pyramid_get_gray(previous, level, &width, &height);
+      current_level = mar_image_pyramid_get_gray(current, level, NULL, NULL);
+      scale = 1.0f / (1 << level);
+      guess_x = dx;
+      guess_y = dy;
+      tracked[i] = mar_optical_flow_track_level(previous_level, current_level, width, height,
+          x[i] * scale, y[i] * scale, window_radius, max_iterations, &dx, &dy);
+
+      // A coarse level where the window leaves the image or is too blurred only loses its refinement
+      if (!tracked[i])
+      {
+        dx = guess_x;
+        dy = guess_y;
+      }
+      if (level > 0)
+      {
+        dx *= 2;
+        dy *= 2;
+      }
+    }
+
+    tracked_x[i] = x[i] + dx;
+    tracked_y[i] = y[i] + dy;
+  }
+
+  return MAR_ERROR_NONE;
+}
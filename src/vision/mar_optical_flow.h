@@ -0,0 +1,56 @@
+/**
+ * @file mar_optical_flow.h
+ *
+ * Contains a pyramidal Lucas-Kanade tracker which follows points from one frame to the next.  Each point's
+ * displacement is found on the coarsest level of the image pyramids first and refined down to full resolution,
+ * so points can move further than the tracking window between frames.
+ *
+ * @author Greg Eddington
+ */
+
+#ifndef MAR_OPTICAL_FLOW_H
+#define MAR_OPTICAL_FLOW_H
+
+#include "../common/mar_error.h"
+#include "../common/mar_image_pyramid.h"
+
+/** The default radius in pixels of the window tracked around each point, the window is 2 * radius + 1 pixels wide */
+#define MAR_OPTICAL_FLOW_DEFAULT_WINDOW_RADIUS 7
+/** The default maximum number of Gauss-Newton iterations on each pyramid level */
+#define MAR_OPTICAL_FLOW_DEFAULT_MAX_ITERATIONS 10
+/** The maximum window radius */
+#define MAR_OPTICAL_FLOW_MAX_WINDOW_RADIUS 15
+/** Iterations stop once an update moves a point less than this many pixels */
+#define MAR_OPTICAL_FLOW_EPSILON 0.01f
+/** A point is lost when the smaller eigenvalue of its window's gradient matrix per pixel is below this, as the window has too little texture */
+#define MAR_OPTICAL_FLOW_MIN_EIGENVALUE 1e-2f
+
+/**
+ * Builds every level of a pyramid so that it may then be tracked from several threads at once.
+ *
+ * @param pyramid The pyramid
+ */
+void mar_optical_flow_prepare(mar_image_pyramid *pyramid);
+
+/**
+ * Tracks points from one frame to the next.  The pyramids must have the same sizes and numbers of levels, and
+ * must have been prepared with mar_optical_flow_prepare.
+ *
+ * @param previous The image pyramid of the frame the points are in
+ * @param current The image pyramid of the frame to track the points into
+ * @param x The X coordinates of the points in the previous frame
+ * @param y The Y coordinates of the points in the previous frame
+ * @param num_points The number of points
+ * @param window_radius The radius of the window tracked around each point, at most MAR_OPTICAL_FLOW_MAX_WINDOW_RADIUS
+ * @param max_iterations The maximum number of iterations on each pyramid level
+ * @param tracked_x Will be filled with the X coordinates of the points in the current frame
+ * @param tracked_y Will be filled with the Y coordinates of the points in the current frame
+ * @param tracked Will be filled with 1 for each point which was tracked and 0 for each point which was lost
+ *
+ * @return MAR_ERROR_NONE on success, MAR_ERROR_INVALID_ARGUMENT if the pyramids or window do not match
+ */
+mar_error_code mar_optical_flow_track(mar_image_pyramid *previous, mar_image_pyramid *current, 
+    const float *x, const float *y, int num_points, int window_radius, int max_iterations, 
+    float *tracked_x, float *tracked_y, unsigned char *tracked);
+
+#endif
@@ -0,0 +1,717 @@
+/**
+ * @file mar_orb.c
+ *
+ * Contains a fast binary keypoint detector.  FAST corners are found in each level of a frame's image pyramid,
+ * oriented by the intensity centroid of their patch and described by 256 rotated BRIEF tests between pairs of
+ * smoothed points of the patch.  The descriptor bits are packed into the first MAR_DESCRIPTOR_BINARY_BYTES bytes
+ * of each keypoint's descriptor and are compared by their Hamming distance.
+ *
+ * @author Greg Eddington
+ */
+
+#include "../common/mar_common.h"
+#include "mar_orb.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+/** The number of pixels on the circle around a FAST corner */
+#define MAR_ORB_CIRCLE_SIZE 16
+
+/** The number of contiguous pixels of the circle which must all be brighter or all be darker than a corner */
+#define MAR_ORB_ARC_LENGTH 9
+
+/** The distance from a level's border within which corners are not detected, so their patch stays inside the level */
+#define MAR_ORB_BORDER (MAR_ORB_PATCH_RADIUS + 1)
+
+/** The half width of the box each BRIEF test point is smoothed over */
+#define MAR_ORB_BOX_RADIUS 2
+
+/** The largest distance of a BRIEF test point from the keypoint, so its box stays inside the patch when rotated */
+#define MAR_ORB_TEST_RADIUS (MAR_ORB_PATCH_RADIUS - MAR_ORB_BOX_RADIUS)
+
+/** The seed of the generator of the BRIEF test points, fixed so that descriptors are comparable between runs */
+#define MAR_ORB_PATTERN_SEED 0x4d415221u
+
+/** The X offsets of the pixels on the circle around a FAST corner @return */
+MAR_PRIVATE const int mar_orb_circle_x[MAR_ORB_CIRCLE_SIZE] = { 0, 1, 2, 3, 3, 3, 2, 1, 0, -1, -2, -3, -3, -3, -2, -1 };
+
+/** The Y offsets of the pixels on the circle around a FAST corner @return */
+MAR_PRIVATE const int mar_orb_circle_y[MAR_ORB_CIRCLE_SIZE] = { -3, -3, -2, -1, 0, 1, 2, 3, 3, 3, 2, 1, 0, -1, -2, -3 };
+
+/**
+ * Returns the next value of a linear congruential generator.
+ *
+ * @param state The generator state
+ *
+ * @return A value in [0, 65535]
+ */
+MAR_PRIVATE
+unsigned int mar_orb_next_random(unsigned int *state)
+{
+  *state = *state * 1103515245u + 12345u;
+  return (*state >> 16) & 0xffff;
+}
+
+/**
+ * Returns a random BRIEF test offset, concentrated toward the keypoint like a Gaussian.
+ *
+ * @param state The generator state
+ *
+ * @return An offset in [-MAR_ORB_TEST_RADIUS, MAR_ORB_TEST_RADIUS]
+ */
+MAR_PRIVATE
+int mar_orb_random_offset(unsigned int *state)
+{
+  int sum;
+
+  // The sum of two uniform values has a triangular distribution
+  sum = (int)(mar_orb_next_random(state) % (MAR_ORB_TEST_RADIUS + 1)) + (int)(mar_orb_next_random(state) % (MAR_ORB_TEST_RADIUS + 1));
+  return sum - MAR_ORB_TEST_RADIUS;
+}
+
+/**
+ * Fills the BRIEF test points and the patch extents of a detector.
+ *
+ * @param ctx The detector
+ */
+MAR_PRIVATE
+void mar_orb_build_pattern(mar_orb_ctx *ctx)
+{
+  unsigned int state = MAR_ORB_PATTERN_SEED;
+  int i, j, x, y;
+
+  for (i = 0; i < MAR_ORB_NUMBER_OF_TESTS; i++)
+  {
+    for (j = 0; j < 4; j += 2)
+    {
+      // Keep the points within a circle so that rotating them cannot leave the patch
+      do
+      {
+        x = mar_orb_random_offset(&state);
+        y = mar_orb_random_offset(&state);
+      }
+      while (x*x + y*y > MAR_ORB_TEST_RADIUS * MAR_ORB_TEST_RADIUS);
+
+      ctx->pattern[i][j] = (signed char)x;
+      ctx->pattern[i][j + 1] = (signed char)y;
+    }
+  }
+
+  for (i = 0; i <= MAR_ORB_PATCH_RADIUS; i++)
+  {
+    ctx->patch_extent[i] = (int)floorf(sqrtf((float)(MAR_ORB_PATCH_RADIUS * MAR_ORB_PATCH_RADIUS - i*i)));
+  }
+}
+
+/**
+ * Creates a new FAST and rotated BRIEF detector.  Must be called before calling other functions on the detector.
+ *
+ * @param ctx The detector
+ * @param width The width of the camera frame
+ * @param height The height of the camera frame
+ * @param number_of_levels The number of image pyramid levels to detect corners in, between 1 and MAR_IMAGE_PYRAMID_MAX_LEVELS
+ * @param fast_threshold The difference a pixel of the circle around a corner must have to the corner to count toward it
+ * @param max_keypoints The maximum number of keypoints detected in a frame
+ *
+ * @return MAR_ERROR_NONE on success, an error code on failure.
+ */
+MAR_PUBLIC
+mar_error_code mar_orb_ctx_new(mar_orb_ctx *ctx, int width, int height, int number_of_levels, int fast_threshold, int max_keypoints)
+{
+  int i, level_width, level_height;
+
+  MAR_CLEAR(*ctx);
+
+  if (width <= 0 || height <= 0 || number_of_levels < 1 || number_of_levels > MAR_IMAGE_PYRAMID_MAX_LEVELS ||
+      fast_threshold < 1 || fast_threshold > 255 || max_keypoints < 1)
+  {
+    return MAR_ERROR_INVALID_ARGUMENT;
+  }
+
+  ctx->image_width = width;
+  ctx->image_height = height;
+  ctx->number_of_levels = number_of_levels;
+  ctx->fast_threshold = fast_threshold;
+  ctx->max_keypoints = max_keypoints;
+
+  // Levels are sized the same way as the image pyramid's
+  level_width = width;
+  level_height = height;
+  for (i = 0; i < number_of_levels; i++)
+  {
+    ctx->scores[i] = (int *)mar_malloc(sizeof(int) * level_width * level_height);
+    ctx->integrals[i] = (unsigned int *)mar_malloc(sizeof(unsigned int) * (level_width + 1) * (level_height + 1));
+    if (ctx->scores[i] == NULL || ctx->integrals[i] == NULL)
+    {
+      mar_orb_ctx_free(ctx);
+      return MAR_ERROR_MALLOC;
+    }
+    level_width /= 2;
+    level_height /= 2;
+  }
+
+  ctx->corners_size = max_keypoints * 4;
+  ctx->corners = (mar_orb_corner *)mar_malloc(sizeof(mar_orb_corner) * ctx->corners_size);
+  ctx->keypoints = (mar_sift_keypoint *)mar_malloc(sizeof(mar_sift_keypoint) * max_keypoints);
+  if (ctx->corners == NULL || ctx->keypoints == NULL)
+  {
+    mar_orb_ctx_free(ctx);
+    return MAR_ERROR_MALLOC;
+  }
+
+  mar_orb_build_pattern(ctx);
+
+  return MAR_ERROR_NONE;
+}
+
+/**
+ * Frees a detector created by mar_orb_ctx_new.
+ *
+ * @param ctx The detector
+ */
+MAR_PUBLIC
+void mar_orb_ctx_free(mar_orb_ctx *ctx)
+{
+  int i;
+
+  for (i = 0; i < MAR_IMAGE_PYRAMID_MAX_LEVELS; i++)
+  {
+    mar_free(ctx->scores[i]);
+    mar_free(ctx->integrals[i]);
+  }
+  mar_free(ctx->corners);
+  mar_free(ctx->keypoints);
+  MAR_CLEAR(*ctx);
+}
+
+/**
+ * Sets the first image pyramid level corners are detected in.  Skipping the full resolution level detects fewer,
+ * larger keypoints at a fraction of the cost.
+ *
+ * @param ctx The detector
+ * @param first_level The first level, less than the number of levels
+ *
+ * @return MAR_ERROR_NONE on success, MAR_ERROR_INVALID_ARGUMENT if the level is out of range.
+ */
+MAR_PUBLIC
+mar_error_code mar_orb_ctx_set_first_level(mar_orb_ctx *ctx, int first_level)
+{
+  if (first_level < 0 || first_level >= ctx->number_of_levels)
+  {
+    return MAR_ERROR_INVALID_ARGUMENT;
+  }
+
+  ctx->first_level = first_level;
+
+  return MAR_ERROR_NONE;
+}
+
+/**
+ * Sets the difference a pixel of the circle around a corner must have to the corner to count toward it, which
+ * takes effect from the next detection.
+ *
+ * @param ctx The detector
+ * @param fast_threshold The threshold, between 1 and 255
+ *
+ * @return MAR_ERROR_NONE on success, MAR_ERROR_INVALID_ARGUMENT if the threshold is out of range.
+ */
+MAR_PUBLIC
+mar_error_code mar_orb_ctx_set_fast_threshold(mar_orb_ctx *ctx, int fast_threshold)
+{
+  if (fast_threshold < 1 || fast_threshold > 255)
+  {
+    return MAR_ERROR_INVALID_ARGUMENT;
+  }
+
+  ctx->fast_threshold = fast_threshold;
+
+  return MAR_ERROR_NONE;
+}
+
+/**
+ * Computes the FAST corner score of a pixel, the sum of the differences beyond the threshold of the circle
+ * pixels in the direction the corner is brighter or darker than its circle.
+ *
+ * @param image The level's grayscale image
+ * @param stride The width of the level
+ * @param x The X coordinate of the pixel
+ * @param y The Y coordinate of the pixel
+ * @param threshold The FAST threshold
+ *
+ * @return The score, or 0 if the pixel is not a corner
+ */
+MAR_PRIVATE
+int mar_orb_fast_score(const unsigned char *image, int stride, int x, int y, int threshold)
+{
+  const unsigned char *center = &image[y * stride + x];
+  int i, c, p, bright_count, dark_count, bright_score, dark_score;
+  unsigned int bright, dark, run;
+
+  c = *center;
+
+  // An arc of 9 pixels always contains at least 2 of the 4 compass pixels
+  bright_count = 0;
+  dark_count = 0;
+  for (i = 0; i < MAR_ORB_CIRCLE_SIZE; i += 4)
+  {
+    p = center[mar_orb_circle_y[i] * stride + mar_orb_circle_x[i]];
+    bright_count += p > c + threshold;
+    dark_count += p < c - threshold;
+  }
+  if (bright_count < 2 && dark_count < 2)
+  {
+    return 0;
+  }
+
+  bright = 0;
+  dark = 0;
+  bright_score = 0;
+  dark_score = 0;
+  for (i = 0; i < MAR_ORB_CIRCLE_SIZE; i++)
+  {
+    p = center[mar_orb_circle_y[i] * stride + mar_orb_circle_x[i]];
+    if (p > c + threshold)
+    {
+      bright |= 1u << i;
+      bright_score += p - c - threshold;
+    }
+    else if (p < c - threshold)
+    {
+      dark |= 1u << i;
+      dark_score += c - p - threshold;
+    }
+  }
+
+  // Repeat the circle so that runs which wrap around it are found, then AND it with itself shifted to find runs
+  bright |= bright << MAR_ORB_CIRCLE_SIZE;
+  dark |= dark << MAR_ORB_CIRCLE_SIZE;
+  run = bright;
+  for (i = 1; i < MAR_ORB_ARC_LENGTH; i++)
+  {
+    run &= bright >> i;
+  }
+  if (run == 0)
+  {
+    bright_score = 0;
+  }
+  run = dark;
+  for (i = 1; i < MAR_ORB_ARC_LENGTH; i++)
+  {
+    run &= dark >> i;
+  }
+  if (run == 0)
+  {
+    dark_score = 0;
+  }
+
+  return bright_score > dark_score ? bright_score : dark_score;
+}
+
+/**
+ * Clips a frame region to the area of a level corners can be detected in.
+ *
+ * @param region The region in frame coordinates
+ * @param level The level
+ * @param level_width The width of the level
+ * @param level_height The height of the level
+ * @param x0 Will be filled with the first column
+ * @param y0 Will be filled with the first row
+ * @param x1 Will be filled with one past the last column
+ * @param y1 Will be filled with one past the last row
+ *
+ * @return Whether or not the clipped region is empty
+ */
+MAR_PRIVATE
+char mar_orb_clip_region(const mar_sift_region *region, int level, int level_width, int level_height, int *x0, int *y0, int *x1, int *y1)
+{
+  *x0 = region->x >> level;
+  *y0 = region->y >> level;
+  *x1 = (region->x + region->width) >> level;
+  *y1 = (region->y + region->height) >> level;
+
+  *x0 = *x0 > MAR_ORB_BORDER ? *x0 : MAR_ORB_BORDER;
+  *y0 = *y0 > MAR_ORB_BORDER ? *y0 : MAR_ORB_BORDER;
+  *x1 = *x1 < level_width - MAR_ORB_BORDER ? *x1 : level_width - MAR_ORB_BORDER;
+  *y1 = *y1 < level_height - MAR_ORB_BORDER ? *y1 : level_height - MAR_ORB_BORDER;
+
+  return *x0 >= *x1 || *y0 >= *y1;
+}
+
+/**
+ * Appends a corner to the corner buffer of a detector, growing the buffer if needed.
+ *
+ * @param ctx The detector
+ * @param num_corners The number of corners, incremented on success
+ * @param x The X coordinate in its level
+ * @param y The Y coordinate in its level
+ * @param level The level
+ * @param score The corner strength
+ *
+ * @return MAR_ERROR_NONE on success, MAR_ERROR_MALLOC if the buffer could not grow
+ */
+MAR_PRIVATE
+mar_error_code mar_orb_add_corner(mar_orb_ctx *ctx, int *num_corners, int x, int y, int level, int score)
+{
+  mar_orb_corner *corners;
+
+  if (*num_corners == ctx->corners_size)
+  {
+    corners = (mar_orb_corner *)mar_realloc(ctx->corners, sizeof(mar_orb_corner) * ctx->corners_size * 2);
+    if (corners == NULL)
+    {
+      return MAR_ERROR_MALLOC;
+    }
+    ctx->corners = corners;
+    ctx->corners_size *= 2;
+  }
+
+  ctx->corners[*num_corners].x = x;
+  ctx->corners[*num_corners].y = y;
+  ctx->corners[*num_corners].level = level;
+  ctx->corners[*num_corners].score = score;
+  (*num_corners)++;
+
+  return MAR_ERROR_NONE;
+}
+
+/**
+ * Finds the FAST corners within regions of a level which are stronger than their 8 neighbours.
+ *
+ * @param ctx The detector
+ * @param num_corners The number of corners found so far, incremented for each corner found
+ * @param image The level's grayscale image
+ * @param level The level
+ * @param level_width The width of the level
+ * @param level_height The height of the level
+ * @param regions The regions in frame coordinates
+ * @param num_regions The number of regions
+ *
+ * @return MAR_ERROR_NONE on success, an error code on failure
+ */
+MAR_PRIVATE
+mar_error_code mar_orb_detect_level(mar_orb_ctx *ctx, int *num_corners, const unsigned char *image, int level, int level_width,
+    int level_height, const mar_sift_region *regions, int num_regions)
+{
+  int *scores = ctx->scores[level];
+  int i, x, y, x0, y0, x1, y1, score;
+  const int *row;
+  mar_error_code mrv;
+
+  // Clear every region and the ring around it first, so that regions which overlap do not clear each other's scores
+  for (i = 0; i < num_regions; i++)
+  {
+    if (mar_orb_clip_region(&regions[i], level, level_width, level_height, &x0, &y0, &x1, &y1))
+    {
+      continue;
+    }
+    for (y = y0 - 1; y <= y1; y++)
+    {
+      memset(&scores[y * level_width + x0 - 1], 0, sizeof(int) * (x1 - x0 + 2));
+    }
+  }
+
+  for (i = 0; i < num_regions; i++)
+  {
+    if (mar_orb_clip_region(&regions[i], level, level_width, level_height, &x0, &y0, &x1, &y1))
+    {
+      continue;
+    }
+    for (y = y0; y < y1; y++)
+    {
+      for (x = x0; x < x1; x++)
+      {
+        scores[y * level_width + x] = mar_orb_fast_score(image, level_width, x, y, ctx->fast_threshold);
+      }
+    }
+  }
+
+  // Ties are broken toward the first neighbour in raster order so that a plateau keeps exactly one corner
+  for (i = 0; i < num_regions; i++)
+  {
+    if (mar_orb_clip_region(&regions[i], level, level_width, level_height, &x0, &y0, &x1, &y1))
+    {
+      continue;
+    }
+    for (y = y0; y < y1; y++)
+    {
+      row = &scores[y * level_width];
+      for (x = x0; x < x1; x++)
+      {
+        score = row[x];
+        if (score == 0 ||
+            score <= row[x - level_width - 1] || score <= row[x - level_width] || score <= row[x - level_width + 1] ||
+            score <= row[x - 1] || score < row[x + 1] ||
+            score < row[x + level_width - 1] || score < row[x + level_width] || score < row[x + level_width + 1])
+        {
+          continue;
+        }
+
+        mrv = mar_orb_add_corner(ctx, num_corners, x, y, level, score);
+        if (mrv != MAR_ERROR_NONE)
+        {
+          return mrv;
+        }
+      }
+    }
+  }
+
+  return MAR_ERROR_NONE;
+}
+
+/**
+ * Orders corners by decreasing strength, then by position so that duplicates from overlapping regions are adjacent.
+ *
+ * @param a The first corner
+ * @param b The second corner
+ *
+ * @return A negative, zero or positive value as the first corner comes before, with or after the second
+ */
+MAR_PRIVATE
+int mar_orb_compare_corners(const void *a, const void *b)
+{
+  const mar_orb_corner *ca = (const mar_orb_corner *)a, *cb = (const mar_orb_corner *)b;
+
+  if (ca->score != cb->score)
+  {
+    return cb->score - ca->score;
+  }
+  if (ca->level != cb->level)
+  {
+    return ca->level - cb->level;
+  }
+  if (ca->y != cb->y)
+  {
+    return ca->y - cb->y;
+  }
+  return ca->x - cb->x;
+}
+
+/**
+ * Computes the integral image of a level, where each value is the sum of the pixels above and to the left of it.
+ *
+ * @param integral The integral image, (level_width + 1) * (level_height + 1) values
+ * @param image The level's grayscale image
+ * @param level_width The width of the level
+ * @param level_height The height of the level
+ */
+MAR_PRIVATE
+void mar_orb_integrate(unsigned int *integral, const unsigned char *image, int level_width, int level_height)
+{
+  int x, y, stride = level_width + 1;
+  unsigned int row_sum;
+
+  memset(integral, 0, sizeof(unsigned int) * stride);
+  for (y = 0; y < level_height; y++)
+  {
+    integral[(y + 1) * stride] = 0;
+    row_sum = 0;
+    for (x = 0; x < level_width; x++)
+    {
+      row_sum += image[y * level_width + x];
+      integral[(y + 1) * stride + x + 1] = integral[y * stride + x + 1] + row_sum;
+    }
+  }
+}
+
+/**
+ * Returns the sum of the box of pixels around a point from an integral image.
+ *
+ * @param integral The integral image
+ * @param stride The width of the integral image
+ * @param x The X coordinate of the point
+ * @param y The Y coordinate of the point
+ *
+ * @return The sum of the pixels within MAR_ORB_BOX_RADIUS of the point
+ */
+MAR_PRIVATE
+unsigned int mar_orb_box_sum(const unsigned int *integral, int stride, int x, int y)
+{
+  int x0 = x - MAR_ORB_BOX_RADIUS, y0 = y - MAR_ORB_BOX_RADIUS;
+  int x1 = x + MAR_ORB_BOX_RADIUS + 1, y1 = y + MAR_ORB_BOX_RADIUS + 1;
+
+  return integral[y1 * stride + x1] - integral[y0 * stride + x1] - integral[y1 * stride + x0] + integral[y0 * stride + x0];
+}
+
+/**
+ * Orients and describes a corner.
+ *
+ * @param ctx The detector
+ * @param corner The corner
+ * @param image The grayscale image of the corner's level
+ * @param level_width The width of the corner's level
+ * @param keypoint Will be filled with the keypoint in frame coordinates
+ */
+MAR_PRIVATE
+void mar_orb_describe(mar_orb_ctx *ctx, const mar_orb_corner *corner, const unsigned char *image, int level_width, mar_sift_keypoint *keypoint)
+{
+  const unsigned char *center = &image[corner->y * level_width + corner->x];
+  const unsigned int *integral = ctx->integrals[corner->level];
+  int stride = level_width + 1;
+  int i, u, v, extent, m01, m10, row_sum, top, bottom;
+  float angle, c, s, scale;
+  unsigned char *descriptor;
+  const signed char *test;
+
+  // The intensity centroid of the circular patch, summing the rows above and below the center together
+  m10 = 0;
+  m01 = 0;
+  for (u = -MAR_ORB_PATCH_RADIUS; u <= MAR_ORB_PATCH_RADIUS; u++)
+  {
+    m10 += u * center[u];
+  }
+  for (v = 1; v <= MAR_ORB_PATCH_RADIUS; v++)
+  {
+    extent = ctx->patch_extent[v];
+    row_sum = 0;
+    for (u = -extent; u <= extent; u++)
+    {
+      top = center[-v * level_width + u];
+      bottom = center[v * level_width + u];
+      row_sum += bottom - top;
+      m10 += u * (bottom + top);
+    }
+    m01 += v * row_sum;
+  }
+
+  angle = atan2f((float)m01, (float)m10);
+  c = cosf(angle);
+  s = sinf(angle);
+
+  // The unused tail of the descriptor is cleared so that keypoints compare and serialize consistently
+  memset(keypoint->descriptor, 0, sizeof(keypoint->descriptor));
+  descriptor = (unsigned char *)keypoint->descriptor;
+  for (i = 0; i < MAR_ORB_NUMBER_OF_TESTS; i++)
+  {
+    test = ctx->pattern[i];
+    if (mar_orb_box_sum(integral, stride, corner->x + (int)lrintf(c * test[0] - s * test[1]), corner->y + (int)lrintf(s * test[0] + c * test[1])) <
+        mar_orb_box_sum(integral, stride, corner->x + (int)lrintf(c * test[2] - s * test[3]), corner->y + (int)lrintf(s * test[2] + c * test[3])))
+    {
+      descriptor[i / 8] |= (unsigned char)(1 << (i % 8));
+    }
+  }
+
+  scale = (float)(1 << corner->level);
+  keypoint->x = (corner->x + 0.5f) * scale - 0.5f;
+  keypoint->y = (corner->y + 0.5f) * scale - 0.5f;
+  keypoint->radius = MAR_ORB_PATCH_RADIUS * scale;
+  keypoint->angle = angle;
+}
+
+/**
+ * Calculates and returns the keypoints within regions of a camera frame from its image pyramid.
+ *
+ * @param ctx The detector
+ * @param keypoints A pointer to a pointer which will be modified to point to the array of keypoints.
+ * @param num_keypoints The number of keypoints
+ * @param pyramid The image pyramid of the frame
+ * @param regions The regions of the frame in frame coordinates
+ * @param num_regions The number of regions
+ *
+ * @return MAR_ERROR_NONE on success, an error code on failure.
+ */
+MAR_PRIVATE
+mar_error_code mar_orb_detect(mar_orb_ctx *ctx, mar_sift_keypoint **keypoints, int *num_keypoints, mar_image_pyramid *pyramid,
+    const mar_sift_region *regions, int num_regions)
+{
+  const unsigned char *images[MAR_IMAGE_PYRAMID_MAX_LEVELS];
+  int widths[MAR_IMAGE_PYRAMID_MAX_LEVELS], heights[MAR_IMAGE_PYRAMID_MAX_LEVELS];
+  char integrated[MAR_IMAGE_PYRAMID_MAX_LEVELS];
+  int i, level, num_corners, num_levels;
+  const mar_orb_corner *corner;
+  mar_error_code mrv;
+
+  *keypoints = ctx->keypoints;
+  *num_keypoints = 0;
+
+  if (pyramid->width[0] != ctx->image_width || pyramid->height[0] != ctx->image_height)
+  {
+    return MAR_ERROR_INVALID_ARGUMENT;
+  }
+
+  num_levels = pyramid->num_levels < ctx->number_of_levels ? pyramid->num_levels : ctx->number_of_levels;
+  num_corners = 0;
+  for (level = ctx->first_level; level < num_levels; level++)
+  {
+    images[level] = mar_image_pyramid_get_gray(pyramid, level, &widths[level], &heights[level]);
+    if (images[level] == NULL)
+    {
+      return MAR_ERROR_INVALID_ARGUMENT;
+    }
+    integrated[level] = 0;
+
+    mrv = mar_orb_detect_level(ctx, &num_corners, images[level], level, widths[level], heights[level], regions, num_regions);
+    if (mrv != MAR_ERROR_NONE)
+    {
+      return mrv;
+    }
+  }
+
+  // Keep the strongest corners, skipping duplicates found by more than one region
+  qsort(ctx->corners, num_corners, sizeof(mar_orb_corner), mar_orb_compare_corners);
+  for (i = 0; i < num_corners && *num_keypoints < ctx->max_keypoints; i++)
+  {
+    corner = &ctx->corners[i];
+    if (i > 0 && mar_orb_compare_corners(corner, &ctx->corners[i - 1]) == 0)
+    {
+      continue;
+    }
+
+    // Integral images are only built for the levels keypoints are described in
+    if (!integrated[corner->level])
+    {
+      mar_orb_integrate(ctx->integrals[corner->level], images[corner->level], widths[corner->level], heights[corner->level]);
+      integrated[corner->level] = 1;
+    }
+
+    mar_orb_describe(ctx, corner, images[corner->level], widths[corner->level], &ctx->keypoints[*num_keypoints]);
+    (*num_keypoints)++;
+  }
+
+  return MAR_ERROR_NONE;
+}
+
+/**
+ * Calculates and returns the keypoints of a camera frame from its image pyramid.  Levels the pyramid does not
+ * have are skipped.
+ *
+ * @param ctx The detector
+ * @param keypoints A pointer to a pointer which will be modified to point to the array of keypoints.
+ * @param num_keypoints The number of keypoints
+ * @param pyramid The image pyramid of the frame, at the size the detector was created with
+ *
+ * @return MAR_ERROR_NONE on success, an error code on failure.
+ */
+MAR_PUBLIC
+mar_error_code mar_orb_ctx_get_keypoints(mar_orb_ctx *ctx, mar_sift_keypoint **keypoints, int *num_keypoints, mar_image_pyramid *pyramid)
+{
+  mar_sift_region frame;
+
+  frame.x = 0;
+  frame.y = 0;
+  frame.width = ctx->image_width;
+  frame.height = ctx->image_height;
+
+  return mar_orb_detect(ctx, keypoints, num_keypoints, pyramid, &frame, 1);
+}
+
+/**
+ * Calculates and returns the keypoints within regions of a camera frame from its image pyramid.  Only corners
+ * inside a region are detected, but they are described from the whole frame, so regions need no padding.
+ *
+ * @param ctx The detector
+ * @param keypoints A pointer to a pointer which will be modified to point to the array of keypoints.
+ * @param num_keypoints The number of keypoints
+ * @param pyramid The image pyramid of the frame, at the size the detector was created with
+ * @param regions The regions of the frame to detect keypoints in, in frame coordinates
+ * @param num_regions The number of regions
+ *
+ * @return MAR_ERROR_NONE on success, an error code on failure.
+ */
+MAR_PUBLIC
+mar_error_code mar_orb_ctx_get_keypoints_from_regions(mar_orb_ctx *ctx, mar_sift_keypoint **keypoints, int *num_keypoints,
+    mar_image_pyramid *pyramid, const mar_sift_region *regions, int num_regions)
+{
+  return mar_orb_detect(ctx, keypoints, num_keypoints, pyramid, regions, num_regions);
+}
@@ -0,0 +1,164 @@
+/**
+ * @file mar_orb.h
+ *
+ * Contains a fast binary keypoint detector.  FAST corners are found in each level of a frame's image pyramid,
+ * oriented by the intensity centroid of their patch and described by 256 rotated BRIEF tests between pairs of
+ * smoothed points of the patch.  The descriptor bits are packed into the first MAR_DESCRIPTOR_BINARY_BYTES bytes
+ * of each keypoint's descriptor and are compared by their Hamming distance.
+ *
+ * @author Greg Eddington
+ */
+
+#ifndef MAR_ORB_H
+#define MAR_ORB_H
+
+#include "../common/mar_error.h"
+#include "../common/mar_image_pyramid.h"
+#include "mar_descriptor.h"
+#include "mar_sift.h"
+
+/** The default difference a pixel of the circle around a corner must have to the corner to count toward it */
+#define MAR_ORB_DEFAULT_FAST_THRESHOLD 20
+
+/** The default maximum number of keypoints detected in a frame, the strongest corners are kept */
+#define MAR_ORB_DEFAULT_MAX_KEYPOINTS 500
+
+/** The default number of image pyramid levels corners are detected in */
+#define MAR_ORB_DEFAULT_NUMBER_OF_LEVELS 3
+
+/** The radius of the patch a keypoint is oriented and described from */
+#define MAR_ORB_PATCH_RADIUS 15
+
+/** The number of BRIEF tests of a descriptor, one bit each */
+#define MAR_ORB_NUMBER_OF_TESTS (MAR_DESCRIPTOR_BINARY_BYTES * 8)
+
+/** The largest Hamming distance between the descriptors of two matching keypoints */
+#define MAR_ORB_MAX_DIFFERENCE 64
+
+/** A match is unique if its Hamming distance times this is at most the distance of the second best match */
+#define MAR_ORB_UNIQUE_KEYPOINT_THRESHOLD 1.3f
+
+/**
+ * A corner found while detecting keypoints @return Do not access directly when using the library
+ */
+typedef struct
+{
+  /** The X coordinate in its level @return Do not access directly when using the library */
+  int x;
+  /** The Y coordinate in its level @return Do not access directly when using the library */
+  int y;
+  /** The pyramid level @return Do not access directly when using the library */
+  int level;
+  /** The corner strength @return Do not access directly when using the library */
+  int score;
+}
+mar_orb_corner;
+
+/**
+ * A FAST and rotated BRIEF detector with its own buffers.  A detector may only be used by one thread at a time,
+ * but separate detectors may be used from separate threads at once.
+ */
+typedef struct
+{
+  /** The width of the frames @return Read-Only */
+  int image_width;
+  /** The height of the frames @return Read-Only */
+  int image_height;
+  /** The number of pyramid levels corners are detected in @return Read-Only */
+  int number_of_levels;
+  /** The first pyramid level corners are detected in @return Read-Only */
+  int first_level;
+  /** The difference a pixel of the circle around a corner must have to the corner @return Read-Only */
+  int fast_threshold;
+  /** The maximum number of keypoints detected in a frame @return Read-Only */
+  int max_keypoints;
+  /** The corner strength of each pixel of each level @return Do not access directly when using the library */
+  int *scores[MAR_IMAGE_PYRAMID_MAX_LEVELS];
+  /** The integral image of each level, one row and column larger than the level @return Do not access directly when using the library */
+  unsigned int *integrals[MAR_IMAGE_PYRAMID_MAX_LEVELS];
+  /** The corners found in the frame @return Do not access directly when using the library */
+  mar_orb_corner *corners;
+  /** The size of the corner buffer @return Do not access directly when using the library */
+  int corners_size;
+  /** The keypoints of the frame, max_keypoints in size @return Do not access directly when using the library */
+  mar_sift_keypoint *keypoints;
+  /** The point pairs of the BRIEF tests, the X and Y of the first point then the X and Y of the second @return Do not access directly when using the library */
+  signed char pattern[MAR_ORB_NUMBER_OF_TESTS][4];
+  /** The half width of the patch on each row away from its center @return Do not access directly when using the library */
+  int patch_extent[MAR_ORB_PATCH_RADIUS + 1];
+}
+mar_orb_ctx;
+
+/**
+ * Creates a new FAST and rotated BRIEF detector.  Must be called before calling other functions on the detector.
+ *
+ * @param ctx The detector
+ * @param width The width of the camera frame
+ * @param height The height of the camera frame
+ * @param number_of_levels The number of image pyramid levels to detect corners in, between 1 and MAR_IMAGE_PYRAMID_MAX_LEVELS
+ * @param fast_threshold The difference a pixel of the circle around a corner must have to the corner to count toward it
+ * @param max_keypoints The maximum number of keypoints detected in a frame
+ *
+ * @return MAR_ERROR_NONE on success, an error code on failure.
+ */
+mar_error_code mar_orb_ctx_new(mar_orb_ctx *ctx, int width, int height, int number_of_levels, int fast_threshold, int max_keypoints);
+
+/**
+ * Frees a detector created by mar_orb_ctx_new.
+ *
+ * @param ctx The detector
+ */
+void mar_orb_ctx_free(mar_orb_ctx *ctx);
+
+/**
+ * Sets the first image pyramid level corners are detected in.  Skipping the full resolution level detects fewer,
+ * larger keypoints at a fraction of the cost.
+ *
+ * @param ctx The detector
+ * @param first_level The first level, less than the number of levels
+ *
+ * @return MAR_ERROR_NONE on success, MAR_ERROR_INVALID_ARGUMENT if the level is out of range.
+ */
+mar_error_code mar_orb_ctx_set_first_level(mar_orb_ctx *ctx, int first_level);
+
+/**
+ * Sets the difference a pixel of the circle around a corner must have to the corner to count toward it, which
+ * takes effect from the next detection.
+ *
+ * @param ctx The detector
+ * @param fast_threshold The threshold, between 1 and 255
+ *
+ * @return MAR_ERROR_NONE on success, MAR_ERROR_INVALID_ARGUMENT if the threshold is out of range.
+ */
+mar_error_code mar_orb_ctx_set_fast_threshold(mar_orb_ctx *ctx, int fast_threshold);
+
+/**
+ * Calculates and returns the keypoints of a camera frame from its image pyramid.  Levels the pyramid does not
+ * have are skipped.
+ *
+ * @param ctx The detector
+ * @param keypoints A pointer to a pointer which will be modified to point to the array of keypoints.
+ * @param num_keypoints The number of keypoints
+ * @param pyramid The image pyramid of the frame, at the size the detector was created with
+ *
+ * @return MAR_ERROR_NONE on success, an error code on failure.
+ */
+mar_error_code mar_orb_ctx_get_keypoints(mar_orb_ctx *ctx, mar_sift_keypoint **keypoints, int *num_keypoints, mar_image_pyramid *pyramid);
+
+/**
+ * Calculates and returns the keypoints within regions of a camera frame from its image pyramid.  Only corners
+ * inside a region are detected, but they are described from the whole frame, so regions need no padding.
+ *
+ * @param ctx The detector
+ * @param keypoints A pointer to a pointer which will be modified to point to the array of keypoints.
+ * @param num_keypoints The number of keypoints
+ * @param pyramid The image pyramid of the frame, at the size the detector was created with
+ * @param regions The regions of the frame to detect keypoints in, in frame coordinates
+ * @param num_regions The number of regions
+ *
+ * @return MAR_ERROR_NONE on success, an error code on failure.
+ */
+mar_error_code mar_orb_ctx_get_keypoints_from_regions(mar_orb_ctx *ctx, mar_sift_keypoint **keypoints, int *num_keypoints,
+    mar_image_pyramid *pyramid, const mar_sift_region *regions, int num_regions);
+
+#endif
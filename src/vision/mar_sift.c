@@ -12,22 +12,13 @@
 #include <string.h>
 #include <sift.h>
 
-/** The SIFT filter @return */
-MAR_PRIVATE VlSiftFilt *sift_filter = NULL;
-/** The image buffer to store a grayscale of the camera image for SIFT filtering @return */
-MAR_PRIVATE float *sift_image_buffer;
-/** The image buffer width @return */
-MAR_PRIVATE int sift_image_width = 0;
-/** The image buffer height @return */
-MAR_PRIVATE int sift_image_height = 0;
-/** A buffer for holding SIFT keypoints found from filtering @return */
-MAR_PRIVATE mar_sift_keypoint *sift_keypoints = NULL;
-/** The size of the SIFT keypoint buffer @return */
-MAR_PRIVATE int sift_keypoints_size = MAR_SIFT_DEFAULT_NUMBER_OF_KEYPOINTS;
+/** The detector used by the functions without a context, created by mar_sift_new @return */
+MAR_PRIVATE mar_sift_ctx mar_sift_default_ctx;
 
 /**
- * Creates a new SIFT filter.  Must be called before calling other MAR SIFT functions.
+ * Creates a new SIFT detector.  Must be called before calling other functions on the detector.
  *
+ * @param ctx The SIFT detector
  * @param width The width of the camera frame
  * @param height The height of the camera frame
  * @param number_of_octaves The number of octaves used by the SIFT filter.  
@@ -41,23 +32,38 @@ MAR_PRIVATE int sift_keypoints_size = MAR_SIFT_DEFAULT_NUMBER_OF_KEYPOINTS;
  * @return MAR_ERROR_NONE on success, an error code on failure.
  */
 MAR_PUBLIC
-mar_error_code mar_sift_new(int width, int height, int number_of_octaves, int number_of_levels, int first_octave)
+mar_error_code mar_sift_ctx_new(mar_sift_ctx *ctx, int width, int height, int number_of_octaves, int number_of_levels, int first_octave)
 {
+#ifdef MAR_DEBUG_ALLOCATIONS
+  // Count the allocations made inside VLFeat, which include its SIFT, MSER and k-d forest buffers
+  vl_set_alloc_func(mar_malloc, mar_realloc, mar_calloc, mar_free);
+#endif
+
+  MAR_CLEAR(*ctx);
+
   // Create the image buffer
-  sift_image_width = width;
-  sift_image_height = height;
-  sift_image_buffer = malloc(width * height * sizeof(float));
-  if (sift_image_buffer == NULL)
+  ctx->image_width = width;
+  ctx->image_height = height;
+  ctx->image_buffer = mar_malloc(width * height * sizeof(float));
+  if (ctx->image_buffer == NULL)
   {
     return MAR_ERROR_MALLOC;
   }
 
   // Create SIFT filter
-  sift_filter = vl_sift_new(width, height, number_of_octaves, number_of_levels, first_octave);
+  ctx->filter = vl_sift_new(width, height, number_of_octaves, number_of_levels, first_octave);
+  ctx->number_of_octaves = number_of_octaves;
+  ctx->number_of_levels = number_of_levels;
+  ctx->first_octave = first_octave;
+  if (ctx->filter == NULL)
+  {
+    return MAR_ERROR_MALLOC;
+  }
 
   // Create the SIFT keypoint buffer
-  sift_keypoints = malloc(sizeof(mar_sift_keypoint) * MAR_SIFT_DEFAULT_NUMBER_OF_KEYPOINTS);
-  if (sift_keypoints == NULL)
+  ctx->keypoints_size = MAR_SIFT_DEFAULT_NUMBER_OF_KEYPOINTS;
+  ctx->keypoints = mar_malloc(sizeof(mar_sift_keypoint) * MAR_SIFT_DEFAULT_NUMBER_OF_KEYPOINTS);
+  if (ctx->keypoints == NULL)
   {
     return MAR_ERROR_MALLOC;
   }
@@ -66,46 +72,69 @@ mar_error_code mar_sift_new(int width, int height, int number_of_octaves, int nu
 }
 
 /**
- * Frees the SIFT filter created by mar_sift_new.
+ * Frees a SIFT detector created by mar_sift_ctx_new.
+ *
+ * @param ctx The SIFT detector
  */
 MAR_PUBLIC
-void mar_sift_free()
+void mar_sift_ctx_free(mar_sift_ctx *ctx)
 {
-  if (sift_image_buffer != NULL)
+  int i;
+
+  if (ctx->image_buffer != NULL)
   {
-    free(sift_image_buffer);
-    sift_image_buffer = NULL;
+    mar_free(ctx->image_buffer);
+    ctx->image_buffer = NULL;
   }
 
-  if (sift_filter != NULL)
+  if (ctx->filter != NULL)
   {
-    vl_sift_delete(sift_filter);
-    sift_filter = NULL;
+    vl_sift_delete(ctx->filter);
+    ctx->filter = NULL;
   }
 
-  if (sift_keypoints != NULL)
+  for (i = 0; i < MAR_SIFT_MAX_REGION_FILTERS; i++)
   {
-    free(sift_keypoints); 
-    sift_keypoints = NULL;
+    if (ctx->region_filters[i] != NULL)
+    {
+      vl_sift_delete(ctx->region_filters[i]);
+      ctx->region_filters[i] = NULL;
+    }
+  }
+
+  if (ctx->keypoints != NULL)
+  {
+    mar_free(ctx->keypoints); 
+    ctx->keypoints = NULL;
   }
 }
 
 /**
  * Sets the peak threshold value for SIFT filter.  May only be called if a SIFT filter has been created.
  *
+ * @param ctx The SIFT detector
  * @param threshold The peak threshold. This is the minimum amount of contrast to accept a keypoint
  *
  * @return MAR_ERROR_NONE on success, an error code on failure.
  */
 MAR_PUBLIC
-mar_error_code mar_sift_set_peak_threshold(float threshold)
+mar_error_code mar_sift_ctx_set_peak_threshold(mar_sift_ctx *ctx, float threshold)
 {
-  if (sift_filter == NULL)
+  int i;
+
+  if (ctx->filter == NULL)
   {
     return MAR_ERROR_SIFT_FILTER_NOT_CREATED;
   }
 
-  vl_sift_set_peak_thresh(sift_filter, threshold);
+  vl_sift_set_peak_thresh(ctx->filter, threshold);
+  for (i = 0; i < MAR_SIFT_MAX_REGION_FILTERS; i++)
+  {
+    if (ctx->region_filters[i] != NULL)
+    {
+      vl_sift_set_peak_thresh(ctx->region_filters[i], threshold);
+    }
+  }
 
   return MAR_ERROR_NONE;
 }
@@ -113,19 +142,75 @@ mar_error_code mar_sift_set_peak_threshold(float threshold)
 /**
  * Sets the edge threshold value for SIFT filter.  May only be called if a SIFT filter has been created.
  *
+ * @param ctx The SIFT detector
  * @param threshold The edge threshold. This is the edge rejection threshold.
  *
  * @return MAR_ERROR_NONE on success, an error code on failure.
  */
 MAR_PUBLIC
-mar_error_code mar_sift_set_edge_threshold(float threshold)
+mar_error_code mar_sift_ctx_set_edge_threshold(mar_sift_ctx *ctx, float threshold)
 {
-  if (sift_filter == NULL)
+  int i;
+
+  if (ctx->filter == NULL)
   {
     return MAR_ERROR_SIFT_FILTER_NOT_CREATED;
   }
 
-  vl_sift_set_edge_thresh(sift_filter, threshold);
+  vl_sift_set_edge_thresh(ctx->filter, threshold);
+  for (i = 0; i < MAR_SIFT_MAX_REGION_FILTERS; i++)
+  {
+    if (ctx->region_filters[i] != NULL)
+    {
+      vl_sift_set_edge_thresh(ctx->region_filters[i], threshold);
+    }
+  }
+
+  return MAR_ERROR_NONE;
+}
+
+/**
+ * Changes the octaves of a SIFT detector, recreating its filters without changing its frame size, buffers or
+ * thresholds.  Skipping the first octaves of a detector detects fewer, larger keypoints at a fraction of the cost.
+ *
+ * @param ctx The SIFT detector
+ * @param number_of_octaves The number of octaves used by the SIFT filter, or MAR_SIFT_MAX_OCTAVES
+ * @param first_octave The SIFT filter will iterate from first_octave to number_of_octaves
+ *
+ * @return MAR_ERROR_NONE on success, an error code on failure, in which case the detector is unchanged.
+ */
+MAR_PUBLIC
+mar_error_code mar_sift_ctx_set_octaves(mar_sift_ctx *ctx, int number_of_octaves, int first_octave)
+{
+  VlSiftFilt *filter;
+  int i;
+
+  if (ctx->filter == NULL)
+  {
+    return MAR_ERROR_SIFT_FILTER_NOT_CREATED;
+  }
+
+  filter = vl_sift_new(ctx->image_width, ctx->image_height, number_of_octaves, ctx->number_of_levels, first_octave);
+  if (filter == NULL)
+  {
+    return MAR_ERROR_MALLOC;
+  }
+  vl_sift_set_peak_thresh(filter, vl_sift_get_peak_thresh(ctx->filter));
+  vl_sift_set_edge_thresh(filter, vl_sift_get_edge_thresh(ctx->filter));
+  vl_sift_delete(ctx->filter);
+  ctx->filter = filter;
+  ctx->number_of_octaves = number_of_octaves;
+  ctx->first_octave = first_octave;
+
+  // The region filters are recreated like the frame filter the next time their regions are filtered
+  for (i = 0; i < MAR_SIFT_MAX_REGION_FILTERS; i++)
+  {
+    if (ctx->region_filters[i] != NULL)
+    {
+      vl_sift_delete(ctx->region_filters[i]);
+      ctx->region_filters[i] = NULL;
+    }
+  }
 
   return MAR_ERROR_NONE;
 }
@@ -133,19 +218,20 @@ mar_error_code mar_sift_set_edge_threshold(float threshold)
 /**
  * Gets the peak threshold value for SIFT filter.  May only be called if a SIFT filter has been created.
  *
+ * @param ctx The SIFT detector
  * @param threshold Will be set to the peak threshold. This is the minimum amount of contrast to accept a keypoint
  *
  * @return MAR_ERROR_NONE on success, an error code on failure.
  */
 MAR_PUBLIC
-mar_error_code mar_sift_get_peak_threshold(float *threshold)
+mar_error_code mar_sift_ctx_get_peak_threshold(mar_sift_ctx *ctx, float *threshold)
 {
-  if (sift_filter == NULL)
+  if (ctx->filter == NULL)
   {
     return MAR_ERROR_SIFT_FILTER_NOT_CREATED;
   }
 
-  *threshold = vl_sift_get_peak_thresh(sift_filter);
+  *threshold = vl_sift_get_peak_thresh(ctx->filter);
 
   return MAR_ERROR_NONE;
 }
@@ -153,19 +239,20 @@ mar_error_code mar_sift_get_peak_threshold(float *threshold)
 /**
  * Gets the edge threshold value for SIFT filter.  May only be called if a SIFT filter has been created.
  *
+ * @param ctx The SIFT detector
  * @param threshold Will be set to the edge threshold. This is the edge rejection threshold.
  *
  * @return MAR_ERROR_NONE on success, an error code on failure.
  */
 MAR_PUBLIC
-mar_error_code mar_sift_get_edge_threshold(float *threshold)
+mar_error_code mar_sift_ctx_get_edge_threshold(mar_sift_ctx *ctx, float *threshold)
 {
-  if (sift_filter == NULL)
+  if (ctx->filter == NULL)
   {
     return MAR_ERROR_SIFT_FILTER_NOT_CREATED;
   }
 
-  *threshold = vl_sift_get_edge_thresh(sift_filter);
+  *threshold = vl_sift_get_edge_thresh(ctx->filter);
 
   return MAR_ERROR_NONE;
 }
@@ -173,19 +260,20 @@ mar_error_code mar_sift_get_edge_threshold(float *threshold)
 /**
  * Gets the first octave used by the SIFT filter.  May only be called if a SIFT filter has been created.
  *
+ * @param ctx The SIFT detector
  * @param first_octave Will be set to the first octave used by the SIFT filter.
  *
  * @return MAR_ERROR_NONE on success, an error code on failure.
  */
 MAR_PUBLIC
-mar_error_code mar_sift_get_first_octave(int *first_octave)
+mar_error_code mar_sift_ctx_get_first_octave(mar_sift_ctx *ctx, int *first_octave)
 {
-  if (sift_filter == NULL)
+  if (ctx->filter == NULL)
   {
     return MAR_ERROR_SIFT_FILTER_NOT_CREATED;
   }
 
-  *first_octave = vl_sift_get_octave_first(sift_filter);
+  *first_octave = vl_sift_get_octave_first(ctx->filter);
 
   return MAR_ERROR_NONE;
 }
@@ -193,19 +281,20 @@ mar_error_code mar_sift_get_first_octave(int *first_octave)
 /**
  * Gets the number of octaves for SIFT filter.  May only be called if a SIFT filter has been created.
  *
+ * @param ctx The SIFT detector
  * @param number_of_octaves Will be set to the number of octaves.
  *
  * @return MAR_ERROR_NONE on success, an error code on failure.
  */
 MAR_PUBLIC
-mar_error_code mar_sift_get_number_of_octaves(int *number_of_octaves)
+mar_error_code mar_sift_ctx_get_number_of_octaves(mar_sift_ctx *ctx, int *number_of_octaves)
 {
-  if (sift_filter == NULL)
+  if (ctx->filter == NULL)
   {
     return MAR_ERROR_SIFT_FILTER_NOT_CREATED;
   }
 
-  *number_of_octaves = vl_sift_get_noctaves(sift_filter);
+  *number_of_octaves = vl_sift_get_noctaves(ctx->filter);
 
   return MAR_ERROR_NONE;
 }
@@ -213,19 +302,20 @@ mar_error_code mar_sift_get_number_of_octaves(int *number_of_octaves)
 /**
  * Gets the number of levels per octave for SIFT filter.  May only be called if a SIFT filter has been created.
  *
+ * @param ctx The SIFT detector
  * @param number_of_levels Will be set to the number of levels per octave of the SIFT filter.
  *
  * @return MAR_ERROR_NONE on success, an error code on failure.
  */
 MAR_PUBLIC
-mar_error_code mar_sift_get_number_of_levels(int *number_of_levels)
+mar_error_code mar_sift_ctx_get_number_of_levels(mar_sift_ctx *ctx, int *number_of_levels)
 {
-  if (sift_filter == NULL)
+  if (ctx->filter == NULL)
   {
     return MAR_ERROR_SIFT_FILTER_NOT_CREATED;
   }
 
-  *number_of_levels = vl_sift_get_nlevels(sift_filter);
+  *number_of_levels = vl_sift_get_nlevels(ctx->filter);
 
   return MAR_ERROR_NONE;
 }
@@ -233,6 +323,7 @@ mar_error_code mar_sift_get_number_of_levels(int *number_of_levels)
 /**
  * Calculates and returns the SIFT keypoints for a camera frame.
  *
+ * @param ctx The SIFT detector
  * @param keypoints A pointer to a pointer which will be modified to point to the array of keypoints.
  * @param num_keypoints The number of SIFT keypoints, and the size of the regions array
  * @param frame_buffer The camera's frame buffer
@@ -240,65 +331,482 @@ mar_error_code mar_sift_get_number_of_levels(int *number_of_levels)
  * @return MAR_ERROR_NONE on success, an error code on failure.
  */
 MAR_PUBLIC
-mar_error_code mar_sift_get_keypoints(mar_sift_keypoint **keypoints, int *num_keypoints, unsigned char *frame_buffer)
+mar_error_code mar_sift_ctx_get_keypoints(mar_sift_ctx *ctx, mar_sift_keypoint **keypoints, int *num_keypoints, unsigned char *frame_buffer)
 {
-  int i, j, sift_status, norientations, num_points;
-  VlSiftKeypoint const *points;
-  double orientations[4];
-  vl_sift_pix descriptors[MAR_SIFT_NBP * MAR_SIFT_NBP * MAR_SIFT_NBO];
+  int i;
 
   // Build grayscale image
-  for (i = 0; i < sift_image_width * sift_image_height; i++)
+  for (i = 0; i < ctx->image_width * ctx->image_height; i++)
   {
-    sift_image_buffer[i] = (frame_buffer[i*3 + 0] * 0.3 + frame_buffer[i*3 + 1] * 0.59 + frame_buffer[i*3 + 2] * 0.11) / 255.0;
+    ctx->image_buffer[i] = (frame_buffer[i*3 + 0] * 0.3 + frame_buffer[i*3 + 1] * 0.59 + frame_buffer[i*3 + 2] * 0.11) / 255.0;
   }
 
+  return mar_sift_ctx_get_keypoints_from_grayscale(ctx, keypoints, num_keypoints, ctx->image_buffer);
+}
+
+/**
+ * Detects the SIFT keypoints of an image with a filter and appends them to the keypoint buffer.
+ *
+ * @param ctx The SIFT detector owning the keypoint buffer
+ * @param filter The SIFT filter, sized for the image
+ * @param image The grayscale image normalized to [0-1]
+ * @param offset_x Added to the X coordinate of every keypoint
+ * @param offset_y Added to the Y coordinate of every keypoint
+ * @param num_keypoints The number of keypoints in the buffer, incremented for every keypoint appended
+ *
+ * @return MAR_ERROR_NONE on success, an error code on failure.
+ */
+MAR_PRIVATE
+mar_error_code mar_sift_detect(mar_sift_ctx *ctx, VlSiftFilt *filter, const float *image, float offset_x, float offset_y, int *num_keypoints)
+{
+  int i, j, sift_status, norientations, num_points;
+  VlSiftKeypoint const *points;
+  double orientations[4];
+  vl_sift_pix descriptors[MAR_SIFT_NBP * MAR_SIFT_NBP * MAR_SIFT_NBO];
+  mar_sift_keypoint *grown;
+
   // Filter the image
-  *num_keypoints = 0;
-  sift_status = vl_sift_process_first_octave(sift_filter, sift_image_buffer);	
+  sift_status = vl_sift_process_first_octave(filter, image);	
   while (sift_status != VL_ERR_EOF)
   {
-    vl_sift_detect(sift_filter);
+    vl_sift_detect(filter);
 
     // Get the SIFT keypoints
-    points = vl_sift_get_keypoints(sift_filter);
-    num_points = vl_sift_get_nkeypoints(sift_filter);
+    points = vl_sift_get_keypoints(filter);
+    num_points = vl_sift_get_nkeypoints(filter);
 
     // Check if the buffer is too small
-    if (sift_keypoints_size < *num_keypoints + num_points * 4)
+    if (ctx->keypoints_size < *num_keypoints + num_points * 4)
     {
-      sift_keypoints_size = *num_keypoints + num_points * 4;
-      sift_keypoints = realloc(sift_keypoints, sizeof(mar_sift_keypoint) * (*num_keypoints + num_points * 4));
-      if (sift_keypoints == NULL)
+      grown = mar_realloc(ctx->keypoints, sizeof(mar_sift_keypoint) * (*num_keypoints + num_points * 4));
+      if (grown == NULL)
       {
         return MAR_ERROR_MALLOC;
       }
+      ctx->keypoints = grown;
+      ctx->keypoints_size = *num_keypoints + num_points * 4;
     }
 
     // Iterate through the keypoints
     for (i = 0; i < num_points; i++)
     {
         // Iterate through the orientations
-        norientations = vl_sift_calc_keypoint_orientations(sift_filter, orientations, &(points[i]));          
+        norientations = vl_sift_calc_keypoint_orientations(filter, orientations, &(points[i]));          
         for (j = 0; j < norientations; j++)
         {
-            vl_sift_calc_keypoint_descriptor(sift_filter, descriptors, &(points[i]), orientations[j]);
+            vl_sift_calc_keypoint_descriptor(filter, descriptors, &(points[i]), orientations[j]);
             
             // Add the sift keypoint
             assert(sizeof(vl_sift_pix) == sizeof(float));
-            sift_keypoints[*num_keypoints].x = points[i].x;
-            sift_keypoints[*num_keypoints].y = points[i].y;
-            sift_keypoints[*num_keypoints].radius = points[i].s;
-            sift_keypoints[*num_keypoints].angle = points[i].sigma;
-            memcpy(sift_keypoints[*num_keypoints].descriptor, descriptors, MAR_SIFT_NBO * MAR_SIFT_NBP * MAR_SIFT_NBP * sizeof(vl_sift_pix));
+            ctx->keypoints[*num_keypoints].x = points[i].x + offset_x;
+            ctx->keypoints[*num_keypoints].y = points[i].y + offset_y;
+            ctx->keypoints[*num_keypoints].radius = points[i].s;
+            ctx->keypoints[*num_keypoints].angle = points[i].sigma;
+            memcpy(ctx->keypoints[*num_keypoints].descriptor, descriptors, MAR_SIFT_NBO * MAR_SIFT_NBP * MAR_SIFT_NBP * sizeof(vl_sift_pix));
             (*num_keypoints)++;
         }
     }
 
-    sift_status = vl_sift_process_next_octave(sift_filter);	
+    sift_status = vl_sift_process_next_octave(filter);	
   }
 
-  *keypoints = sift_keypoints;
+  return MAR_ERROR_NONE;
+}
+
+/**
+ * Calculates and returns the SIFT keypoints for a grayscale camera frame.  The image is filtered in place,
+ * so no conversion of the camera frame is needed.
+ *
+ * @param ctx The SIFT detector
+ * @param keypoints A pointer to a pointer which will be modified to point to the array of keypoints.
+ * @param num_keypoints The number of SIFT keypoints, and the size of the regions array
+ * @param image The grayscale camera frame normalized to [0-1], width * height floats in size
+ *
+ * @return MAR_ERROR_NONE on success, an error code on failure.
+ */
+MAR_PUBLIC
+mar_error_code mar_sift_ctx_get_keypoints_from_grayscale(mar_sift_ctx *ctx, mar_sift_keypoint **keypoints, int *num_keypoints, const float *image)
+{
+  mar_error_code mrv;
+
+  if (ctx->filter == NULL)
+  {
+    return MAR_ERROR_SIFT_FILTER_NOT_CREATED;
+  }
+
+  *num_keypoints = 0;
+  mrv = mar_sift_detect(ctx, ctx->filter, image, 0, 0, num_keypoints);
+  *keypoints = ctx->keypoints;
+
+  return mrv;
+}
+
+/**
+ * Returns a SIFT filter sized for a region, reusing the least recently used region filter if none is.
+ *
+ * @param ctx The SIFT detector
+ * @param width The width of the region
+ * @param height The height of the region
+ *
+ * @return The filter, or NULL if it could not be created
+ */
+MAR_PRIVATE
+VlSiftFilt *mar_sift_get_region_filter(mar_sift_ctx *ctx, int width, int height)
+{
+  int i, oldest = 0;
+
+  if (width == ctx->image_width && height == ctx->image_height)
+  {
+    return ctx->filter;
+  }
+
+  for (i = 0; i < MAR_SIFT_MAX_REGION_FILTERS; i++)
+  {
+    if (ctx->region_filters[i] != NULL && ctx->region_filter_width[i] == width && ctx->region_filter_height[i] == height)
+    {
+      ctx->region_filter_last_used[i] = ctx->region_calls;
+      return ctx->region_filters[i];
+    }
+    if (ctx->region_filters[i] == NULL || ctx->region_filter_last_used[i] < ctx->region_filter_last_used[oldest])
+    {
+      oldest = i;
+    }
+  }
+
+  // Replace the least recently used filter with one configured like the frame filter
+  if (ctx->region_filters[oldest] != NULL)
+  {
+    vl_sift_delete(ctx->region_filters[oldest]);
+  }
+  ctx->region_filters[oldest] = vl_sift_new(width, height, ctx->number_of_octaves, ctx->number_of_levels, ctx->first_octave);
+  if (ctx->region_filters[oldest] == NULL)
+  {
+    return NULL;
+  }
+  ctx->region_filter_width[oldest] = width;
+  ctx->region_filter_height[oldest] = height;
+  vl_sift_set_peak_thresh(ctx->region_filters[oldest], vl_sift_get_peak_thresh(ctx->filter));
+  vl_sift_set_edge_thresh(ctx->region_filters[oldest], vl_sift_get_edge_thresh(ctx->filter));
+  ctx->region_filter_last_used[oldest] = ctx->region_calls;
+
+  return ctx->region_filters[oldest];
+}
+
+/**
+ * Clamps a region to the frame and grows it to a multiple of MAR_SIFT_REGION_ALIGNMENT, so that regions of
+ * similar sizes share a filter.
+ *
+ * @param ctx The SIFT detector
+ * @param region The region to align
+ */
+MAR_PRIVATE
+void mar_sift_align_region(const mar_sift_ctx *ctx, mar_sift_region *region)
+{
+  int x1 = region->x + region->width, y1 = region->y + region->height;
+
+  region->x = region->x < 0 ? 0 : region->x;
+  region->y = region->y < 0 ? 0 : region->y;
+  x1 = x1 > ctx->image_width ? ctx->image_width : x1;
+  y1 = y1 > ctx->image_height ? ctx->image_height : y1;
+  region->width = x1 - region->x;
+  region->height = y1 - region->y;
+  if (region->width <= 0 || region->height <= 0)
+  {
+    region->width = region->height = 0;
+    return;
+  }
+
+  // Grow to the alignment, shifting back into the frame at its right and bottom edges
+  region->width = (region->width + MAR_SIFT_REGION_ALIGNMENT - 1) / MAR_SIFT_REGION_ALIGNMENT * MAR_SIFT_REGION_ALIGNMENT;
+  region->height = (region->height + MAR_SIFT_REGION_ALIGNMENT - 1) / MAR_SIFT_REGION_ALIGNMENT * MAR_SIFT_REGION_ALIGNMENT;
+  region->width = region->width > ctx->image_width ? ctx->image_width : region->width;
+  region->height = region->height > ctx->image_height ? ctx->image_height : region->height;
+  region->x = region->x + region->width > ctx->image_width ? ctx->image_width - region->width : region->x;
+  region->y = region->y + region->height > ctx->image_height ? ctx->image_height - region->height : region->y;
+}
+
+/**
+ * Calculates and returns the SIFT keypoints within regions of a grayscale camera frame.  Overlapping regions
+ * are merged so that no keypoint is detected twice.  Keypoints within a few pixels of a region's border are
+ * not detected, so regions should be padded.
+ *
+ * @param ctx The SIFT detector
+ * @param keypoints A pointer to a pointer which will be modified to point to the array of keypoints.
+ * @param num_keypoints The number of SIFT keypoints
+ * @param image The grayscale camera frame normalized to [0-1], width * height floats in size
+ * @param regions The regions of the frame to detect keypoints in, in frame coordinates
+ * @param num_regions The number of regions, at most MAR_SIFT_MAX_REGIONS
+ *
+ * @return MAR_ERROR_NONE on success, an error code on failure.
+ */
+MAR_PUBLIC
+mar_error_code mar_sift_ctx_get_keypoints_from_grayscale_regions(mar_sift_ctx *ctx, mar_sift_keypoint **keypoints, int *num_keypoints, const float *image,
+    const mar_sift_region *regions, int num_regions)
+{
+  mar_sift_region merged[MAR_SIFT_MAX_REGIONS];
+  int i, j, x0, y0, x1, y1, num_merged = 0;
+  char merging;
+  VlSiftFilt *filter;
+  mar_error_code mrv;
+
+  if (ctx->filter == NULL)
+  {
+    return MAR_ERROR_SIFT_FILTER_NOT_CREATED;
+  }
+
+  if (num_regions > MAR_SIFT_MAX_REGIONS)
+  {
+    num_regions = MAR_SIFT_MAX_REGIONS;
+  }
+  for (i = 0; i < num_regions; i++)
+  {
+    merged[num_merged] = regions[i];
+    mar_sift_align_region(ctx, &merged[num_merged]);
+    if (merged[num_merged].width > 0)
+    {
+      num_merged++;
+    }
+  }
+
+  // Merge overlapping regions into their bounding box until none overlap
+  do
+  {
+    merging = 0;
+    for (i = 0; i < num_merged && !merging; i++)
+    {
+      for (j = i + 1; j < num_merged && !merging; j++)
+      {
+        if (merged[i].x < merged[j].x + merged[j].width && merged[j].x < merged[i].x + merged[i].width &&
+            merged[i].y < merged[j].y + merged[j].height && merged[j].y < merged[i].y + merged[i].height)
+        {
+          x0 = merged[i].x < merged[j].x ? merged[i].x : merged[j].x;
+          y0 = merged[i].y < merged[j].y ? merged[i].y : merged[j].y;
+          x1 = merged[i].x + merged[i].width > merged[j].x + merged[j].width ? merged[i].x + merged[i].width : merged[j].x + merged[j].width;
+          y1 = merged[i].y + merged[i].height > merged[j].y + merged[j].height ? merged[i].y + merged[i].height : merged[j].y + merged[j].height;
+          merged[i].x = x0;
+          merged[i].y = y0;
+          merged[i].width = x1 - x0;
+          merged[i].height = y1 - y0;
+          mar_sift_align_region(ctx, &merged[i]);
+          merged[j] = merged[--num_merged];
+          merging = 1;
+        }
+      }
+    }
+  }
+  while (merging);
+
+  // Filter each region from a copy of its pixels
+  ctx->region_calls++;
+  *num_keypoints = 0;
+  *keypoints = ctx->keypoints;
+  for (i = 0; i < num_merged; i++)
+  {
+    filter = mar_sift_get_region_filter(ctx, merged[i].width, merged[i].height);
+    if (filter == NULL)
+    {
+      return MAR_ERROR_MALLOC;
+    }
+
+    for (j = 0; j < merged[i].height; j++)
+    {
+      memcpy(&ctx->image_buffer[j * merged[i].width], &image[(merged[i].y + j) * ctx->image_width + merged[i].x], merged[i].width * sizeof(float));
+    }
+
+    mrv = mar_sift_detect(ctx, filter, ctx->image_buffer, merged[i].x, merged[i].y, num_keypoints);
+    *keypoints = ctx->keypoints;
+    if (mrv != MAR_ERROR_NONE)
+    {
+      return mrv;
+    }
+  }
 
   return MAR_ERROR_NONE;
 }
+
+/**
+ * Creates a new SIFT filter.  Must be called before calling other MAR SIFT functions without a detector.
+ *
+ * @param width The width of the camera frame
+ * @param height The height of the camera frame
+ * @param number_of_octaves The number of octaves used by the SIFT filter.  
+ * Increasing the scale by an octave means doubling the size of the smoothing kernel, 
+ * whose effect is roughly equivalent to halving the image resolution. 
+ * @param number_of_levels The number of levels used by the SIFT filter.
+ * Each octave is sampled at this given number of intermediate scales 
+ * Increasing this number might in principle return more refined keypoints, but in practice can make their selection unstable due to noise.
+ * @param first_octave The SIFT filter will iterate from first_octave to number_of_octaves
+ * 
+ * @return MAR_ERROR_NONE on success, an error code on failure.
+ */
+MAR_PUBLIC
+mar_error_code mar_sift_new(int width, int height, int number_of_octaves, int number_of_levels, int first_octave)
+{
+  return mar_sift_ctx_new(&mar_sift_default_ctx, width, height, number_of_octaves, number_of_levels, first_octave);
+}
+
+/**
+ * Frees the SIFT filter created by mar_sift_new.
+ */
+MAR_PUBLIC
+void mar_sift_free()
+{
+  mar_sift_ctx_free(&mar_sift_default_ctx);
+}
+
+/**
+ * Calculates and returns the SIFT keypoints for a camera frame.
+ *
+ * @param keypoints A pointer to a pointer which will be modified to point to the array of keypoints.
+ * @param num_keypoints The number of SIFT keypoints, and the size of the regions array
+ * @param frame_buffer The camera's frame buffer
+ *
+ * @return MAR_ERROR_NONE on success, an error code on failure.
+ */
+MAR_PUBLIC
+mar_error_code mar_sift_get_keypoints(mar_sift_keypoint **keypoints, int *num_keypoints, unsigned char *frame_buffer)
+{
+  return mar_sift_ctx_get_keypoints(&mar_sift_default_ctx, keypoints, num_keypoints, frame_buffer);
+}
+
+/**
+ * Calculates and returns the SIFT keypoints for a grayscale camera frame.  The image is filtered in place,
+ * so no conversion of the camera frame is needed.
+ *
+ * @param keypoints A pointer to a pointer which will be modified to point to the array of keypoints.
+ * @param num_keypoints The number of SIFT keypoints, and the size of the regions array
+ * @param image The grayscale camera frame normalized to [0-1], width * height floats in size
+ *
+ * @return MAR_ERROR_NONE on success, an error code on failure.
+ */
+MAR_PUBLIC
+mar_error_code mar_sift_get_keypoints_from_grayscale(mar_sift_keypoint **keypoints, int *num_keypoints, const float *image)
+{
+  return mar_sift_ctx_get_keypoints_from_grayscale(&mar_sift_default_ctx, keypoints, num_keypoints, image);
+}
+
+/**
+ * Calculates and returns the SIFT keypoints within regions of a grayscale camera frame.  Overlapping regions
+ * are merged so that no keypoint is detected twice.  Keypoints within a few pixels of a region's border are
+ * not detected, so regions should be padded.
+ *
+ * @param keypoints A pointer to a pointer which will be modified to point to the array of keypoints.
+ * @param num_keypoints The number of SIFT keypoints
+ * @param image The grayscale camera frame normalized to [0-1], width * height floats in size
+ * @param regions The regions of the frame to detect keypoints in, in frame coordinates
+ * @param num_regions The number of regions, at most MAR_SIFT_MAX_REGIONS
+ *
+ * @return MAR_ERROR_NONE on success, an error code on failure.
+ */
+MAR_PUBLIC
+mar_error_code mar_sift_get_keypoints_from_grayscale_regions(mar_sift_keypoint **keypoints, int *num_keypoints, const float *image,
+    const mar_sift_region *regions, int num_regions)
+{
+  return mar_sift_ctx_get_keypoints_from_grayscale_regions(&mar_sift_default_ctx, keypoints, num_keypoints, image, regions, num_regions);
+}
+
+/**
+ * Sets the peak threshold value for SIFT filter.  May only be called if a SIFT filter has been created.
+ *
+ * @param threshold The peak threshold. This is the minimum amount of contrast to accept a keypoint
+ *
+ * @return MAR_ERROR_NONE on success, an error code on failure.
+ */
+MAR_PUBLIC
+mar_error_code mar_sift_set_peak_threshold(float threshold)
+{
+  return mar_sift_ctx_set_peak_threshold(&mar_sift_default_ctx, threshold);
+}
+
+/**
+ * Sets the edge threshold value for SIFT filter.  May only be called if a SIFT filter has been created.
+ *
+ * @param threshold The edge threshold. This is the edge rejection threshold.
+ *
+ * @return MAR_ERROR_NONE on success, an error code on failure.
+ */
+MAR_PUBLIC
+mar_error_code mar_sift_set_edge_threshold(float threshold)
+{
+  return mar_sift_ctx_set_edge_threshold(&mar_sift_default_ctx, threshold);
+}
+
+/**
+ * Changes the octaves of the SIFT filter, recreating it without changing its frame size, buffers or thresholds.
+ * May only be called if a SIFT filter has been created.
+ *
+ * @param number_of_octaves The number of octaves used by the SIFT filter, or MAR_SIFT_MAX_OCTAVES
+ * @param first_octave The SIFT filter will iterate from first_octave to number_of_octaves
+ *
+ * @return MAR_ERROR_NONE on success, an error code on failure, in which case the filter is unchanged.
+ */
+MAR_PUBLIC
+mar_error_code mar_sift_set_octaves(int number_of_octaves, int first_octave)
+{
+  return mar_sift_ctx_set_octaves(&mar_sift_default_ctx, number_of_octaves, first_octave);
+}
+
+/**
+ * Gets the peak threshold value for SIFT filter.  May only be called if a SIFT filter has been created.
+ *
+ * @param threshold Will be set to the peak threshold. This is the minimum amount of contrast to accept a keypoint
+ *
+ * @return MAR_ERROR_NONE on success, an error code on failure.
+ */
+MAR_PUBLIC
+mar_error_code mar_sift_get_peak_threshold(float *threshold)
+{
+  return mar_sift_ctx_get_peak_threshold(&mar_sift_default_ctx, threshold);
+}
+
+/**
+ * Gets the edge threshold value for SIFT filter.  May only be called if a SIFT filter has been created.
+ *
+ * @param threshold Will be set to the edge threshold. This is the edge rejection threshold.
+ *
+ * @return MAR_ERROR_NONE on success, an error code on failure.
+ */
+MAR_PUBLIC
+mar_error_code mar_sift_get_edge_threshold(float *threshold)
+{
+  return mar_sift_ctx_get_edge_threshold(&mar_sift_default_ctx, threshold);
+}
+
+/**
+ * Gets the first octave used by the SIFT filter.  May only be called if a SIFT filter has been created.
+ *
+ * @param first_octave Will be set to the first octave used by the SIFT filter.
+ *
+ * @return MAR_ERROR_NONE on success, an error code on failure.
+ */
+MAR_PUBLIC
+mar_error_code mar_sift_get_first_octave(int *first_octave)
+{
+  return mar_sift_ctx_get_first_octave(&mar_sift_default_ctx, first_octave);
+}
+
+/**
+ * Gets the number of octaves for SIFT filter.  May only be called if a SIFT filter has been created.
+ *
+ * @param number_of_octaves Will be set to the number of octaves.
+ *
+ * @return MAR_ERROR_NONE on success, an error code on failure.
+ */
+MAR_PUBLIC
+mar_error_code mar_sift_get_number_of_octaves(int *number_of_octaves)
+{
+  return mar_sift_ctx_get_number_of_octaves(&mar_sift_default_ctx, number_of_octaves);
+}
+
+/**
+ * Gets the number of levels per octave for SIFT filter.  May only be called if a SIFT filter has been created.
+ *
+ * @param number_of_levels Will be set to the number of levels per octave of the SIFT filter.
+ *
+ * @return MAR_ERROR_NONE on success, an error code on failure.
+ */
+MAR_PUBLIC
+mar_error_code mar_sift_get_number_of_levels(int *number_of_levels)
+{
+  return mar_sift_ctx_get_number_of_levels(&mar_sift_default_ctx, number_of_levels);
+}
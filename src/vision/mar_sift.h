@@ -29,6 +29,12 @@
 #define MAR_SIFT_NBO 8
 /** Number of SIFT bins per position */
 #define MAR_SIFT_NBP 4
+/** The maximum number of regions filtered by mar_sift_get_keypoints_from_grayscale_regions */
+#define MAR_SIFT_MAX_REGIONS 64
+/** The number of SIFT filters kept for regions of different sizes */
+#define MAR_SIFT_MAX_REGION_FILTERS 4
+/** Region sizes are rounded up to a multiple of this so that regions of similar sizes share a filter */
+#define MAR_SIFT_REGION_ALIGNMENT 32
 
 /**
  * A type to encompass a SIFT keypoint
@@ -49,7 +55,60 @@ typedef struct
 mar_sift_keypoint;
 
 /**
- * Creates a new SIFT filter.  Must be called before calling other MAR SIFT functions.
+ * A rectangular region of a camera frame
+ */
+typedef struct
+{
+  /** The X coordinate of the region's left edge @return */
+  int x;
+  /** The Y coordinate of the region's top edge @return */
+  int y;
+  /** The width of the region @return */
+  int width;
+  /** The height of the region @return */
+  int height;
+}
+mar_sift_region;
+
+/**
+ * A SIFT detector with its own filters and buffers.  A detector may only be used by one thread at a time,
+ * but separate detectors may be used from separate threads at once.
+ */
+typedef struct
+{
+  /** The SIFT filter for the whole frame, or NULL when not created @return Do not access directly when using the library */
+  void *filter;
+  /** The image buffer to store a grayscale of the camera image for SIFT filtering @return Do not access directly when using the library */
+  float *image_buffer;
+  /** The image buffer width @return Read-Only */
+  int image_width;
+  /** The image buffer height @return Read-Only */
+  int image_height;
+  /** A buffer for holding SIFT keypoints found from filtering @return Do not access directly when using the library */
+  mar_sift_keypoint *keypoints;
+  /** The size of the SIFT keypoint buffer @return Do not access directly when using the library */
+  int keypoints_size;
+  /** The number of octaves the detector was created with, used for the region filters @return Read-Only */
+  int number_of_octaves;
+  /** The number of levels the detector was created with, used for the region filters @return Read-Only */
+  int number_of_levels;
+  /** The first octave the detector was created with, used for the region filters @return Read-Only */
+  int first_octave;
+  /** SIFT filters sized for the regions most recently filtered, NULL when unused @return Do not access directly when using the library */
+  void *region_filters[MAR_SIFT_MAX_REGION_FILTERS];
+  /** The width of the region each region filter was created for @return Do not access directly when using the library */
+  int region_filter_width[MAR_SIFT_MAX_REGION_FILTERS];
+  /** The height of the region each region filter was created for @return Do not access directly when using the library */
+  int region_filter_height[MAR_SIFT_MAX_REGION_FILTERS];
+  /** When each region filter was last used, in calls to filter regions @return Do not access directly when using the library */
+  unsigned int region_filter_last_used[MAR_SIFT_MAX_REGION_FILTERS];
+  /** The number of calls to filter regions @return Do not access directly when using the library */
+  unsigned int region_calls;
+}
+mar_sift_ctx;
+
+/**
+ * Creates a new SIFT filter.  Must be called before calling other MAR SIFT functions without a detector.
  *
  * @param width The width of the camera frame
  * @param height The height of the camera frame
@@ -81,6 +140,34 @@ void mar_sift_free();
  */
 mar_error_code mar_sift_get_keypoints(mar_sift_keypoint **keypoints, int *num_keypoints, unsigned char *frame_buffer);
 
+/**
+ * Calculates and returns the SIFT keypoints for a grayscale camera frame.  The image is filtered in place,
+ * so no conversion of the camera frame is needed.
+ *
+ * @param keypoints A pointer to a pointer which will be modified to point to the array of keypoints.
+ * @param num_keypoints The number of SIFT keypoints, and the size of the regions array
+ * @param image The grayscale camera frame normalized to [0-1], width * height floats in size
+ *
+ * @return MAR_ERROR_NONE on success, an error code on failure.
+ */
+mar_error_code mar_sift_get_keypoints_from_grayscale(mar_sift_keypoint **keypoints, int *num_keypoints, const float *image);
+
+/**
+ * Calculates and returns the SIFT keypoints within regions of a grayscale camera frame.  Overlapping regions
+ * are merged so that no keypoint is detected twice.  Keypoints within a few pixels of a region's border are
+ * not detected, so regions should be padded.
+ *
+ * @param keypoints A pointer to a pointer which will be modified to point to the array of keypoints.
+ * @param num_keypoints The number of SIFT keypoints
+ * @param image The grayscale camera frame normalized to [0-1], width * height floats in size
+ * @param regions The regions of the frame to detect keypoints in, in frame coordinates
+ * @param num_regions The number of regions, at most MAR_SIFT_MAX_REGIONS
+ *
+ * @return MAR_ERROR_NONE on success, an error code on failure.
+ */
+mar_error_code mar_sift_get_keypoints_from_grayscale_regions(mar_sift_keypoint **keypoints, int *num_keypoints, const float *image,
+    const mar_sift_region *regions, int num_regions);
+
 /**
  * Sets the peak threshold value for SIFT filter.  May only be called if a SIFT filter has been created.
  *
@@ -99,6 +186,17 @@ mar_error_code mar_sift_set_peak_threshold(float threshold);
  */
 mar_error_code mar_sift_set_edge_threshold(float threshold);
 
+/**
+ * Changes the octaves of the SIFT filter, recreating it without changing its frame size, buffers or thresholds.
+ * May only be called if a SIFT filter has been created.
+ *
+ * @param number_of_octaves The number of octaves used by the SIFT filter, or MAR_SIFT_MAX_OCTAVES
+ * @param first_octave The SIFT filter will iterate from first_octave to number_of_octaves
+ *
+ * @return MAR_ERROR_NONE on success, an error code on failure, in which case the filter is unchanged.
+ */
+mar_error_code mar_sift_set_octaves(int number_of_octaves, int first_octave);
+
 /**
  * Gets the peak threshold value for SIFT filter.  May only be called if a SIFT filter has been created.
  *
@@ -144,4 +242,153 @@ mar_error_code mar_sift_get_number_of_octaves(int *number_of_octaves);
  */
 mar_error_code mar_sift_get_number_of_levels(int *number_of_levels);
 
+/**
+ * Creates a new SIFT detector.  Must be called before calling other functions on the detector.
+ *
+ * @param ctx The SIFT detector
+ * @param width The width of the camera frame
+ * @param height The height of the camera frame
+ * @param number_of_octaves The number of octaves used by the SIFT filter.  
+ * Increasing the scale by an octave means doubling the size of the smoothing kernel, 
+ * whose effect is roughly equivalent to halving the image resolution. 
+ * @param number_of_levels The number of levels used by the SIFT filter.
+ * Each octave is sampled at this given number of intermediate scales 
+ * Increasing this number might in principle return more refined keypoints, but in practice can make their selection unstable due to noise.
+ * @param first_octave The SIFT filter will iterate from first_octave to number_of_octaves
+ * 
+ * @return MAR_ERROR_NONE on success, an error code on failure.
+ */
+mar_error_code mar_sift_ctx_new(mar_sift_ctx *ctx, int width, int height, int number_of_octaves, int number_of_levels, int first_octave);
+
+/**
+ * Frees a SIFT detector created by mar_sift_ctx_new.
+ *
+ * @param ctx The SIFT detector
+ */
+void mar_sift_ctx_free(mar_sift_ctx *ctx);
+
+/**
+ * Sets the peak threshold value for SIFT filter.  May only be called if a SIFT filter has been created.
+ *
+ * @param ctx The SIFT detector
+ * @param threshold The peak threshold. This is the minimum amount of contrast to accept a keypoint
+ *
+ * @return MAR_ERROR_NONE on success, an error code on failure.
+ */
+mar_error_code mar_sift_ctx_set_peak_threshold(mar_sift_ctx *ctx, float threshold);
+
+/**
+ * Sets the edge threshold value for SIFT filter.  May only be called if a SIFT filter has been created.
+ *
+ * @param ctx The SIFT detector
+ * @param threshold The edge threshold. This is the edge rejection threshold.
+ *
+ * @return MAR_ERROR_NONE on success, an error code on failure.
+ */
+mar_error_code mar_sift_ctx_set_edge_threshold(mar_sift_ctx *ctx, float threshold);
+
+/**
+ * Changes the octaves of a SIFT detector, recreating its filters without changing its frame size, buffers or
+ * thresholds.  Skipping the first octaves of a detector detects fewer, larger keypoints at a fraction of the cost.
+ *
+ * @param ctx The SIFT detector
+ * @param number_of_octaves The number of octaves used by the SIFT filter, or MAR_SIFT_MAX_OCTAVES
+ * @param first_octave The SIFT filter will iterate from first_octave to number_of_octaves
+ *
+ * @return MAR_ERROR_NONE on success, an error code on failure, in which case the detector is unchanged.
+ */
+mar_error_code mar_sift_ctx_set_octaves(mar_sift_ctx *ctx, int number_of_octaves, int first_octave);
+
+/**
+ * Gets the peak threshold value for SIFT filter.  May only be called if a SIFT filter has been created.
+ *
+ * @param ctx The SIFT detector
+ * @param threshold Will be set to the peak threshold. This is the minimum amount of contrast to accept a keypoint
+ *
+ * @return MAR_ERROR_NONE on success, an error code on failure.
+ */
+mar_error_code mar_sift_ctx_get_peak_threshold(mar_sift_ctx *ctx, float *threshold);
+
+/**
+ * Gets the edge threshold value for SIFT filter.  May only be called if a SIFT filter has been created.
+ *
+ * @param ctx The SIFT detector
+ * @param threshold Will be set to the edge threshold. This is the edge rejection threshold.
+ *
+ * @return MAR_ERROR_NONE on success, an error code on failure.
+ */
+mar_error_code mar_sift_ctx_get_edge_threshold(mar_sift_ctx *ctx, float *threshold);
+
+/**
+ * Gets the first octave used by the SIFT filter.  May only be called if a SIFT filter has been created.
+ *
+ * @param ctx The SIFT detector
+ * @param first_octave Will be set to the first octave used by the SIFT filter.
+ *
+ * @return MAR_ERROR_NONE on success, an error code on failure.
+ */
+mar_error_code mar_sift_ctx_get_first_octave(mar_sift_ctx *ctx, int *first_octave);
+
+/**
+ * Gets the number of octaves for SIFT filter.  May only be called if a SIFT filter has been created.
+ *
+ * @param ctx The SIFT detector
+ * @param number_of_octaves Will be set to the number of octaves.
+ *
+ * @return MAR_ERROR_NONE on success, an error code on failure.
+ */
+mar_error_code mar_sift_ctx_get_number_of_octaves(mar_sift_ctx *ctx, int *number_of_octaves);
+
+/**
+ * Gets the number of levels per octave for SIFT filter.  May only be called if a SIFT filter has been created.
+ *
+ * @param ctx The SIFT detector
+ * @param number_of_levels Will be set to the number of levels per octave of the SIFT filter.
+ *
+ * @return MAR_ERROR_NONE on success, an error code on failure.
+ */
+mar_error_code mar_sift_ctx_get_number_of_levels(mar_sift_ctx *ctx, int *number_of_levels);
+
+/**
+ * Calculates and returns the SIFT keypoints for a camera frame.
+ *
+ * @param ctx The SIFT detector
+ * @param keypoints A pointer to a pointer which will be modified to point to the array of keypoints.
+ * @param num_keypoints The number of SIFT keypoints, and the size of the regions array
+ * @param frame_buffer The camera's frame buffer
+ *
+ * @return MAR_ERROR_NONE on success, an error code on failure.
+ */
+mar_error_code mar_sift_ctx_get_keypoints(mar_sift_ctx *ctx, mar_sift_keypoint **keypoints, int *num_keypoints, unsigned char *frame_buffer);
+
+/**
+ * Calculates and returns the SIFT keypoints for a grayscale camera frame.  The image is filtered in place,
+ * so no conversion of the camera frame is needed.
+ *
+ * @param ctx The SIFT detector
+ * @param keypoints A pointer to a pointer which will be modified to point to the array of keypoints.
+ * @param num_keypoints The number of SIFT keypoints, and the size of the regions array
+ * @param image The grayscale camera frame normalized to [0-1], width * height floats in size
+ *
+ * @return MAR_ERROR_NONE on success, an error code on failure.
+ */
+mar_error_code mar_sift_ctx_get_keypoints_from_grayscale(mar_sift_ctx *ctx, mar_sift_keypoint **keypoints, int *num_keypoints, const float *image);
+
+/**
+ * Calculates and returns the SIFT keypoints within regions of a grayscale camera frame.  Overlapping regions
+ * are merged so that no keypoint is detected twice.  Keypoints within a few pixels of a region's border are
+ * not detected, so regions should be padded.
+ *
+ * @param ctx The SIFT detector
+ * @param keypoints A pointer to a pointer which will be modified to point to the array of keypoints.
+ * @param num_keypoints The number of SIFT keypoints
+ * @param image The grayscale camera frame normalized to [0-1], width * height floats in size
+ * @param regions The regions of the frame to detect keypoints in, in frame coordinates
+ * @param num_regions The number of regions, at most MAR_SIFT_MAX_REGIONS
+ *
+ * @return MAR_ERROR_NONE on success, an error code on failure.
+ */
+mar_error_code mar_sift_ctx_get_keypoints_from_grayscale_regions(mar_sift_ctx *ctx, mar_sift_keypoint **keypoints, int *num_keypoints, const float *image,
+    const mar_sift_region *regions, int num_regions);
+
 #endif
@@ -12,8 +12,11 @@
 #include <mar/vision/mar_mser.h>
 #include <mar/vision/mar_sift.h>
 #include <mar/augment/mar_augment.h>
+#include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#define GL_GLEXT_PROTOTYPES
 #include <GL/glut.h>
 #include <sys/time.h>
 #include <math.h>
@@ -22,8 +25,59 @@
 static int window_width;
 /** The GLUT window's height */
 static int window_height;
+/** The configuration file of the augmentation, reloaded with the 'c' key */
+#define LIGHTHOUSE_CONFIG "res/lighthouse.cfg"
+/** The camera texture has not been streamed to yet */
+#define CAMERA_TEXTURE_NONE -3
+/** The camera texture holds a frame converted to RGB on the CPU */
+#define CAMERA_TEXTURE_RGB  -2
+/** The camera texture holds the raw YUYV macropixels of a frame */
+#define CAMERA_TEXTURE_YUYV -1
+
 /** The texture for storing and drawing camera frames */
 static GLuint camera_texture;
+/** The pixel format of the camera texture's storage, or 0 if it is not allocated */
+static GLenum camera_texture_format = 0;
+/** The width of the camera texture's storage */
+static int camera_texture_width = 0;
+/** The height of the camera texture's storage */
+static int camera_texture_height = 0;
+/** The pixel buffer objects camera frames are streamed through, alternating between frames */
+static GLuint frame_pixel_buffers[2];
+/** The index of the pixel buffer object the next frame is streamed through */
+static int frame_pixel_buffer_index = 0;
+/** Whether or not pixel buffer objects are supported */
+static char use_pixel_buffers = 0;
+/** The shader program converting YUYV camera textures to RGB, or 0 if shaders are not supported */
+static GLuint yuyv_program = 0;
+/** The location of the frame width uniform of the YUYV shader program */
+static GLint yuyv_program_width;
+/** Upload raw YUYV frames and convert them on the GPU or not */
+static char upload_yuyv = 1;
+/** The version of the snapshot the camera texture was last streamed from */
+static unsigned int camera_texture_version = 0;
+/** The image the camera texture was last streamed from, a pyramid level, CAMERA_TEXTURE_RGB or CAMERA_TEXTURE_YUYV */
+static int camera_texture_source = CAMERA_TEXTURE_NONE;
+/** The camera frame of the shown snapshot converted to RGB24 on the CPU */
+static unsigned char *camera_frame_rgb = NULL;
+
+/**
+ * The fragment shader converting YUYV to RGB.  Each texel holds a Y0 U Y1 V macropixel of two horizontal pixels,
+ * Y0 is used for even pixels and Y1 for odd pixels.  The coefficients match mar_camera_frame_to_rgb.
+ */
+static const char *yuyv_fragment_shader =
+  "#version 120\n"
+  "uniform sampler2D frame;\n"
+  "uniform float width;\n"
+  "void main()\n"
+  "{\n"
+  "  vec4 yuyv = texture2D(frame, gl_TexCoord[0].st) * 255.0;\n"
+  "  float y = mod(floor(gl_TexCoord[0].s * width), 2.0) < 1.0 ? yuyv.r : yuyv.b;\n"
+  "  vec3 rgb = vec3(1.164075 * y + 0.000255 * yuyv.g + 1.59375 * yuyv.a - 222.36,\n"
+  "                  1.164075 * y - 0.39321 * yuyv.g - 0.811665 * yuyv.a + 135.405,\n"
+  "                  1.164075 * y + 2.023425 * yuyv.g - 277.44);\n"
+  "  gl_FragColor = vec4(clamp(rgb / 255.0, 0.0, 1.0), 1.0);\n"
+  "}\n";
 
 /** The camera's frame width */
 static int camera_width = 320;
@@ -39,20 +93,39 @@ static char show_keypoints = 0;
 static char show_fps = 0;
 /** Show selectable regions or not */
 static char show_selectable_regions = 1;
+/** The grayscale pyramid level to show instead of the color camera frame, or -1 for the color frame */
+static int show_pyramid_level = -1;
 
 /** The mouse X position */
 static int mouse_x = 0;
 /** The mouse Y position */
 static int mouse_y = 0;
 
-/** The augmentation ID */
+/** The augmentation ID, written atomically by the tracking thread */
 mar_augmentation_id augmentation_id = MAR_NO_AUGMENTATION;
+/** The augmentation ID last drawn */
+mar_augmentation_id shown_augmentation_id = MAR_NO_AUGMENTATION;
 /** Augmentation X coordinate */
 int augmentation_x;
 /** Augmentation Y coordinate */
 int augmentation_y;
-/** Whether or not the augmentation is successful */
-char augmentation_successful = 0;
+
+/** The thread updating the augmentation, so that tracking runs at the camera's rate and drawing at the display's */
+static pthread_t tracking_thread;
+/** Whether or not the tracking thread was started */
+static char tracking_started = 0;
+/** Whether or not the tracking thread keeps running, read atomically */
+static char tracking_running = 0;
+/** The error which stopped the tracking thread, read atomically */
+static mar_error_code tracking_error = MAR_ERROR_NONE;
+/** Guards the click waiting to be turned into an augmentation by the tracking thread */
+static pthread_mutex_t click_mutex = PTHREAD_MUTEX_INITIALIZER;
+/** Whether or not a click is waiting to be turned into an augmentation */
+static char click_pending = 0;
+/** The X coordinate of the waiting click in frame coordinates */
+static int click_x;
+/** The Y coordinate of the waiting click in frame coordinates */
+static int click_y;
 
 /**
  * A function which subtracts a timeval from another.
@@ -87,15 +160,119 @@ int timeval_subtract(struct timeval *result, struct timeval *x, struct timeval *
 }
 
 /**
- * Draws the camera frame.
+ * Streams an image to the bound camera texture.  The texture's storage is only allocated when the image's size or
+ * format changes, otherwise the image replaces its contents.  When supported, the image is copied into a pixel
+ * buffer object so that the driver transfers it to the GPU asynchronously.  The two pixel buffer objects alternate
+ * so that writing a frame never waits on the transfer of the one before it.
+ *
+ * @param format The pixel format of the image
+ * @param width The width of the image in texels
+ * @param height The height of the image in texels
+ * @param data The image, may be NULL if there is no frame yet
+ * @param length The size of the image in bytes
+ */
+void upload_camera_texture(GLenum format, int width, int height, const unsigned char *data, size_t length)
+{
+  void *pixels = NULL;
+
+  if (data == NULL)
+  {
+    return;
+  }
+
+  // Allocate the texture's storage, packed YUYV macropixels must not be filtered
+  if (format != camera_texture_format || width != camera_texture_width || height != camera_texture_height)
+  {
+    glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, NULL);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, format == GL_RGBA ? GL_NEAREST : GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, format == GL_RGBA ? GL_NEAREST : GL_LINEAR);
+    camera_texture_format = format;
+    camera_texture_width = width;
+    camera_texture_height = height;
+  }
+
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+  if (use_pixel_buffers)
+  {
+    // Orphan the buffer's previous storage rather than waiting for its transfer to finish
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, frame_pixel_buffers[frame_pixel_buffer_index]);
+    glBufferData(GL_PIXEL_UNPACK_BUFFER, length, NULL, GL_STREAM_DRAW);
+    pixels = glMapBuffer(GL_PIXEL_UNPACK_BUFFER, GL_WRITE_ONLY);
+    if (pixels != NULL)
+    {
+      memcpy(pixels, data, length);
+      glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+      glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width, height, format, GL_UNSIGNED_BYTE, NULL);
+    }
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    frame_pixel_buffer_index = !frame_pixel_buffer_index;
+  }
+
+  // Copy directly from client memory without pixel buffer objects
+  if (pixels == NULL)
+  {
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width, height, format, GL_UNSIGNED_BYTE, data);
+  }
+}
+
+/**
+ * Draws the camera frame of a snapshot.  The texture is only streamed to when the snapshot or the shown image changed.
  *
  * @param texture The ID of the OpenGL texture to use for drawing
+ * @param snapshot The snapshot to draw
  */
-void draw_camera_frame(int texture)
+void draw_camera_frame(int texture, const mar_augment_snapshot *snapshot)
 {
-  // Create the texture
+  const mar_camera_frame *frame = &snapshot->views[0].frame;
+  int source = CAMERA_TEXTURE_RGB;
+
+  // Show a grayscale pyramid level if one is selected, going back to the color frame past the last level
+  if (show_pyramid_level >= 0 && (snapshot->contents & MAR_AUGMENT_SNAPSHOT_GRAYSCALE))
+  {
+    if (show_pyramid_level < MAR_IMAGE_PYRAMID_MAX_LEVELS && snapshot->views[0].gray[show_pyramid_level] != NULL)
+    {
+      source = show_pyramid_level;
+    }
+    else
+    {
+      show_pyramid_level = -1;
+    }
+  }
+  else if (frame->data == NULL)
+  {
+    return;
+  }
+  else if (upload_yuyv && yuyv_program != 0 && frame->format == MAR_CAM_FMT_YUYV && frame->width % 2 == 0 &&
+      frame->length >= frame->width * frame->height * 2)
+  {
+    source = CAMERA_TEXTURE_YUYV;
+  }
+
+  // Stream the image to the texture
   glBindTexture(GL_TEXTURE_2D, texture);
-  glTexImage2D(GL_TEXTURE_2D, 0, 3, camera_width, camera_height, 0, GL_RGB, GL_UNSIGNED_BYTE, mar_augment_get_camera_frame_buffer());
+  if (snapshot->version != camera_texture_version || source != camera_texture_source)
+  {
+    if (source >= 0)
+    {
+      upload_camera_texture(GL_LUMINANCE, snapshot->views[0].gray_width[source], snapshot->views[0].gray_height[source],
+          snapshot->views[0].gray[source], snapshot->views[0].gray_width[source] * snapshot->views[0].gray_height[source]);
+    }
+    else if (source == CAMERA_TEXTURE_YUYV)
+    {
+      upload_camera_texture(GL_RGBA, frame->width / 2, frame->height, frame->data, frame->width * frame->height * 2);
+    }
+    else if (frame->width == camera_width && frame->height == camera_height && mar_camera_frame_to_rgb(frame, camera_frame_rgb) == MAR_ERROR_NONE)
+    {
+      upload_camera_texture(GL_RGB, camera_width, camera_height, camera_frame_rgb, camera_width * camera_height * 3);
+    }
+    camera_texture_version = snapshot->version;
+    camera_texture_source = source;
+  }
+  if (source == CAMERA_TEXTURE_YUYV)
+  {
+    glUseProgram(yuyv_program);
+    glUniform1f(yuyv_program_width, frame->width);
+  }
   
   // Draw the texture
   glEnable(GL_TEXTURE_2D);
@@ -106,6 +283,11 @@ void draw_camera_frame(int texture)
     glTexCoord2d(1.0, 1.0); glVertex2d(camera_width, -camera_height);
     glTexCoord2d(0.0, 1.0); glVertex2d(0,            -camera_height);
   glEnd();
+
+  if (source == CAMERA_TEXTURE_YUYV)
+  {
+    glUseProgram(0);
+  }
 }
 
 /**
@@ -202,21 +384,14 @@ void draw_keypoint(float x, float y, float r, float angle)
 
 /**
  * Draw the MSER ellipses
+ *
+ * @param snapshot The snapshot to draw
  */
-void draw_mser_ellipses()
+void draw_mser_ellipses(const mar_augment_snapshot *snapshot)
 {
-  mar_error_code mrv;
   int i;
-  int num_regions = 0;
-  mar_mser *regions;
-
-  mrv = mar_augment_get_regions(&regions, &num_regions);
-  if (mrv != MAR_ERROR_NONE)
-  {
-    fprintf(stderr, "error: ");
-    mar_print_error(mrv);
-    exit(EXIT_FAILURE);
-  }
+  int num_regions = snapshot->views[0].num_regions;
+  const mar_mser *regions = snapshot->views[0].regions;
 
   for (i = 0; i < num_regions; i++)
   {
@@ -226,21 +401,14 @@ void draw_mser_ellipses()
 
 /**
  * Draw the Selectable Regions
+ *
+ * @param snapshot The snapshot to draw
  */
-void draw_selectable_regions()
+void draw_selectable_regions(const mar_augment_snapshot *snapshot)
 {
-  mar_error_code mrv;
   int i;
-  int num_regions = 0;
-  mar_mser *regions;
-
-  mrv = mar_augment_get_regions(&regions, &num_regions);
-  if (mrv != MAR_ERROR_NONE)
-  {
-    fprintf(stderr, "error: ");
-    mar_print_error(mrv);
-    exit(EXIT_FAILURE);
-  }
+  int num_regions = snapshot->views[0].num_regions;
+  const mar_mser *regions = snapshot->views[0].regions;
 
   for (i = 0; i < num_regions; i++)
   {
@@ -250,21 +418,14 @@ void draw_selectable_regions()
 
 /** 
  * Draw the SIFT keypoints 
+ *
+ * @param snapshot The snapshot to draw
  */
-void draw_sift_keypoints()
+void draw_sift_keypoints(const mar_augment_snapshot *snapshot)
 {
-  mar_error_code mrv;
   int i;
-  mar_sift_keypoint *keypoints;
-  int num_keypoints = 0;
-
-  mrv = mar_augment_get_keypoints(&keypoints, &num_keypoints);
-  if (mrv != MAR_ERROR_NONE)
-  {
-    fprintf(stderr, "error: ");
-    mar_print_error(mrv);
-    exit(EXIT_FAILURE);
-  }
+  const mar_sift_keypoint *keypoints = snapshot->views[0].keypoints;
+  int num_keypoints = snapshot->views[0].num_keypoints;
 
   for (i = 0; i < num_keypoints; i++)
   {
@@ -302,21 +463,14 @@ void draw_fps()
 
 /**
  * Draw a preview of selectable regions
+ *
+ * @param snapshot The snapshot to draw
  */
-void draw_region_preview()
+void draw_region_preview(const mar_augment_snapshot *snapshot)
 {
-  mar_error_code mrv;
   int i;
-  int num_regions = 0;
-  mar_mser *regions;
-
-  mrv = mar_augment_get_regions(&regions, &num_regions);
-  if (mrv != MAR_ERROR_NONE)
-  {
-    fprintf(stderr, "error: ");
-    mar_print_error(mrv);
-    exit(EXIT_FAILURE);
-  }
+  int num_regions = snapshot->views[0].num_regions;
+  const mar_mser *regions = snapshot->views[0].regions;
 
   for (i = 0; i < num_regions; i++)
   {
@@ -330,17 +484,16 @@ void draw_region_preview()
 
 /**
  * Draw the augmented virtual image
+ *
+ * @param result The result of the augmentation in the snapshot being drawn
  */
-void draw_augmentation()
+void draw_augmentation(const mar_augmentation_result *result)
 {
-  float transform_matrix[16];
-
-  if (augmentation_id != MAR_NO_AUGMENTATION && augmentation_successful)
+  if (result->error == MAR_ERROR_NONE)
   {
     glPushMatrix();
-      mar_augment_get_transformation(augmentation_id, transform_matrix);
       glScalef(1, -1, 1);
-      glMultMatrixf(transform_matrix);
+      glMultMatrixf(result->transform);
       glTranslatef(0, 0, 0.5f);
       glDisable(GL_TEXTURE_2D);
       glLineWidth(5.0f);
@@ -375,6 +528,11 @@ void draw_augmentation()
  */
 void initialize_graphics(void)
 {
+  const char *version;
+  int major, minor;
+  GLuint shader;
+  GLint status;
+
   glEnable(GL_DEPTH_TEST);
   glEnable(GL_TEXTURE);
   glEnable(GL_COLOR);
@@ -390,28 +548,162 @@ void initialize_graphics(void)
   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR); 
   glTexEnvf(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_DECAL);
+
+  // Pixel buffer objects and GLSL 1.20 both need OpenGL 2.1
+  version = (const char *)glGetString(GL_VERSION);
+  if (version == NULL || sscanf(version, "%d.%d", &major, &minor) != 2 || major * 10 + minor < 21)
+  {
+    fprintf(stderr, "warning: OpenGL 2.1 is not supported, camera frames are converted and copied on the CPU\n");
+    return;
+  }
+
+  // Create the pixel buffer objects frames are streamed through
+  glGenBuffers(2, frame_pixel_buffers);
+  use_pixel_buffers = 1;
+
+  // Create the YUYV conversion shader
+  shader = glCreateShader(GL_FRAGMENT_SHADER);
+  glShaderSource(shader, 1, &yuyv_fragment_shader, NULL);
+  glCompileShader(shader);
+  glGetShaderiv(shader, GL_COMPILE_STATUS, &status);
+  if (status == GL_TRUE)
+  {
+    yuyv_program = glCreateProgram();
+    glAttachShader(yuyv_program, shader);
+    glLinkProgram(yuyv_program);
+    glGetProgramiv(yuyv_program, GL_LINK_STATUS, &status);
+    if (status != GL_TRUE)
+    {
+      glDeleteProgram(yuyv_program);
+      yuyv_program = 0;
+    }
+  }
+  glDeleteShader(shader);
+  if (yuyv_program == 0)
+  {
+    fprintf(stderr, "warning: the YUYV shader could not be built, camera frames are converted on the CPU\n");
+    return;
+  }
+  yuyv_program_width = glGetUniformLocation(yuyv_program, "width");
 }
 
 /**
- * GLUT callback called to update the state and draw graphics.
+ * Turns a click into an augmentation of the MSER under it, if there is one.  Called on the tracking thread.
+ *
+ * @param x The click's X coordinate in frame coordinates
+ * @param y The click's Y coordinate in frame coordinates
+ *
+ * @return MAR_ERROR_NONE on success, an error code on failure.
  */
-void update_and_display(void)
+mar_error_code select_region(int x, int y)
 {
   mar_error_code mrv;
+  mar_augmentation_id id;
+  int i;
+  int num_regions = 0;
+  mar_mser *regions;
 
-  // Clear frame buffer and depth buffer
-  glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+  mrv = mar_augment_get_regions(&regions, &num_regions);
+  if (mrv != MAR_ERROR_NONE)
+  {
+    return mrv;
+  }
+
+  for (i = 0; i < num_regions; i++)
+  {
+    if ((x - regions[i].ellipse_x) * (x - regions[i].ellipse_x) + (y - regions[i].ellipse_y) * (y - regions[i].ellipse_y) < 200)
+    {
+      if (mar_augment_new_augmentation(&id, &regions[i]) == MAR_ERROR_NONE)
+      {
+        __atomic_store_n(&augmentation_id, id, __ATOMIC_RELEASE);
+        return mar_start_augmentation();
+      }
+    }
+  }
+
+  return MAR_ERROR_NONE;
+}
 
-  // Capture frames
-  mrv = mar_augment_update();
-  if (mrv != MAR_ERROR_NONE && mrv != MAR_ERROR_AGAIN && mrv != MAR_ERROR_INTERRUPTED && mrv != MAR_ERROR_TOO_FEW_MATCHING_KEYPOINTS)
+/**
+ * The tracking thread, which updates the augmentation as fast as the camera delivers frames.  Every call into the
+ * augmentation is made from this thread, the GLUT thread only draws the published snapshots.
+ *
+ * @param arg Unused
+ *
+ * @return NULL
+ */
+void *track(void *arg)
+{
+  mar_error_code mrv = MAR_ERROR_NONE;
+  char pending;
+  int x, y;
+
+  while (__atomic_load_n(&tracking_running, __ATOMIC_ACQUIRE))
+  {
+    // Make the augmentation the user clicked on between updates
+    pthread_mutex_lock(&click_mutex);
+    pending = click_pending;
+    x = click_x;
+    y = click_y;
+    click_pending = 0;
+    pthread_mutex_unlock(&click_mutex);
+    if (pending)
+    {
+      mrv = select_region(x, y);
+    }
+
+    if (mrv == MAR_ERROR_NONE)
+    {
+      mrv = mar_augment_update();
+    }
+    if (mrv != MAR_ERROR_NONE && mrv != MAR_ERROR_AGAIN && mrv != MAR_ERROR_INTERRUPTED && mrv != MAR_ERROR_TOO_FEW_MATCHING_KEYPOINTS)
+    {
+      __atomic_store_n(&tracking_error, mrv, __ATOMIC_RELEASE);
+      break;
+    }
+    mrv = MAR_ERROR_NONE;
+  }
+
+  return NULL;
+}
+
+/**
+ * GLUT callback called to draw the latest snapshot of the augmentation.
+ */
+void display(void)
+{
+  mar_error_code mrv;
+  const mar_augment_snapshot *snapshot;
+  int i, contents = 0;
+
+  // Stop if the tracking thread failed
+  mrv = __atomic_load_n(&tracking_error, __ATOMIC_ACQUIRE);
+  if (mrv != MAR_ERROR_NONE)
   {
     fprintf(stderr, "error: ");
     mar_print_error(mrv);
     exit(EXIT_FAILURE);
   }
 
-  augmentation_successful = mrv == MAR_ERROR_NONE;
+  // Hide the selectable regions once a new augmentation was made from them
+  if (__atomic_load_n(&augmentation_id, __ATOMIC_ACQUIRE) != shown_augmentation_id)
+  {
+    shown_augmentation_id = __atomic_load_n(&augmentation_id, __ATOMIC_ACQUIRE);
+    show_selectable_regions = 0;
+  }
+
+  // Ask the tracking thread for what is shown, then take the latest snapshot
+  contents |= show_keypoints ? MAR_AUGMENT_SNAPSHOT_KEYPOINTS : 0;
+  contents |= show_ellipses || show_selectable_regions ? MAR_AUGMENT_SNAPSHOT_REGIONS : 0;
+  contents |= show_pyramid_level >= 0 ? MAR_AUGMENT_SNAPSHOT_GRAYSCALE : 0;
+  contents |= MAR_AUGMENT_SNAPSHOT_FRAME;
+  if (mar_augment_acquire_snapshot(contents, &snapshot) != MAR_ERROR_NONE)
+  {
+    return;
+  }
+
+  // Clear frame buffer and depth buffer
+  glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
   // Set up viewing transformation
   glLoadIdentity();
@@ -423,25 +715,25 @@ void update_and_display(void)
   glScalef(1.0f / camera_width * 2 , 1.0f / camera_height * 2, 1.0f);
 
   // Display camera frame
-  draw_camera_frame(camera_texture);
+  draw_camera_frame(camera_texture, snapshot);
 
   // Draw the MSER filter
   if (show_ellipses)
   {
-    draw_mser_ellipses();
+    draw_mser_ellipses(snapshot);
   }
 
   // Draw the MSER filter
   if (show_selectable_regions)
   {
-    draw_selectable_regions();
-    draw_region_preview();
+    draw_selectable_regions(snapshot);
+    draw_region_preview(snapshot);
   }
 
   // Draw the SIFT filter
   if (show_keypoints)
   {  
-    draw_sift_keypoints();
+    draw_sift_keypoints(snapshot);
   }
 
   // Calculate and Draw FPS
@@ -451,10 +743,14 @@ void update_and_display(void)
   }
 
   // Show augmentation
-  if (mar_augmentation_get_error(augmentation_id) == MAR_ERROR_NONE)
+  for (i = 0; i < snapshot->num_results; i++)
   {
-    draw_augmentation();
+    if (snapshot->results[i].id == shown_augmentation_id)
+    {
+      draw_augmentation(&snapshot->results[i]);
+    }
   }
+  mar_augment_release_snapshot(snapshot);
 
   // Swap to screen
   glutSwapBuffers();
@@ -488,38 +784,19 @@ void reshape(GLint width, GLint height)
  */
 void mouse_button(int button, int state, int x, int y)
 {
-  mar_error_code mrv;
-  int i;
-  int num_regions = 0;
-  mar_mser *regions;
-
   x = (float)x / window_width * camera_width;
   y = (float)y / window_height * camera_height;
 
+  // Leave the click for the tracking thread, which owns the augmentation
   if (button == GLUT_LEFT_BUTTON && state == GLUT_DOWN)
   {
-    mrv = mar_augment_get_regions(&regions, &num_regions);
-    if (mrv != MAR_ERROR_NONE)
-    {
-      fprintf(stderr, "error: ");
-      mar_print_error(mrv);
-      exit(EXIT_FAILURE);
-    }
-
-    for (i = 0; i < num_regions; i++)
-    {
-      if ((x - regions[i].ellipse_x) * (x - regions[i].ellipse_x) + (y - regions[i].ellipse_y) * (y - regions[i].ellipse_y) < 200)
-      {
-        if (mar_augment_new_augmentation(&augmentation_id, &regions[i]) == MAR_ERROR_NONE)
-        {
-          show_selectable_regions = 0;
-          augmentation_x = x;
-          augmentation_y = y;
-          mar_start_augmentation();
-          break;
-        }
-      }
-    }
+    pthread_mutex_lock(&click_mutex);
+    click_pending = 1;
+    click_x = x;
+    click_y = y;
+    pthread_mutex_unlock(&click_mutex);
+    augmentation_x = x;
+    augmentation_y = y;
   }
 }
 
@@ -544,9 +821,7 @@ void mouse_motion(int x, int y)
  */
 void keyboard(unsigned char key, int x, int y)
 {
-  static char mode = ' ';
-  float temp_float;
-  int temp_int_1, temp_int_2, temp_int_3;
+  mar_error_code mrv;
 
   switch (key)
   {
@@ -562,45 +837,26 @@ void keyboard(unsigned char key, int x, int y)
     case 'm':
       show_keypoints = !show_keypoints;
       break;
-    case 'q':
-      printf("Editing MSER Delta...\n");
-      mode = 'q';
-      break;
-    case 'w':
-      printf("Editing MSER Min Area...\n");
-      mode = 'w';
-      break;
-    case 'e':
-      printf("Editing MSER Max Area...\n");
-      mode = 'e';
-      break;
-    case 'r':
-      printf("Editing MSER Max Variation...\n");
-      mode = 'r';
-      break;
-    case 't':
-      printf("Editing MSER Min Diversity...\n");
-      mode = 't';
-      break;
-    case 'a':
-      printf("Editing SIFT Number of Octaves...\n");
-      mode = 'a';
-      break;
-    case 's':
-      printf("Editing SIFT Number of Levels...\n");
-      mode = 's';
-      break;
-    case 'd':
-      printf("Editing SIFT First Octave...\n");
-      mode = 'd';
+    case 'c':
+      // Apply the edited configuration to the running pipeline, keeping every augmentation, which is how the
+      // detectors are tuned since the tracking thread owns them
+      mrv = mar_augment_reload_config(LIGHTHOUSE_CONFIG);
+      if (mrv != MAR_ERROR_NONE)
+      {
+        mar_print_error(mrv);
+      }
+      else
+      {
+        printf("Reloaded %s\n", LIGHTHOUSE_CONFIG);
+      }
       break;
-    case 'f':
-      printf("Editing SIFT Peak Threshold...\n");
-      mode = 'f';
+    case 'y':
+      upload_yuyv = !upload_yuyv;
+      printf("Converting camera frames on the %s\n", upload_yuyv && yuyv_program != 0 ? "GPU" : "CPU");
       break;
-    case 'g':
-      printf("Editing SIFT Edge Threshold...\n");
-      mode = 'g';
+    case 'p':
+      // Cycle through the grayscale pyramid levels, the color frame is shown again past the last level
+      show_pyramid_level++;
       break;
     case 'j':
       augmentation_x -= 4;
@@ -614,134 +870,6 @@ void keyboard(unsigned char key, int x, int y)
     case 'i':
       augmentation_y -= 4;
       break;
-    case '-':
-      switch (mode)
-      {
-         case 'q':
-          mar_mser_get_delta(&temp_float);
-          mar_mser_set_delta(temp_float-1);
-          printf("MSER Delta: %f\n", temp_float-1);
-          break;
-        case 'w':
-          mar_mser_get_min_area(&temp_float);
-          mar_mser_set_min_area(temp_float-0.01);
-          printf("MSER Min Area: %f\n", temp_float-0.01);
-          break;
-        case 'e':
-          mar_mser_get_max_area(&temp_float);
-          mar_mser_set_max_area(temp_float-0.01);
-          printf("MSER Max Area: %f\n", temp_float-0.01);
-          break;
-        case 'r':
-          mar_mser_get_max_variation(&temp_float);
-          mar_mser_set_max_variation(temp_float-0.1);
-          printf("MSER Max Variation: %f\n", temp_float-0.1);
-          break;
-        case 't':
-          mar_mser_get_min_diversity(&temp_float);
-          mar_mser_set_min_diversity(temp_float-0.1);
-          printf("MSER Min Diversity: %f\n", temp_float-0.1);
-          break;
-        case 'a':
-          mar_sift_get_number_of_octaves(&temp_int_1);
-          mar_sift_get_number_of_levels(&temp_int_2);
-          mar_sift_get_first_octave(&temp_int_3);
-          mar_sift_free();
-          mar_sift_new(camera_width, camera_height, temp_int_1 - 1, temp_int_2, temp_int_3);
-          printf("SIFT Number of Octaves: %d (-1 is MAX)\n", temp_int_1 - 1);
-          break;
-        case 's':
-          mar_sift_get_number_of_octaves(&temp_int_1);
-          mar_sift_get_number_of_levels(&temp_int_2);
-          mar_sift_get_first_octave(&temp_int_3);
-          mar_sift_free();
-          mar_sift_new(camera_width, camera_height, temp_int_1, temp_int_2 - 1, temp_int_3);
-          printf("SIFT Number of Levels: %d\n", temp_int_2 - 1);
-          break;
-        case 'd':
-          mar_sift_get_number_of_octaves(&temp_int_1);
-          mar_sift_get_number_of_levels(&temp_int_2);
-          mar_sift_get_first_octave(&temp_int_3);
-          mar_sift_free();
-          mar_sift_new(camera_width, camera_height, temp_int_1, temp_int_2, temp_int_3 - 1);
-          printf("SIFT First Octave: %d\n", temp_int_3 - 1);
-          break;
-        case 'f':
-          mar_sift_get_peak_threshold(&temp_float);
-          mar_sift_set_peak_threshold(temp_float - 0.1);
-          printf("SIFT Peak Threshold: %f\n", temp_float - 0.1);
-          break;
-        case 'g':
-          mar_sift_get_edge_threshold(&temp_float);
-          mar_sift_set_edge_threshold(temp_float - 0.1);
-          printf("SIFT Edge Threshold: %f\n", temp_float - 0.1);
-          break;
-      }
-      break;
-    case '=':
-      switch (mode)
-      {
-         case 'q':
-          mar_mser_get_delta(&temp_float);
-          mar_mser_set_delta(temp_float+1);
-          printf("MSER Delta: %f\n", temp_float+1);
-          break;
-        case 'w':
-          mar_mser_get_min_area(&temp_float);
-          mar_mser_set_min_area(temp_float+0.01);
-          printf("MSER Min Area: %f\n", temp_float+0.01);
-          break;
-        case 'e':
-          mar_mser_get_max_area(&temp_float);
-          mar_mser_set_max_area(temp_float+0.01);
-          printf("MSER Max Area: %f\n", temp_float+0.01);
-          break;
-        case 'r':
-          mar_mser_get_max_variation(&temp_float);
-          mar_mser_set_max_variation(temp_float+0.1);
-          printf("MSER Max Variation: %f\n", temp_float+0.1);
-          break;
-        case 't':
-          mar_mser_get_min_diversity(&temp_float);
-          mar_mser_set_min_diversity(temp_float+0.1);
-          printf("MSER Min Diversity: %f\n", temp_float+0.1);
-          break;
-        case 'a':
-          mar_sift_get_number_of_octaves(&temp_int_1);
-          mar_sift_get_number_of_levels(&temp_int_2);
-          mar_sift_get_first_octave(&temp_int_3);
-          mar_sift_free();
-          mar_sift_new(camera_width, camera_height, temp_int_1 + 1, temp_int_2, temp_int_3);
-          printf("SIFT Number of Octaves: %d (-1 is MAX)\n", temp_int_1 + 1);
-          break;
-        case 's':
-          mar_sift_get_number_of_octaves(&temp_int_1);
-          mar_sift_get_number_of_levels(&temp_int_2);
-          mar_sift_get_first_octave(&temp_int_3);
-          mar_sift_free();
-          mar_sift_new(camera_width, camera_height, temp_int_1, temp_int_2 + 1, temp_int_3);
-          printf("SIFT Number of Levels: %d\n", temp_int_2 + 1);
-          break;
-        case 'd':
-          mar_sift_get_number_of_octaves(&temp_int_1);
-          mar_sift_get_number_of_levels(&temp_int_2);
-          mar_sift_get_first_octave(&temp_int_3);
-          mar_sift_free();
-          mar_sift_new(camera_width, camera_height, temp_int_1, temp_int_2, temp_int_3 + 1);
-          printf("SIFT First Octave: %d\n", temp_int_3 + 1);
-          break;
-        case 'f':
-          mar_sift_get_peak_threshold(&temp_float);
-          mar_sift_set_peak_threshold(temp_float + 0.1);
-          printf("SIFT Peak Threshold: %f\n", temp_float + 0.1);
-          break;
-        case 'g':
-          mar_sift_get_edge_threshold(&temp_float);
-          mar_sift_set_edge_threshold(temp_float + 0.1);
-          printf("SIFT Edge Threshold: %f\n", temp_float + 0.1);
-          break;
-      }
-      break;
     case 27:  // Escape key
       exit (EXIT_SUCCESS);
   }
@@ -753,6 +881,15 @@ void keyboard(unsigned char key, int x, int y)
 void cleanup_lighthouse()
 {
   mar_error_code mrv;
+
+  // Stop tracking before the augmentation is freed
+  if (tracking_started)
+  {
+    __atomic_store_n(&tracking_running, 0, __ATOMIC_RELEASE);
+    pthread_join(tracking_thread, NULL);
+  }
+  free(camera_frame_rgb);
+
   mrv = mar_augment_free();
   if (mrv != MAR_ERROR_NONE)
   {
@@ -791,11 +928,12 @@ int main(int argc, char *argv[])
   glutKeyboardFunc(keyboard);
   glutMouseFunc(mouse_button);
   glutPassiveMotionFunc(mouse_motion);
-  glutIdleFunc(update_and_display);
+  glutDisplayFunc(display);
+  glutIdleFunc(display);
   atexit(cleanup_lighthouse);
  
-  // Create the augmentation
-  mrv = mar_augment_init("res/lighthouse.cfg");
+  // Create the augmentation, replaying a capture log if one is given
+  mrv = argc > 1 ? mar_augment_init_replay(argv[1]) : mar_augment_init(LIGHTHOUSE_CONFIG);
   if (mrv != MAR_ERROR_NONE)
   {
     fprintf(stderr, "error: ");
@@ -812,6 +950,23 @@ int main(int argc, char *argv[])
     exit(EXIT_FAILURE);
   }
 
+  // Track on a thread of its own, drawing the snapshots it publishes from the GLUT thread
+  camera_frame_rgb = (unsigned char *)malloc(camera_width * camera_height * 3);
+  if (camera_frame_rgb == NULL)
+  {
+    fprintf(stderr, "error: ");
+    mar_print_error(MAR_ERROR_MALLOC);
+    exit(EXIT_FAILURE);
+  }
+  tracking_running = 1;
+  if (pthread_create(&tracking_thread, NULL, track, NULL) != 0)
+  {
+    fprintf(stderr, "error: ");
+    mar_print_error(MAR_ERROR_THREAD);
+    exit(EXIT_FAILURE);
+  }
+  tracking_started = 1;
+
   // Get the initial time
   gettimeofday(&last_display_time, NULL);
 